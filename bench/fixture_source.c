@@ -0,0 +1,121 @@
+/**
+ * @file fixture_source.c
+ * @brief Functions for serving recorded /proc files in place of the source cache.
+ * @author 1v6n
+ * @date 15/10/2026
+ */
+
+#include "fixture_source.h"
+#include "metrics.h"
+#include "source_cache.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+
+/**
+ * @brief Structure to hold an open fixture and its read buffer.
+ */
+typedef struct
+{
+    const char* path; /**< Path of the source, as asked by the reader. */
+    int fd;           /**< Descriptor of the fixture. */
+    char* buffer;     /**< Buffer holding the contents of the fixture. */
+    size_t capacity;  /**< Size of buffer in bytes. */
+} FixtureSource;
+
+static const char* fixture_root = "."; /**< Directory the /proc paths are resolved in. */
+static FixtureSource fixtures[MAX_SOURCES]; /**< Fixtures opened so far. */
+static size_t fixture_count = 0;            /**< Number of used entries in fixtures. */
+
+void fixture_source_set_root(const char* directory)
+{
+    fixture_root = directory;
+}
+
+static FixtureSource* open_fixture(const char* path)
+{
+    for (size_t i = 0; i < fixture_count; i++)
+    {
+        if (fixtures[i].path == path || strcmp(fixtures[i].path, path) == 0)
+        {
+            return &fixtures[i];
+        }
+    }
+
+    if (fixture_count >= MAX_SOURCES)
+    {
+        fprintf(stderr, "Error: too many fixtures (max %d)\n", MAX_SOURCES);
+        return NULL;
+    }
+
+    char fixture_path[PATH_MAX];
+    snprintf(fixture_path, sizeof(fixture_path), "%s%s", fixture_root, path);
+    int fd = open(fixture_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Error opening fixture %s: %s\n", fixture_path, strerror(errno));
+        return NULL;
+    }
+
+    FixtureSource* fixture = &fixtures[fixture_count++];
+    fixture->path = path;
+    fixture->fd = fd;
+    fixture->buffer = NULL;
+    fixture->capacity = 0;
+    return fixture;
+}
+
+const char* source_cache_read(const char* path, size_t* len)
+{
+    FixtureSource* fixture = open_fixture(path);
+    if (fixture == NULL)
+    {
+        return NULL;
+    }
+
+    // Like the cache, the contents are read again on every call, into a buffer that only grows
+    size_t used = 0;
+    while (true)
+    {
+        if (used + 1 >= fixture->capacity)
+        {
+            size_t capacity = fixture->capacity > 0 ? fixture->capacity * 2 : SOURCE_INITIAL_BUFFER;
+            char* buffer = realloc(fixture->buffer, capacity);
+            if (buffer == NULL)
+            {
+                return NULL;
+            }
+            fixture->buffer = buffer;
+            fixture->capacity = capacity;
+        }
+
+        ssize_t n = pread(fixture->fd, fixture->buffer + used, fixture->capacity - used - 1, (off_t)used);
+        if (n < 0)
+        {
+            fprintf(stderr, "Error reading fixture of %s: %s\n", path, strerror(errno));
+            return NULL;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        used += (size_t)n;
+    }
+
+    fixture->buffer[used] = '\0';
+    if (len != NULL)
+    {
+        *len = used;
+    }
+    return fixture->buffer;
+}
+
+void source_cache_close_all(void)
+{
+    for (size_t i = 0; i < fixture_count; i++)
+    {
+        close(fixtures[i].fd);
+        free(fixtures[i].buffer);
+    }
+    fixture_count = 0;
+}
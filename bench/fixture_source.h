@@ -0,0 +1,25 @@
+#ifndef FIXTURE_SOURCE_H
+#define FIXTURE_SOURCE_H
+
+/**
+ * @file fixture_source.h
+ * @brief Header file for serving recorded /proc files to the readers under benchmark.
+ *
+ * The benchmark links fixture_source.c in place of source_cache.c. Every source_cache_read() of a /proc path is then
+ * answered from the same path under a fixture directory, through a kept descriptor and pread() like the real cache, so
+ * the readers parse the same bytes on every host and every run.
+ *
+ * @date 15/10/2026
+ * @author 1v6n
+ */
+
+/**
+ * @brief Sets the directory the /proc fixtures are read from.
+ *
+ * Must be called before the first read. A path such as /proc/stat is then read from <directory>/proc/stat.
+ *
+ * @param directory The fixture directory. The pointer is stored, so it must outlive the benchmark.
+ */
+void fixture_source_set_root(const char* directory);
+
+#endif // FIXTURE_SOURCE_H
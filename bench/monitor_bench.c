@@ -0,0 +1,683 @@
+/**
+ * @file monitor_bench.c
+ * @brief Microbenchmarks of the /proc readers, the Prometheus client and the exposition, and a scrape load test.
+ *
+ * Every benchmark runs its operation in batches sized to last at least BENCH_MIN_BATCH_NS, after a warm-up, and
+ * reports the mean time per operation, the heap allocations per operation and the 99th percentile of the per-batch
+ * time per operation. Allocations are counted by wrapping the allocator entry points of the C library, so they include
+ * the allocations of libprom.
+ *
+ * Usage: monitor_bench [-f fixture_dir] [-s host:port] [-c connections] [-d seconds] [pattern]
+ *
+ * The /proc readers parse the recorded files of fixture_dir (BENCH_FIXTURE_DIR unless set). Only the benchmarks whose
+ * name matches the fnmatch(3) pattern run. The scrape load test runs against a running agent, and only when -s names
+ * it.
+ *
+ * @author 1v6n
+ * @date 15/10/2026
+ */
+
+#include "fixture_source.h"
+#include "metrics.h"
+#include "source_cache.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <netdb.h>
+#include <prom.h>
+#include <prom_map_i.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#define BENCH_BATCHES 200                  /**< Batches timed per benchmark. */
+#define BENCH_WARMUP_BATCHES 10            /**< Batches run before timing starts. */
+#define BENCH_MIN_BATCH_NS 50000ULL        /**< Shortest duration of a batch. */
+#define BENCH_MAX_BATCH_OPS (1ULL << 24)   /**< Largest number of operations in a batch. */
+#define BENCH_MAP_KEY_SIZE 32              /**< Buffer size of a generated map key. */
+#define SCRAPE_DEFAULT_CONNECTIONS 8       /**< Concurrent scrapers unless -c is set. */
+#define SCRAPE_DEFAULT_SECONDS 10          /**< Duration of the scrape load test unless -d is set. */
+#define SCRAPE_MAX_CONNECTIONS 256         /**< Largest number of concurrent scrapers. */
+#define SCRAPE_MAX_SAMPLES (1 << 20)       /**< Latencies kept per scraper for the percentiles. */
+#define SCRAPE_BUFFER_SIZE 65536           /**< Size of the buffer responses are read into. */
+
+#ifndef BENCH_FIXTURE_DIR
+#define BENCH_FIXTURE_DIR "bench/fixtures" /**< Fixture directory unless -f is set. */
+#endif
+
+/**
+ * @brief Operation under benchmark, run once per call.
+ */
+typedef void (*bench_fn)(void* arg);
+
+static atomic_ullong allocation_count; /**< Heap allocations made by the process so far. */
+static const char* bench_pattern = "*"; /**< Pattern selecting the benchmarks to run. */
+
+/* Allocator entry points of glibc, which the wrappers below forward to. */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+
+void* malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size)
+{
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    void* memory = __libc_memalign(alignment, size);
+    if (memory == NULL)
+    {
+        return ENOMEM;
+    }
+    *ptr = memory;
+    return 0;
+}
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Runs one benchmark and prints its line of the report, if its name matches the selected pattern.
+ *
+ * @param name Name of the benchmark.
+ * @param fn The operation.
+ * @param arg Argument passed to the operation.
+ */
+static void run_bench(const char* name, bench_fn fn, void* arg)
+{
+    if (fnmatch(bench_pattern, name, 0) != 0)
+    {
+        return;
+    }
+
+    // The batch grows until it lasts long enough for the clock reads around it not to matter
+    uint64_t batch_ops = 1;
+    while (batch_ops < BENCH_MAX_BATCH_OPS)
+    {
+        uint64_t start = monotonic_ns();
+        for (uint64_t i = 0; i < batch_ops; i++)
+        {
+            fn(arg);
+        }
+        if (monotonic_ns() - start >= BENCH_MIN_BATCH_NS)
+        {
+            break;
+        }
+        batch_ops *= 2;
+    }
+
+    for (int b = 0; b < BENCH_WARMUP_BATCHES; b++)
+    {
+        for (uint64_t i = 0; i < batch_ops; i++)
+        {
+            fn(arg);
+        }
+    }
+
+    double per_op[BENCH_BATCHES];
+    uint64_t total_ns = 0;
+    unsigned long long allocations = atomic_load(&allocation_count);
+    for (int b = 0; b < BENCH_BATCHES; b++)
+    {
+        uint64_t start = monotonic_ns();
+        for (uint64_t i = 0; i < batch_ops; i++)
+        {
+            fn(arg);
+        }
+        uint64_t elapsed = monotonic_ns() - start;
+        total_ns += elapsed;
+        per_op[b] = (double)elapsed / (double)batch_ops;
+    }
+    allocations = atomic_load(&allocation_count) - allocations;
+
+    qsort(per_op, BENCH_BATCHES, sizeof(per_op[0]), compare_doubles);
+    double ops = (double)batch_ops * BENCH_BATCHES;
+    printf("%-44s %14.1f ns/op %10.2f allocs/op %14.1f ns p99\n", name, (double)total_ns / ops,
+           (double)allocations / ops, per_op[(BENCH_BATCHES * 99) / 100]);
+}
+
+static void bench_get_memory_usage(void* arg)
+{
+    (void)arg;
+    get_memory_usage();
+}
+
+static void bench_get_total_memory(void* arg)
+{
+    (void)arg;
+    get_total_memory();
+}
+
+static void bench_get_used_memory(void* arg)
+{
+    (void)arg;
+    get_used_memory();
+}
+
+static void bench_get_available_memory(void* arg)
+{
+    (void)arg;
+    get_available_memory();
+}
+
+static void bench_get_cpu_usage(void* arg)
+{
+    get_cpu_usage(arg);
+}
+
+static void bench_get_context_switches(void* arg)
+{
+    (void)arg;
+    unsigned long long switches;
+    get_context_switches(&switches);
+}
+
+static void bench_get_disk_usage(void* arg)
+{
+    (void)arg;
+    get_disk_usage();
+}
+
+static void bench_get_process_states(void* arg)
+{
+    (void)arg;
+    ProcessStateCounts counts;
+    get_process_states(&counts);
+}
+
+static void bench_read_proc_stat(void* arg)
+{
+    read_proc_stat_snapshot(arg);
+}
+
+static void bench_read_diskstats(void* arg)
+{
+    read_diskstats_snapshot(arg);
+}
+
+static void bench_read_net_dev(void* arg)
+{
+    read_proc_net_dev_snapshot(arg);
+}
+
+/**
+ * @brief Benchmarks every reader of src/metrics.c.
+ *
+ * The readers of /proc/stat, /proc/meminfo, /proc/net/dev and /proc/diskstats parse the fixtures. get_disk_usage()
+ * and get_process_states() have no single file to record, so they query the live statvfs() and /proc of the host.
+ */
+static void bench_metrics(void)
+{
+    run_bench("metrics/get_memory_usage", bench_get_memory_usage, NULL);
+    run_bench("metrics/get_total_memory", bench_get_total_memory, NULL);
+    run_bench("metrics/get_used_memory", bench_get_used_memory, NULL);
+    run_bench("metrics/get_available_memory", bench_get_available_memory, NULL);
+
+    // The fixture never moves, so get_cpu_usage() reports an empty interval on every call; its warning is dropped
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (saved_stderr >= 0 && null_fd >= 0)
+    {
+        dup2(null_fd, STDERR_FILENO);
+    }
+    CpuUsageState cpu_usage_state = {0};
+    run_bench("metrics/get_cpu_usage", bench_get_cpu_usage, &cpu_usage_state);
+    if (saved_stderr >= 0 && null_fd >= 0)
+    {
+        dup2(saved_stderr, STDERR_FILENO);
+    }
+    if (null_fd >= 0)
+    {
+        close(null_fd);
+    }
+    if (saved_stderr >= 0)
+    {
+        close(saved_stderr);
+    }
+    proc_stat_snapshot_free(&cpu_usage_state.snapshot);
+
+    run_bench("metrics/get_context_switches", bench_get_context_switches, NULL);
+    run_bench("metrics/get_disk_usage(live)", bench_get_disk_usage, NULL);
+    run_bench("metrics/get_process_states(live)", bench_get_process_states, NULL);
+
+    ProcStatSnapshot stat_snapshot = {0};
+    run_bench("metrics/read_proc_stat_snapshot", bench_read_proc_stat, &stat_snapshot);
+    proc_stat_snapshot_free(&stat_snapshot);
+
+    DiskStatsSnapshot disk_snapshot = {0};
+    run_bench("metrics/read_diskstats_snapshot", bench_read_diskstats, &disk_snapshot);
+    diskstats_snapshot_free(&disk_snapshot);
+
+    NetDevSnapshot net_snapshot = {0};
+    run_bench("metrics/read_proc_net_dev_snapshot", bench_read_net_dev, &net_snapshot);
+    net_dev_snapshot_free(&net_snapshot);
+}
+
+/**
+ * @brief Structure to hold a map and the keys it was filled with.
+ */
+typedef struct
+{
+    prom_map_t* map; /**< The map. */
+    char** keys;     /**< Keys present in the map. */
+    size_t count;    /**< Number of keys. */
+    size_t next;     /**< Key used by the next operation. */
+} MapBench;
+
+static void bench_map_get(void* arg)
+{
+    MapBench* bench = arg;
+    prom_map_get(bench->map, bench->keys[bench->next]);
+    bench->next = bench->next + 1 < bench->count ? bench->next + 1 : 0;
+}
+
+static void bench_map_set(void* arg)
+{
+    MapBench* bench = arg;
+    prom_map_set(bench->map, bench->keys[bench->next], bench);
+    bench->next = bench->next + 1 < bench->count ? bench->next + 1 : 0;
+}
+
+/**
+ * @brief Benchmarks lookups and overwrites of existing keys in maps of 10 to 100k keys.
+ *
+ * Read-mostly maps copy their table on every insertion, so they are only filled up to the size of a registry.
+ */
+static void bench_map(bool read_mostly)
+{
+    static const size_t sizes[] = {10, 100, 1000, 10000, 100000};
+    size_t size_count = read_mostly ? 3 : sizeof(sizes) / sizeof(sizes[0]);
+    for (size_t s = 0; s < size_count; s++)
+    {
+        MapBench bench = {read_mostly ? prom_map_new_read_mostly() : prom_map_new(), calloc(sizes[s], sizeof(char*)),
+                          sizes[s], 0};
+        if (bench.map == NULL || bench.keys == NULL)
+        {
+            fprintf(stderr, "Error allocating a map of %zu keys\n", sizes[s]);
+            return;
+        }
+        for (size_t i = 0; i < bench.count; i++)
+        {
+            bench.keys[i] = malloc(BENCH_MAP_KEY_SIZE);
+            snprintf(bench.keys[i], BENCH_MAP_KEY_SIZE, "{series=\"%zu\"}", i);
+            prom_map_set(bench.map, bench.keys[i], &bench);
+        }
+
+        char name[64];
+        const char* kind = read_mostly ? "prom_map_read_mostly" : "prom_map";
+        snprintf(name, sizeof(name), "%s/get/%zu", kind, bench.count);
+        run_bench(name, bench_map_get, &bench);
+        snprintf(name, sizeof(name), "%s/set/%zu", kind, bench.count);
+        run_bench(name, bench_map_set, &bench);
+
+        prom_map_destroy(bench.map);
+        for (size_t i = 0; i < bench.count; i++)
+        {
+            free(bench.keys[i]);
+        }
+        free(bench.keys);
+    }
+}
+
+/**
+ * @brief Structure to hold a histogram sample and the values observed into it.
+ */
+typedef struct
+{
+    prom_metric_sample_histogram_t* sample; /**< The sample. */
+    double value;                           /**< Value of the next observation. */
+} HistogramBench;
+
+static void bench_histogram_observe(void* arg)
+{
+    HistogramBench* bench = arg;
+    prom_metric_sample_histogram_observe(bench->sample, bench->value);
+    // Walks every bucket boundary of the exponential layout
+    bench->value = bench->value < 10000.0 ? bench->value * 1.7 : 0.001;
+}
+
+/**
+ * @brief Benchmarks observations into a histogram sample of 20 exponential buckets.
+ */
+static void bench_histogram(void)
+{
+    prom_histogram_t* histogram = prom_histogram_new("bench_histogram", "Benchmark histogram",
+                                                     prom_histogram_buckets_exponential(0.001, 2.5, 20), 0, NULL);
+    HistogramBench bench = {NULL, 0.001};
+    if (histogram != NULL)
+    {
+        bench.sample = prom_metric_sample_histogram_from_labels((prom_metric_t*)histogram, NULL);
+    }
+    if (bench.sample == NULL)
+    {
+        fprintf(stderr, "Error creating the benchmark histogram\n");
+        prom_histogram_destroy(histogram);
+        return;
+    }
+
+    run_bench("prom_metric_sample_histogram_observe", bench_histogram_observe, &bench);
+    prom_histogram_destroy(histogram);
+}
+
+/**
+ * @brief Structure to hold a registry rendered by the bridge benchmark.
+ */
+typedef struct
+{
+    prom_collector_registry_t* registry; /**< Registry holding the series. */
+    prom_gauge_t* gauge;                 /**< Gauge with one sample per series. */
+    double value;                        /**< Value set before the next render. */
+} BridgeBench;
+
+static void bench_registry_bridge(void* arg)
+{
+    BridgeBench* bench = arg;
+    const char* label_values[] = {"0"};
+
+    // Moving a sample invalidates the render cache, so every call formats the whole registry again
+    prom_gauge_set(bench->gauge, bench->value++, label_values);
+    free((char*)prom_collector_registry_bridge(bench->registry));
+}
+
+/**
+ * @brief Benchmarks rendering the text exposition of registries of 10 to 100k series.
+ */
+static void bench_bridge(void)
+{
+    static const size_t sizes[] = {10, 100, 1000, 10000, 100000};
+    static const char* label_keys[] = {"series"};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "prom_collector_registry_bridge/%zu", sizes[s]);
+        if (fnmatch(bench_pattern, name, 0) != 0)
+        {
+            continue;
+        }
+
+        BridgeBench bench = {prom_collector_registry_new("bench"), NULL, 0.0};
+        prom_collector_t* collector = prom_collector_new("bench");
+        bench.gauge = prom_gauge_new("bench_series", "Benchmark series", 1, label_keys);
+        if (bench.registry == NULL || collector == NULL || bench.gauge == NULL ||
+            prom_collector_add_metric(collector, (prom_metric_t*)bench.gauge) != 0 ||
+            prom_collector_registry_register_collector(bench.registry, collector) != 0)
+        {
+            fprintf(stderr, "Error creating a registry of %zu series\n", sizes[s]);
+            return;
+        }
+
+        for (size_t i = 0; i < sizes[s]; i++)
+        {
+            char label[32];
+            snprintf(label, sizeof(label), "%zu", i);
+            const char* label_values[] = {label};
+            prom_gauge_set(bench.gauge, (double)i * 1.5, label_values);
+        }
+
+        run_bench(name, bench_registry_bridge, &bench);
+        prom_collector_registry_destroy(bench.registry);
+    }
+}
+
+/**
+ * @brief Structure to hold the target and the results of one scraper thread.
+ */
+typedef struct
+{
+    const struct addrinfo* address; /**< Address of the agent. */
+    uint64_t deadline_ns;           /**< Monotonic time at which the scraper stops. */
+    double* latencies_ns;           /**< Latency of every successful scrape. */
+    size_t count;                   /**< Number of successful scrapes. */
+    size_t failures;                /**< Number of failed scrapes. */
+    unsigned long long bytes;       /**< Bytes received by successful scrapes. */
+} Scraper;
+
+/**
+ * @brief Scrapes /metrics once over a new connection.
+ *
+ * @return The number of bytes received, or -1 on failure.
+ */
+static ssize_t scrape_once(const struct addrinfo* address)
+{
+    static const char request[] = "GET /metrics HTTP/1.1\r\nHost: monitor\r\nConnection: close\r\n\r\n";
+    char buffer[SCRAPE_BUFFER_SIZE];
+
+    int fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+    if (fd < 0)
+    {
+        return RETURN_ERROR;
+    }
+    if (connect(fd, address->ai_addr, address->ai_addrlen) != 0 ||
+        send(fd, request, sizeof(request) - 1, MSG_NOSIGNAL) != (ssize_t)(sizeof(request) - 1))
+    {
+        close(fd);
+        return RETURN_ERROR;
+    }
+
+    ssize_t total = 0;
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0)
+    {
+        if (total == 0 && (n < 12 || strncmp(buffer + 8, " 200", 4) != 0))
+        {
+            close(fd);
+            return RETURN_ERROR;
+        }
+        total += n;
+    }
+    close(fd);
+    return n == 0 && total > 0 ? total : RETURN_ERROR;
+}
+
+static void* run_scraper(void* arg)
+{
+    Scraper* scraper = arg;
+    while (monotonic_ns() < scraper->deadline_ns)
+    {
+        uint64_t start = monotonic_ns();
+        ssize_t bytes = scrape_once(scraper->address);
+        if (bytes < 0)
+        {
+            scraper->failures++;
+            continue;
+        }
+        if (scraper->count < SCRAPE_MAX_SAMPLES)
+        {
+            scraper->latencies_ns[scraper->count++] = (double)(monotonic_ns() - start);
+        }
+        scraper->bytes += (unsigned long long)bytes;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Runs the scrape load test against a running agent and prints its report.
+ *
+ * @param target Address of the agent, as host:port.
+ * @param connections Number of concurrent scrapers, each scraping over a new connection at a time.
+ * @param seconds Duration of the test.
+ * @return 0 on success, or -1 in case of error.
+ */
+static int bench_scrape(const char* target, int connections, int seconds)
+{
+    char host[256];
+    const char* colon = strrchr(target, ':');
+    if (colon == NULL || (size_t)(colon - target) >= sizeof(host))
+    {
+        fprintf(stderr, "Invalid scrape target '%s', expected host:port\n", target);
+        return RETURN_ERROR;
+    }
+    memcpy(host, target, (size_t)(colon - target));
+    host[colon - target] = '\0';
+
+    struct addrinfo hints = {0};
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* address = NULL;
+    int err = getaddrinfo(host, colon + 1, &hints, &address);
+    if (err != 0)
+    {
+        fprintf(stderr, "Error resolving %s: %s\n", target, gai_strerror(err));
+        return RETURN_ERROR;
+    }
+
+    Scraper scrapers[SCRAPE_MAX_CONNECTIONS];
+    pthread_t threads[SCRAPE_MAX_CONNECTIONS];
+    uint64_t start = monotonic_ns();
+    int started = 0;
+    for (; started < connections; started++)
+    {
+        Scraper* scraper = &scrapers[started];
+        memset(scraper, 0, sizeof(*scraper));
+        scraper->address = address;
+        scraper->deadline_ns = start + (uint64_t)seconds * 1000000000ULL;
+        scraper->latencies_ns = malloc(SCRAPE_MAX_SAMPLES * sizeof(double));
+        if (scraper->latencies_ns == NULL || pthread_create(&threads[started], NULL, run_scraper, scraper) != 0)
+        {
+            free(scraper->latencies_ns);
+            fprintf(stderr, "Error starting scraper %d\n", started);
+            break;
+        }
+    }
+
+    size_t count = 0;
+    size_t failures = 0;
+    unsigned long long bytes = 0;
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+        count += scrapers[i].count;
+        failures += scrapers[i].failures;
+        bytes += scrapers[i].bytes;
+    }
+    double elapsed_s = (double)(monotonic_ns() - start) / 1e9;
+    freeaddrinfo(address);
+
+    double* latencies = count > 0 ? malloc(count * sizeof(double)) : NULL;
+    size_t merged = 0;
+    for (int i = 0; i < started; i++)
+    {
+        if (latencies != NULL)
+        {
+            memcpy(latencies + merged, scrapers[i].latencies_ns, scrapers[i].count * sizeof(double));
+            merged += scrapers[i].count;
+        }
+        free(scrapers[i].latencies_ns);
+    }
+
+    if (latencies == NULL)
+    {
+        fprintf(stderr, "No successful scrape of %s (%zu failures)\n", target, failures);
+        return RETURN_ERROR;
+    }
+
+    qsort(latencies, merged, sizeof(double), compare_doubles);
+    double sum = 0;
+    for (size_t i = 0; i < merged; i++)
+    {
+        sum += latencies[i];
+    }
+    printf("%-44s %14.1f ns/op %10.1f scrapes/s %14.1f ns p99\n", "scrape/metrics", sum / (double)merged,
+           (double)count / elapsed_s, latencies[(merged * 99) / 100]);
+    printf("%-44s %14zu failed %11.1f KiB/scrape %10d connections\n", "scrape/metrics", failures,
+           (double)bytes / (double)count / 1024.0, started);
+    free(latencies);
+    return 0;
+}
+
+/**
+ * @brief Entry point of the benchmark.
+ *
+ * @param argc The argument count.
+ * @param argv The argument vector.
+ * @return Returns `EXIT_SUCCESS`, or `EXIT_FAILURE` on invalid arguments or a failed scrape load test.
+ */
+int main(int argc, char* argv[])
+{
+    const char* fixture_dir = BENCH_FIXTURE_DIR;
+    const char* scrape_target = NULL;
+    int connections = SCRAPE_DEFAULT_CONNECTIONS;
+    int seconds = SCRAPE_DEFAULT_SECONDS;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:s:c:d:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            fixture_dir = optarg;
+            break;
+        case 's':
+            scrape_target = optarg;
+            break;
+        case 'c':
+            connections = atoi(optarg);
+            break;
+        case 'd':
+            seconds = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-f fixture_dir] [-s host:port] [-c connections] [-d seconds] [pattern]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind < argc)
+    {
+        bench_pattern = argv[optind];
+    }
+    if (connections < 1 || connections > SCRAPE_MAX_CONNECTIONS || seconds < 1)
+    {
+        fprintf(stderr, "Connections must be 1 to %d and the duration at least 1 s\n", SCRAPE_MAX_CONNECTIONS);
+        return EXIT_FAILURE;
+    }
+
+    fixture_source_set_root(fixture_dir);
+    bench_metrics();
+    bench_map(false);
+    bench_map(true);
+    bench_histogram();
+    bench_bridge();
+    source_cache_close_all();
+
+    if (scrape_target != NULL && fnmatch(bench_pattern, "scrape/metrics", 0) == 0)
+    {
+        return bench_scrape(scrape_target, connections, seconds) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+#ifndef CGROUP_TABLE_H
+#define CGROUP_TABLE_H
+
+/**
+ * @file cgroup_table.h
+ * @brief Header file for tracking the cgroup v2 hierarchy and reading the resource usage of every cgroup.
+ *
+ * The hierarchy is walked once; after that, an inotify watch on every cgroup directory reports child cgroups being
+ * created and removed, and changes of cgroup.events, which the kernel modifies whenever the populated state of the
+ * cgroup flips. Only populated cgroups are reported, and each keeps its cpu.stat, memory.current, memory.stat and
+ * io.stat open, so a read is one pread() per file and never walks the hierarchy again. The files held open are capped
+ * at a share of RLIMIT_NOFILE; past that, the files of further cgroups are opened, read and closed on every read.
+ *
+ * Entries are freed as soon as their cgroup is removed, so memory use follows the number of live cgroups. The
+ * release callback lets the caller drop the series of a cgroup that is gone or no longer populated.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <prom.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CGROUP_ROOT_PATH "/sys/fs/cgroup" /**< Mount point of the cgroup v2 hierarchy. */
+#define CGROUP_READ_BUFFER 8192           /**< Initial size of the buffer the cgroup files are read into. */
+#define CGROUP_READ_MAX_BUFFER (1 << 20)  /**< Upper bound on the size of that buffer. */
+#define CGROUP_INITIAL_BUCKETS 64         /**< Initial number of buckets of the watch table. */
+#define CGROUP_FD_SHARE 2                 /**< The table holds at most 1/CGROUP_FD_SHARE of RLIMIT_NOFILE open. */
+#define CGROUP_FD_MISSING (-1)            /**< Descriptor of a file the cgroup does not have. */
+#define CGROUP_FD_UNHELD (-2)             /**< Descriptor of a file opened on every read, past the fd budget. */
+
+/**
+ * @brief Values read from the files of a cgroup.
+ */
+typedef enum
+{
+    CGROUP_CPU_USAGE,      /**< CPU time in seconds, from cpu.stat usage_usec. */
+    CGROUP_CPU_THROTTLED,  /**< Time throttled by the CPU controller in seconds, from cpu.stat throttled_usec. */
+    CGROUP_MEMORY_CURRENT, /**< Memory charged to the cgroup in bytes, from memory.current. */
+    CGROUP_MEMORY_ANON,    /**< Anonymous memory in bytes, from memory.stat anon. */
+    CGROUP_MEMORY_FILE,    /**< Page cache in bytes, from memory.stat file. */
+    CGROUP_IO_READ,        /**< Bytes read from every device, from io.stat rbytes. */
+    CGROUP_IO_WRITE,       /**< Bytes written to every device, from io.stat wbytes. */
+    CGROUP_STAT_COUNT      /**< Number of values. */
+} CgroupStat;
+
+/**
+ * @brief Files kept open per cgroup.
+ */
+typedef enum
+{
+    CGROUP_FILE_EVENTS,         /**< cgroup.events, missing on the root cgroup. */
+    CGROUP_FILE_CPU_STAT,       /**< cpu.stat. */
+    CGROUP_FILE_MEMORY_CURRENT, /**< memory.current, present once the memory controller is enabled. */
+    CGROUP_FILE_MEMORY_STAT,    /**< memory.stat. */
+    CGROUP_FILE_IO_STAT,        /**< io.stat, present once the io controller is enabled. */
+    CGROUP_FILE_COUNT           /**< Number of files. */
+} CgroupFile;
+
+/**
+ * @brief Structure to hold one cgroup.
+ */
+typedef struct CgroupEntry
+{
+    int wd;                                           /**< inotify watch of the cgroup directory. */
+    char* path;                                       /**< Absolute path of the cgroup directory. */
+    const char* name;                                 /**< Path relative to the hierarchy root, into path. */
+    int fds[CGROUP_FILE_COUNT];                       /**< Descriptors of the files, or a CGROUP_FD_ value. */
+    bool populated;                                   /**< Whether the cgroup or one of its descendants has tasks. */
+    bool reported;                                    /**< Whether the caller may hold samples of the cgroup. */
+    bool seen;                                        /**< Set when the last walk listed the cgroup. */
+    double values[CGROUP_STAT_COUNT];                 /**< Last values read. */
+    unsigned long long counts[CGROUP_STAT_COUNT];     /**< Exact values of the byte counters, 0 for the others. */
+    bool valid[CGROUP_STAT_COUNT];                    /**< Whether each value was read. */
+    prom_metric_sample_t* samples[CGROUP_STAT_COUNT]; /**< Sample handles, owned by the caller. */
+    struct CgroupEntry* next;                         /**< Next entry of the same bucket. */
+} CgroupEntry;
+
+/**
+ * @brief Callback invoked when a reported cgroup is removed or no longer populated; its samples must be dropped.
+ */
+typedef void (*cgroup_release_fn)(CgroupEntry* entry);
+
+/**
+ * @brief Structure to hold the cgroup table.
+ */
+typedef struct
+{
+    const char* root;          /**< Mount point of the hierarchy. */
+    int inotify_fd;            /**< inotify instance watching every cgroup directory. */
+    CgroupEntry** buckets;     /**< Entries hashed by watch descriptor. */
+    size_t bucket_count;       /**< Number of buckets, a power of two. */
+    size_t entry_count;        /**< Number of live entries. */
+    char* buffer;              /**< Read buffer shared by every file. */
+    size_t capacity;           /**< Size of buffer in bytes. */
+    size_t open_fds;           /**< Number of files held open. */
+    size_t fd_budget;          /**< Number of files that may be held open. */
+    bool rescan;               /**< Whether the next read must walk the hierarchy first. */
+    cgroup_release_fn release; /**< Called before the samples of a cgroup go stale. */
+} CgroupTable;
+
+/**
+ * @brief Initializes a cgroup table; the first read walks the hierarchy.
+ *
+ * @param table The table to initialize.
+ * @param root Mount point of the hierarchy, normally CGROUP_ROOT_PATH. The pointer is stored.
+ * @param release Callback invoked before the samples of a cgroup go stale, may be NULL.
+ * @return 0 on success, or -1 if inotify is unavailable.
+ */
+int cgroup_table_init(CgroupTable* table, const char* root, cgroup_release_fn release);
+
+/**
+ * @brief Applies the pending hierarchy changes, then reads the files of every populated cgroup.
+ *
+ * @param table The table.
+ * @return 0 on success, or -1 in case of error.
+ */
+int cgroup_table_read(CgroupTable* table);
+
+/**
+ * @brief Iterates over the cgroups of the table.
+ *
+ * @param table The table.
+ * @param entry The previous entry, or NULL to start.
+ * @return The next entry, or NULL once every entry was returned.
+ */
+CgroupEntry* cgroup_table_next(const CgroupTable* table, const CgroupEntry* entry);
+
+/**
+ * @brief Releases every cgroup and closes the table.
+ *
+ * @param table The table.
+ */
+void cgroup_table_free(CgroupTable* table);
+
+#endif // CGROUP_TABLE_H
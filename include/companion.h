@@ -0,0 +1,87 @@
+#ifndef COMPANION_H
+#define COMPANION_H
+
+/**
+ * @file companion.h
+ * @brief Header file for launching and supervising the Prometheus and Grafana servers that run next to the monitor.
+ *
+ * The companions named by COMPANIONS_ENV are started with posix_spawn rather than through a shell, from the first
+ * supervision pass, which runs once the HTTP endpoint is up, so they never delay the first scrape. Every pass reaps the
+ * companions that exited and starts them again, after a delay that doubles from COMPANION_MIN_BACKOFF_MS up to
+ * COMPANION_MAX_BACKOFF_MS while they keep exiting and is reset once one ran for COMPANION_STABLE_MS.
+ *
+ * Companions are installed under the home directory, as the monitor has always expected: $HOME/prometheus/prometheus
+ * with $HOME/prometheus/prometheus.yml, and $HOME/grafana/bin/grafana with its defaults.ini. They inherit the standard
+ * streams, the environment and the placement of the collector threads, see placement.h, and are not stopped when the
+ * monitor exits.
+ *
+ * @date 15/10/2026
+ * @author 1v6n
+ */
+
+#include <prom.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define COMPANIONS_ENV "MONITOR_COMPANIONS" /**< Companions to run: "prometheus", "grafana" or both. */
+#define COMPANION_INTERVAL_MS 1000          /**< Interval at which the companions are supervised. */
+#define COMPANION_MIN_BACKOFF_MS 1000       /**< First delay before starting a companion that exited again. */
+#define COMPANION_MAX_BACKOFF_MS 60000      /**< Longest delay before starting a companion that exited again. */
+#define COMPANION_STABLE_MS 60000           /**< Run time after which a companion that exits is started right away. */
+#define COMPANION_PATH_SIZE 512             /**< Buffer size of a path in the command line of a companion. */
+#define COMPANION_MAX_ARGS 8                /**< Most arguments of a companion, including its path and the NULL. */
+
+/**
+ * @brief Companions the monitor knows how to run.
+ */
+typedef enum
+{
+    COMPANION_PROMETHEUS, /**< The Prometheus server. */
+    COMPANION_GRAFANA,    /**< The Grafana server. */
+    COMPANION_COUNT,      /**< Number of companions. */
+} CompanionKind;
+
+/**
+ * @brief Structure to hold a supervised companion.
+ */
+typedef struct
+{
+    bool enabled;                                        /**< Whether COMPANIONS_ENV names the companion. */
+    char paths[COMPANION_MAX_ARGS][COMPANION_PATH_SIZE]; /**< Arguments built from the home directory. */
+    char* argv[COMPANION_MAX_ARGS];                      /**< Command line, pointing into paths or at literals. */
+    pid_t pid;                                           /**< Process of the running companion, or 0. */
+    uint64_t started_ms;                                 /**< CLOCK_MONOTONIC time the companion was last started. */
+    uint64_t next_start_ms;                              /**< CLOCK_MONOTONIC time before which it is not restarted. */
+    unsigned int backoff_ms;                             /**< Delay before the next start once it exits. */
+} Companion;
+
+/**
+ * @brief Structure to hold the companions and the metrics reporting them.
+ */
+typedef struct
+{
+    Companion companions[COMPANION_COUNT]; /**< The companions, indexed by CompanionKind. */
+    prom_gauge_t* up_metric;               /**< Whether each enabled companion is running. */
+    prom_counter_t* starts_metric;         /**< Times each enabled companion was started. */
+} Companions;
+
+/**
+ * @brief Parses the companions to run and builds their command lines. None is started yet.
+ *
+ * @param companions The companions to initialize.
+ * @param list Comma-separated names of the companions, as in COMPANIONS_ENV.
+ * @return 0 on success, or -1 if a name is unknown or the home directory cannot be found.
+ */
+int companions_open(Companions* companions, const char* list);
+
+/**
+ * @brief Reaps the companions that exited and starts those that are due.
+ *
+ * Only one thread may supervise at a time.
+ *
+ * @param companions The companions.
+ */
+void companions_supervise(Companions* companions);
+
+#endif // COMPANION_H
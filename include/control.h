@@ -0,0 +1,108 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+/**
+ * @file control.h
+ * @brief Header file for the control channel that changes the selected metrics while monitoring runs.
+ *
+ * The channel is a FIFO opened read-write and without blocking, so it never reports end of file when a writer closes
+ * it and any number of clients can send commands over the lifetime of the process. The scheduler polls it along with
+ * its timer, and every command is applied on the scheduler thread, between two ticks:
+ *
+ *     add <patterns>             Registers the metrics and schedules their collectors.
+ *     remove <patterns>          Unschedules the collectors no selected metric needs and unregisters the metrics.
+ *     interval <patterns> <ms>   Collects the metrics every ms milliseconds, or at their default interval for 0.
+ *     list                       Points at the /catalog endpoint listing the available metrics.
+ *     trace <path>               Writes the events recorded since the last trace as Chrome trace JSON, see trace.h.
+ *
+ * Patterns are separated by commas; each is a metric name, a shell wildcard pattern such as "cpu_*", or "all", as
+ * accepted by match_metrics. A line holding only patterns adds them, and a line holding only "1" lists the metrics,
+ * as the one-shot FIFO read did. Commands end with a newline, or with the write that carried them, which must then fit
+ * in PIPE_BUF bytes.
+ *
+ * Unregistered metrics are kept, with their samples, and are registered again by a later add.
+ *
+ * So that a restarted monitor is scraped with data before any client writes to the FIFO, a default selection, taken
+ * from CONTROL_DEFAULT_ENV or CONTROL_DEFAULT_METRICS, is applied as soon as the channel is open. It is provisional:
+ * the first add replaces it, keeping the samples of the metrics that both select, and the first remove or interval
+ * command adopts it as is.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include "scheduler.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CONTROL_FIFO_PATH "/tmp/monitor_fifo"         /**< Path of the control FIFO. */
+#define CONTROL_LINE_SIZE 4096                        /**< Longest command accepted; longer lines are discarded. */
+#define CONTROL_DEFAULT_ENV "MONITOR_DEFAULT_METRICS" /**< Patterns selected at startup; empty for none. */
+/** Patterns selected at startup unless CONTROL_DEFAULT_ENV is set. */
+#define CONTROL_DEFAULT_METRICS                                                                                        \
+    "cpu_usage_percentage,memory_usage_percentage,*_memory_mb,filesystem_usage_percentage,network_*_bytes_total"
+
+/**
+ * @brief Callback reporting the outcome of every command.
+ */
+typedef void (*control_status_fn)(const char* status);
+
+/**
+ * @brief Structure to hold the control channel and the selection it manages.
+ */
+typedef struct
+{
+    int fd;                       /**< FIFO opened read-write, or -1. */
+    const char* path;             /**< Path of the FIFO, removed on close. */
+    char line[CONTROL_LINE_SIZE]; /**< Bytes of the command being received. */
+    size_t length;                /**< Number of bytes in line. */
+    bool discarding;              /**< Set while the rest of an overlong line is skipped. */
+    Scheduler* scheduler;         /**< Scheduler running the collectors of the selected metrics. */
+    bool* selected;               /**< Whether each entry of all_metrics is selected. */
+    bool* registered;             /**< Whether each entry of all_metrics is registered. */
+    unsigned int* intervals;      /**< Interval of each entry of all_metrics in ms, 0 for its default. */
+    size_t metric_count;          /**< Number of entries in all_metrics. */
+    size_t selected_count;        /**< Number of selected metrics. */
+    bool provisional;             /**< Set while the selection is the default one, which the first add replaces. */
+    control_status_fn report;     /**< Called with the outcome of every command, may be NULL. */
+} ControlChannel;
+
+/**
+ * @brief Creates the control FIFO if needed, opens it and has the scheduler poll it.
+ *
+ * @param control The channel to initialize.
+ * @param path Path of the FIFO, normally CONTROL_FIFO_PATH. The pointer is stored.
+ * @param scheduler The scheduler polling the channel and running the collectors.
+ * @param report Callback reporting the outcome of every command, or NULL.
+ * @return 0 on success, or -1 in case of error.
+ */
+int control_channel_open(ControlChannel* control, const char* path, Scheduler* scheduler, control_status_fn report);
+
+/**
+ * @brief Executes one command, as if it had been received on the channel.
+ *
+ * @param control The channel.
+ * @param command The command, without its newline. It is modified while being parsed.
+ * @return 0 on success, or -1 if the command is invalid or could not be applied entirely.
+ */
+int control_channel_execute(ControlChannel* control, char* command);
+
+/**
+ * @brief Applies the default selection, which the first add replaces.
+ *
+ * @param control The channel.
+ * @param patterns Comma-separated patterns, normally from CONTROL_DEFAULT_ENV or CONTROL_DEFAULT_METRICS.
+ * @return 0 on success, or -1 if a pattern selects no metric or the selection could not be applied entirely.
+ */
+int control_channel_select_default(ControlChannel* control, const char* patterns);
+
+/**
+ * @brief Stops polling the channel, closes it and removes the FIFO.
+ *
+ * The selected metrics stay registered.
+ *
+ * @param control The channel.
+ */
+void control_channel_close(ControlChannel* control);
+
+#endif // CONTROL_H
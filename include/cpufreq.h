@@ -0,0 +1,76 @@
+#ifndef CPUFREQ_H
+#define CPUFREQ_H
+
+/**
+ * @file cpufreq.h
+ * @brief Header file for reading the current frequency of every CPU through persistent file descriptors.
+ *
+ * On hybrid and throttled machines the CPUs run at very different frequencies, so cpu0 alone says little. A discovery
+ * pass lists every CPU under /sys/devices/system/cpu once and opens its cpufreq/scaling_cur_freq attribute. A regular
+ * read is then a single pass of pread() calls over the open descriptors, preceded by a read of the online CPU list;
+ * the pass is repeated only when that list changes or a descriptor goes stale.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <prom.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CPUFREQ_ROOT_PATH "/sys/devices/system/cpu" /**< Directory listing the CPUs. */
+#define CPUFREQ_VALUE_SIZE 32                       /**< Bytes read from a frequency attribute. */
+#define CPUFREQ_ONLINE_SIZE 256                     /**< Bytes kept of the online CPU list. */
+#define CPUFREQ_LABEL_SIZE 12                       /**< Buffer size of a CPU id rendered as a label value. */
+
+/**
+ * @brief Structure to hold the frequency input of one CPU.
+ */
+typedef struct
+{
+    int cpu;                        /**< CPU id. */
+    int fd;                         /**< Descriptor of the scaling_cur_freq attribute. */
+    char label[CPUFREQ_LABEL_SIZE]; /**< CPU id rendered as a label value. */
+    double mhz;                     /**< Last frequency read, in MHz. */
+    bool valid;                     /**< Whether mhz holds a reading. */
+    prom_metric_sample_t* sample;   /**< Sample handle, owned by the caller and reset by every discovery pass. */
+} CpuFreqEntry;
+
+/**
+ * @brief Structure to hold the per-CPU frequency table.
+ */
+typedef struct
+{
+    const char* root;                  /**< Directory the CPUs are discovered in. */
+    CpuFreqEntry* cpus;                /**< CPUs with a cpufreq driver, by ascending id. */
+    size_t cpu_count;                  /**< Number of valid entries in cpus. */
+    size_t cpu_capacity;               /**< Number of allocated entries in cpus. */
+    int online_fd;                     /**< Descriptor of the online CPU list, or -1. */
+    char online[CPUFREQ_ONLINE_SIZE];  /**< Online CPU list seen by the last discovery pass. */
+    bool rescan;                       /**< Whether the next read must run a discovery pass first. */
+} CpuFreqTable;
+
+/**
+ * @brief Initializes a frequency table; the first read runs the discovery pass.
+ *
+ * @param table The table to initialize.
+ * @param root Directory listing the CPUs, normally CPUFREQ_ROOT_PATH. The pointer is stored.
+ */
+void cpufreq_table_init(CpuFreqTable* table, const char* root);
+
+/**
+ * @brief Reads the frequency of every CPU of the table.
+ *
+ * @param table The table.
+ * @return 1 if a discovery pass ran, so that sample handles must be resolved again, 0 if not, or -1 in case of error.
+ */
+int cpufreq_table_read(CpuFreqTable* table);
+
+/**
+ * @brief Closes every descriptor of the table and releases it.
+ *
+ * @param table The table.
+ */
+void cpufreq_table_free(CpuFreqTable* table);
+
+#endif // CPUFREQ_H
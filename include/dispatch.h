@@ -0,0 +1,71 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+/**
+ * @file dispatch.h
+ * @brief Header file for grouping selected metrics by the collector that produces them.
+ *
+ * Several metrics are produced by the same collector function (for example, every network counter comes from a single
+ * pass over /proc/net/dev). The dispatch layer keeps one entry per distinct collector so that each collector runs
+ * exactly once per monitoring cycle, no matter how many of its metrics were selected.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <stddef.h>
+
+#define MAX_COLLECTORS 32        /**< Maximum number of distinct collector functions in a dispatch table. */
+#define DEFAULT_INTERVAL_MS 1000  /**< Collection interval of metrics that do not set their own. */
+
+/**
+ * @brief Collector function that reads a source and updates every gauge derived from it.
+ */
+typedef void (*collector_fn)(void);
+
+/**
+ * @brief Structure to hold a collector and the number of selected metrics it serves.
+ */
+typedef struct
+{
+    collector_fn update_function; /**< Collector shared by the grouped metrics. */
+    size_t metric_count;          /**< Number of selected metrics served by the collector. */
+    unsigned int interval_ms;     /**< Shortest interval requested by the grouped metrics. */
+} CollectorGroup;
+
+/**
+ * @brief Structure to hold the deduplicated set of collectors to run on every cycle.
+ */
+typedef struct
+{
+    CollectorGroup groups[MAX_COLLECTORS]; /**< Distinct collectors in selection order. */
+    size_t group_count;                    /**< Number of used entries in groups. */
+} CollectorDispatch;
+
+/**
+ * @brief Initializes an empty dispatch table.
+ *
+ * @param dispatch The dispatch table to initialize.
+ */
+void dispatch_init(CollectorDispatch* dispatch);
+
+/**
+ * @brief Adds a metric's collector to the dispatch table.
+ *
+ * If the collector is already present, its metric count is incremented and it keeps the shorter of the two intervals.
+ *
+ * @param dispatch The dispatch table.
+ * @param update_function The collector producing the metric.
+ * @param interval_ms Collection interval of the metric in milliseconds, or 0 for DEFAULT_INTERVAL_MS.
+ * @return 0 on success, or -1 if the table is full or the collector is NULL.
+ */
+int dispatch_add(CollectorDispatch* dispatch, collector_fn update_function, unsigned int interval_ms);
+
+/**
+ * @brief Runs every collector in the dispatch table exactly once.
+ *
+ * @param dispatch The dispatch table.
+ */
+void dispatch_run(const CollectorDispatch* dispatch);
+
+#endif // DISPATCH_H
@@ -10,14 +10,37 @@
  * collected from the system and made available via an HTTP server for monitoring purposes.
  *
  * The metrics include usage statistics for CPU, memory, disk, network, battery, and more. The metrics are updated
- * safely in a multi-threaded environment using mutexes to ensure thread safety.
+ * without locks; related values are published as batches so that scrapes always see a consistent set.
  *
  * @date 09/10/2024
  * @author 1v6n
  */
 
+#include "cgroup_table.h"
+#include "companion.h"
+#include "cpufreq.h"
+#include "gateway.h"
+#include "history.h"
+#include "hwmon.h"
+#include "instrumentation.h"
+#include "irq_stats.h"
 #include "metrics.h"
+#include "mount_table.h"
+#include "perf_events.h"
+#include "placement.h"
+#include "process_table.h"
+#include "psi.h"
+#include "rate.h"
+#include "remote_write.h"
+#include "rollup.h"
+#include "schedstat.h"
+#include "scheduler.h"
+#include "shm_export.h"
+#include "source_cache.h"
+#include "sysroot.h"
+#include "trace.h"
 #include <errno.h>
+#include <limits.h>
 #include <prom.h>
 #include <promhttp.h>
 #include <pthread.h>
@@ -29,18 +52,115 @@
 #include <string.h>
 #include <unistd.h>
 
+#define HTTP_PORT 8000                 /**< Port the metrics are exposed on. */
+#define HTTP_THREAD_POOL_SIZE 4        /**< Threads serving scrapes. */
+#define HTTP_CONNECTION_LIMIT 64       /**< Maximum number of concurrent scrape connections. */
+#define HTTP_PER_IP_CONNECTION_LIMIT 8 /**< Maximum number of concurrent connections from one address. */
+#define HTTP_CONNECTION_TIMEOUT_S 10   /**< Seconds after which an idle connection is closed. */
+#define HTTP_STREAM_CHUNK_SIZE 0       /**< Streamed /metrics chunk size in bytes; 0 serves the cached render. */
+#define NETWORK_INCLUDE_ENV "MONITOR_NETWORK_INCLUDE" /**< Pattern of the network devices to report. */
+#define NETWORK_EXCLUDE_ENV "MONITOR_NETWORK_EXCLUDE" /**< Pattern of the network devices to skip. */
+#define NET_DEV_METRIC_COUNT 8                        /**< Number of per-device network gauges. */
+#define DISK_DEVICE_METRIC_COUNT 6                    /**< Number of per-disk gauges. */
+#define FILESYSTEM_INCLUDE_ENV "MONITOR_FILESYSTEM_INCLUDE" /**< Pattern of the file system types to report. */
+#define FILESYSTEM_EXCLUDE_ENV "MONITOR_FILESYSTEM_EXCLUDE" /**< Pattern of the file system types to skip. */
+#define FILESYSTEM_STAT_TIMEOUT_MS 1000                     /**< Time a collection waits for statvfs answers. */
+#define PSI_TRIGGER_ENV "MONITOR_PSI_TRIGGER"               /**< PSI trigger armed on every resource, empty for none. */
+#define ADAPTIVE_MAX_INTERVAL_ENV "MONITOR_ADAPTIVE_MAX_MS" /**< Longest backed-off interval; unset for fixed rates. */
+#define ADAPTIVE_EPSILON_ENV "MONITOR_ADAPTIVE_EPSILON"    /**< Relative change below which a value is stable. */
+#define ADAPTIVE_EPSILON_DEFAULT 0.001                     /**< Stability threshold unless ADAPTIVE_EPSILON_ENV is set. */
+#define LAZY_COLLECTION_ENV "MONITOR_LAZY"                  /**< 1 to collect the metrics only when scraped. */
+#define SERIES_MAX_ENV "MONITOR_SERIES_MAX"                 /**< Most series of one labelled metric; unset for no limit. */
+#define SERIES_SWEEP_INTERVAL_MS 10000                      /**< Interval at which idle series are evicted. */
+/** Pseudo file systems skipped unless FILESYSTEM_EXCLUDE_ENV is set. */
+#define FILESYSTEM_EXCLUDE_DEFAULT                                                                                     \
+    "autofs|binfmt_misc|bpf|cgroup2?|configfs|debugfs|devpts|devtmpfs|fusectl|hugetlbfs|iso9660|mqueue|nsfs|"        \
+    "overlay|proc|procfs|pstore|rpc_pipefs|securityfs|selinuxfs|squashfs|sysfs|tracefs"
+
+/**
+ * @brief Prometheus type a metric is exported as.
+ */
+typedef enum
+{
+    METRIC_GAUGE,        /**< Gauge holding a double, stored densely. */
+    METRIC_COUNTER,      /**< Counter holding an exact 64-bit integer, for monotonic kernel counters. */
+    METRIC_FLOAT_COUNTER /**< Counter holding a double, stored densely, for cumulative times in seconds. */
+} MetricKind;
+
 typedef struct
 {
     const char* name;
     const char* description;
     prom_gauge_t** metric;
     void (*update_function)(void); // Pointer to the update function
+    unsigned int interval_ms;      // Collection interval in milliseconds, 0 for the default
+    size_t label_count;            // Number of label keys, 0 for unlabelled gauges
+    const char** label_keys;       // Label keys, NULL for unlabelled gauges
+    MetricKind kind;               // Exported type, METRIC_GAUGE unless set
+    Rollup* rollup;                // One-minute min/max/avg rollup of a gauge, NULL for none
+    Rate* rate;                    // Per-second rate of a counter, NULL for none
+    const char* header;            // "# HELP" and "# TYPE" lines of the text format, built by the compiler
+    size_t header_len;             // Length of header
 } MetricInfo;
 
-extern MetricInfo all_metrics[];
+extern const MetricInfo all_metrics[];
+
+typedef struct
+{
+    const char* name;              // Name used as the collector label value
+    void (*update_function)(void); // Pointer to the update function
+} CollectorInfo;
+
+extern CollectorInfo all_collectors[];
 
 /**
- * @brief Updates a Prometheus gauge metric with thread safety.
+ * @brief Looks up the name of a collector in the all_collectors array.
+ *
+ * @param update_function The collector.
+ * @return The collector name, or "unknown" if it is not listed.
+ */
+const char* collector_name(void (*update_function)(void));
+
+/**
+ * @brief Counts a missed collector deadline in the collector_timeout_total counter.
+ *
+ * @param update_function The collector that missed its deadline.
+ */
+void report_collector_timeout(void (*update_function)(void));
+
+/**
+ * @brief Callback invoked on every metric selected by a pattern.
+ */
+typedef void (*metric_visit_fn)(const MetricInfo* info, void* arg);
+
+/**
+ * @brief Looks up a metric by name in the all_metrics array.
+ *
+ * The lookup is a binary search of all_metrics, which metric_catalog.h keeps sorted by name.
+ *
+ * @param name The metric name.
+ * @return The matching MetricInfo entry, or NULL if the metric does not exist.
+ */
+const MetricInfo* find_metric_info(const char* name);
+
+/**
+ * @brief Calls a function on every metric selected by a pattern, in name order.
+ *
+ * The pattern is a metric name, a shell wildcard pattern such as "cpu_*" as matched by fnmatch(3), or "all". Only the
+ * metrics sharing the literal prefix of the pattern are matched against it, so a lookup costs a binary search plus
+ * the number of metrics under that prefix.
+ *
+ * @param pattern The pattern.
+ * @param visit The function to call.
+ * @param arg Argument passed to the function.
+ * @return The number of selected metrics.
+ */
+size_t match_metrics(const char* pattern, metric_visit_fn visit, void* arg);
+
+/**
+ * @brief Updates a Prometheus gauge metric without taking any lock.
+ *
+ * Gauges that were not selected (NULL) are skipped, so collectors can update every gauge they produce.
  *
  * @param gauge The Prometheus gauge metric to update.
  * @param value The value to set for the metric.
@@ -48,31 +168,86 @@ extern MetricInfo all_metrics[];
 void update_gauge(prom_gauge_t* gauge, double value);
 
 /**
- * @brief Updates the CPU usage metric.
+ * @brief Updates several gauges as one consistent set.
+ *
+ * A scrape sees either every new value of the batch or none of them. Gauges that were not selected (NULL) are skipped.
+ *
+ * @param gauges The Prometheus gauges to update.
+ * @param values The values to set, one per gauge.
+ * @param count The number of gauges.
+ */
+void update_gauges(const prom_gauge_t** gauges, const double* values, size_t count);
+
+/**
+ * @brief Sets the exact value of a counter mirroring a kernel counter.
+ *
+ * Counters that were not selected (NULL) are skipped.
+ *
+ * @param counter The Prometheus counter to update, created as METRIC_COUNTER.
+ * @param value The value read from the kernel.
+ */
+void update_counter(prom_counter_t* counter, unsigned long long value);
+
+/**
+ * @brief Sets the exact values of several counters as one consistent set.
+ *
+ * A scrape sees either every new value of the batch or none of them. Counters that were not selected (NULL) are
+ * skipped.
+ *
+ * @param counters The Prometheus counters to update, created as METRIC_COUNTER.
+ * @param values The values to set, one per counter.
+ * @param count The number of counters.
  */
-void update_cpu_gauge(void);
+void update_counters(prom_counter_t* const* counters, const unsigned long long* values, size_t count);
 
 /**
- * @brief Updates the memory usage metric.
+ * @brief Updates the CPU, context switch, interrupt and process count metrics from a single /proc/stat snapshot.
  */
-void update_memory_gauge(void);
+void update_proc_stat_metrics(void);
 
 /**
- * @brief Thread function to expose metrics via HTTP on port 8000.
+ * @brief Thread function to expose metrics via HTTP on port HTTP_PORT.
+ *
+ * The daemon serves scrapes from a pool of HTTP_THREAD_POOL_SIZE epoll threads, falling back to a single select()
+ * thread where epoll is unavailable. The calling thread then blocks until stop_expose_metrics is called.
+ *
  * @param arg Unused argument.
  * @return NULL
  */
 void* expose_metrics(const void* arg);
 
 /**
- * @brief Initializes mutex and metrics.
+ * @brief Stops the HTTP server started by expose_metrics and lets its thread return.
+ */
+void stop_expose_metrics(void);
+
+/**
+ * @brief Initializes the Prometheus registry and the selected metrics.
+ *
+ * @param selected_metrics Patterns of the metrics to register, as accepted by match_metrics.
+ * @param num_metrics Number of patterns.
  */
 void init_metrics(const char* selected_metrics[], size_t num_metrics);
 
 /**
- * @brief Destroys the mutex.
+ * @brief Registers a metric, creating it on first use.
+ *
+ * A metric that was unregistered is registered again with its samples.
+ *
+ * @param info The metric, which must not be registered.
+ * @return 0 on success, or -1 in case of error.
  */
-void destroy_mutex(void);
+int register_metric(const MetricInfo* info);
+
+/**
+ * @brief Removes a metric from the exposition without destroying it.
+ *
+ * Collectors may keep updating the metric; the updates are only exposed once it is registered again.
+ *
+ * @param info The registered metric.
+ * @return 0 on success, or -1 in case of error.
+ */
+int unregister_metric(const MetricInfo* info);
 
 /**
  * @brief Updates the disk usage metric.
@@ -80,68 +255,216 @@ void destroy_mutex(void);
 void update_disk_gauge(void);
 
 /**
- * @brief Updates the running processes metric.
+ * @brief Updates every hwmon sensor metric and the single-value temperature, battery and fan gauges from one read of
+ *        the sensor table.
  */
-void update_running_processes_gauge(void);
+void update_hwmon_metrics(void);
 
 /**
- * @brief Updates the CPU temperature metric.
+ * @brief Updates the per-CPU frequency metric and the single-value CPU frequency gauge from one read of the frequency
+ *        table.
  */
-void update_cpu_temperature(void);
+void update_cpu_frequency(void);
 
 /**
- * @brief Updates the battery voltage metric.
+ * @brief Refreshes the process table and updates the process state and top-N process metrics.
  */
-void update_battery_voltage(void);
+void update_process_states_gauge(void);
 
 /**
- * @brief Updates the battery current metric.
+ * @brief Updates every memory metric from a single /proc/meminfo snapshot.
  */
-void update_battery_current(void);
+void update_memory_metrics(void);
 
 /**
- * @brief Updates the CPU frequency metric.
+ * @brief Updates the network traffic metrics.
  */
-void update_cpu_frequency(void);
+void update_network_traffic_metric(void);
 
 /**
- * @brief Updates the CPU fan speed metric.
+ * @brief Updates the per-device network metrics from a single /proc/net/dev snapshot.
+ *
+ * Only the devices passing the NETWORK_INCLUDE_ENV and NETWORK_EXCLUDE_ENV patterns are reported, each labelled by its
+ * interface name.
  */
-void update_cpu_fan_speed(void);
+void update_network_device_metrics(void);
 
 /**
- * @brief Updates the GPU fan speed metric.
+ * @brief Updates the disk stats metrics.
  */
-void update_gpu_fan_speed(void);
+void update_disk_stats_metrics(void);
 
 /**
- * @brief Updates the process states metrics.
+ * @brief Updates the usage and inode metrics of every mounted file system.
+ *
+ * The statvfs queries run on the pool given to set_collector_pool and are waited for up to FILESYSTEM_STAT_TIMEOUT_MS,
+ * so a dead network mount only leaves its own gauges stale.
  */
-void update_process_states_gauge(void);
+void update_filesystem_metrics(void);
 
 /**
- * @brief Updates the memory metrics.
+ * @brief Updates the pressure stall metrics of every resource from /proc/pressure.
  */
-void update_memory_metrics(void);
+void update_psi_metrics(void);
 
 /**
- * @brief Updates the network traffic metrics.
+ * @brief Updates the per-CPU scheduler metrics and the mean run-queue latency from /proc/schedstat.
  */
-void update_network_traffic_metric(void);
+void update_schedstat_metrics(void);
 
 /**
- * @brief Updates the context switches metric.
+ * @brief Updates the instructions per cycle and the cache and branch miss ratios of every CPU from its hardware events.
  */
-void update_context_switches_metric(void);
+void update_perf_metrics(void);
 
 /**
- * @brief Updates the disk stats metrics.
+ * @brief Updates the interrupt count of the busiest lines of /proc/interrupts on every CPU, keeping IRQ_TOP_ENV lines.
  */
-void update_disk_stats_metrics(void);
+void update_interrupt_metrics(void);
 
 /**
- * @brief Prints all available metrics with their names and descriptions.
+ * @brief Updates the count of every softirq type on every CPU from /proc/softirqs.
+ */
+void update_softirq_metrics(void);
+
+/**
+ * @brief Updates the page fault, swap and OOM kill counters from /proc/vmstat.
+ */
+void update_vmstat_metrics(void);
+
+/**
+ * @brief Updates the CPU, memory and I/O metrics of every populated cgroup, each labelled by its path.
+ *
+ * The series of a cgroup are removed as soon as it is deleted or no longer populated.
+ */
+void update_cgroup_metrics(void);
+
+/**
+ * @brief Registers the descriptors whose events must run a collector right away with the scheduler.
+ *
+ * When the pressure metrics are selected, a PSI trigger (PSI_TRIGGER_ENV, or PSI_TRIGGER_DEFAULT) is armed on every
+ * resource, so that a stall refreshes them as soon as it happens instead of on the next tick. Collectors that already
+ * watch their descriptors are left alone, so this can be called again whenever the scheduled collectors change.
+ *
+ * @param scheduler The scheduler running the collectors.
+ */
+void watch_collector_events(Scheduler* scheduler);
+
+/**
+ * @brief Publishes the current value of every series in the shared memory segment, if one is configured.
+ *
+ * Nothing is copied unless a sample changed since the last snapshot.
+ */
+void update_shm_export(void);
+
+/**
+ * @brief Appends the current value of every series to the local history, if one is configured.
+ */
+void update_history(void);
+
+/**
+ * @brief Queues the current value of every series for the remote-write endpoint, if one is configured.
+ */
+void update_remote_write(void);
+
+/**
+ * @brief Scrapes the monitors merged by the gateway, if one is configured.
+ */
+void update_gateway(void);
+
+/**
+ * @brief Starts the companion servers that are due and reaps those that exited, if any is configured.
+ */
+void update_companions(void);
+
+/**
+ * @brief Evicts the series left idle past the TTL of their metric, and reports the series refused by SERIES_MAX_ENV.
+ */
+void update_series_sweep(void);
+
+/**
+ * @brief Folds the gauges a collector just updated into their rollups.
+ *
+ * @param update_function The collector that ran.
+ */
+void update_rollups(void (*update_function)(void));
+
+/**
+ * @brief Derives the per-second rates of the counters a collector just updated.
+ *
+ * @param update_function The collector that ran.
+ */
+void update_rates(void (*update_function)(void));
+
+/**
+ * @brief Tells whether the last run of a collector changed any of its series by more than the adaptive epsilon.
+ *
+ * A value is stable while it moves by less than ADAPTIVE_EPSILON_ENV times its magnitude, or than the epsilon itself
+ * for values below 1. A series that appears or disappears is a change, and so is every run of a collector without
+ * series, so exporters are never slowed down. Must be called by the thread that ran the collector.
+ *
+ * @param update_function The collector that ran.
+ * @return Whether the run changed the metrics of the collector.
+ */
+bool collector_metrics_changed(void (*update_function)(void));
+
+/**
+ * @brief Turns on adaptive sampling in a scheduler if ADAPTIVE_MAX_INTERVAL_ENV is set.
+ *
+ * Collectors whose series stay within ADAPTIVE_EPSILON_ENV then double their interval on every run, up to
+ * ADAPTIVE_MAX_INTERVAL_ENV milliseconds, and return to their own interval as soon as a series changes.
+ *
+ * @param scheduler The scheduler, which must not run yet.
+ */
+void init_adaptive_sampling(Scheduler* scheduler);
+
+/**
+ * @brief Turns on lazy collection in a scheduler if LAZY_COLLECTION_ENV is set.
+ *
+ * The metric collectors then leave the wheel and run when a scrape finds their last run older than their interval.
+ * The collectors added by add_export_collectors() keep running on the wheel, on whatever values were last collected.
+ *
+ * @param scheduler The scheduler, which must not run yet.
+ */
+void init_lazy_collection(Scheduler* scheduler);
+
+/**
+ * @brief Stops scrapes from collecting through the scheduler given to init_lazy_collection, before it is destroyed.
+ */
+void stop_lazy_collection(void);
+
+/**
+ * @brief Adds the collectors that export the metrics, rather than read them, to a dispatch.
+ *
+ * They run whatever metrics are selected: the shared memory snapshot, when SHM_EXPORT_NAME_ENV names a segment, the
+ * local history, when HISTORY_DIR_ENV names a directory, and the remote write, when REMOTE_WRITE_URL_ENV names an
+ * endpoint. The series sweep always runs with them.
+ *
+ * @param dispatch The dispatch being built.
+ */
+void add_export_collectors(CollectorDispatch* dispatch);
+
+/**
+ * @brief Closes the gateway, if one was opened, unregistering its merged families.
+ *
+ * Must be called once the scheduler and the worker pool running the export collectors are destroyed. The HTTP server
+ * may keep serving; its renders no longer list the families of the gateway.
+ */
+void stop_export_collectors(void);
+
+/**
+ * @brief Hands the collector worker pool to the collectors that spread their own work over it.
+ *
+ * @param pool The pool, or NULL to run that work on the collector thread.
+ */
+void set_collector_pool(WorkerPool* pool);
+
+/**
+ * @brief Updates the per-disk I/O rate metrics from a single /proc/diskstats snapshot.
+ *
+ * Every whole device is reported, labelled by its name; partitions, loop and ram devices are skipped. Rates are
+ * computed against the previous cycle, so a device is first reported on the cycle after it appears.
  */
-void show_available_metrics(void);
+void update_disk_device_metrics(void);
 
 #endif // EXPOSE_METRICS_H
\ No newline at end of file
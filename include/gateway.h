@@ -0,0 +1,176 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+/**
+ * @file gateway.h
+ * @brief Header file for merging the series of many downstream monitors into the registry this monitor serves.
+ *
+ * A Prometheus server scraping hundreds of monitors per rack spends most of its effort on targets rather than samples.
+ * With GATEWAY_TARGETS_ENV set, one monitor per rack scrapes the others every GATEWAY_INTERVAL_MS and serves their
+ * series as its own, each with an instance label naming the monitor it came from. Prometheus then scrapes the gateway
+ * alone, through the same cached exposition as every other series.
+ *
+ * Targets are scraped concurrently from one thread: every connection is non-blocking and driven by epoll, and a target
+ * that has not answered within GATEWAY_TIMEOUT_MS counts as down. Hosts are resolved when the gateway opens; a target
+ * that could not be resolved or reached is resolved again in the background, and its new address used once known. The
+ * binary protobuf exposition is requested, so no text is parsed. Counter, gauge and untyped series are merged;
+ * summaries and histograms are skipped. A family is registered when first listed, with the label names of its first
+ * series; series with other label names or already labelled with instance are skipped, and so are families whose name
+ * the registry already holds, as when this monitor selected the same metric itself.
+ *
+ * Series a target no longer lists, and those of a target that is down, are evicted by the series sweep once idle for
+ * GATEWAY_SERIES_TTL_S. gateway_target_up tells which targets answered the last scrape.
+ *
+ * With GATEWAY_AGGREGATE_ENV set to sum, max or both, every merged family also gets rack:<name>:sum and rack:<name>:max
+ * families holding the sum or the maximum, over the targets that answered, of the series that share their other
+ * labels. A target going down thus lowers a sum of counters, which rate() takes for a reset.
+ *
+ * @date 15/10/2026
+ * @author 1v6n
+ */
+
+#include <prom.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#define GATEWAY_TARGETS_ENV "MONITOR_GATEWAY_TARGETS"     /**< Comma-separated host:port of the monitors to merge. */
+#define GATEWAY_AGGREGATE_ENV "MONITOR_GATEWAY_AGGREGATE" /**< "sum", "max" or "sum,max"; unset for no aggregates. */
+#define GATEWAY_INTERVAL_MS 5000                          /**< Interval at which every target is scraped. */
+#define GATEWAY_TIMEOUT_MS 4000                           /**< Time a scrape of every target may take. */
+#define GATEWAY_SERIES_TTL_S 30                           /**< Idle time after which a merged series is evicted. */
+#define GATEWAY_DEFAULT_PORT "8000"                       /**< Port of a target that names none. */
+#define GATEWAY_PATH "/metrics"                           /**< Path scraped on every target. */
+#define GATEWAY_MAX_TARGETS 1024                          /**< Most targets a gateway scrapes. */
+#define GATEWAY_MAX_RESPONSE (1 << 26)                    /**< Largest response accepted from a target. */
+#define GATEWAY_MAX_LABELS 32                             /**< Most labels of a merged series, instance included. */
+#define GATEWAY_HOST_SIZE 256                             /**< Longest host name accepted, including the NUL. */
+#define GATEWAY_REQUEST_SIZE 512                          /**< Buffer size of the request sent to a target. */
+#define GATEWAY_AGGREGATE_PREFIX "rack:"                  /**< Prefix of the names of the aggregate families. */
+
+/**
+ * @brief Aggregates a gateway can keep of every merged family.
+ */
+typedef enum
+{
+    GATEWAY_SUM,             /**< Sum over the targets. */
+    GATEWAY_MAX,             /**< Maximum over the targets. */
+    GATEWAY_AGGREGATE_COUNT, /**< Number of aggregates. */
+} GatewayAggregateKind;
+
+/**
+ * @brief Progress of the scrape of a target.
+ */
+typedef enum
+{
+    GATEWAY_IDLE,       /**< Not being scraped. */
+    GATEWAY_CONNECTING, /**< Connecting, or sending the request. */
+    GATEWAY_RECEIVING,  /**< Reading the response until the target closes the connection. */
+    GATEWAY_DONE,       /**< The whole response was read. */
+    GATEWAY_FAILED,     /**< The target could not be reached or did not answer in time. */
+} GatewayState;
+
+/**
+ * @brief Structure to hold a downstream monitor and the buffer its responses are read into.
+ */
+typedef struct
+{
+    char host[GATEWAY_HOST_SIZE];         /**< Host of the target. */
+    char port[8];                         /**< Port of the target. */
+    char instance[GATEWAY_HOST_SIZE + 8]; /**< Value of the instance label of its series, as configured. */
+    char request[GATEWAY_REQUEST_SIZE];   /**< Request sent on every scrape. */
+    size_t request_len;                   /**< Length of request. */
+    struct sockaddr_storage address;      /**< Address the host resolved to. */
+    socklen_t address_len;                /**< Length of address, 0 until resolved. */
+    struct gaicb* resolve;                /**< Resolution of host running in the background, or NULL. */
+    int fd;                               /**< Socket of the scrape in progress, or -1. */
+    GatewayState state;                   /**< Progress of the current scrape. */
+    size_t sent;                          /**< Bytes of request sent. */
+    char* response;                       /**< Response read, kept across scrapes. */
+    size_t len;                           /**< Bytes of response read. */
+    size_t capacity;                      /**< Allocated bytes of response. */
+    double duration;                      /**< Duration of the last scrape in seconds. */
+    bool up;                              /**< Whether the last scrape was merged. */
+} GatewayTarget;
+
+/**
+ * @brief Structure to hold the series of an aggregate family that share their labels but instance.
+ */
+typedef struct
+{
+    char** values; /**< Label values, one per label key of the family. */
+    double sum;    /**< Sum of the series in the current pass. */
+    double max;    /**< Maximum of the series in the current pass. */
+    uint64_t pass; /**< Last pass a series contributed to the entry. */
+} GatewayAggregate;
+
+/**
+ * @brief Structure to hold a merged family.
+ *
+ * Families stay registered until gateway_close, which destroys their metrics before the names and help texts they
+ * point at.
+ */
+typedef struct
+{
+    char* name;                                         /**< Name of the family. */
+    char* help;                                         /**< Help text of the family. */
+    bool counter;                                       /**< Whether the family is a counter rather than a gauge. */
+    bool usable;                                        /**< Whether the family is registered and merged. */
+    size_t label_count;                                 /**< Number of label keys, instance excluded. */
+    char** label_keys;                                  /**< Label keys of the downstream series, in their order. */
+    prom_metric_t* metric;                              /**< Merged series, labelled with label_keys and instance. */
+    char* aggregate_names[GATEWAY_AGGREGATE_COUNT];     /**< Names of the aggregate families, or NULL. */
+    prom_metric_t* aggregates[GATEWAY_AGGREGATE_COUNT]; /**< Aggregate families, indexed by GatewayAggregateKind. */
+    GatewayAggregate* entries;                          /**< Series of the aggregate families. */
+    size_t entry_count;                                 /**< Number of valid entries in entries. */
+    size_t entry_capacity;                              /**< Number of allocated entries in entries. */
+} GatewayFamily;
+
+/**
+ * @brief Structure to hold the gateway.
+ */
+typedef struct
+{
+    GatewayTarget* targets;                  /**< The targets, in the order they are configured. */
+    size_t target_count;                     /**< Number of entries in targets. */
+    int epoll_fd;                            /**< Epoll instance driving the scrapes. */
+    GatewayFamily* families;                 /**< Families merged so far, in the order they were first listed. */
+    size_t family_count;                     /**< Number of valid entries in families. */
+    size_t family_capacity;                  /**< Number of allocated entries in families. */
+    bool aggregate[GATEWAY_AGGREGATE_COUNT]; /**< Whether each aggregate is kept. */
+    uint64_t pass;                           /**< Current scrape pass. */
+    char* scratch;                           /**< Label values of the series being merged, NUL-terminated. */
+    size_t scratch_capacity;                 /**< Allocated bytes of scratch. */
+    prom_gauge_t* up_metric;                 /**< Whether each target answered the last scrape. */
+    prom_gauge_t* duration_metric;           /**< Duration of the last scrape of each target. */
+} Gateway;
+
+/**
+ * @brief Parses the targets and the aggregates to keep, and registers the gateway metrics.
+ *
+ * @param gateway The gateway to initialize.
+ * @param targets Comma-separated host[:port] of the targets; an IPv6 address is written in brackets.
+ * @param aggregate "sum", "max", "sum,max", or NULL for no aggregates.
+ * @return 0 on success, or -1 in case of error.
+ */
+int gateway_open(Gateway* gateway, const char* targets, const char* aggregate);
+
+/**
+ * @brief Scrapes every target concurrently and merges the series of those that answered.
+ *
+ * Only one thread may scrape at a time.
+ *
+ * @param gateway The gateway.
+ * @return 0 on success, or -1 if the scrape could not be started; a target that is down is not an error.
+ */
+int gateway_scrape(Gateway* gateway);
+
+/**
+ * @brief Closes the scrapes in progress, unregisters every metric of the gateway and frees the targets and families.
+ *
+ * @param gateway The gateway.
+ */
+void gateway_close(Gateway* gateway);
+
+#endif // GATEWAY_H
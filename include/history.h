@@ -0,0 +1,166 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+/**
+ * @file history.h
+ * @brief Header file for the local history of every series, kept in a memory-mapped ring of compressed segments.
+ *
+ * When the Prometheus server is down or cannot be reached, its scrapes are lost. The history keeps the samples on the
+ * local disk, within a fixed budget, so that gaps can be backfilled and short-range queries answered locally.
+ *
+ * The history is a single file of HISTORY_SEGMENT_SIZE segments, mapped shared so that the page cache writes it back.
+ * Each segment belongs to one series and holds two columns that grow towards each other: the timestamps from the
+ * front, as delta-of-delta codes, and the values from the back, XORed with the previous value as in Gorilla. A series
+ * fills one segment at a time; when it is full, the next segment of the ring is taken, which overwrites the oldest
+ * samples of whichever series owned it. Disk usage is the size of the file, and memory is its page cache plus the
+ * encoder state of every series.
+ *
+ * Timestamps are CLOCK_REALTIME milliseconds. Integer series are recorded as doubles, which are exact up to 2^53.
+ * Segments left by a previous run are read but never appended to.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_DIR_ENV "MONITOR_HISTORY_DIR"      /**< Directory of the history file; unset for no history. */
+#define HISTORY_SIZE_ENV "MONITOR_HISTORY_SIZE_MB" /**< Size of the history file in MiB. */
+#define HISTORY_FILE_NAME "history.ring"           /**< Name of the history file in its directory. */
+#define HISTORY_DEFAULT_SIZE_MB 64                 /**< Size of the history file unless HISTORY_SIZE_ENV is set. */
+#define HISTORY_MIN_SEGMENTS 16                    /**< Fewest segments of a history file. */
+#define HISTORY_SEGMENT_SIZE 4096                  /**< Bytes of a segment, including its header. */
+#define HISTORY_SERIES_SIZE 240                    /**< Bytes of a series name, including its terminating NUL. */
+#define HISTORY_INTERVAL_MS 5000                   /**< Interval at which every series is recorded. */
+#define HISTORY_MAGIC 0x4d4f4e48u                  /**< "MONH", the first four bytes of the file. */
+#define HISTORY_SEGMENT_MAGIC 0x4d4f4e47u          /**< Marks a segment holding samples. */
+#define HISTORY_VERSION 1                          /**< Version of the layout; other versions are discarded. */
+#define HISTORY_INITIAL_SLOTS 1024                 /**< Initial number of series slots, must be a power of two. */
+#define HISTORY_MAX_LOAD 0.5                       /**< Maximum fraction of used series slots before they grow. */
+
+/**
+ * @brief Structure to hold the header at the start of the history file, in a segment of its own.
+ */
+typedef struct
+{
+    uint32_t magic;         /**< HISTORY_MAGIC, written once the file is initialized. */
+    uint32_t version;       /**< HISTORY_VERSION. */
+    uint32_t segment_size;  /**< HISTORY_SEGMENT_SIZE. */
+    uint32_t segment_count; /**< Number of segments after the header. */
+    uint32_t next_segment;  /**< Segment the ring takes next. */
+    uint32_t reserved;      /**< Zero. */
+} HistoryFileHeader;
+
+/**
+ * @brief Structure to hold the header of a segment, followed by its two columns.
+ */
+typedef struct
+{
+    uint32_t magic;                      /**< HISTORY_SEGMENT_MAGIC once the segment holds samples, else 0. */
+    uint32_t count;                      /**< Number of samples. */
+    uint64_t sequence;                   /**< Order in which the segment was taken, across runs. */
+    int64_t first_ms;                    /**< Timestamp of the first sample. */
+    int64_t last_ms;                     /**< Timestamp of the last sample. */
+    uint32_t time_bits;                  /**< Bits used by the timestamp column, from the front. */
+    uint32_t value_bits;                 /**< Bits used by the value column, from the back. */
+    char series[HISTORY_SERIES_SIZE];    /**< Series as in the text exposition, NUL terminated, maybe truncated. */
+    uint8_t data[];                      /**< The two columns. */
+} HistorySegment;
+
+/**
+ * @brief Structure to hold the encoder state of one series.
+ */
+typedef struct
+{
+    char* name;               /**< Series as in the text exposition. */
+    uint64_t hash;            /**< Hash of name. */
+    HistorySegment* segment;  /**< Segment being filled, or NULL. */
+    uint64_t sequence;        /**< Sequence of segment when it was taken; the ring reclaimed it once it differs. */
+    int64_t prev_ms;          /**< Timestamp of the last sample. */
+    int64_t prev_delta;       /**< Difference between the last two timestamps. */
+    uint64_t prev_bits;       /**< Bits of the last value. */
+    uint8_t leading;          /**< Leading zero bits of the last XOR window. */
+    uint8_t trailing;         /**< Trailing zero bits of the last XOR window. */
+    double pending;           /**< Value read by the current snapshot. */
+    uint64_t pending_pass;    /**< Snapshot pass pending was read by. */
+} HistorySeries;
+
+/**
+ * @brief Structure to hold the history.
+ */
+typedef struct
+{
+    int fd;                      /**< Descriptor of the history file, or -1. */
+    HistoryFileHeader* header;   /**< Mapping of the whole file. */
+    size_t mapped_size;          /**< Size of the mapping in bytes. */
+    uint64_t next_sequence;      /**< Sequence of the next segment taken. */
+    HistorySeries** slots;       /**< Open-addressing index of the series with linear probing. */
+    size_t slot_count;           /**< Number of slots, always a power of two. */
+    HistorySeries** series;      /**< Every series, in the order they appeared. */
+    size_t series_count;         /**< Number of entries in series. */
+    size_t series_capacity;      /**< Allocated entries in series. */
+    uint64_t pass;               /**< Current snapshot pass. */
+    pthread_mutex_t mutex;       /**< Guards the segments against concurrent readers. */
+} History;
+
+/**
+ * @brief Callback receiving the samples of a range read, in time order.
+ */
+typedef void (*history_point_fn)(int64_t timestamp_ms, double value, void* arg);
+
+/**
+ * @brief Opens the history file in a directory, creating it or discarding it if its layout differs.
+ *
+ * @param history The history to initialize.
+ * @param directory Directory of the history file.
+ * @param size Size of the history file in bytes.
+ * @return 0 on success, or -1 in case of error.
+ */
+int history_open(History* history, const char* directory, size_t size);
+
+/**
+ * @brief Appends the current value of every series of the default registry, timestamped now.
+ *
+ * Only one thread may record at a time.
+ *
+ * @param history The history.
+ * @return 0 on success, or -1 in case of error.
+ */
+int history_record(History* history);
+
+/**
+ * @brief Reads the samples of a series within a time range.
+ *
+ * @param history The history.
+ * @param series The series, as in the text exposition.
+ * @param from_ms Timestamp of the first sample to read.
+ * @param to_ms Timestamp of the last sample to read.
+ * @param fn Callback receiving every sample in range, in time order.
+ * @param arg Argument passed to fn.
+ * @return Number of samples read.
+ */
+size_t history_read(History* history, const char* series, int64_t from_ms, int64_t to_ms, history_point_fn fn,
+                    void* arg);
+
+/**
+ * @brief Serves range reads of the history as /history on the HTTP daemon, which must not be started yet.
+ *
+ * /history?series=<series>&start=<seconds>&end=<seconds> returns {"series", "values": [[<seconds>, "<value>"], ...]}
+ * like a Prometheus range query. end defaults to now and start to an hour before end.
+ *
+ * @param history The history.
+ * @return 0 on success, or -1 in case of error.
+ */
+int history_add_endpoint(History* history);
+
+/**
+ * @brief Unmaps and closes the history file, and frees the series.
+ *
+ * @param history The history.
+ */
+void history_close(History* history);
+
+#endif // HISTORY_H
@@ -0,0 +1,128 @@
+#ifndef HWMON_H
+#define HWMON_H
+
+/**
+ * @file hwmon.h
+ * @brief Header file for discovering the hwmon sensors and reading them through persistent file descriptors.
+ *
+ * The hwmonN indices are assigned in probe order and change between boots, so sensors are never addressed by path.
+ * A discovery pass walks every chip under /sys/class/hwmon once, opens each temperature, fan, voltage, current and
+ * power input, and keeps the descriptors in a compact sensor table. A regular read is then a single pass of pread()
+ * calls over that table. The pass is repeated only when a kernel uevent reports a hwmon device being added or
+ * removed, or when a descriptor goes stale.
+ *
+ * Sensors are labelled by the chip, named after the device it belongs to so that the label survives renumbering, and
+ * by the sensor attribute and its human-readable label.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <prom.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define HWMON_ROOT_PATH "/sys/class/hwmon" /**< Directory listing the hwmon chips. */
+#define HWMON_NAME_SIZE 64                 /**< Buffer size of chip and sensor names. */
+#define HWMON_VALUE_SIZE 32                /**< Bytes read from a sensor input. */
+#define HWMON_UEVENT_BUFFER 4096           /**< Receive buffer size of a kernel uevent. */
+
+/**
+ * @brief Kind of a hwmon sensor, named after the prefix of its sysfs attributes.
+ */
+typedef enum
+{
+    HWMON_TEMP,      /**< Temperature, reported in millidegrees Celsius. */
+    HWMON_FAN,       /**< Fan speed, reported in RPM. */
+    HWMON_IN,        /**< Voltage, reported in millivolts. */
+    HWMON_CURR,      /**< Current, reported in milliamperes. */
+    HWMON_POWER,     /**< Power, reported in microwatts. */
+    HWMON_KIND_COUNT /**< Number of sensor kinds. */
+} HwmonKind;
+
+/**
+ * @brief Sensors standing in for the fixed hwmon paths the single-value gauges used to read.
+ */
+typedef enum
+{
+    HWMON_ROLE_CPU_TEMP,        /**< First temperature of a CPU package sensor. */
+    HWMON_ROLE_BATTERY_VOLTAGE, /**< First voltage of a battery. */
+    HWMON_ROLE_BATTERY_CURRENT, /**< First current of a battery. */
+    HWMON_ROLE_CPU_FAN,         /**< First fan of the first chip with fans. */
+    HWMON_ROLE_GPU_FAN,         /**< First fan of a GPU, or the second fan of the CPU fan chip. */
+    HWMON_ROLE_COUNT            /**< Number of roles. */
+} HwmonRole;
+
+/**
+ * @brief Structure to hold one sensor input.
+ */
+typedef struct
+{
+    HwmonKind kind;               /**< Kind of the sensor. */
+    int fd;                       /**< Descriptor of the input attribute. */
+    char chip[HWMON_NAME_SIZE];   /**< Device the chip belongs to, or the chip name if it has no device. */
+    char name[HWMON_NAME_SIZE];   /**< Chip name, as reported by its name attribute. */
+    char sensor[HWMON_NAME_SIZE]; /**< Attribute prefix, such as temp1. */
+    char label[HWMON_NAME_SIZE];  /**< Contents of the label attribute, or the attribute prefix. */
+    double value;                 /**< Last value read, in the base unit of the kind. */
+    bool valid;                   /**< Whether value holds a reading. */
+    prom_metric_sample_t* sample; /**< Sample handle, owned by the caller and reset by every discovery pass. */
+} HwmonSensor;
+
+/**
+ * @brief Callback invoked when a discovery pass no longer finds a sensor that has a sample; its series must be dropped.
+ */
+typedef void (*hwmon_release_fn)(const HwmonSensor* sensor);
+
+/**
+ * @brief Structure to hold the sensor table.
+ */
+typedef struct
+{
+    const char* root;            /**< Directory the chips are discovered in. */
+    HwmonSensor* sensors;        /**< Discovered sensors. */
+    size_t sensor_count;         /**< Number of valid entries in sensors. */
+    size_t sensor_capacity;      /**< Number of allocated entries in sensors. */
+    int roles[HWMON_ROLE_COUNT]; /**< Index of the sensor filling each role, or -1. */
+    int uevent_fd;               /**< Kernel uevent socket, or -1 if uevents are unavailable. */
+    bool rescan;                 /**< Whether the next read must run a discovery pass first. */
+    hwmon_release_fn release;    /**< Called for the sensors a discovery pass no longer finds. */
+} HwmonTable;
+
+/**
+ * @brief Initializes a sensor table; the first read runs the discovery pass.
+ *
+ * @param table The table to initialize.
+ * @param root Directory listing the chips, normally HWMON_ROOT_PATH. The pointer is stored.
+ * @param release Callback invoked for the sensors a discovery pass no longer finds, may be NULL.
+ */
+void hwmon_table_init(HwmonTable* table, const char* root, hwmon_release_fn release);
+
+/**
+ * @brief Reads every sensor of the table.
+ *
+ * Pending uevents are drained first; a discovery pass runs if one of them concerns hwmon or a descriptor went stale
+ * on the previous read.
+ *
+ * @param table The table.
+ * @return 1 if a discovery pass ran, so that sample handles must be resolved again, 0 if not, or -1 in case of error.
+ */
+int hwmon_table_read(HwmonTable* table);
+
+/**
+ * @brief Returns the sensor filling a role.
+ *
+ * @param table The table.
+ * @param role The role.
+ * @return The sensor, or NULL if no sensor fills the role.
+ */
+const HwmonSensor* hwmon_table_role(const HwmonTable* table, HwmonRole role);
+
+/**
+ * @brief Closes every descriptor of the table and releases it.
+ *
+ * @param table The table.
+ */
+void hwmon_table_free(HwmonTable* table);
+
+#endif // HWMON_H
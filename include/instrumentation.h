@@ -0,0 +1,56 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+/**
+ * @file instrumentation.h
+ * @brief Header file for the histograms the monitor keeps about itself.
+ *
+ * Every collector run is observed in monitor_collector_duration_seconds{collector=...}, and every full /metrics scrape
+ * in monitor_scrape_render_seconds, monitor_scrape_send_seconds, monitor_scrape_bytes and
+ * monitor_scrape_allocations; scrapes whose client went away before the body was sent are counted in
+ * monitor_scrape_aborted_total. Missed collector deadlines stay in collector_timeout_total.
+ *
+ * The histograms are sharded and every series is resolved when the instrumentation starts, so an observation only
+ * bumps per-CPU counters: it neither allocates nor formats labels, and never waits on the scrape it measures.
+ *
+ * With INSTRUMENTATION_NATIVE_ENV set to 1 the histograms are native instead: each series keeps only its populated
+ * exponential buckets, at a far finer resolution, and exposes them in the protobuf format; the text formats only show
+ * their count and sum. An observation then takes a short lock of its series.
+ *
+ * @date 15/10/2026
+ * @author 1v6n
+ */
+
+#include <prom.h>
+#include <stdint.h>
+
+#define INSTRUMENTATION_NATIVE_ENV "MONITOR_NATIVE_HISTOGRAMS" /**< 1 to keep native histograms. */
+#define INSTRUMENTATION_NATIVE_SCHEMA 3                          /**< Initial schema, buckets about 9% wide. */
+#define INSTRUMENTATION_LATENCY_START 0.0001 /**< Upper bound of the first latency bucket, in seconds. */
+#define INSTRUMENTATION_LATENCY_FACTOR 2.0   /**< Ratio between two latency buckets. */
+#define INSTRUMENTATION_LATENCY_BUCKETS 16   /**< Number of latency buckets, up to about 3 s. */
+#define INSTRUMENTATION_BYTES_START 1024.0   /**< Upper bound of the first size bucket, in bytes. */
+#define INSTRUMENTATION_BYTES_FACTOR 4.0     /**< Ratio between two size buckets. */
+#define INSTRUMENTATION_BYTES_BUCKETS 10     /**< Number of size buckets, up to 256 MiB. */
+#define INSTRUMENTATION_ALLOCS_START 1.0     /**< Upper bound of the first allocation bucket. */
+#define INSTRUMENTATION_ALLOCS_FACTOR 4.0    /**< Ratio between two allocation buckets. */
+#define INSTRUMENTATION_ALLOCS_BUCKETS 12    /**< Number of allocation buckets, up to about 4M. */
+
+/**
+ * @brief Creates and registers the instrumentation histograms and installs the scrape observer.
+ *
+ * Must be called once the registry is initialized and before the HTTP daemon starts.
+ *
+ * @return 0 on success, or -1 in case of error, in which case nothing is observed.
+ */
+int instrumentation_init(void);
+
+/**
+ * @brief Observes one run of a collector in monitor_collector_duration_seconds.
+ *
+ * @param update_function The collector that ran; runs of collectors missing from all_collectors are ignored.
+ * @param duration_ns Time the run took, in nanoseconds.
+ */
+void instrumentation_record_collector(void (*update_function)(void), uint64_t duration_ns);
+
+#endif // INSTRUMENTATION_H
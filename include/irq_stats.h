@@ -0,0 +1,146 @@
+#ifndef IRQ_STATS_H
+#define IRQ_STATS_H
+
+/**
+ * @file irq_stats.h
+ * @brief Header file for reading the per-CPU interrupt and softirq counts and the paging counters of /proc/vmstat.
+ *
+ * /proc/interrupts and /proc/softirqs are matrices: a header naming the online CPUs, then one line per interrupt
+ * source with a count for every CPU. A large host has hundreds of MSI-X vectors and hundreds of CPUs, so both are
+ * read once per collection through the source cache and parsed with the shared procfs parser into one dense array per
+ * file, indexed by line and CPU, that is kept across reads along with the sample handles of every count.
+ *
+ * Lines are matched across reads by name and device, so that a vector that moved to another driver starts over. A
+ * read can keep only the lines with the most interrupts since boot; the caller decides which lines it exports from
+ * the selection and must drop the series of a line it no longer exports. Lines that are no longer listed nor
+ * exported are dropped on the next read. CPUs that go offline leave the header, and their counts keep their last
+ * value.
+ *
+ * @date 15/10/2026
+ * @author 1v6n
+ */
+
+#include <prom.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define INTERRUPTS_PATH "/proc/interrupts" /**< Path to the per-CPU interrupt counts. */
+#define SOFTIRQS_PATH "/proc/softirqs"     /**< Path to the per-CPU softirq counts. */
+#define VMSTAT_PATH "/proc/vmstat"         /**< Path to the virtual memory counters. */
+#define IRQ_NAME_SIZE 16                   /**< Buffer size of the name of a line. */
+#define IRQ_DEVICE_SIZE 64                 /**< Buffer size of the device of a line. */
+#define IRQ_LABEL_SIZE 21                  /**< Buffer size of a CPU label. */
+#define IRQ_TOP_ENV "MONITOR_IRQ_TOP"      /**< Interrupt lines exported, the busiest first; 0 for every line. */
+#define IRQ_TOP_DEFAULT 20                 /**< Interrupt lines exported unless IRQ_TOP_ENV is set. */
+
+/**
+ * @brief Structure to hold one line of a matrix.
+ */
+typedef struct
+{
+    char name[IRQ_NAME_SIZE];     /**< IRQ number or name of the line, without the colon. */
+    char device[IRQ_DEVICE_SIZE]; /**< Handlers of the line or its description, empty for softirqs. */
+    uint64_t total;               /**< Sum of the counts of every CPU as of the last read. */
+    bool seen;                    /**< Whether the last read listed the line. */
+    bool selected;                /**< Whether the line is among those kept by the last read. */
+    bool reported;                /**< Whether the caller exports the line; kept by the caller. */
+} IrqLine;
+
+/**
+ * @brief Structure to hold the counts of every line of /proc/interrupts or /proc/softirqs on every CPU.
+ *
+ * The caller keeps one matrix per file across reads, so that the buffers are reused and the sample handles survive.
+ * It starts zeroed but for the path.
+ */
+typedef struct
+{
+    const char* path;                   /**< File the matrix is read from. */
+    IrqLine* lines;                     /**< Lines, in the order they were first listed. */
+    size_t line_count;                  /**< Number of valid entries in lines. */
+    size_t line_capacity;               /**< Number of allocated entries in lines and rows of counts and samples. */
+    size_t cpu_slots;                   /**< Length of a row: one past the highest CPU listed so far. */
+    char (*cpu_labels)[IRQ_LABEL_SIZE]; /**< Number of every CPU slot, as a label value. */
+    uint64_t* counts;                   /**< Count of every line on every CPU, a row of cpu_slots per line. */
+    prom_metric_sample_t** samples;     /**< Sample handle of every count, owned by the caller. */
+    int* columns;                       /**< CPU of every column of the last read. */
+    size_t column_count;                /**< Number of valid entries in columns. */
+    size_t column_capacity;             /**< Number of allocated entries in columns and values. */
+    uint64_t* values;                   /**< Counts of the line being parsed, one per column. */
+    uint64_t* ranks;                    /**< Totals of the lines listed, sorted to select the busiest. */
+    bool unavailable;                   /**< Set once the file turned out to be missing. */
+} IrqMatrix;
+
+/**
+ * @brief Counters of /proc/vmstat that are exported.
+ */
+typedef enum
+{
+    VMSTAT_PGFAULT,     /**< Page faults. */
+    VMSTAT_PGMAJFAULT,  /**< Page faults that needed I/O. */
+    VMSTAT_PSWPIN,      /**< Pages swapped in. */
+    VMSTAT_PSWPOUT,     /**< Pages swapped out. */
+    VMSTAT_OOM_KILL,    /**< Processes killed by the OOM killer. */
+    VMSTAT_FIELD_COUNT, /**< Number of counters. */
+} VmstatField;
+
+/**
+ * @brief Structure to hold the exported counters of /proc/vmstat.
+ */
+typedef struct
+{
+    unsigned long long values[VMSTAT_FIELD_COUNT]; /**< Counters, indexed by VmstatField. */
+    bool present[VMSTAT_FIELD_COUNT];              /**< Whether the kernel lists each counter. */
+} VmstatSnapshot;
+
+/**
+ * @brief Reads a matrix file into a matrix and selects its busiest lines.
+ *
+ * @param matrix The matrix.
+ * @param top Number of lines with the most interrupts since boot to select, or 0 to select every line listed.
+ * @return 0 on success, or -1 if the file is missing, cannot be read or has an unknown format.
+ */
+int irq_matrix_read(IrqMatrix* matrix, size_t top);
+
+/**
+ * @brief Returns the count of a line on a CPU slot as of the last read.
+ *
+ * @param matrix The matrix.
+ * @param line Index of the line.
+ * @param cpu The CPU slot.
+ * @return The count.
+ */
+static inline uint64_t irq_matrix_count(const IrqMatrix* matrix, size_t line, size_t cpu)
+{
+    return matrix->counts[line * matrix->cpu_slots + cpu];
+}
+
+/**
+ * @brief Returns the sample handle of a line on a CPU slot.
+ *
+ * @param matrix The matrix.
+ * @param line Index of the line.
+ * @param cpu The CPU slot.
+ * @return Pointer to the handle, which is NULL until the caller sets it.
+ */
+static inline prom_metric_sample_t** irq_matrix_sample(IrqMatrix* matrix, size_t line, size_t cpu)
+{
+    return &matrix->samples[line * matrix->cpu_slots + cpu];
+}
+
+/**
+ * @brief Releases the buffers of a matrix, keeping its path.
+ *
+ * @param matrix The matrix.
+ */
+void irq_matrix_free(IrqMatrix* matrix);
+
+/**
+ * @brief Reads the exported counters of /proc/vmstat into a snapshot.
+ *
+ * @param snapshot The snapshot.
+ * @return 0 on success, or -1 if the file cannot be read.
+ */
+int read_vmstat_snapshot(VmstatSnapshot* snapshot);
+
+#endif // IRQ_STATS_H
@@ -0,0 +1,43 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+/**
+ * @file json_writer.h
+ * @brief Header file for writing JSON bodies into a fixed buffer, as the HTTP endpoints render them.
+ *
+ * Like snprintf, the writer keeps counting once the buffer is full, so the caller learns the length the whole body
+ * needs and can render it again into a buffer that fits.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <stddef.h>
+
+/**
+ * @brief Structure to hold a JSON body being written into a fixed buffer, snprintf style.
+ */
+typedef struct
+{
+    char* buf;   /**< Buffer receiving the body. */
+    size_t size; /**< Size of buf in bytes. */
+    size_t len;  /**< Length of the whole body so far, which may exceed size. */
+} JsonWriter;
+
+/**
+ * @brief Appends formatted text to a JSON body.
+ *
+ * @param writer The writer.
+ * @param format printf format of the text, which is not escaped.
+ */
+void json_append(JsonWriter* writer, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Appends a JSON string, escaping quotes, backslashes and control characters.
+ *
+ * @param writer The writer.
+ * @param value The string, without quotes.
+ */
+void json_string(JsonWriter* writer, const char* value);
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,197 @@
+#ifndef METRIC_CATALOG_H
+#define METRIC_CATALOG_H
+
+/**
+ * @file metric_catalog.h
+ * @brief Definition of every metric the monitor can export, expanded by expose_metrics.c into the variables holding
+ * the metrics and into all_metrics.
+ *
+ * Every METRIC entry gives, in this order: the variable holding the metric, its name, its type (GAUGE, COUNTER for
+ * integer counts or FLOAT_COUNTER for cumulative times in seconds), the collector updating it, its interval in
+ * milliseconds (0 for DEFAULT_INTERVAL_MS), its number of labels, their keys (NULL without labels), its one-minute
+ * rollup (NULL for none), its per-second rate (NULL for none) and its help text.
+ * The label keys, rollups, rates and intervals are those declared in expose_metrics.c.
+ *
+ * The entries are sorted by name, which lets lookups search all_metrics directly. Names and help texts are string
+ * literals without characters to escape, so that the "# HELP" and "# TYPE" lines of every metric are built by the
+ * compiler.
+ *
+ * @date 15/10/2026
+ * @author 1v6n
+ */
+
+#define METRIC_CATALOG(METRIC)                                                                                         \
+    METRIC(available_memory_metric, "available_memory_mb", GAUGE, update_memory_metrics, 0, 0, NULL, NULL, NULL,       \
+           "Available memory in MB")                                                                                   \
+    METRIC(battery_current_metric, "battery_current_amperes", GAUGE, update_hwmon_metrics, 0, 0, NULL, NULL, NULL,     \
+           "Battery current in amperes")                                                                               \
+    METRIC(battery_voltage_metric, "battery_voltage_volts", GAUGE, update_hwmon_metrics, 0, 0, NULL, NULL, NULL,       \
+           "Battery voltage in volts")                                                                                 \
+    METRIC(blocked_processes_metric, "blocked_processes", GAUGE, update_process_states_gauge, PROCESS_INTERVAL_MS, 0,  \
+           NULL, NULL, NULL, "Blocked processes")                                                                      \
+    METRIC(cgroup_throttled_metric, "cgroup_cpu_throttled_seconds_total", FLOAT_COUNTER, update_cgroup_metrics, 0, 1,  \
+           cgroup_label_keys, NULL, NULL, "Time each cgroup was throttled by the CPU controller in seconds")           \
+    METRIC(cgroup_cpu_metric, "cgroup_cpu_usage_seconds_total", FLOAT_COUNTER, update_cgroup_metrics, 0, 1,            \
+           cgroup_label_keys, NULL, NULL, "CPU time of each cgroup in seconds")                                        \
+    METRIC(cgroup_io_read_metric, "cgroup_io_read_bytes_total", COUNTER, update_cgroup_metrics, 0, 1,                  \
+           cgroup_label_keys, NULL, NULL, "Bytes read by each cgroup from every device")                               \
+    METRIC(cgroup_io_write_metric, "cgroup_io_write_bytes_total", COUNTER, update_cgroup_metrics, 0, 1,                \
+           cgroup_label_keys, NULL, NULL, "Bytes written by each cgroup to every device")                              \
+    METRIC(cgroup_anon_metric, "cgroup_memory_anon_bytes", GAUGE, update_cgroup_metrics, 0, 1, cgroup_label_keys,      \
+           NULL, NULL, "Anonymous memory of each cgroup in bytes")                                                     \
+    METRIC(cgroup_memory_metric, "cgroup_memory_current_bytes", GAUGE, update_cgroup_metrics, 0, 1,                    \
+           cgroup_label_keys, NULL, NULL, "Memory charged to each cgroup in bytes")                                    \
+    METRIC(cgroup_file_metric, "cgroup_memory_file_bytes", GAUGE, update_cgroup_metrics, 0, 1, cgroup_label_keys,      \
+           NULL, NULL, "Page cache of each cgroup in bytes")                                                           \
+    METRIC(context_switches_metric, "context_switches", COUNTER, update_proc_stat_metrics, 0, 0, NULL, NULL,           \
+           &context_switches_rate, "Context switches")                                                                 \
+    METRIC(perf_branch_metric, "cpu_branch_misses_per_kilo_instructions", GAUGE, update_perf_metrics, 0, 1,            \
+           cpu_label_keys, NULL, NULL, "Branch misses per thousand instructions on each CPU")                          \
+    METRIC(core_freq_metric, "cpu_core_frequency_megahertz", GAUGE, update_cpu_frequency, 0, 1, cpu_label_keys, NULL,  \
+           NULL, "Frequency of each CPU in MHz")                                                                       \
+    METRIC(cpu_core_usage_metric, "cpu_core_usage_percentage", GAUGE, update_proc_stat_metrics, 0, 2,                  \
+           cpu_core_label_keys, &cpu_core_usage_rollup, NULL, "CPU usage of each core per mode in percentage")         \
+    METRIC(cpu_fan_speed_metric, "cpu_fan_speed_rpm", GAUGE, update_hwmon_metrics, 0, 0, NULL, NULL, NULL,             \
+           "CPU fan speed in RPM")                                                                                     \
+    METRIC(cpu_frequency_metric, "cpu_frequency_megahertz", GAUGE, update_cpu_frequency, 0, 0, NULL, NULL, NULL,       \
+           "CPU frequency in MHz")                                                                                     \
+    METRIC(perf_ipc_metric, "cpu_instructions_per_cycle", GAUGE, update_perf_metrics, 0, 1, cpu_label_keys, NULL,      \
+           NULL, "Instructions retired per cycle on each CPU")                                                         \
+    METRIC(perf_cache_metric, "cpu_llc_misses_per_kilo_instructions", GAUGE, update_perf_metrics, 0, 1,                \
+           cpu_label_keys, NULL, NULL, "Last-level cache misses per thousand instructions on each CPU")                \
+    METRIC(sched_run_metric, "cpu_run_seconds_total", FLOAT_COUNTER, update_schedstat_metrics, 0, 1, cpu_label_keys,   \
+           NULL, NULL, "Time each CPU spent running tasks in seconds")                                                 \
+    METRIC(sched_wait_metric, "cpu_runqueue_wait_seconds_total", FLOAT_COUNTER, update_schedstat_metrics, 0, 1,        \
+           cpu_label_keys, NULL, NULL, "Time runnable tasks waited on the run queue of each CPU in seconds")           \
+    METRIC(cpu_temp_metric, "cpu_temperature_celsius", GAUGE, update_hwmon_metrics, 0, 0, NULL, NULL, NULL,            \
+           "CPU temperature in Celsius")                                                                               \
+    METRIC(sched_slices_metric, "cpu_timeslices_total", COUNTER, update_schedstat_metrics, 0, 1, cpu_label_keys, NULL, \
+           NULL, "Timeslices run on each CPU")                                                                         \
+    METRIC(cpu_usage_metric, "cpu_usage_percentage", GAUGE, update_proc_stat_metrics, 0, 0, NULL, &cpu_usage_rollup,   \
+           NULL, "CPU usage in percentage")                                                                            \
+    METRIC(disk_await_metric, "disk_await_milliseconds", GAUGE, update_disk_device_metrics, 0, 1, disk_label_keys,     \
+           NULL, NULL, "Average time of the completed requests per disk")                                              \
+    METRIC(disk_read_bytes_metric, "disk_read_bytes_per_second", GAUGE, update_disk_device_metrics, 0, 1,              \
+           disk_label_keys, NULL, NULL, "Bytes read per second per disk")                                              \
+    METRIC(disk_reads_metric, "disk_reads_per_second", GAUGE, update_disk_device_metrics, 0, 1, disk_label_keys,       \
+           NULL, NULL, "Reads completed per second per disk")                                                          \
+    METRIC(disk_usage_metric, "disk_usage_percentage", GAUGE, update_disk_gauge, DISK_USAGE_INTERVAL_MS, 0, NULL,      \
+           NULL, NULL, "Disk usage in percentage")                                                                     \
+    METRIC(disk_utilization_metric, "disk_utilization_percentage", GAUGE, update_disk_device_metrics, 0, 1,            \
+           disk_label_keys, &disk_utilization_rollup, NULL, "Share of time with I/O in flight per disk")               \
+    METRIC(disk_write_bytes_metric, "disk_write_bytes_per_second", GAUGE, update_disk_device_metrics, 0, 1,            \
+           disk_label_keys, NULL, NULL, "Bytes written per second per disk")                                           \
+    METRIC(disk_writes_metric, "disk_writes_per_second", GAUGE, update_disk_device_metrics, 0, 1, disk_label_keys,     \
+           NULL, NULL, "Writes completed per second per disk")                                                         \
+    METRIC(dropped_packets_metric, "dropped_packets_total", COUNTER, update_network_traffic_metric, 0, 0, NULL, NULL,  \
+           NULL, "Total dropped packets")                                                                              \
+    METRIC(fs_avail_metric, "filesystem_avail_bytes", GAUGE, update_filesystem_metrics, DISK_USAGE_INTERVAL_MS, 3,     \
+           fs_label_keys, NULL, NULL, "Bytes available to unprivileged users per file system")                         \
+    METRIC(fs_files_metric, "filesystem_files", GAUGE, update_filesystem_metrics, DISK_USAGE_INTERVAL_MS, 3,           \
+           fs_label_keys, NULL, NULL, "Inodes of each file system")                                                    \
+    METRIC(fs_files_free_metric, "filesystem_files_free", GAUGE, update_filesystem_metrics, DISK_USAGE_INTERVAL_MS,    \
+           3, fs_label_keys, NULL, NULL, "Free inodes of each file system")                                            \
+    METRIC(fs_free_metric, "filesystem_free_bytes", GAUGE, update_filesystem_metrics, DISK_USAGE_INTERVAL_MS, 3,       \
+           fs_label_keys, NULL, NULL, "Free bytes of each file system")                                                \
+    METRIC(fs_size_metric, "filesystem_size_bytes", GAUGE, update_filesystem_metrics, DISK_USAGE_INTERVAL_MS, 3,       \
+           fs_label_keys, NULL, NULL, "Size of each file system in bytes")                                             \
+    METRIC(fs_usage_metric, "filesystem_usage_percentage", GAUGE, update_filesystem_metrics, DISK_USAGE_INTERVAL_MS,   \
+           3, fs_label_keys, NULL, NULL, "Usage of each file system in percentage")                                    \
+    METRIC(forks_metric, "forks_total", COUNTER, update_proc_stat_metrics, 0, 0, NULL, NULL, &forks_rate,              \
+           "Total processes created since boot")                                                                       \
+    METRIC(gpu_fan_speed_metric, "gpu_fan_speed_rpm", GAUGE, update_hwmon_metrics, 0, 0, NULL, NULL, NULL,             \
+           "GPU fan speed in RPM")                                                                                     \
+    METRIC(hwmon_current_metric, "hwmon_current_amperes", GAUGE, update_hwmon_metrics, 0, 3, hwmon_label_keys, NULL,   \
+           NULL, "Current of every hwmon sensor in amperes")                                                           \
+    METRIC(hwmon_fan_metric, "hwmon_fan_rpm", GAUGE, update_hwmon_metrics, 0, 3, hwmon_label_keys, NULL, NULL,         \
+           "Speed of every hwmon fan in RPM")                                                                          \
+    METRIC(hwmon_power_metric, "hwmon_power_watts", GAUGE, update_hwmon_metrics, 0, 3, hwmon_label_keys, NULL, NULL,   \
+           "Power of every hwmon sensor in watts")                                                                     \
+    METRIC(hwmon_temp_metric, "hwmon_temperature_celsius", GAUGE, update_hwmon_metrics, 0, 3, hwmon_label_keys, NULL,  \
+           NULL, "Temperature of every hwmon sensor in Celsius")                                                       \
+    METRIC(hwmon_voltage_metric, "hwmon_voltage_volts", GAUGE, update_hwmon_metrics, 0, 3, hwmon_label_keys, NULL,     \
+           NULL, "Voltage of every hwmon sensor in volts")                                                             \
+    METRIC(idle_processes_metric, "idle_processes", GAUGE, update_process_states_gauge, PROCESS_INTERVAL_MS, 0, NULL,  \
+           NULL, NULL, "Idle kernel threads")                                                                          \
+    METRIC(interrupts_metric, "interrupts_total", COUNTER, update_proc_stat_metrics, 0, 0, NULL, NULL,                 \
+           &interrupts_rate, "Total interrupts serviced")                                                              \
+    METRIC(io_time_metric, "io_time_ms", COUNTER, update_disk_stats_metrics, 0, 0, NULL, NULL, NULL,                   \
+           "Time spent on I/O in milliseconds")                                                                        \
+    METRIC(irq_interrupts_metric, "irq_interrupts_total", COUNTER, update_interrupt_metrics, 0, 3, irq_label_keys,     \
+           NULL, NULL, "Interrupts serviced on each CPU per line, for the busiest lines")                              \
+    METRIC(memory_usage_metric, "memory_usage_percentage", GAUGE, update_memory_metrics, 0, 0, NULL,                   \
+           &memory_usage_rollup, NULL, "Memory usage in percentage")                                                   \
+    METRIC(net_rx_bytes_metric, "network_receive_bytes_total", COUNTER, update_network_device_metrics, 0, 1,           \
+           net_dev_label_keys, NULL, &net_rx_bytes_rate, "Bytes received per network device")                          \
+    METRIC(net_rx_dropped_metric, "network_receive_drop_total", COUNTER, update_network_device_metrics, 0, 1,          \
+           net_dev_label_keys, NULL, NULL, "Received packets dropped per network device")                              \
+    METRIC(net_rx_errors_metric, "network_receive_errors_total", COUNTER, update_network_device_metrics, 0, 1,         \
+           net_dev_label_keys, NULL, NULL, "Receive errors per network device")                                        \
+    METRIC(net_rx_packets_metric, "network_receive_packets_total", COUNTER, update_network_device_metrics, 0, 1,       \
+           net_dev_label_keys, NULL, &net_rx_packets_rate, "Packets received per network device")                      \
+    METRIC(net_tx_bytes_metric, "network_transmit_bytes_total", COUNTER, update_network_device_metrics, 0, 1,          \
+           net_dev_label_keys, NULL, &net_tx_bytes_rate, "Bytes transmitted per network device")                       \
+    METRIC(net_tx_dropped_metric, "network_transmit_drop_total", COUNTER, update_network_device_metrics, 0, 1,         \
+           net_dev_label_keys, NULL, NULL, "Transmitted packets dropped per network device")                           \
+    METRIC(net_tx_errors_metric, "network_transmit_errors_total", COUNTER, update_network_device_metrics, 0, 1,        \
+           net_dev_label_keys, NULL, NULL, "Transmit errors per network device")                                       \
+    METRIC(net_tx_packets_metric, "network_transmit_packets_total", COUNTER, update_network_device_metrics, 0, 1,      \
+           net_dev_label_keys, NULL, &net_tx_packets_rate, "Packets transmitted per network device")                   \
+    METRIC(oom_kills_metric, "oom_kills_total", COUNTER, update_vmstat_metrics, 0, 0, NULL, NULL, NULL,                \
+           "Processes killed by the OOM killer")                                                                       \
+    METRIC(page_faults_metric, "page_faults_total", COUNTER, update_vmstat_metrics, 0, 0, NULL, NULL,                  \
+           &page_faults_rate, "Total page faults")                                                                     \
+    METRIC(page_major_faults_metric, "page_major_faults_total", COUNTER, update_vmstat_metrics, 0, 0, NULL, NULL,      \
+           &page_major_faults_rate, "Total page faults that needed I/O")                                               \
+    METRIC(psi_avg_metric, "pressure_stall_percentage", GAUGE, update_psi_metrics, 0, 3, psi_avg_label_keys,           \
+           &psi_avg_rollup, NULL, "Share of time tasks were stalled on a resource, averaged over a window")            \
+    METRIC(psi_total_metric, "pressure_stall_seconds_total", FLOAT_COUNTER, update_psi_metrics, 0, 2,                  \
+           psi_total_label_keys, NULL, NULL, "Total time tasks were stalled on a resource in seconds")                 \
+    METRIC(procs_blocked_metric, "procs_blocked", GAUGE, update_proc_stat_metrics, 0, 0, NULL, NULL, NULL,             \
+           "Processes blocked waiting for I/O")                                                                        \
+    METRIC(reads_completed_metric, "reads_completed_total", COUNTER, update_disk_stats_metrics, 0, 0, NULL, NULL,      \
+           &reads_completed_rate, "Total reads completed")                                                             \
+    METRIC(ready_processes_metric, "ready_processes", GAUGE, update_process_states_gauge, PROCESS_INTERVAL_MS, 0,      \
+           NULL, NULL, NULL, "Ready processes")                                                                        \
+    METRIC(running_processes_metric, "running_processes", GAUGE, update_proc_stat_metrics, 0, 0, NULL, NULL, NULL,     \
+           "Running processes")                                                                                        \
+    METRIC(runqueue_latency_metric, "runqueue_latency_seconds", GAUGE, update_schedstat_metrics, 0, 0, NULL, NULL,     \
+           NULL, "Mean time a task waited on a run queue before running since the last update")                        \
+    METRIC(rx_bytes_metric, "rx_bytes_total", COUNTER, update_network_traffic_metric, 0, 0, NULL, NULL,                \
+           &rx_bytes_rate, "Total received bytes")                                                                     \
+    METRIC(rx_errors_metric, "rx_errors_total", COUNTER, update_network_traffic_metric, 0, 0, NULL, NULL, NULL,        \
+           "Total receive errors")                                                                                     \
+    METRIC(softirqs_metric, "softirqs_total", COUNTER, update_softirq_metrics, 0, 2, softirq_label_keys, NULL, NULL,   \
+           "Softirqs run on each CPU per type")                                                                        \
+    METRIC(stopped_processes_metric, "stopped_processes", GAUGE, update_process_states_gauge, PROCESS_INTERVAL_MS, 0,  \
+           NULL, NULL, NULL, "Stopped processes")                                                                      \
+    METRIC(suspended_processes_metric, "suspended_processes", GAUGE, update_process_states_gauge,                      \
+           PROCESS_INTERVAL_MS, 0, NULL, NULL, NULL, "Suspended processes")                                            \
+    METRIC(swap_in_metric, "swap_in_pages_total", COUNTER, update_vmstat_metrics, 0, 0, NULL, NULL, NULL,              \
+           "Total pages swapped in")                                                                                   \
+    METRIC(swap_out_metric, "swap_out_pages_total", COUNTER, update_vmstat_metrics, 0, 0, NULL, NULL, NULL,            \
+           "Total pages swapped out")                                                                                  \
+    METRIC(top_cpu_process_metric, "top_cpu_process_percentage", GAUGE, update_process_states_gauge,                   \
+           PROCESS_INTERVAL_MS, 1, rank_label_keys, NULL, NULL, "CPU usage of the processes using the most CPU")       \
+    METRIC(top_cpu_pid_metric, "top_cpu_process_pid", GAUGE, update_process_states_gauge, PROCESS_INTERVAL_MS, 1,      \
+           rank_label_keys, NULL, NULL, "PID of the processes using the most CPU")                                     \
+    METRIC(top_rss_process_metric, "top_rss_process_bytes", GAUGE, update_process_states_gauge, PROCESS_INTERVAL_MS,   \
+           1, rank_label_keys, NULL, NULL, "Resident memory of the processes using the most memory")                   \
+    METRIC(top_rss_pid_metric, "top_rss_process_pid", GAUGE, update_process_states_gauge, PROCESS_INTERVAL_MS, 1,      \
+           rank_label_keys, NULL, NULL, "PID of the processes using the most memory")                                  \
+    METRIC(total_memory_metric, "total_memory_mb", GAUGE, update_memory_metrics, 0, 0, NULL, NULL, NULL,               \
+           "Total memory in MB")                                                                                       \
+    METRIC(total_processes_metric, "total_processes", GAUGE, update_process_states_gauge, PROCESS_INTERVAL_MS, 0,      \
+           NULL, NULL, NULL, "Total number of processes")                                                              \
+    METRIC(tx_bytes_metric, "tx_bytes_total", COUNTER, update_network_traffic_metric, 0, 0, NULL, NULL,                \
+           &tx_bytes_rate, "Total transmitted bytes")                                                                  \
+    METRIC(tx_errors_metric, "tx_errors_total", COUNTER, update_network_traffic_metric, 0, 0, NULL, NULL, NULL,        \
+           "Total transmit errors")                                                                                    \
+    METRIC(used_memory_metric, "used_memory_mb", GAUGE, update_memory_metrics, 0, 0, NULL, NULL, NULL,                 \
+           "Used memory in MB")                                                                                        \
+    METRIC(writes_completed_metric, "writes_completed_total", COUNTER, update_disk_stats_metrics, 0, 0, NULL, NULL,    \
+           &writes_completed_rate, "Total writes completed")                                                           \
+    METRIC(zombie_processes_metric, "zombie_processes", GAUGE, update_process_states_gauge, PROCESS_INTERVAL_MS, 0,    \
+           NULL, NULL, NULL, "Zombie processes")
+
+#endif // METRIC_CATALOG_H
@@ -18,16 +18,29 @@
 
 #include <ctype.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <regex.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/statvfs.h> // Required for retrieving file system stats
+#include <time.h>
 #include <unistd.h>
 
 #define SLEEP_TIME 1                      /**< Sleep time in seconds for the main loop. */
 #define COMMAND_SIZE 512                  /**< Size of the command buffer. */
 #define BUFFER_SIZE 1024                  /**< Buffer size for reading files. */
 #define DISKSTATS_PATH "/proc/diskstats"  /**< Path to the disk stats file. */
+#define SYS_BLOCK_PATH "/sys/block"       /**< Directory listing the whole block devices. */
+#define DISK_NAME_SIZE 32                 /**< Buffer size of a block device name. */
+#define DISK_SECTOR_SIZE 512              /**< Size of the sectors counted by /proc/diskstats, in bytes. */
+#define DISKSTATS_FIELDS 10               /**< Counters read from a /proc/diskstats line, up to the I/O time. */
+#define CPU_TIME_FIELDS 10                /**< Counters of a cpu line of /proc/stat. */
+#define RAMDISK_MAJOR 1                   /**< Major number of the ram block devices. */
+#define LOOP_MAJOR 7                      /**< Major number of the loop block devices. */
 #define RETURN_ERROR -1                   /**< Return value for functions that encounter an error. */
 #define PROC_STAT_PATH "/proc/stat"       /**< Path to the stat file. */
 #define PROC_NET_DEV_PATH "/proc/net/dev" /**< Path to the network device file. */
@@ -35,27 +48,62 @@
 #define PROC_MEMINFO_PATH "/proc/meminfo" /**< Path to the meminfo file. */
 #define PROC_STAT_PATH "/proc/stat"       /**< Path to the stat file. */
 #define ROOT_PATH "/"                     /**< Root path for the file system. */
-#define HWMON_CPU_TEMP_PATH "/sys/class/hwmon/hwmon4/temp1_input"             /**< Path to the CPU temperature file. */
-#define HWMON_BATTERY_VOLTAGE_PATH "/sys/class/hwmon/hwmon2/in0_input"        /**< Path to the battery voltage file. */
-#define HWMON_BATTERY_CURRENT_PATH "/sys/class/hwmon/hwmon2/curr1_input"      /**< Path to the battery current file. */
-#define CPU_FREQ_PATH "/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq" /**< Path to the CPU frequency file. */
-#define CPU_FAN_SPEED_PATH "/sys/class/hwmon/hwmon5/fan1_input"               /**< Path to the CPU fan speed file. */
-#define GPU_FAN_SPEED_PATH "/sys/class/hwmon/hwmon5/fan2_input"               /**< Path to the GPU fan speed file. */
 #define UNIT_CONVERSION 1000.0           /**< Unit conversion factor for file paths. */
 #define CONVERT_TO_MB 1024.0             /**< Conversion factor for memory values. */
 #define PERCENTAGE 100.0                 /**< Conversion factor for percentage values. */
 #define PROC_DIR_PATH "/proc"            /**< Path to the /proc directory. */
 #define STAT_FILE_FORMAT "/proc/%s/stat" /**< Format string for the stat file. */
+#define DENTS_BUFFER_SIZE (64 * 1024)    /**< Buffer size for listing /proc with getdents64. */
+#define PID_STAT_BUFFER_SIZE 256         /**< Bytes of /proc/<pid>/stat needed to reach the state field. */
+#define PID_STAT_FULL_BUFFER_SIZE 1024   /**< Bytes of /proc/<pid>/stat needed to read every field. */
 
 /**
- * @brief Reads the value from the specified file.
+ * @brief Structure to hold the /proc/meminfo fields used by the memory metrics.
  *
- * This function reads the value from the specified file and returns it as a double.
+ * All values are in kB, as reported by the kernel. Fields missing from the file are left at zero.
+ */
+typedef struct
+{
+    unsigned long long mem_total;     /**< Total usable memory (MemTotal). */
+    unsigned long long mem_free;      /**< Unused memory (MemFree). */
+    unsigned long long mem_available; /**< Memory available for new allocations (MemAvailable). */
+    unsigned long long buffers;       /**< Memory used by block device buffers (Buffers). */
+    unsigned long long cached;        /**< Memory used by the page cache (Cached). */
+    unsigned long long swap_total;    /**< Total swap space (SwapTotal). */
+    unsigned long long swap_free;     /**< Unused swap space (SwapFree). */
+    unsigned long long dirty;         /**< Memory waiting to be written back to disk (Dirty). */
+    unsigned long long slab;          /**< Memory used by the kernel slab allocator (Slab). */
+} MemInfoSnapshot;
+
+/**
+ * @brief Reads /proc/meminfo into a MemInfoSnapshot.
+ *
+ * The file is read in one pass through the source cache and only the fields of MemInfoSnapshot are parsed, so
+ * every memory metric of a monitoring cycle can be derived from one pass over the file.
+ *
+ * @param snapshot Pointer to store the parsed values.
+ * @return 0 on success, or -1 if the file cannot be read or MemTotal is missing.
+ */
+int read_meminfo_snapshot(MemInfoSnapshot* snapshot);
+
+/**
+ * @brief Calculates the memory usage percentage from a meminfo snapshot.
  *
- * @param path The path to the file to read.
- * @return The value read from the file, or -1.0 in case of an error.
+ * @param snapshot The meminfo snapshot.
+ * @return Memory usage as a percentage (0.0 to 100.0).
  */
-static double read_value(const char* path);
+double meminfo_usage_percentage(const MemInfoSnapshot* snapshot);
+
+/**
+ * @brief Calculates the used memory in MB from a meminfo snapshot.
+ *
+ * Used memory excludes free memory, buffers and the page cache. An inconsistent snapshot, listing more unused memory
+ * than the total, yields 0 rather than a wrapped difference.
+ *
+ * @param snapshot The meminfo snapshot.
+ * @return Used memory in MB.
+ */
+double meminfo_used_mb(const MemInfoSnapshot* snapshot);
 
 /**
  * @brief Retrieves the memory usage percentage from /proc/meminfo.
@@ -67,92 +115,174 @@ static double read_value(const char* path);
  */
 double get_memory_usage();
 
+#define CPU_MODE_COUNT 8 /**< Number of CPU modes reported per core. */
+
 /**
- * @brief Retrieves the CPU usage percentage from /proc/stat.
+ * @brief Names of the CPU modes, used as values of the mode label.
+ */
+extern const char* const cpu_mode_names[CPU_MODE_COUNT];
+
+/**
+ * @brief Structure to hold the time counters of one cpu line of /proc/stat.
  *
- * Reads CPU time values from /proc/stat and calculates the percentage of CPU usage
- * over a time interval.
+ * All values are in USER_HZ ticks.
+ */
+typedef struct
+{
+    int cpu;                       /**< CPU id, or -1 for the aggregate line. */
+    unsigned long long user;       /**< Time spent in user mode. */
+    unsigned long long nice;       /**< Time spent in user mode with low priority. */
+    unsigned long long system;     /**< Time spent in system mode. */
+    unsigned long long idle;       /**< Time spent idle. */
+    unsigned long long iowait;     /**< Time spent waiting for I/O. */
+    unsigned long long irq;        /**< Time spent servicing interrupts. */
+    unsigned long long softirq;    /**< Time spent servicing softirqs. */
+    unsigned long long steal;      /**< Time stolen by the hypervisor. */
+    unsigned long long guest;      /**< Time spent running a guest. */
+    unsigned long long guest_nice; /**< Time spent running a low priority guest. */
+} CpuTimes;
+
+/**
+ * @brief Structure to hold one parsed snapshot of /proc/stat.
  *
- * @return CPU usage as a percentage (0.0 to 100.0), or -1.0 in case of error.
+ * The per-CPU array is owned by the snapshot and reused between reads; it only grows when more CPUs appear.
  */
-double get_cpu_usage();
+typedef struct
+{
+    CpuTimes total;                   /**< Aggregate cpu line. */
+    CpuTimes* cpus;                   /**< Per-CPU lines in file order. */
+    size_t cpu_count;                 /**< Number of valid entries in cpus. */
+    size_t cpu_capacity;              /**< Number of allocated entries in cpus. */
+    unsigned long long ctxt;          /**< Context switches since boot. */
+    unsigned long long intr_total;    /**< Interrupts serviced since boot. */
+    unsigned long long processes;     /**< Processes created since boot. */
+    unsigned long long procs_running; /**< Processes currently runnable. */
+    unsigned long long procs_blocked; /**< Processes currently blocked on I/O. */
+} ProcStatSnapshot;
 
 /**
- * @brief Retrieves the disk usage percentage.
+ * @brief Reads /proc/stat into a ProcStatSnapshot in a single pass.
  *
- * Uses the `statvfs()` function to obtain file system statistics and calculates
- * the percentage of disk space used.
+ * The snapshot must be zero-initialized before its first use and can be reused for every later read.
  *
- * @return Disk usage as a percentage, or -1.0 in case of error.
+ * @param snapshot Pointer to store the parsed values.
+ * @return 0 on success, or -1 in case of error.
  */
-double get_disk_usage();
+int read_proc_stat_snapshot(ProcStatSnapshot* snapshot);
 
 /**
- * @brief Retrieves the current CPU temperature.
+ * @brief Releases the per-CPU array of a ProcStatSnapshot.
  *
- * This function reads the CPU temperature from the hardware monitor file and returns the value.
+ * @param snapshot The snapshot to release.
+ */
+void proc_stat_snapshot_free(ProcStatSnapshot* snapshot);
+
+/**
+ * @brief Calculates the CPU usage percentage between two readings of the same cpu line.
  *
- * @return The CPU temperature in degrees Celsius, or -1.0 in case of an error.
+ * @param prev The previous reading.
+ * @param cur The current reading.
+ * @return CPU usage as a percentage (0.0 to 100.0), or -1.0 if no time has elapsed.
  */
-double get_cpu_temperature();
+double cpu_times_usage_percentage(const CpuTimes* prev, const CpuTimes* cur);
 
 /**
- * @brief Retrieves the current battery voltage.
+ * @brief Calculates the share of time spent in each CPU mode between two readings of the same cpu line.
  *
- * This function reads the battery voltage from the hardware monitor file and returns the value.
+ * The modes are reported in the order of cpu_mode_names.
  *
- * @return The battery voltage, or -1.0 in case of an error.
+ * @param prev The previous reading.
+ * @param cur The current reading.
+ * @param percentages Array to store the percentage of time spent in each mode.
+ * @return 0 on success, or -1 if no time has elapsed or the counters went backwards.
  */
-double get_battery_voltage();
+int cpu_times_mode_percentages(const CpuTimes* prev, const CpuTimes* cur, double percentages[CPU_MODE_COUNT]);
 
 /**
- * @brief Retrieves the current battery current.
+ * @brief Structure to hold the state of get_cpu_usage() between two calls, zero-initialized before the first.
+ */
+typedef struct
+{
+    ProcStatSnapshot snapshot; /**< Buffer of the last read, freed with proc_stat_snapshot_free. */
+    CpuTimes prev;             /**< Aggregate times of the previous call. */
+    bool valid;                /**< Whether prev holds the times of a previous call. */
+} CpuUsageState;
+
+/**
+ * @brief Retrieves the CPU usage percentage from /proc/stat.
  *
- * This function reads the battery current from the hardware monitor file and returns the value.
+ * Reads CPU time values from /proc/stat and calculates the percentage of CPU usage since the previous call with the
+ * same state. Callers with their own state can call it concurrently.
  *
- * @return The battery current, or -1.0 in case of an error.
+ * @param state The state of the previous call; the first call only fills it.
+ * @return CPU usage as a percentage (0.0 to 100.0), or -1.0 on the first call or in case of error.
  */
-double get_battery_current();
+double get_cpu_usage(CpuUsageState* state);
 
 /**
- * @brief Retrieves the current CPU frequency.
+ * @brief Retrieves the disk usage percentage.
  *
- * This function reads the current CPU frequency from the system file and returns the value.
+ * Uses the `statvfs()` function to obtain file system statistics and calculates
+ * the percentage of disk space used.
  *
- * @return The CPU frequency, or -1.0 in case of an error.
+ * @return Disk usage as a percentage, or -1.0 in case of error.
  */
-double get_cpu_frequency();
+double get_disk_usage();
 
 /**
- * @brief Retrieves the current CPU fan speed.
- *
- * This function reads the CPU fan speed from the hardware monitor file and returns the value.
+ * @brief Structure to hold the number of processes in each scheduler state.
+ */
+typedef struct
+{
+    int total;      /**< Processes whose state could be read. */
+    int running;    /**< Running or runnable processes (R). */
+    int sleeping;   /**< Processes in interruptible sleep (S). */
+    int disk_sleep; /**< Processes in uninterruptible sleep, usually waiting for I/O (D). */
+    int zombie;     /**< Terminated processes not yet reaped by their parent (Z). */
+    int stopped;    /**< Processes stopped by a signal or a tracer (T, t). */
+    int idle;       /**< Idle kernel threads (I). */
+} ProcessStateCounts;
+
+/**
+ * @brief Callback invoked for every process found in /proc.
  *
- * @return The CPU fan speed in RPM, or -1.0 in case of an error.
+ * @param pid PID of the process as a string.
+ * @param fields NUL-terminated fields of /proc/<pid>/stat, starting at the state (field 3).
+ * @param len Length of fields.
+ * @param ctx User context passed to for_each_pid_stat.
  */
-double get_cpu_fan_speed();
+typedef void (*pid_stat_fn)(const char* pid, const char* fields, size_t len, void* ctx);
 
 /**
- * @brief Retrieves the current GPU fan speed.
+ * @brief Walks /proc and reads the stat file of every process.
  *
- * This function reads the GPU fan speed from the hardware monitor file and returns the value.
+ * Lists /proc with getdents64 and reads every <pid>/stat through openat, without any stdio on the per-process path.
+ * Processes that exit during the walk are skipped.
  *
- * @return The GPU fan speed in RPM, or -1.0 in case of an error.
+ * @param read_size Number of bytes of each stat file to read, at most PID_STAT_FULL_BUFFER_SIZE.
+ * @param fn Callback invoked for every process.
+ * @param ctx User context passed to fn.
+ * @return 0 on success, or -1 if /proc cannot be listed.
  */
-double get_gpu_fan_speed();
+int for_each_pid_stat(size_t read_size, pid_stat_fn fn, void* ctx);
 
 /**
- * @brief Retrieves the total, suspended, ready, and blocked processes.
+ * @brief Adds one process in the given state to a ProcessStateCounts structure.
  *
- * Reads the state of all processes from /proc and counts the total, suspended,
- * ready, and blocked processes.
+ * @param counts The counts to update.
+ * @param state The state character from /proc/<pid>/stat.
+ */
+void process_state_counts_add(ProcessStateCounts* counts, char state);
+
+/**
+ * @brief Counts the processes in each scheduler state.
+ *
+ * Only the first bytes of every <pid>/stat are read, up to the state byte after the comm field.
  *
- * @param total Pointer to store the total number of processes.
- * @param suspended Pointer to store the number of suspended processes.
- * @param ready Pointer to store the number of ready processes.
- * @param blocked Pointer to store the number of blocked processes.
+ * @param counts Pointer to store the number of processes in each state.
+ * @return 0 on success, or -1 if /proc cannot be listed.
  */
-void get_process_states(int* total, int* suspended, int* ready, int* blocked);
+int get_process_states(ProcessStateCounts* counts);
 
 /**
  * @brief Retrieves the total memory available in the system.
@@ -184,11 +314,13 @@ double get_available_memory();
 /**
  * @brief Retrieves the number of context switches.
  *
- * Reads the number of context switches from /proc/stat.
+ * Reads the number of context switches from a /proc/stat snapshot. The count is kept in 64 bits, since it overflows
+ * an int within days on a busy host.
  *
- * @return The number of context switches, or -1 in case of error.
+ * @param switches Pointer to store the number of context switches since boot.
+ * @return 0 on success, or -1 in case of error.
  */
-int get_context_switches();
+int get_context_switches(unsigned long long* switches);
 
 /**
  * @brief Structure to hold disk statistics.
@@ -203,11 +335,98 @@ typedef struct
 /**
  * @brief Retrieves disk statistics including I/O time and the number of completed read and write operations.
  *
- * Reads the disk statistics from /proc/diskstats and returns them in a DiskStats structure.
+ * Reads the disk statistics from /proc/diskstats and stores them in a DiskStats structure. Only physical disks are
+ * summed: partitions, stacked devices such as device-mapper and md, and loop and ram devices would count the same I/O
+ * twice.
  *
- * @return A DiskStats struct containing I/O time, writes completed, and reads completed.
+ * @param stats Pointer to store the I/O time, writes completed, and reads completed.
+ * @return 0 on success, or -1 if /proc/diskstats cannot be read; stats is then left untouched.
+ */
+int get_disk_stats(DiskStats* stats);
+
+/**
+ * @brief Kind of a block device listed in /proc/diskstats.
+ */
+typedef enum
+{
+    DISK_KIND_PARTITION, /**< Partition, or any device missing from /sys/block. */
+    DISK_KIND_VIRTUAL,   /**< Loop or ram device. */
+    DISK_KIND_STACKED,   /**< Whole device built on other block devices, such as device-mapper or md. */
+    DISK_KIND_PHYSICAL,  /**< Whole device with no underlying block device, including NVMe namespaces. */
+} DiskKind;
+
+/**
+ * @brief Structure to hold the counters of one /proc/diskstats line.
  */
-DiskStats get_disk_stats();
+typedef struct
+{
+    char name[DISK_NAME_SIZE];        /**< Device name. */
+    unsigned int major;               /**< Major device number. */
+    unsigned int minor;               /**< Minor device number. */
+    DiskKind kind;                    /**< Kind of the device. */
+    unsigned long long reads;         /**< Reads completed. */
+    unsigned long long read_sectors;  /**< Sectors read. */
+    unsigned long long read_ms;       /**< Milliseconds spent reading. */
+    unsigned long long writes;        /**< Writes completed. */
+    unsigned long long write_sectors; /**< Sectors written. */
+    unsigned long long write_ms;      /**< Milliseconds spent writing. */
+    unsigned long long io_ms;         /**< Milliseconds during which the device had I/O in flight. */
+} DiskDeviceStats;
+
+/**
+ * @brief Structure to hold one parsed snapshot of /proc/diskstats.
+ *
+ * The device array is owned by the snapshot and reused between reads. The kind of a device is looked up in
+ * /sys/block only when a new device shows up at its position, so a regular read performs no extra system calls.
+ */
+typedef struct
+{
+    DiskDeviceStats* devices;  /**< Devices in file order. */
+    size_t device_count;       /**< Number of valid entries in devices. */
+    size_t device_capacity;    /**< Number of allocated entries in devices. */
+    struct timespec timestamp; /**< Monotonic time of the read. */
+} DiskStatsSnapshot;
+
+/**
+ * @brief Reads every device of /proc/diskstats into a DiskStatsSnapshot in a single pass.
+ *
+ * The snapshot must be zero-initialized before its first use and can be reused for every later read.
+ *
+ * @param snapshot Pointer to store the parsed values.
+ * @return 0 on success, or -1 in case of error.
+ */
+int read_diskstats_snapshot(DiskStatsSnapshot* snapshot);
+
+/**
+ * @brief Releases the device array of a DiskStatsSnapshot.
+ *
+ * @param snapshot The snapshot to release.
+ */
+void diskstats_snapshot_free(DiskStatsSnapshot* snapshot);
+
+/**
+ * @brief Structure to hold the activity of one block device over an interval.
+ */
+typedef struct
+{
+    double reads_per_second;       /**< Reads completed per second. */
+    double writes_per_second;      /**< Writes completed per second. */
+    double read_bytes_per_second;  /**< Bytes read per second. */
+    double write_bytes_per_second; /**< Bytes written per second. */
+    double await_ms;               /**< Average time of the completed requests, queueing included. */
+    double utilization;            /**< Percentage of the interval with I/O in flight (0.0 to 100.0). */
+} DiskDeviceRates;
+
+/**
+ * @brief Calculates the activity of a block device between two readings of it.
+ *
+ * @param prev The previous reading.
+ * @param cur The current reading.
+ * @param elapsed Seconds between the readings.
+ * @param rates Pointer to store the activity.
+ * @return 0 on success, or -1 if no time has elapsed or the counters went backwards.
+ */
+int disk_device_rates(const DiskDeviceStats* prev, const DiskDeviceStats* cur, double elapsed, DiskDeviceRates* rates);
 
 /**
  * @brief Structure to hold network traffic statistics.
@@ -225,10 +444,138 @@ typedef struct
  * @brief Retrieves network traffic statistics for the specified network interface.
  *
  * Reads the network traffic statistics from /proc/net/dev and returns the total bytes received,
- * transmitted, and errors encountered for the "wlp4s0" interface.
+ * transmitted, and errors encountered for the NETWORK_INTERFACE interface. The interface name must match exactly.
+ *
+ * @param stats Pointer to store the network traffic statistics.
+ * @return 0 on success, or -1 if /proc/net/dev cannot be read or does not list the interface; stats is then left
+ * untouched.
+ */
+int get_network_traffic(NetworkStats* stats);
+
+/**
+ * @brief Counters of one /proc/net/dev line, in the order of the file.
+ */
+typedef enum
+{
+    NET_DEV_RX_BYTES,
+    NET_DEV_RX_PACKETS,
+    NET_DEV_RX_ERRORS,
+    NET_DEV_RX_DROPPED,
+    NET_DEV_RX_FIFO,
+    NET_DEV_RX_FRAME,
+    NET_DEV_RX_COMPRESSED,
+    NET_DEV_RX_MULTICAST,
+    NET_DEV_TX_BYTES,
+    NET_DEV_TX_PACKETS,
+    NET_DEV_TX_ERRORS,
+    NET_DEV_TX_DROPPED,
+    NET_DEV_TX_FIFO,
+    NET_DEV_TX_COLLISIONS,
+    NET_DEV_TX_CARRIER,
+    NET_DEV_TX_COMPRESSED,
+    NET_DEV_COUNTER_COUNT /**< Number of counters per device. */
+} NetDevCounter;
+
+/**
+ * @brief Structure to hold the counters of one network device.
+ */
+typedef struct
+{
+    char name[IFNAMSIZ];                                /**< Interface name. */
+    unsigned long long counters[NET_DEV_COUNTER_COUNT]; /**< Counters indexed by NetDevCounter. */
+} NetDevStats;
+
+typedef struct NetlinkReader NetlinkReader; /**< rtnetlink socket, declared in netlink_stats.h. */
+
+/**
+ * @brief Structure to hold one snapshot of the network device counters.
+ *
+ * The device array is owned by the snapshot and reused between reads; it only grows when more devices appear. The
+ * snapshot also owns the netlink socket it is read from.
+ */
+typedef struct
+{
+    NetDevStats* devices;    /**< Devices in source order. */
+    size_t device_count;     /**< Number of valid entries in devices. */
+    size_t device_capacity;  /**< Number of allocated entries in devices. */
+    NetlinkReader* netlink;  /**< Netlink reader, NULL until the first read or once netlink has failed. */
+    int netlink_unavailable; /**< Whether netlink failed, in which case /proc/net/dev is read instead. */
+} NetDevSnapshot;
+
+/**
+ * @brief Reads the counters of every network device into a NetDevSnapshot in a single pass.
+ *
+ * The counters come from an rtnetlink link dump. If netlink cannot be used, /proc/net/dev is parsed instead, for the
+ * rest of the life of the snapshot. Both sources fill the same NetDevCounter columns.
+ *
+ * The snapshot must be zero-initialized before its first use and can be reused for every later read.
+ *
+ * @param snapshot Pointer to store the parsed values.
+ * @return 0 on success, or -1 in case of error.
+ */
+int read_net_dev_snapshot(NetDevSnapshot* snapshot);
+
+/**
+ * @brief Reads every device of /proc/net/dev into a NetDevSnapshot in a single pass.
+ *
+ * @param snapshot Pointer to store the parsed values.
+ * @return 0 on success, or -1 in case of error.
+ */
+int read_proc_net_dev_snapshot(NetDevSnapshot* snapshot);
+
+/**
+ * @brief Reserves room for one more device in a NetDevSnapshot.
+ *
+ * @param snapshot The snapshot.
+ * @return The entry following the valid ones, or NULL if the array cannot be grown.
+ */
+NetDevStats* net_dev_snapshot_next(NetDevSnapshot* snapshot);
+
+/**
+ * @brief Releases the device array and the netlink reader of a NetDevSnapshot.
+ *
+ * @param snapshot The snapshot to release.
+ */
+void net_dev_snapshot_free(NetDevSnapshot* snapshot);
+
+/**
+ * @brief Include and exclude patterns selecting the names to report, such as network devices or file system types.
+ */
+typedef struct
+{
+    regex_t include; /**< Names that are reported, valid if has_include is set. */
+    regex_t exclude; /**< Names that are skipped, valid if has_exclude is set. */
+    int has_include; /**< Whether an include pattern was given. */
+    int has_exclude; /**< Whether an exclude pattern was given. */
+} NameFilter;
+
+/**
+ * @brief Compiles the filter patterns.
+ *
+ * The patterns are POSIX extended regular expressions matched against the whole name. A NULL or empty pattern
+ * disables that side of the filter.
+ *
+ * @param filter Pointer to the filter to initialize.
+ * @param include Pattern of the names to report, or NULL to report every name.
+ * @param exclude Pattern of the names to skip, or NULL to skip none.
+ * @return 0 on success, or -1 if a pattern does not compile; the filter is then left without patterns.
+ */
+int name_filter_init(NameFilter* filter, const char* include, const char* exclude);
+
+/**
+ * @brief Checks whether a name passes the filter.
+ *
+ * @param filter The filter.
+ * @param name The name.
+ * @return 1 if the name is reported, 0 otherwise.
+ */
+int name_filter_match(const NameFilter* filter, const char* name);
+
+/**
+ * @brief Releases the compiled patterns of a filter.
  *
- * @return A NetworkStats struct containing network traffic statistics.
+ * @param filter The filter to release.
  */
-NetworkStats get_network_traffic();
+void name_filter_free(NameFilter* filter);
 
 #endif // METRICS_H
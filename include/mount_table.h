@@ -0,0 +1,119 @@
+#ifndef MOUNT_TABLE_H
+#define MOUNT_TABLE_H
+
+/**
+ * @file mount_table.h
+ * @brief Header file for tracking the mounted file systems and their usage.
+ *
+ * The mount table keeps /proc/self/mountinfo open and only parses it again when poll() reports POLLPRI, which the
+ * kernel raises whenever the mount namespace changes. Mounts are selected by file system type.
+ *
+ * statvfs() on a dead network mount blocks until the server comes back, so every mount is queried by its own task on
+ * the worker pool and the caller only waits up to a timeout. A mount whose query is still in flight is not queried
+ * again until it returns, so a dead mount holds at most one worker, and at most MOUNT_MAX_IN_FLIGHT queries run at
+ * once so that the other collectors always keep a worker.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include "metrics.h"
+#include "worker_pool.h"
+#include <prom.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/statvfs.h>
+
+#define PROC_MOUNTINFO_PATH "/proc/self/mountinfo" /**< Path to the mount table of the calling process. */
+#define MOUNTINFO_SIZE_HINT 8192                   /**< Initial buffer size for /proc/self/mountinfo. */
+#define MOUNTINFO_MAX_SIZE (1 << 22)               /**< Upper bound on the buffer size of /proc/self/mountinfo. */
+#define MOUNT_MAX_IN_FLIGHT (WORKER_COUNT / 2)     /**< Maximum number of statvfs queries running at once. */
+#define MOUNT_SAMPLE_COUNT 6                       /**< Sample handles kept per mount for the caller. */
+
+/**
+ * @brief Structure to hold one mount and its last usage reading.
+ */
+typedef struct MountEntry
+{
+    int mount_id;                                       /**< Unique ID of the mount. */
+    char* mount_point;                                  /**< Mount point, with escapes decoded. */
+    char* fstype;                                       /**< File system type. */
+    char* source;                                       /**< Mount source, such as the block device. */
+    struct statvfs usage;                               /**< Last reading, valid if has_usage is set. */
+    bool has_usage;                                     /**< Whether usage holds a reading of this mount. */
+    bool in_flight;                                     /**< Set while a query of the mount is queued or running. */
+    bool fresh;                                         /**< Set when a query completed during the last round. */
+    bool pending;                                       /**< Set while the mount waits for a query slot. */
+    bool queried;                                       /**< Set when the query in flight was sent this round. */
+    bool removed;                                       /**< Set once the mount is gone; its query frees it. */
+    bool seen;                                          /**< Set when the last parse listed the mount. */
+    prom_metric_sample_t* samples[MOUNT_SAMPLE_COUNT];  /**< Sample handles, owned by the caller. */
+    struct MountTable* table;                           /**< Table the entry belongs to. */
+    struct MountEntry* next;                            /**< Next mount of the table. */
+} MountEntry;
+
+/**
+ * @brief Callback invoked when a mount leaves the table; its samples must be dropped.
+ */
+typedef void (*mount_release_fn)(MountEntry* entry);
+
+/**
+ * @brief Structure to hold the mount table.
+ */
+typedef struct MountTable
+{
+    MountEntry* entries;      /**< Selected mounts. */
+    int fd;                   /**< Descriptor of /proc/self/mountinfo kept open for poll(). */
+    bool loaded;              /**< Whether mountinfo has been parsed at least once. */
+    char* buffer;             /**< Read buffer of mountinfo. */
+    size_t capacity;          /**< Size of buffer in bytes. */
+    NameFilter fstypes;       /**< File system types to report. */
+    WorkerPool* pool;         /**< Pool running the statvfs queries, or NULL to run them inline. */
+    size_t in_flight;         /**< Number of queries queued or running. */
+    pthread_mutex_t mutex;    /**< Protects the entries while queries are in flight. */
+    pthread_cond_t done;      /**< Signalled whenever a query completes. */
+    mount_release_fn release; /**< Called under mutex when a mount leaves the table. */
+} MountTable;
+
+/**
+ * @brief Initializes a mount table.
+ *
+ * @param table The table to initialize.
+ * @param include Pattern of the file system types to report, or NULL for every type.
+ * @param exclude Pattern of the file system types to skip, or NULL to skip none.
+ * @param release Callback invoked when a mount leaves the table, may be NULL.
+ * @return 0 on success, or -1 in case of error.
+ */
+int mount_table_init(MountTable* table, const char* include, const char* exclude, mount_release_fn release);
+
+/**
+ * @brief Sets the worker pool running the statvfs queries.
+ *
+ * @param table The table.
+ * @param pool The pool, or NULL to query the mounts on the calling thread.
+ */
+void mount_table_set_pool(MountTable* table, WorkerPool* pool);
+
+/**
+ * @brief Parses /proc/self/mountinfo again if the mounts changed since the last call.
+ *
+ * Mounts keep their entry, and with it their sample handles, across parses.
+ *
+ * @param table The table.
+ * @return 0 on success, or -1 in case of error.
+ */
+int mount_table_refresh(MountTable* table);
+
+/**
+ * @brief Queries the usage of every mount and waits for the answers.
+ *
+ * On return, the entries that got an answer have fresh set. The caller must hold table->mutex while it reads the
+ * entries.
+ *
+ * @param table The table.
+ * @param timeout_ms Milliseconds to wait for the answers.
+ * @return The number of mounts still waiting for an answer.
+ */
+size_t mount_table_stat(MountTable* table, unsigned int timeout_ms);
+
+#endif // MOUNT_TABLE_H
@@ -0,0 +1,58 @@
+#ifndef NETLINK_STATS_H
+#define NETLINK_STATS_H
+
+/**
+ * @file netlink_stats.h
+ * @brief Header file for reading network link statistics over rtnetlink.
+ *
+ * A RTM_GETLINK dump returns the binary IFLA_STATS64 counters of every link in a few messages, so neither the kernel
+ * nor the collector has to format or parse the text of /proc/net/dev. The socket and the receive buffer are owned by
+ * the reader and reused for every dump.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include "metrics.h"
+
+#define NETLINK_INITIAL_BUFFER 32768 /**< Initial receive buffer size, enough for a full batch of link messages. */
+#define NETLINK_RECV_TIMEOUT_S 1     /**< Seconds after which a dump that gets no answer is abandoned. */
+
+/**
+ * @brief Structure to hold an rtnetlink socket and its receive buffer.
+ */
+struct NetlinkReader
+{
+    int fd;           /**< NETLINK_ROUTE socket. */
+    unsigned int seq; /**< Sequence number of the last dump request. */
+    char* buffer;     /**< Receive buffer, reused between dumps. */
+    size_t capacity;  /**< Size of buffer in bytes. */
+};
+
+/**
+ * @brief Opens an rtnetlink socket for link dumps.
+ *
+ * @return The reader, or NULL if netlink is unavailable, for example inside a sandbox without AF_NETLINK.
+ */
+NetlinkReader* netlink_reader_open(void);
+
+/**
+ * @brief Dumps the statistics of every link into a snapshot.
+ *
+ * The counters are mapped to the columns of /proc/net/dev the same way the kernel does when it formats that file, so
+ * both sources report identical values.
+ *
+ * @param reader The reader.
+ * @param snapshot Pointer to store the links; its device array is reused and grown as needed.
+ * @return 0 on success, or -1 in case of error.
+ */
+int netlink_read_links(NetlinkReader* reader, NetDevSnapshot* snapshot);
+
+/**
+ * @brief Closes the socket of a reader and releases it.
+ *
+ * @param reader The reader, or NULL.
+ */
+void netlink_reader_close(NetlinkReader* reader);
+
+#endif // NETLINK_STATS_H
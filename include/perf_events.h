@@ -0,0 +1,100 @@
+#ifndef PERF_EVENTS_H
+#define PERF_EVENTS_H
+
+/**
+ * @file perf_events.h
+ * @brief Header file for counting hardware events on every CPU to tell how efficiently it runs.
+ *
+ * Utilisation from /proc/stat only tells that a CPU was busy, not whether it retired instructions or stalled on memory.
+ * Every CPU gets a perf_event_open group counting cycles, instructions, cache misses (the last-level cache on most
+ * PMUs) and branch misses system-wide. A group is scheduled on the PMU as a whole, so its counters cover the same
+ * time even when the kernel multiplexes them, and it is read with a single read() through PERF_FORMAT_GROUP.
+ *
+ * The ratios between two reads are exported: instructions per cycle, and cache and branch misses per thousand
+ * instructions. Cycles and instructions are required; a miss counter the PMU lacks, as in many virtual machines, is
+ * left out of the group and its ratio is not exported.
+ *
+ * Counting on every CPU needs CAP_PERFMON (or CAP_SYS_ADMIN) or a kernel.perf_event_paranoid of 0 or less. When no
+ * group can be opened, or a snapshot is replayed, the events are reported as unavailable once and never read. CPUs
+ * that are offline when the groups are opened are not counted.
+ *
+ * @date 15/10/2026
+ * @author 1v6n
+ */
+
+#include <prom.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PERF_LABEL_SIZE 12 /**< Buffer size of a CPU label. */
+
+/**
+ * @brief Hardware events of a group, in the order they are opened; cycles lead the group.
+ */
+typedef enum
+{
+    PERF_CYCLES,        /**< CPU cycles. */
+    PERF_INSTRUCTIONS,  /**< Retired instructions. */
+    PERF_CACHE_MISSES,  /**< Cache misses, usually of the last-level cache. */
+    PERF_BRANCH_MISSES, /**< Mispredicted branches. */
+    PERF_EVENT_COUNT    /**< Number of events. */
+} PerfEvent;
+
+/**
+ * @brief Ratios exported for every CPU.
+ */
+typedef enum
+{
+    PERF_IPC,                  /**< Instructions per cycle. */
+    PERF_CACHE_MISSES_PER_KI,  /**< Cache misses per thousand instructions. */
+    PERF_BRANCH_MISSES_PER_KI, /**< Branch misses per thousand instructions. */
+    PERF_RATIO_COUNT           /**< Number of ratios. */
+} PerfRatio;
+
+/**
+ * @brief Structure to hold the event group of one CPU.
+ */
+typedef struct
+{
+    int cpu;                                         /**< Number of the CPU. */
+    char label[PERF_LABEL_SIZE];                     /**< Number of the CPU, as a label value. */
+    int fds[PERF_EVENT_COUNT];                       /**< Descriptor of every opened event; fds[PERF_CYCLES] leads. */
+    uint64_t previous[PERF_EVENT_COUNT];             /**< Counts as of the previous read. */
+    uint64_t previous_running;                       /**< Time the group was counting as of the previous read. */
+    bool has_previous;                               /**< Whether previous holds a read. */
+    double ratios[PERF_RATIO_COUNT];                 /**< Ratios between the last two reads, NAN when unknown. */
+    prom_metric_sample_t* samples[PERF_RATIO_COUNT]; /**< Sample handles, owned by the caller. */
+} PerfCpu;
+
+/**
+ * @brief Structure to hold the event groups of every CPU.
+ */
+typedef struct
+{
+    PerfCpu* cpus;                 /**< CPUs with an open group. */
+    size_t cpu_count;              /**< Number of entries in cpus. */
+    bool opened[PERF_EVENT_COUNT]; /**< Whether each event is part of the groups. */
+    size_t event_count;            /**< Number of events in every group. */
+    bool initialized;              /**< Set once the groups have been opened or found unavailable. */
+    bool unavailable;              /**< Set when no group could be opened. */
+} PerfTable;
+
+/**
+ * @brief Reads the event group of every CPU and derives the ratios since the previous read.
+ *
+ * Opens the groups on the first call. A CPU whose group cannot be read, as after it went offline, keeps NAN ratios.
+ *
+ * @param table The table, zero-initialized before the first call.
+ * @return 0 on success, or -1 if the events are unavailable.
+ */
+int perf_table_read(PerfTable* table);
+
+/**
+ * @brief Closes every event group of a table.
+ *
+ * @param table The table.
+ */
+void perf_table_free(PerfTable* table);
+
+#endif // PERF_EVENTS_H
@@ -0,0 +1,59 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+/**
+ * @file placement.h
+ * @brief Header file for pinning the threads of the monitor to chosen CPUs and NUMA nodes and lowering their priority.
+ *
+ * On a large NUMA host a floating monitor walks /proc from whichever node it last ran on, and its allocations land on
+ * remote memory. Two roles can be placed apart, each given a list of CPUs ("0-3,8") or a node ("node:1"):
+ *
+ * - PLACEMENT_COLLECTOR: the scheduler thread and the collector workers and every other thread it starts.
+ * - PLACEMENT_HTTP: the thread running the HTTP server and the libmicrohttpd threads it starts.
+ *
+ * A thread is placed by setting its affinity and, for a node, a memory policy preferring that node, before it starts
+ * its own threads and before the arenas of the scrapes are allocated, so that both follow it. A role without a setting
+ * keeps the CPUs the process started with and the default local allocation.
+ *
+ * The scheduling priority ("idle" for SCHED_IDLE, or a nice level) and the I/O priority ("idle", or a best-effort level
+ * from 0 to 7) apply to every thread, so that production workloads win whenever they compete with the monitor.
+ *
+ * @date 15/10/2026
+ * @author 1v6n
+ */
+
+#define COLLECTOR_CPUS_ENV "MONITOR_COLLECTOR_CPUS" /**< CPUs or node:N of the collector threads; unset to float. */
+#define HTTP_CPUS_ENV "MONITOR_HTTP_CPUS"           /**< CPUs or node:N of the HTTP threads; unset to float. */
+#define PRIORITY_ENV "MONITOR_PRIORITY"             /**< "idle" for SCHED_IDLE, or a nice level; unset to keep. */
+#define IO_PRIORITY_ENV "MONITOR_IO_PRIORITY"       /**< "idle", or a best-effort level from 0 to 7; unset to keep. */
+#define PLACEMENT_NODE_PREFIX "node:"               /**< Prefix of a node in place of a list of CPUs. */
+#define PLACEMENT_IDLE "idle"                       /**< Value of the priorities selecting the idle class. */
+
+/**
+ * @brief Roles a thread can be placed for.
+ */
+typedef enum
+{
+    PLACEMENT_COLLECTOR, /**< The scheduler thread and the collector workers. */
+    PLACEMENT_HTTP,      /**< The HTTP server threads. */
+    PLACEMENT_ROLES,     /**< Number of roles. */
+} PlacementRole;
+
+/**
+ * @brief Reads the placement of every role and lowers the priorities of the calling thread as configured.
+ *
+ * Must be called from the main thread before any other thread is started, so that they all inherit the priorities.
+ *
+ * @return 0 on success, or -1 if a setting is invalid or could not be applied; the others are still applied.
+ */
+int placement_init(void);
+
+/**
+ * @brief Places the calling thread for a role. The threads it starts afterwards inherit the placement.
+ *
+ * @param role The role of the calling thread.
+ * @return 0 on success, or -1 if the placement could not be applied.
+ */
+int placement_apply(PlacementRole role);
+
+#endif // PLACEMENT_H
@@ -0,0 +1,115 @@
+#ifndef PROCESS_TABLE_H
+#define PROCESS_TABLE_H
+
+/**
+ * @file process_table.h
+ * @brief Header file for tracking per-process CPU and memory usage across monitoring cycles.
+ *
+ * The process table keeps one entry per live process, keyed by PID and start time so that a recycled PID is never
+ * mistaken for the process that used it before. Entries live in slabs and are indexed by an open-addressing hash
+ * table. Every scan refreshes the entries in place and keeps the previous CPU times, so per-process rates are computed
+ * without allocating on a regular cycle. Processes that were not seen by a scan are evicted together at its end.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include "metrics.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define PROCESS_SLAB_SIZE 256            /**< Number of entries allocated at once. */
+#define PROCESS_TABLE_INITIAL_SLOTS 1024 /**< Initial number of hash slots, must be a power of two. */
+#define PROCESS_TABLE_MAX_LOAD 0.5       /**< Maximum fraction of used hash slots before the index grows. */
+
+/**
+ * @brief Structure to hold the state of one tracked process.
+ */
+typedef struct ProcessEntry
+{
+    pid_t pid;                        /**< Process ID. */
+    unsigned long long start_time;    /**< Start time after boot in clock ticks, disambiguates recycled PIDs. */
+    unsigned long long utime;         /**< User CPU time in clock ticks. */
+    unsigned long long stime;         /**< System CPU time in clock ticks. */
+    unsigned long long prev_cpu_time; /**< utime + stime at the previous scan. */
+    unsigned long long rss_pages;     /**< Resident set size in pages. */
+    double cpu_percentage;            /**< CPU usage since the previous scan, 100 per fully used core. */
+    char state;                       /**< Scheduler state character. */
+    uint32_t generation;              /**< Scan generation in which the entry was last seen, 0 while unused. */
+    struct ProcessEntry* next_free;   /**< Next entry in the free list while unused. */
+} ProcessEntry;
+
+/**
+ * @brief Structure to hold a block of entries allocated at once.
+ */
+typedef struct ProcessSlab
+{
+    ProcessEntry entries[PROCESS_SLAB_SIZE]; /**< Entries of the slab. */
+    struct ProcessSlab* next;                /**< Next slab in the table. */
+} ProcessSlab;
+
+/**
+ * @brief Structure to hold the process table.
+ */
+typedef struct
+{
+    ProcessEntry** slots;      /**< Open-addressing index with linear probing; NULL marks an empty slot. */
+    size_t slot_count;         /**< Number of slots, always a power of two. */
+    size_t entry_count;        /**< Number of live entries. */
+    ProcessSlab* slabs;        /**< Every slab allocated by the table. */
+    ProcessEntry* free_list;   /**< Unused entries ready for reuse. */
+    uint32_t generation;       /**< Generation of the current scan. */
+    struct timespec last_scan; /**< Monotonic time of the previous scan. */
+    double clock_ticks;        /**< Clock ticks per second. */
+    long page_size;            /**< Page size in bytes. */
+    ProcessStateCounts counts; /**< Process states counted by the last scan. */
+} ProcessTable;
+
+/**
+ * @brief Ranking keys for process_table_top.
+ */
+typedef enum
+{
+    PROCESS_RANK_CPU, /**< Rank by CPU usage. */
+    PROCESS_RANK_RSS  /**< Rank by resident set size. */
+} ProcessRankKey;
+
+/**
+ * @brief Initializes an empty process table.
+ *
+ * @param table The table to initialize.
+ * @return 0 on success, or -1 if the index cannot be allocated.
+ */
+int process_table_init(ProcessTable* table);
+
+/**
+ * @brief Releases every slab and the index of a process table.
+ *
+ * @param table The table to destroy.
+ */
+void process_table_destroy(ProcessTable* table);
+
+/**
+ * @brief Walks /proc once, refreshing every live process and evicting the ones that exited.
+ *
+ * The process state counts of the walk are stored in the counts field of the table.
+ *
+ * @param table The process table.
+ * @return 0 on success, or -1 in case of error.
+ */
+int process_table_scan(ProcessTable* table);
+
+/**
+ * @brief Selects the processes with the highest CPU usage or resident set size.
+ *
+ * @param table The process table.
+ * @param key The ranking key.
+ * @param top Array to store the selected entries, highest first.
+ * @param n Maximum number of entries to select.
+ * @return The number of selected entries.
+ */
+size_t process_table_top(const ProcessTable* table, ProcessRankKey key, const ProcessEntry** top, size_t n);
+
+#endif // PROCESS_TABLE_H
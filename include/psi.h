@@ -0,0 +1,100 @@
+#ifndef PSI_H
+#define PSI_H
+
+/**
+ * @file psi.h
+ * @brief Header file for reading Pressure Stall Information and arming PSI triggers.
+ *
+ * /proc/pressure/{cpu,memory,io} report the share of time in which some or all non-idle tasks were stalled on the
+ * resource, averaged over 10, 60 and 300 seconds, along with the total stall time in microseconds.
+ *
+ * Writing "some|full <stall us> <window us>" to one of these files arms a trigger on the descriptor, which then raises
+ * POLLPRI whenever the stall time within one window exceeds the threshold. Unprivileged processes can only arm
+ * triggers whose window is a multiple of two seconds.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <stdbool.h>
+
+#define PSI_CPU_PATH "/proc/pressure/cpu"       /**< Path to the CPU pressure file. */
+#define PSI_MEMORY_PATH "/proc/pressure/memory" /**< Path to the memory pressure file. */
+#define PSI_IO_PATH "/proc/pressure/io"         /**< Path to the I/O pressure file. */
+#define PSI_TRIGGER_DEFAULT "some 150000 2000000" /**< Default trigger: 150 ms of stall within a 2 s window. */
+
+/**
+ * @brief Resource tracked by PSI.
+ */
+typedef enum
+{
+    PSI_CPU,           /**< CPU pressure. */
+    PSI_MEMORY,        /**< Memory pressure. */
+    PSI_IO,            /**< I/O pressure. */
+    PSI_RESOURCE_COUNT /**< Number of resources. */
+} PsiResource;
+
+/**
+ * @brief Line of a PSI file.
+ */
+typedef enum
+{
+    PSI_SOME,      /**< Time in which at least one task was stalled. */
+    PSI_FULL,      /**< Time in which all non-idle tasks were stalled at once. */
+    PSI_KIND_COUNT /**< Number of lines. */
+} PsiKind;
+
+/**
+ * @brief Averaging window of a PSI line.
+ */
+typedef enum
+{
+    PSI_AVG10,       /**< Average over the last 10 seconds. */
+    PSI_AVG60,       /**< Average over the last 60 seconds. */
+    PSI_AVG300,      /**< Average over the last 300 seconds. */
+    PSI_WINDOW_COUNT /**< Number of windows. */
+} PsiWindow;
+
+/**
+ * @brief Structure to hold one line of a PSI file.
+ */
+typedef struct
+{
+    double avg[PSI_WINDOW_COUNT]; /**< Stall percentages, indexed by PsiWindow. */
+    unsigned long long total_us;  /**< Total stall time in microseconds. */
+    bool valid;                   /**< Whether the line was present in the last read. */
+} PsiLine;
+
+/**
+ * @brief Structure to hold the pressure of every resource.
+ *
+ * The caller keeps one snapshot across reads, so that a resource whose file is missing is only tried once.
+ */
+typedef struct
+{
+    PsiLine lines[PSI_RESOURCE_COUNT][PSI_KIND_COUNT]; /**< Lines, indexed by PsiResource and PsiKind. */
+    bool unavailable[PSI_RESOURCE_COUNT];              /**< Set once the file of a resource failed to open. */
+} PsiSnapshot;
+
+extern const char* const psi_resource_names[PSI_RESOURCE_COUNT]; /**< Names of the resources, as in /proc/pressure. */
+extern const char* const psi_kind_names[PSI_KIND_COUNT];         /**< Names of the lines. */
+extern const char* const psi_window_names[PSI_WINDOW_COUNT];     /**< Names of the windows, in seconds. */
+
+/**
+ * @brief Reads /proc/pressure into a snapshot.
+ *
+ * @param snapshot The snapshot.
+ * @return 0 if at least one resource was read, or -1 if PSI is unavailable.
+ */
+int read_psi_snapshot(PsiSnapshot* snapshot);
+
+/**
+ * @brief Opens the PSI file of a resource and arms a trigger on it.
+ *
+ * @param resource The resource.
+ * @param spec The trigger, such as PSI_TRIGGER_DEFAULT.
+ * @return A descriptor raising POLLPRI on every trigger event, or -1 in case of error.
+ */
+int psi_trigger_open(PsiResource resource, const char* spec);
+
+#endif // PSI_H
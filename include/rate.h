@@ -0,0 +1,92 @@
+#ifndef RATE_H
+#define RATE_H
+
+/**
+ * @file rate.h
+ * @brief Header file for the per-second rates derived from chosen counters.
+ *
+ * The kernel counters are exported as they are read, so a consumer without a query language has to diff two scrapes
+ * to get a rate. A rate follows one counter: right after each run of its collector, the value of every series of the
+ * counter is copied into a dense array, by position, and the rates of all series are derived in one pass
+ * against the values and CLOCK_MONOTONIC times of the previous run. They are published as a gauge with the same
+ * labels, named after the counter with "_total" replaced by "_per_second".
+ *
+ * A series gets its first rate on the second run that sees it at the same position, so when a series leaves the
+ * counter, the ones after it start over. A counter that went backwards was either a 32-bit counter that wrapped, when
+ * the increment modulo 2^32 is below 2^31, or reset, in which case its whole value counts as the increment. A series
+ * that leaves the counter is removed from the rate gauge. A value of -1, which a collector leaves when its read fails,
+ * is skipped: the series gets no rate on that run, and the next one is derived against the last value that was read.
+ *
+ * @date 15/10/2026
+ * @author 1v6n
+ */
+
+#include <prom.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RATE_NAME_SIZE 128     /**< Longest rate gauge name, including the NUL. */
+#define RATE_HELP_SIZE 256     /**< Longest rate gauge description, including the NUL. */
+#define RATE_INITIAL_SERIES 16 /**< Initial number of series slots. */
+#define RATE_SUFFIX "_total"   /**< Suffix of the counter name replaced by "_per_second". */
+
+/**
+ * @brief Initializer of a Rate attached to a MetricInfo entry.
+ */
+#define RATE_INIT {.mutex = PTHREAD_MUTEX_INITIALIZER}
+
+/**
+ * @brief Structure to hold the rate of one counter. Every array is indexed by the position of a series in the counter.
+ */
+typedef struct
+{
+    pthread_mutex_t mutex;          /**< Guards every field below. */
+    bool open;                      /**< Whether the rate gauge has been created. */
+    char name[RATE_NAME_SIZE];      /**< Name of the rate gauge. */
+    char help[RATE_HELP_SIZE];      /**< Description of the rate gauge. */
+    prom_gauge_t* gauge;            /**< The rate gauge. */
+    size_t label_count;             /**< Number of label keys of the counter. */
+    const char** label_keys;        /**< Label keys of the counter. */
+    uint64_t* hashes;               /**< Hash of the series at every position, to notice a position changing series. */
+    uint64_t* previous;             /**< Value of every series on the previous run. */
+    uint64_t* current;              /**< Value of every series on the current run. */
+    bool* valid;                    /**< Whether the current value was read, rather than left at an error value. */
+    int64_t* previous_ns;           /**< CLOCK_MONOTONIC time of previous, 0 for a series not seen before. */
+    double* rates;                  /**< Rate of every series, NAN until it has two values. */
+    char*** label_values;           /**< Label values of every series, NULL until parsed. */
+    prom_metric_sample_t** samples; /**< Series of the rate gauge at every position, NULL until published. */
+    size_t count;                   /**< Number of series of the counter on the current run. */
+    size_t capacity;                /**< Allocated entries in every array. */
+} Rate;
+
+/**
+ * @brief Creates the rate gauge of a counter on first use and registers it.
+ *
+ * @param rate The rate, initialized with RATE_INIT.
+ * @param name Name of the counter.
+ * @param description Description of the counter.
+ * @param label_count Number of label keys of the counter.
+ * @param label_keys Label keys of the counter.
+ * @return 0 on success, or -1 in case of error.
+ */
+int rate_register(Rate* rate, const char* name, const char* description, size_t label_count, const char** label_keys);
+
+/**
+ * @brief Unregisters the rate gauge, keeping the previous values for a later rate_register.
+ *
+ * @param rate The rate.
+ * @return 0 on success, or -1 in case of error.
+ */
+int rate_unregister(Rate* rate);
+
+/**
+ * @brief Derives the rate of every series of a counter since the previous call and publishes them.
+ *
+ * @param rate The rate.
+ * @param source The counter, holding exact integers.
+ */
+void rate_observe(Rate* rate, prom_counter_t* source);
+
+#endif // RATE_H
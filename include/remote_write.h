@@ -0,0 +1,131 @@
+#ifndef REMOTE_WRITE_H
+#define REMOTE_WRITE_H
+
+/**
+ * @file remote_write.h
+ * @brief Header file for pushing every series to a Prometheus remote-write endpoint.
+ *
+ * Nodes behind NAT cannot be scraped, so the monitor can push instead. Every REMOTE_WRITE_INTERVAL_MS, the current
+ * value of every counter and gauge series is read from the registry the collectors update and queued, timestamped,
+ * on one of REMOTE_WRITE_SHARDS shards; a series always goes to the same shard, so its samples are sent in order.
+ * Queuing never blocks: a full shard drops its oldest samples. Each shard has a thread that sends a batch once
+ * REMOTE_WRITE_BATCH_SAMPLES samples are queued or REMOTE_WRITE_FLUSH_MS elapsed, as a snappy-compressed protobuf
+ * WriteRequest, and retries it with exponential backoff while the endpoint fails with a 5xx status or cannot be
+ * reached. Batches refused with another status are dropped.
+ *
+ * Only plain HTTP endpoints are supported, such as http://gateway:9090/api/v1/write; a TLS-terminating proxy can sit
+ * in front of a remote HTTPS endpoint.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <prom.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REMOTE_WRITE_URL_ENV "MONITOR_REMOTE_WRITE_URL" /**< URL of the endpoint; unset for no push. */
+#define REMOTE_WRITE_INTERVAL_MS 1000                   /**< Interval at which every series is queued. */
+#define REMOTE_WRITE_SHARDS 4                           /**< Number of queues, each sent by its own thread. */
+#define REMOTE_WRITE_QUEUE_CAPACITY 16384               /**< Samples a shard holds before dropping the oldest. */
+#define REMOTE_WRITE_BATCH_SAMPLES 2000                 /**< Most samples sent in one request. */
+#define REMOTE_WRITE_FLUSH_MS 5000                      /**< Longest time a queued sample waits for its batch. */
+#define REMOTE_WRITE_TIMEOUT_S 10                       /**< Timeout of the connection and of every read or write. */
+#define REMOTE_WRITE_MIN_BACKOFF_MS 100                 /**< First delay before retrying a failed batch. */
+#define REMOTE_WRITE_MAX_BACKOFF_MS 5000                /**< Longest delay before retrying a failed batch. */
+#define REMOTE_WRITE_HOST_SIZE 256                      /**< Longest host name accepted, including the NUL. */
+#define REMOTE_WRITE_PATH_SIZE 1024                     /**< Longest URL path accepted, including the NUL. */
+#define REMOTE_WRITE_INITIAL_SLOTS 1024                 /**< Initial number of series slots, a power of two. */
+#define REMOTE_WRITE_MAX_LOAD 0.5                       /**< Maximum fraction of used series slots before growing. */
+
+/**
+ * @brief Structure to hold a series, with its labels encoded once as protobuf Label messages.
+ *
+ * Series are never freed, so queued samples can point at them from the shard threads.
+ */
+typedef struct
+{
+    char* name;            /**< Series as in the text exposition. */
+    uint64_t hash;         /**< Hash of name, which also picks the shard. */
+    uint8_t* labels;       /**< Encoded TimeSeries.labels fields, sorted by label name. */
+    size_t labels_len;     /**< Length of labels in bytes. */
+    double pending;        /**< Value read by the current snapshot. */
+    uint64_t pending_pass; /**< Snapshot pass pending was read by. */
+} RemoteSeries;
+
+/**
+ * @brief Structure to hold a queued sample.
+ */
+typedef struct
+{
+    const RemoteSeries* series; /**< The series. */
+    int64_t timestamp_ms;       /**< CLOCK_REALTIME timestamp in milliseconds. */
+    double value;               /**< The value. */
+} RemoteSample;
+
+struct RemoteWrite;
+
+/**
+ * @brief Structure to hold a shard: a bounded queue and the thread sending it.
+ */
+typedef struct
+{
+    struct RemoteWrite* remote;                        /**< The client the shard belongs to. */
+    RemoteSample samples[REMOTE_WRITE_QUEUE_CAPACITY]; /**< Ring buffer of queued samples. */
+    size_t head;                                       /**< Index of the oldest queued sample. */
+    size_t count;                                      /**< Number of queued samples. */
+    pthread_mutex_t mutex;                             /**< Guards the queue. */
+    pthread_cond_t cond;                               /**< Signalled when a batch is ready or on stop. */
+    pthread_t thread;                                  /**< Thread sending the batches. */
+    bool started;                                      /**< Whether thread was created. */
+} RemoteShard;
+
+/**
+ * @brief Structure to hold the remote-write client.
+ */
+typedef struct RemoteWrite
+{
+    char host[REMOTE_WRITE_HOST_SIZE];       /**< Host of the endpoint. */
+    char port[8];                            /**< Port of the endpoint. */
+    char path[REMOTE_WRITE_PATH_SIZE];       /**< Path of the endpoint. */
+    RemoteShard shards[REMOTE_WRITE_SHARDS]; /**< The shards. */
+    atomic_bool stopping;                    /**< Set to stop the shard threads. */
+    RemoteSeries** slots;                    /**< Open-addressing index of the series with linear probing. */
+    size_t slot_count;                       /**< Number of slots, always a power of two. */
+    RemoteSeries** series;                   /**< Every series, in the order they appeared. */
+    size_t series_count;                     /**< Number of entries in series. */
+    size_t series_capacity;                  /**< Allocated entries in series. */
+    uint64_t pass;                           /**< Current snapshot pass. */
+    prom_counter_t* samples_metric;          /**< Samples by outcome: sent, dropped or failed. */
+} RemoteWrite;
+
+/**
+ * @brief Parses the endpoint URL and starts the shard threads.
+ *
+ * @param remote The client to initialize.
+ * @param url URL of the endpoint, http://host[:port][/path].
+ * @return 0 on success, or -1 in case of error.
+ */
+int remote_write_open(RemoteWrite* remote, const char* url);
+
+/**
+ * @brief Queues the current value of every series of the default registry, timestamped now.
+ *
+ * Never waits for the shard threads. Only one thread may queue at a time.
+ *
+ * @param remote The client.
+ * @return 0 on success, or -1 in case of error.
+ */
+int remote_write_queue(RemoteWrite* remote);
+
+/**
+ * @brief Stops the shard threads, dropping the samples still queued, and frees the series.
+ *
+ * @param remote The client.
+ */
+void remote_write_close(RemoteWrite* remote);
+
+#endif // REMOTE_WRITE_H
@@ -0,0 +1,137 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+/**
+ * @file rollup.h
+ * @brief Header file for the one-minute rollups of chosen gauges.
+ *
+ * Consumers that only need minute resolution would otherwise ingest every sample. A rollup follows one gauge: every
+ * series of the gauge keeps a running minimum, maximum, sum and count, folded in right after each run of its
+ * collector, and every ROLLUP_WINDOW_MS the window is published as three gauges with the same labels,
+ * <name>_min_1m, <name>_max_1m and <name>_avg_1m, then restarted. Peaks between two scrapes of the source gauge are
+ * therefore kept, and memory only grows with the number of live series.
+ *
+ * The published values are those of the last complete window. A series without samples during a whole window is
+ * removed from the rollup gauges and forgotten.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <prom.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ROLLUP_WINDOW_MS 60000  /**< Length of a window in milliseconds. */
+#define ROLLUP_NAME_SIZE 128    /**< Longest rollup gauge name, including the NUL. */
+#define ROLLUP_HELP_SIZE 256    /**< Longest rollup gauge description, including the NUL. */
+#define ROLLUP_INITIAL_SLOTS 64 /**< Initial number of series slots, a power of two. */
+#define ROLLUP_MAX_LOAD 0.5     /**< Maximum fraction of used series slots before growing. */
+
+/**
+ * @brief Initializer of a Rollup attached to a MetricInfo entry.
+ */
+#define ROLLUP_INIT {.mutex = PTHREAD_MUTEX_INITIALIZER}
+
+/**
+ * @brief Indexes of the three rollup gauges.
+ */
+typedef enum
+{
+    ROLLUP_MIN, /**< Minimum over the window. */
+    ROLLUP_MAX, /**< Maximum over the window. */
+    ROLLUP_AVG, /**< Mean of the samples of the window. */
+    ROLLUP_KINDS
+} RollupKind;
+
+/**
+ * @brief Structure to hold the window of one series.
+ */
+typedef struct
+{
+    char* name;                                  /**< Series of the source gauge, as in the text exposition. */
+    uint64_t hash;                               /**< Hash of name. */
+    char** label_values;                         /**< Label values parsed out of name, in label key order. */
+    double min;                                  /**< Smallest sample of the window. */
+    double max;                                  /**< Largest sample of the window. */
+    double sum;                                  /**< Sum of the samples of the window. */
+    uint64_t count;                              /**< Number of samples of the window. */
+    prom_metric_sample_t* samples[ROLLUP_KINDS]; /**< Series of the rollup gauges, NULL until published. */
+    double pending;                              /**< Value read by the current visit. */
+    uint64_t pending_pass;                       /**< Visit pass pending was read by. */
+} RollupSeries;
+
+/**
+ * @brief Structure to hold the rollup of one gauge.
+ */
+typedef struct
+{
+    pthread_mutex_t mutex;                      /**< Guards every field below. */
+    bool open;                                  /**< Whether the rollup gauges have been created. */
+    char names[ROLLUP_KINDS][ROLLUP_NAME_SIZE]; /**< Names of the rollup gauges. */
+    char help[ROLLUP_KINDS][ROLLUP_HELP_SIZE];  /**< Descriptions of the rollup gauges. */
+    prom_gauge_t* gauges[ROLLUP_KINDS];         /**< The rollup gauges. */
+    size_t label_count;                         /**< Number of label keys of the source gauge. */
+    const char** label_keys;                    /**< Label keys of the source gauge. */
+    int64_t window_end_ms;                      /**< CLOCK_MONOTONIC end of the current window, 0 before the first. */
+    RollupSeries** slots;                       /**< Open-addressing index of the series with linear probing. */
+    size_t slot_count;                          /**< Number of slots, always a power of two. */
+    RollupSeries** series;                      /**< Every series, in the order they appeared. */
+    size_t series_count;                        /**< Number of entries in series. */
+    size_t series_capacity;                     /**< Allocated entries in series. */
+    uint64_t pass;                              /**< Current visit pass. */
+} Rollup;
+
+/**
+ * @brief Parses the label values out of a series, name{key="value",...}, in label key order.
+ *
+ * The client library escapes backslashes, double quotes and line feeds in label values, and the values returned are
+ * unescaped. Used by the metrics derived from the series of another metric, which carry the same labels.
+ *
+ * @param series The series, as in the text exposition; not NUL-terminated.
+ * @param len Length of series.
+ * @param label_count Number of label keys of the metric.
+ * @param label_keys Label keys of the metric.
+ * @return The values, to be freed with series_label_values_free, or NULL if the series has no such labels or memory
+ * runs out.
+ */
+char** series_label_values(const char* series, size_t len, size_t label_count, const char** label_keys);
+
+/**
+ * @brief Frees label values returned by series_label_values. NULL is ignored.
+ */
+void series_label_values_free(char** values, size_t count);
+
+/**
+ * @brief Creates the rollup gauges of a gauge on first use and registers them.
+ *
+ * @param rollup The rollup, initialized with ROLLUP_INIT.
+ * @param name Name of the source gauge.
+ * @param description Description of the source gauge.
+ * @param label_count Number of label keys of the source gauge.
+ * @param label_keys Label keys of the source gauge.
+ * @return 0 on success, or -1 in case of error.
+ */
+int rollup_register(Rollup* rollup, const char* name, const char* description, size_t label_count,
+                    const char** label_keys);
+
+/**
+ * @brief Unregisters the rollup gauges, keeping the windows for a later rollup_register.
+ *
+ * @param rollup The rollup.
+ * @return 0 on success, or -1 in case of error.
+ */
+int rollup_unregister(Rollup* rollup);
+
+/**
+ * @brief Folds the current value of every series of the source gauge into its window, publishing the window first
+ * once it has ended.
+ *
+ * @param rollup The rollup.
+ * @param source The source gauge.
+ */
+void rollup_observe(Rollup* rollup, prom_gauge_t* source);
+
+#endif // ROLLUP_H
@@ -0,0 +1,90 @@
+#ifndef SCHEDSTAT_H
+#define SCHEDSTAT_H
+
+/**
+ * @file schedstat.h
+ * @brief Header file for reading the scheduler statistics of every CPU.
+ *
+ * /proc/schedstat reports, for every CPU, the time its tasks spent running, the time runnable tasks spent waiting on
+ * its run queue, and the number of timeslices run. The kernel accumulates these on every context switch, so the wait
+ * time divided by the number of timeslices between two reads is the mean run-queue latency over that interval,
+ * measured in the kernel rather than sampled. The file is only present on kernels built with CONFIG_SCHEDSTATS.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <prom.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SCHEDSTAT_PATH "/proc/schedstat" /**< Path to the scheduler statistics file. */
+#define SCHEDSTAT_MIN_VERSION 15         /**< Oldest format whose CPU lines are understood. */
+#define SCHEDSTAT_LABEL_SIZE 12          /**< Buffer size of a CPU label. */
+
+/**
+ * @brief Counters of a CPU line, in the order of /proc/schedstat.
+ */
+typedef enum
+{
+    SCHEDSTAT_RUN_TIME,   /**< Time spent running tasks in nanoseconds. */
+    SCHEDSTAT_WAIT_TIME,  /**< Time runnable tasks spent waiting on the run queue in nanoseconds. */
+    SCHEDSTAT_TIMESLICES, /**< Number of timeslices run. */
+    SCHEDSTAT_FIELD_COUNT /**< Number of counters. */
+} SchedstatField;
+
+/**
+ * @brief Structure to hold the counters of one CPU.
+ */
+typedef struct
+{
+    int cpu;                                              /**< Number of the CPU. */
+    char label[SCHEDSTAT_LABEL_SIZE];                     /**< Number of the CPU, as a label value. */
+    unsigned long long values[SCHEDSTAT_FIELD_COUNT];     /**< Counters, indexed by SchedstatField. */
+    prom_metric_sample_t* samples[SCHEDSTAT_FIELD_COUNT]; /**< Sample handles, owned by the caller. */
+} SchedstatCpu;
+
+/**
+ * @brief Structure to hold the scheduler statistics of every CPU.
+ *
+ * The caller keeps one snapshot across reads, so that sample handles survive and the system-wide totals of the
+ * previous read are available to compute the latency over the interval.
+ */
+typedef struct
+{
+    SchedstatCpu* cpus;                                 /**< CPUs, in the order of /proc/schedstat. */
+    size_t cpu_count;                                   /**< Number of valid entries in cpus. */
+    size_t cpu_capacity;                                /**< Number of allocated entries in cpus. */
+    unsigned long long totals[SCHEDSTAT_FIELD_COUNT];   /**< Sum of the counters of every CPU. */
+    unsigned long long previous[SCHEDSTAT_FIELD_COUNT]; /**< totals as of the previous read. */
+    bool has_previous;                                  /**< Whether previous holds a read. */
+    bool unavailable;                                   /**< Set once the file turned out to be missing. */
+} SchedstatSnapshot;
+
+/**
+ * @brief Reads /proc/schedstat into a snapshot.
+ *
+ * Entries whose CPU changed since the previous read, as after a hotplug, have their sample handles reset.
+ *
+ * @param snapshot The snapshot.
+ * @return 0 on success, or -1 if the file is missing, cannot be read or has an unknown format.
+ */
+int read_schedstat_snapshot(SchedstatSnapshot* snapshot);
+
+/**
+ * @brief Returns the mean time a task waited on a run queue before running, between the last two reads.
+ *
+ * @param snapshot The snapshot.
+ * @param latency Pointer to store the latency in seconds.
+ * @return 0 on success, or -1 if there is no previous read or no timeslice ran in between.
+ */
+int schedstat_runqueue_latency(const SchedstatSnapshot* snapshot, double* latency);
+
+/**
+ * @brief Releases the entries of a snapshot.
+ *
+ * @param snapshot The snapshot.
+ */
+void schedstat_snapshot_free(SchedstatSnapshot* snapshot);
+
+#endif // SCHEDSTAT_H
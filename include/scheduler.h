@@ -0,0 +1,258 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+/**
+ * @file scheduler.h
+ * @brief Header file for running collectors at their own intervals on a hashed timer wheel.
+ *
+ * Time advances in fixed ticks delivered by a periodic timerfd armed on CLOCK_MONOTONIC at an absolute start time.
+ * Each collector is stored in the wheel slot of the tick it is due on and is rescheduled relative to that tick, not to
+ * the time it finished running, so its period does not drift with the cost of the collectors. When the scheduler falls
+ * behind, the ticks it missed are still walked in order, but a collector runs only once for them: the periods it missed
+ * entirely are coalesced into that one run and skipped, keeping its phase, rather than replayed.
+ *
+ * When a worker pool is given, collectors run on it instead of on the scheduler thread. Each run must finish before
+ * the collector is due again; a run that misses this deadline is reported once through the timeout callback, and the
+ * collector is skipped until it returns, so a blocked source never delays the other collectors.
+ *
+ * A collector can also watch descriptors that raise POLLPRI, such as PSI triggers; it then runs as soon as one of them
+ * fires, on top of its regular period.
+ *
+ * In adaptive mode, a probe tells after every run whether the metrics of the collector changed. Each run without a
+ * change doubles the interval of the collector, up to a cap, and the first change brings it back to its own interval.
+ *
+ * In lazy mode, chosen collectors leave the wheel and only run when someone asks for their metrics, such as a scrape:
+ * scheduler_collect_stale() runs those whose last run is older than their interval, which becomes their freshness
+ * window, and waits for them. A caller arriving while another one's runs are in flight waits for the same runs instead
+ * of starting new ones, so concurrent scrapes share one collection.
+ *
+ * The set of collectors can be changed while the scheduler runs. Collectors that are removed while a run is in flight
+ * keep their entry until it returns, so a slow run never completes into the entry of another collector.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include "dispatch.h"
+#include "trace.h"
+#include "worker_pool.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#define SCHEDULER_TICK_MS 50        /**< Duration of a wheel tick in milliseconds. */
+#define SCHEDULER_WHEEL_SLOTS 256   /**< Number of wheel slots, must be a power of two. */
+#define SCHEDULER_MAX_WATCHES 8     /**< Maximum number of descriptors watched for events. */
+#define SCHEDULER_LAZY_WAIT_MS 1000 /**< Longest scheduler_collect_stale() waits for the runs in flight. */
+
+/**
+ * @brief Outcome of the last run of a collector, as seen by the adaptive probe.
+ */
+typedef enum
+{
+    COLLECTOR_RUN_NONE,    /**< No run completed since the outcome was last applied. */
+    COLLECTOR_RUN_STABLE,  /**< The run left the metrics unchanged. */
+    COLLECTOR_RUN_CHANGED, /**< The run changed the metrics. */
+} CollectorRunOutcome;
+
+/**
+ * @brief Callback invoked after every run of a collector, from the thread that ran it.
+ */
+typedef void (*collector_run_fn)(collector_fn update_function, const struct timespec* started, uint64_t duration_ns);
+
+/**
+ * @brief Probe invoked after every run of a collector in adaptive mode, from the thread that ran it.
+ *
+ * @return Whether the run changed the metrics of the collector.
+ */
+typedef bool (*collector_changed_fn)(collector_fn update_function);
+
+/**
+ * @brief Predicate telling, in lazy mode, whether a collector runs on demand rather than on the wheel.
+ */
+typedef bool (*collector_lazy_fn)(collector_fn update_function);
+
+/**
+ * @brief Structure to hold a collector scheduled on the wheel.
+ */
+typedef struct ScheduledCollector
+{
+    collector_fn update_function;    /**< Collector to run. */
+    uint64_t interval_ticks;         /**< Current period of the collector in ticks. */
+    uint64_t base_ticks;             /**< Period of the collector in ticks, as set by the dispatch. */
+    atomic_int outcome;              /**< CollectorRunOutcome of the last run, set by the thread that ran it. */
+    uint64_t due_tick;               /**< Tick on which the collector runs next. */
+    uint64_t deadline_tick;          /**< Tick by which the run in flight must finish. */
+    atomic_bool in_flight;           /**< Set while a run is queued or running on the worker pool. */
+    bool timed_out;                  /**< Set once the run in flight has been reported as timed out. */
+    bool active;                     /**< Set while the collector is scheduled, on the wheel or on demand. */
+    bool lazy;                       /**< Set in lazy mode when the collector runs on demand instead of on the wheel. */
+    uint64_t fresh_until_ns;         /**< CLOCK_MONOTONIC time before which a lazy collector is not run again. */
+    size_t watch_count;              /**< Number of watched descriptors running the collector. */
+    collector_run_fn on_run;         /**< Called after every run, may be NULL. */
+    collector_changed_fn probe;      /**< Called after every run in adaptive mode, else NULL. */
+    struct Scheduler* scheduler;     /**< Scheduler owning the entry, told when a lazy run returns. */
+    struct ScheduledCollector* next; /**< Next collector in the same wheel slot. */
+} ScheduledCollector;
+
+/**
+ * @brief Callback invoked when a collector misses its deadline.
+ */
+typedef void (*collector_timeout_fn)(collector_fn update_function);
+
+/**
+ * @brief Callback invoked on the scheduler thread when the input descriptor is readable.
+ */
+typedef void (*scheduler_input_fn)(void* arg);
+
+/**
+ * @brief Structure to hold a descriptor whose events run a collector.
+ */
+typedef struct
+{
+    int fd;                    /**< Watched descriptor, owned by the scheduler. */
+    ScheduledCollector* entry; /**< Collector run on every event. */
+} ScheduledWatch;
+
+/**
+ * @brief Structure to hold the timer wheel.
+ */
+typedef struct Scheduler
+{
+    ScheduledCollector* slots[SCHEDULER_WHEEL_SLOTS]; /**< Collectors hashed by due tick. */
+    ScheduledCollector entries[MAX_COLLECTORS];       /**< Storage for the scheduled collectors. */
+    size_t entry_count;                               /**< Number of used entries. */
+    uint64_t current_tick;                            /**< Last tick processed. */
+    int timer_fd;                                     /**< Periodic timerfd delivering the ticks. */
+    struct timespec start;                            /**< Monotonic time of tick 0. */
+    WorkerPool* pool;                                 /**< Pool running the collectors, or NULL to run inline. */
+    collector_timeout_fn on_timeout;                  /**< Called for every missed deadline, may be NULL. */
+    collector_run_fn on_run;                          /**< Called after every run, may be NULL. */
+    collector_changed_fn probe;                       /**< Adaptive probe, or NULL outside adaptive mode. */
+    uint64_t max_ticks;                               /**< Longest period an adaptive collector backs off to. */
+    ScheduledWatch watches[SCHEDULER_MAX_WATCHES];    /**< Descriptors watched for events. */
+    size_t watch_count;                               /**< Number of used entries in watches. */
+    int input_fd;                                     /**< Descriptor polled for POLLIN, or -1. */
+    scheduler_input_fn on_input;                      /**< Called whenever input_fd is readable. */
+    void* input_arg;                                  /**< Argument passed to on_input. */
+    collector_lazy_fn is_lazy;                        /**< Lazy predicate, or NULL outside lazy mode. */
+    pthread_mutex_t lazy_lock;                        /**< Guards the entries against on-demand callers. */
+    pthread_cond_t lazy_done;                         /**< Signalled whenever a lazy run returns. */
+} Scheduler;
+
+/**
+ * @brief Initializes a scheduler with every collector of a dispatch table.
+ *
+ * Every collector runs on the first tick and then once per interval.
+ *
+ * @param scheduler The scheduler to initialize.
+ * @param dispatch The dispatch table holding the collectors and their intervals.
+ * @param pool Worker pool running the collectors, or NULL to run them on the scheduler thread.
+ * @param on_timeout Callback invoked when a collector misses its deadline, or NULL.
+ * @param on_run Callback invoked after every run with its CLOCK_REALTIME start time and duration, or NULL.
+ * @return 0 on success, or -1 if the timer cannot be created.
+ */
+int scheduler_init(Scheduler* scheduler, const CollectorDispatch* dispatch, WorkerPool* pool,
+                   collector_timeout_fn on_timeout, collector_run_fn on_run);
+
+/**
+ * @brief Replaces the scheduled collectors with those of a dispatch table.
+ *
+ * Collectors missing from the table are taken off the wheel and their watched descriptors are closed. New collectors
+ * run on the next tick. Collectors already scheduled keep their phase, unless their new interval brings their next run
+ * closer.
+ *
+ * Must be called on the thread running the scheduler, e.g. from the input callback.
+ *
+ * @param scheduler The scheduler.
+ * @param dispatch The dispatch table holding the collectors and their intervals.
+ * @return 0 on success, or -1 if too many collectors have runs in flight to schedule every new one.
+ */
+int scheduler_update(Scheduler* scheduler, const CollectorDispatch* dispatch);
+
+/**
+ * @brief Returns the scheduled entry of a collector.
+ *
+ * @param scheduler The scheduler.
+ * @param update_function The collector.
+ * @return The entry, or NULL if the collector is not scheduled.
+ */
+const ScheduledCollector* scheduler_find(const Scheduler* scheduler, collector_fn update_function);
+
+/**
+ * @brief Turns on adaptive mode, where collectors whose metrics do not change are run less and less often.
+ *
+ * Must be called before the scheduler runs.
+ *
+ * @param scheduler The scheduler.
+ * @param probe Called after every run to tell whether the metrics of the collector changed.
+ * @param max_interval_ms Longest interval a collector backs off to; collectors with a longer one keep it.
+ */
+void scheduler_set_adaptive(Scheduler* scheduler, collector_changed_fn probe, unsigned int max_interval_ms);
+
+/**
+ * @brief Turns on lazy mode, where the chosen collectors run on demand through scheduler_collect_stale().
+ *
+ * Must be called before the scheduler runs. Lazy collectors keep running when a watched descriptor fires.
+ *
+ * @param scheduler The scheduler.
+ * @param is_lazy Tells which collectors run on demand; the others stay on the wheel.
+ */
+void scheduler_set_lazy(Scheduler* scheduler, collector_lazy_fn is_lazy);
+
+/**
+ * @brief Runs every lazy collector whose last run is older than its interval and waits for it.
+ *
+ * Can be called from any thread. Runs already in flight, started by another caller, are waited for rather than
+ * started again. A run that misses its deadline is reported through the timeout callback as on the wheel, and is no
+ * longer waited for until it returns.
+ *
+ * @param scheduler The scheduler.
+ * @return 0 on success or outside lazy mode, or -1 if a run was still in flight after SCHEDULER_LAZY_WAIT_MS.
+ */
+int scheduler_collect_stale(Scheduler* scheduler);
+
+/**
+ * @brief Runs a callback on the scheduler thread whenever a descriptor is readable.
+ *
+ * The descriptor stays owned by the caller, which must keep it open until the scheduler is destroyed.
+ *
+ * @param scheduler The scheduler.
+ * @param fd The descriptor, or -1 to stop polling one.
+ * @param on_input The callback, which must consume the input.
+ * @param arg Argument passed to the callback.
+ */
+void scheduler_set_input(Scheduler* scheduler, int fd, scheduler_input_fn on_input, void* arg);
+
+/**
+ * @brief Runs a scheduled collector whenever a descriptor raises POLLPRI.
+ *
+ * The scheduler takes ownership of the descriptor, including on failure, and stops watching it once it reports an
+ * error.
+ *
+ * @param scheduler The scheduler.
+ * @param fd The descriptor.
+ * @param update_function The collector, which must be scheduled.
+ * @return 0 on success, or -1 if the collector is not scheduled or too many descriptors are watched.
+ */
+int scheduler_watch(Scheduler* scheduler, int fd, collector_fn update_function);
+
+/**
+ * @brief Runs the collectors due on the next ticks, or watching a descriptor that fired.
+ *
+ * Blocks until the timer expires, a watched descriptor fires or the input descriptor is readable, then processes every
+ * tick that elapsed since the previous call.
+ *
+ * @param scheduler The scheduler.
+ * @return 0 on success, or -1 if reading the timer fails.
+ */
+int scheduler_run_once(Scheduler* scheduler);
+
+/**
+ * @brief Releases the timer and the watched descriptors of a scheduler.
+ *
+ * @param scheduler The scheduler to destroy.
+ */
+void scheduler_destroy(Scheduler* scheduler);
+
+#endif // SCHEDULER_H
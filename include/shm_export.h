@@ -0,0 +1,113 @@
+#ifndef SHM_EXPORT_H
+#define SHM_EXPORT_H
+
+/**
+ * @file shm_export.h
+ * @brief Header file for publishing the current value of every series in a POSIX shared memory segment.
+ *
+ * Local consumers can map the segment read-only and read the latest numbers without any system call and without
+ * parsing the text exposition. The segment starts with a fixed header followed by fixed-size entries, one per series,
+ * and is guarded by a sequence lock: the sequence is odd while the monitor rewrites the snapshot. A reader copies what
+ * it needs as follows:
+ *
+ *     1. Load sequence with acquire ordering; retry while it is odd.
+ *     2. Copy the header fields and entries it needs. If capacity entries no longer fit in its mapping, map the
+ *        segment again at its new size (fstat) and start over.
+ *     3. Issue an acquire fence and load sequence again; the copy is consistent if it did not change.
+ *
+ * Entries are written in registration order, so a series keeps its index until the set of series changes. The segment
+ * is unlinked when the monitor closes it or a new monitor replaces it; readers can tell from fstat() reporting no link
+ * and should open it again.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHM_EXPORT_NAME_ENV "MONITOR_SHM_NAME" /**< Name of the segment, such as /monitor; unset for no segment. */
+#define SHM_EXPORT_MAGIC 0x4d4f4e53u           /**< "MONS", the first four bytes of the segment. */
+#define SHM_EXPORT_VERSION 1                   /**< Version of the layout, bumped on incompatible changes. */
+#define SHM_EXPORT_SERIES_SIZE 240             /**< Bytes of a series name, including its terminating NUL. */
+#define SHM_EXPORT_INITIAL_CAPACITY 256        /**< Entries of a new segment. */
+#define SHM_EXPORT_MAX_CAPACITY (1 << 20)      /**< Upper bound on the number of entries. */
+#define SHM_EXPORT_INTERVAL_MS 250             /**< Interval at which changes are published. */
+
+#define SHM_EXPORT_INTEGER 0x1u    /**< Entry flag: the value is an exact integer, held in u_value. */
+#define SHM_EXPORT_TRUNCATED 0x2u  /**< Entry flag: the series name did not fit and was cut. */
+#define SHM_EXPORT_INCOMPLETE 0x1u /**< Header flag: some series did not fit in the segment and were left out. */
+
+/**
+ * @brief Structure to hold one series of the segment.
+ */
+typedef struct
+{
+    char series[SHM_EXPORT_SERIES_SIZE]; /**< Metric name and label set as in the text exposition, NUL terminated. */
+    uint32_t flags;                      /**< SHM_EXPORT_INTEGER and SHM_EXPORT_TRUNCATED. */
+    uint32_t reserved;                   /**< Zero. */
+    double value;                        /**< Value of the series, unless SHM_EXPORT_INTEGER is set. */
+    uint64_t u_value;                    /**< Value of the series if SHM_EXPORT_INTEGER is set. */
+} ShmExportEntry;
+
+/**
+ * @brief Structure to hold the header at the start of the segment.
+ */
+typedef struct
+{
+    uint32_t magic;            /**< SHM_EXPORT_MAGIC, written once the segment is initialized. */
+    uint32_t version;          /**< SHM_EXPORT_VERSION. */
+    _Atomic uint64_t sequence; /**< Sequence lock, odd while the snapshot is being written. */
+    uint64_t capacity;         /**< Number of entries the segment holds. */
+    uint64_t entry_count;      /**< Number of valid entries. */
+    uint64_t generation;       /**< Sample generation of the snapshot; it only changes along with the values. */
+    int64_t timestamp_ns;      /**< CLOCK_REALTIME time of the snapshot in nanoseconds. */
+    uint32_t entry_size;       /**< sizeof(ShmExportEntry). */
+    uint32_t flags;            /**< SHM_EXPORT_INCOMPLETE. */
+    uint64_t reserved;         /**< Zero. */
+    ShmExportEntry entries[];  /**< The series. */
+} ShmExportHeader;
+
+/**
+ * @brief Structure to hold the writer side of the segment.
+ */
+typedef struct
+{
+    const char* name;        /**< Name of the segment. */
+    int fd;                  /**< Descriptor of the segment, or -1. */
+    ShmExportHeader* header; /**< Mapping of the segment. */
+    size_t mapped_size;      /**< Size of the mapping in bytes. */
+    uint64_t generation;     /**< Sample generation of the last snapshot. */
+    bool published;          /**< Whether a snapshot was published. */
+    bool incomplete;         /**< Set when a series did not fit during the current snapshot. */
+} ShmExport;
+
+/**
+ * @brief Creates the segment, replacing any segment of the same name.
+ *
+ * @param shm The writer to initialize.
+ * @param name Name of the segment, as accepted by shm_open(). The pointer is stored.
+ * @return 0 on success, or -1 in case of error.
+ */
+int shm_export_open(ShmExport* shm, const char* name);
+
+/**
+ * @brief Copies every series of the default registry into the segment if any of them changed.
+ *
+ * The segment grows as needed. Only one thread may publish at a time.
+ *
+ * @param shm The writer.
+ * @return 0 on success, or -1 in case of error.
+ */
+int shm_export_publish(ShmExport* shm);
+
+/**
+ * @brief Unmaps and unlinks the segment.
+ *
+ * @param shm The writer.
+ */
+void shm_export_close(ShmExport* shm);
+
+#endif // SHM_EXPORT_H
@@ -0,0 +1,43 @@
+#ifndef SOURCE_CACHE_H
+#define SOURCE_CACHE_H
+
+/**
+ * @file source_cache.h
+ * @brief Header file for reading /proc and /sys sources through persistent file descriptors.
+ *
+ * Every source is opened once and kept open. Each read goes through prom_procfs_read(), which rewinds it with pread()
+ * at offset 0 and reads it in large blocks into a buffer owned by the cache, so the kernel regenerates the contents
+ * without paying for open() and close() on every cycle. A
+ * source is only reopened when the cached descriptor goes stale, for example after hwmon devices are renumbered.
+ *
+ * Every thread has its own cache, so collectors running on different workers never share a descriptor or a buffer.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <sys/types.h>
+
+#define MAX_SOURCES 32                /**< Maximum number of sources kept open by the cache. */
+#define SOURCE_INITIAL_BUFFER 4096    /**< Initial buffer size for a source without a size hint. */
+#define SOURCE_MAX_BUFFER (1 << 22)   /**< Upper bound on the buffer size of a single source. */
+
+/**
+ * @brief Reads the full contents of a source.
+ *
+ * The returned buffer is owned by the cache, is NUL-terminated and stays valid until the next read of the same
+ * source. The buffer grows when the contents do not fit, so large files such as /proc/stat on many-core hosts are
+ * always read completely.
+ *
+ * @param path Path of the source. The pointer is stored, so it must outlive the cache (string literals are fine).
+ * @param len Pointer to store the number of bytes read, or NULL.
+ * @return The contents of the source, or NULL in case of error.
+ */
+const char* source_cache_read(const char* path, size_t* len);
+
+/**
+ * @brief Closes every descriptor cached by the calling thread and releases its buffers.
+ */
+void source_cache_close_all(void);
+
+#endif // SOURCE_CACHE_H
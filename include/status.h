@@ -0,0 +1,60 @@
+#ifndef STATUS_H
+#define STATUS_H
+
+/**
+ * @file status.h
+ * @brief Header file for the in-memory status of the monitor, served as /status and /catalog.
+ *
+ * The status message, the selected metrics and the last run of every collector are kept in memory and rendered as
+ * JSON on the HTTP daemon whenever they are asked for, so a supervisor polls them without any file being rewritten:
+ *
+ *     /status    {"status", "updated", "selected_metrics": [...], "collectors": [{"name", "last_run",
+ *                "duration_ms", "runs"}]}, timestamps in seconds since the epoch.
+ *     /catalog   {"metrics": [{"name", "description", "type", "collector", "interval_ms", "labels", "selected"}]}
+ *
+ * Every function may be called from any thread.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include "dispatch.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define STATUS_MESSAGE_SIZE 256 /**< Longest status message kept, including the NUL. */
+
+/**
+ * @brief Replaces the status message.
+ *
+ * @param status The new message.
+ */
+void status_set(const char* status);
+
+/**
+ * @brief Replaces the selected metrics.
+ *
+ * @param selected Whether each entry of all_metrics is selected.
+ * @param count Number of entries in selected.
+ */
+void status_set_selection(const bool* selected, size_t count);
+
+/**
+ * @brief Records a run of a collector; matches collector_run_fn.
+ *
+ * @param update_function The collector.
+ * @param started CLOCK_REALTIME time the run started at.
+ * @param duration_ns Duration of the run in nanoseconds.
+ */
+void status_record_run(collector_fn update_function, const struct timespec* started, uint64_t duration_ns);
+
+/**
+ * @brief Adds the /status and /catalog endpoints to the HTTP daemon, which must not be started yet.
+ *
+ * @return 0 on success, or -1 in case of error.
+ */
+int status_add_endpoints(void);
+
+#endif // STATUS_H
@@ -0,0 +1,68 @@
+#ifndef SYSROOT_H
+#define SYSROOT_H
+
+/**
+ * @file sysroot.h
+ * @brief Header file for reading /proc and /sys from a captured snapshot instead of the live host.
+ *
+ * When SYSROOT_ENV names a directory, every /proc and /sys path read by the collectors is looked up under it, so a
+ * snapshot copied from another host (for example, a 256-core machine running 50k processes) replays through the same
+ * readers. When it names an uncompressed tar archive, the archive is first extracted into a private directory under
+ * TMPDIR, which is removed again when the process exits.
+ *
+ * procfs files report a size of zero, so a snapshot must be captured by copying their contents (for example with cat
+ * or cp) before it is archived; tar run directly on /proc stores empty files.
+ *
+ * Sources that have no file to replay keep reading the live host: statvfs() of the mounted file systems and the
+ * netlink link dump, which is skipped in favour of /proc/net/dev. PSI triggers are not armed on a snapshot.
+ *
+ * @date 15/10/2026
+ * @author 1v6n
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SYSROOT_ENV "MONITOR_SYSROOT"              /**< Snapshot holding proc/ and sys/; unset for live. */
+#define SYSROOT_TEMPLATE "monitor-sysroot-XXXXXX" /**< Name of the directory an archive is extracted to. */
+#define TAR_BLOCK_SIZE 512                        /**< Size of a tar header and of a block of contents. */
+
+/**
+ * @brief Selects the root the /proc and /sys paths are read from, as named by SYSROOT_ENV.
+ *
+ * Must be called before any collector runs. Leaves the live host selected if SYSROOT_ENV is unset or cannot be used.
+ *
+ * @return 0 on success, or -1 if SYSROOT_ENV is set but cannot be used.
+ */
+int sysroot_init(void);
+
+/**
+ * @brief Tells whether the paths are read from a snapshot rather than the live host.
+ */
+bool sysroot_active(void);
+
+/**
+ * @brief Returns the path a /proc or /sys path is read from.
+ *
+ * @param path The absolute path on the live host.
+ * @param buffer Buffer to build the path in when a snapshot is replayed.
+ * @param size Size of the buffer in bytes.
+ * @return path itself on the live host, buffer when a snapshot is replayed, or NULL if the path does not fit.
+ */
+const char* sysroot_path(const char* path, char* buffer, size_t size);
+
+/**
+ * @brief Extracts an uncompressed tar archive into a directory.
+ *
+ * Regular files, directories and symbolic links are extracted, including GNU long names and pax paths. Entries whose
+ * name is absolute or goes up with "..", and links whose target is absolute or leaves the directory, are skipped.
+ * Entries are never written through a symbolic link, so an archive cannot reach outside the directory.
+ *
+ * @param archive Path of the archive.
+ * @param directory Existing directory to extract into.
+ * @return 0 on success, or -1 in case of error.
+ */
+int sysroot_extract(const char* archive, const char* directory);
+
+#endif // SYSROOT_H
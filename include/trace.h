@@ -0,0 +1,91 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/**
+ * @file trace.h
+ * @brief Header file for the per-event tracing of collector runs and scrapes, compiled in with MONITOR_TRACING.
+ *
+ * The histograms of instrumentation.h show how long runs take in aggregate; finding the run that caused a jitter needs
+ * every event. Built with MONITOR_TRACING, the monitor offers two ways to get them:
+ *
+ * - USDT probes of the "monitor" provider, collector__start and collector__done, around every collector run, with the
+ *   address of the collector as argument. The client library adds its own with PROM_TRACE (map resizes and scrapes).
+ *   They need sys/sdt.h and cost a nop until a tracer attaches.
+ * - An in-process trace: every collector run and every scrape is recorded in a lock-free single-producer,
+ *   single-consumer ring owned by the thread it ran on, and the "trace <path>" control command drains the rings into a
+ *   Chrome trace JSON file, to be opened in chrome://tracing or Perfetto. When a ring is full, new events are dropped
+ *   and counted until it is drained.
+ *
+ * Without MONITOR_TRACING the macros below expand to nothing and trace_dump() only reports that tracing is off.
+ *
+ * @date 15/10/2026
+ * @author 1v6n
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#define TRACE_RING_SIZE 4096  /**< Events held by a ring before new ones are dropped, a power of two. */
+#define TRACE_MAX_THREADS 64  /**< Most threads that can record events; later threads record nothing. */
+
+/**
+ * @brief Kinds of traced events.
+ */
+typedef enum
+{
+    TRACE_COLLECTOR,     /**< A collector run; the subject is the collector. */
+    TRACE_SCRAPE_RENDER, /**< The render of a scrape; the value is the body size in bytes. */
+    TRACE_SCRAPE_SEND,   /**< The send of a scrape; the value is 1 if it completed. */
+} TraceKind;
+
+#ifdef MONITOR_TRACING
+
+#if defined(__has_include) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define TRACE_PROBE1(name, a) DTRACE_PROBE1(monitor, name, a)
+#else
+#define TRACE_PROBE1(name, a) ((void)0)
+#endif
+
+#define TRACE_RECORD(kind, subject, start_ns, duration_ns, value)                                                     \
+    trace_record(kind, subject, start_ns, duration_ns, value)
+
+#else
+
+#define TRACE_PROBE1(name, a) ((void)0)
+#define TRACE_RECORD(kind, subject, start_ns, duration_ns, value) ((void)0)
+
+#endif // MONITOR_TRACING
+
+/**
+ * @brief Returns the CLOCK_REALTIME time in nanoseconds, as the events are stamped.
+ */
+static inline uint64_t trace_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Records one event in the ring of the calling thread. Use TRACE_RECORD, which compiles out without tracing.
+ *
+ * @param kind Kind of the event.
+ * @param subject Collector the event is about, or NULL.
+ * @param start_ns CLOCK_REALTIME start of the event, in nanoseconds.
+ * @param duration_ns Length of the event, in nanoseconds.
+ * @param value Value attached to the event, as described by kind.
+ */
+void trace_record(TraceKind kind, void (*subject)(void), uint64_t start_ns, uint64_t duration_ns, uint64_t value);
+
+/**
+ * @brief Drains every ring into a Chrome trace JSON file.
+ *
+ * Must only be called from one thread at a time, normally the scheduler thread running the control commands.
+ *
+ * @param path Path of the file to write, replaced if it exists.
+ * @return 0 on success, or -1 in case of error or when built without MONITOR_TRACING.
+ */
+int trace_dump(const char* path);
+
+#endif // TRACE_H
@@ -0,0 +1,77 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+/**
+ * @file worker_pool.h
+ * @brief Header file for running collectors concurrently on a small pool of worker threads.
+ *
+ * The pool owns a fixed number of threads fed from a bounded FIFO queue. It does not interrupt a task that blocks;
+ * the scheduler is responsible for not queueing the same collector again while a previous run is still in flight, so
+ * a hung collector can hold at most one worker.
+ *
+ * @date 14/10/2026
+ * @author 1v6n
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define WORKER_COUNT 4       /**< Number of worker threads in the pool. */
+#define WORKER_QUEUE_SIZE 64 /**< Maximum number of queued tasks. */
+
+/**
+ * @brief Function run by a worker thread.
+ */
+typedef void (*worker_task_fn)(void* arg);
+
+/**
+ * @brief Structure to hold a queued task.
+ */
+typedef struct
+{
+    worker_task_fn function; /**< Function to run. */
+    void* arg;               /**< Argument passed to function. */
+} WorkerTask;
+
+/**
+ * @brief Structure to hold the worker pool.
+ */
+typedef struct
+{
+    pthread_t threads[WORKER_COUNT];     /**< Worker threads. */
+    size_t thread_count;                 /**< Number of started threads. */
+    WorkerTask queue[WORKER_QUEUE_SIZE]; /**< Ring buffer of pending tasks. */
+    size_t head;                         /**< Index of the next task to run. */
+    size_t count;                        /**< Number of pending tasks. */
+    pthread_mutex_t mutex;               /**< Protects the queue and stopping. */
+    pthread_cond_t cond;                 /**< Signalled when a task is queued or the pool stops. */
+    bool stopping;                       /**< Set when the pool is being destroyed. */
+} WorkerPool;
+
+/**
+ * @brief Starts the worker threads of a pool.
+ *
+ * @param pool The pool to initialize.
+ * @return 0 on success, or -1 if no thread could be started.
+ */
+int worker_pool_init(WorkerPool* pool);
+
+/**
+ * @brief Queues a task for the next idle worker.
+ *
+ * @param pool The worker pool.
+ * @param function Function to run.
+ * @param arg Argument passed to function.
+ * @return 0 on success, or -1 if the queue is full.
+ */
+int worker_pool_submit(WorkerPool* pool, worker_task_fn function, void* arg);
+
+/**
+ * @brief Stops the pool and joins its threads once the pending tasks are done.
+ *
+ * @param pool The pool to destroy.
+ */
+void worker_pool_destroy(WorkerPool* pool);
+
+#endif // WORKER_POOL_H
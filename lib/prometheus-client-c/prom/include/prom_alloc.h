@@ -1,22 +1,27 @@
-/*
-Copyright 2019-2020 DigitalOcean Inc.
-
-Licensed under the Apache License, Version 2.0 (the "License");
-you may not use this file except in compliance with the License.
-You may obtain a copy of the License at
-
-     http://www.apache.org/licenses/LICENSE-2.0
-
-Unless required by applicable law or agreed to in writing, software
-distributed under the License is distributed on an "AS IS" BASIS,
-WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-See the License for the specific language governing permissions and
-limitations under the License.
-*/
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
 
 /**
  * @file prom_alloc.h
  * @brief memory management
+ *
+ * Every allocation made by the library goes through the prom_malloc, prom_calloc, prom_realloc, prom_strdup and
+ * prom_free macros.
+ * By default they call a pluggable prom_allocator_t, which is libc unless prom_allocator_set selects another backend
+ * such as the built-in slab allocator. The macros may still be redefined at build time to bypass the interface.
  */
 
 #ifndef PROM_ALLOC_H
@@ -26,23 +31,92 @@ limitations under the License.
 #include <string.h>
 
 /**
- * @brief Redefine this macro if you wish to override it. The default value is malloc.
+ * @brief A memory allocator backend
+ *
+ * The functions follow the contracts of malloc, calloc, realloc and free and must be safe to call from any thread.
+ * Memory may be freed by a thread other than the one which allocated it.
+ */
+typedef struct prom_allocator {
+  void *(*malloc)(size_t size);               /**< Allocates size bytes */
+  void *(*realloc)(void *ptr, size_t size);   /**< Resizes an allocation, or allocates if ptr is NULL */
+  void (*free)(void *ptr);                    /**< Releases an allocation; NULL is ignored */
+  void *(*calloc)(size_t count, size_t size); /**< Allocates zeroed memory; NULL uses malloc and memset */
+} prom_allocator_t;
+
+/**
+ * @brief Selects the allocator backend used by the library
+ *
+ * Memory cannot move between backends, so the backend must be selected before the library allocates anything, that
+ * is before the first registry, metric or collector is created.
+ *
+ * @param allocator The backend. NULL selects libc. The pointer must stay valid for the lifetime of the process.
+ * @return A non-zero integer value if the library already allocated memory with another backend
+ */
+int prom_allocator_set(const prom_allocator_t *allocator);
+
+/**
+ * @brief Returns the allocator backend in use
+ */
+const prom_allocator_t *prom_allocator_get(void);
+
+/**
+ * @brief Returns the built-in slab allocator backend
+ *
+ * Requests of up to 512 bytes, which covers metrics, samples, map and linked list nodes and their keys, are served
+ * from size classes carved out of 64KiB chunks. Objects created together therefore sit next to each other instead of
+ * being scattered across the heap, which keeps exposition walking few cache lines. Freed blocks go to a free list of
+ * the calling thread, so neither allocating nor freeing takes a lock. Chunks are never returned to the system, which
+ * suits the long-lived objects of a registry. Larger requests are forwarded to libc.
+ */
+const prom_allocator_t *prom_allocator_slab(void);
+
+/**
+ * @brief Returns the number of allocations the calling thread made through the allocator backend
+ *
+ * The counter only moves on the calling thread, so the difference between two calls counts the allocations made by the
+ * work in between, such as one render. Allocations served from an arena scope are not counted.
+ */
+unsigned long long prom_alloc_thread_allocations(void);
+
+void *prom_alloc_malloc(size_t size);
+void *prom_alloc_calloc(size_t count, size_t size);
+void *prom_alloc_realloc(void *ptr, size_t size);
+char *prom_alloc_strdup(const char *str);
+void prom_alloc_free(void *ptr);
+
+#ifndef prom_malloc
+/**
+ * @brief Redefine this macro if you wish to override it. The default value is prom_alloc_malloc.
+ */
+#define prom_malloc prom_alloc_malloc
+#endif
+
+#ifndef prom_calloc
+/**
+ * @brief Redefine this macro if you wish to override it. The default value is prom_alloc_calloc.
  */
-#define prom_malloc malloc
+#define prom_calloc prom_alloc_calloc
+#endif
 
+#ifndef prom_realloc
 /**
- * @brief Redefine this macro if you wish to override it. The default value is realloc.
+ * @brief Redefine this macro if you wish to override it. The default value is prom_alloc_realloc.
  */
-#define prom_realloc realloc
+#define prom_realloc prom_alloc_realloc
+#endif
 
+#ifndef prom_strdup
 /**
- * @brief Redefine this macro if you wish to override it. The default value is strdup.
+ * @brief Redefine this macro if you wish to override it. The default value is prom_alloc_strdup.
  */
-#define prom_strdup strdup
+#define prom_strdup prom_alloc_strdup
+#endif
 
+#ifndef prom_free
 /**
- * @brief Redefine this macro if you wish to override it. The default value is free.
+ * @brief Redefine this macro if you wish to override it. The default value is prom_alloc_free.
  */
-#define prom_free free
+#define prom_free prom_alloc_free
+#endif
 
 #endif  // PROM_ALLOC_H
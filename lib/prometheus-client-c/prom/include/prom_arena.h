@@ -0,0 +1,82 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file prom_arena.h
+ * @brief Resettable arenas for transient allocations
+ */
+
+#ifndef PROM_ARENA_H
+#define PROM_ARENA_H
+
+#include <stddef.h>
+
+/**
+ * @brief A bump allocator whose allocations are all released at once by prom_arena_reset
+ */
+typedef struct prom_arena prom_arena_t;
+
+/**
+ * @brief Constructs a prom_arena_t*
+ * @param chunk_size Size in bytes of the chunks the arena hands allocations out of. The first chunk is kept across
+ * resets, so it should fit the transient allocations of one cycle.
+ * @return The constructed prom_arena_t*, or NULL upon failure
+ */
+prom_arena_t *prom_arena_new(size_t chunk_size);
+
+/**
+ * @brief Destroys a prom_arena_t*, releasing every allocation made from it
+ * @return A non-zero integer value upon failure
+ */
+int prom_arena_destroy(prom_arena_t *self);
+
+/**
+ * @brief Allocates size bytes from the arena, aligned for any type
+ * @return The allocation, or NULL upon failure
+ */
+void *prom_arena_alloc(prom_arena_t *self, size_t size);
+
+/**
+ * @brief Copies a string into the arena
+ * @return The copy, or NULL upon failure
+ */
+char *prom_arena_strdup(prom_arena_t *self, const char *str);
+
+/**
+ * @brief Releases every allocation made from the arena
+ *
+ * The first chunk is kept, so an arena reset once per cycle stops touching the backend allocator once it has grown to
+ * fit a cycle.
+ */
+void prom_arena_reset(prom_arena_t *self);
+
+/**
+ * @brief Routes prom_malloc, prom_realloc and prom_strdup of the calling thread to the arena until prom_arena_leave
+ *
+ * prom_free of memory owned by the arena does nothing while the scope is active, so code written against prom_malloc
+ * and prom_free can build and tear down transient structures without reaching the backend allocator. Nothing
+ * allocated inside the scope may outlive it. Scopes do not nest.
+ *
+ * @return A non-zero integer value if the calling thread is already inside a scope
+ */
+int prom_arena_enter(prom_arena_t *self);
+
+/**
+ * @brief Ends the scope started by prom_arena_enter on the calling thread
+ */
+void prom_arena_leave(void);
+
+#endif  // PROM_ARENA_H
@@ -22,6 +22,11 @@ limitations under the License.
 #ifndef PROM_REGISTRY_H
 #define PROM_REGISTRY_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
 #include "prom_collector.h"
 #include "prom_metric.h"
 
@@ -30,6 +35,22 @@ limitations under the License.
  */
 typedef struct prom_collector_registry prom_collector_registry_t;
 
+/**
+ * @brief The exposition formats a registry can be rendered in
+ *
+ * Reference: https://prometheus.io/docs/instrumenting/exposition_formats/
+ */
+typedef enum prom_exposition_format {
+  PROM_EXPOSITION_TEXT = 0,    /**< Prometheus text format, version 0.0.4 */
+  PROM_EXPOSITION_OPENMETRICS, /**< OpenMetrics text format, version 1.0.0 */
+  PROM_EXPOSITION_PROTOBUF,    /**< Length-delimited io.prometheus.client.MetricFamily protobuf messages */
+} prom_exposition_format_t;
+
+/**
+ * @brief The number of values of prom_exposition_format_t
+ */
+#define PROM_EXPOSITION_FORMAT_COUNT 3
+
 /**
  * @brief Initialize the default registry by calling prom_collector_registry_init within your program. You MUST NOT
  * modify this value.
@@ -80,13 +101,26 @@ prom_metric_t *prom_collector_registry_must_register_metric(prom_metric_t *metri
  * @brief Registers a metric with the default collector on PROM_DEFAULT_COLLECTOR_REGISTRY. Returns an non-zero integer
  * value on failure.
  *
- * See prom_collector_registry_must_register_metric.
+ * See prom_collector_registry_must_register_metric. Renders in progress are waited for.
  *
  * @param metric The metric to register on PROM_DEFAULT_COLLECTOR_REGISTRY*
  * @return A non-zero integer value upon failure
  */
 int prom_collector_registry_register_metric(prom_metric_t *metric);
 
+/**
+ * @brief Unregisters a metric from the default collector on PROM_DEFAULT_COLLECTOR_REGISTRY without destroying it.
+ * Returns a non-zero integer value on failure.
+ *
+ * The metric leaves the exposition with the next render. It stays valid, so threads still updating it need not be
+ * stopped first, and it may be registered again with prom_collector_registry_register_metric, keeping its samples.
+ * Renders in progress are waited for; open streams leave out the rest of the default collector.
+ *
+ * @param metric The metric to unregister from PROM_DEFAULT_COLLECTOR_REGISTRY*
+ * @return A non-zero integer value upon failure
+ */
+int prom_collector_registry_unregister_metric(prom_metric_t *metric);
+
 /**
  * @brief Register a collector with the given registry. Returns a non-zero integer value on failure.
  * @param self The target prom_collector_registry_t*
@@ -99,6 +133,8 @@ int prom_collector_registry_register_collector(prom_collector_registry_t *self,
  * @brief Returns a string in the default metric exposition format. The string MUST be freed to avoid unnecessary heap
  * memory growth.
  *
+ * The string is a copy of the render cache; see prom_collector_registry_render_acquire to avoid the copy.
+ *
  * Reference: https://prometheus.io/docs/instrumenting/exposition_formats/
  *
  * @param self The target prom_collector_registry_t*
@@ -106,11 +142,181 @@ int prom_collector_registry_register_collector(prom_collector_registry_t *self,
  */
 const char *prom_collector_registry_bridge(prom_collector_registry_t *self);
 
+/**
+ * @brief Returns the exposition of the registry from its render cache, without copying it.
+ *
+ * The registry keeps the last rendered exposition together with the sample generation it was rendered at. Setting,
+ * adding to or subtracting from any sample, creating a sample and registering a metric or collector all advance the
+ * generation; the exposition is only rendered again when the generation moved since the cached copy was built.
+ *
+ * The returned string is shared between callers. It MUST NOT be modified or freed; pass it to
+ * prom_collector_registry_render_release once done. It stays valid until then, even if a newer render replaces it.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param len If not NULL, set to the length of the returned string in bytes
+ * @return The string in the default metric exposition format, or NULL upon failure
+ */
+const char *prom_collector_registry_render_acquire(prom_collector_registry_t *self, size_t *len);
+
+/**
+ * @brief Returns the exposition of the registry in the given format from its render cache, without copying it.
+ *
+ * Each format is cached on its own, with the same rules as prom_collector_registry_render_acquire. The protobuf format
+ * is binary and may contain NUL bytes, so its length MUST be taken from len rather than from strlen.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param format The exposition format to render
+ * @param len If not NULL, set to the length of the returned data in bytes
+ * @return The exposition, or NULL upon failure. Release it with prom_collector_registry_render_release.
+ */
+const char *prom_collector_registry_render_acquire_format(prom_collector_registry_t *self,
+                                                          prom_exposition_format_t format, size_t *len);
+
+/**
+ * @brief Releases a string returned by prom_collector_registry_render_acquire or
+ * prom_collector_registry_render_acquire_format.
+ * @param render The string to release. NULL is ignored.
+ */
+void prom_collector_registry_render_release(const char *render);
+
+/**
+ * @brief Returns the sample generation a string returned by prom_collector_registry_render_acquire was rendered at.
+ *
+ * Two renders of the same registry at the same generation hold the same exposition, so the generation can key caches
+ * of data derived from the render, such as a compressed copy.
+ *
+ * @param render A string returned by prom_collector_registry_render_acquire and not yet released
+ * @return The generation of the render
+ */
+uint64_t prom_collector_registry_render_generation(const char *render);
+
+/**
+ * @brief Returns the metric family of the named metric within a render, without copying it.
+ *
+ * Every render keeps an index from metric name to the bytes of its family, sorted by name, so a filtered scrape only
+ * copies the requested families out of the cached render instead of formatting the registry. In the protobuf format a
+ * family is one length-delimited MetricFamily message; families without samples are not indexed there. The index
+ * holds its own copies of the names, so a render stays searchable after its metrics are unregistered and destroyed.
+ *
+ * @param render A string returned by prom_collector_registry_render_acquire_format and not yet released
+ * @param name The name of the metric
+ * @param len Set to the length of the family in bytes
+ * @return A pointer into render, or NULL if the render holds no family of that name
+ */
+const char *prom_collector_registry_render_find(const char *render, const char *name, size_t *len);
+
+/**
+ * @brief A prom_collector_registry_stream_t renders a registry incrementally, a few samples at a time
+ */
+typedef struct prom_collector_registry_stream prom_collector_registry_stream_t;
+
+/**
+ * @brief Starts an incremental render of the registry that bypasses the render cache.
+ *
+ * Collectors, metrics and samples are walked as the stream is read, so memory stays bounded by the read size plus the
+ * longest sample (or, in the protobuf format, the longest metric family) however many series are registered. Unlike
+ * prom_collector_registry_render_acquire, the stream cannot retry on concurrent updates: a batch of gauge updates
+ * published while it is read may be seen half applied. Collectors MUST NOT be registered while a stream is open.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param format The exposition format to render
+ * @return The stream, or NULL upon failure. It MUST be destroyed with prom_collector_registry_stream_destroy.
+ */
+prom_collector_registry_stream_t *prom_collector_registry_stream_new(prom_collector_registry_t *self,
+                                                                     prom_exposition_format_t format);
+
+/**
+ * @brief Reads up to max bytes of the exposition into buf.
+ * @param self The target prom_collector_registry_stream_t*
+ * @param buf The destination buffer
+ * @param max The size of buf in bytes
+ * @return The number of bytes read, 0 once the whole exposition was read, or -1 upon failure
+ */
+ssize_t prom_collector_registry_stream_read(prom_collector_registry_stream_t *self, char *buf, size_t max);
+
+/**
+ * @brief Destroys a stream returned by prom_collector_registry_stream_new. NULL is ignored.
+ */
+void prom_collector_registry_stream_destroy(prom_collector_registry_stream_t *self);
+
+/**
+ * @brief The current value of one counter or gauge series, as passed to a prom_collector_registry_visit_fn
+ */
+typedef struct prom_sample_view {
+  const char *series; /**< Metric name and label set, as in the text exposition; not NUL terminated */
+  size_t series_len;  /**< Length of series in bytes */
+  bool integer;       /**< Whether the series holds an exact integer, in u_value rather than value */
+  double value;       /**< The value of the series, unless integer is set */
+  uint64_t u_value;   /**< The value of the series if integer is set */
+} prom_sample_view_t;
+
+/**
+ * @brief Called on every series visited by prom_collector_registry_visit_samples
+ * @param index Position of the series within the current pass, starting at 0
+ * @param view The series; its pointers are only valid during the call
+ * @param arg The argument given to prom_collector_registry_visit_samples
+ */
+typedef void prom_collector_registry_visit_fn(size_t index, const prom_sample_view_t *view, void *arg);
+
+/**
+ * @brief Calls a function on the current value of every counter and gauge series of the registry.
+ *
+ * This reads the same values as a render without formatting them, for exporters that keep their own binary copy.
+ * Like a render, the walk starts over if a batch of gauge updates is published meanwhile, so that a batch is never
+ * seen half applied; each pass starts again at index 0, and only the series of the last pass are current. Histograms
+ * and summaries are skipped.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param fn The function to call
+ * @param arg Argument passed to fn
+ * @param count If not NULL, set to the number of series of the last pass
+ * @return A non-zero integer value upon failure
+ */
+int prom_collector_registry_visit_samples(prom_collector_registry_t *self, prom_collector_registry_visit_fn *fn,
+                                          void *arg, size_t *count);
+
+/**
+ * @brief Calls a function on the current value of every series of one counter or gauge.
+ *
+ * Like prom_collector_registry_visit_samples, but for a single metric, so that a caller interested in a few metrics
+ * does not walk the whole registry. The metric need not be registered.
+ *
+ * @param metric The counter or gauge
+ * @param fn The function to call
+ * @param arg Argument passed to fn
+ * @param count If not NULL, set to the number of series of the last pass
+ * @return A non-zero integer value upon failure
+ */
+int prom_metric_visit_samples(prom_metric_t *metric, prom_collector_registry_visit_fn *fn, void *arg, size_t *count);
+
+/**
+ * @brief Calls prom_metric_sweep on every metric of the registry, evicting the idle series of those with a TTL.
+ *
+ * The metrics are walked without running the collect functions of their collectors. Renders wait for the sweep, which
+ * only holds the lock of a metric while it walks the series of that metric.
+ *
+ * @param self The target prom_collector_registry_t*
+ * @param evicted If not NULL, set to the number of series evicted
+ * @return A non-zero integer value upon failure
+ */
+int prom_collector_registry_sweep(prom_collector_registry_t *self, size_t *evicted);
+
+/**
+ * @brief Returns the current sample generation, which moves whenever a render would change, as described for
+ * prom_collector_registry_render_acquire.
+ *
+ * Exporters compare it with the generation of their last copy to skip copying an unchanged registry.
+ */
+uint64_t prom_collector_registry_generation(void);
+
 /**
  *@brief Validates that the given metric name complies with the specification:
  *
  * Reference: https://prometheus.io/docs/concepts/data_model/#metric-names-and-labels
  *
+ * The name is checked with a table lookup per character, so validating is cheap enough to do for every series. Metric
+ * constructors apply the same check to metric and label names.
+ *
  * Returns a non-zero integer value on failure.
  *
  * @param self The target prom_collector_registry_t*
@@ -20,6 +20,7 @@ limitations under the License.
 #include <stdlib.h>
 
 #include "prom_metric.h"
+#include "prom_metric_sample.h"
 
 /**
  * @file prom_counter.h
@@ -55,6 +56,49 @@ typedef prom_metric_t prom_counter_t;
  */
 prom_counter_t *prom_counter_new(const char *name, const char *help, size_t label_key_count, const char **label_keys);
 
+/**
+ * @brief Construct a prom_counter_t* whose samples are split into per-CPU shards
+ *
+ * Use it for counters incremented by many threads at once. Each shard sits on its own cache line, so concurrent
+ * increments from different CPUs do not contend; the shards are summed when the counter is scraped. Sharded samples
+ * use more memory, one cache line per CPU, so prefer prom_counter_new for counters that are not on a hot path.
+ *
+ * The parameters are those of prom_counter_new, and the counter is used and destroyed like any other.
+ *
+ * @return The constructed prom_counter_t*
+ */
+prom_counter_t *prom_counter_new_sharded(const char *name, const char *help, size_t label_key_count,
+                                         const char **label_keys);
+
+/**
+ * @brief Construct a prom_counter_t* whose sample values are stored contiguously
+ *
+ * Use it for counters with many label sets. Values live in dense arrays next to their interned label sets, so a scrape
+ * reads them in one linear pass instead of visiting every sample object. Samples are still looked up by label values
+ * and may be cached like those of any counter. A dense counter cannot also be sharded.
+ *
+ * The parameters are those of prom_counter_new, and the counter is used and destroyed like any other.
+ *
+ * @return The constructed prom_counter_t*
+ */
+prom_counter_t *prom_counter_new_dense(const char *name, const char *help, size_t label_key_count,
+                                       const char **label_keys);
+
+/**
+ * @brief Construct a prom_counter_t* whose sample values are exact 64-bit integers
+ *
+ * Use it to export monotonic sources counted in integers, such as bytes or events, which lose precision past 2^53 as
+ * doubles. The values are updated with atomic 64-bit operations through prom_metric_sample_add_u64 and
+ * prom_metric_sample_set_u64, and are formatted as integers in the text formats. prom_counter_inc and prom_counter_add
+ * keep working and truncate their argument. An integer counter cannot also be sharded or dense.
+ *
+ * The parameters are those of prom_counter_new, and the counter is used and destroyed like any other.
+ *
+ * @return The constructed prom_counter_t*
+ */
+prom_counter_t *prom_counter_new_integer(const char *name, const char *help, size_t label_key_count,
+                                         const char **label_keys);
+
 /**
  * @brief Destroys a prom_counter_t*. You must set self to NULL after destruction. A non-zero integer value will be
  *        returned on failure.
@@ -100,4 +144,52 @@ int prom_counter_inc(prom_counter_t *self, const char **label_values);
  */
 int prom_counter_add(prom_counter_t *self, double r_value, const char **label_values);
 
+/**
+ * @brief Set a counter to a value counted elsewhere, such as a counter scraped from another process
+ *
+ * The value is taken as is, so a source that restarted shows up as a counter reset, which rate() handles. Sharded
+ * counters cannot be set, since their value is the sum of their shards.
+ *
+ * @param self The target prom_counter_t*
+ * @param r_value The value of the source
+ * @param label_values The label values of the sample, or NULL for a counter without labels
+ * @return A non-zero integer value upon failure
+ *
+ * *Example*
+ *
+ *     prom_counter_set(foo_counter, 22, (const char *[]){"bar", "bang"});
+ */
+int prom_counter_set(prom_counter_t *self, double r_value, const char **label_values);
+
+/**
+ * @brief Resolve the sample of a counter for the given label values once, for repeated updates
+ *
+ * The sample is created if needed and pinned, so that the TTL set by prom_metric_set_lifecycle never evicts it. The
+ * returned handle stays valid until prom_counter_remove removes the sample or the counter is destroyed, and
+ * incrementing it with prom_metric_sample_add is a single atomic operation: unlike prom_counter_add, it neither locks
+ * the counter nor formats and looks up the label set again.
+ *
+ * @param self The target prom_counter_t*
+ * @param label_values The label values of the sample, or NULL for a counter without labels. The number of labels must
+ *                     match the value passed to label_key_count in the counter's constructor.
+ * @return The sample handle, or NULL upon failure
+ *
+ * *Example*
+ *
+ *     prom_metric_sample_t *sample = prom_counter_with_labels(foo_counter, (const char *[]){"bar", "bang"});
+ *     prom_metric_sample_add(sample, 1);
+ */
+prom_metric_sample_t *prom_counter_with_labels(prom_counter_t *self, const char **label_values);
+
+/**
+ * @brief Remove the sample of a counter for the given label values
+ *
+ * The sample is no longer exposed and handles returned by prom_counter_with_labels for it become invalid.
+ *
+ * @param self The target prom_counter_t*
+ * @param label_values The label values of the sample
+ * @return A non-zero integer value upon failure
+ */
+int prom_counter_remove(prom_counter_t *self, const char **label_values);
+
 #endif  // PROM_COUNTER_H
@@ -25,6 +25,7 @@ limitations under the License.
 #include <stdlib.h>
 
 #include "prom_metric.h"
+#include "prom_metric_sample.h"
 
 /**
  * @brief A prometheus gauge.
@@ -53,6 +54,20 @@ typedef prom_metric_t prom_gauge_t;
  */
 prom_gauge_t *prom_gauge_new(const char *name, const char *help, size_t label_key_count, const char **label_keys);
 
+/**
+ * @brief Construct a prom_gauge_t* whose sample values are stored contiguously
+ *
+ * Use it for gauges with many label sets. Values live in dense arrays next to their interned label sets, so a scrape
+ * reads them in one linear pass instead of visiting every sample object. Samples are still looked up by label values
+ * and may be cached like those of any gauge.
+ *
+ * The parameters are those of prom_gauge_new, and the gauge is used and destroyed like any other.
+ *
+ * @return The constructed prom_gauge_t*
+ */
+prom_gauge_t *prom_gauge_new_dense(const char *name, const char *help, size_t label_key_count,
+                                   const char **label_keys);
+
 /**
  * @brief Destroys a prom_gauge_t*. You must set self to NULL after destruction. A non-zero integer value will be
  *        returned on failure.
@@ -152,4 +167,72 @@ int prom_gauge_sub(prom_gauge_t *self, double r_value, const char **label_values
  */
 int prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_values);
 
+/**
+ * @brief Resolve the sample of a gauge for the given label values once, for repeated updates
+ *
+ * The sample is created if needed and pinned, so that the TTL set by prom_metric_set_lifecycle never evicts it. The
+ * returned handle stays valid until prom_gauge_remove removes the sample or the gauge is destroyed, and updating it
+ * with prom_metric_sample_set, prom_metric_sample_add or prom_metric_sample_sub is a single atomic operation: unlike
+ * prom_gauge_set, it neither locks the gauge nor formats and looks up the label set again.
+ *
+ * @param self The target prom_gauge_t*
+ * @param label_values The label values of the sample, or NULL for a gauge without labels. The number of labels must
+ *                     match the value passed to label_key_count in the gauge's constructor.
+ * @return The sample handle, or NULL upon failure
+ *
+ * *Example*
+ *
+ *     prom_metric_sample_t *sample = prom_gauge_with_labels(foo_gauge, (const char *[]){"bar", "bang"});
+ *     prom_metric_sample_set(sample, 22);
+ */
+prom_metric_sample_t *prom_gauge_with_labels(prom_gauge_t *self, const char **label_values);
+
+/**
+ * @brief Remove the sample of a gauge for the given label values
+ *
+ * The sample is no longer exposed and handles returned by prom_gauge_with_labels for it become invalid.
+ *
+ * @param self The target prom_gauge_t*
+ * @param label_values The label values of the sample
+ * @return A non-zero integer value upon failure
+ *
+ * *Example*
+ *
+ *     prom_gauge_remove(foo_gauge, (const char *[]){"bar", "bang"});
+ */
+int prom_gauge_remove(prom_gauge_t *self, const char **label_values);
+
+/**
+ * @brief Set the unlabelled sample of several gauges as one consistent update
+ *
+ * The values are published as a batch: prom_collector_registry_bridge never renders some of them with their new value
+ * and others with their old one. Batches from different threads may run concurrently.
+ *
+ * @param gauges The target gauges. NULL entries are skipped.
+ * @param values The values, one per gauge
+ * @param count The number of gauges
+ * @return A non-zero integer value upon failure. Every gauge is still attempted.
+ *
+ * *Example*
+ *
+ *     const prom_gauge_t *gauges[] = { foo_gauge, bar_gauge };
+ *     const double values[] = { 1.0, 2.0 };
+ *     prom_gauge_set_many(gauges, values, 2);
+ */
+int prom_gauge_set_many(const prom_gauge_t **gauges, const double *values, size_t count);
+
+/**
+ * @brief Start a batch of gauge updates that must be observed together
+ *
+ * Every prom_gauge_set, prom_gauge_add or prom_gauge_sub issued between prom_gauge_batch_begin and
+ * prom_gauge_batch_end is published as one consistent set. Use it for labelled families updated sample by sample.
+ * Calls MUST be paired and SHOULD NOT block in between.
+ */
+void prom_gauge_batch_begin(void);
+
+/**
+ * @brief End a batch started with prom_gauge_batch_begin
+ */
+void prom_gauge_batch_end(void);
+
 #endif  // PROM_GAUGE_H
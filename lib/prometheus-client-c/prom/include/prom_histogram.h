@@ -27,6 +27,11 @@ limitations under the License.
 #include "prom_histogram_buckets.h"
 #include "prom_metric.h"
 
+/**
+ * @brief Default most populated buckets a series of a native histogram keeps before its schema is lowered
+ */
+#define PROM_HISTOGRAM_NATIVE_MAX_BUCKETS 160
+
 /**
  * @brief A prometheus histogram.
  *
@@ -60,6 +65,52 @@ typedef prom_metric_t prom_histogram_t;
 prom_histogram_t *prom_histogram_new(const char *name, const char *help, prom_histogram_buckets_t *buckets,
                                      size_t label_key_count, const char **label_keys);
 
+/**
+ * @brief Construct a prom_histogram_t* whose bucket counters are split into per-CPU shards
+ *
+ * Use it for histograms observed by many threads at once. Each shard holds its own bucket counters and sum on cache
+ * lines of their own, so concurrent observations from different CPUs do not contend; the shards are merged when the
+ * histogram is scraped.
+ *
+ * The parameters are those of prom_histogram_new, and the histogram is used and destroyed like any other.
+ *
+ * @return The constructed prom_histogram_t*
+ */
+prom_histogram_t *prom_histogram_new_sharded(const char *name, const char *help, prom_histogram_buckets_t *buckets,
+                                             size_t label_key_count, const char **label_keys);
+
+/**
+ * @brief Construct a prom_histogram_t* with native, sparse exponential buckets instead of fixed upper bounds
+ *
+ * A value v is counted in the bucket of index i such that base^(i-1) < |v| <= base^i, with base = 2^(2^-schema):
+ * schema 3 gives buckets about 9% wide, schema 8 about 0.27%. Each series stores only the buckets that hold
+ * observations, as an index-to-count map, plus a zero bucket for values of absolute value up to 2^-128. When a series
+ * holds more than max_bucket_count buckets, its schema is lowered by one, merging every bucket with its neighbour,
+ * until they fit again; at schema -4 the buckets are kept however many they are.
+ *
+ * The buckets are exposed in the protobuf format, as the spans and deltas Prometheus reads native histograms from.
+ * The text formats have no notation for them and only show the +Inf bucket, the count and the sum, so a native
+ * histogram costs three text series whatever its resolution.
+ *
+ * The histogram is used and destroyed like any other. It cannot be sharded.
+ *
+ * @param name The name of the metric
+ * @param help The metric description
+ * @param schema The resolution to start from, between -4 and 8
+ * @param max_bucket_count The most buckets a series keeps, or 0 for PROM_HISTOGRAM_NATIVE_MAX_BUCKETS
+ * @param label_key_count is the number of labels associated with the given metric. Pass 0 if the metric does not
+ *                        require labels.
+ * @param label_keys A collection of label keys. The number of keys MUST match the value passed as label_key_count. If
+ *                   no labels are required, pass NULL.
+ * @return The constructed prom_histogram_t*, or NULL if the schema is out of range
+ *
+ * *Example*
+ *
+ *     prom_histogram_new_native("request_seconds", "Request latency", 3, 0, 1, (const char*[]){"method"});
+ */
+prom_histogram_t *prom_histogram_new_native(const char *name, const char *help, int schema, size_t max_bucket_count,
+                                            size_t label_key_count, const char **label_keys);
+
 /**
  * @brief Destroy a prom_histogram_t*. self MUSTS be set to NULL after destruction. Returns a non-zero integer value
  *        upon failure.
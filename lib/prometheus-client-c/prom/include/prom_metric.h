@@ -22,8 +22,11 @@ limitations under the License.
 #ifndef PROM_METRIC_H
 #define PROM_METRIC_H
 
+#include <stddef.h>
+
 #include "prom_metric_sample.h"
 #include "prom_metric_sample_histogram.h"
+#include "prom_metric_sample_summary.h"
 
 struct prom_metric;
 /**
@@ -38,7 +41,7 @@ typedef struct prom_metric prom_metric_t;
  *
  * You may use this function to cache metric samples to avoid sample lookup. Metric samples are stored in a hash map
  * with O(1) lookups in average case; nonethless, caching metric samples and updating them directly might be
- * preferrable in performance-sensitive situations.
+ * preferrable in performance-sensitive situations. The sample is pinned, so prom_metric_sweep never evicts it.
  *
  * @param self The target prom_metric_t*
  * @param label_values The label values associated with the metric sample being updated. The number of labels must
@@ -64,4 +67,93 @@ prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const
 prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_metric_t *self,
                                                                          const char **label_values);
 
+/**
+ * @brief Returns a prom_metric_sample_summary_t*. The order of label_values is significant.
+ *
+ * You may use this function to cache metric samples to avoid sample lookup. Observing a cached summary sample is lock
+ * free.
+ *
+ * @param self The target prom_summary_t*
+ * @param label_values The label values associated with the metric sample being updated. The number of labels must
+ *                     match the value passed to label_key_count in the summary's constructor. If no label values are
+ *                     necessary, pass NULL. Otherwise, It may be convenient to pass this value as a literal.
+ * @return prom_metric_sample_summary_t*
+ */
+prom_metric_sample_summary_t *prom_metric_sample_summary_from_labels(prom_metric_t *self, const char **label_values);
+
+/**
+ * @brief Removes the sample of the given label values, so that it is no longer exposed and its memory is reclaimed
+ *
+ * Use it for series whose subject is gone, such as a removed container or device. Every handle to the sample becomes
+ * invalid, so the caller must drop its cached handles before calling this; updates through label values in progress
+ * are waited for. Removing a sample that does not exist is not an error.
+ *
+ * @param self The target prom_metric_t*
+ * @param label_values The label values of the sample. The order of label_values is significant.
+ * @return A non-zero integer value upon failure
+ */
+int prom_metric_remove_labels(prom_metric_t *self, const char **label_values);
+
+/**
+ * @brief Makes room for sample_count samples up front, so that creating them never resizes the sample map
+ *
+ * Maps otherwise grow a few entries at a time as samples are created, which keeps every creation short; reserving
+ * avoids even that work when the number of series is known, for example before registering a large label set.
+ * @param self The target prom_metric_t*
+ * @param sample_count The number of samples the metric is expected to hold
+ * @return Non-zero value upon failure
+ */
+int prom_metric_reserve(prom_metric_t *self, size_t sample_count);
+
+/**
+ * @brief Bounds the series of a metric: series not updated for ttl_seconds are evicted by prom_metric_sweep, and
+ * lookups of new label values fail once the metric holds max_series samples
+ *
+ * Meant for labels whose values come and go, such as PIDs or cgroups, whose series would otherwise pile up forever.
+ * Updates stamp their series with the time of the last sweep rather than read a clock, so a series is evicted between
+ * ttl_seconds and ttl_seconds plus two sweep intervals after its last update.
+ * A sweep unlinks the idle samples, so that renders no longer see them, waits for the updates through label values
+ * that resolved one of them to return, and frees them. Samples a handle was taken for, with
+ * prom_metric_sample_from_labels, prom_gauge_with_labels or prom_counter_with_labels, are pinned and never evicted:
+ * their owner removes them when their label values go away. Only counters and gauges with labels and without dense
+ * storage can have a TTL; any metric can have a cap.
+ *
+ * @param self The target prom_metric_t*
+ * @param ttl_seconds Seconds a series may go without update before it is evicted, or 0 to keep series forever
+ * @param max_series Most series the metric may hold, or 0 for no limit
+ * @return Non-zero value upon failure, in which case the metric is unchanged
+ */
+int prom_metric_set_lifecycle(prom_metric_t *self, unsigned int ttl_seconds, size_t max_series);
+
+/**
+ * @brief Evicts and frees the unpinned series idle for longer than the TTL set by prom_metric_set_lifecycle
+ *
+ * Meant to be called at a regular interval, well below the TTL. Before freeing, the sweep waits for the updates
+ * through label values in progress, which last one lookup. Metrics without a TTL return at once.
+ * @param self The target prom_metric_t*
+ * @return The number of series evicted
+ */
+size_t prom_metric_sweep(prom_metric_t *self);
+
+/**
+ * @brief Returns the number of lookups of new label values refused so far because the metric held max_series samples
+ * @param self The target prom_metric_t*
+ */
+size_t prom_metric_refused_series(prom_metric_t *self);
+
+/**
+ * @brief Sets the "# HELP" and "# TYPE" lines the text format writes before the samples of a metric
+ *
+ * Meant for metrics whose name and help are known at compile time, so that the lines are string literals built by the
+ * compiler and a render copies them instead of escaping and concatenating them. The lines must be those the library
+ * would write, help escaped and each line ending with a newline; only their HELP prefix is checked. The header is not
+ * copied and must outlive the metric. OpenMetrics keeps building its header, which drops the _total suffix of
+ * counters.
+ * @param self The target prom_metric_t*
+ * @param header The lines, or NULL to build them at every render again
+ * @param len The length of header
+ * @return Non-zero value upon failure, in which case the metric is unchanged
+ */
+int prom_metric_set_text_header(prom_metric_t *self, const char *header, size_t len);
+
 #endif  // PROM_METRIC_H
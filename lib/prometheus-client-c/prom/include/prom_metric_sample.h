@@ -22,6 +22,8 @@ limitations under the License.
 #ifndef PROM_METRIC_SAMPLE_H
 #define PROM_METRIC_SAMPLE_H
 
+#include <stdint.h>
+
 struct prom_metric_sample;
 /**
  * @brief Contains the specific metric and value given the name and label set
@@ -40,7 +42,7 @@ int prom_metric_sample_add(prom_metric_sample_t *self, double r_value);
 /**
  * @brief Subtract the r_value from the sample.
  *
- * This operation MUST be called a sample derived from a gauge metric.
+ * This operation MUST be called a sample derived from a gauge metric. An integer sample is clamped at zero.
  * @param self The target prom_metric_sample_t*
  * @param r_value The double to subtract from the prom_metric_sample_t* provided by self
  * @return Non-zero integer value upon failure
@@ -57,4 +59,34 @@ int prom_metric_sample_sub(prom_metric_sample_t *self, double r_value);
  */
 int prom_metric_sample_set(prom_metric_sample_t *self, double r_value);
 
+/**
+ * @brief Set a counter sample to a value counted elsewhere, as prom_counter_set does through label values
+ *
+ * This operation MUST be called on a sample derived from a counter that is not sharded. It mirrors monotonic sources
+ * kept as fractions, such as times converted to seconds, whose absolute value is read rather than accumulated.
+ * @param self The target prom_metric_sample_t*
+ * @param r_value The value of the source
+ * @return Non-zero integer value upon failure
+ */
+int prom_metric_sample_set_counter(prom_metric_sample_t *self, double r_value);
+
+/**
+ * @brief Add an exact integer to a sample of an integer metric, see prom_counter_new_integer
+ * @param self The target prom_metric_sample_t*
+ * @param value The integer to add
+ * @return Non-zero integer value upon failure, including when the sample does not belong to an integer metric
+ */
+int prom_metric_sample_add_u64(prom_metric_sample_t *self, uint64_t value);
+
+/**
+ * @brief Set a sample of an integer metric to an exact integer, see prom_counter_new_integer
+ *
+ * Unlike prom_metric_sample_set, this operation may be called on a counter sample: integer counters mirror monotonic
+ * sources, such as the counters of the kernel, whose absolute value is read rather than accumulated.
+ * @param self The target prom_metric_sample_t*
+ * @param value The integer which will be set to the prom_metric_sample_t* provided by self
+ * @return Non-zero integer value upon failure, including when the sample does not belong to an integer metric
+ */
+int prom_metric_sample_set_u64(prom_metric_sample_t *self, uint64_t value);
+
 #endif  // PROM_METRIC_SAMPLE_H
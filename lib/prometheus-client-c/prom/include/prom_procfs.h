@@ -0,0 +1,90 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file prom_procfs.h
+ * @brief Bulk reads of procfs and sysfs files
+ */
+
+#ifndef PROM_PROCFS_H
+#define PROM_PROCFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * @brief Block size used when a caller does not know how large a file is
+ */
+#define PROM_PROCFS_DEFAULT_SIZE_HINT 4096
+
+/**
+ * @brief Reads the whole contents of an open procfs or sysfs file, starting at offset 0
+ *
+ * The file is read with pread() in blocks as large as the free space of the buffer, so the kernel regenerates it once
+ * per call and the same descriptor can be read again on the next scrape. The buffer is NUL-terminated.
+ *
+ * If *buf is NULL, a buffer of *capacity bytes (or PROM_PROCFS_DEFAULT_SIZE_HINT if *capacity is 0) is allocated. When
+ * the contents do not fit, the buffer is doubled with prom_realloc until it reaches max_capacity; the contents are
+ * truncated past that. Passing max_capacity <= *capacity keeps the buffer from ever being reallocated, so a caller
+ * may hand in a buffer on the stack.
+ *
+ * @param fd The descriptor of the file
+ * @param buf Pointer to the buffer. A buffer that may grow must have been allocated with prom_malloc.
+ * @param capacity Pointer to the size of the buffer in bytes, updated when the buffer grows
+ * @param max_capacity Upper bound on the size of the buffer in bytes
+ * @return The number of bytes read, excluding the NUL terminator, or -1 with errno set upon failure
+ */
+ssize_t prom_procfs_read(int fd, char **buf, size_t *capacity, size_t max_capacity);
+
+/**
+ * @brief Parses the unsigned decimal field at *p, after the spaces and tabs before it
+ *
+ * Runs of eight digits are converted at once, eight bytes in a 64-bit word, when the buffer holds that many bytes
+ * before end; shorter runs and the tail of a long one are converted a digit at a time. Unlike strtoull(), the parse
+ * does not depend on the locale and never reads past end, which need not be NUL-terminated.
+ *
+ * @param p Pointer to the parse position, advanced past the digits
+ * @param end End of the buffer
+ * @return The value, or 0 if no digits are present, in which case *p is only advanced past the blanks
+ */
+uint64_t prom_procfs_parse_u64(const char **p, const char *end);
+
+/**
+ * @brief Parses up to count unsigned decimal fields separated by spaces or tabs, as prom_procfs_parse_u64
+ *
+ * The parse stops at the first field that does not start with a digit, such as a negative number, a name or the end
+ * of the line, so the fields of a line are read in one call without crossing into the next one.
+ *
+ * @param p Pointer to the parse position, advanced past the last field parsed
+ * @param end End of the buffer
+ * @param values Array of count entries; the entries past the fields parsed are left untouched
+ * @param count The number of fields to parse
+ * @return The number of fields parsed
+ */
+size_t prom_procfs_parse_u64s(const char **p, const char *end, uint64_t *values, size_t count);
+
+/**
+ * @brief Skips up to count fields separated by spaces or tabs, whatever they hold, without crossing the end of the line
+ *
+ * @param p Pointer to the parse position, advanced past the last field skipped
+ * @param end End of the buffer
+ * @param count The number of fields to skip
+ * @return The number of fields skipped
+ */
+size_t prom_procfs_skip_fields(const char **p, const char *end, size_t count);
+
+#endif  // PROM_PROCFS_H
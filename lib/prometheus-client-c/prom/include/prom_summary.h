@@ -0,0 +1,86 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file prom_summary.h
+ * @brief https://prometheus.io/docs/concepts/metric_types/#summary
+ */
+
+#ifndef PROM_SUMMARY_INCLUDED
+#define PROM_SUMMARY_INCLUDED
+
+#include <stdlib.h>
+
+#include "prom_metric.h"
+#include "prom_summary_quantiles.h"
+
+/**
+ * @brief A prometheus summary.
+ *
+ * Each series keeps a DDSketch of the observed values: a fixed array of logarithmic bins (about 16KB) from which every
+ * quantile is estimated within 1% relative error, without choosing bucket boundaries up front. Observing is lock free.
+ * Values below 1e-9, zero and negative values included, are reported as 0.
+ *
+ * References
+ * * See https://prometheus.io/docs/concepts/metric_types/#summary
+ * * See https://arxiv.org/abs/1908.10693
+ */
+typedef prom_metric_t prom_summary_t;
+
+/**
+ * @brief Construct a prom_summary_t*
+ * @param name The name of the metric
+ * @param help The metric description
+ * @param quantiles The prom_summary_quantiles_t* to report, or NULL for prom_summary_default_quantiles. See
+ *                  prom_summary_quantiles.h.
+ * @param label_key_count is the number of labels associated with the given metric. Pass 0 if the metric does not
+ *                        require labels.
+ * @param label_keys A collection of label keys. The number of keys MUST match the value passed as label_key_count. If
+ *                   no labels are required, pass NULL. Otherwise, it may be convenient to pass this value as a
+ *                   literal.
+ * @return The constructed prom_summary_t*
+ *
+ * *Example*
+ *
+ *     // An example with labels
+ *     prom_summary_quantiles_t* quantiles = prom_summary_quantiles_new(2, 0.5, 0.99);
+ *     prom_summary_new("foo", "foo is a summary with labels", quantiles, 2, (const char**) { "one", "two" });
+ *
+ *     // An example without labels, reporting the default quantiles
+ *     prom_summary_new("foo", "foo is a summary without labels", NULL, 0, NULL);
+ */
+prom_summary_t *prom_summary_new(const char *name, const char *help, prom_summary_quantiles_t *quantiles,
+                                 size_t label_key_count, const char **label_keys);
+
+/**
+ * @brief Destroy a prom_summary_t*. self MUST be set to NULL after destruction. Returns a non-zero integer value upon
+ *        failure.
+ * @return Non-zero value upon failure.
+ */
+int prom_summary_destroy(prom_summary_t *self);
+
+/**
+ * @brief Observe the prom_summary_t given the value and labels
+ * @param self The target prom_summary_t*
+ * @param value The value to observe
+ * @param label_values The label values associated with the metric sample being updated. The number of labels must
+ *                     match the value passed to label_key_count in the summary's constructor. If no label values are
+ *                     necessary, pass NULL. Otherwise, it may be convenient to pass this value as a literal.
+ * @return Non-zero value upon failure
+ */
+int prom_summary_observe(prom_summary_t *self, double value, const char **label_values);
+
+#endif  // PROM_SUMMARY_INCLUDED
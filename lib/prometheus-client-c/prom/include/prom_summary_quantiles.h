@@ -0,0 +1,61 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file prom_summary_quantiles.h
+ * @brief https://prometheus.io/docs/concepts/metric_types/#summary
+ */
+
+#include "stdlib.h"
+
+#ifndef PROM_SUMMARY_QUANTILES_H
+#define PROM_SUMMARY_QUANTILES_H
+
+typedef struct prom_summary_quantiles {
+  int count;               /**< Number of quantiles */
+  const double *quantiles; /**< The quantiles, each between 0 and 1 */
+} prom_summary_quantiles_t;
+
+/**
+ * @brief Construct a prom_summary_quantiles_t*
+ * @param count The number of quantiles
+ * @param quantile The first quantile. A variable number of quantiles may be passed. This quantity MUST equal the value
+ *                 passed as count. Each quantile MUST be between 0 and 1.
+ * @return The constructed prom_summary_quantiles_t*
+ */
+prom_summary_quantiles_t *prom_summary_quantiles_new(size_t count, double quantile, ...);
+
+/**
+ * @brief the default summary quantiles: .5, .9, .99
+ */
+extern prom_summary_quantiles_t *prom_summary_default_quantiles;
+
+/**
+ * @brief Destroy a prom_summary_quantiles_t*. Self MUST be set to NULL after destruction. Returns a non-zero integer
+ *        value upon failure.
+ * @param self The target prom_summary_quantiles_t*
+ * @return Non-zero integer value upon failure
+ */
+int prom_summary_quantiles_destroy(prom_summary_quantiles_t *self);
+
+/**
+ * @brief Get the count of quantiles
+ * @param self The target prom_summary_quantiles_t*
+ * @return The count of quantiles
+ */
+size_t prom_summary_quantiles_count(prom_summary_quantiles_t *self);
+
+#endif  // PROM_SUMMARY_QUANTILES_H
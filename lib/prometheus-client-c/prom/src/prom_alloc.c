@@ -0,0 +1,226 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_alloc_i.h"
+#include "prom_arena_i.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// libc backend
+
+static const prom_allocator_t prom_allocator_libc = {
+    .malloc = &malloc, .realloc = &realloc, .free = &free, .calloc = &calloc};
+
+static const prom_allocator_t *prom_allocator_current = &prom_allocator_libc;
+
+// Set by the first allocation, after which the backend can no longer change
+static atomic_bool prom_allocator_in_use = false;
+
+int prom_allocator_set(const prom_allocator_t *allocator) {
+  if (allocator == NULL) allocator = &prom_allocator_libc;
+  if (allocator == prom_allocator_current) return 0;
+  if (atomic_load_explicit(&prom_allocator_in_use, memory_order_relaxed)) return 1;
+  prom_allocator_current = allocator;
+  return 0;
+}
+
+const prom_allocator_t *prom_allocator_get(void) { return prom_allocator_current; }
+
+void prom_allocator_mark_in_use(void) {
+  if (!atomic_load_explicit(&prom_allocator_in_use, memory_order_relaxed)) {
+    atomic_store_explicit(&prom_allocator_in_use, true, memory_order_relaxed);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Slab backend
+
+#define PROM_ALLOC_SLAB_CHUNK_SIZE (64 * 1024)
+#define PROM_ALLOC_SLAB_MIN_SHIFT 4
+#define PROM_ALLOC_SLAB_CLASS_COUNT 6 /**< Classes of 16, 32, 64, 128, 256 and 512 bytes */
+#define PROM_ALLOC_SLAB_LARGE UINT32_MAX
+
+// Every block starts with a header naming its size class; it is as large as max_align_t to keep the payload aligned
+typedef union prom_alloc_slab_header {
+  uint32_t size_class; /**< Index of the size class, or PROM_ALLOC_SLAB_LARGE for blocks from libc */
+  max_align_t align;
+} prom_alloc_slab_header_t;
+
+typedef struct prom_alloc_slab_block {
+  struct prom_alloc_slab_block *next;
+} prom_alloc_slab_block_t;
+
+static _Thread_local prom_alloc_slab_block_t *prom_alloc_slab_free_lists[PROM_ALLOC_SLAB_CLASS_COUNT];
+static _Thread_local char *prom_alloc_slab_chunk = NULL;
+static _Thread_local size_t prom_alloc_slab_chunk_left = 0;
+
+static inline size_t prom_alloc_slab_class_size(uint32_t size_class) {
+  return (size_t)1 << (size_class + PROM_ALLOC_SLAB_MIN_SHIFT);
+}
+
+static inline uint32_t prom_alloc_slab_class(size_t size) {
+  uint32_t size_class = 0;
+  while (size_class < PROM_ALLOC_SLAB_CLASS_COUNT && prom_alloc_slab_class_size(size_class) < size) size_class++;
+  return size_class < PROM_ALLOC_SLAB_CLASS_COUNT ? size_class : PROM_ALLOC_SLAB_LARGE;
+}
+
+static void *prom_alloc_slab_malloc(size_t size) {
+  uint32_t size_class = prom_alloc_slab_class(size);
+  prom_alloc_slab_header_t *header;
+
+  if (size_class == PROM_ALLOC_SLAB_LARGE) {
+    header = (prom_alloc_slab_header_t *)malloc(sizeof(prom_alloc_slab_header_t) + size);
+    if (header == NULL) return NULL;
+  } else if (prom_alloc_slab_free_lists[size_class] != NULL) {
+    prom_alloc_slab_block_t *block = prom_alloc_slab_free_lists[size_class];
+    prom_alloc_slab_free_lists[size_class] = block->next;
+    header = (prom_alloc_slab_header_t *)block - 1;
+  } else {
+    // Blocks of every class are carved from the same chunk in allocation order, so objects created together share
+    // cache lines and pages
+    size_t block_size = sizeof(prom_alloc_slab_header_t) + prom_alloc_slab_class_size(size_class);
+    if (prom_alloc_slab_chunk_left < block_size) {
+      prom_alloc_slab_chunk = (char *)malloc(PROM_ALLOC_SLAB_CHUNK_SIZE);
+      if (prom_alloc_slab_chunk == NULL) {
+        prom_alloc_slab_chunk_left = 0;
+        return NULL;
+      }
+      prom_alloc_slab_chunk_left = PROM_ALLOC_SLAB_CHUNK_SIZE;
+    }
+    header = (prom_alloc_slab_header_t *)prom_alloc_slab_chunk;
+    prom_alloc_slab_chunk += block_size;
+    prom_alloc_slab_chunk_left -= block_size;
+  }
+
+  header->size_class = size_class;
+  return header + 1;
+}
+
+static void *prom_alloc_slab_calloc(size_t count, size_t size) {
+  if (size != 0 && count > SIZE_MAX / size) return NULL;
+  size_t total = count * size;
+  if (prom_alloc_slab_class(total) != PROM_ALLOC_SLAB_LARGE) {
+    void *ptr = prom_alloc_slab_malloc(total);
+    if (ptr != NULL) memset(ptr, 0, total);
+    return ptr;
+  }
+
+  // Large blocks come from libc, which hands out fresh pages already zeroed
+  prom_alloc_slab_header_t *header =
+      (prom_alloc_slab_header_t *)calloc(1, sizeof(prom_alloc_slab_header_t) + total);
+  if (header == NULL) return NULL;
+  header->size_class = PROM_ALLOC_SLAB_LARGE;
+  return header + 1;
+}
+
+static void prom_alloc_slab_free(void *ptr) {
+  if (ptr == NULL) return;
+  prom_alloc_slab_header_t *header = (prom_alloc_slab_header_t *)ptr - 1;
+  if (header->size_class == PROM_ALLOC_SLAB_LARGE) {
+    free(header);
+    return;
+  }
+  prom_alloc_slab_block_t *block = (prom_alloc_slab_block_t *)ptr;
+  block->next = prom_alloc_slab_free_lists[header->size_class];
+  prom_alloc_slab_free_lists[header->size_class] = block;
+}
+
+static void *prom_alloc_slab_realloc(void *ptr, size_t size) {
+  if (ptr == NULL) return prom_alloc_slab_malloc(size);
+  prom_alloc_slab_header_t *header = (prom_alloc_slab_header_t *)ptr - 1;
+  if (header->size_class == PROM_ALLOC_SLAB_LARGE) {
+    if (prom_alloc_slab_class(size) == PROM_ALLOC_SLAB_LARGE) {
+      header = (prom_alloc_slab_header_t *)realloc(header, sizeof(prom_alloc_slab_header_t) + size);
+      return header == NULL ? NULL : header + 1;
+    }
+  } else if (size <= prom_alloc_slab_class_size(header->size_class)) {
+    return ptr;
+  }
+
+  // The old size is only known up to its class, which is enough: a block never holds more than its class size
+  size_t old_size = header->size_class == PROM_ALLOC_SLAB_LARGE ? size : prom_alloc_slab_class_size(header->size_class);
+  void *grown = prom_alloc_slab_malloc(size);
+  if (grown == NULL) return NULL;
+  memcpy(grown, ptr, old_size < size ? old_size : size);
+  prom_alloc_slab_free(ptr);
+  return grown;
+}
+
+static const prom_allocator_t prom_allocator_slab_backend = {.malloc = &prom_alloc_slab_malloc,
+                                                             .realloc = &prom_alloc_slab_realloc,
+                                                             .free = &prom_alloc_slab_free,
+                                                             .calloc = &prom_alloc_slab_calloc};
+
+const prom_allocator_t *prom_allocator_slab(void) { return &prom_allocator_slab_backend; }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Entry points of the prom_alloc.h macros
+
+// Allocations made through the backend by the current thread
+static _Thread_local unsigned long long prom_alloc_thread_count = 0;
+
+unsigned long long prom_alloc_thread_allocations(void) { return prom_alloc_thread_count; }
+
+void *prom_alloc_malloc(size_t size) {
+  if (prom_arena_scope != NULL) return prom_arena_alloc(prom_arena_scope, size);
+  prom_allocator_mark_in_use();
+  prom_alloc_thread_count++;
+  return prom_allocator_current->malloc(size);
+}
+
+void *prom_alloc_calloc(size_t count, size_t size) {
+  if (prom_arena_scope != NULL || prom_allocator_current->calloc == NULL) {
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+    void *ptr = prom_alloc_malloc(count * size);
+    if (ptr != NULL) memset(ptr, 0, count * size);
+    return ptr;
+  }
+  prom_allocator_mark_in_use();
+  prom_alloc_thread_count++;
+  return prom_allocator_current->calloc(count, size);
+}
+
+void *prom_alloc_realloc(void *ptr, size_t size) {
+  if (prom_arena_scope != NULL && (ptr == NULL || prom_arena_owns(prom_arena_scope, ptr))) {
+    return ptr == NULL ? prom_arena_alloc(prom_arena_scope, size) : prom_arena_realloc(prom_arena_scope, ptr, size);
+  }
+  prom_allocator_mark_in_use();
+  prom_alloc_thread_count++;
+  return prom_allocator_current->realloc(ptr, size);
+}
+
+char *prom_alloc_strdup(const char *str) {
+  size_t len = strlen(str);
+  char *copy = (char *)prom_alloc_malloc(len + 1);
+  if (copy == NULL) return NULL;
+  memcpy(copy, str, len + 1);
+  return copy;
+}
+
+void prom_alloc_free(void *ptr) {
+  if (ptr == NULL) return;
+  if (prom_arena_scope != NULL && prom_arena_owns(prom_arena_scope, ptr)) return;
+  prom_allocator_current->free(ptr);
+}
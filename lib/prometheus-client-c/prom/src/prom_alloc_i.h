@@ -0,0 +1,25 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_ALLOC_I_H
+#define PROM_ALLOC_I_H
+
+/**
+ * @brief API PRIVATE Records that the backend allocator handed out memory, after which it can no longer be changed
+ */
+void prom_allocator_mark_in_use(void);
+
+#endif  // PROM_ALLOC_I_H
@@ -0,0 +1,133 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+#include "prom_arena.h"
+
+// Private
+#include "prom_alloc_i.h"
+#include "prom_arena_i.h"
+#include "prom_arena_t.h"
+#include "prom_assert.h"
+
+_Thread_local prom_arena_t *prom_arena_scope = NULL;
+
+// Chunks and the arena itself come from the backend directly, since prom_malloc may be routed to an arena
+static prom_arena_chunk_t *prom_arena_chunk_new(size_t size) {
+  prom_allocator_mark_in_use();
+  prom_arena_chunk_t *chunk = (prom_arena_chunk_t *)prom_allocator_get()->malloc(sizeof(prom_arena_chunk_t) + size);
+  if (chunk == NULL) return NULL;
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  return chunk;
+}
+
+prom_arena_t *prom_arena_new(size_t chunk_size) {
+  prom_allocator_mark_in_use();
+  prom_arena_t *self = (prom_arena_t *)prom_allocator_get()->malloc(sizeof(prom_arena_t));
+  if (self == NULL) return NULL;
+  self->chunk_size = chunk_size;
+  self->head = prom_arena_chunk_new(chunk_size);
+  if (self->head == NULL) {
+    prom_allocator_get()->free(self);
+    return NULL;
+  }
+  return self;
+}
+
+int prom_arena_destroy(prom_arena_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+  if (prom_arena_scope == self) prom_arena_scope = NULL;
+  prom_arena_chunk_t *chunk = self->head;
+  while (chunk != NULL) {
+    prom_arena_chunk_t *next = chunk->next;
+    prom_allocator_get()->free(chunk);
+    chunk = next;
+  }
+  prom_allocator_get()->free(self);
+  return 0;
+}
+
+void *prom_arena_alloc(prom_arena_t *self, size_t size) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+
+  size_t align = sizeof(max_align_t);
+  size_t need = PROM_ARENA_HEADER_SIZE + (size + align - 1) / align * align;
+  if (self->head->size - self->head->used < need) {
+    prom_arena_chunk_t *chunk = prom_arena_chunk_new(need > self->chunk_size ? need : self->chunk_size);
+    if (chunk == NULL) return NULL;
+    chunk->next = self->head;
+    self->head = chunk;
+  }
+
+  char *block = (char *)self->head->data + self->head->used;
+  self->head->used += need;
+  *(size_t *)block = size;
+  return block + PROM_ARENA_HEADER_SIZE;
+}
+
+char *prom_arena_strdup(prom_arena_t *self, const char *str) {
+  size_t len = strlen(str);
+  char *copy = (char *)prom_arena_alloc(self, len + 1);
+  if (copy == NULL) return NULL;
+  memcpy(copy, str, len + 1);
+  return copy;
+}
+
+void prom_arena_reset(prom_arena_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return;
+  while (self->head->next != NULL) {
+    prom_arena_chunk_t *next = self->head->next;
+    prom_allocator_get()->free(self->head);
+    self->head = next;
+  }
+  self->head->used = 0;
+}
+
+bool prom_arena_owns(prom_arena_t *self, const void *ptr) {
+  for (prom_arena_chunk_t *chunk = self->head; chunk != NULL; chunk = chunk->next) {
+    const char *data = (const char *)chunk->data;
+    if ((const char *)ptr >= data && (const char *)ptr < data + chunk->used) return true;
+  }
+  return false;
+}
+
+void *prom_arena_realloc(prom_arena_t *self, void *ptr, size_t size) {
+  size_t old_size = *(size_t *)((char *)ptr - PROM_ARENA_HEADER_SIZE);
+  if (size <= old_size) return ptr;
+  void *grown = prom_arena_alloc(self, size);
+  if (grown == NULL) return NULL;
+  memcpy(grown, ptr, old_size);
+  return grown;
+}
+
+int prom_arena_enter(prom_arena_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || prom_arena_scope != NULL) return 1;
+  prom_arena_scope = self;
+  return 0;
+}
+
+void prom_arena_leave(void) { prom_arena_scope = NULL; }
@@ -0,0 +1,40 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_ARENA_I_H
+#define PROM_ARENA_I_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "prom_arena_t.h"
+
+/**
+ * @brief API PRIVATE The arena prom_malloc of the calling thread allocates from, or NULL outside of a scope
+ */
+extern _Thread_local prom_arena_t *prom_arena_scope;
+
+/**
+ * @brief API PRIVATE Returns true if ptr was allocated from the arena since its last reset
+ */
+bool prom_arena_owns(prom_arena_t *self, const void *ptr);
+
+/**
+ * @brief API PRIVATE Resizes an allocation of the arena by copying it into a new one
+ */
+void *prom_arena_realloc(prom_arena_t *self, void *ptr, size_t size);
+
+#endif  // PROM_ARENA_I_H
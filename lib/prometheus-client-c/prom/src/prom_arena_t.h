@@ -0,0 +1,41 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_ARENA_T_H
+#define PROM_ARENA_T_H
+
+#include <stddef.h>
+
+#include "prom_arena.h"
+
+/**
+ * @brief Every allocation is preceded by its size, padded to keep the allocation aligned for any type
+ */
+#define PROM_ARENA_HEADER_SIZE sizeof(max_align_t)
+
+typedef struct prom_arena_chunk {
+  struct prom_arena_chunk *next; /**< Chunk filled before this one, or NULL */
+  size_t size;                   /**< Bytes available in data */
+  size_t used;                   /**< Bytes handed out from data */
+  max_align_t data[];            /**< Allocations */
+} prom_arena_chunk_t;
+
+struct prom_arena {
+  prom_arena_chunk_t *head; /**< Chunk allocations are taken from; its next chain ends with the first chunk */
+  size_t chunk_size;        /**< Size of the chunks allocated when head is full */
+};
+
+#endif  // PROM_ARENA_T_H
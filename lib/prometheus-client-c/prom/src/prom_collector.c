@@ -14,20 +14,26 @@
  * limitations under the License.
  */
 
+#include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 // Public
 #include "prom_alloc.h"
 #include "prom_collector.h"
 #include "prom_collector_registry.h"
+#include "prom_procfs.h"
 
 // Private
 #include "prom_assert.h"
 #include "prom_collector_t.h"
+#include "prom_errors.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_metric_i.h"
+#include "prom_metric_sample_i.h"
 #include "prom_process_fds_i.h"
 #include "prom_process_fds_t.h"
 #include "prom_process_limits_i.h"
@@ -42,7 +48,7 @@ prom_collector_t *prom_collector_new(const char *name) {
   int r = 0;
   prom_collector_t *self = (prom_collector_t *)prom_malloc(sizeof(prom_collector_t));
   self->name = prom_strdup(name);
-  self->metrics = prom_map_new();
+  self->metrics = prom_map_new_read_mostly();
   if (self->metrics == NULL) {
     prom_collector_destroy(self);
     return NULL;
@@ -60,9 +66,22 @@ prom_collector_t *prom_collector_new(const char *name) {
   }
   self->proc_limits_file_path = NULL;
   self->proc_stat_file_path = NULL;
+  self->process_state = NULL;
   return self;
 }
 
+/**
+ * @brief Closes the files held by the process collector state
+ */
+static void prom_collector_process_state_close(prom_collector_process_state_t *state) {
+  if (state->stat_fd >= 0) close(state->stat_fd);
+  state->stat_fd = -1;
+  if (state->fd_dir != NULL) closedir(state->fd_dir);
+  state->fd_dir = NULL;
+  if (state->scrape_arena != NULL) prom_arena_destroy(state->scrape_arena);
+  state->scrape_arena = NULL;
+}
+
 int prom_collector_destroy(prom_collector_t *self) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 0;
@@ -78,6 +97,12 @@ int prom_collector_destroy(prom_collector_t *self) {
   if (r) ret = r;
   self->string_builder = NULL;
 
+  if (self->process_state != NULL) {
+    prom_collector_process_state_close(self->process_state);
+    prom_free(self->process_state);
+    self->process_state = NULL;
+  }
+
   prom_free((char *)self->name);
   self->name = NULL;
   prom_free(self);
@@ -113,7 +138,23 @@ int prom_collector_add_metric(prom_collector_t *self, prom_metric_t *metric) {
     PROM_LOG("metric already found in collector");
     return 1;
   }
-  return prom_map_set(self->metrics, metric->name, metric);
+  int r = prom_map_set(self->metrics, metric->name, metric);
+  if (r) return r;
+  prom_metric_sample_generation_bump();
+  return 0;
+}
+
+int prom_collector_remove_metric(prom_collector_t *self, prom_metric_t *metric) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (prom_map_get(self->metrics, metric->name) != metric) {
+    PROM_LOG("metric not found in collector");
+    return 1;
+  }
+  int r = prom_map_remove(self->metrics, metric->name);
+  if (r) return r;
+  prom_metric_sample_generation_bump();
+  return 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -165,113 +206,154 @@ prom_collector_t *prom_collector_process_new(const char *limits_path, const char
   return self;
 }
 
-prom_map_t *prom_collector_process_collect(prom_collector_t *self) {
-  PROM_ASSERT(self != NULL);
-  if (self == NULL) return NULL;
+/**
+ * @brief Returns the state of the process collector, (re)opening the stat file and fd directory when the collector
+ * runs for the first time or after a fork
+ */
+static prom_collector_process_state_t *prom_collector_process_state(prom_collector_t *self) {
+  pid_t pid = getpid();
+  prom_collector_process_state_t *state = self->process_state;
+  if (state == NULL) {
+    state = (prom_collector_process_state_t *)prom_malloc(sizeof(prom_collector_process_state_t));
+    if (state == NULL) return NULL;
+    memset(state, 0, sizeof(prom_collector_process_state_t));
+    state->stat_fd = -1;
+    self->process_state = state;
+  } else if (state->pid == pid) {
+    return state;
+  } else {
+    prom_collector_process_state_close(state);
+  }
+
+  state->pid = pid;
+  state->limits_read = false;
+
+  char path[64];
+  if (self->proc_stat_file_path) {
+    state->stat_fd = open(self->proc_stat_file_path, O_RDONLY | O_CLOEXEC);
+  } else {
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    state->stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+  }
+  if (state->stat_fd < 0) PROM_LOG(PROM_STDIO_OPEN_FILE_ERROR);
+
+  snprintf(path, sizeof(path), "/proc/%d/fd", (int)pid);
+  state->fd_dir = opendir(path);
+  if (state->fd_dir == NULL) PROM_LOG(PROM_STDIO_OPEN_DIR_ERROR);
 
+  return state;
+}
+
+/**
+ * @brief Reads the soft limits of open files and address space from the limits file
+ *
+ * @return A non-zero integer value upon failure
+ */
+static int prom_collector_process_parse_limits(prom_collector_t *self, prom_collector_process_state_t *state) {
   int r = 0;
 
   // Allocate and create a *prom_process_limits_file_t
   prom_process_limits_file_t *limits_f = prom_process_limits_file_new(self->proc_limits_file_path);
-  if (limits_f == NULL) {
-    prom_process_limits_file_destroy(limits_f);
-    return NULL;
-  }
+  if (limits_f == NULL) return 1;
 
   // Allocate and create a *prom_map_t from prom_process_limits_file_t. This is the main storage container for the
   // limits metric data
   prom_map_t *limits_map = prom_process_limits(limits_f);
   if (limits_map == NULL) {
     prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    return NULL;
+    return 1;
   }
 
-  // Retrieve the *prom_process_limits_row_t for Max open files
+  // Retrieve the *prom_process_limits_row_t for Max open files and Max address space
   prom_process_limits_row_t *max_fds = (prom_process_limits_row_t *)prom_map_get(limits_map, "Max open files");
-  if (max_fds == NULL) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    return NULL;
-  }
-
-  // Retrieve the *prom_process_limits_row_t for Max address space
   prom_process_limits_row_t *virtual_memory_max_bytes =
       (prom_process_limits_row_t *)prom_map_get(limits_map, "Max address space");
-  if (virtual_memory_max_bytes == NULL) {
+  if (max_fds == NULL || virtual_memory_max_bytes == NULL) {
     prom_process_limits_file_destroy(limits_f);
     prom_map_destroy(limits_map);
-    return NULL;
+    return 1;
   }
+  state->max_fds = max_fds->soft;
+  state->max_address_space = virtual_memory_max_bytes->soft;
+
+  r = prom_process_limits_file_destroy(limits_f);
+  if (r) return r;
+  return prom_map_destroy(limits_map);
+}
+
+/**
+ * @brief Parses the limits file again when it was never read or PROM_COLLECTOR_PROCESS_LIMITS_REFRESH_S elapsed
+ *
+ * @return A non-zero integer value upon failure
+ */
+static int prom_collector_process_load_limits(prom_collector_t *self, prom_collector_process_state_t *state) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (state->limits_read && now.tv_sec - state->limits_read_at.tv_sec < PROM_COLLECTOR_PROCESS_LIMITS_REFRESH_S) {
+    return 0;
+  }
+
+  int r = 0;
+
+  // Everything the parse builds is torn down before it returns, so it is allocated from an arena reset afterwards
+  if (state->scrape_arena == NULL) state->scrape_arena = prom_arena_new(PROM_COLLECTOR_PROCESS_ARENA_SIZE);
+  if (state->scrape_arena == NULL) return 1;
+  r = prom_arena_enter(state->scrape_arena);
+  if (r) return r;
+  r = prom_collector_process_parse_limits(self, state);
+  prom_arena_leave();
+  prom_arena_reset(state->scrape_arena);
+  if (r) return r;
+
+  state->limits_read = true;
+  state->limits_read_at = now;
+  return 0;
+}
+
+prom_map_t *prom_collector_process_collect(prom_collector_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+
+  int r = 0;
+
+  prom_collector_process_state_t *state = prom_collector_process_state(self);
+  if (state == NULL) return NULL;
+
+  // The limits only change on setrlimit, so they are parsed on a long interval and served from the cache otherwise
+  r = prom_collector_process_load_limits(self, state);
+  if (r) return NULL;
 
   // Set the metric values for max_fds and virtual_memory_max_bytes
-  r = prom_gauge_set(prom_process_max_fds, max_fds->soft, NULL);
+  r = prom_gauge_set(prom_process_max_fds, state->max_fds, NULL);
   if (r) return NULL;
-  r = prom_gauge_set(prom_process_virtual_memory_max_bytes, virtual_memory_max_bytes->soft, NULL);
+  r = prom_gauge_set(prom_process_virtual_memory_max_bytes, state->max_address_space, NULL);
   if (r) return NULL;
 
-  // Aloocate and create a *prom_process_stat_file_t
-  prom_process_stat_file_t *stat_f = prom_process_stat_file_new(self->proc_stat_file_path);
-  if (stat_f == NULL) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    return self->metrics;
-  }
+  // procfs regenerates the stat file on every read from offset 0, so the descriptor opened once is re-read in place
+  if (state->stat_fd < 0) return self->metrics;
+  char *stat_buf = state->stat_buf;
+  size_t stat_capacity = sizeof(state->stat_buf);
+  ssize_t len = prom_procfs_read(state->stat_fd, &stat_buf, &stat_capacity, stat_capacity);
+  if (len <= 0) return self->metrics;
 
-  // Allocate and create a *prom_process_stat_t from *prom_process_stat_file_t
-  prom_process_stat_t *stat = prom_process_stat_new(stat_f);
+  prom_process_stat_t stat;
+  memset(&stat, 0, sizeof(prom_process_stat_t));
+  r = prom_process_stat_parse(&stat, state->stat_buf, (size_t)len);
+  if (r) return self->metrics;
 
   // Set the metrics related to the stat file
-  r = prom_gauge_set(prom_process_cpu_seconds_total, ((stat->utime + stat->stime) / sysconf(_SC_CLK_TCK)), NULL);
-  if (r) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    prom_process_stat_file_destroy(stat_f);
-    prom_process_stat_destroy(stat);
-    return NULL;
-  }
-  r = prom_gauge_set(prom_process_virtual_memory_bytes, stat->vsize, NULL);
-  if (r) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    prom_process_stat_file_destroy(stat_f);
-    prom_process_stat_destroy(stat);
-    return NULL;
-  }
-  r = prom_gauge_set(prom_process_resident_memory_bytes, stat->rss*sysconf(_SC_PAGE_SIZE), NULL);
-  if (r) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    prom_process_stat_file_destroy(stat_f);
-    prom_process_stat_destroy(stat);
-    return NULL;
-  }
-  r = prom_gauge_set(prom_process_start_time_seconds, stat->starttime, NULL);
-  if (r) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    prom_process_stat_file_destroy(stat_f);
-    prom_process_stat_destroy(stat);
-    return NULL;
-  }
-  r = prom_gauge_set(prom_process_open_fds, prom_process_fds_count(NULL), NULL);
-  if (r) {
-    prom_process_limits_file_destroy(limits_f);
-    prom_map_destroy(limits_map);
-    prom_process_stat_file_destroy(stat_f);
-    prom_process_stat_destroy(stat);
-    return NULL;
-  }
-
-  // If there is any issue deallocating the following structures, return NULL to indicate failure
-  r = prom_process_limits_file_destroy(limits_f);
+  r = prom_gauge_set(prom_process_cpu_seconds_total, ((stat.utime + stat.stime) / sysconf(_SC_CLK_TCK)), NULL);
   if (r) return NULL;
-  r = prom_map_destroy(limits_map);
+  r = prom_gauge_set(prom_process_virtual_memory_bytes, stat.vsize, NULL);
   if (r) return NULL;
-  r = prom_process_stat_file_destroy(stat_f);
+  r = prom_gauge_set(prom_process_resident_memory_bytes, stat.rss * sysconf(_SC_PAGE_SIZE), NULL);
   if (r) return NULL;
-  r = prom_process_stat_destroy(stat);
+  r = prom_gauge_set(prom_process_start_time_seconds, stat.starttime, NULL);
   if (r) return NULL;
+  if (state->fd_dir != NULL) {
+    r = prom_gauge_set(prom_process_open_fds, prom_process_fds_count_dir(state->fd_dir), NULL);
+    if (r) return NULL;
+  }
 
   return self->metrics;
 }
@@ -15,8 +15,10 @@
  */
 
 #include <pthread.h>
-#include <regex.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
@@ -28,16 +30,26 @@
 #include "prom_collector_registry_t.h"
 #include "prom_collector_t.h"
 #include "prom_errors.h"
+#include "prom_intern_i.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_metric_formatter_i.h"
 #include "prom_metric_i.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_t.h"
 #include "prom_metric_t.h"
+#include "prom_name_i.h"
 #include "prom_process_limits_i.h"
 #include "prom_string_builder_i.h"
 
+#define PROM_COLLECTOR_REGISTRY_BRIDGE_ATTEMPTS 8
+#define PROM_COLLECTOR_REGISTRY_RENDER_INIT_SIZE 4096
+
 prom_collector_registry_t *PROM_COLLECTOR_REGISTRY_DEFAULT;
 
+// prom_collector_default_collect prototype declaration
+prom_map_t *prom_collector_default_collect(prom_collector_t *self);
+
 prom_collector_registry_t *prom_collector_registry_new(const char *name) {
   int r = 0;
 
@@ -46,7 +58,7 @@ prom_collector_registry_t *prom_collector_registry_new(const char *name) {
   self->disable_process_metrics = false;
 
   self->name = prom_strdup(name);
-  self->collectors = prom_map_new();
+  self->collectors = prom_map_new_read_mostly();
   prom_map_set_free_value_fn(self->collectors, &prom_collector_free_generic);
   prom_map_set(self->collectors, "default", prom_collector_new("default"));
 
@@ -58,6 +70,21 @@ prom_collector_registry_t *prom_collector_registry_new(const char *name) {
     PROM_LOG("failed to initialize rwlock");
     return NULL;
   }
+  self->render_lock = (pthread_mutex_t *)prom_malloc(sizeof(pthread_mutex_t));
+  r = pthread_mutex_init(self->render_lock, NULL);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_INIT_ERROR);
+    return NULL;
+  }
+  for (int i = 0; i < PROM_EXPOSITION_FORMAT_COUNT; i++) self->render[i] = NULL;
+  for (int i = 0; i < PROM_COLLECTOR_REGISTRY_RENDER_SLOTS; i++) self->render_slots[i] = NULL;
+  self->spans = NULL;
+  self->span_count = 0;
+  self->span_capacity = 0;
+  self->names = NULL;
+  self->names_len = 0;
+  self->names_capacity = 0;
+  self->metric_removals = 0;
   return self;
 }
 
@@ -121,6 +148,31 @@ int prom_collector_registry_destroy(prom_collector_registry_t *self) {
   self->lock = NULL;
   if (r) ret = r;
 
+  // Pooled renders are owned by the registry, so they are freed even if a reference is somehow still held
+  for (int i = 0; i < PROM_EXPOSITION_FORMAT_COUNT; i++) {
+    if (self->render[i] != NULL && !self->render[i]->pooled) {
+      prom_collector_registry_render_release(self->render[i]->data);
+    }
+    self->render[i] = NULL;
+  }
+  for (int i = 0; i < PROM_COLLECTOR_REGISTRY_RENDER_SLOTS; i++) {
+    if (self->render_slots[i] != NULL) {
+      prom_free(self->render_slots[i]->spans);
+      prom_free(self->render_slots[i]->names);
+    }
+    prom_free(self->render_slots[i]);
+    self->render_slots[i] = NULL;
+  }
+  prom_free(self->spans);
+  self->spans = NULL;
+  prom_free(self->names);
+  self->names = NULL;
+
+  r = pthread_mutex_destroy(self->render_lock);
+  prom_free(self->render_lock);
+  self->render_lock = NULL;
+  if (r) ret = r;
+
   prom_free((char *)self->name);
   self->name = NULL;
 
@@ -133,14 +185,46 @@ int prom_collector_registry_destroy(prom_collector_registry_t *self) {
 int prom_collector_registry_register_metric(prom_metric_t *metric) {
   PROM_ASSERT(metric != NULL);
 
-  prom_collector_t *default_collector =
-      (prom_collector_t *)prom_map_get(PROM_COLLECTOR_REGISTRY_DEFAULT->collectors, "default");
+  prom_collector_registry_t *self = PROM_COLLECTOR_REGISTRY_DEFAULT;
+  prom_collector_t *default_collector = (prom_collector_t *)prom_map_get(self->collectors, "default");
+
+  if (default_collector == NULL) {
+    return 1;
+  }
+
+  // Renders and streams walk the metrics of a collector under render_lock, so the new node is linked under it too
+  int r = pthread_mutex_lock(self->render_lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_LOCK_ERROR);
+    return r;
+  }
+  r = prom_collector_add_metric(default_collector, metric);
+  int rr = pthread_mutex_unlock(self->render_lock);
+  if (rr) PROM_LOG(PROM_PTHREAD_MUTEX_UNLOCK_ERROR);
+  return r;
+}
+
+int prom_collector_registry_unregister_metric(prom_metric_t *metric) {
+  PROM_ASSERT(metric != NULL);
+
+  prom_collector_registry_t *self = PROM_COLLECTOR_REGISTRY_DEFAULT;
+  prom_collector_t *default_collector = (prom_collector_t *)prom_map_get(self->collectors, "default");
 
   if (default_collector == NULL) {
     return 1;
   }
 
-  return prom_collector_add_metric(default_collector, metric);
+  // Renders walk the metrics of a collector under render_lock; streams notice the removal and stop walking them
+  int r = pthread_mutex_lock(self->render_lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_LOCK_ERROR);
+    return r;
+  }
+  r = prom_collector_remove_metric(default_collector, metric);
+  if (r == 0) self->metric_removals++;
+  int rr = pthread_mutex_unlock(self->render_lock);
+  if (rr) PROM_LOG(PROM_PTHREAD_MUTEX_UNLOCK_ERROR);
+  return r;
 }
 
 prom_metric_t *prom_collector_registry_must_register_metric(prom_metric_t *metric) {
@@ -182,6 +266,7 @@ int prom_collector_registry_register_collector(prom_collector_registry_t *self,
       return r;
     }
   }
+  prom_metric_sample_generation_bump();
   r = pthread_rwlock_unlock(self->lock);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
@@ -191,27 +276,597 @@ int prom_collector_registry_register_collector(prom_collector_registry_t *self,
 }
 
 int prom_collector_registry_validate_metric_name(prom_collector_registry_t *self, const char *metric_name) {
-  regex_t r;
-  int ret = 0;
-  ret = regcomp(&r, "^[a-zA-Z_:][a-zA-Z0-9_:]*$", REG_EXTENDED);
-  if (ret) {
-    PROM_LOG(PROM_REGEX_REGCOMP_ERROR);
-    regfree(&r);
-    return ret;
+  if (!prom_name_is_valid_metric(metric_name)) {
+    PROM_LOG(PROM_METRIC_INVALID_NAME);
+    return 1;
   }
+  return 0;
+}
 
-  ret = regexec(&r, metric_name, 0, NULL, 0);
-  if (ret) {
-    PROM_LOG(PROM_REGEX_REGEXEC_ERROR);
-    regfree(&r);
-    return ret;
+/**
+ * @brief API PRIVATE Runs the collect function of every collector that computes its samples on demand.
+ *
+ * Such collectors (e.g. the process collector) only update their samples when collected, so they are collected before
+ * the generation is compared against the cache. Collectors using the default collect function are skipped.
+ */
+static int prom_collector_registry_refresh(prom_collector_registry_t *self) {
+  for (prom_map_node_t *current_node = self->collectors->head; current_node != NULL;
+       current_node = current_node->next) {
+    prom_collector_t *collector = (prom_collector_t *)current_node->value;
+    if (collector == NULL) return 1;
+    if (collector->collect_fn == &prom_collector_default_collect) continue;
+    if (collector->collect_fn(collector) == NULL) return 1;
   }
-  regfree(&r);
   return 0;
 }
 
-const char *prom_collector_registry_bridge(prom_collector_registry_t *self) {
+/**
+ * @brief API PRIVATE Returns true if render is the cached render of one of the formats
+ */
+static bool prom_collector_registry_render_is_cached(prom_collector_registry_t *self,
+                                                     const prom_collector_registry_render_t *render) {
+  for (int i = 0; i < PROM_EXPOSITION_FORMAT_COUNT; i++) {
+    if (self->render[i] == render) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief API PRIVATE Returns a render with room for len bytes that no caller references, or NULL upon failure.
+ *
+ * The registry rotates through its render slots: the cached render of every format stays readable while a free slot
+ * is overwritten. A slot is reused only once every scrape that was served from it has released it; if none is free, an
+ * unpooled render is allocated for this one render and freed with its last reference. Slots grow by doubling and are
+ * never shrunk, so a steady-state render does not allocate.
+ *
+ * Must be called with render_lock held.
+ */
+static prom_collector_registry_render_t *prom_collector_registry_render_reserve(prom_collector_registry_t *self,
+                                                                                size_t len) {
+  for (int i = 0; i < PROM_COLLECTOR_REGISTRY_RENDER_SLOTS; i++) {
+    prom_collector_registry_render_t *slot = self->render_slots[i];
+    // References to a slot are only taken through the cache, so an uncached slot at zero stays free
+    if (slot != NULL && (prom_collector_registry_render_is_cached(self, slot) || atomic_load(&slot->refs) != 0)) {
+      continue;
+    }
+    if (slot == NULL || slot->capacity < len + 1) {
+      size_t capacity = slot == NULL ? PROM_COLLECTOR_REGISTRY_RENDER_INIT_SIZE : slot->capacity;
+      while (capacity < len + 1) capacity <<= 1;
+      bool fresh = slot == NULL;
+      slot = (prom_collector_registry_render_t *)prom_realloc(slot,
+                                                              sizeof(prom_collector_registry_render_t) + capacity);
+      if (slot == NULL) return NULL;
+      if (fresh) {
+        slot->spans = NULL;
+        slot->span_capacity = 0;
+        slot->names = NULL;
+        slot->names_capacity = 0;
+      }
+      slot->capacity = capacity;
+      slot->pooled = true;
+      self->render_slots[i] = slot;
+    }
+    atomic_init(&slot->refs, 1);
+    return slot;
+  }
+
+  prom_collector_registry_render_t *render =
+      (prom_collector_registry_render_t *)prom_malloc(sizeof(prom_collector_registry_render_t) + len + 1);
+  if (render == NULL) return NULL;
+  render->capacity = len + 1;
+  render->pooled = false;
+  render->spans = NULL;
+  render->span_capacity = 0;
+  render->names = NULL;
+  render->names_capacity = 0;
+  atomic_init(&render->refs, 1);
+  return render;
+}
+
+static int prom_collector_registry_span_compare(const void *a, const void *b) {
+  return strcmp(((const prom_collector_registry_span_t *)a)->name, ((const prom_collector_registry_span_t *)b)->name);
+}
+
+/**
+ * @brief API PRIVATE Appends a span for a family of the render in progress, copying the name of its metric.
+ *
+ * A render may be read after its metrics were unregistered and destroyed, so its spans never point into them.
+ */
+static int prom_collector_registry_add_span(prom_collector_registry_t *self, const char *name, size_t offset,
+                                            size_t len) {
+  if (self->span_count == self->span_capacity) {
+    size_t capacity = self->span_capacity == 0 ? 16 : self->span_capacity * 2;
+    prom_collector_registry_span_t *spans = (prom_collector_registry_span_t *)prom_realloc(
+        self->spans, sizeof(prom_collector_registry_span_t) * capacity);
+    if (spans == NULL) return 1;
+    self->spans = spans;
+    self->span_capacity = capacity;
+  }
+
+  size_t name_len = strlen(name) + 1;
+  if (self->names_len + name_len > self->names_capacity) {
+    size_t capacity = self->names_capacity == 0 ? 256 : self->names_capacity;
+    while (capacity < self->names_len + name_len) capacity <<= 1;
+    char *names = (char *)prom_realloc(self->names, capacity);
+    if (names == NULL) return 1;
+    self->names = names;
+    self->names_capacity = capacity;
+  }
+  memcpy(self->names + self->names_len, name, name_len);
+
+  // The names may still move as they grow, so the pointer is set once the render takes them over
+  self->spans[self->span_count++] = (prom_collector_registry_span_t){NULL, self->names_len, offset, len};
+  self->names_len += name_len;
+  return 0;
+}
+
+/**
+ * @brief API PRIVATE Loads every metric in the given format, recording the span of each family in self->spans.
+ *
+ * Must be called with render_lock held.
+ */
+static int prom_collector_registry_load_metrics(prom_collector_registry_t *self, prom_exposition_format_t format) {
+  int r = 0;
+  prom_string_builder_t *builder = self->metric_formatter->string_builder;
+
+  self->span_count = 0;
+  self->names_len = 0;
+  for (prom_map_node_t *current_node = self->collectors->head; current_node != NULL;
+       current_node = current_node->next) {
+    prom_collector_t *collector = (prom_collector_t *)current_node->value;
+    if (collector == NULL) return 1;
+
+    prom_map_t *metrics = collector->collect_fn(collector);
+    if (metrics == NULL) return 1;
+
+    for (prom_map_node_t *current_metric_node = metrics->head; current_metric_node != NULL;
+         current_metric_node = current_metric_node->next) {
+      prom_metric_t *metric = (prom_metric_t *)current_metric_node->value;
+      if (metric == NULL) return 1;
+
+      // Samples are only created and removed under the write lock, so the read lock keeps them in place
+      size_t offset = prom_string_builder_len(builder);
+      pthread_rwlock_rdlock(metric->rwlock);
+      r = prom_metric_formatter_load_metric_as(self->metric_formatter, metric, format);
+      pthread_rwlock_unlock(metric->rwlock);
+      if (r) return r;
+      size_t len = prom_string_builder_len(builder) - offset;
+      if (len == 0) continue;
+
+      r = prom_collector_registry_add_span(self, metric->name, offset, len);
+      if (r) return r;
+    }
+  }
+  if (format == PROM_EXPOSITION_OPENMETRICS) return prom_string_builder_add_str(builder, "# EOF\n");
+  return 0;
+}
+
+/**
+ * @brief API PRIVATE Renders the registry into a prom_collector_registry_render_t* holding one reference.
+ *
+ * Must be called with render_lock held.
+ */
+static prom_collector_registry_render_t *prom_collector_registry_render(prom_collector_registry_t *self,
+                                                                        prom_exposition_format_t format,
+                                                                        uint64_t generation) {
+  int r = 0;
+  prom_string_builder_t *builder = self->metric_formatter->string_builder;
+
+  // Render again if a batch of gauge updates was published while rendering, so that a batch is never half visible
+  for (int attempt = 1;; attempt++) {
+    uint64_t seq = prom_metric_sample_read_begin();
+    prom_metric_formatter_clear(self->metric_formatter);
+    r = prom_collector_registry_load_metrics(self, format);
+    if (r) {
+      PROM_LOG("failed to render the collector registry");
+      prom_metric_formatter_clear(self->metric_formatter);
+      return NULL;
+    }
+    if (prom_metric_sample_read_validate(seq) || attempt >= PROM_COLLECTOR_REGISTRY_BRIDGE_ATTEMPTS) break;
+  }
+
+  size_t len = prom_string_builder_len(builder);
+  prom_collector_registry_render_t *render = prom_collector_registry_render_reserve(self, len);
+  if (render != NULL) {
+    render->generation = generation;
+    render->len = len;
+    memcpy(render->data, prom_string_builder_str(builder), len + 1);
+
+    // Hand the spans and their names over rather than copying them; the registry keeps the render's previous arrays
+    // as scratch
+    prom_collector_registry_span_t *spans = render->spans;
+    size_t span_capacity = render->span_capacity;
+    render->spans = self->spans;
+    render->span_capacity = self->span_capacity;
+    render->span_count = self->span_count;
+    self->spans = spans;
+    self->span_capacity = span_capacity;
+    self->span_count = 0;
+    char *names = render->names;
+    size_t names_capacity = render->names_capacity;
+    render->names = self->names;
+    render->names_capacity = self->names_capacity;
+    self->names = names;
+    self->names_capacity = names_capacity;
+    self->names_len = 0;
+    for (size_t i = 0; i < render->span_count; i++) {
+      render->spans[i].name = render->names + render->spans[i].name_offset;
+    }
+    if (render->span_count > 1) {
+      qsort(render->spans, render->span_count, sizeof(prom_collector_registry_span_t),
+            &prom_collector_registry_span_compare);
+    }
+  }
   prom_metric_formatter_clear(self->metric_formatter);
-  prom_metric_formatter_load_metrics(self->metric_formatter, self->collectors);
-  return (const char *)prom_metric_formatter_dump(self->metric_formatter);
+  return render;
+}
+
+/**
+ * @brief API PRIVATE Visits every series of a metric, numbering them on from *index.
+ */
+static void prom_collector_registry_visit_metric(prom_metric_t *metric, prom_collector_registry_visit_fn *fn,
+                                                 void *arg, size_t *index) {
+  pthread_rwlock_rdlock(metric->rwlock);
+  for (prom_map_node_t *sample_node = metric->samples->head; sample_node != NULL; sample_node = sample_node->next) {
+    prom_metric_sample_t *sample = (prom_metric_sample_t *)sample_node->value;
+    // The interned prefix ends with the space before the value
+    prom_sample_view_t view = {sample->prefix, prom_intern_len(sample->prefix) - 1, sample->integer, 0.0, 0};
+    if (sample->integer) {
+      view.u_value = prom_metric_sample_value_u64(sample);
+    } else {
+      view.value = prom_metric_sample_value(sample);
+    }
+    fn((*index)++, &view, arg);
+  }
+  pthread_rwlock_unlock(metric->rwlock);
+}
+
+/**
+ * @brief API PRIVATE Visits every counter and gauge series once, numbering them from 0.
+ *
+ * Must be called with render_lock held.
+ */
+static int prom_collector_registry_visit_pass(prom_collector_registry_t *self, prom_collector_registry_visit_fn *fn,
+                                              void *arg, size_t *count) {
+  size_t index = 0;
+  for (prom_map_node_t *current_node = self->collectors->head; current_node != NULL;
+       current_node = current_node->next) {
+    prom_collector_t *collector = (prom_collector_t *)current_node->value;
+    if (collector == NULL) return 1;
+
+    prom_map_t *metrics = collector->collect_fn(collector);
+    if (metrics == NULL) return 1;
+
+    for (prom_map_node_t *metric_node = metrics->head; metric_node != NULL; metric_node = metric_node->next) {
+      prom_metric_t *metric = (prom_metric_t *)metric_node->value;
+      if (metric == NULL) return 1;
+      if (metric->type != PROM_COUNTER && metric->type != PROM_GAUGE) continue;
+      prom_collector_registry_visit_metric(metric, fn, arg, &index);
+    }
+  }
+  *count = index;
+  return 0;
+}
+
+int prom_collector_registry_visit_samples(prom_collector_registry_t *self, prom_collector_registry_visit_fn *fn,
+                                          void *arg, size_t *count) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || fn == NULL) return 1;
+
+  int r = pthread_mutex_lock(self->render_lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_LOCK_ERROR);
+    return r;
+  }
+
+  r = prom_collector_registry_refresh(self);
+  if (r) PROM_LOG("failed to collect on-demand collectors");
+
+  size_t visited = 0;
+  for (int attempt = 1;; attempt++) {
+    uint64_t seq = prom_metric_sample_read_begin();
+    r = prom_collector_registry_visit_pass(self, fn, arg, &visited);
+    if (r || prom_metric_sample_read_validate(seq) || attempt >= PROM_COLLECTOR_REGISTRY_BRIDGE_ATTEMPTS) break;
+  }
+
+  int rr = pthread_mutex_unlock(self->render_lock);
+  if (rr) PROM_LOG(PROM_PTHREAD_MUTEX_UNLOCK_ERROR);
+  if (r) {
+    PROM_LOG("failed to visit the collector registry");
+    return r;
+  }
+  if (count != NULL) *count = visited;
+  return 0;
+}
+
+int prom_metric_visit_samples(prom_metric_t *metric, prom_collector_registry_visit_fn *fn, void *arg, size_t *count) {
+  PROM_ASSERT(metric != NULL);
+  if (metric == NULL || fn == NULL) return 1;
+  if (metric->type != PROM_COUNTER && metric->type != PROM_GAUGE) return 1;
+
+  size_t visited = 0;
+  for (int attempt = 1;; attempt++) {
+    uint64_t seq = prom_metric_sample_read_begin();
+    visited = 0;
+    prom_collector_registry_visit_metric(metric, fn, arg, &visited);
+    if (prom_metric_sample_read_validate(seq) || attempt >= PROM_COLLECTOR_REGISTRY_BRIDGE_ATTEMPTS) break;
+  }
+  if (count != NULL) *count = visited;
+  return 0;
+}
+
+int prom_collector_registry_sweep(prom_collector_registry_t *self, size_t *evicted) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  // Unregistering a metric frees it under render_lock
+  int r = pthread_mutex_lock(self->render_lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_LOCK_ERROR);
+    return r;
+  }
+  size_t total = 0;
+  for (prom_map_node_t *current_node = self->collectors->head; current_node != NULL;
+       current_node = current_node->next) {
+    prom_collector_t *collector = (prom_collector_t *)current_node->value;
+    for (prom_map_node_t *metric_node = collector->metrics->head; metric_node != NULL; metric_node = metric_node->next) {
+      total += prom_metric_sweep((prom_metric_t *)metric_node->value);
+    }
+  }
+  r = pthread_mutex_unlock(self->render_lock);
+  if (r) PROM_LOG(PROM_PTHREAD_MUTEX_UNLOCK_ERROR);
+  if (evicted != NULL) *evicted = total;
+  return r;
+}
+
+uint64_t prom_collector_registry_generation(void) { return prom_metric_sample_generation(); }
+
+const char *prom_collector_registry_render_acquire(prom_collector_registry_t *self, size_t *len) {
+  return prom_collector_registry_render_acquire_format(self, PROM_EXPOSITION_TEXT, len);
+}
+
+const char *prom_collector_registry_render_acquire_format(prom_collector_registry_t *self,
+                                                          prom_exposition_format_t format, size_t *len) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (format < 0 || format >= PROM_EXPOSITION_FORMAT_COUNT) return NULL;
+
+  int r = 0;
+
+  r = pthread_mutex_lock(self->render_lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_LOCK_ERROR);
+    return NULL;
+  }
+
+  r = prom_collector_registry_refresh(self);
+  if (r) PROM_LOG("failed to collect on-demand collectors");
+
+  // Read before rendering: a change landing mid-render leaves the cache one generation behind and is picked up by
+  // the next call instead of being lost
+  uint64_t generation = prom_metric_sample_generation();
+  if (self->render[format] == NULL || self->render[format]->generation != generation) {
+    prom_collector_registry_render_t *render = prom_collector_registry_render(self, format, generation);
+    if (render == NULL) {
+      pthread_mutex_unlock(self->render_lock);
+      return NULL;
+    }
+    if (self->render[format] != NULL) prom_collector_registry_render_release(self->render[format]->data);
+    self->render[format] = render;
+  }
+
+  prom_collector_registry_render_t *render = self->render[format];
+  atomic_fetch_add(&render->refs, 1);
+
+  r = pthread_mutex_unlock(self->render_lock);
+  if (r) PROM_LOG(PROM_PTHREAD_MUTEX_UNLOCK_ERROR);
+
+  if (len != NULL) *len = render->len;
+  return render->data;
+}
+
+void prom_collector_registry_render_release(const char *data) {
+  if (data == NULL) return;
+  prom_collector_registry_render_t *render =
+      (prom_collector_registry_render_t *)(data - offsetof(prom_collector_registry_render_t, data));
+  if (atomic_fetch_sub(&render->refs, 1) == 1 && !render->pooled) {
+    prom_free(render->spans);
+    prom_free(render->names);
+    prom_free(render);
+  }
+}
+
+uint64_t prom_collector_registry_render_generation(const char *data) {
+  PROM_ASSERT(data != NULL);
+  const prom_collector_registry_render_t *render =
+      (const prom_collector_registry_render_t *)(data - offsetof(prom_collector_registry_render_t, data));
+  return render->generation;
+}
+
+prom_collector_registry_stream_t *prom_collector_registry_stream_new(prom_collector_registry_t *self,
+                                                                     prom_exposition_format_t format) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (format < 0 || format >= PROM_EXPOSITION_FORMAT_COUNT) return NULL;
+
+  prom_collector_registry_stream_t *stream =
+      (prom_collector_registry_stream_t *)prom_malloc(sizeof(prom_collector_registry_stream_t));
+  if (stream == NULL) return NULL;
+  stream->registry = self;
+  stream->format = format;
+  stream->offset = 0;
+  stream->collector_node = self->collectors->head;
+  stream->metric_node = NULL;
+  stream->sample_node = NULL;
+  stream->metric_removals = 0;
+  stream->header_done = false;
+  stream->done = false;
+  stream->formatter = prom_metric_formatter_new();
+  if (stream->formatter == NULL) {
+    prom_free(stream);
+    return NULL;
+  }
+  return stream;
+}
+
+/**
+ * @brief API PRIVATE Renders the next unit of a stream into its formatter, which must be empty.
+ *
+ * A unit is the header of a metric, one of its samples or its footer; in the protobuf format, a whole metric family.
+ * Units may be empty, e.g. the footer of an OpenMetrics metric.
+ */
+static int prom_collector_registry_stream_next(prom_collector_registry_stream_t *self) {
+  int r = 0;
+
+  if (self->metric_node == NULL) {
+    if (self->collector_node == NULL) {
+      self->done = true;
+      if (self->format == PROM_EXPOSITION_OPENMETRICS) {
+        return prom_string_builder_add_str(self->formatter->string_builder, "# EOF\n");
+      }
+      return 0;
+    }
+
+    prom_collector_t *collector = (prom_collector_t *)self->collector_node->value;
+    if (collector == NULL) return 1;
+    self->collector_node = self->collector_node->next;
+
+    // Collect functions may update their samples, so they run one at a time like in a full render
+    r = pthread_mutex_lock(self->registry->render_lock);
+    if (r) {
+      PROM_LOG(PROM_PTHREAD_MUTEX_LOCK_ERROR);
+      return r;
+    }
+    prom_map_t *metrics = collector->collect_fn(collector);
+    self->metric_node = metrics == NULL ? NULL : metrics->head;
+    self->metric_removals = self->registry->metric_removals;
+    r = pthread_mutex_unlock(self->registry->render_lock);
+    if (r) PROM_LOG(PROM_PTHREAD_MUTEX_UNLOCK_ERROR);
+    if (metrics == NULL) return 1;
+
+    self->header_done = false;
+    return 0;
+  }
+
+  // Metric nodes are freed when their metric is unregistered, so they are only followed under render_lock and while
+  // no metric was unregistered since the collector was collected; otherwise the rest of the collector is left out
+  r = pthread_mutex_lock(self->registry->render_lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_LOCK_ERROR);
+    return r;
+  }
+  bool unregistered = self->registry->metric_removals != self->metric_removals;
+  prom_metric_t *metric = unregistered ? NULL : (prom_metric_t *)self->metric_node->value;
+  prom_map_node_t *next_node = unregistered ? NULL : self->metric_node->next;
+  r = pthread_mutex_unlock(self->registry->render_lock);
+  if (r) PROM_LOG(PROM_PTHREAD_MUTEX_UNLOCK_ERROR);
+  if (unregistered) {
+    self->metric_node = NULL;
+    if (!self->header_done) return 0;
+    self->header_done = false;
+    return prom_metric_formatter_load_metric_footer(self->formatter, self->format);
+  }
+  if (metric == NULL) return 1;
+
+  // A MetricFamily message is prefixed with its length, so it cannot be split
+  if (self->format == PROM_EXPOSITION_PROTOBUF) {
+    self->metric_node = next_node;
+    pthread_rwlock_rdlock(metric->rwlock);
+    r = prom_metric_formatter_load_metric_as(self->formatter, metric, self->format);
+    pthread_rwlock_unlock(metric->rwlock);
+    return r;
+  }
+
+  if (!self->header_done) {
+    self->header_done = true;
+    pthread_rwlock_rdlock(metric->rwlock);
+    self->sample_node = metric->samples->head;
+    self->removals = metric->removals;
+    pthread_rwlock_unlock(metric->rwlock);
+    return prom_metric_formatter_load_metric_header(self->formatter, metric, self->format);
+  }
+
+  if (self->sample_node != NULL) {
+    // The lock is not held between units, so a removal since the header may have freed the next sample; the rest of
+    // the family is then left out of this scrape
+    pthread_rwlock_rdlock(metric->rwlock);
+    bool removed = metric->removals != self->removals;
+    if (removed) {
+      self->sample_node = NULL;
+    } else {
+      void *sample = self->sample_node->value;
+      self->sample_node = self->sample_node->next;
+      r = prom_metric_formatter_load_metric_sample(self->formatter, metric, sample, self->format);
+    }
+    pthread_rwlock_unlock(metric->rwlock);
+    if (!removed) return r;
+  }
+
+  self->metric_node = next_node;
+  self->header_done = false;
+  return prom_metric_formatter_load_metric_footer(self->formatter, self->format);
+}
+
+ssize_t prom_collector_registry_stream_read(prom_collector_registry_stream_t *self, char *buf, size_t max) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return -1;
+
+  int r = 0;
+  prom_string_builder_t *builder = self->formatter->string_builder;
+
+  size_t n = 0;
+  while (n < max) {
+    size_t len = prom_string_builder_len(builder);
+    if (self->offset < len) {
+      size_t count = len - self->offset < max - n ? len - self->offset : max - n;
+      memcpy(buf + n, prom_string_builder_str(builder) + self->offset, count);
+      self->offset += count;
+      n += count;
+      continue;
+    }
+    if (self->done) break;
+
+    r = prom_metric_formatter_clear(self->formatter);
+    if (r) return -1;
+    self->offset = 0;
+
+    r = prom_collector_registry_stream_next(self);
+    if (r) {
+      PROM_LOG("failed to render the collector registry");
+      return -1;
+    }
+  }
+  return (ssize_t)n;
+}
+
+void prom_collector_registry_stream_destroy(prom_collector_registry_stream_t *self) {
+  if (self == NULL) return;
+  prom_metric_formatter_destroy(self->formatter);
+  self->formatter = NULL;
+  prom_free(self);
+}
+
+const char *prom_collector_registry_render_find(const char *data, const char *name, size_t *len) {
+  PROM_ASSERT(data != NULL);
+  if (data == NULL || name == NULL) return NULL;
+  const prom_collector_registry_render_t *render =
+      (const prom_collector_registry_render_t *)(data - offsetof(prom_collector_registry_render_t, data));
+
+  prom_collector_registry_span_t key = {name, 0, 0, 0};
+  const prom_collector_registry_span_t *span = (const prom_collector_registry_span_t *)bsearch(
+      &key, render->spans, render->span_count, sizeof(prom_collector_registry_span_t),
+      &prom_collector_registry_span_compare);
+  if (span == NULL) return NULL;
+  if (len != NULL) *len = span->len;
+  return data + span->offset;
+}
+
+const char *prom_collector_registry_bridge(prom_collector_registry_t *self) {
+  size_t len = 0;
+  const char *data = prom_collector_registry_render_acquire(self, &len);
+  if (data == NULL) return NULL;
+  char *out = (char *)prom_malloc(len + 1);
+  if (out != NULL) memcpy(out, data, len + 1);
+  prom_collector_registry_render_release(data);
+  return out;
 }
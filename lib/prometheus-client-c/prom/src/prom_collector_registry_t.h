@@ -18,7 +18,10 @@
 #define PROM_REGISTRY_T_H
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 // Public
 #include "prom_collector_registry.h"
@@ -28,6 +31,37 @@
 #include "prom_metric_formatter_t.h"
 #include "prom_string_builder_t.h"
 
+// Number of long-lived render buffers owned by each registry: one cached render per format plus one to render into.
+// Slots are allocated on first use, so a registry scraped in a single format only ever allocates two.
+#define PROM_COLLECTOR_REGISTRY_RENDER_SLOTS (PROM_EXPOSITION_FORMAT_COUNT + 1)
+
+/**
+ * @brief The bytes of a render holding one metric family
+ */
+typedef struct prom_collector_registry_span {
+  const char *name;   /**< Name of the metric, copied into the names of the render so it outlives the metric */
+  size_t name_offset; /**< Offset of name in those names */
+  size_t offset;      /**< Offset of the family in the render data */
+  size_t len;         /**< Length of the family in bytes */
+} prom_collector_registry_span_t;
+
+/**
+ * @brief A reference counted exposition rendered at a given sample generation
+ */
+typedef struct prom_collector_registry_render {
+  _Atomic unsigned int refs;             /**< References held by the registry cache and by in-flight scrapes */
+  bool pooled;                           /**< Owned by a registry render slot and kept when refs drops to zero */
+  uint64_t generation;                   /**< Sample generation observed before rendering */
+  prom_collector_registry_span_t *spans; /**< Family of each metric, sorted by name */
+  size_t span_count;                     /**< Number of entries in spans */
+  size_t span_capacity;                  /**< Entries available in spans */
+  char *names;                           /**< Names of the spans, each NUL terminated */
+  size_t names_capacity;                 /**< Bytes available in names */
+  size_t len;                            /**< Length of data in bytes, excluding the terminating NUL */
+  size_t capacity;                       /**< Bytes available in data */
+  char data[];                           /**< The exposition, NUL terminated */
+} prom_collector_registry_render_t;
+
 struct prom_collector_registry {
   const char *name;
   bool disable_process_metrics;              /**< Disables the collection of process metrics */
@@ -35,6 +69,33 @@ struct prom_collector_registry {
   prom_string_builder_t *string_builder;     /**< Enables string building */
   prom_metric_formatter_t *metric_formatter; /**< metric formatter for metric exposition on bridge call */
   pthread_rwlock_t *lock;                    /**< mutex for safety against concurrent registration */
+  pthread_mutex_t *render_lock;              /**< serializes renders and access to render */
+  prom_collector_registry_render_t *render[PROM_EXPOSITION_FORMAT_COUNT]; /**< cached exposition per format */
+  prom_collector_registry_render_t *render_slots[PROM_COLLECTOR_REGISTRY_RENDER_SLOTS]; /**< reusable buffers */
+  prom_collector_registry_span_t *spans;    /**< spans of the render in progress, handed over to the render */
+  size_t span_count;                        /**< number of entries in spans */
+  size_t span_capacity;                     /**< entries available in spans */
+  char *names;                              /**< names of the spans of the render in progress, handed over too */
+  size_t names_len;                         /**< bytes used in names */
+  size_t names_capacity;                    /**< bytes available in names */
+  uint64_t metric_removals;                 /**< metrics unregistered so far, advanced under render_lock */
+};
+
+/**
+ * @brief The position of an incremental render within the collectors, metrics and samples of a registry
+ */
+struct prom_collector_registry_stream {
+  prom_collector_registry_t *registry; /**< Registry being rendered */
+  prom_exposition_format_t format;     /**< Exposition format */
+  prom_metric_formatter_t *formatter;  /**< Holds the unit rendered last, a metric header or sample */
+  size_t offset;                       /**< Bytes of the formatter string already read */
+  prom_map_node_t *collector_node;     /**< Next collector to collect, NULL once every collector was collected */
+  prom_map_node_t *metric_node;        /**< Metric being rendered, NULL between collectors */
+  prom_map_node_t *sample_node;        /**< Next sample of the metric, NULL once every sample was rendered */
+  size_t removals;                     /**< Removals of the metric when its header was rendered */
+  uint64_t metric_removals;            /**< Metrics unregistered from the registry when the collector was collected */
+  bool header_done;                    /**< The header of the metric was rendered */
+  bool done;                           /**< The last unit was rendered */
 };
 
 #endif  // PROM_REGISTRY_T_H
@@ -17,10 +17,38 @@
 #ifndef PROM_COLLECTOR_T_H
 #define PROM_COLLECTOR_T_H
 
+#include <dirent.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "prom_arena.h"
 #include "prom_collector.h"
 #include "prom_map_t.h"
+#include "prom_process_stat_t.h"
 #include "prom_string_builder_t.h"
 
+// Seconds between two parses of /proc/[pid]/limits, which only changes on setrlimit
+#define PROM_COLLECTOR_PROCESS_LIMITS_REFRESH_S 60
+
+// Size of the arena holding the buffer, map and rows built while parsing /proc/[pid]/limits
+#define PROM_COLLECTOR_PROCESS_ARENA_SIZE (16 * 1024)
+
+/**
+ * @brief Files and values the process collector keeps between scrapes
+ */
+typedef struct prom_collector_process_state {
+  pid_t pid;                                              /**< Process the files were opened for */
+  int stat_fd;                                            /**< /proc/[pid]/stat, re-read with pread, or -1 */
+  DIR *fd_dir;                                            /**< /proc/[pid]/fd, rewound on every scrape, or NULL */
+  char stat_buf[PROM_PROCESS_STAT_SIZE_HINT];             /**< Contents of the stat file */
+  bool limits_read;                                       /**< The limits below were parsed once */
+  struct timespec limits_read_at;                         /**< CLOCK_MONOTONIC time of the last limits parse */
+  int max_fds;                                            /**< Soft limit of open files */
+  int max_address_space;                                  /**< Soft limit of the address space */
+  prom_arena_t *scrape_arena;                             /**< Transient allocations of a limits parse, or NULL */
+} prom_collector_process_state_t;
+
 struct prom_collector {
   const char *name;
   prom_map_t *metrics;
@@ -28,6 +56,7 @@ struct prom_collector {
   prom_string_builder_t *string_builder;
   const char *proc_limits_file_path;
   const char *proc_stat_file_path;
+  prom_collector_process_state_t *process_state; /**< State of the process collector, NULL for other collectors */
 };
 
 #endif  // PROM_COLLECTOR_T_H
@@ -23,15 +23,45 @@
 #include "prom_assert.h"
 #include "prom_errors.h"
 #include "prom_log.h"
+#include "prom_metric_dense_i.h"
 #include "prom_metric_i.h"
 #include "prom_metric_sample_i.h"
 #include "prom_metric_sample_t.h"
+#include "prom_metric_shard_i.h"
 #include "prom_metric_t.h"
 
 prom_counter_t *prom_counter_new(const char *name, const char *help, size_t label_key_count, const char **label_keys) {
   return (prom_counter_t *)prom_metric_new(PROM_COUNTER, name, help, label_key_count, label_keys);
 }
 
+prom_counter_t *prom_counter_new_sharded(const char *name, const char *help, size_t label_key_count,
+                                         const char **label_keys) {
+  prom_counter_t *self = prom_counter_new(name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->shard_count = prom_metric_shard_count();
+  return self;
+}
+
+prom_counter_t *prom_counter_new_dense(const char *name, const char *help, size_t label_key_count,
+                                       const char **label_keys) {
+  prom_counter_t *self = prom_counter_new(name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->dense = prom_metric_dense_new();
+  if (self->dense == NULL) {
+    prom_counter_destroy(self);
+    return NULL;
+  }
+  return self;
+}
+
+prom_counter_t *prom_counter_new_integer(const char *name, const char *help, size_t label_key_count,
+                                         const char **label_keys) {
+  prom_counter_t *self = prom_counter_new(name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->integer = true;
+  return self;
+}
+
 int prom_counter_destroy(prom_counter_t *self) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 0;
@@ -48,9 +78,7 @@ int prom_counter_inc(prom_counter_t *self, const char **label_values) {
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_add(sample, 1.0);
+  return prom_metric_update(self, label_values, &prom_metric_sample_add, 1.0);
 }
 
 int prom_counter_add(prom_counter_t *self, double r_value, const char **label_values) {
@@ -60,7 +88,35 @@ int prom_counter_add(prom_counter_t *self, double r_value, const char **label_va
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_add(sample, r_value);
+  return prom_metric_update(self, label_values, &prom_metric_sample_add, r_value);
+}
+
+int prom_counter_set(prom_counter_t *self, double r_value, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_COUNTER) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_update(self, label_values, &prom_metric_sample_store, r_value);
+}
+
+prom_metric_sample_t *prom_counter_with_labels(prom_counter_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (self->type != PROM_COUNTER) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return NULL;
+  }
+  return prom_metric_sample_from_labels(self, label_values);
+}
+
+int prom_counter_remove(prom_counter_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_COUNTER) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_remove_labels(self, label_values);
 }
@@ -0,0 +1,345 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Shortest round-trip double to string conversion using the Grisu2 algorithm described in "Printing Floating-Point
+ * Numbers Quickly and Accurately with Integers" (Florian Loitsch, PLDI 2010).
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Private
+#include "prom_dtoa_i.h"
+
+#define PROM_DTOA_SIGNIFICAND_SIZE 52
+#define PROM_DTOA_EXPONENT_BIAS (0x3FF + PROM_DTOA_SIGNIFICAND_SIZE)
+#define PROM_DTOA_DENORMAL_EXPONENT (1 - PROM_DTOA_EXPONENT_BIAS)
+#define PROM_DTOA_EXPONENT_MASK 0x7FF0000000000000ULL
+#define PROM_DTOA_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define PROM_DTOA_HIDDEN_BIT 0x0010000000000000ULL
+
+// Integral values below this magnitude are exactly representable and written without going through Grisu
+#define PROM_DTOA_MAX_EXACT_INTEGER 9007199254740992.0
+
+// Normalized 64-bit significands and binary exponents of 10^k for k = -348, -340, ..., 340
+static const uint64_t prom_dtoa_cached_powers_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+    0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+    0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+    0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+    0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+    0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+    0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+    0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+    0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+    0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+    0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+    0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+static const int16_t prom_dtoa_cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+static const uint64_t prom_dtoa_pow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL,
+    100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+    10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+    1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/**
+ * @brief A floating point number with a 64-bit significand and no implicit bit: f * 2^e
+ */
+typedef struct prom_dtoa_diy_fp {
+  uint64_t f;
+  int e;
+} prom_dtoa_diy_fp_t;
+
+static prom_dtoa_diy_fp_t prom_dtoa_diy_fp_from_double(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  int biased_e = (int)((bits & PROM_DTOA_EXPONENT_MASK) >> PROM_DTOA_SIGNIFICAND_SIZE);
+  uint64_t significand = bits & PROM_DTOA_SIGNIFICAND_MASK;
+  prom_dtoa_diy_fp_t fp;
+  if (biased_e != 0) {
+    fp.f = significand + PROM_DTOA_HIDDEN_BIT;
+    fp.e = biased_e - PROM_DTOA_EXPONENT_BIAS;
+  } else {
+    fp.f = significand;
+    fp.e = PROM_DTOA_DENORMAL_EXPONENT;
+  }
+  return fp;
+}
+
+static prom_dtoa_diy_fp_t prom_dtoa_diy_fp_normalize(prom_dtoa_diy_fp_t fp) {
+  while (!(fp.f & (1ULL << 63))) {
+    fp.f <<= 1;
+    fp.e--;
+  }
+  return fp;
+}
+
+/**
+ * @brief Returns the rounded upper 64 bits of the 128-bit product of a and b
+ */
+static prom_dtoa_diy_fp_t prom_dtoa_diy_fp_multiply(prom_dtoa_diy_fp_t a, prom_dtoa_diy_fp_t b) {
+  const uint64_t mask32 = 0xFFFFFFFFULL;
+  uint64_t a_hi = a.f >> 32, a_lo = a.f & mask32;
+  uint64_t b_hi = b.f >> 32, b_lo = b.f & mask32;
+  uint64_t hh = a_hi * b_hi, hl = a_hi * b_lo, lh = a_lo * b_hi, ll = a_lo * b_lo;
+  uint64_t mid = (ll >> 32) + (hl & mask32) + (lh & mask32);
+  mid += 1ULL << 31;  // round
+  prom_dtoa_diy_fp_t product = {hh + (hl >> 32) + (lh >> 32) + (mid >> 32), a.e + b.e + 64};
+  return product;
+}
+
+/**
+ * @brief Computes the normalized boundaries m- and m+ halfway to the neighbouring doubles, sharing the exponent of m+
+ */
+static void prom_dtoa_normalized_boundaries(prom_dtoa_diy_fp_t v, prom_dtoa_diy_fp_t *minus, prom_dtoa_diy_fp_t *plus) {
+  prom_dtoa_diy_fp_t pl = {(v.f << 1) + 1, v.e - 1};
+  while (!(pl.f & (PROM_DTOA_HIDDEN_BIT << 1))) {
+    pl.f <<= 1;
+    pl.e--;
+  }
+  pl.f <<= 64 - PROM_DTOA_SIGNIFICAND_SIZE - 2;
+  pl.e -= 64 - PROM_DTOA_SIGNIFICAND_SIZE - 2;
+
+  // The lower boundary is closer when v is a power of two, since the double below it has a smaller exponent
+  prom_dtoa_diy_fp_t mi;
+  if (v.f == PROM_DTOA_HIDDEN_BIT) {
+    mi.f = (v.f << 2) - 1;
+    mi.e = v.e - 2;
+  } else {
+    mi.f = (v.f << 1) - 1;
+    mi.e = v.e - 1;
+  }
+  mi.f <<= mi.e - pl.e;
+  mi.e = pl.e;
+
+  *plus = pl;
+  *minus = mi;
+}
+
+/**
+ * @brief Returns the cached power of ten c = 10^-k whose product with a number of binary exponent e lands in the
+ * exponent range [-60, -32] expected by prom_dtoa_digit_gen
+ */
+static prom_dtoa_diy_fp_t prom_dtoa_cached_power(int e, int *k) {
+  // log10(2) = 0.30102999566398114
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int ik = (int)dk;
+  if (dk - ik > 0.0) ik++;
+  unsigned int index = (unsigned int)((ik >> 3) + 1);
+  *k = -(-348 + (int)(index << 3));
+  prom_dtoa_diy_fp_t power = {prom_dtoa_cached_powers_f[index], prom_dtoa_cached_powers_e[index]};
+  return power;
+}
+
+static int prom_dtoa_count_digits(uint32_t n) {
+  int digits = 1;
+  while (digits < 10 && n >= prom_dtoa_pow10[digits]) digits++;
+  return digits;
+}
+
+/**
+ * @brief Moves the last generated digit towards w while the result stays within the rounding interval
+ */
+static void prom_dtoa_round(char *buffer, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w) {
+  while (rest < wp_w && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    buffer[len - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+/**
+ * @brief Generates the shortest digits of a number within delta of mp, and adjusts the decimal exponent k
+ */
+static int prom_dtoa_digit_gen(prom_dtoa_diy_fp_t w, prom_dtoa_diy_fp_t mp, uint64_t delta, char *buffer, int *k) {
+  const prom_dtoa_diy_fp_t one = {1ULL << -mp.e, mp.e};
+  const uint64_t wp_w = mp.f - w.f;
+  uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+  uint64_t p2 = mp.f & (one.f - 1);
+  int kappa = prom_dtoa_count_digits(p1);
+  int len = 0;
+
+  // Integral part
+  while (kappa > 0) {
+    uint32_t d = (uint32_t)(p1 / prom_dtoa_pow10[kappa - 1]);
+    p1 = (uint32_t)(p1 % prom_dtoa_pow10[kappa - 1]);
+    if (d || len) buffer[len++] = (char)('0' + d);
+    kappa--;
+    uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+    if (rest <= delta) {
+      *k += kappa;
+      prom_dtoa_round(buffer, len, delta, rest, prom_dtoa_pow10[kappa] << -one.e, wp_w);
+      return len;
+    }
+  }
+
+  // Fractional part
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+    char d = (char)(p2 >> -one.e);
+    if (d || len) buffer[len++] = (char)('0' + d);
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < delta) {
+      *k += kappa;
+      int index = -kappa;
+      prom_dtoa_round(buffer, len, delta, p2, one.f, index < 20 ? wp_w * prom_dtoa_pow10[index] : 0);
+      return len;
+    }
+  }
+}
+
+/**
+ * @brief Writes the digits of a positive finite value to buffer and returns their count; value = digits * 10^k
+ */
+static int prom_dtoa_grisu2(double value, char *buffer, int *k) {
+  prom_dtoa_diy_fp_t v = prom_dtoa_diy_fp_from_double(value);
+  prom_dtoa_diy_fp_t w_m, w_p;
+  prom_dtoa_normalized_boundaries(v, &w_m, &w_p);
+
+  prom_dtoa_diy_fp_t c_mk = prom_dtoa_cached_power(w_p.e, k);
+  prom_dtoa_diy_fp_t w = prom_dtoa_diy_fp_multiply(prom_dtoa_diy_fp_normalize(v), c_mk);
+  prom_dtoa_diy_fp_t wp = prom_dtoa_diy_fp_multiply(w_p, c_mk);
+  prom_dtoa_diy_fp_t wm = prom_dtoa_diy_fp_multiply(w_m, c_mk);
+  // Shrink the interval by one unit on each side to absorb the rounding error of the multiplications
+  wm.f++;
+  wp.f--;
+  return prom_dtoa_digit_gen(w, wp, wp.f - wm.f, buffer, k);
+}
+
+static int prom_dtoa_write_exponent(int exponent, char *buffer) {
+  int len = 0;
+  buffer[len++] = 'e';
+  if (exponent < 0) {
+    buffer[len++] = '-';
+    exponent = -exponent;
+  } else {
+    buffer[len++] = '+';
+  }
+  if (exponent >= 100) {
+    buffer[len++] = (char)('0' + exponent / 100);
+    exponent %= 100;
+    buffer[len++] = (char)('0' + exponent / 10);
+  } else {
+    buffer[len++] = (char)('0' + exponent / 10);
+  }
+  buffer[len++] = (char)('0' + exponent % 10);
+  return len;
+}
+
+/**
+ * @brief Lays out len digits with decimal exponent k in fixed or scientific notation
+ */
+static int prom_dtoa_prettify(char *buffer, int len, int k) {
+  // Position of the decimal point relative to the first digit: 10^(kk-1) <= v < 10^kk
+  const int kk = len + k;
+
+  if (k >= 0 && kk <= 21) {
+    // 1234e7 -> 12340000000
+    memset(buffer + len, '0', (size_t)k);
+    return kk;
+  }
+  if (kk > 0 && kk <= 21) {
+    // 1234e-2 -> 12.34
+    memmove(buffer + kk + 1, buffer + kk, (size_t)(len - kk));
+    buffer[kk] = '.';
+    return len + 1;
+  }
+  if (kk > -6 && kk <= 0) {
+    // 1234e-6 -> 0.001234
+    const int offset = 2 - kk;
+    memmove(buffer + offset, buffer, (size_t)len);
+    buffer[0] = '0';
+    buffer[1] = '.';
+    memset(buffer + 2, '0', (size_t)(offset - 2));
+    return len + offset;
+  }
+  if (len == 1) {
+    // 1e30
+    return 1 + prom_dtoa_write_exponent(kk - 1, buffer + 1);
+  }
+  // 1234e30 -> 1.234e+33
+  memmove(buffer + 2, buffer + 1, (size_t)(len - 1));
+  buffer[1] = '.';
+  return len + 1 + prom_dtoa_write_exponent(kk - 1, buffer + len + 1);
+}
+
+static int prom_dtoa_write_integer(uint64_t n, char *buffer) {
+  char digits[20];
+  int count = 0;
+  do {
+    digits[count++] = (char)('0' + n % 10);
+    n /= 10;
+  } while (n != 0);
+  for (int i = 0; i < count; i++) buffer[i] = digits[count - 1 - i];
+  return count;
+}
+
+int prom_dtoa(double value, char *buffer) {
+  int len = 0;
+
+  if (isnan(value)) {
+    memcpy(buffer, "NaN", 4);
+    return 3;
+  }
+  if (isinf(value)) {
+    memcpy(buffer, value > 0 ? "+Inf" : "-Inf", 5);
+    return 4;
+  }
+
+  bool negative = signbit(value);
+  if (negative) {
+    buffer[len++] = '-';
+    value = -value;
+  }
+
+  if (value < PROM_DTOA_MAX_EXACT_INTEGER && value == (double)(uint64_t)value) {
+    // Whole counts (processes, bytes, ...) are by far the most common samples
+    len += prom_dtoa_write_integer((uint64_t)value, buffer + len);
+  } else {
+    int k = 0;
+    int digits = prom_dtoa_grisu2(value, buffer + len, &k);
+    len += prom_dtoa_prettify(buffer + len, digits, k);
+  }
+  buffer[len] = '\0';
+  return len;
+}
@@ -0,0 +1,38 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_DTOA_I_H
+#define PROM_DTOA_I_H
+
+// The longest string written by prom_dtoa, including the terminating NUL: "-2.2250738585072014e-308"
+#define PROM_DTOA_BUFFER_SIZE 32
+
+/**
+ * @brief API PRIVATE Writes the shortest decimal string that parses back to value, and returns its length.
+ *
+ * Integral values below 2^53 in magnitude are written as plain integers. Other finite values are converted with Grisu2,
+ * which always round-trips and yields the shortest representation for the vast majority of inputs, and are written in
+ * fixed notation when the decimal exponent is in [-6, 21) and in scientific notation (e.g. 1.5e+300) otherwise.
+ * NaN and infinities are written as NaN, +Inf and -Inf as required by the exposition format. The output does not
+ * depend on the current locale.
+ *
+ * @param value The value to format
+ * @param buffer Target of at least PROM_DTOA_BUFFER_SIZE bytes. The string is NUL terminated.
+ * @return The length of the string, excluding the terminating NUL
+ */
+int prom_dtoa(double value, char *buffer);
+
+#endif  // PROM_DTOA_I_H
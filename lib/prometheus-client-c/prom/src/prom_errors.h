@@ -16,11 +16,19 @@
 
 #define PROM_STDIO_CLOSE_DIR_ERROR "failed to close dir"
 #define PROM_STDIO_OPEN_DIR_ERROR "failed to open dir"
+#define PROM_STDIO_OPEN_FILE_ERROR "failed to open file"
+#define PROM_HISTOGRAM_INVALID_SCHEMA "native histogram schemas must be between -4 and 8"
 #define PROM_METRIC_INCORRECT_TYPE "incorrect metric type"
 #define PROM_METRIC_INVALID_LABEL_NAME "invalid label name"
+#define PROM_METRIC_INVALID_NAME "invalid metric name"
+#define PROM_METRIC_INVALID_HEADER "a prebuilt header must start with the HELP line of its metric"
+#define PROM_METRIC_INVALID_LIFECYCLE "only labelled counters and gauges without dense storage can have a ttl"
+#define PROM_METRIC_SERIES_LIMIT "series limit reached, new label values are refused"
+#define PROM_PTHREAD_MUTEX_INIT_ERROR "failed to initialize the pthread_mutex_t*"
+#define PROM_PTHREAD_MUTEX_LOCK_ERROR "failed to lock the pthread_mutex_t*"
+#define PROM_PTHREAD_MUTEX_UNLOCK_ERROR "failed to unlock the pthread_mutex_t*"
 #define PROM_PTHREAD_RWLOCK_DESTROY_ERROR "failed to destroy the pthread_rwlock_t*"
 #define PROM_PTHREAD_RWLOCK_INIT_ERROR "failed to initialize the pthread_rwlock_t*"
 #define PROM_PTHREAD_RWLOCK_LOCK_ERROR "failed to lock the pthread_rwlock_t*"
 #define PROM_PTHREAD_RWLOCK_UNLOCK_ERROR "failed to unlock the pthread_rwlock_t*"
-#define PROM_REGEX_REGCOMP_ERROR "failed to compile the regular expression"
-#define PROM_REGEX_REGEXEC_ERROR "failed to execute the regular expression"
+#define PROM_SUMMARY_INVALID_QUANTILE "summary quantiles must be between 0 and 1"
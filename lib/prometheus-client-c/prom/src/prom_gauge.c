@@ -23,6 +23,7 @@
 #include "prom_assert.h"
 #include "prom_errors.h"
 #include "prom_log.h"
+#include "prom_metric_dense_i.h"
 #include "prom_metric_i.h"
 #include "prom_metric_sample_i.h"
 #include "prom_metric_sample_t.h"
@@ -32,6 +33,18 @@ prom_gauge_t *prom_gauge_new(const char *name, const char *help, size_t label_ke
   return (prom_gauge_t *)prom_metric_new(PROM_GAUGE, name, help, label_key_count, label_keys);
 }
 
+prom_gauge_t *prom_gauge_new_dense(const char *name, const char *help, size_t label_key_count,
+                                   const char **label_keys) {
+  prom_gauge_t *self = prom_gauge_new(name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->dense = prom_metric_dense_new();
+  if (self->dense == NULL) {
+    prom_gauge_destroy(self);
+    return NULL;
+  }
+  return self;
+}
+
 int prom_gauge_destroy(prom_gauge_t *self) {
   PROM_ASSERT(self != NULL);
   int r = 0;
@@ -47,9 +60,7 @@ int prom_gauge_inc(prom_gauge_t *self, const char **label_values) {
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_add(sample, 1.0);
+  return prom_metric_update(self, label_values, &prom_metric_sample_add, 1.0);
 }
 
 int prom_gauge_dec(prom_gauge_t *self, const char **label_values) {
@@ -59,9 +70,7 @@ int prom_gauge_dec(prom_gauge_t *self, const char **label_values) {
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_sub(sample, 1.0);
+  return prom_metric_update(self, label_values, &prom_metric_sample_sub, 1.0);
 }
 
 int prom_gauge_add(prom_gauge_t *self, double r_value, const char **label_values) {
@@ -71,9 +80,7 @@ int prom_gauge_add(prom_gauge_t *self, double r_value, const char **label_values
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_add(sample, r_value);
+  return prom_metric_update(self, label_values, &prom_metric_sample_add, r_value);
 }
 
 int prom_gauge_sub(prom_gauge_t *self, double r_value, const char **label_values) {
@@ -83,9 +90,7 @@ int prom_gauge_sub(prom_gauge_t *self, double r_value, const char **label_values
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_sub(sample, r_value);
+  return prom_metric_update(self, label_values, &prom_metric_sample_sub, r_value);
 }
 
 int prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_values) {
@@ -95,7 +100,45 @@ int prom_gauge_set(prom_gauge_t *self, double r_value, const char **label_values
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  prom_metric_sample_t *sample = prom_metric_sample_from_labels(self, label_values);
-  if (sample == NULL) return 1;
-  return prom_metric_sample_set(sample, r_value);
+  return prom_metric_update(self, label_values, &prom_metric_sample_set, r_value);
+}
+
+prom_metric_sample_t *prom_gauge_with_labels(prom_gauge_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+  if (self->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return NULL;
+  }
+  return prom_metric_sample_from_labels(self, label_values);
 }
+
+int prom_gauge_remove(prom_gauge_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_GAUGE) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_remove_labels(self, label_values);
+}
+
+int prom_gauge_set_many(const prom_gauge_t **gauges, const double *values, size_t count) {
+  PROM_ASSERT(gauges != NULL);
+  PROM_ASSERT(values != NULL);
+  if (gauges == NULL || values == NULL) return 1;
+
+  int ret = 0;
+  prom_metric_sample_publish_begin();
+  for (size_t i = 0; i < count; i++) {
+    if (gauges[i] == NULL) continue;
+    int r = prom_gauge_set((prom_gauge_t *)gauges[i], values[i], NULL);
+    if (r) ret = r;
+  }
+  prom_metric_sample_publish_end();
+  return ret;
+}
+
+void prom_gauge_batch_begin(void) { prom_metric_sample_publish_begin(); }
+
+void prom_gauge_batch_end(void) { prom_metric_sample_publish_end(); }
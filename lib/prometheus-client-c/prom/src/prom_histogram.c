@@ -28,6 +28,8 @@
 #include "prom_metric_i.h"
 #include "prom_metric_sample_histogram_i.h"
 #include "prom_metric_sample_histogram_t.h"
+#include "prom_metric_sample_native_t.h"
+#include "prom_metric_shard_i.h"
 #include "prom_metric_t.h"
 
 prom_histogram_t *prom_histogram_new(const char *name, const char *help, prom_histogram_buckets_t *buckets,
@@ -54,6 +56,38 @@ prom_histogram_t *prom_histogram_new(const char *name, const char *help, prom_hi
   return self;
 }
 
+prom_histogram_t *prom_histogram_new_sharded(const char *name, const char *help, prom_histogram_buckets_t *buckets,
+                                             size_t label_key_count, const char **label_keys) {
+  prom_histogram_t *self = prom_histogram_new(name, help, buckets, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->shard_count = prom_metric_shard_count();
+  return self;
+}
+
+prom_histogram_t *prom_histogram_new_native(const char *name, const char *help, int schema, size_t max_bucket_count,
+                                            size_t label_key_count, const char **label_keys) {
+  if (schema < PROM_METRIC_SAMPLE_NATIVE_MIN_SCHEMA || schema > PROM_METRIC_SAMPLE_NATIVE_MAX_SCHEMA) {
+    PROM_LOG(PROM_HISTOGRAM_INVALID_SCHEMA);
+    return NULL;
+  }
+  prom_histogram_t *self = (prom_histogram_t *)prom_metric_new(PROM_HISTOGRAM, name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+
+  // No upper bounds: the classic layout of a sample is reduced to the +Inf, count and sum series of the text formats
+  prom_histogram_buckets_t *buckets = (prom_histogram_buckets_t *)prom_malloc(sizeof(prom_histogram_buckets_t));
+  if (buckets == NULL) {
+    prom_metric_destroy(self);
+    return NULL;
+  }
+  buckets->count = 0;
+  buckets->upper_bounds = NULL;
+  self->buckets = buckets;
+  self->native = true;
+  self->native_schema = schema;
+  self->native_max_buckets = max_bucket_count == 0 ? PROM_HISTOGRAM_NATIVE_MAX_BUCKETS : max_bucket_count;
+  return self;
+}
+
 int prom_histogram_destroy(prom_histogram_t *self) {
   PROM_ASSERT(self != NULL);
 
@@ -0,0 +1,149 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_intern_i.h"
+#include "prom_intern_t.h"
+
+// Number of buckets of the table when the first string is interned. MUST be a power of two.
+#define PROM_INTERN_INITIAL_SIZE 256
+
+#define PROM_INTERN_FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define PROM_INTERN_FNV_PRIME 0x100000001b3ULL
+
+// Strings are only interned and released when series are created or destroyed, never while they are updated or
+// rendered, so a single lock is enough
+static pthread_mutex_t prom_intern_lock = PTHREAD_MUTEX_INITIALIZER;
+static prom_intern_node_t **prom_intern_buckets = NULL;
+static size_t prom_intern_bucket_count = 0;
+static size_t prom_intern_size = 0;
+
+static inline prom_intern_node_t *prom_intern_node(const char *str) {
+  return (prom_intern_node_t *)(str - offsetof(prom_intern_node_t, str));
+}
+
+static uint64_t prom_intern_hash(const char *str, size_t len) {
+  uint64_t hash = PROM_INTERN_FNV_OFFSET_BASIS;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char)str[i];
+    hash *= PROM_INTERN_FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * @brief Doubles the number of buckets, or allocates the first ones
+ *
+ * @return A non-zero integer value upon failure
+ */
+static int prom_intern_grow(void) {
+  size_t bucket_count = prom_intern_bucket_count == 0 ? PROM_INTERN_INITIAL_SIZE : prom_intern_bucket_count * 2;
+  prom_intern_node_t **buckets = (prom_intern_node_t **)prom_malloc(sizeof(prom_intern_node_t *) * bucket_count);
+  if (buckets == NULL) return 1;
+  memset(buckets, 0, sizeof(prom_intern_node_t *) * bucket_count);
+
+  for (size_t i = 0; i < prom_intern_bucket_count; i++) {
+    prom_intern_node_t *node = prom_intern_buckets[i];
+    while (node != NULL) {
+      prom_intern_node_t *next = node->next;
+      size_t bucket = node->hash & (bucket_count - 1);
+      node->next = buckets[bucket];
+      buckets[bucket] = node;
+      node = next;
+    }
+  }
+  prom_free(prom_intern_buckets);
+  prom_intern_buckets = buckets;
+  prom_intern_bucket_count = bucket_count;
+  return 0;
+}
+
+const char *prom_intern_acquire(const char *str, size_t len) {
+  if (str == NULL) return NULL;
+  uint64_t hash = prom_intern_hash(str, len);
+
+  pthread_mutex_lock(&prom_intern_lock);
+  if (prom_intern_bucket_count == 0 || prom_intern_size >= prom_intern_bucket_count) {
+    if (prom_intern_grow() && prom_intern_bucket_count == 0) {
+      pthread_mutex_unlock(&prom_intern_lock);
+      return NULL;
+    }
+  }
+
+  size_t bucket = hash & (prom_intern_bucket_count - 1);
+  for (prom_intern_node_t *node = prom_intern_buckets[bucket]; node != NULL; node = node->next) {
+    if (node->hash == hash && node->len == len && memcmp(node->str, str, len) == 0) {
+      node->refs++;
+      pthread_mutex_unlock(&prom_intern_lock);
+      return node->str;
+    }
+  }
+
+  prom_intern_node_t *node = (prom_intern_node_t *)prom_malloc(sizeof(prom_intern_node_t) + len + 1);
+  if (node == NULL) {
+    pthread_mutex_unlock(&prom_intern_lock);
+    return NULL;
+  }
+  node->hash = hash;
+  node->refs = 1;
+  node->len = len;
+  memcpy(node->str, str, len);
+  node->str[len] = '\0';
+  node->next = prom_intern_buckets[bucket];
+  prom_intern_buckets[bucket] = node;
+  prom_intern_size++;
+  pthread_mutex_unlock(&prom_intern_lock);
+  return node->str;
+}
+
+const char *prom_intern_retain(const char *str) {
+  if (str == NULL) return NULL;
+  pthread_mutex_lock(&prom_intern_lock);
+  prom_intern_node(str)->refs++;
+  pthread_mutex_unlock(&prom_intern_lock);
+  return str;
+}
+
+void prom_intern_release(const char *str) {
+  if (str == NULL) return;
+  prom_intern_node_t *node = prom_intern_node(str);
+
+  pthread_mutex_lock(&prom_intern_lock);
+  if (--node->refs > 0) {
+    pthread_mutex_unlock(&prom_intern_lock);
+    return;
+  }
+  prom_intern_node_t **link = &prom_intern_buckets[node->hash & (prom_intern_bucket_count - 1)];
+  while (*link != node) link = &(*link)->next;
+  *link = node->next;
+  prom_intern_size--;
+  if (prom_intern_size == 0) {
+    // The last series is gone, typically because the registries were destroyed
+    prom_free(prom_intern_buckets);
+    prom_intern_buckets = NULL;
+    prom_intern_bucket_count = 0;
+  }
+  pthread_mutex_unlock(&prom_intern_lock);
+  prom_free(node);
+}
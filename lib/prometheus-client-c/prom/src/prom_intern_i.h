@@ -0,0 +1,49 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_INTERN_I_H
+#define PROM_INTERN_I_H
+
+#include <stddef.h>
+
+#include "prom_intern_t.h"
+
+/**
+ * @brief API PRIVATE Returns the interned copy of the first len bytes of str, or NULL upon failure
+ *
+ * Every series holding the same label value or the same exposition prefix shares one copy. Each call takes a
+ * reference which must be returned with prom_intern_release.
+ */
+const char *prom_intern_acquire(const char *str, size_t len);
+
+/**
+ * @brief API PRIVATE Takes another reference to an interned string
+ */
+const char *prom_intern_retain(const char *str);
+
+/**
+ * @brief API PRIVATE Returns a reference taken by prom_intern_acquire or prom_intern_retain; NULL is ignored
+ */
+void prom_intern_release(const char *str);
+
+/**
+ * @brief API PRIVATE Returns the length of an interned string without scanning it
+ */
+static inline size_t prom_intern_len(const char *str) {
+  return ((const prom_intern_node_t *)(str - offsetof(prom_intern_node_t, str)))->len;
+}
+
+#endif  // PROM_INTERN_I_H
@@ -0,0 +1,34 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_INTERN_T_H
+#define PROM_INTERN_T_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief API PRIVATE An interned string; the string handed out points to str
+ */
+typedef struct prom_intern_node {
+  struct prom_intern_node *next; /**< Next node of the same bucket */
+  uint64_t hash;                 /**< FNV-1a hash of str */
+  size_t refs;                   /**< Number of holders; the node is freed when it drops to 0 */
+  size_t len;                    /**< Length of str, excluding the NUL terminator */
+  char str[];                    /**< The string, NUL-terminated */
+} prom_intern_node_t;
+
+#endif  // PROM_INTERN_T_H
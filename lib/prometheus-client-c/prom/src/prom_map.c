@@ -15,7 +15,11 @@
  */
 
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
@@ -23,50 +27,258 @@
 // Private
 #include "prom_assert.h"
 #include "prom_errors.h"
-#include "prom_linked_list_i.h"
-#include "prom_linked_list_t.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
 #include "prom_map_t.h"
+#include "prom_trace.h"
 
+// Number of slots of a new map. MUST be a power of two.
 #define PROM_MAP_INITIAL_SIZE 32
 
+// Nodes moved to the new table by every write while a resize is in progress
+#define PROM_MAP_MIGRATE_STEP 16
+
+#define PROM_MAP_FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define PROM_MAP_FNV_PRIME 0x100000001b3ULL
+
 static void destroy_map_node_value_no_op(void *value) {}
 
+/**
+ * @brief API PRIVATE 64-bit FNV-1a hash of key. The length of key is returned through len.
+ */
+static uint64_t prom_map_hash(const char *key, size_t *len) {
+  uint64_t hash = PROM_MAP_FNV_OFFSET_BASIS;
+  const char *current = key;
+  for (; *current != '\0'; current++) {
+    hash ^= (unsigned char)*current;
+    hash *= PROM_MAP_FNV_PRIME;
+  }
+  *len = (size_t)(current - key);
+  return hash;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // prom_map_node
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-prom_map_node_t *prom_map_node_new(const char *key, void *value, prom_map_node_free_value_fn free_value_fn) {
-  prom_map_node_t *self = prom_malloc(sizeof(prom_map_node_t));
-  self->key = prom_strdup(key);
+static prom_map_node_t *prom_map_node_new_internal(const char *key, size_t len, uint64_t hash, void *value,
+                                                   prom_map_node_free_value_fn free_value_fn) {
+  // The key is stored inline, right after the node, so a node costs a single allocation
+  prom_map_node_t *self = prom_malloc(sizeof(prom_map_node_t) + len + 1);
+  if (self == NULL) return NULL;
+  memcpy(self->key_storage, key, len + 1);
+  self->key = self->key_storage;
   self->value = value;
   self->free_value_fn = free_value_fn;
+  self->hash = hash;
+  self->prev = NULL;
+  self->next = NULL;
   return self;
 }
 
+prom_map_node_t *prom_map_node_new(const char *key, void *value, prom_map_node_free_value_fn free_value_fn) {
+  size_t len = 0;
+  uint64_t hash = prom_map_hash(key, &len);
+  return prom_map_node_new_internal(key, len, hash, value, free_value_fn);
+}
+
 int prom_map_node_destroy(prom_map_node_t *self) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 0;
-  prom_free((void *)self->key);
-  self->key = NULL;
   if (self->value != NULL) (*self->free_value_fn)(self->value);
   self->value = NULL;
+  self->key = NULL;
   prom_free(self);
   self = NULL;
   return 0;
 }
 
-void prom_map_node_free(void *item) {
-  prom_map_node_t *map_node = (prom_map_node_t *)item;
-  prom_map_node_destroy(map_node);
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// prom_map_table
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static prom_map_table_t *prom_map_table_new(size_t max_size) {
+  // Large tables are zeroed by the kernel as their pages are first touched, rather than all at once by the resize
+  prom_map_table_t *table = prom_calloc(1, sizeof(prom_map_table_t) + sizeof(prom_map_slot_t) * max_size);
+  if (table == NULL) return NULL;
+  table->max_size = max_size;
+  return table;
+}
+
+/**
+ * @brief API PRIVATE Returns how far the slot at index is from the slot its hash maps to.
+ */
+static size_t prom_map_probe_distance(const prom_map_table_t *table, size_t index, uint64_t hash) {
+  size_t mask = table->max_size - 1;
+  return (index - (size_t)(hash & mask)) & mask;
+}
+
+/**
+ * @brief API PRIVATE Returns the slot holding key, or NULL if the key is absent.
+ *
+ * Lookups compare the cached hash of each probed slot before touching its node, and stop as soon as they meet a slot
+ * closer to its home than the probe is to the key's, which Robin Hood ordering guarantees cannot be followed by key.
+ */
+static prom_map_slot_t *prom_map_find_slot(prom_map_table_t *table, const char *key, uint64_t hash) {
+  size_t mask = table->max_size - 1;
+  size_t index = (size_t)(hash & mask);
+  for (size_t distance = 0;; distance++, index = (index + 1) & mask) {
+    prom_map_slot_t *slot = &table->slots[index];
+    if (slot->node == NULL) return NULL;
+    if (prom_map_probe_distance(table, index, slot->hash) < distance) return NULL;
+    if (slot->hash == hash && strcmp(slot->node->key, key) == 0) return slot;
+  }
+}
+
+/**
+ * @brief API PRIVATE Returns the slot holding node, or NULL if the node is in another table.
+ */
+static prom_map_slot_t *prom_map_find_node_slot(prom_map_table_t *table, const prom_map_node_t *node) {
+  size_t mask = table->max_size - 1;
+  size_t index = (size_t)(node->hash & mask);
+  for (size_t distance = 0;; distance++, index = (index + 1) & mask) {
+    prom_map_slot_t *slot = &table->slots[index];
+    if (slot->node == NULL) return NULL;
+    if (prom_map_probe_distance(table, index, slot->hash) < distance) return NULL;
+    if (slot->node == node) return slot;
+  }
+}
+
+/**
+ * @brief API PRIVATE Places a node that is not in the slot table yet, displacing richer entries Robin Hood style.
+ *
+ * The caller MUST make sure a free slot is available.
+ */
+static void prom_map_insert_slot(prom_map_table_t *table, prom_map_node_t *node) {
+  size_t mask = table->max_size - 1;
+  prom_map_slot_t current = {node->hash, node};
+  size_t index = (size_t)(current.hash & mask);
+  for (size_t distance = 0;; distance++, index = (index + 1) & mask) {
+    prom_map_slot_t *slot = &table->slots[index];
+    if (slot->node == NULL) {
+      *slot = current;
+      return;
+    }
+    size_t existing = prom_map_probe_distance(table, index, slot->hash);
+    if (existing < distance) {
+      prom_map_slot_t displaced = *slot;
+      *slot = current;
+      current = displaced;
+      distance = existing;
+    }
+  }
+}
+
+/**
+ * @brief API PRIVATE Empties the slot at index with backward shift deletion, pulling the following entries of the probe
+ * sequence one slot closer to their home.
+ */
+static void prom_map_clear_slot(prom_map_table_t *table, size_t index) {
+  size_t mask = table->max_size - 1;
+  for (;;) {
+    size_t next = (index + 1) & mask;
+    prom_map_slot_t *following = &table->slots[next];
+    if (following->node == NULL || prom_map_probe_distance(table, next, following->hash) == 0) break;
+    table->slots[index] = *following;
+    index = next;
+  }
+  table->slots[index].node = NULL;
+  table->slots[index].hash = 0;
+}
+
+/**
+ * @brief API PRIVATE Returns a copy of the slot table of self with max_size slots, or NULL if it cannot be allocated.
+ */
+static prom_map_table_t *prom_map_table_copy(prom_map_t *self, size_t max_size) {
+  prom_map_table_t *old = atomic_load_explicit(&self->table, memory_order_relaxed);
+  prom_map_table_t *table = prom_map_table_new(max_size);
+  if (table == NULL) return NULL;
+  if (max_size == old->max_size) {
+    memcpy(table->slots, old->slots, sizeof(prom_map_slot_t) * max_size);
+    return table;
+  }
+
+  // Hashes are cached on the nodes, so rehashing never touches the keys
+  PROM_TRACE2(map__resize__start, self->size, max_size);
+  for (prom_map_node_t *current_node = self->head; current_node != NULL; current_node = current_node->next) {
+    prom_map_insert_slot(table, current_node);
+  }
+  PROM_TRACE2(map__resize__done, self->size, max_size);
+  return table;
 }
 
-prom_linked_list_compare_t prom_map_node_compare(void *item_a, void *item_b) {
-  prom_map_node_t *map_node_a = (prom_map_node_t *)item_a;
-  prom_map_node_t *map_node_b = (prom_map_node_t *)item_b;
+/**
+ * @brief API PRIVATE Returns the number of slots the table needs to hold one more node.
+ */
+static size_t prom_map_needed_slots(prom_map_t *self) {
+  size_t max_size = atomic_load_explicit(&self->table, memory_order_relaxed)->max_size;
 
-  return strcmp(map_node_a->key, map_node_b->key);
+  // Keep the load factor at or below 3/4 so that probe sequences stay short
+  return (self->size + 1) * 4 <= max_size * 3 ? max_size : max_size * 2;
+}
+
+/**
+ * @brief API PRIVATE Moves up to steps nodes of an incremental resize from old_table to table, in insertion order.
+ *
+ * Nodes inserted since the resize started are already in table and are only stepped over. old_table is freed once it
+ * is empty.
+ */
+static void prom_map_migrate(prom_map_t *self, size_t steps) {
+  prom_map_table_t *table = atomic_load_explicit(&self->table, memory_order_relaxed);
+  for (; self->old_table != NULL && steps > 0; steps--) {
+    prom_map_node_t *node = self->migrate_node;
+    if (node != NULL) {
+      self->migrate_node = node->next;
+      prom_map_slot_t *slot = prom_map_find_node_slot(self->old_table, node);
+      if (slot != NULL) {
+        prom_map_clear_slot(self->old_table, (size_t)(slot - self->old_table->slots));
+        prom_map_insert_slot(table, node);
+        self->old_count--;
+      }
+    }
+    if (node == NULL || self->old_count == 0) {
+      PROM_TRACE2(map__resize__done, self->size, table->max_size);
+      prom_free(self->old_table);
+      self->old_table = NULL;
+      self->migrate_node = NULL;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Read-side critical sections of read-mostly maps
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief API PRIVATE Enters a read-side critical section, during which no table, node or value is freed.
+ *
+ * The reader counts itself in the half of readers selected by the epoch it read, and tries again if a writer flipped
+ * the epoch meanwhile, since that writer may not wait for it.
+ *
+ * @return The epoch to pass to prom_map_read_unlock
+ */
+static unsigned int prom_map_read_lock(prom_map_t *self) {
+  for (;;) {
+    unsigned int epoch = atomic_load(&self->epoch);
+    atomic_fetch_add(&self->readers[epoch & 1], 1);
+    if (atomic_load(&self->epoch) == epoch) return epoch;
+    atomic_fetch_sub(&self->readers[epoch & 1], 1);
+  }
+}
+
+static void prom_map_read_unlock(prom_map_t *self, unsigned int epoch) {
+  atomic_fetch_sub_explicit(&self->readers[epoch & 1], 1, memory_order_release);
+}
+
+/**
+ * @brief API PRIVATE Waits until every reader that may still see what the writer just unpublished has left.
+ *
+ * Called by writers, under the write lock, between unpublishing a table, node or value and freeing it. Readers never
+ * block, so the wait lasts at most one lookup.
+ */
+static void prom_map_synchronize(prom_map_t *self) {
+  unsigned int epoch = atomic_fetch_add(&self->epoch, 1);
+  while (atomic_load(&self->readers[epoch & 1]) != 0) sched_yield();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -77,64 +289,64 @@ prom_map_t *prom_map_new() {
   int r = 0;
 
   prom_map_t *self = (prom_map_t *)prom_malloc(sizeof(prom_map_t));
+  if (self == NULL) return NULL;
   self->size = 0;
-  self->max_size = PROM_MAP_INITIAL_SIZE;
-
-  self->keys = prom_linked_list_new();
-  if (self->keys == NULL) return NULL;
-
-  // These each key will be allocated once by prom_map_node_new and used here as well to save memory. With that said
-  // we will only have to deallocate each key once. That will happen on prom_map_node_destroy.
-  r = prom_linked_list_set_free_fn(self->keys, prom_linked_list_no_op_free);
-  if (r) {
-    prom_map_destroy(self);
-    return NULL;
-  }
-
-  self->addrs = prom_malloc(sizeof(prom_linked_list_t) * self->max_size);
+  self->head = NULL;
+  self->tail = NULL;
   self->free_value_fn = destroy_map_node_value_no_op;
-
-  for (int i = 0; i < self->max_size; i++) {
-    self->addrs[i] = prom_linked_list_new();
-    r = prom_linked_list_set_free_fn(self->addrs[i], prom_map_node_free);
-    if (r) {
-      prom_map_destroy(self);
-      return NULL;
-    }
-    r = prom_linked_list_set_compare_fn(self->addrs[i], prom_map_node_compare);
-    if (r) {
-      prom_map_destroy(self);
-      return NULL;
-    }
+  self->read_mostly = false;
+  self->old_table = NULL;
+  self->old_count = 0;
+  self->migrate_node = NULL;
+  atomic_init(&self->epoch, 0);
+  atomic_init(&self->readers[0], 0);
+  atomic_init(&self->readers[1], 0);
+
+  prom_map_table_t *table = prom_map_table_new(PROM_MAP_INITIAL_SIZE);
+  if (table == NULL) {
+    prom_free(self);
+    return NULL;
   }
+  atomic_init(&self->table, table);
 
   self->rwlock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
   r = pthread_rwlock_init(self->rwlock, NULL);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_INIT_ERROR);
-    prom_map_destroy(self);
+    prom_free(self->rwlock);
+    prom_free(table);
+    prom_free(self);
     return NULL;
   }
 
   return self;
 }
 
+prom_map_t *prom_map_new_read_mostly(void) {
+  prom_map_t *self = prom_map_new();
+  if (self != NULL) self->read_mostly = true;
+  return self;
+}
+
 int prom_map_destroy(prom_map_t *self) {
   PROM_ASSERT(self != NULL);
   int r = 0;
   int ret = 0;
 
-  r = prom_linked_list_destroy(self->keys);
-  if (r) ret = r;
-  self->keys = NULL;
-
-  for (size_t i = 0; i < self->max_size; i++) {
-    r = prom_linked_list_destroy(self->addrs[i]);
+  prom_map_node_t *current_node = self->head;
+  while (current_node != NULL) {
+    prom_map_node_t *next = current_node->next;
+    r = prom_map_node_destroy(current_node);
     if (r) ret = r;
-    self->addrs[i] = NULL;
+    current_node = next;
   }
-  prom_free(self->addrs);
-  self->addrs = NULL;
+  self->head = NULL;
+  self->tail = NULL;
+
+  prom_free(atomic_load_explicit(&self->table, memory_order_relaxed));
+  atomic_store_explicit(&self->table, NULL, memory_order_relaxed);
+  prom_free(self->old_table);
+  self->old_table = NULL;
 
   r = pthread_rwlock_destroy(self->rwlock);
   if (r) {
@@ -150,64 +362,95 @@ int prom_map_destroy(prom_map_t *self) {
   return ret;
 }
 
-static size_t prom_map_get_index_internal(const char *key, size_t *size, size_t *max_size) {
-  size_t index;
-  size_t a = 31415, b = 27183;
-  for (index = 0; *key != '\0'; key++, a = a * b % (*max_size - 1)) {
-    index = (a * index + *key) % *max_size;
-  }
-  return index;
+int prom_map_ensure_space(prom_map_t *self) {
+  PROM_ASSERT(self != NULL);
+
+  // A resize is spread over the writes that follow it, so that no single write rehashes the whole map
+  prom_map_migrate(self, PROM_MAP_MIGRATE_STEP);
+  prom_map_table_t *old = atomic_load_explicit(&self->table, memory_order_relaxed);
+  size_t max_size = prom_map_needed_slots(self);
+  if (max_size == old->max_size) return 0;
+
+  // The new table starts below 3/8 full and every write moves several nodes, so the previous resize has normally ended
+  prom_map_migrate(self, SIZE_MAX);
+  prom_map_table_t *table = prom_map_table_new(max_size);
+  if (table == NULL) return 1;
+  PROM_TRACE2(map__resize__start, self->size, max_size);
+  self->old_table = old;
+  self->old_count = self->size;
+  self->migrate_node = self->head;
+  atomic_store_explicit(&self->table, table, memory_order_relaxed);
+  return 0;
 }
 
 /**
- * @brief API PRIVATE hash function that returns an array index from the given key and prom_map.
- *
- * The algorithm is based off of Horner's method. In a simpler version, you set the return value to 0. Next, for each
- * character in the string, you add the integer value of the current character to the product of the prime number and
- * the current return value, set the result to the return value, then finally return the return value.
- *
- * In this version of the algorithm, we attempt to achieve a probabily of key to index conversion collisions to
- * 1/M (with M being the max_size of the map). This optimizes dispersion and consequently, evens out the performance
- * for gets and sets for each item. Instead of using a fixed prime number, we generate a coefficient for each iteration
- * through the loop.
+ * @brief API PRIVATE Returns the slot holding key in either table of a map that is being resized.
  *
- * Reference:
- *   * Algorithms in C: Third Edition by Robert Sedgewick, p579
+ * @param table Set to the table holding the slot.
  */
-size_t prom_map_get_index(prom_map_t *self, const char *key) {
-  return prom_map_get_index_internal(key, &self->size, &self->max_size);
-}
-
-static void *prom_map_get_internal(const char *key, size_t *size, size_t *max_size, prom_linked_list_t *keys,
-                                   prom_linked_list_t **addrs, prom_map_node_free_value_fn free_value_fn) {
-  size_t index = prom_map_get_index_internal(key, size, max_size);
-  prom_linked_list_t *list = addrs[index];
-  prom_map_node_t *temp_map_node = prom_map_node_new(key, NULL, free_value_fn);
-
-  for (prom_linked_list_node_t *current_node = list->head; current_node != NULL; current_node = current_node->next) {
-    prom_map_node_t *current_map_node = (prom_map_node_t *)current_node->item;
-    prom_linked_list_compare_t result = prom_linked_list_compare(list, current_map_node, temp_map_node);
-    if (result == PROM_EQUAL) {
-      prom_map_node_destroy(temp_map_node);
-      temp_map_node = NULL;
-      return current_map_node->value;
+static prom_map_slot_t *prom_map_find_any_slot(prom_map_t *self, const char *key, uint64_t hash,
+                                               prom_map_table_t **table) {
+  *table = atomic_load_explicit(&self->table, memory_order_relaxed);
+  prom_map_slot_t *slot = prom_map_find_slot(*table, key, hash);
+  if (slot != NULL || self->old_table == NULL) return slot;
+  *table = self->old_table;
+  return prom_map_find_slot(*table, key, hash);
+}
+
+int prom_map_reserve(prom_map_t *self, size_t count) {
+  PROM_ASSERT(self != NULL);
+  int r = pthread_rwlock_wrlock(self->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+
+  prom_map_migrate(self, SIZE_MAX);
+  prom_map_table_t *old = atomic_load_explicit(&self->table, memory_order_relaxed);
+  size_t max_size = old->max_size;
+  while (count * 4 > max_size * 3) max_size *= 2;
+  if (max_size > old->max_size) {
+    prom_map_table_t *table = prom_map_table_copy(self, max_size);
+    if (table == NULL) {
+      r = 1;
+    } else {
+      atomic_store_explicit(&self->table, table, memory_order_release);
+      if (self->read_mostly) prom_map_synchronize(self);
+      prom_free(old);
     }
   }
-  prom_map_node_destroy(temp_map_node);
-  temp_map_node = NULL;
-  return NULL;
+
+  int rr = pthread_rwlock_unlock(self->rwlock);
+  if (rr) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
+    return rr;
+  }
+  return r;
 }
 
 void *prom_map_get(prom_map_t *self, const char *key) {
   PROM_ASSERT(self != NULL);
   int r = 0;
-  r = pthread_rwlock_wrlock(self->rwlock);
+  size_t len = 0;
+  uint64_t hash = prom_map_hash(key, &len);
+
+  if (self->read_mostly) {
+    // Writers never change a published table, so the lookup only has to keep what it reads from being freed
+    unsigned int epoch = prom_map_read_lock(self);
+    prom_map_slot_t *slot = prom_map_find_slot(atomic_load_explicit(&self->table, memory_order_acquire), key, hash);
+    void *payload = slot == NULL ? NULL : __atomic_load_n(&slot->node->value, __ATOMIC_ACQUIRE);
+    prom_map_read_unlock(self, epoch);
+    return payload;
+  }
+
+  r = pthread_rwlock_rdlock(self->rwlock);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
-    NULL;
+    return NULL;
   }
-  void *payload =
-      prom_map_get_internal(key, &self->size, &self->max_size, self->keys, self->addrs, self->free_value_fn);
+  prom_map_table_t *table = NULL;
+  prom_map_slot_t *slot = prom_map_find_any_slot(self, key, hash, &table);
+  void *payload = slot == NULL ? NULL : slot->node->value;
   r = pthread_rwlock_unlock(self->rwlock);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
@@ -216,106 +459,76 @@ void *prom_map_get(prom_map_t *self, const char *key) {
   return payload;
 }
 
-static int prom_map_set_internal(const char *key, void *value, size_t *size, size_t *max_size, prom_linked_list_t *keys,
-                                 prom_linked_list_t **addrs, prom_map_node_free_value_fn free_value_fn,
-                                 bool destroy_current_value) {
-  prom_map_node_t *map_node = prom_map_node_new(key, value, free_value_fn);
-  if (map_node == NULL) return 1;
-
-  size_t index = prom_map_get_index_internal(key, size, max_size);
-  prom_linked_list_t *list = addrs[index];
-  for (prom_linked_list_node_t *current_node = list->head; current_node != NULL; current_node = current_node->next) {
-    prom_map_node_t *current_map_node = (prom_map_node_t *)current_node->item;
-    prom_linked_list_compare_t result = prom_linked_list_compare(list, current_map_node, map_node);
-    if (result == PROM_EQUAL) {
-      if (destroy_current_value) {
-        free_value_fn(current_map_node->value);
-        current_map_node->value = NULL;
-      }
-      prom_free((char *)current_map_node->key);
-      current_map_node->key = NULL;
-      prom_free(current_map_node);
-      current_map_node = NULL;
-      current_node->item = map_node;
-      return 0;
-    }
+/**
+ * @brief API PRIVATE Links a node that was just placed in the slot table at the end of the insertion order.
+ */
+static void prom_map_link_node(prom_map_t *self, prom_map_node_t *map_node) {
+  // The links are plain stores: walks from head must hold the lock that serializes insertions into this map
+  map_node->prev = self->tail;
+  if (self->tail == NULL) {
+    self->head = map_node;
+  } else {
+    self->tail->next = map_node;
   }
-  prom_linked_list_append(list, map_node);
-  prom_linked_list_append(keys, (char *)map_node->key);
-  (*size)++;
-  return 0;
+  self->tail = map_node;
+  self->size++;
 }
 
-int prom_map_ensure_space(prom_map_t *self) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
-
-  if (self->size <= self->max_size / 2) {
+/**
+ * @brief API PRIVATE Inserts or replaces a key of a read-mostly map, publishing a new table for an insertion.
+ */
+static int prom_map_set_read_mostly(prom_map_t *self, const char *key, size_t len, uint64_t hash, void *value) {
+  prom_map_table_t *old = atomic_load_explicit(&self->table, memory_order_relaxed);
+  prom_map_slot_t *slot = prom_map_find_slot(old, key, hash);
+  if (slot != NULL) {
+    prom_map_node_t *current_node = slot->node;
+    void *old_value = current_node->value;
+    __atomic_store_n(&current_node->value, value, __ATOMIC_RELEASE);
+    if (old_value != NULL && old_value != value) {
+      prom_map_synchronize(self);
+      self->free_value_fn(old_value);
+    }
     return 0;
   }
 
-  // Increase the max size
-  size_t new_max = self->max_size * 2;
-  size_t new_size = 0;
-
-  // Create a new list of keys
-  prom_linked_list_t *new_keys = prom_linked_list_new();
-  if (new_keys == NULL) return 1;
+  prom_map_table_t *table = prom_map_table_copy(self, prom_map_needed_slots(self));
+  if (table == NULL) return 1;
+  prom_map_node_t *map_node = prom_map_node_new_internal(key, len, hash, value, self->free_value_fn);
+  if (map_node == NULL) {
+    prom_free(table);
+    return 1;
+  }
+  prom_map_insert_slot(table, map_node);
+  atomic_store_explicit(&self->table, table, memory_order_release);
+  prom_map_link_node(self, map_node);
 
-  r = prom_linked_list_set_free_fn(new_keys, prom_linked_list_no_op_free);
-  if (r) return r;
+  prom_map_synchronize(self);
+  prom_free(old);
+  return 0;
+}
 
-  // Create a new array of addrs
-  prom_linked_list_t **new_addrs = prom_malloc(sizeof(prom_linked_list_t) * new_max);
-
-  // Initialize the new array
-  for (int i = 0; i < new_max; i++) {
-    new_addrs[i] = prom_linked_list_new();
-    r = prom_linked_list_set_free_fn(new_addrs[i], prom_map_node_free);
-    if (r) return r;
-    r = prom_linked_list_set_compare_fn(new_addrs[i], prom_map_node_compare);
-    if (r) return r;
-  }
-
-  // Iterate through each linked-list at each memory region in the map's backbone
-  for (int i = 0; i < self->max_size; i++) {
-    // Create a new map node for each node in the linked list and insert it into the new map. Afterwards, deallocate
-    // the old map node
-    prom_linked_list_t *list = self->addrs[i];
-    prom_linked_list_node_t *current_node = list->head;
-    while (current_node != NULL) {
-      prom_map_node_t *map_node = (prom_map_node_t *)current_node->item;
-      r = prom_map_set_internal(map_node->key, map_node->value, &new_size, &new_max, new_keys, new_addrs,
-                                self->free_value_fn, false);
-      if (r) return r;
-
-      prom_linked_list_node_t *next = current_node->next;
-      prom_free(current_node);
-      current_node = NULL;
-      prom_free((void *)map_node->key);
-      map_node->key = NULL;
-      prom_free(map_node);
-      map_node = NULL;
-      current_node = next;
-    }
-    // We're done deallocating each map node in the linked list, so deallocate the linked-list object
-    prom_free(self->addrs[i]);
-    self->addrs[i] = NULL;
+static int prom_map_set_internal(prom_map_t *self, const char *key, void *value) {
+  size_t len = 0;
+  uint64_t hash = prom_map_hash(key, &len);
+  if (self->read_mostly) return prom_map_set_read_mostly(self, key, len, hash, value);
+
+  prom_map_table_t *table = NULL;
+  prom_map_slot_t *slot = prom_map_find_any_slot(self, key, hash, &table);
+  if (slot != NULL) {
+    // Replace the value in place; the node keeps its key and its position in insertion order
+    prom_map_node_t *current_node = slot->node;
+    if (current_node->value != NULL && current_node->value != value) self->free_value_fn(current_node->value);
+    current_node->value = value;
+    return 0;
   }
-  // Destroy the collection of keys in the map
-  prom_linked_list_destroy(self->keys);
-  self->keys = NULL;
-
-  // Deallocate the backbone of the map
-  prom_free(self->addrs);
-  self->addrs = NULL;
 
-  // Update the members of the current map
-  self->size = new_size;
-  self->max_size = new_max;
-  self->keys = new_keys;
-  self->addrs = new_addrs;
+  int r = prom_map_ensure_space(self);
+  if (r) return r;
 
+  prom_map_node_t *map_node = prom_map_node_new_internal(key, len, hash, value, self->free_value_fn);
+  if (map_node == NULL) return 1;
+  prom_map_insert_slot(atomic_load_explicit(&self->table, memory_order_relaxed), map_node);
+  prom_map_link_node(self, map_node);
   return 0;
 }
 
@@ -328,19 +541,7 @@ int prom_map_set(prom_map_t *self, const char *key, void *value) {
     return r;
   }
 
-  r = prom_map_ensure_space(self);
-  if (r) {
-    int rr = 0;
-    rr = pthread_rwlock_unlock(self->rwlock);
-    if (rr) {
-      PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
-      return rr;
-    } else {
-      return r;
-    }
-  }
-  r = prom_map_set_internal(key, value, &self->size, &self->max_size, self->keys, self->addrs, self->free_value_fn,
-                            true);
+  r = prom_map_set_internal(self, key, value);
   if (r) {
     int rr = 0;
     rr = pthread_rwlock_unlock(self->rwlock);
@@ -358,30 +559,47 @@ int prom_map_set(prom_map_t *self, const char *key, void *value) {
   return r;
 }
 
-static int prom_map_delete_internal(const char *key, size_t *size, size_t *max_size, prom_linked_list_t *keys,
-                                    prom_linked_list_t **addrs, prom_map_node_free_value_fn free_value_fn) {
-  int r = 0;
-  size_t index = prom_map_get_index_internal(key, size, max_size);
-  prom_linked_list_t *list = addrs[index];
-  prom_map_node_t *temp_map_node = prom_map_node_new(key, NULL, free_value_fn);
-
-  for (prom_linked_list_node_t *current_node = list->head; current_node != NULL; current_node = current_node->next) {
-    prom_map_node_t *current_map_node = (prom_map_node_t *)current_node->item;
-    prom_linked_list_compare_t result = prom_linked_list_compare(list, current_map_node, temp_map_node);
-    if (result == PROM_EQUAL) {
-      r = prom_linked_list_remove(list, current_node);
-      if (r) return r;
-
-      r = prom_linked_list_remove(keys, (char *)current_map_node->key);
-      if (r) return r;
-
-      (*size)--;
-      break;
-    }
+static int prom_map_delete_internal(prom_map_t *self, const char *key, bool free_value) {
+  size_t len = 0;
+  uint64_t hash = prom_map_hash(key, &len);
+
+  if (!self->read_mostly) prom_map_migrate(self, PROM_MAP_MIGRATE_STEP);
+  prom_map_table_t *holder = NULL;
+  prom_map_slot_t *slot = prom_map_find_any_slot(self, key, hash, &holder);
+  if (slot == NULL) return 0;
+  size_t index = (size_t)(slot - holder->slots);
+  prom_map_node_t *map_node = slot->node;
+  if (holder == self->old_table) self->old_count--;
+  if (self->migrate_node == map_node) self->migrate_node = map_node->next;
+
+  if (self->read_mostly) {
+    // Readers may be probing the published table, so the entry is removed from a copy that replaces it
+    prom_map_table_t *table = prom_map_table_copy(self, holder->max_size);
+    if (table == NULL) return 1;
+    prom_map_clear_slot(table, index);
+    atomic_store_explicit(&self->table, table, memory_order_release);
+  } else {
+    prom_map_clear_slot(holder, index);
   }
-  r = prom_map_node_destroy(temp_map_node);
-  temp_map_node = NULL;
-  return r;
+
+  if (map_node->prev == NULL) {
+    self->head = map_node->next;
+  } else {
+    map_node->prev->next = map_node->next;
+  }
+  if (map_node->next == NULL) {
+    self->tail = map_node->prev;
+  } else {
+    map_node->next->prev = map_node->prev;
+  }
+  self->size--;
+
+  if (self->read_mostly) {
+    prom_map_synchronize(self);
+    prom_free(holder);
+  }
+  if (!free_value) map_node->value = NULL;
+  return prom_map_node_destroy(map_node);
 }
 
 int prom_map_delete(prom_map_t *self, const char *key) {
@@ -391,9 +609,28 @@ int prom_map_delete(prom_map_t *self, const char *key) {
   r = pthread_rwlock_wrlock(self->rwlock);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+  r = prom_map_delete_internal(self, key, true);
+  if (r) ret = r;
+  r = pthread_rwlock_unlock(self->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);
     ret = r;
   }
-  r = prom_map_delete_internal(key, &self->size, &self->max_size, self->keys, self->addrs, self->free_value_fn);
+  return ret;
+}
+
+int prom_map_remove(prom_map_t *self, const char *key) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+  int ret = 0;
+  r = pthread_rwlock_wrlock(self->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+  r = prom_map_delete_internal(self, key, false);
   if (r) ret = r;
   r = pthread_rwlock_unlock(self->rwlock);
   if (r) {
@@ -406,6 +643,9 @@ int prom_map_delete(prom_map_t *self, const char *key) {
 int prom_map_set_free_value_fn(prom_map_t *self, prom_map_node_free_value_fn free_value_fn) {
   PROM_ASSERT(self != NULL);
   self->free_value_fn = free_value_fn;
+  for (prom_map_node_t *current_node = self->head; current_node != NULL; current_node = current_node->next) {
+    current_node->free_value_fn = free_value_fn;
+  }
   return 0;
 }
 
@@ -21,14 +21,33 @@
 
 prom_map_t *prom_map_new(void);
 
+/**
+ * @brief API PRIVATE Creates a map for keys that are looked up far more often than they change
+ *
+ * prom_map_get never takes a lock on such a map, so lookups never wait for writers, nor writers for lookups. Every
+ * insertion or deletion copies the slot table, and every write waits for the lookups in progress before freeing what
+ * it replaced, so the map suits registries rather than series.
+ */
+prom_map_t *prom_map_new_read_mostly(void);
+
 int prom_map_set_free_value_fn(prom_map_t *self, prom_map_node_free_value_fn free_value_fn);
 
 void *prom_map_get(prom_map_t *self, const char *key);
 
 int prom_map_set(prom_map_t *self, const char *key, void *value);
 
+/**
+ * @brief API PRIVATE Grows the table up front to hold count keys, so that inserting them never resizes the map
+ */
+int prom_map_reserve(prom_map_t *self, size_t count);
+
 int prom_map_delete(prom_map_t *self, const char *key);
 
+/**
+ * @brief API PRIVATE Deletes the node of a key without freeing its value, which the caller keeps
+ */
+int prom_map_remove(prom_map_t *self, const char *key);
+
 int prom_map_destroy(prom_map_t *self);
 
 size_t prom_map_size(prom_map_t *self);
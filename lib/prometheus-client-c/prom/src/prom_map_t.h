@@ -18,28 +18,63 @@
 #define PROM_MAP_T_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 // Public
 #include "prom_map.h"
 
-// Private
-#include "prom_linked_list_t.h"
-
 typedef void (*prom_map_node_free_value_fn)(void *);
 
 struct prom_map_node {
-  const char *key;
+  const char *key;                           /**< points to key_storage */
   void *value;
   prom_map_node_free_value_fn free_value_fn;
+  uint64_t hash;                             /**< cached hash of key */
+  prom_map_node_t *prev;                     /**< previous node in insertion order */
+  prom_map_node_t *next;                     /**< next node in insertion order */
+  char key_storage[];                        /**< the key, allocated together with the node */
 };
 
+/**
+ * @brief A slot of the open addressing table. The hash is cached so that probes rarely dereference the node.
+ */
+typedef struct prom_map_slot {
+  uint64_t hash;
+  prom_map_node_t *node; /**< NULL if the slot is empty */
+} prom_map_slot_t;
+
+/**
+ * @brief The slots of a map, allocated together with their count
+ */
+typedef struct prom_map_table {
+  size_t max_size;         /**< number of slots, always a power of two */
+  prom_map_slot_t slots[]; /**< Robin Hood hash table of the nodes */
+} prom_map_table_t;
+
+/**
+ * When a map outgrows its table, the nodes move to a table twice as large a few at a time: every following write moves
+ * PROM_MAP_MIGRATE_STEP of them, and lookups look in both tables until old_table is empty.
+ *
+ * A read-mostly map (see prom_map_new_read_mostly) never changes a table once it is published: writers, serialized by
+ * rwlock, insert into or delete from a copy, swap it in and free the old table once no reader can still see it. Readers
+ * take no lock; they count themselves in readers[epoch & 1] for the length of a lookup, and a writer flips the epoch and
+ * waits for the readers of the previous one before freeing anything it unpublished.
+ */
 struct prom_map {
-  size_t size;                /**< contains the size of the map */
-  size_t max_size;            /**< stores the current max_size */
-  prom_linked_list_t *keys;   /**< linked list containing containing all keys present */
-  prom_linked_list_t **addrs; /**< Sequence of linked lists. Each list contains nodes with the same index */
-  pthread_rwlock_t *rwlock;
+  size_t size;                       /**< contains the size of the map */
+  _Atomic(prom_map_table_t *) table; /**< the slots; only swapped whole while a read-mostly map is read */
+  prom_map_node_t *head;             /**< first node in insertion order; walk with next to iterate the map */
+  prom_map_node_t *tail;             /**< last node in insertion order */
+  pthread_rwlock_t *rwlock;          /**< guards the map; only serializes writers of a read-mostly map */
   prom_map_node_free_value_fn free_value_fn;
+  prom_map_table_t *old_table;       /**< table being emptied into table by an incremental resize, or NULL */
+  size_t old_count;                  /**< number of nodes left in old_table */
+  prom_map_node_t *migrate_node;     /**< next node in insertion order to move out of old_table */
+  bool read_mostly;                  /**< whether lookups run without the lock, see above */
+  atomic_uint epoch;                 /**< grace period of a read-mostly map, advanced by writers */
+  atomic_size_t readers[2];          /**< lookups in progress, by parity of the epoch they entered in */
 };
 
 #endif  // PROM_MAP_T_H
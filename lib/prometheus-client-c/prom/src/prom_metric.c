@@ -15,6 +15,8 @@
  */
 
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 
 // Public
 #include "prom_alloc.h"
@@ -25,21 +27,91 @@
 #include "prom_errors.h"
 #include "prom_log.h"
 #include "prom_map_i.h"
+#include "prom_metric_dense_i.h"
 #include "prom_metric_formatter_i.h"
 #include "prom_metric_i.h"
 #include "prom_metric_sample_histogram_i.h"
 #include "prom_metric_sample_i.h"
+#include "prom_metric_sample_native_i.h"
+#include "prom_metric_sample_summary_i.h"
+#include "prom_name_i.h"
 
 char *prom_metric_type_map[4] = {"counter", "gauge", "histogram", "summary"};
 
+/**
+ * @brief API PRIVATE Enters the grace period of an update through label values, as prom_map_read_lock does for lookups.
+ *
+ * @return The epoch to pass to prom_metric_update_end
+ */
+static unsigned int prom_metric_update_begin(prom_metric_t *self) {
+  for (;;) {
+    unsigned int epoch = atomic_load(&self->epoch);
+    atomic_fetch_add(&self->updaters[epoch & 1], 1);
+    if (atomic_load(&self->epoch) == epoch) return epoch;
+    atomic_fetch_sub(&self->updaters[epoch & 1], 1);
+  }
+}
+
+static void prom_metric_update_end(prom_metric_t *self, unsigned int epoch) {
+  atomic_fetch_sub_explicit(&self->updaters[epoch & 1], 1, memory_order_release);
+}
+
+/**
+ * @brief API PRIVATE Waits until every update that may still hold a sample unlinked before the call has returned.
+ *
+ * Must be called without the write lock, which those updates may be waiting for.
+ */
+static void prom_metric_synchronize(prom_metric_t *self) {
+  unsigned int epoch = atomic_fetch_add(&self->epoch, 1);
+  while (atomic_load(&self->updaters[epoch & 1]) != 0) sched_yield();
+}
+
+/**
+ * @brief API PRIVATE Returns true, counting the refusal, if a new sample would take the metric over max_series. Must be
+ * called with the write lock held.
+ */
+static bool prom_metric_refuse_series(prom_metric_t *self) {
+  if (self->max_series == 0 || prom_map_size(self->samples) < self->max_series) return false;
+  if (self->refused++ == 0) PROM_LOG(PROM_METRIC_SERIES_LIMIT);
+  return true;
+}
+
 prom_metric_t *prom_metric_new(prom_metric_type_t metric_type, const char *name, const char *help,
                                size_t label_key_count, const char **label_keys) {
   int r = 0;
+
+  // Validate the names before allocating anything, so that a rejected metric has nothing to release
+  if (!prom_name_is_valid_metric(name)) {
+    PROM_LOG(PROM_METRIC_INVALID_NAME);
+    return NULL;
+  }
+  for (size_t i = 0; i < label_key_count; i++) {
+    if (!prom_name_is_valid_label(label_keys[i])) {
+      PROM_LOG(PROM_METRIC_INVALID_LABEL_NAME);
+      return NULL;
+    }
+  }
+
   prom_metric_t *self = (prom_metric_t *)prom_malloc(sizeof(prom_metric_t));
   self->type = metric_type;
   self->name = name;
   self->help = help;
   self->buckets = NULL;
+  self->quantiles = NULL;
+  self->dense = NULL;
+  self->removals = 0;
+  self->integer = false;
+  self->ttl = 0;
+  self->max_series = 0;
+  self->refused = 0;
+  atomic_init(&self->epoch, 0);
+  atomic_init(&self->updaters[0], 0);
+  atomic_init(&self->updaters[1], 0);
+  self->header = NULL;
+  self->header_len = 0;
+  self->native = false;
+  self->native_schema = 0;
+  self->native_max_buckets = 0;
 
   const char **k = (const char **)prom_malloc(sizeof(const char *) * label_key_count);
 
@@ -58,6 +130,8 @@ prom_metric_t *prom_metric_new(prom_metric_type_t metric_type, const char *name,
   }
   self->label_keys = k;
   self->label_key_count = label_key_count;
+  atomic_init(&self->default_sample, NULL);
+  self->shard_count = 0;
   self->samples = prom_map_new();
 
   if (metric_type == PROM_HISTOGRAM) {
@@ -66,6 +140,12 @@ prom_metric_t *prom_metric_new(prom_metric_type_t metric_type, const char *name,
       prom_metric_destroy(self);
       return NULL;
     }
+  } else if (metric_type == PROM_SUMMARY) {
+    r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_summary_free_generic);
+    if (r) {
+      prom_metric_destroy(self);
+      return NULL;
+    }
   } else {
     r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_free_generic);
     if (r) {
@@ -105,6 +185,20 @@ int prom_metric_destroy(prom_metric_t *self) {
   self->samples = NULL;
   if (r) ret = r;
 
+  // Samples point into the dense storage, so it goes after them
+  if (self->dense != NULL) {
+    r = prom_metric_dense_destroy(self->dense);
+    self->dense = NULL;
+    if (r) ret = r;
+  }
+
+  // The default quantiles are shared by every summary created without its own
+  if (self->quantiles != NULL && self->quantiles != prom_summary_default_quantiles) {
+    r = prom_summary_quantiles_destroy(self->quantiles);
+    self->quantiles = NULL;
+    if (r) ret = r;
+  }
+
   r = prom_metric_formatter_destroy(self->formatter);
   self->formatter = NULL;
   if (r) ret = r;
@@ -144,9 +238,19 @@ void prom_metric_free_generic(void *item) {
   prom_metric_destroy(self);
 }
 
-prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const char **label_values) {
+/**
+ * @brief API PRIVATE Returns the sample of the given label values, creating it if needed, and pins it if asked to.
+ */
+static prom_metric_sample_t *prom_metric_sample_resolve(prom_metric_t *self, const char **label_values, bool pin) {
   PROM_ASSERT(self != NULL);
   int r = 0;
+
+  // A metric without labels has a single sample, so it is resolved once and then returned without locking
+  if (self->label_key_count == 0) {
+    prom_metric_sample_t *sample = atomic_load_explicit(&self->default_sample, memory_order_acquire);
+    if (sample != NULL) return sample;
+  }
+
   r = pthread_rwlock_wrlock(self->rwlock);
   if (r) {
     PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
@@ -173,18 +277,219 @@ prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const
 
   // Get sample
   prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(self->samples, l_value);
+  if (sample != NULL) prom_metric_sample_touch(sample);
+  if (sample == NULL && prom_metric_refuse_series(self)) {
+    prom_free((void *)l_value);
+    PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
+  }
   if (sample == NULL) {
-    sample = prom_metric_sample_new(self->type, l_value, 0.0);
+    if (self->shard_count > 0) {
+      sample = prom_metric_sample_new_sharded(self->type, l_value, self->shard_count, self->label_key_count,
+                                              label_values);
+    } else {
+      sample = prom_metric_sample_new(self->type, l_value, 0.0, self->label_key_count, label_values);
+      if (sample != NULL) sample->integer = self->integer;
+    }
+    if (sample != NULL && self->dense != NULL) {
+      // The value moves to the dense storage before the sample is visible, so no update can be lost
+      sample->value = prom_metric_dense_append(self->dense, sample->prefix, 0.0);
+      if (sample->value == NULL) {
+        prom_metric_sample_destroy(sample);
+        sample = NULL;
+      }
+    }
+    if (sample == NULL) {
+      prom_free((void *)l_value);
+      PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
+    }
     r = prom_map_set(self->samples, l_value, sample);
     if (r) {
       PROM_METRIC_SAMPLE_FROM_LABELS_HANDLE_UNLOCK();
     }
   }
+  if (pin) sample->pinned = true;
+  if (self->label_key_count == 0) atomic_store_explicit(&self->default_sample, sample, memory_order_release);
   pthread_rwlock_unlock(self->rwlock);
   prom_free((void *)l_value);
   return sample;
 }
 
+prom_metric_sample_t *prom_metric_sample_from_labels(prom_metric_t *self, const char **label_values) {
+  // The caller may keep the sample, so the TTL must not evict it
+  return prom_metric_sample_resolve(self, label_values, true);
+}
+
+int prom_metric_update(prom_metric_t *self, const char **label_values,
+                       int (*fn)(prom_metric_sample_t *sample, double r_value), double r_value) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  unsigned int epoch = prom_metric_update_begin(self);
+  prom_metric_sample_t *sample = prom_metric_sample_resolve(self, label_values, false);
+  int r = sample == NULL ? 1 : fn(sample, r_value);
+  prom_metric_update_end(self, epoch);
+  return r;
+}
+
+int prom_metric_reserve(prom_metric_t *self, size_t sample_count) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  return prom_map_reserve(self->samples, sample_count);
+}
+
+int prom_metric_set_lifecycle(prom_metric_t *self, unsigned int ttl_seconds, size_t max_series) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (ttl_seconds > 0 && ((self->type != PROM_COUNTER && self->type != PROM_GAUGE) || self->label_key_count == 0 ||
+                          self->dense != NULL)) {
+    PROM_LOG(PROM_METRIC_INVALID_LIFECYCLE);
+    return 1;
+  }
+
+  int r = pthread_rwlock_wrlock(self->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+  // Samples created from now on are stamped with a running clock rather than left for the first sweep
+  if (ttl_seconds > 0) prom_metric_sample_clock_advance();
+  self->ttl = ttl_seconds;
+  self->max_series = max_series;
+  pthread_rwlock_unlock(self->rwlock);
+  return 0;
+}
+
+int prom_metric_set_text_header(prom_metric_t *self, const char *header, size_t len) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (header != NULL) {
+    size_t name_len = strlen(self->name);
+    if (len < sizeof("# HELP ") + name_len || strncmp(header, "# HELP ", sizeof("# HELP ") - 1) != 0 ||
+        strncmp(header + sizeof("# HELP ") - 1, self->name, name_len) != 0 ||
+        header[sizeof("# HELP ") - 1 + name_len] != ' ' || header[len - 1] != '\n') {
+      PROM_LOG(PROM_METRIC_INVALID_HEADER);
+      return 1;
+    }
+  }
+
+  int r = pthread_rwlock_wrlock(self->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+  self->header = header;
+  self->header_len = header != NULL ? len : 0;
+  pthread_rwlock_unlock(self->rwlock);
+  return 0;
+}
+
+size_t prom_metric_sweep(prom_metric_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+
+  int r = pthread_rwlock_wrlock(self->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return 0;
+  }
+  if (self->ttl == 0) {
+    pthread_rwlock_unlock(self->rwlock);
+    return 0;
+  }
+
+  // Updates since the last sweep stamped the clock that sweep set, so idle times are measured against it: a sample is
+  // evicted between ttl and ttl plus two sweep intervals after its last update
+  uint32_t last = prom_metric_sample_clock();
+  uint32_t now = prom_metric_sample_clock_advance();
+  size_t evicted = 0;
+  size_t retired_capacity = 0;
+  prom_metric_sample_t **retired = NULL;
+  prom_map_node_t *next_node = NULL;
+  for (prom_map_node_t *node = self->samples->head; node != NULL; node = next_node) {
+    next_node = node->next;
+    prom_metric_sample_t *sample = (prom_metric_sample_t *)node->value;
+    if (sample->pinned) continue;
+    uint32_t touched = atomic_load_explicit(&sample->touched, memory_order_relaxed);
+    if (touched == 0) {
+      // Created before any sweep, so its idle time starts now
+      atomic_store_explicit(&sample->touched, now, memory_order_relaxed);
+      continue;
+    }
+    if (touched >= last || last - touched <= self->ttl) continue;
+
+    if (evicted == retired_capacity) {
+      size_t capacity = retired_capacity == 0 ? 16 : retired_capacity * 2;
+      prom_metric_sample_t **grown =
+          (prom_metric_sample_t **)prom_realloc(retired, sizeof(prom_metric_sample_t *) * capacity);
+      if (grown == NULL) break;
+      retired = grown;
+      retired_capacity = capacity;
+    }
+    // Renders hold the read lock, so the map node can go at once; only the sample waits for the grace period
+    if (prom_map_remove(self->samples, node->key) != 0) break;
+    retired[evicted++] = sample;
+  }
+  if (evicted > 0) {
+    self->removals++;
+    prom_metric_sample_generation_bump();
+  }
+  pthread_rwlock_unlock(self->rwlock);
+
+  // Updates through label values that resolved one of these samples before it was unlinked may still write it
+  if (evicted > 0) prom_metric_synchronize(self);
+  for (size_t i = 0; i < evicted; i++) prom_metric_sample_destroy(retired[i]);
+  prom_free(retired);
+  return evicted;
+}
+
+size_t prom_metric_refused_series(prom_metric_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+  pthread_rwlock_rdlock(self->rwlock);
+  size_t refused = self->refused;
+  pthread_rwlock_unlock(self->rwlock);
+  return refused;
+}
+
+int prom_metric_remove_labels(prom_metric_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  int r = pthread_rwlock_wrlock(self->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return r;
+  }
+
+  r = prom_metric_formatter_load_l_value(self->formatter, self->name, NULL, self->label_key_count, self->label_keys,
+                                         label_values);
+  const char *l_value = r ? NULL : prom_metric_formatter_dump(self->formatter);
+  if (l_value == NULL) {
+    pthread_rwlock_unlock(self->rwlock);
+    return 1;
+  }
+
+  void *sample = prom_map_get(self->samples, l_value);
+  // Counter and gauge samples may be held by an update through label values, so they are freed after its grace period
+  bool graced = self->type == PROM_COUNTER || self->type == PROM_GAUGE;
+  if (sample != NULL) {
+    // Renders hold the read lock, so neither the dense entry nor the map node can be in use while they go away
+    if (self->dense != NULL) prom_metric_dense_release(self->dense, ((prom_metric_sample_t *)sample)->value);
+    r = graced ? prom_map_remove(self->samples, l_value) : prom_map_delete(self->samples, l_value);
+    if (self->label_key_count == 0) atomic_store_explicit(&self->default_sample, NULL, memory_order_release);
+    self->removals++;
+    prom_metric_sample_generation_bump();
+  }
+  pthread_rwlock_unlock(self->rwlock);
+  prom_free((void *)l_value);
+
+  if (sample != NULL && graced && r == 0) {
+    prom_metric_synchronize(self);
+    prom_metric_sample_destroy((prom_metric_sample_t *)sample);
+  }
+  return r;
+}
+
 prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_metric_t *self,
                                                                          const char **label_values) {
   PROM_ASSERT(self != NULL);
@@ -218,12 +523,25 @@ prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_me
 
   // Get sample
   prom_metric_sample_histogram_t *sample = (prom_metric_sample_histogram_t *)prom_map_get(self->samples, l_value);
+  if (sample == NULL && prom_metric_refuse_series(self)) {
+    prom_free((void *)l_value);
+    PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
+    return NULL;
+  }
   if (sample == NULL) {
-    sample = prom_metric_sample_histogram_new(self->name, self->buckets, self->label_key_count, self->label_keys,
-                                              label_values);
+    sample = prom_metric_sample_histogram_new(self->name, self->buckets, self->shard_count, self->label_key_count,
+                                              self->label_keys, label_values);
+    if (sample != NULL && self->native) {
+      sample->native = prom_metric_sample_native_new(self->native_schema, self->native_max_buckets);
+      if (sample->native == NULL) {
+        prom_metric_sample_histogram_destroy(sample);
+        sample = NULL;
+      }
+    }
     if (sample == NULL) {
       prom_free((void *)l_value);
       PROM_METRIC_SAMPLE_HISTOGRAM_FROM_LABELS_HANDLE_UNLOCK();
+      return NULL;
     }
     r = prom_map_set(self->samples, l_value, sample);
     if (r) {
@@ -236,3 +554,55 @@ prom_metric_sample_histogram_t *prom_metric_sample_histogram_from_labels(prom_me
   prom_free((void *)l_value);
   return sample;
 }
+
+prom_metric_sample_summary_t *prom_metric_sample_summary_from_labels(prom_metric_t *self, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+
+  int r = 0;
+  r = pthread_rwlock_wrlock(self->rwlock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+    return NULL;
+  }
+
+#define PROM_METRIC_SAMPLE_SUMMARY_FROM_LABELS_HANDLE_UNLOCK() \
+  r = pthread_rwlock_unlock(self->rwlock);                     \
+  if (r) PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);           \
+  return NULL;
+
+  // Load the l_value
+  r = prom_metric_formatter_load_l_value(self->formatter, self->name, NULL, self->label_key_count, self->label_keys,
+                                         label_values);
+  if (r) {
+    PROM_METRIC_SAMPLE_SUMMARY_FROM_LABELS_HANDLE_UNLOCK();
+  }
+
+  // This must be freed before returning
+  const char *l_value = prom_metric_formatter_dump(self->formatter);
+  if (l_value == NULL) {
+    PROM_METRIC_SAMPLE_SUMMARY_FROM_LABELS_HANDLE_UNLOCK();
+  }
+
+  // Get sample
+  prom_metric_sample_summary_t *sample = (prom_metric_sample_summary_t *)prom_map_get(self->samples, l_value);
+  if (sample == NULL && prom_metric_refuse_series(self)) {
+    prom_free((void *)l_value);
+    PROM_METRIC_SAMPLE_SUMMARY_FROM_LABELS_HANDLE_UNLOCK();
+  }
+  if (sample == NULL) {
+    sample = prom_metric_sample_summary_new(self->name, self->quantiles, self->label_key_count, self->label_keys,
+                                            label_values);
+    if (sample == NULL) {
+      prom_free((void *)l_value);
+      PROM_METRIC_SAMPLE_SUMMARY_FROM_LABELS_HANDLE_UNLOCK();
+    }
+    r = prom_map_set(self->samples, l_value, sample);
+    if (r) {
+      prom_free((void *)l_value);
+      PROM_METRIC_SAMPLE_SUMMARY_FROM_LABELS_HANDLE_UNLOCK();
+    }
+  }
+  pthread_rwlock_unlock(self->rwlock);
+  prom_free((void *)l_value);
+  return sample;
+}
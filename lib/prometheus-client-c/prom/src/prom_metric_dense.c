@@ -0,0 +1,118 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_metric_dense_i.h"
+#include "prom_metric_dense_t.h"
+
+prom_metric_dense_t *prom_metric_dense_new(void) {
+  prom_metric_dense_t *self = (prom_metric_dense_t *)prom_malloc(sizeof(prom_metric_dense_t));
+  if (self == NULL) return NULL;
+  atomic_init(&self->count, 0);
+  for (size_t i = 0; i < PROM_METRIC_DENSE_BLOCK_COUNT; i++) {
+    self->values[i] = NULL;
+    self->prefixes[i] = NULL;
+  }
+  self->free_slots = NULL;
+  self->free_count = 0;
+  self->free_capacity = 0;
+  return self;
+}
+
+int prom_metric_dense_destroy(prom_metric_dense_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+  for (size_t i = 0; i < PROM_METRIC_DENSE_BLOCK_COUNT; i++) {
+    prom_free((void *)self->values[i]);
+    self->values[i] = NULL;
+    prom_free((void *)self->prefixes[i]);
+    self->prefixes[i] = NULL;
+  }
+  prom_free(self->free_slots);
+  prom_free(self);
+  return 0;
+}
+
+_Atomic double *prom_metric_dense_append(prom_metric_dense_t *self, const char *prefix, double r_value) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return NULL;
+
+  size_t offset = 0;
+  if (self->free_count > 0) {
+    size_t block = prom_metric_dense_block(self->free_slots[--self->free_count], &offset);
+    _Atomic double *slot = &self->values[block][offset];
+    atomic_store_explicit(slot, r_value, memory_order_relaxed);
+    self->prefixes[block][offset] = prefix;
+    return slot;
+  }
+
+  size_t index = atomic_load_explicit(&self->count, memory_order_relaxed);
+  size_t block = prom_metric_dense_block(index, &offset);
+  if (block >= PROM_METRIC_DENSE_BLOCK_COUNT) return NULL;
+
+  if (self->values[block] == NULL) {
+    size_t size = prom_metric_dense_block_size(block);
+    self->values[block] = (_Atomic double *)prom_malloc(sizeof(_Atomic double) * size);
+    if (self->values[block] == NULL) return NULL;
+    self->prefixes[block] = (const char **)prom_malloc(sizeof(const char *) * size);
+    if (self->prefixes[block] == NULL) {
+      prom_free((void *)self->values[block]);
+      self->values[block] = NULL;
+      return NULL;
+    }
+  }
+
+  _Atomic double *slot = &self->values[block][offset];
+  atomic_init(slot, r_value);
+  self->prefixes[block][offset] = prefix;
+
+  // Publishing the count last lets readers scan every entry below it without a lock
+  atomic_store_explicit(&self->count, index + 1, memory_order_release);
+  return slot;
+}
+
+void prom_metric_dense_release(prom_metric_dense_t *self, _Atomic double *slot) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL || slot == NULL) return;
+
+  size_t first = 0;
+  for (size_t block = 0; block < PROM_METRIC_DENSE_BLOCK_COUNT && self->values[block] != NULL; block++) {
+    size_t size = prom_metric_dense_block_size(block);
+    if (slot >= self->values[block] && slot < self->values[block] + size) {
+      if (self->free_count == self->free_capacity) {
+        size_t capacity = self->free_capacity == 0 ? PROM_METRIC_DENSE_FIRST_BLOCK : self->free_capacity * 2;
+        size_t *free_slots = (size_t *)prom_realloc(self->free_slots, sizeof(size_t) * capacity);
+        // Without room to record it the entry is only hidden, not reused
+        if (free_slots != NULL) {
+          self->free_slots = free_slots;
+          self->free_capacity = capacity;
+        }
+      }
+      size_t offset = (size_t)(slot - self->values[block]);
+      self->prefixes[block][offset] = NULL;
+      if (self->free_count < self->free_capacity) self->free_slots[self->free_count++] = first + offset;
+      return;
+    }
+    first += size;
+  }
+}
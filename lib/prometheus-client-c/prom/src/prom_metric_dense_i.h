@@ -0,0 +1,73 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_METRIC_DENSE_I_H
+#define PROM_METRIC_DENSE_I_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "prom_metric_dense_t.h"
+
+/**
+ * @brief API PRIVATE Returns a new prom_metric_dense_t*, or NULL upon failure
+ */
+prom_metric_dense_t *prom_metric_dense_new(void);
+
+/**
+ * @brief API PRIVATE Destroys a prom_metric_dense_t*
+ */
+int prom_metric_dense_destroy(prom_metric_dense_t *self);
+
+/**
+ * @brief API PRIVATE Appends an entry and returns the slot of its value, or NULL upon failure
+ *
+ * Appends must be serialized by the caller; readers may scan concurrently and see the entry once this returns.
+ *
+ * @param prefix The interned prefix of the sample, which must outlive the entry. No reference is taken.
+ */
+_Atomic double *prom_metric_dense_append(prom_metric_dense_t *self, const char *prefix, double r_value);
+
+/**
+ * @brief API PRIVATE Releases the entry of a slot returned by prom_metric_dense_append, for reuse by a later append
+ *
+ * Must be serialized with appends and with readers, which skip released entries.
+ */
+void prom_metric_dense_release(prom_metric_dense_t *self, _Atomic double *slot);
+
+/**
+ * @brief API PRIVATE Returns the number of entries readers may scan
+ */
+static inline size_t prom_metric_dense_count(prom_metric_dense_t *self) {
+  return atomic_load_explicit(&self->count, memory_order_acquire);
+}
+
+/**
+ * @brief API PRIVATE Returns the block holding entry index and stores the position of the entry within it in offset
+ */
+static inline size_t prom_metric_dense_block(size_t index, size_t *offset) {
+  size_t slot = (index >> PROM_METRIC_DENSE_FIRST_BLOCK_SHIFT) + 1;
+  size_t block = (size_t)(63 - __builtin_clzll((unsigned long long)slot));
+  *offset = index - (((size_t)PROM_METRIC_DENSE_FIRST_BLOCK << block) - PROM_METRIC_DENSE_FIRST_BLOCK);
+  return block;
+}
+
+/**
+ * @brief API PRIVATE Returns the number of entries of a block
+ */
+static inline size_t prom_metric_dense_block_size(size_t block) { return (size_t)PROM_METRIC_DENSE_FIRST_BLOCK << block; }
+
+#endif  // PROM_METRIC_DENSE_I_H
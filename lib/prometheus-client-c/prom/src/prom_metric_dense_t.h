@@ -0,0 +1,50 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_METRIC_DENSE_T_H
+#define PROM_METRIC_DENSE_T_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/**
+ * @brief Block b holds PROM_METRIC_DENSE_FIRST_BLOCK << b entries, so blocks never move once allocated
+ */
+#define PROM_METRIC_DENSE_FIRST_BLOCK_SHIFT 4
+#define PROM_METRIC_DENSE_FIRST_BLOCK (1 << PROM_METRIC_DENSE_FIRST_BLOCK_SHIFT)
+#define PROM_METRIC_DENSE_BLOCK_COUNT 24
+
+/**
+ * @brief API PRIVATE Contiguous storage of the values of a counter or gauge
+ *
+ * Entry i holds the value of the i-th sample created, next to the interned exposition prefix of the sample. Values are updated in
+ * place, so exposition walks the blocks in order instead of following the sample map. A single growing array would
+ * move under concurrent updates; blocks of doubling size keep each entry at a fixed address while still being scanned
+ * in long runs.
+ *
+ * Entries of removed samples are kept with a NULL prefix, which readers skip, and are reused by the next appends, so
+ * the storage is sized by the live samples rather than by every sample ever created.
+ */
+typedef struct prom_metric_dense {
+  _Atomic size_t count;                                     /**< Entries published to readers */
+  _Atomic double *values[PROM_METRIC_DENSE_BLOCK_COUNT];    /**< Blocks of sample values */
+  const char **prefixes[PROM_METRIC_DENSE_BLOCK_COUNT];     /**< Blocks of prefixes, parallel to values */
+  size_t *free_slots;                                       /**< Indexes of the released entries */
+  size_t free_count;                                        /**< Number of used entries of free_slots */
+  size_t free_capacity;                                     /**< Number of allocated entries of free_slots */
+} prom_metric_dense_t;
+
+#endif  // PROM_METRIC_DENSE_T_H
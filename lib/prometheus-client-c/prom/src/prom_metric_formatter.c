@@ -14,7 +14,11 @@
  * limitations under the License.
  */
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
@@ -22,14 +26,72 @@
 // Private
 #include "prom_assert.h"
 #include "prom_collector_t.h"
+#include "prom_intern_i.h"
 #include "prom_linked_list_t.h"
 #include "prom_map_i.h"
+#include "prom_metric_dense_i.h"
 #include "prom_metric_formatter_i.h"
 #include "prom_metric_sample_histogram_t.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_native_t.h"
+#include "prom_metric_sample_summary_i.h"
 #include "prom_metric_sample_t.h"
 #include "prom_metric_t.h"
+#include "prom_protobuf_i.h"
 #include "prom_string_builder_i.h"
 
+// OpenMetrics requires counter samples to end in _total and counter families to be named without it
+#define PROM_METRIC_FORMATTER_TOTAL_SUFFIX "_total"
+
+// Levels of prom_metric_formatter_t.message_builders
+#define PROM_METRIC_FORMATTER_FAMILY 0
+#define PROM_METRIC_FORMATTER_METRIC 1
+#define PROM_METRIC_FORMATTER_VALUE 2
+#define PROM_METRIC_FORMATTER_LEAF 3
+
+// Field numbers of io.prometheus.client messages. Reference: https://github.com/prometheus/client_model
+#define PROM_PROTOBUF_FAMILY_NAME 1
+#define PROM_PROTOBUF_FAMILY_HELP 2
+#define PROM_PROTOBUF_FAMILY_TYPE 3
+#define PROM_PROTOBUF_FAMILY_METRIC 4
+#define PROM_PROTOBUF_METRIC_LABEL 1
+#define PROM_PROTOBUF_METRIC_GAUGE 2
+#define PROM_PROTOBUF_METRIC_COUNTER 3
+#define PROM_PROTOBUF_METRIC_SUMMARY 4
+#define PROM_PROTOBUF_METRIC_HISTOGRAM 7
+#define PROM_PROTOBUF_LABEL_NAME 1
+#define PROM_PROTOBUF_LABEL_VALUE 2
+#define PROM_PROTOBUF_VALUE 1
+#define PROM_PROTOBUF_SAMPLE_COUNT 1
+#define PROM_PROTOBUF_SAMPLE_SUM 2
+#define PROM_PROTOBUF_BUCKET 3
+#define PROM_PROTOBUF_HISTOGRAM_SCHEMA 5
+#define PROM_PROTOBUF_HISTOGRAM_ZERO_THRESHOLD 6
+#define PROM_PROTOBUF_HISTOGRAM_ZERO_COUNT 7
+#define PROM_PROTOBUF_HISTOGRAM_NEGATIVE_SPAN 9
+#define PROM_PROTOBUF_HISTOGRAM_NEGATIVE_DELTA 10
+#define PROM_PROTOBUF_HISTOGRAM_POSITIVE_SPAN 12
+#define PROM_PROTOBUF_HISTOGRAM_POSITIVE_DELTA 13
+#define PROM_PROTOBUF_BUCKET_CUMULATIVE_COUNT 1
+#define PROM_PROTOBUF_BUCKET_UPPER_BOUND 2
+#define PROM_PROTOBUF_QUANTILE 3
+#define PROM_PROTOBUF_QUANTILE_QUANTILE 1
+#define PROM_PROTOBUF_QUANTILE_VALUE 2
+#define PROM_PROTOBUF_SPAN_OFFSET 1
+#define PROM_PROTOBUF_SPAN_LENGTH 2
+
+// Empty buckets a span of a native histogram runs through before a new span starts: each costs a one-byte delta,
+// while a new span costs a few bytes
+#define PROM_METRIC_FORMATTER_NATIVE_MAX_GAP 2
+
+// io.prometheus.client.MetricType, indexed by prom_metric_type_t
+static const uint64_t prom_metric_formatter_protobuf_types[] = {
+    [PROM_COUNTER] = 0,
+    [PROM_GAUGE] = 1,
+    [PROM_HISTOGRAM] = 4,
+    [PROM_SUMMARY] = 2,
+};
+
 prom_metric_formatter_t *prom_metric_formatter_new() {
   prom_metric_formatter_t *self = (prom_metric_formatter_t *)prom_malloc(sizeof(prom_metric_formatter_t));
   self->string_builder = prom_string_builder_new();
@@ -42,6 +104,8 @@ prom_metric_formatter_t *prom_metric_formatter_new() {
     prom_metric_formatter_destroy(self);
     return NULL;
   }
+  self->capacity_hint = 0;
+  for (int i = 0; i < PROM_METRIC_FORMATTER_MESSAGE_DEPTH; i++) self->message_builders[i] = NULL;
   return self;
 }
 
@@ -60,51 +124,71 @@ int prom_metric_formatter_destroy(prom_metric_formatter_t *self) {
   self->err_builder = NULL;
   if (r) ret = r;
 
+  for (int i = 0; i < PROM_METRIC_FORMATTER_MESSAGE_DEPTH; i++) {
+    if (self->message_builders[i] == NULL) continue;
+    r = prom_string_builder_destroy(self->message_builders[i]);
+    self->message_builders[i] = NULL;
+    if (r) ret = r;
+  }
+
   prom_free(self);
   self = NULL;
   return ret;
 }
 
-int prom_metric_formatter_load_help(prom_metric_formatter_t *self, const char *name, const char *help) {
-  PROM_ASSERT(self != NULL);
-  if (self == NULL) return 1;
-
+/**
+ * @brief API PRIVATE Loads a "# <keyword> <name> <text>" line, taking the first name_len bytes of name
+ */
+static int prom_metric_formatter_load_comment(prom_metric_formatter_t *self, const char *keyword, const char *name,
+                                              size_t name_len, const char *text) {
   int r = 0;
 
-  r = prom_string_builder_add_str(self->string_builder, "# HELP ");
+  r = prom_string_builder_add_str(self->string_builder, keyword);
   if (r) return r;
 
-  r = prom_string_builder_add_str(self->string_builder, name);
+  r = prom_string_builder_add_bytes(self->string_builder, name, name_len);
   if (r) return r;
 
   r = prom_string_builder_add_char(self->string_builder, ' ');
   if (r) return r;
 
-  r = prom_string_builder_add_str(self->string_builder, help);
+  r = prom_string_builder_add_str(self->string_builder, text);
   if (r) return r;
 
   return prom_string_builder_add_char(self->string_builder, '\n');
 }
 
-int prom_metric_formatter_load_type(prom_metric_formatter_t *self, const char *name, prom_metric_type_t metric_type) {
+int prom_metric_formatter_load_help(prom_metric_formatter_t *self, const char *name, const char *help) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 1;
 
-  int r = 0;
-
-  r = prom_string_builder_add_str(self->string_builder, "# TYPE ");
-  if (r) return r;
-
-  r = prom_string_builder_add_str(self->string_builder, name);
-  if (r) return r;
+  return prom_metric_formatter_load_comment(self, "# HELP ", name, strlen(name), help);
+}
 
-  r = prom_string_builder_add_char(self->string_builder, ' ');
-  if (r) return r;
+int prom_metric_formatter_load_type(prom_metric_formatter_t *self, const char *name, prom_metric_type_t metric_type) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
 
-  r = prom_string_builder_add_str(self->string_builder, prom_metric_type_map[metric_type]);
-  if (r) return r;
+  return prom_metric_formatter_load_comment(self, "# TYPE ", name, strlen(name), prom_metric_type_map[metric_type]);
+}
 
-  return prom_string_builder_add_char(self->string_builder, '\n');
+/**
+ * @brief API PRIVATE Loads a label value, escaping backslashes, double quotes and line feeds as the text format requires
+ */
+static int prom_metric_formatter_load_label_value(prom_metric_formatter_t *self, const char *value) {
+  int r = 0;
+  const char *run = value;
+  for (const char *p = value;; p++) {
+    if (*p != '\\' && *p != '"' && *p != '\n' && *p != '\0') continue;
+    // Runs without special characters are copied at once
+    r = prom_string_builder_add_bytes(self->string_builder, run, (size_t)(p - run));
+    if (r || *p == '\0') return r;
+    r = prom_string_builder_add_char(self->string_builder, '\\');
+    if (r) return r;
+    r = prom_string_builder_add_char(self->string_builder, *p == '\n' ? 'n' : *p);
+    if (r) return r;
+    run = p + 1;
+  }
 }
 
 int prom_metric_formatter_load_l_value(prom_metric_formatter_t *self, const char *name, const char *suffix,
@@ -141,7 +225,7 @@ int prom_metric_formatter_load_l_value(prom_metric_formatter_t *self, const char
     r = prom_string_builder_add_char(self->string_builder, '"');
     if (r) return r;
 
-    r = prom_string_builder_add_str(self->string_builder, (const char *)label_values[i]);
+    r = prom_metric_formatter_load_label_value(self, (const char *)label_values[i]);
     if (r) return r;
 
     r = prom_string_builder_add_char(self->string_builder, '"');
@@ -158,29 +242,118 @@ int prom_metric_formatter_load_l_value(prom_metric_formatter_t *self, const char
   return 0;
 }
 
+/**
+ * @brief API PRIVATE Loads a series from its interned prefix, which already ends with the space before the value
+ */
+static int prom_metric_formatter_load_value(prom_metric_formatter_t *self, const char *prefix, double r_value) {
+  int r = 0;
+
+  r = prom_string_builder_add_bytes(self->string_builder, prefix, prom_intern_len(prefix));
+  if (r) return r;
+
+  r = prom_string_builder_add_double(self->string_builder, r_value);
+  if (r) return r;
+
+  return prom_string_builder_add_char(self->string_builder, '\n');
+}
+
 int prom_metric_formatter_load_sample(prom_metric_formatter_t *self, prom_metric_sample_t *sample) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 1;
 
+  if (sample->integer) {
+    int r = prom_string_builder_add_bytes(self->string_builder, sample->prefix, prom_intern_len(sample->prefix));
+    if (r) return r;
+    r = prom_string_builder_add_u64(self->string_builder, prom_metric_sample_value_u64(sample));
+    if (r) return r;
+    return prom_string_builder_add_char(self->string_builder, '\n');
+  }
+  return prom_metric_formatter_load_value(self, sample->prefix, prom_metric_sample_value(sample));
+}
+
+int prom_metric_formatter_load_histogram(prom_metric_formatter_t *self, prom_metric_sample_histogram_t *sample) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
   int r = 0;
 
-  r = prom_string_builder_add_str(self->string_builder, sample->l_value);
-  if (r) return r;
+  if (sample->native != NULL) {
+    // A native histogram has no upper bounds the text formats can show, only the +Inf bucket, the count and the sum
+    pthread_mutex_lock(&sample->native->lock);
+    uint64_t count = sample->native->count;
+    double sum = sample->native->sum;
+    pthread_mutex_unlock(&sample->native->lock);
 
-  r = prom_string_builder_add_char(self->string_builder, ' ');
+    r = prom_metric_formatter_load_value(self, sample->prefixes[PROM_METRIC_SAMPLE_HISTOGRAM_INF_INDEX(sample)],
+                                         (double)count);
+    if (r) return r;
+    r = prom_metric_formatter_load_value(self, sample->prefixes[PROM_METRIC_SAMPLE_HISTOGRAM_COUNT_INDEX(sample)],
+                                         (double)count);
+    if (r) return r;
+    return prom_metric_formatter_load_value(self, sample->prefixes[PROM_METRIC_SAMPLE_HISTOGRAM_SUM_INDEX(sample)],
+                                            sum);
+  }
+
+  // The buckets hold non-cumulative counts, split across shards; merge and accumulate them while writing so that every
+  // le line includes the observations of the buckets below it. The +Inf line then equals the total count.
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i <= sample->bucket_count; i++) {
+    for (size_t shard = 0; shard < sample->shard_count; shard++) {
+      cumulative +=
+          atomic_load_explicit(&sample->bucket_counts[shard * sample->shard_stride + i], memory_order_relaxed);
+    }
+    r = prom_metric_formatter_load_value(self, sample->prefixes[i], (double)cumulative);
+    if (r) return r;
+  }
+
+  double sum = 0.0;
+  for (size_t shard = 0; shard < sample->shard_count; shard++) {
+    sum += atomic_load_explicit(&sample->sums[shard].value, memory_order_relaxed);
+  }
+
+  r = prom_metric_formatter_load_value(self, sample->prefixes[PROM_METRIC_SAMPLE_HISTOGRAM_COUNT_INDEX(sample)],
+                                       (double)cumulative);
   if (r) return r;
 
-  char buffer[50];
-  sprintf(buffer, "%.17g", sample->r_value);
-  r = prom_string_builder_add_str(self->string_builder, buffer);
+  return prom_metric_formatter_load_value(self, sample->prefixes[PROM_METRIC_SAMPLE_HISTOGRAM_SUM_INDEX(sample)], sum);
+}
+
+int prom_metric_formatter_load_summary(prom_metric_formatter_t *self, prom_metric_sample_summary_t *sample) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  int r = 0;
+
+  uint64_t count = prom_metric_sample_summary_count(sample);
+  for (size_t i = 0; i < sample->quantile_count; i++) {
+    double value = prom_metric_sample_summary_quantile(sample, sample->quantiles->quantiles[i], count);
+    r = prom_metric_formatter_load_value(self, sample->prefixes[i], value);
+    if (r) return r;
+  }
+
+  r = prom_metric_formatter_load_value(self, sample->prefixes[PROM_METRIC_SAMPLE_SUMMARY_COUNT_INDEX(sample)],
+                                       (double)count);
   if (r) return r;
 
-  return prom_string_builder_add_char(self->string_builder, '\n');
+  return prom_metric_formatter_load_value(self, sample->prefixes[PROM_METRIC_SAMPLE_SUMMARY_SUM_INDEX(sample)],
+                                          atomic_load_explicit(&sample->sum, memory_order_relaxed));
 }
 
 int prom_metric_formatter_clear(prom_metric_formatter_t *self) {
   PROM_ASSERT(self != NULL);
-  return prom_string_builder_clear(self->string_builder);
+  if (self == NULL) return 1;
+
+  int r = 0;
+
+  // Keep the allocation and make sure it covers the longest string built so far, so that steady-state rebuilds of the
+  // same content never reallocate
+  size_t len = prom_string_builder_len(self->string_builder);
+  if (len > self->capacity_hint) self->capacity_hint = len;
+
+  r = prom_string_builder_reset(self->string_builder);
+  if (r) return r;
+
+  return prom_string_builder_reserve(self->string_builder, self->capacity_hint);
 }
 
 char *prom_metric_formatter_dump(prom_metric_formatter_t *self) {
@@ -189,7 +362,7 @@ char *prom_metric_formatter_dump(prom_metric_formatter_t *self) {
   if (self == NULL) return NULL;
   char *data = prom_string_builder_dump(self->string_builder);
   if (data == NULL) return NULL;
-  r = prom_string_builder_clear(self->string_builder);
+  r = prom_metric_formatter_clear(self);
   if (r) {
     prom_free(data);
     return NULL;
@@ -197,65 +370,527 @@ char *prom_metric_formatter_dump(prom_metric_formatter_t *self) {
   return data;
 }
 
-int prom_metric_formatter_load_metric(prom_metric_formatter_t *self, prom_metric_t *metric) {
+const char *prom_metric_formatter_dump_prefix(prom_metric_formatter_t *self) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+  if (self == NULL) return NULL;
+  r = prom_string_builder_add_char(self->string_builder, ' ');
+  if (r) return NULL;
+  const char *prefix = prom_intern_acquire(prom_string_builder_str(self->string_builder),
+                                           prom_string_builder_len(self->string_builder));
+  if (prefix == NULL) return NULL;
+  r = prom_metric_formatter_clear(self);
+  if (r) {
+    prom_intern_release(prefix);
+    return NULL;
+  }
+  return prefix;
+}
+
+/**
+ * @brief API PRIVATE Returns true if the metric name ends with the _total suffix
+ */
+static bool prom_metric_formatter_has_total_suffix(prom_metric_t *metric, size_t name_len) {
+  size_t suffix_len = strlen(PROM_METRIC_FORMATTER_TOTAL_SUFFIX);
+  return name_len > suffix_len && strcmp(metric->name + name_len - suffix_len, PROM_METRIC_FORMATTER_TOTAL_SUFFIX) == 0;
+}
+
+int prom_metric_formatter_load_metric_header(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                             prom_exposition_format_t format) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 1;
 
   int r = 0;
 
-  r = prom_metric_formatter_load_help(self, metric->name, metric->help);
+  if (format == PROM_EXPOSITION_TEXT && metric->header != NULL) {
+    return prom_string_builder_add_bytes(self->string_builder, metric->header, metric->header_len);
+  }
+
+  size_t family_len = strlen(metric->name);
+  if (format == PROM_EXPOSITION_OPENMETRICS && metric->type == PROM_COUNTER &&
+      prom_metric_formatter_has_total_suffix(metric, family_len)) {
+    family_len -= strlen(PROM_METRIC_FORMATTER_TOTAL_SUFFIX);
+  }
+
+  r = prom_metric_formatter_load_comment(self, "# HELP ", metric->name, family_len, metric->help);
   if (r) return r;
 
-  r = prom_metric_formatter_load_type(self, metric->name, metric->type);
+  return prom_metric_formatter_load_comment(self, "# TYPE ", metric->name, family_len,
+                                            prom_metric_type_map[metric->type]);
+}
+
+/**
+ * @brief API PRIVATE Loads the prefix of a counter or gauge sample in one of the text formats, up to its value
+ */
+static int prom_metric_formatter_load_plain_prefix(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                                   const char *prefix, prom_exposition_format_t format) {
+  int r = 0;
+
+  size_t name_len = strlen(metric->name);
+  if (format == PROM_EXPOSITION_OPENMETRICS && metric->type == PROM_COUNTER &&
+      !prom_metric_formatter_has_total_suffix(metric, name_len)) {
+    // The prefix starts with the metric name; the suffix goes between the name and the labels
+    r = prom_string_builder_add_bytes(self->string_builder, prefix, name_len);
+    if (r) return r;
+    r = prom_string_builder_add_str(self->string_builder, PROM_METRIC_FORMATTER_TOTAL_SUFFIX);
+    if (r) return r;
+    return prom_string_builder_add_bytes(self->string_builder, prefix + name_len, prom_intern_len(prefix) - name_len);
+  }
+  return prom_string_builder_add_bytes(self->string_builder, prefix, prom_intern_len(prefix));
+}
+
+/**
+ * @brief API PRIVATE Loads the value of a counter or gauge sample in one of the text formats
+ */
+static int prom_metric_formatter_load_plain_value(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                                  const char *prefix, double r_value,
+                                                  prom_exposition_format_t format) {
+  int r = 0;
+
+  r = prom_metric_formatter_load_plain_prefix(self, metric, prefix, format);
   if (r) return r;
+  r = prom_string_builder_add_double(self->string_builder, r_value);
+  if (r) return r;
+  return prom_string_builder_add_char(self->string_builder, '\n');
+}
 
-  for (prom_linked_list_node_t *current_node = metric->samples->keys->head; current_node != NULL;
-       current_node = current_node->next) {
-    const char *key = (const char *)current_node->item;
-    if (metric->type == PROM_HISTOGRAM) {
-      prom_metric_sample_histogram_t *hist_sample =
-          (prom_metric_sample_histogram_t *)prom_map_get(metric->samples, key);
+/**
+ * @brief API PRIVATE Loads the exact value of a sample of an integer metric in one of the text formats
+ */
+static int prom_metric_formatter_load_integer_value(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                                    prom_metric_sample_t *sample, prom_exposition_format_t format) {
+  int r = 0;
+
+  r = prom_metric_formatter_load_plain_prefix(self, metric, sample->prefix, format);
+  if (r) return r;
+  r = prom_string_builder_add_u64(self->string_builder, prom_metric_sample_value_u64(sample));
+  if (r) return r;
+  return prom_string_builder_add_char(self->string_builder, '\n');
+}
+
+int prom_metric_formatter_load_metric_sample(prom_metric_formatter_t *self, prom_metric_t *metric, void *sample,
+                                             prom_exposition_format_t format) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (sample == NULL) return 1;
+
+  if (metric->type == PROM_HISTOGRAM) {
+    return prom_metric_formatter_load_histogram(self, (prom_metric_sample_histogram_t *)sample);
+  }
+  if (metric->type == PROM_SUMMARY) {
+    return prom_metric_formatter_load_summary(self, (prom_metric_sample_summary_t *)sample);
+  }
+
+  prom_metric_sample_t *plain = (prom_metric_sample_t *)sample;
+  if (plain->integer) return prom_metric_formatter_load_integer_value(self, metric, plain, format);
+  return prom_metric_formatter_load_plain_value(self, metric, plain->prefix, prom_metric_sample_value(plain), format);
+}
+
+int prom_metric_formatter_load_metric_footer(prom_metric_formatter_t *self, prom_exposition_format_t format) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  // Only the text format separates families with a blank line
+  if (format != PROM_EXPOSITION_TEXT) return 0;
+  return prom_string_builder_add_char(self->string_builder, '\n');
+}
+
+/**
+ * @brief API PRIVATE Loads a metric in one of the text formats
+ */
+static int prom_metric_formatter_load_text_metric(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                                  prom_exposition_format_t format) {
+  int r = 0;
 
-      if (hist_sample == NULL) return 1;
+  r = prom_metric_formatter_load_metric_header(self, metric, format);
+  if (r) return r;
 
-      for (prom_linked_list_node_t *current_hist_node = hist_sample->l_value_list->head; current_hist_node != NULL;
-           current_hist_node = current_hist_node->next) {
-        const char *hist_key = (const char *)current_hist_node->item;
-        prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(hist_sample->samples, hist_key);
-        if (sample == NULL) return 1;
-        r = prom_metric_formatter_load_sample(self, sample);
+  if (metric->dense != NULL) {
+    // Dense values sit in blocks next to their prefixes, in the same insertion order as the sample map
+    size_t count = prom_metric_dense_count(metric->dense);
+    for (size_t block = 0, index = 0; index < count; block++) {
+      _Atomic double *values = metric->dense->values[block];
+      const char **prefixes = metric->dense->prefixes[block];
+      size_t block_size = prom_metric_dense_block_size(block);
+      for (size_t offset = 0; offset < block_size && index < count; offset++, index++) {
+        if (prefixes[offset] == NULL) continue;
+        r = prom_metric_formatter_load_plain_value(self, metric, prefixes[offset],
+                                                   atomic_load_explicit(&values[offset], memory_order_relaxed), format);
         if (r) return r;
       }
+    }
+    return prom_metric_formatter_load_metric_footer(self, format);
+  }
+
+  // Walk the sample map in insertion order; each node already holds the sample, so no lookup is needed
+  for (prom_map_node_t *current_node = metric->samples->head; current_node != NULL;
+       current_node = current_node->next) {
+    r = prom_metric_formatter_load_metric_sample(self, metric, current_node->value, format);
+    if (r) return r;
+  }
+  return prom_metric_formatter_load_metric_footer(self, format);
+}
+
+int prom_metric_formatter_load_metric(prom_metric_formatter_t *self, prom_metric_t *metric) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  return prom_metric_formatter_load_text_metric(self, metric, PROM_EXPOSITION_TEXT);
+}
+
+/**
+ * @brief API PRIVATE Returns the empty scratch builder of the given protobuf nesting level, or NULL upon failure
+ */
+static prom_string_builder_t *prom_metric_formatter_message_builder(prom_metric_formatter_t *self, int level) {
+  if (self->message_builders[level] == NULL) {
+    self->message_builders[level] = prom_string_builder_new();
+    return self->message_builders[level];
+  }
+  if (prom_string_builder_reset(self->message_builders[level])) return NULL;
+  return self->message_builders[level];
+}
+
+/**
+ * @brief API PRIVATE Adds a LabelPair field to message for each label of a sample
+ */
+static int prom_metric_formatter_load_protobuf_labels(prom_metric_formatter_t *self, prom_string_builder_t *message,
+                                                      prom_metric_t *metric, size_t label_count,
+                                                      const char **label_values) {
+  int r = 0;
+
+  for (size_t i = 0; i < label_count && i < metric->label_key_count; i++) {
+    prom_string_builder_t *label = prom_metric_formatter_message_builder(self, PROM_METRIC_FORMATTER_LEAF);
+    if (label == NULL) return 1;
+
+    r = prom_protobuf_add_string(label, PROM_PROTOBUF_LABEL_NAME, metric->label_keys[i]);
+    if (r) return r;
+
+    r = prom_protobuf_add_string(label, PROM_PROTOBUF_LABEL_VALUE, label_values[i]);
+    if (r) return r;
+
+    r = prom_protobuf_add_message(message, PROM_PROTOBUF_METRIC_LABEL, label);
+    if (r) return r;
+  }
+  return 0;
+}
+
+/**
+ * @brief API PRIVATE Adds the spans and the deltas of the populated buckets of one sign of a native histogram
+ *
+ * A span is a run of consecutive bucket indexes, its offset counted from the end of the previous span, or from 0 for
+ * the first. The counts of the buckets of every span follow as one packed field, each as its difference to the
+ * previous one, which keeps them short when neighbouring buckets hold similar counts.
+ */
+static int prom_metric_formatter_load_protobuf_native_buckets(prom_metric_formatter_t *self,
+                                                              prom_string_builder_t *histogram,
+                                                              prom_metric_sample_native_buckets_t *buckets,
+                                                              uint32_t span_field, uint32_t delta_field) {
+  int r = 0;
+
+  if (buckets->count == 0) return 0;
+
+  for (size_t start = 0, end = 0; start < buckets->count; start = end) {
+    for (end = start + 1; end < buckets->count; end++) {
+      int64_t gap = (int64_t)buckets->indexes[end] - buckets->indexes[end - 1] - 1;
+      if (gap > PROM_METRIC_FORMATTER_NATIVE_MAX_GAP) break;
+    }
+
+    prom_string_builder_t *span = prom_metric_formatter_message_builder(self, PROM_METRIC_FORMATTER_LEAF);
+    if (span == NULL) return 1;
+
+    int64_t offset = buckets->indexes[start];
+    if (start > 0) offset -= (int64_t)buckets->indexes[start - 1] + 1;
+    r = prom_protobuf_add_sint64(span, PROM_PROTOBUF_SPAN_OFFSET, offset);
+    if (r) return r;
+
+    r = prom_protobuf_add_uint64(span, PROM_PROTOBUF_SPAN_LENGTH,
+                                 (uint64_t)((int64_t)buckets->indexes[end - 1] - buckets->indexes[start] + 1));
+    if (r) return r;
+
+    r = prom_protobuf_add_message(histogram, span_field, span);
+    if (r) return r;
+  }
+
+  prom_string_builder_t *deltas = prom_metric_formatter_message_builder(self, PROM_METRIC_FORMATTER_LEAF);
+  if (deltas == NULL) return 1;
+
+  int64_t previous = 0;
+  for (size_t i = 0; i < buckets->count; i++) {
+    // The empty buckets inside a span count as buckets of their own
+    int64_t gap = i == 0 ? 0 : (int64_t)buckets->indexes[i] - buckets->indexes[i - 1] - 1;
+    for (int64_t empty = 0; gap <= PROM_METRIC_FORMATTER_NATIVE_MAX_GAP && empty < gap; empty++) {
+      r = prom_protobuf_add_varint(deltas, prom_protobuf_zigzag(-previous));
+      if (r) return r;
+      previous = 0;
+    }
+
+    int64_t count = (int64_t)buckets->counts[i];
+    r = prom_protobuf_add_varint(deltas, prom_protobuf_zigzag(count - previous));
+    if (r) return r;
+    previous = count;
+  }
+  return prom_protobuf_add_message(histogram, delta_field, deltas);
+}
+
+/**
+ * @brief API PRIVATE Adds the fields of a native histogram to histogram, with the sample locked
+ */
+static int prom_metric_formatter_load_protobuf_native_locked(prom_metric_formatter_t *self,
+                                                             prom_string_builder_t *histogram,
+                                                             prom_metric_sample_native_t *native) {
+  int r = 0;
+
+  r = prom_protobuf_add_uint64(histogram, PROM_PROTOBUF_SAMPLE_COUNT, native->count);
+  if (r) return r;
+
+  r = prom_protobuf_add_double(histogram, PROM_PROTOBUF_SAMPLE_SUM, native->sum);
+  if (r) return r;
+
+  r = prom_protobuf_add_sint64(histogram, PROM_PROTOBUF_HISTOGRAM_SCHEMA, native->schema);
+  if (r) return r;
+
+  // A non-zero threshold also tells Prometheus the histogram is native when it has no bucket yet
+  r = prom_protobuf_add_double(histogram, PROM_PROTOBUF_HISTOGRAM_ZERO_THRESHOLD,
+                               PROM_METRIC_SAMPLE_NATIVE_ZERO_THRESHOLD);
+  if (r) return r;
+
+  r = prom_protobuf_add_uint64(histogram, PROM_PROTOBUF_HISTOGRAM_ZERO_COUNT, native->zero_count);
+  if (r) return r;
+
+  r = prom_metric_formatter_load_protobuf_native_buckets(self, histogram, &native->negative,
+                                                         PROM_PROTOBUF_HISTOGRAM_NEGATIVE_SPAN,
+                                                         PROM_PROTOBUF_HISTOGRAM_NEGATIVE_DELTA);
+  if (r) return r;
+
+  return prom_metric_formatter_load_protobuf_native_buckets(self, histogram, &native->positive,
+                                                            PROM_PROTOBUF_HISTOGRAM_POSITIVE_SPAN,
+                                                            PROM_PROTOBUF_HISTOGRAM_POSITIVE_DELTA);
+}
+
+/**
+ * @brief API PRIVATE Adds the Histogram field of a native histogram sample to message
+ *
+ * The sample stays locked while it is encoded, so the buckets, the count and the sum agree with each other.
+ */
+static int prom_metric_formatter_load_protobuf_native(prom_metric_formatter_t *self, prom_string_builder_t *message,
+                                                      prom_metric_sample_native_t *native) {
+  int r = 0;
+
+  prom_string_builder_t *histogram = prom_metric_formatter_message_builder(self, PROM_METRIC_FORMATTER_VALUE);
+  if (histogram == NULL) return 1;
+
+  pthread_mutex_lock(&native->lock);
+  r = prom_metric_formatter_load_protobuf_native_locked(self, histogram, native);
+  pthread_mutex_unlock(&native->lock);
+  if (r) return r;
+
+  return prom_protobuf_add_message(message, PROM_PROTOBUF_METRIC_HISTOGRAM, histogram);
+}
+
+/**
+ * @brief API PRIVATE Adds the Histogram field of a histogram sample to message
+ *
+ * Every counter is read once, so the buckets, the count and the sum agree with each other even while observations
+ * land. The +Inf bucket is implied by the sample count and is not written.
+ */
+static int prom_metric_formatter_load_protobuf_histogram(prom_metric_formatter_t *self, prom_string_builder_t *message,
+                                                         prom_metric_sample_histogram_t *sample) {
+  int r = 0;
+
+  if (sample->native != NULL) return prom_metric_formatter_load_protobuf_native(self, message, sample->native);
+
+  prom_string_builder_t *histogram = prom_metric_formatter_message_builder(self, PROM_METRIC_FORMATTER_VALUE);
+  if (histogram == NULL) return 1;
+
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i <= sample->bucket_count; i++) {
+    for (size_t shard = 0; shard < sample->shard_count; shard++) {
+      cumulative +=
+          atomic_load_explicit(&sample->bucket_counts[shard * sample->shard_stride + i], memory_order_relaxed);
+    }
+    if (i == sample->bucket_count) break;
+
+    prom_string_builder_t *bucket = prom_metric_formatter_message_builder(self, PROM_METRIC_FORMATTER_LEAF);
+    if (bucket == NULL) return 1;
+
+    r = prom_protobuf_add_uint64(bucket, PROM_PROTOBUF_BUCKET_CUMULATIVE_COUNT, cumulative);
+    if (r) return r;
+
+    r = prom_protobuf_add_double(bucket, PROM_PROTOBUF_BUCKET_UPPER_BOUND, sample->buckets->upper_bounds[i]);
+    if (r) return r;
+
+    r = prom_protobuf_add_message(histogram, PROM_PROTOBUF_BUCKET, bucket);
+    if (r) return r;
+  }
+
+  double sum = 0.0;
+  for (size_t shard = 0; shard < sample->shard_count; shard++) {
+    sum += atomic_load_explicit(&sample->sums[shard].value, memory_order_relaxed);
+  }
+
+  r = prom_protobuf_add_uint64(histogram, PROM_PROTOBUF_SAMPLE_COUNT, cumulative);
+  if (r) return r;
+
+  r = prom_protobuf_add_double(histogram, PROM_PROTOBUF_SAMPLE_SUM, sum);
+  if (r) return r;
+
+  return prom_protobuf_add_message(message, PROM_PROTOBUF_METRIC_HISTOGRAM, histogram);
+}
+
+/**
+ * @brief API PRIVATE Adds the Summary field of a summary sample to message
+ */
+static int prom_metric_formatter_load_protobuf_summary(prom_metric_formatter_t *self, prom_string_builder_t *message,
+                                                       prom_metric_sample_summary_t *sample) {
+  int r = 0;
+
+  prom_string_builder_t *summary = prom_metric_formatter_message_builder(self, PROM_METRIC_FORMATTER_VALUE);
+  if (summary == NULL) return 1;
+
+  uint64_t count = prom_metric_sample_summary_count(sample);
+  for (size_t i = 0; i < sample->quantile_count; i++) {
+    prom_string_builder_t *quantile = prom_metric_formatter_message_builder(self, PROM_METRIC_FORMATTER_LEAF);
+    if (quantile == NULL) return 1;
+
+    double q = sample->quantiles->quantiles[i];
+    r = prom_protobuf_add_double(quantile, PROM_PROTOBUF_QUANTILE_QUANTILE, q);
+    if (r) return r;
+
+    r = prom_protobuf_add_double(quantile, PROM_PROTOBUF_QUANTILE_VALUE,
+                                 prom_metric_sample_summary_quantile(sample, q, count));
+    if (r) return r;
+
+    r = prom_protobuf_add_message(summary, PROM_PROTOBUF_QUANTILE, quantile);
+    if (r) return r;
+  }
+
+  r = prom_protobuf_add_uint64(summary, PROM_PROTOBUF_SAMPLE_COUNT, count);
+  if (r) return r;
+
+  r = prom_protobuf_add_double(summary, PROM_PROTOBUF_SAMPLE_SUM,
+                               atomic_load_explicit(&sample->sum, memory_order_relaxed));
+  if (r) return r;
+
+  return prom_protobuf_add_message(message, PROM_PROTOBUF_METRIC_SUMMARY, summary);
+}
+
+/**
+ * @brief API PRIVATE Adds the Counter or Gauge field of a sample to message
+ */
+static int prom_metric_formatter_load_protobuf_sample(prom_metric_formatter_t *self, prom_string_builder_t *message,
+                                                      prom_metric_sample_t *sample) {
+  int r = 0;
+
+  prom_string_builder_t *value = prom_metric_formatter_message_builder(self, PROM_METRIC_FORMATTER_VALUE);
+  if (value == NULL) return 1;
+
+  r = prom_protobuf_add_double(value, PROM_PROTOBUF_VALUE, prom_metric_sample_value(sample));
+  if (r) return r;
+
+  uint32_t field = sample->type == PROM_COUNTER ? PROM_PROTOBUF_METRIC_COUNTER : PROM_PROTOBUF_METRIC_GAUGE;
+  return prom_protobuf_add_message(message, field, value);
+}
+
+/**
+ * @brief API PRIVATE Loads a metric as a varint length followed by a MetricFamily message
+ *
+ * Nested messages are prefixed with their length, so each one is built in the scratch builder of its level and then
+ * copied into its parent. Families without samples are skipped.
+ */
+static int prom_metric_formatter_load_protobuf_metric(prom_metric_formatter_t *self, prom_metric_t *metric) {
+  int r = 0;
+
+  if (metric->samples->head == NULL) return 0;
+
+  prom_string_builder_t *family = prom_metric_formatter_message_builder(self, PROM_METRIC_FORMATTER_FAMILY);
+  if (family == NULL) return 1;
+
+  r = prom_protobuf_add_string(family, PROM_PROTOBUF_FAMILY_NAME, metric->name);
+  if (r) return r;
+
+  r = prom_protobuf_add_string(family, PROM_PROTOBUF_FAMILY_HELP, metric->help);
+  if (r) return r;
+
+  r = prom_protobuf_add_uint64(family, PROM_PROTOBUF_FAMILY_TYPE, prom_metric_formatter_protobuf_types[metric->type]);
+  if (r) return r;
+
+  for (prom_map_node_t *current_node = metric->samples->head; current_node != NULL;
+       current_node = current_node->next) {
+    if (current_node->value == NULL) return 1;
+
+    prom_string_builder_t *message = prom_metric_formatter_message_builder(self, PROM_METRIC_FORMATTER_METRIC);
+    if (message == NULL) return 1;
+
+    if (metric->type == PROM_HISTOGRAM) {
+      prom_metric_sample_histogram_t *sample = (prom_metric_sample_histogram_t *)current_node->value;
+      r = prom_metric_formatter_load_protobuf_labels(self, message, metric, sample->label_count, sample->label_values);
+      if (r) return r;
+      r = prom_metric_formatter_load_protobuf_histogram(self, message, sample);
+    } else if (metric->type == PROM_SUMMARY) {
+      prom_metric_sample_summary_t *sample = (prom_metric_sample_summary_t *)current_node->value;
+      r = prom_metric_formatter_load_protobuf_labels(self, message, metric, sample->label_count, sample->label_values);
+      if (r) return r;
+      r = prom_metric_formatter_load_protobuf_summary(self, message, sample);
     } else {
-      prom_metric_sample_t *sample = (prom_metric_sample_t *)prom_map_get(metric->samples, key);
-      if (sample == NULL) return 1;
-      r = prom_metric_formatter_load_sample(self, sample);
+      prom_metric_sample_t *sample = (prom_metric_sample_t *)current_node->value;
+      r = prom_metric_formatter_load_protobuf_labels(self, message, metric, sample->label_count, sample->label_values);
       if (r) return r;
+      r = prom_metric_formatter_load_protobuf_sample(self, message, sample);
     }
+    if (r) return r;
+
+    r = prom_protobuf_add_message(family, PROM_PROTOBUF_FAMILY_METRIC, message);
+    if (r) return r;
+  }
+
+  r = prom_protobuf_add_varint(self->string_builder, prom_string_builder_len(family));
+  if (r) return r;
+
+  return prom_string_builder_add_bytes(self->string_builder, prom_string_builder_str(family),
+                                       prom_string_builder_len(family));
+}
+
+int prom_metric_formatter_load_metric_as(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                         prom_exposition_format_t format) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  switch (format) {
+    case PROM_EXPOSITION_TEXT:
+    case PROM_EXPOSITION_OPENMETRICS:
+      return prom_metric_formatter_load_text_metric(self, metric, format);
+    case PROM_EXPOSITION_PROTOBUF:
+      return prom_metric_formatter_load_protobuf_metric(self, metric);
+    default:
+      return 1;
   }
-  return prom_string_builder_add_char(self->string_builder, '\n');
 }
 
 int prom_metric_formatter_load_metrics(prom_metric_formatter_t *self, prom_map_t *collectors) {
+  return prom_metric_formatter_load_metrics_as(self, collectors, PROM_EXPOSITION_TEXT);
+}
+
+int prom_metric_formatter_load_metrics_as(prom_metric_formatter_t *self, prom_map_t *collectors,
+                                          prom_exposition_format_t format) {
   PROM_ASSERT(self != NULL);
   int r = 0;
-  for (prom_linked_list_node_t *current_node = collectors->keys->head; current_node != NULL;
-       current_node = current_node->next) {
-    const char *collector_name = (const char *)current_node->item;
-    prom_collector_t *collector = (prom_collector_t *)prom_map_get(collectors, collector_name);
+  for (prom_map_node_t *current_node = collectors->head; current_node != NULL; current_node = current_node->next) {
+    prom_collector_t *collector = (prom_collector_t *)current_node->value;
     if (collector == NULL) return 1;
 
     prom_map_t *metrics = collector->collect_fn(collector);
     if (metrics == NULL) return 1;
 
-    for (prom_linked_list_node_t *current_node = metrics->keys->head; current_node != NULL;
-         current_node = current_node->next) {
-      const char *metric_name = (const char *)current_node->item;
-      prom_metric_t *metric = (prom_metric_t *)prom_map_get(metrics, metric_name);
+    for (prom_map_node_t *current_metric_node = metrics->head; current_metric_node != NULL;
+         current_metric_node = current_metric_node->next) {
+      prom_metric_t *metric = (prom_metric_t *)current_metric_node->value;
       if (metric == NULL) return 1;
-      r = prom_metric_formatter_load_metric(self, metric);
+      pthread_rwlock_rdlock(metric->rwlock);
+      r = prom_metric_formatter_load_metric_as(self, metric, format);
+      pthread_rwlock_unlock(metric->rwlock);
       if (r) return r;
     }
   }
+  if (format == PROM_EXPOSITION_OPENMETRICS) return prom_string_builder_add_str(self->string_builder, "# EOF\n");
   return r;
 }
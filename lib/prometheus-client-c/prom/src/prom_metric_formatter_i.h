@@ -19,8 +19,13 @@
 #ifndef PROM_METRIC_FORMATTER_I_H
 #define PROM_METRIC_FORMATTER_I_H
 
+// Public
+#include "prom_collector_registry.h"
+
 // Private
 #include "prom_metric_formatter_t.h"
+#include "prom_metric_sample_histogram_t.h"
+#include "prom_metric_sample_summary_t.h"
 #include "prom_metric_t.h"
 
 /**
@@ -51,7 +56,8 @@ int prom_metric_formatter_load_type(prom_metric_formatter_t *self, const char *n
  * @param label_keys An array of constant strings.
  * @param label_values An array of constant strings.
  *
- * The number of const char **and prom_label_value must be the same.
+ * The number of const char **and prom_label_value must be the same. Backslashes, double quotes and line feeds in the
+ * label values are escaped as \\, \" and \n, as the text exposition format requires.
  */
 int prom_metric_formatter_load_l_value(prom_metric_formatter_t *metric_formatter, const char *name, const char *suffix,
                                        size_t label_count, const char **label_keys, const char **label_values);
@@ -61,24 +67,83 @@ int prom_metric_formatter_load_l_value(prom_metric_formatter_t *metric_formatter
  */
 int prom_metric_formatter_load_sample(prom_metric_formatter_t *metric_formatter, prom_metric_sample_t *sample);
 
+/**
+ * @brief API PRIVATE Loads the formatter with the bucket, count and sum lines of a histogram sample
+ */
+int prom_metric_formatter_load_histogram(prom_metric_formatter_t *metric_formatter,
+                                         prom_metric_sample_histogram_t *sample);
+
+/**
+ * @brief API PRIVATE Loads the formatter with the quantile, count and sum lines of a summary sample
+ */
+int prom_metric_formatter_load_summary(prom_metric_formatter_t *metric_formatter, prom_metric_sample_summary_t *sample);
+
 /**
  * @brief API PRIVATE Loads a metric in the string exposition format
  */
 int prom_metric_formatter_load_metric(prom_metric_formatter_t *self, prom_metric_t *metric);
 
+/**
+ * @brief API PRIVATE Loads the HELP and TYPE lines of a metric in one of the text formats
+ *
+ * Together with prom_metric_formatter_load_metric_sample and prom_metric_formatter_load_metric_footer, this lets a
+ * metric be written one sample at a time.
+ */
+int prom_metric_formatter_load_metric_header(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                             prom_exposition_format_t format);
+
+/**
+ * @brief API PRIVATE Loads the lines of one sample of a metric in one of the text formats
+ * @param sample A prom_metric_sample_t*, prom_metric_sample_histogram_t* or prom_metric_sample_summary_t* according
+ * to the type of the metric
+ */
+int prom_metric_formatter_load_metric_sample(prom_metric_formatter_t *self, prom_metric_t *metric, void *sample,
+                                             prom_exposition_format_t format);
+
+/**
+ * @brief API PRIVATE Loads what follows the last sample of a metric in one of the text formats
+ */
+int prom_metric_formatter_load_metric_footer(prom_metric_formatter_t *self, prom_exposition_format_t format);
+
+/**
+ * @brief API PRIVATE Loads a metric in the given exposition format
+ *
+ * OpenMetrics families are not followed by a blank line and counter families drop their _total suffix, which their
+ * samples always carry. Protobuf families are written as a varint length followed by a MetricFamily message.
+ */
+int prom_metric_formatter_load_metric_as(prom_metric_formatter_t *self, prom_metric_t *metric,
+                                         prom_exposition_format_t format);
+
 /**
  * @brief API PRIVATE Loads the given metrics
  */
 int prom_metric_formatter_load_metrics(prom_metric_formatter_t *self, prom_map_t *collectors);
 
+/**
+ * @brief API PRIVATE Loads the given metrics in the given exposition format, ending OpenMetrics with # EOF
+ */
+int prom_metric_formatter_load_metrics_as(prom_metric_formatter_t *self, prom_map_t *collectors,
+                                          prom_exposition_format_t format);
+
 /**
  * @brief API PRIVATE Clear the underlying string_builder
+ *
+ * The allocation is kept and grown to the longest string the formatter has built so far.
  */
 int prom_metric_formatter_clear(prom_metric_formatter_t *self);
 
 /**
- * @brief API PRIVATE Returns the string built by prom_metric_formatter
+ * @brief API PRIVATE Returns a copy of the string built by prom_metric_formatter and clears the formatter
  */
 char *prom_metric_formatter_dump(prom_metric_formatter_t *metric_formatter);
 
+/**
+ * @brief API PRIVATE Returns the interned exposition prefix of the l_value built by prom_metric_formatter and clears
+ * the formatter
+ *
+ * The prefix is the l_value followed by the space that separates it from the value, so rendering a series copies it
+ * in one piece and only formats the value. Release it with prom_intern_release.
+ */
+const char *prom_metric_formatter_dump_prefix(prom_metric_formatter_t *metric_formatter);
+
 #endif  // PROM_METRIC_FORMATTER_I_H
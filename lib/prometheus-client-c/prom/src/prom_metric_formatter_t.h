@@ -17,11 +17,18 @@
 #ifndef PROM_METRIC_FORMATTER_T_H
 #define PROM_METRIC_FORMATTER_T_H
 
+#include <stddef.h>
+
 #include "prom_string_builder_t.h"
 
+// Nesting depth of the protobuf messages: MetricFamily, Metric, Counter/Gauge/Histogram/Summary, Bucket/Quantile
+#define PROM_METRIC_FORMATTER_MESSAGE_DEPTH 4
+
 typedef struct prom_metric_formatter {
   prom_string_builder_t *string_builder;
   prom_string_builder_t *err_builder;
+  size_t capacity_hint; /**< longest string built so far, reserved up front on every clear */
+  prom_string_builder_t *message_builders[PROM_METRIC_FORMATTER_MESSAGE_DEPTH]; /**< protobuf scratch, lazily made */
 } prom_metric_formatter_t;
 
 #endif  // PROM_METRIC_FORMATTER_T_H
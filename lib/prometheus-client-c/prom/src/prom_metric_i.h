@@ -42,4 +42,13 @@ int prom_metric_destroy_generic(void *item);
  */
 void prom_metric_free_generic(void *item);
 
+/**
+ * @brief API PRIVATE Resolves the sample of the given label values and applies fn to it
+ *
+ * The update runs in a grace period of the metric: a sweep or removal that unlinks the sample meanwhile frees it only
+ * once the update has returned.
+ */
+int prom_metric_update(prom_metric_t *self, const char **label_values,
+                       int (*fn)(prom_metric_sample_t *sample, double r_value), double r_value);
+
 #endif  // PROM_METRIC_I_INCLUDED
@@ -14,7 +14,10 @@
  * limitations under the License.
  */
 
+#include <sched.h>
 #include <stdatomic.h>
+#include <string.h>
+#include <time.h>
 
 // Public
 #include "prom_alloc.h"
@@ -22,28 +25,111 @@
 // Private
 #include "prom_assert.h"
 #include "prom_errors.h"
+#include "prom_intern_i.h"
 #include "prom_log.h"
 #include "prom_metric_sample_i.h"
 #include "prom_metric_sample_t.h"
+#include "prom_metric_shard_i.h"
 
-prom_metric_sample_t *prom_metric_sample_new(prom_metric_type_t type, const char *l_value, double r_value) {
+#define PROM_METRIC_SAMPLE_READ_SPINS 1024
+
+typedef struct prom_metric_sample_shard_generation {
+  _Alignas(PROM_METRIC_SHARD_CACHE_LINE) _Atomic uint64_t value;
+} prom_metric_sample_shard_generation_t;
+
+static _Atomic uint64_t prom_metric_sample_publish_seq = ATOMIC_VAR_INIT(0);
+static _Atomic unsigned int prom_metric_sample_publish_writers = ATOMIC_VAR_INIT(0);
+static _Atomic uint64_t prom_metric_sample_generation_counter = ATOMIC_VAR_INIT(0);
+static prom_metric_sample_shard_generation_t prom_metric_sample_shard_generations[PROM_METRIC_SHARD_MAX];
+static _Atomic uint32_t prom_metric_sample_lifecycle_clock = ATOMIC_VAR_INIT(0);
+
+prom_metric_sample_t *prom_metric_sample_new(prom_metric_type_t type, const char *l_value, double r_value,
+                                             size_t label_count, const char **label_values) {
   prom_metric_sample_t *self = (prom_metric_sample_t *)prom_malloc(sizeof(prom_metric_sample_t));
   self->type = type;
-  self->l_value = prom_strdup(l_value);
+  self->prefix = prom_metric_sample_prefix_new(l_value);
   self->r_value = ATOMIC_VAR_INIT(r_value);
+  self->value = &self->r_value;
+  self->u_value = ATOMIC_VAR_INIT(0);
+  self->integer = false;
+  self->shard_count = 0;
+  self->shards = NULL;
+  self->shard_storage = NULL;
+  self->label_count = label_count;
+  self->label_values = prom_metric_sample_label_values_copy(label_count, label_values);
+  atomic_init(&self->touched, atomic_load_explicit(&prom_metric_sample_lifecycle_clock, memory_order_relaxed));
+  self->pinned = false;
+  if (self->prefix == NULL || (label_count > 0 && self->label_values == NULL)) {
+    prom_metric_sample_destroy(self);
+    return NULL;
+  }
+  prom_metric_sample_generation_bump();
+  return self;
+}
+
+prom_metric_sample_t *prom_metric_sample_new_sharded(prom_metric_type_t type, const char *l_value, size_t shard_count,
+                                                     size_t label_count, const char **label_values) {
+  prom_metric_sample_t *self = prom_metric_sample_new(type, l_value, 0.0, label_count, label_values);
+  if (self == NULL) return NULL;
+  if (shard_count == 0) return self;
+
+  self->shards = (prom_metric_shard_t *)prom_metric_shard_alloc(sizeof(prom_metric_shard_t) * shard_count,
+                                                                &self->shard_storage);
+  if (self->shards == NULL) {
+    prom_metric_sample_destroy(self);
+    return NULL;
+  }
+  self->shard_count = shard_count;
   return self;
 }
 
 int prom_metric_sample_destroy(prom_metric_sample_t *self) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 0;
-  prom_free((void *)self->l_value);
-  self->l_value = NULL;
+  prom_intern_release(self->prefix);
+  self->prefix = NULL;
+  prom_free(self->shard_storage);
+  self->shard_storage = NULL;
+  self->shards = NULL;
+  prom_metric_sample_label_values_free(self->label_count, self->label_values);
+  self->label_values = NULL;
   prom_free((void *)self);
   self = NULL;
   return 0;
 }
 
+const char *prom_metric_sample_prefix_new(const char *l_value) {
+  size_t len = strlen(l_value);
+  char *buf = (char *)prom_malloc(len + 1);
+  if (buf == NULL) return NULL;
+  memcpy(buf, l_value, len);
+  buf[len] = ' ';
+  const char *prefix = prom_intern_acquire(buf, len + 1);
+  prom_free(buf);
+  return prefix;
+}
+
+const char **prom_metric_sample_label_values_copy(size_t label_count, const char **label_values) {
+  if (label_count == 0 || label_values == NULL) return NULL;
+  const char **copy = (const char **)prom_malloc(sizeof(const char *) * label_count);
+  if (copy == NULL) return NULL;
+  for (size_t i = 0; i < label_count; i++) {
+    // Label values repeat across series (hosts, CPUs, devices), so each distinct value is stored once
+    copy[i] = prom_intern_acquire(label_values[i], strlen(label_values[i]));
+    if (copy[i] == NULL) {
+      prom_metric_sample_label_values_free(i, copy);
+      return NULL;
+    }
+  }
+  return copy;
+}
+
+void prom_metric_sample_label_values_free(size_t label_count, const char **label_values) {
+  if (label_values == NULL) return;
+  for (size_t i = 0; i < label_count; i++) prom_intern_release(label_values[i]);
+  prom_free((void *)label_values);
+}
+
 int prom_metric_sample_destroy_generic(void *gen) {
   int r = 0;
 
@@ -60,13 +146,27 @@ void prom_metric_sample_free_generic(void *gen) {
 
 int prom_metric_sample_add(prom_metric_sample_t *self, double r_value) {
   PROM_ASSERT(self != NULL);
+  prom_metric_sample_touch(self);
   if (r_value < 0) {
     return 1;
   }
-  _Atomic double old = atomic_load(&self->r_value);
+  if (self->integer) return prom_metric_sample_add_u64(self, (uint64_t)r_value);
+  if (self->shards != NULL) {
+    // Uncontended unless two threads share a CPU, and then only briefly
+    size_t shard = prom_metric_shard_index(self->shard_count);
+    _Atomic double *slot = &self->shards[shard].value;
+    double current = atomic_load_explicit(slot, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(slot, &current, current + r_value, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+    if (r_value != 0) prom_metric_sample_generation_bump_shard(shard);
+    return 0;
+  }
+  _Atomic double old = atomic_load(self->value);
   for (;;) {
     _Atomic double new = ATOMIC_VAR_INIT(old + r_value);
-    if (atomic_compare_exchange_weak(&self->r_value, &old, new)) {
+    if (atomic_compare_exchange_weak(self->value, &old, new)) {
+      if (r_value != 0) prom_metric_sample_generation_bump();
       return 0;
     }
   }
@@ -74,14 +174,27 @@ int prom_metric_sample_add(prom_metric_sample_t *self, double r_value) {
 
 int prom_metric_sample_sub(prom_metric_sample_t *self, double r_value) {
   PROM_ASSERT(self != NULL);
+  prom_metric_sample_touch(self);
   if (self->type != PROM_GAUGE) {
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  _Atomic double old = atomic_load(&self->r_value);
+  if (self->integer) {
+    if (r_value < 0) return 1;
+    if (r_value == 0) return 0;
+    uint64_t value = (uint64_t)r_value;
+    uint64_t old = atomic_load(&self->u_value);
+    // Clamp at zero rather than wrapping around to a huge value
+    while (!atomic_compare_exchange_weak(&self->u_value, &old, old > value ? old - value : 0)) {
+    }
+    if (old != 0) prom_metric_sample_generation_bump();
+    return 0;
+  }
+  _Atomic double old = atomic_load(self->value);
   for (;;) {
     _Atomic double new = ATOMIC_VAR_INIT(old - r_value);
-    if (atomic_compare_exchange_weak(&self->r_value, &old, new)) {
+    if (atomic_compare_exchange_weak(self->value, &old, new)) {
+      if (r_value != 0) prom_metric_sample_generation_bump();
       return 0;
     }
   }
@@ -89,9 +202,131 @@ int prom_metric_sample_sub(prom_metric_sample_t *self, double r_value) {
 
 int prom_metric_sample_set(prom_metric_sample_t *self, double r_value) {
   if (self->type != PROM_GAUGE) {
+    prom_metric_sample_touch(self);
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_sample_store(self, r_value);
+}
+
+int prom_metric_sample_set_counter(prom_metric_sample_t *self, double r_value) {
+  if (self->type != PROM_COUNTER) {
+    prom_metric_sample_touch(self);
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  return prom_metric_sample_store(self, r_value);
+}
+
+int prom_metric_sample_store(prom_metric_sample_t *self, double r_value) {
+  PROM_ASSERT(self != NULL);
+  prom_metric_sample_touch(self);
+  if (self->shards != NULL) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  if (self->integer) return r_value < 0 ? 1 : prom_metric_sample_set_u64(self, (uint64_t)r_value);
+  // Only a value that actually changed invalidates renders of the registry. The bits are compared, so that a NaN
+  // stored over a NaN counts as unchanged.
+  double old = atomic_exchange(self->value, r_value);
+  if (memcmp(&old, &r_value, sizeof(old)) != 0) prom_metric_sample_generation_bump();
+  return 0;
+}
+
+int prom_metric_sample_add_u64(prom_metric_sample_t *self, uint64_t value) {
+  PROM_ASSERT(self != NULL);
+  prom_metric_sample_touch(self);
+  if (!self->integer) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  if (value != 0) {
+    atomic_fetch_add(&self->u_value, value);
+    prom_metric_sample_generation_bump();
+  }
+  return 0;
+}
+
+int prom_metric_sample_set_u64(prom_metric_sample_t *self, uint64_t value) {
+  PROM_ASSERT(self != NULL);
+  prom_metric_sample_touch(self);
+  if (!self->integer) {
     PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
     return 1;
   }
-  atomic_store(&self->r_value, r_value);
+  uint64_t old = atomic_exchange(&self->u_value, value);
+  if (old != value) prom_metric_sample_generation_bump();
   return 0;
 }
+
+uint64_t prom_metric_sample_value_u64(prom_metric_sample_t *self) {
+  PROM_ASSERT(self != NULL);
+  return atomic_load(&self->u_value);
+}
+
+double prom_metric_sample_value(prom_metric_sample_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self->integer) return (double)atomic_load(&self->u_value);
+  double value = atomic_load(self->value);
+  for (size_t i = 0; i < self->shard_count; i++) {
+    value += atomic_load_explicit(&self->shards[i].value, memory_order_relaxed);
+  }
+  return value;
+}
+
+void prom_metric_sample_generation_bump(void) { atomic_fetch_add(&prom_metric_sample_generation_counter, 1); }
+
+void prom_metric_sample_generation_bump_shard(size_t shard) {
+  atomic_fetch_add_explicit(&prom_metric_sample_shard_generations[shard].value, 1, memory_order_relaxed);
+}
+
+uint64_t prom_metric_sample_generation(void) {
+  // Every counter only moves forward, so the sum changes whenever any of them does
+  uint64_t generation = atomic_load(&prom_metric_sample_generation_counter);
+  for (size_t i = 0; i < PROM_METRIC_SHARD_MAX; i++) {
+    generation += atomic_load_explicit(&prom_metric_sample_shard_generations[i].value, memory_order_relaxed);
+  }
+  return generation;
+}
+
+void prom_metric_sample_publish_begin(void) {
+  atomic_fetch_add(&prom_metric_sample_publish_writers, 1);
+  atomic_fetch_add(&prom_metric_sample_publish_seq, 1);
+}
+
+void prom_metric_sample_publish_end(void) {
+  atomic_fetch_add(&prom_metric_sample_publish_seq, 1);
+  atomic_fetch_sub(&prom_metric_sample_publish_writers, 1);
+}
+
+uint64_t prom_metric_sample_read_begin(void) {
+  for (int i = 0; i < PROM_METRIC_SAMPLE_READ_SPINS; i++) {
+    if (atomic_load(&prom_metric_sample_publish_writers) == 0) break;
+    sched_yield();
+  }
+  return atomic_load(&prom_metric_sample_publish_seq);
+}
+
+bool prom_metric_sample_read_validate(uint64_t seq) {
+  return atomic_load(&prom_metric_sample_publish_writers) == 0 && atomic_load(&prom_metric_sample_publish_seq) == seq;
+}
+
+uint32_t prom_metric_sample_clock_advance(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint32_t clock = (uint32_t)now.tv_sec + 1;
+  atomic_store_explicit(&prom_metric_sample_lifecycle_clock, clock, memory_order_relaxed);
+  return clock;
+}
+
+uint32_t prom_metric_sample_clock(void) {
+  return atomic_load_explicit(&prom_metric_sample_lifecycle_clock, memory_order_relaxed);
+}
+
+void prom_metric_sample_touch(prom_metric_sample_t *self) {
+  // The stamp only changes once per sweep, so sharded samples updated from every CPU do not keep sharing its line
+  uint32_t clock = atomic_load_explicit(&prom_metric_sample_lifecycle_clock, memory_order_relaxed);
+  if (atomic_load_explicit(&self->touched, memory_order_relaxed) != clock) {
+    atomic_store_explicit(&self->touched, clock, memory_order_relaxed);
+  }
+}
@@ -14,8 +14,10 @@
  * limitations under the License.
  */
 
-#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 // Public
 #include "prom_alloc.h"
@@ -24,12 +26,13 @@
 // Private
 #include "prom_assert.h"
 #include "prom_errors.h"
-#include "prom_linked_list_i.h"
 #include "prom_log.h"
-#include "prom_map_i.h"
+#include "prom_intern_i.h"
 #include "prom_metric_formatter_i.h"
 #include "prom_metric_sample_histogram_i.h"
 #include "prom_metric_sample_i.h"
+#include "prom_metric_sample_native_i.h"
+#include "prom_metric_shard_i.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Static Declarations
@@ -44,41 +47,36 @@ static const char *prom_metric_sample_histogram_l_value_for_inf(prom_metric_samp
                                                                 size_t label_count, const char **label_keys,
                                                                 const char **label_values);
 
-static void prom_metric_sample_histogram_free_str_generic(void *gen);
-
-static int prom_metric_sample_histogram_init_bucket_samples(prom_metric_sample_histogram_t *self, const char *name,
-                                                            size_t label_count, const char **label_keys,
-                                                            const char **label_values);
-
-static int prom_metric_sample_histogram_init_inf(prom_metric_sample_histogram_t *self, const char *name,
-                                                 size_t label_count, const char **label_keys,
-                                                 const char **label_values);
-
-static int prom_metric_sample_histogram_init_count(prom_metric_sample_histogram_t *self, const char *name,
-                                                   size_t label_count, const char **label_keys,
-                                                   const char **label_values);
-
-static int prom_metric_sample_histogram_init_summary(prom_metric_sample_histogram_t *self, const char *name,
-                                                     size_t label_count, const char **label_keys,
-                                                     const char **label_values);
+static const char *prom_metric_sample_histogram_l_value_for_suffix(prom_metric_sample_histogram_t *self,
+                                                                   const char *name, const char *suffix,
+                                                                   size_t label_count, const char **label_keys,
+                                                                   const char **label_values);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // End static declarations
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 prom_metric_sample_histogram_t *prom_metric_sample_histogram_new(const char *name, prom_histogram_buckets_t *buckets,
-                                                                 size_t label_count, const char **label_keys,
-                                                                 const char **label_values) {
-  // Capture return codes
-  int r = 0;
-
+                                                                 size_t shard_count, size_t label_count,
+                                                                 const char **label_keys, const char **label_values) {
   // Allocate and set self
   prom_metric_sample_histogram_t *self =
       (prom_metric_sample_histogram_t *)prom_malloc(sizeof(prom_metric_sample_histogram_t));
+  if (self == NULL) return NULL;
 
-  // Allocate and set the l_value_list
-  self->l_value_list = prom_linked_list_new();
-  if (self->l_value_list == NULL) {
+  self->buckets = buckets;
+  self->bucket_count = prom_histogram_buckets_count(buckets);
+  self->prefixes = NULL;
+  self->shard_count = shard_count == 0 ? 1 : shard_count;
+  self->bucket_counts = NULL;
+  self->sums = NULL;
+  self->bucket_counts_storage = NULL;
+  self->sums_storage = NULL;
+  self->metric_formatter = NULL;
+  self->native = NULL;
+  self->label_count = label_count;
+  self->label_values = prom_metric_sample_label_values_copy(label_count, label_values);
+  if (label_count > 0 && self->label_values == NULL) {
     prom_metric_sample_histogram_destroy(self);
     return NULL;
   }
@@ -90,184 +88,62 @@ prom_metric_sample_histogram_t *prom_metric_sample_histogram_new(const char *nam
     return NULL;
   }
 
-  // Store map of l_value/prom_metric_sample_t
-  self->samples = prom_map_new();
-  if (self->samples == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Set the free value function on the samples map
-  r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_free_generic);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Set a map of bucket: l_value
-  self->l_values = prom_map_new();  // Store map of bucket/l_value
-  if (self->l_values == NULL) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  // Set the free value function for thhe l_values map
-  r = prom_map_set_free_value_fn(self->l_values, prom_metric_sample_histogram_free_str_generic);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
-
-  self->buckets = buckets;
-
-  // Allocate and initialize the lock
-  self->rwlock = (pthread_rwlock_t *)prom_malloc(sizeof(pthread_rwlock_t));
-  r = pthread_rwlock_init(self->rwlock, NULL);
-  if (r) {
+  // Allocate the counters of every bucket plus the +Inf overflow in one contiguous array, with each shard's counters
+  // starting on a cache line of their own
+  size_t per_line = PROM_METRIC_SHARD_CACHE_LINE / sizeof(_Atomic uint64_t);
+  self->shard_stride = (self->bucket_count + 1 + per_line - 1) / per_line * per_line;
+  self->bucket_counts = (_Atomic uint64_t *)prom_metric_shard_alloc(
+      sizeof(_Atomic uint64_t) * self->shard_stride * self->shard_count, &self->bucket_counts_storage);
+  if (self->bucket_counts == NULL) {
     prom_metric_sample_histogram_destroy(self);
     return NULL;
   }
+  for (size_t i = 0; i < self->shard_stride * self->shard_count; i++) atomic_init(&self->bucket_counts[i], 0);
 
-  // Allocate and initialize bucket metric samples
-  r = prom_metric_sample_histogram_init_bucket_samples(self, name, label_count, label_keys, label_values);
-  if (r) {
+  self->sums = (prom_metric_shard_t *)prom_metric_shard_alloc(sizeof(prom_metric_shard_t) * self->shard_count,
+                                                              &self->sums_storage);
+  if (self->sums == NULL) {
     prom_metric_sample_histogram_destroy(self);
     return NULL;
   }
+  for (size_t i = 0; i < self->shard_count; i++) atomic_init(&self->sums[i].value, 0.0);
 
-  // Allocate and initialize the +Inf metric sample
-  r = prom_metric_sample_histogram_init_inf(self, name, label_count, label_keys, label_values);
-  if (r) {
+  // Render every prefix once: the buckets (with their le label), then +Inf, count and sum
+  size_t prefix_count = PROM_METRIC_SAMPLE_HISTOGRAM_PREFIX_COUNT(self);
+  self->prefixes = (const char **)prom_malloc(sizeof(const char *) * prefix_count);
+  if (self->prefixes == NULL) {
     prom_metric_sample_histogram_destroy(self);
     return NULL;
   }
-
-  // Allocate and initialize the count metric sample
-  r = prom_metric_sample_histogram_init_count(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
+  for (size_t i = 0; i < prefix_count; i++) self->prefixes[i] = NULL;
+
+  for (size_t i = 0; i < self->bucket_count; i++) {
+    self->prefixes[i] = prom_metric_sample_histogram_l_value_for_bucket(self, name, label_count, label_keys,
+                                                                        label_values, self->buckets->upper_bounds[i]);
+    if (self->prefixes[i] == NULL) {
+      prom_metric_sample_histogram_destroy(self);
+      return NULL;
+    }
   }
 
-  // Add summary sample
-  r = prom_metric_sample_histogram_init_summary(self, name, label_count, label_keys, label_values);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
+  self->prefixes[PROM_METRIC_SAMPLE_HISTOGRAM_INF_INDEX(self)] =
+      prom_metric_sample_histogram_l_value_for_inf(self, name, label_count, label_keys, label_values);
+  self->prefixes[PROM_METRIC_SAMPLE_HISTOGRAM_COUNT_INDEX(self)] =
+      prom_metric_sample_histogram_l_value_for_suffix(self, name, "count", label_count, label_keys, label_values);
+  self->prefixes[PROM_METRIC_SAMPLE_HISTOGRAM_SUM_INDEX(self)] =
+      prom_metric_sample_histogram_l_value_for_suffix(self, name, "sum", label_count, label_keys, label_values);
+  for (size_t i = self->bucket_count; i < prefix_count; i++) {
+    if (self->prefixes[i] == NULL) {
+      prom_metric_sample_histogram_destroy(self);
+      return NULL;
+    }
   }
 
-  // The value of nodes in this map will be simple prom_metric_sample pointers.
-  r = prom_map_set_free_value_fn(self->samples, &prom_metric_sample_free_generic);
-  if (r) {
-    prom_metric_sample_histogram_destroy(self);
-    return NULL;
-  }
+  // A new series changes the exposition even before its first observation
+  prom_metric_sample_generation_bump();
   return self;
 }
 
-static int prom_metric_sample_histogram_init_bucket_samples(prom_metric_sample_histogram_t *self, const char *name,
-                                                            size_t label_count, const char **label_keys,
-                                                            const char **label_values) {
-  PROM_ASSERT(self);
-  int r = 0;
-  int bucket_count = prom_histogram_buckets_count(self->buckets);
-
-  // For each bucket, create an prom_metric_sample_t with an appropriate l_value and default value of 0.0. The
-  // l_value will contain the metric name, user labels, and finally, the le label and bucket value.
-  for (int i = 0; i < bucket_count; i++) {
-    const char *l_value = prom_metric_sample_histogram_l_value_for_bucket(self, name, label_count, label_keys,
-                                                                          label_values, self->buckets->upper_bounds[i]);
-    if (l_value == NULL) return 1;
-
-    r = prom_linked_list_append(self->l_value_list, prom_strdup(l_value));
-    if (r) return r;
-
-    const char *bucket_key = prom_metric_sample_histogram_bucket_to_str(self->buckets->upper_bounds[i]);
-    if (bucket_key == NULL) return 1;
-
-    r = prom_map_set(self->l_values, bucket_key, (char *)l_value);
-    if (r) return r;
-
-    prom_metric_sample_t *sample = prom_metric_sample_new(PROM_HISTOGRAM, l_value, 0.0);
-    if (sample == NULL) return 1;
-
-    r = prom_map_set(self->samples, l_value, sample);
-    if (r) return r;
-
-    prom_free((void *)bucket_key);
-  }
-  return 0;
-}
-
-static int prom_metric_sample_histogram_init_inf(prom_metric_sample_histogram_t *self, const char *name,
-                                                 size_t label_count, const char **label_keys,
-                                                 const char **label_values) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
-  const char *inf_l_value =
-      prom_metric_sample_histogram_l_value_for_inf(self, name, label_count, label_keys, label_values);
-  if (inf_l_value == NULL) return 1;
-
-  r = prom_linked_list_append(self->l_value_list, prom_strdup(inf_l_value));
-  if (r) return r;
-
-  r = prom_map_set(self->l_values, "+Inf", (char *)inf_l_value);
-  if (r) return r;
-
-  prom_metric_sample_t *inf_sample = prom_metric_sample_new(PROM_HISTOGRAM, (char *)inf_l_value, 0.0);
-  if (inf_sample == NULL) return 1;
-
-  return prom_map_set(self->samples, inf_l_value, inf_sample);
-}
-
-static int prom_metric_sample_histogram_init_count(prom_metric_sample_histogram_t *self, const char *name,
-                                                   size_t label_count, const char **label_keys,
-                                                   const char **label_values) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
-
-  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, "count", label_count, label_keys, label_values);
-  if (r) return r;
-
-  const char *count_l_value = prom_metric_formatter_dump(self->metric_formatter);
-  if (count_l_value == NULL) return 1;
-
-  r = prom_linked_list_append(self->l_value_list, prom_strdup(count_l_value));
-  if (r) return r;
-
-  r = prom_map_set(self->l_values, "count", (char *)count_l_value);
-  if (r) return r;
-
-  prom_metric_sample_t *count_sample = prom_metric_sample_new(PROM_HISTOGRAM, count_l_value, 0.0);
-  if (count_sample == NULL) return 1;
-
-  return prom_map_set(self->samples, count_l_value, count_sample);
-}
-
-static int prom_metric_sample_histogram_init_summary(prom_metric_sample_histogram_t *self, const char *name,
-                                                     size_t label_count, const char **label_keys,
-                                                     const char **label_values) {
-  PROM_ASSERT(self != NULL);
-  int r = 0;
-
-  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, "sum", label_count, label_keys, label_values);
-  if (r) return r;
-
-  const char *sum_l_value = prom_metric_formatter_dump(self->metric_formatter);
-  if (sum_l_value == NULL) return 1;
-
-  r = prom_linked_list_append(self->l_value_list, prom_strdup(sum_l_value));
-  if (r) return r;
-
-  r = prom_map_set(self->l_values, "sum", (char *)sum_l_value);
-  if (r) return r;
-
-  prom_metric_sample_t *sum_sample = prom_metric_sample_new(PROM_HISTOGRAM, sum_l_value, 0.0);
-  if (sum_sample == NULL) return 1;
-
-  return prom_map_set(self->samples, sum_l_value, sum_sample);
-}
-
 int prom_metric_sample_histogram_destroy(prom_metric_sample_histogram_t *self) {
   PROM_ASSERT(self != NULL);
   int r = 0;
@@ -275,27 +151,37 @@ int prom_metric_sample_histogram_destroy(prom_metric_sample_histogram_t *self) {
 
   if (self == NULL) return 0;
 
-  r = prom_linked_list_destroy(self->l_value_list);
-  self->l_value_list = NULL;
-  if (r) ret = r;
+  if (self->prefixes != NULL) {
+    for (size_t i = 0; i < PROM_METRIC_SAMPLE_HISTOGRAM_PREFIX_COUNT(self); i++) {
+      prom_intern_release(self->prefixes[i]);
+      self->prefixes[i] = NULL;
+    }
+    prom_free(self->prefixes);
+    self->prefixes = NULL;
+  }
 
-  r = prom_map_destroy(self->samples);
-  if (r) ret = r;
-  self->samples = NULL;
+  prom_free(self->bucket_counts_storage);
+  self->bucket_counts_storage = NULL;
+  self->bucket_counts = NULL;
 
-  r = prom_map_destroy(self->l_values);
-  if (r) ret = r;
-  self->l_values = NULL;
+  prom_free(self->sums_storage);
+  self->sums_storage = NULL;
+  self->sums = NULL;
 
-  r = prom_metric_formatter_destroy(self->metric_formatter);
-  if (r) ret = r;
-  self->metric_formatter = NULL;
+  prom_metric_sample_label_values_free(self->label_count, self->label_values);
+  self->label_values = NULL;
 
-  r = pthread_rwlock_destroy(self->rwlock);
-  if (r) ret = r;
+  if (self->metric_formatter != NULL) {
+    r = prom_metric_formatter_destroy(self->metric_formatter);
+    if (r) ret = r;
+    self->metric_formatter = NULL;
+  }
 
-  prom_free(self->rwlock);
-  self->rwlock = NULL;
+  if (self->native != NULL) {
+    r = prom_metric_sample_native_destroy(self->native);
+    if (r) ret = r;
+    self->native = NULL;
+  }
 
   prom_free(self);
   self = NULL;
@@ -317,101 +203,40 @@ void prom_metric_sample_histogram_free_generic(void *gen) {
 }
 
 int prom_metric_sample_histogram_observe(prom_metric_sample_histogram_t *self, double value) {
-  int r = 0;
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
 
-  r = pthread_rwlock_wrlock(self->rwlock);
-  if (r) {
-    printf("RETURN CODE: %d\n", r);
-    PROM_LOG(PROM_PTHREAD_RWLOCK_LOCK_ERROR);
+  if (self->native != NULL) {
+    int r = prom_metric_sample_native_observe(self->native, value);
+    if (r == 0) prom_metric_sample_generation_bump();
     return r;
   }
 
-#define PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(r) \
-  int rr = 0;                                                 \
-  rr = pthread_rwlock_unlock(self->rwlock);                   \
-  if (rr) {                                                   \
-    PROM_LOG(PROM_PTHREAD_RWLOCK_UNLOCK_ERROR);               \
-    return rr;                                                \
-  } else {                                                    \
-    return r;                                                 \
-  }
-
-  // Update the counter for the proper bucket if found
-  int bucket_count = prom_histogram_buckets_count(self->buckets);
-  for (int i = (bucket_count - 1); i >= 0; i--) {
-    if (value > self->buckets->upper_bounds[i]) {
-      break;
-    }
-
-    const char *bucket_key = prom_metric_sample_histogram_bucket_to_str(self->buckets->upper_bounds[i]);
-    if (bucket_key == NULL) {
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1)
-    }
-
-    const char *l_value = prom_map_get(self->l_values, bucket_key);
-    if (l_value == NULL) {
-      prom_free((void *)bucket_key);
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1)
-    }
-
-    prom_metric_sample_t *sample = prom_map_get(self->samples, l_value);
-    if (sample == NULL) {
-      prom_free((void *)bucket_key);
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1)
+  // Binary search for the first upper bound greater than or equal to value. The bounds are sorted in increasing
+  // order; values above every bound (and NaN) land in the +Inf overflow slot at index bucket_count.
+  const double *upper_bounds = self->buckets->upper_bounds;
+  size_t low = 0;
+  size_t high = self->bucket_count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (value <= upper_bounds[mid]) {
+      high = mid;
+    } else {
+      low = mid + 1;
     }
-
-    prom_free((void *)bucket_key);
-    r = prom_metric_sample_add(sample, 1.0);
-    if (r) {
-      PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(r);
-    }
-  }
-
-  // Update the +Inf and count samples
-  const char *inf_l_value = prom_map_get(self->l_values, "+Inf");
-  if (inf_l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
   }
 
-  prom_metric_sample_t *inf_sample = prom_map_get(self->samples, inf_l_value);
-  if (inf_sample == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  r = prom_metric_sample_add(inf_sample, 1.0);
-  if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
+  // Count the observation in the shard of the calling CPU; shards are merged at scrape time
+  size_t shard = prom_metric_shard_index(self->shard_count);
+  atomic_fetch_add_explicit(&self->bucket_counts[shard * self->shard_stride + low], 1, memory_order_relaxed);
 
-  const char *count_l_value = prom_map_get(self->l_values, "count");
-  if (count_l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
+  _Atomic double *sum = &self->sums[shard].value;
+  double old = atomic_load_explicit(sum, memory_order_relaxed);
+  while (!atomic_compare_exchange_weak_explicit(sum, &old, old + value, memory_order_relaxed, memory_order_relaxed)) {
   }
 
-  prom_metric_sample_t *count_sample = prom_map_get(self->samples, count_l_value);
-  if (count_sample == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  r = prom_metric_sample_add(count_sample, 1.0);
-  if (r) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  // Update the sum sample
-  const char *sum_l_value = prom_map_get(self->l_values, "sum");
-  if (sum_l_value == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  prom_metric_sample_t *sum_sample = prom_map_get(self->samples, sum_l_value);
-  if (sum_sample == NULL) {
-    PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(1);
-  }
-
-  r = prom_metric_sample_add(sum_sample, value);
-  PROM_METRIC_SAMPLE_HISTOGRAM_OBSERVE_HANDLE_UNLOCK(r);
-  return r;
+  prom_metric_sample_generation_bump_shard(shard);
+  return 0;
 }
 
 static const char *prom_metric_sample_histogram_l_value_for_bucket(prom_metric_sample_histogram_t *self,
@@ -449,7 +274,7 @@ static const char *prom_metric_sample_histogram_l_value_for_bucket(prom_metric_s
     PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_BUCKET_CLEANUP();
     return NULL;
   }
-  const char *ret = (const char *)prom_metric_formatter_dump(self->metric_formatter);
+  const char *ret = (const char *)prom_metric_formatter_dump_prefix(self->metric_formatter);
   PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_BUCKET_CLEANUP();
   return ret;
 }
@@ -488,15 +313,22 @@ static const char *prom_metric_sample_histogram_l_value_for_inf(prom_metric_samp
     PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_INF_CLEANUP()
     return NULL;
   }
-  const char *ret = (const char *)prom_metric_formatter_dump(self->metric_formatter);
+  const char *ret = (const char *)prom_metric_formatter_dump_prefix(self->metric_formatter);
   PROM_METRIC_SAMPLE_HISTOGRAM_L_VALUE_FOR_INF_CLEANUP()
   return ret;
 }
 
-static void prom_metric_sample_histogram_free_str_generic(void *gen) {
-  char *str = (char *)gen;
-  prom_free((void *)str);
-  str = NULL;
+static const char *prom_metric_sample_histogram_l_value_for_suffix(prom_metric_sample_histogram_t *self,
+                                                                   const char *name, const char *suffix,
+                                                                   size_t label_count, const char **label_keys,
+                                                                   const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+
+  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, suffix, label_count, label_keys, label_values);
+  if (r) return NULL;
+
+  return (const char *)prom_metric_formatter_dump_prefix(self->metric_formatter);
 }
 
 char *prom_metric_sample_histogram_bucket_to_str(double bucket) {
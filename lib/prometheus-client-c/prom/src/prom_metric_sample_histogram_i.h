@@ -25,10 +25,12 @@
 
 /**
  * @brief API PRIVATE Create a pointer to a prom_metric_sample_histogram_t
+ *
+ * @param shard_count The number of per-CPU shards of the bucket counters, or 0 for a single set of counters
  */
 prom_metric_sample_histogram_t *prom_metric_sample_histogram_new(const char *name, prom_histogram_buckets_t *buckets,
-                                                                 size_t label_count, const char **label_keys,
-                                                                 const char **label_vales);
+                                                                 size_t shard_count, size_t label_count,
+                                                                 const char **label_keys, const char **label_values);
 
 /**
  * @brief API PRIVATE Destroy a prom_metric_sample_histogram_t
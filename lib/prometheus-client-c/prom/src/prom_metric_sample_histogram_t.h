@@ -14,26 +14,42 @@
  * limitations under the License.
  */
 
-#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 
 // Public
 #include "prom_histogram_buckets.h"
 #include "prom_metric_sample_histogram.h"
 
 // Private
-#include "prom_map_t.h"
 #include "prom_metric_formatter_t.h"
+#include "prom_metric_sample_native_t.h"
+#include "prom_metric_shard_t.h"
 
 #ifndef PROM_METRIC_HISTOGRAM_SAMPLE_T_H
 #define PROM_METRIC_HISTOGRAM_SAMPLE_T_H
 
 struct prom_metric_sample_histogram {
-  prom_linked_list_t *l_value_list;
-  prom_map_t *l_values;
-  prom_map_t *samples;
-  prom_metric_formatter_t *metric_formatter;
-  prom_histogram_buckets_t *buckets;
-  pthread_rwlock_t *rwlock;
+  prom_histogram_buckets_t *buckets;         /**< upper bounds, sorted in increasing order */
+  size_t bucket_count;                       /**< number of upper bounds, excluding +Inf */
+  const char **prefixes;                     /**< interned "l_value " of each bucket, then of +Inf, count and sum */
+  size_t shard_count;                        /**< number of per-CPU shards, 1 if the histogram is not sharded */
+  size_t shard_stride;                       /**< counters per shard, padded to whole cache lines */
+  _Atomic uint64_t *bucket_counts;           /**< per shard: non-cumulative observations per bucket, then above all */
+  prom_metric_shard_t *sums;                 /**< per shard: sum of the observed values */
+  void *bucket_counts_storage;               /**< allocation backing bucket_counts */
+  void *sums_storage;                        /**< allocation backing sums */
+  size_t label_count;                        /**< number of label values, excluding le */
+  const char **label_values;                 /**< values of the metric labels, in label key order */
+  prom_metric_formatter_t *metric_formatter; /**< builds the prefixes at construction */
+  prom_metric_sample_native_t *native;       /**< sparse buckets of a native histogram, or NULL */
 };
 
+// Indexes of the +Inf, count and sum entries of prefixes, and the number of entries
+#define PROM_METRIC_SAMPLE_HISTOGRAM_INF_INDEX(self) ((self)->bucket_count)
+#define PROM_METRIC_SAMPLE_HISTOGRAM_COUNT_INDEX(self) ((self)->bucket_count + 1)
+#define PROM_METRIC_SAMPLE_HISTOGRAM_SUM_INDEX(self) ((self)->bucket_count + 2)
+#define PROM_METRIC_SAMPLE_HISTOGRAM_PREFIX_COUNT(self) ((self)->bucket_count + 3)
+
 #endif  // PROM_METRIC_HISTOGRAM_SAMPLE_T_H
@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "prom_metric_sample_t.h"
 #include "prom_metric_t.h"
 
@@ -26,8 +29,63 @@
  * @param type The type of metric sample
  * @param l_value The entire left value of the metric e.g metric_name{foo="bar"}
  * @param r_value A double representing the value of the sample
+ * @param label_count The number of label values
+ * @param label_values The label values the l_value was built from, copied into the sample
+ */
+prom_metric_sample_t *prom_metric_sample_new(prom_metric_type_t type, const char *l_value, double r_value,
+                                             size_t label_count, const char **label_values);
+
+/**
+ * @brief API PRIVATE Return a prom_metric_sample_t* whose additions land in per-CPU shards
+ *
+ * Each shard sits on its own cache line, so threads adding to the sample from different CPUs never contend. The shards
+ * are merged by prom_metric_sample_value at scrape time.
+ *
+ * @param type The type of metric sample
+ * @param l_value The entire left value of the metric e.g metric_name{foo="bar"}
+ * @param shard_count The number of shards, see prom_metric_shard_count
+ * @param label_count The number of label values
+ * @param label_values The label values the l_value was built from, copied into the sample
+ */
+prom_metric_sample_t *prom_metric_sample_new_sharded(prom_metric_type_t type, const char *l_value, size_t shard_count,
+                                                     size_t label_count, const char **label_values);
+
+/**
+ * @brief API PRIVATE Returns the interned exposition prefix of an l_value: the l_value followed by a space, or NULL
+ * upon failure. Release it with prom_intern_release.
+ */
+const char *prom_metric_sample_prefix_new(const char *l_value);
+
+/**
+ * @brief API PRIVATE Returns an array of interned copies of label_values, or NULL if label_count is 0 or upon failure
+ *
+ * Samples keep the values of their labels so that formats which encode labels separately from the metric name, such
+ * as protobuf, do not have to parse them back out of the l_value.
+ */
+const char **prom_metric_sample_label_values_copy(size_t label_count, const char **label_values);
+
+/**
+ * @brief API PRIVATE Frees a copy returned by prom_metric_sample_label_values_copy. NULL is ignored.
+ */
+void prom_metric_sample_label_values_free(size_t label_count, const char **label_values);
+
+/**
+ * @brief API PRIVATE Returns the value of the sample, merging its shards if it has any
+ */
+double prom_metric_sample_value(prom_metric_sample_t *self);
+
+/**
+ * @brief API PRIVATE Returns the exact value of a sample of an integer metric
  */
-prom_metric_sample_t *prom_metric_sample_new(prom_metric_type_t type, const char *l_value, double r_value);
+uint64_t prom_metric_sample_value_u64(prom_metric_sample_t *self);
+
+/**
+ * @brief API PRIVATE Sets the value of a counter or gauge sample, as prom_metric_sample_set does for gauges
+ *
+ * @return Non-zero integer value upon failure, including when the sample is sharded or the value is negative and the
+ * sample belongs to an integer metric
+ */
+int prom_metric_sample_store(prom_metric_sample_t *self, double r_value);
 
 /**
  * @brief API PRIVATE Destroy the prom_metric_sample**
@@ -46,4 +104,71 @@ int prom_metric_sample_destroy_generic(void *);
  */
 void prom_metric_sample_free_generic(void *gen);
 
+/**
+ * @brief API PRIVATE Marks the start of a batch of sample updates that must be observed together.
+ *
+ * Batches may run concurrently from several threads. Each batch bumps the publication sequence when it starts and when
+ * it ends, and is counted as an active writer in between.
+ */
+void prom_metric_sample_publish_begin(void);
+
+/**
+ * @brief API PRIVATE Marks the end of a batch started with prom_metric_sample_publish_begin.
+ */
+void prom_metric_sample_publish_end(void);
+
+/**
+ * @brief API PRIVATE Waits for in-flight batches to finish and returns the publication sequence to validate against.
+ *
+ * The wait is bounded; if writers keep the sequence busy the current value is returned anyway.
+ */
+uint64_t prom_metric_sample_read_begin(void);
+
+/**
+ * @brief API PRIVATE Returns true if no batch started or was in flight since prom_metric_sample_read_begin returned seq.
+ */
+bool prom_metric_sample_read_validate(uint64_t seq);
+
+/**
+ * @brief API PRIVATE Advances the generation counter shared by every sample.
+ *
+ * Called whenever a sample value changes or a sample is created, and by registries whenever their set of metrics
+ * changes, so that any render taken at an older generation is known to be stale.
+ */
+void prom_metric_sample_generation_bump(void);
+
+/**
+ * @brief API PRIVATE Advances the generation counter of one shard.
+ *
+ * Sharded samples bump the counter of the shard they updated instead of the shared one, which would otherwise bring
+ * back the contention the shards avoid. prom_metric_sample_generation accounts for every shard.
+ *
+ * @param shard The shard that was updated, lower than PROM_METRIC_SHARD_MAX
+ */
+void prom_metric_sample_generation_bump_shard(size_t shard);
+
+/**
+ * @brief API PRIVATE Returns the current value of the generation counter shared by every sample, plus the counters of
+ * every shard.
+ */
+uint64_t prom_metric_sample_generation(void);
+
+/**
+ * @brief API PRIVATE Advances the lifecycle clock to the current monotonic time, in seconds, and returns it.
+ *
+ * Updates stamp their sample with the clock as of the last sweep, so the idle time of a sample is only known to the
+ * resolution of the sweep interval. The clock never reads 0, which marks the samples no sweep has seen yet.
+ */
+uint32_t prom_metric_sample_clock_advance(void);
+
+/**
+ * @brief API PRIVATE Returns the lifecycle clock as set by the last call to prom_metric_sample_clock_advance, or 0.
+ */
+uint32_t prom_metric_sample_clock(void);
+
+/**
+ * @brief API PRIVATE Stamps a sample as updated, for metrics whose idle samples are evicted.
+ */
+void prom_metric_sample_touch(prom_metric_sample_t *self);
+
 #endif  // PROM_METRIC_SAMPLE_I_H
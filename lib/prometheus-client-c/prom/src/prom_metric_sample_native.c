@@ -0,0 +1,176 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_errors.h"
+#include "prom_log.h"
+#include "prom_metric_sample_native_i.h"
+
+// Buckets allocated for a sign on its first observation
+#define PROM_METRIC_SAMPLE_NATIVE_INITIAL_CAPACITY 8
+
+prom_metric_sample_native_t *prom_metric_sample_native_new(int schema, size_t max_bucket_count) {
+  prom_metric_sample_native_t *self = (prom_metric_sample_native_t *)prom_malloc(sizeof(prom_metric_sample_native_t));
+  if (self == NULL) return NULL;
+
+  memset(self, 0, sizeof(*self));
+  if (pthread_mutex_init(&self->lock, NULL)) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_INIT_ERROR);
+    prom_free(self);
+    return NULL;
+  }
+  self->schema = schema;
+  self->max_bucket_count = max_bucket_count;
+  return self;
+}
+
+int prom_metric_sample_native_destroy(prom_metric_sample_native_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+
+  prom_free(self->positive.indexes);
+  prom_free(self->positive.counts);
+  prom_free(self->negative.indexes);
+  prom_free(self->negative.counts);
+  int r = pthread_mutex_destroy(&self->lock);
+  prom_free(self);
+  return r;
+}
+
+/**
+ * @brief API PRIVATE Returns the index of the bucket of a positive value above the zero threshold
+ *
+ * frexp splits the value into a fraction in [0.5, 1) and a power of two, so that powers of two, which are bucket
+ * boundaries at every schema, are indexed exactly.
+ */
+static int32_t prom_metric_sample_native_index(double value, int schema) {
+  if (value > DBL_MAX) return prom_metric_sample_native_index(DBL_MAX, schema) + 1;
+
+  int exp = 0;
+  double frac = frexp(value, &exp);
+  if (schema > 0) {
+    int64_t scale = (int64_t)1 << schema;
+    if (frac == 0.5) return (int32_t)(((int64_t)exp - 1) * scale);
+    return (int32_t)((int64_t)exp * scale + (int64_t)ceil(log2(frac) * (double)scale));
+  }
+
+  // Each bucket spans 2^-schema powers of two; round the exponent up to the next multiple
+  int64_t index = frac == 0.5 ? (int64_t)exp - 1 : (int64_t)exp;
+  int64_t span = (int64_t)1 << -schema;
+  return (int32_t)(index >= 0 ? (index + span - 1) / span : -(-index / span));
+}
+
+/**
+ * @brief API PRIVATE Counts one observation in the bucket of the given index, inserting it if it holds none yet
+ */
+static int prom_metric_sample_native_buckets_add(prom_metric_sample_native_buckets_t *buckets, int32_t index) {
+  size_t low = 0;
+  size_t high = buckets->count;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (buckets->indexes[mid] < index) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low < buckets->count && buckets->indexes[low] == index) {
+    buckets->counts[low]++;
+    return 0;
+  }
+
+  if (buckets->count == buckets->capacity) {
+    size_t capacity = buckets->capacity == 0 ? PROM_METRIC_SAMPLE_NATIVE_INITIAL_CAPACITY : buckets->capacity * 2;
+    int32_t *indexes = (int32_t *)prom_realloc(buckets->indexes, sizeof(int32_t) * capacity);
+    if (indexes == NULL) return 1;
+    buckets->indexes = indexes;
+    uint64_t *counts = (uint64_t *)prom_realloc(buckets->counts, sizeof(uint64_t) * capacity);
+    if (counts == NULL) return 1;
+    buckets->counts = counts;
+    buckets->capacity = capacity;
+  }
+  memmove(&buckets->indexes[low + 1], &buckets->indexes[low], sizeof(int32_t) * (buckets->count - low));
+  memmove(&buckets->counts[low + 1], &buckets->counts[low], sizeof(uint64_t) * (buckets->count - low));
+  buckets->indexes[low] = index;
+  buckets->counts[low] = 1;
+  buckets->count++;
+  return 0;
+}
+
+/**
+ * @brief API PRIVATE Merges every bucket with its neighbour, as the schema is lowered by one
+ *
+ * Bucket i becomes bucket ceil(i / 2) of the doubled base, so buckets 2j - 1 and 2j merge into j. The mapping keeps
+ * the order, so the buckets are merged in place.
+ */
+static void prom_metric_sample_native_buckets_halve(prom_metric_sample_native_buckets_t *buckets) {
+  size_t merged = 0;
+  for (size_t i = 0; i < buckets->count; i++) {
+    int32_t index = buckets->indexes[i];
+    index = index >= 0 ? (int32_t)(((int64_t)index + 1) / 2) : -(-index / 2);
+    if (merged > 0 && buckets->indexes[merged - 1] == index) {
+      buckets->counts[merged - 1] += buckets->counts[i];
+      continue;
+    }
+    buckets->indexes[merged] = index;
+    buckets->counts[merged] = buckets->counts[i];
+    merged++;
+  }
+  buckets->count = merged;
+}
+
+int prom_metric_sample_native_observe(prom_metric_sample_native_t *self, double value) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  int r = pthread_mutex_lock(&self->lock);
+  if (r) {
+    PROM_LOG(PROM_PTHREAD_MUTEX_LOCK_ERROR);
+    return r;
+  }
+
+  // NaN is counted and summed like the other client libraries do, but has no bucket
+  double magnitude = fabs(value);
+  if (magnitude <= PROM_METRIC_SAMPLE_NATIVE_ZERO_THRESHOLD) {
+    self->zero_count++;
+  } else if (!isnan(value)) {
+    prom_metric_sample_native_buckets_t *buckets = value > 0 ? &self->positive : &self->negative;
+    r = prom_metric_sample_native_buckets_add(buckets, prom_metric_sample_native_index(magnitude, self->schema));
+    while (r == 0 && self->positive.count + self->negative.count > self->max_bucket_count &&
+           self->schema > PROM_METRIC_SAMPLE_NATIVE_MIN_SCHEMA) {
+      prom_metric_sample_native_buckets_halve(&self->positive);
+      prom_metric_sample_native_buckets_halve(&self->negative);
+      self->schema--;
+    }
+  }
+  if (r == 0) {
+    self->count++;
+    self->sum += value;
+  }
+
+  pthread_mutex_unlock(&self->lock);
+  return r;
+}
@@ -0,0 +1,43 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_METRIC_SAMPLE_NATIVE_I_H
+#define PROM_METRIC_SAMPLE_NATIVE_I_H
+
+#include <stddef.h>
+
+// Private
+#include "prom_metric_sample_native_t.h"
+
+/**
+ * @brief API PRIVATE Create a pointer to a prom_metric_sample_native_t
+ *
+ * @param schema The initial schema, at most PROM_METRIC_SAMPLE_NATIVE_MAX_SCHEMA
+ * @param max_bucket_count The most populated buckets kept before the schema is lowered
+ */
+prom_metric_sample_native_t *prom_metric_sample_native_new(int schema, size_t max_bucket_count);
+
+/**
+ * @brief API PRIVATE Destroy a prom_metric_sample_native_t
+ */
+int prom_metric_sample_native_destroy(prom_metric_sample_native_t *self);
+
+/**
+ * @brief API PRIVATE Counts value in its bucket, lowering the schema if the buckets no longer fit
+ */
+int prom_metric_sample_native_observe(prom_metric_sample_native_t *self, double value);
+
+#endif  // PROM_METRIC_SAMPLE_NATIVE_I_H
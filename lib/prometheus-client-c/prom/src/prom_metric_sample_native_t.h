@@ -0,0 +1,67 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_METRIC_SAMPLE_NATIVE_T_H
+#define PROM_METRIC_SAMPLE_NATIVE_T_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief API PRIVATE Lowest schema a native histogram is reduced to, with buckets growing 65536-fold
+ */
+#define PROM_METRIC_SAMPLE_NATIVE_MIN_SCHEMA -4
+
+/**
+ * @brief API PRIVATE Highest schema of a native histogram, with buckets growing by about 0.27%
+ */
+#define PROM_METRIC_SAMPLE_NATIVE_MAX_SCHEMA 8
+
+/**
+ * @brief API PRIVATE Largest absolute value counted in the zero bucket, 2^-128 as in the other client libraries
+ */
+#define PROM_METRIC_SAMPLE_NATIVE_ZERO_THRESHOLD 2.938735877055719e-39
+
+/**
+ * @brief API PRIVATE The populated buckets of one sign, sorted by index
+ */
+typedef struct prom_metric_sample_native_buckets {
+  int32_t *indexes; /**< index of every populated bucket, in increasing order */
+  uint64_t *counts; /**< observations of every populated bucket */
+  size_t count;     /**< number of populated buckets */
+  size_t capacity;  /**< number of entries allocated in indexes and counts */
+} prom_metric_sample_native_buckets_t;
+
+/**
+ * @brief API PRIVATE The sparse exponential buckets of one series of a native histogram
+ *
+ * A value v falls in the bucket of index i such that base^(i-1) < |v| <= base^i, with base = 2^(2^-schema). Only the
+ * buckets that hold observations are stored. When there are more than max_bucket_count of them, the schema is lowered
+ * by one, which merges every bucket with its neighbour, until they fit again.
+ */
+typedef struct prom_metric_sample_native {
+  pthread_mutex_t lock;                         /**< guards every field below */
+  int schema;                                   /**< current resolution, lowered as buckets are merged */
+  size_t max_bucket_count;                      /**< most populated buckets kept before the schema is lowered */
+  uint64_t count;                               /**< number of observations, NaN included */
+  double sum;                                   /**< sum of the observed values */
+  uint64_t zero_count;                          /**< observations of absolute value up to the threshold */
+  prom_metric_sample_native_buckets_t positive; /**< buckets of positive values */
+  prom_metric_sample_native_buckets_t negative; /**< buckets of negative values, indexed by their absolute value */
+} prom_metric_sample_native_t;
+
+#endif  // PROM_METRIC_SAMPLE_NATIVE_T_H
@@ -0,0 +1,260 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Public
+#include "prom_alloc.h"
+#include "prom_summary.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_errors.h"
+#include "prom_log.h"
+#include "prom_intern_i.h"
+#include "prom_metric_formatter_i.h"
+#include "prom_metric_sample_i.h"
+#include "prom_metric_sample_summary_i.h"
+#include "prom_metric_shard_i.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Static Declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const char *prom_metric_sample_summary_l_value_for_quantile(prom_metric_sample_summary_t *self,
+                                                                   const char *name, size_t label_count,
+                                                                   const char **label_keys, const char **label_values,
+                                                                   double quantile);
+
+static const char *prom_metric_sample_summary_l_value_for_suffix(prom_metric_sample_summary_t *self, const char *name,
+                                                                 const char *suffix, size_t label_count,
+                                                                 const char **label_keys, const char **label_values);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// End static declarations
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+prom_metric_sample_summary_t *prom_metric_sample_summary_new(const char *name, prom_summary_quantiles_t *quantiles,
+                                                             size_t label_count, const char **label_keys,
+                                                             const char **label_values) {
+  // Allocate and set self; the bins are part of the struct, so a series never allocates again
+  prom_metric_sample_summary_t *self =
+      (prom_metric_sample_summary_t *)prom_malloc(sizeof(prom_metric_sample_summary_t));
+  if (self == NULL) return NULL;
+
+  self->quantiles = quantiles;
+  self->quantile_count = prom_summary_quantiles_count(quantiles);
+  self->prefixes = NULL;
+  double accuracy = PROM_METRIC_SAMPLE_SUMMARY_RELATIVE_ACCURACY;
+  self->gamma = (1.0 + accuracy) / (1.0 - accuracy);
+  self->log_gamma = log(self->gamma);
+  self->min_key = (int)ceil(log(PROM_METRIC_SAMPLE_SUMMARY_MIN_VALUE) / self->log_gamma);
+  atomic_init(&self->zero_count, 0);
+  for (size_t i = 0; i < PROM_METRIC_SAMPLE_SUMMARY_BIN_COUNT; i++) atomic_init(&self->bins[i], 0);
+  atomic_init(&self->sum, 0.0);
+  self->metric_formatter = NULL;
+  self->label_count = label_count;
+  self->label_values = prom_metric_sample_label_values_copy(label_count, label_values);
+  if (label_count > 0 && self->label_values == NULL) {
+    prom_metric_sample_summary_destroy(self);
+    return NULL;
+  }
+
+  // Allocate and set the metric formatter
+  self->metric_formatter = prom_metric_formatter_new();
+  if (self->metric_formatter == NULL) {
+    prom_metric_sample_summary_destroy(self);
+    return NULL;
+  }
+
+  // Render every prefix once: the quantiles (with their quantile label), then count and sum
+  size_t prefix_count = PROM_METRIC_SAMPLE_SUMMARY_PREFIX_COUNT(self);
+  self->prefixes = (const char **)prom_malloc(sizeof(const char *) * prefix_count);
+  if (self->prefixes == NULL) {
+    prom_metric_sample_summary_destroy(self);
+    return NULL;
+  }
+  for (size_t i = 0; i < prefix_count; i++) self->prefixes[i] = NULL;
+
+  for (size_t i = 0; i < self->quantile_count; i++) {
+    self->prefixes[i] = prom_metric_sample_summary_l_value_for_quantile(self, name, label_count, label_keys,
+                                                                        label_values, quantiles->quantiles[i]);
+  }
+  self->prefixes[PROM_METRIC_SAMPLE_SUMMARY_COUNT_INDEX(self)] =
+      prom_metric_sample_summary_l_value_for_suffix(self, name, "count", label_count, label_keys, label_values);
+  self->prefixes[PROM_METRIC_SAMPLE_SUMMARY_SUM_INDEX(self)] =
+      prom_metric_sample_summary_l_value_for_suffix(self, name, "sum", label_count, label_keys, label_values);
+  for (size_t i = 0; i < prefix_count; i++) {
+    if (self->prefixes[i] == NULL) {
+      prom_metric_sample_summary_destroy(self);
+      return NULL;
+    }
+  }
+
+  // A new series changes the exposition even before its first observation
+  prom_metric_sample_generation_bump();
+  return self;
+}
+
+int prom_metric_sample_summary_destroy(prom_metric_sample_summary_t *self) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+  int ret = 0;
+
+  if (self == NULL) return 0;
+
+  if (self->prefixes != NULL) {
+    for (size_t i = 0; i < PROM_METRIC_SAMPLE_SUMMARY_PREFIX_COUNT(self); i++) {
+      prom_intern_release(self->prefixes[i]);
+      self->prefixes[i] = NULL;
+    }
+    prom_free(self->prefixes);
+    self->prefixes = NULL;
+  }
+
+  prom_metric_sample_label_values_free(self->label_count, self->label_values);
+  self->label_values = NULL;
+
+  if (self->metric_formatter != NULL) {
+    r = prom_metric_formatter_destroy(self->metric_formatter);
+    if (r) ret = r;
+    self->metric_formatter = NULL;
+  }
+
+  prom_free(self);
+  self = NULL;
+  return ret;
+}
+
+int prom_metric_sample_summary_destroy_generic(void *gen) {
+  int r = 0;
+
+  prom_metric_sample_summary_t *self = (prom_metric_sample_summary_t *)gen;
+  r = prom_metric_sample_summary_destroy(self);
+  self = NULL;
+  return r;
+}
+
+void prom_metric_sample_summary_free_generic(void *gen) {
+  prom_metric_sample_summary_t *self = (prom_metric_sample_summary_t *)gen;
+  prom_metric_sample_summary_destroy(self);
+}
+
+int prom_metric_sample_summary_observe(prom_metric_sample_summary_t *self, double value) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (isnan(value)) return 1;
+
+  if (value < PROM_METRIC_SAMPLE_SUMMARY_MIN_VALUE) {
+    atomic_fetch_add_explicit(&self->zero_count, 1, memory_order_relaxed);
+  } else {
+    double key = ceil(log(value) / self->log_gamma) - self->min_key;
+    size_t bin = 0;
+    if (key >= PROM_METRIC_SAMPLE_SUMMARY_BIN_COUNT) {
+      bin = PROM_METRIC_SAMPLE_SUMMARY_BIN_COUNT - 1;
+    } else if (key > 0) {
+      bin = (size_t)key;
+    }
+    atomic_fetch_add_explicit(&self->bins[bin], 1, memory_order_relaxed);
+  }
+
+  double old = atomic_load_explicit(&self->sum, memory_order_relaxed);
+  while (!atomic_compare_exchange_weak_explicit(&self->sum, &old, old + value, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+  }
+
+  // Bump the generation of the calling CPU rather than the shared one, which every observer would contend on
+  prom_metric_sample_generation_bump_shard(prom_metric_shard_index(PROM_METRIC_SHARD_MAX));
+  return 0;
+}
+
+uint64_t prom_metric_sample_summary_count(prom_metric_sample_summary_t *self) {
+  PROM_ASSERT(self != NULL);
+  uint64_t count = atomic_load_explicit(&self->zero_count, memory_order_relaxed);
+  for (size_t i = 0; i < PROM_METRIC_SAMPLE_SUMMARY_BIN_COUNT; i++) {
+    count += atomic_load_explicit(&self->bins[i], memory_order_relaxed);
+  }
+  return count;
+}
+
+double prom_metric_sample_summary_quantile(prom_metric_sample_summary_t *self, double quantile, uint64_t count) {
+  PROM_ASSERT(self != NULL);
+  if (count == 0) return NAN;
+
+  // The quantile is the value of rank quantile * (count - 1), counting from 0 in increasing order
+  double rank = quantile * (double)(count - 1);
+  uint64_t seen = atomic_load_explicit(&self->zero_count, memory_order_relaxed);
+  if ((double)seen > rank) return 0.0;
+
+  size_t last = 0;
+  for (size_t i = 0; i < PROM_METRIC_SAMPLE_SUMMARY_BIN_COUNT; i++) {
+    uint64_t bin = atomic_load_explicit(&self->bins[i], memory_order_relaxed);
+    if (bin == 0) continue;
+    last = i;
+    seen += bin;
+    if ((double)seen > rank) break;
+  }
+  // Observations landing after count was read may leave the rank unreached; the highest bin seen is then the answer.
+  // The estimate is the point of the bin equally distant, in relative terms, from both of its bounds.
+  return 2.0 * pow(self->gamma, (double)((int)last + self->min_key)) / (self->gamma + 1.0);
+}
+
+static const char *prom_metric_sample_summary_l_value_for_quantile(prom_metric_sample_summary_t *self,
+                                                                   const char *name, size_t label_count,
+                                                                   const char **label_keys, const char **label_values,
+                                                                   double quantile) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+
+  // Make new arrays to hold the label keys and values with the quantile label appended
+  const char **new_keys = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
+  const char **new_values = (const char **)prom_malloc((label_count + 1) * sizeof(char *));
+  if (new_keys == NULL || new_values == NULL) {
+    prom_free(new_keys);
+    prom_free(new_values);
+    return NULL;
+  }
+  for (size_t i = 0; i < label_count; i++) {
+    new_keys[i] = label_keys[i];
+    new_values[i] = label_values[i];
+  }
+  char quantile_str[32];
+  snprintf(quantile_str, sizeof(quantile_str), "%g", quantile);
+  new_keys[label_count] = "quantile";
+  new_values[label_count] = quantile_str;
+
+  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, NULL, label_count + 1, new_keys, new_values);
+  prom_free(new_keys);
+  prom_free(new_values);
+  if (r) return NULL;
+
+  return (const char *)prom_metric_formatter_dump_prefix(self->metric_formatter);
+}
+
+static const char *prom_metric_sample_summary_l_value_for_suffix(prom_metric_sample_summary_t *self, const char *name,
+                                                                 const char *suffix, size_t label_count,
+                                                                 const char **label_keys, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+
+  r = prom_metric_formatter_load_l_value(self->metric_formatter, name, suffix, label_count, label_keys, label_values);
+  if (r) return NULL;
+
+  return (const char *)prom_metric_formatter_dump_prefix(self->metric_formatter);
+}
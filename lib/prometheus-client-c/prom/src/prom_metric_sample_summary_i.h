@@ -0,0 +1,65 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+// Public
+#include "prom_metric_sample_summary.h"
+
+// Private
+#include "prom_metric_sample_summary_t.h"
+
+#ifndef PROM_METRIC_SAMPLE_SUMMARY_I_H
+#define PROM_METRIC_SAMPLE_SUMMARY_I_H
+
+/**
+ * @brief API PRIVATE Create a pointer to a prom_metric_sample_summary_t
+ */
+prom_metric_sample_summary_t *prom_metric_sample_summary_new(const char *name, prom_summary_quantiles_t *quantiles,
+                                                             size_t label_count, const char **label_keys,
+                                                             const char **label_values);
+
+/**
+ * @brief API PRIVATE Destroy a prom_metric_sample_summary_t
+ */
+int prom_metric_sample_summary_destroy(prom_metric_sample_summary_t *self);
+
+/**
+ * @brief API PRIVATE Destroy a void pointer that is cast to a prom_metric_sample_summary_t*
+ */
+int prom_metric_sample_summary_destroy_generic(void *gen);
+
+/**
+ * @brief API PRIVATE Destroy a void pointer that is cast to a prom_metric_sample_summary_t*. Discards any errors.
+ */
+void prom_metric_sample_summary_free_generic(void *gen);
+
+/**
+ * @brief API PRIVATE Returns the number of values observed by the sample
+ */
+uint64_t prom_metric_sample_summary_count(prom_metric_sample_summary_t *self);
+
+/**
+ * @brief API PRIVATE Estimates a quantile of the values observed by the sample
+ *
+ * @param quantile The quantile to estimate, between 0 and 1
+ * @param count The number of observations, as returned by prom_metric_sample_summary_count
+ * @return The estimate, within PROM_METRIC_SAMPLE_SUMMARY_RELATIVE_ACCURACY of the true quantile, or NaN if the sample
+ *         has no observation
+ */
+double prom_metric_sample_summary_quantile(prom_metric_sample_summary_t *self, double quantile, uint64_t count);
+
+#endif  // PROM_METRIC_SAMPLE_SUMMARY_I_H
@@ -0,0 +1,77 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Public
+#include "prom_metric_sample_summary.h"
+#include "prom_summary_quantiles.h"
+
+// Private
+#include "prom_metric_formatter_t.h"
+
+#ifndef PROM_METRIC_SAMPLE_SUMMARY_T_H
+#define PROM_METRIC_SAMPLE_SUMMARY_T_H
+
+/**
+ * @brief API PRIVATE Relative error of the quantiles reported by summaries
+ */
+#define PROM_METRIC_SAMPLE_SUMMARY_RELATIVE_ACCURACY 0.01
+
+/**
+ * @brief API PRIVATE Number of logarithmic bins of a summary sample
+ *
+ * With a relative accuracy of 1%, 2048 bins starting at PROM_METRIC_SAMPLE_SUMMARY_MIN_VALUE cover values up to about
+ * 6e8. Larger values are counted in the last bin.
+ */
+#define PROM_METRIC_SAMPLE_SUMMARY_BIN_COUNT 2048
+
+/**
+ * @brief API PRIVATE Smallest value given a bin of its own; smaller values, zero and negative values included, are
+ * reported as 0
+ */
+#define PROM_METRIC_SAMPLE_SUMMARY_MIN_VALUE 1e-9
+
+/**
+ * @brief API PRIVATE A DDSketch of the values observed by one series of a summary
+ *
+ * Each observation falls in the bin of index ceil(log(value) / log(gamma)), which bounds the relative error of every
+ * quantile by PROM_METRIC_SAMPLE_SUMMARY_RELATIVE_ACCURACY. Memory is fixed at construction, inserting is a single
+ * atomic increment, and two sketches with the same parameters merge by adding their bins.
+ */
+struct prom_metric_sample_summary {
+  prom_summary_quantiles_t *quantiles;                         /**< quantiles reported by the sample */
+  size_t quantile_count;                                       /**< number of quantiles */
+  const char **prefixes;                                       /**< interned "l_value " of each quantile, then count and sum */
+  double gamma;                                                /**< ratio between the upper bounds of adjacent bins */
+  double log_gamma;                                            /**< log(gamma) */
+  int min_key;                                                 /**< key of the smallest bin */
+  _Atomic uint64_t zero_count;                                 /**< observations below the smallest bin */
+  _Atomic uint64_t bins[PROM_METRIC_SAMPLE_SUMMARY_BIN_COUNT]; /**< observations per logarithmic bin */
+  _Atomic double sum;                                          /**< sum of the observed values */
+  size_t label_count;                                          /**< number of label values, excluding quantile */
+  const char **label_values;                                   /**< values of the metric labels, in label key order */
+  prom_metric_formatter_t *metric_formatter;                   /**< builds the prefixes at construction */
+};
+
+// Indexes of the count and sum entries of prefixes, and the number of entries
+#define PROM_METRIC_SAMPLE_SUMMARY_COUNT_INDEX(self) ((self)->quantile_count)
+#define PROM_METRIC_SAMPLE_SUMMARY_SUM_INDEX(self) ((self)->quantile_count + 1)
+#define PROM_METRIC_SAMPLE_SUMMARY_PREFIX_COUNT(self) ((self)->quantile_count + 2)
+
+#endif  // PROM_METRIC_SAMPLE_SUMMARY_T_H
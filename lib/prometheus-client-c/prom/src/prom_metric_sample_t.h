@@ -17,13 +17,28 @@
 #ifndef PROM_METRIC_SAMPLE_T_H
 #define PROM_METRIC_SAMPLE_T_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #include "prom_metric_sample.h"
+#include "prom_metric_shard_t.h"
 #include "prom_metric_t.h"
 
 struct prom_metric_sample {
-  prom_metric_type_t type; /**< type is the metric type for the sample */
-  char *l_value;           /**< l_value is the full metric name and label set represeted as a string */
-  _Atomic double r_value;  /**< r_value is the value of the metric sample */
+  prom_metric_type_t type;     /**< type is the metric type for the sample */
+  const char *prefix;          /**< prefix is the interned l_value, the full metric name and label set, and a space */
+  _Atomic double r_value;      /**< r_value is the value of the metric sample, unless it is stored densely */
+  _Atomic double *value;       /**< value points to r_value, or to the slot of the sample in its metric's dense storage */
+  _Atomic uint64_t u_value;    /**< u_value is the value of the sample if integer is set, and r_value is unused */
+  bool integer;                /**< integer is set for the samples of an integer metric */
+  size_t shard_count;          /**< shard_count is the number of shards, or 0 if the sample is not sharded */
+  prom_metric_shard_t *shards; /**< shards are per-CPU slots added to r_value when the sample is read */
+  void *shard_storage;         /**< shard_storage is the allocation backing shards */
+  size_t label_count;          /**< label_count is the number of label values */
+  const char **label_values;   /**< label_values are the values of the metric labels, in label key order */
+  _Atomic uint32_t touched;    /**< touched is the lifecycle clock at the last update, or 0 if no sweep has seen it */
+  bool pinned;                 /**< pinned is set under the metric's write lock once a handle was handed out */
 };
 
 #endif  // PROM_METRIC_SAMPLE_T_H
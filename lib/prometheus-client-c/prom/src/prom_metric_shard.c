@@ -0,0 +1,67 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+
+// Public
+#include "prom_alloc.h"
+
+// Private
+#include "prom_metric_shard_i.h"
+
+static _Atomic size_t prom_metric_shard_count_cache = ATOMIC_VAR_INIT(0);
+static _Atomic size_t prom_metric_shard_next_thread = ATOMIC_VAR_INIT(0);
+static _Thread_local size_t prom_metric_shard_thread = SIZE_MAX;
+
+size_t prom_metric_shard_count(void) {
+  size_t count = atomic_load_explicit(&prom_metric_shard_count_cache, memory_order_relaxed);
+  if (count != 0) return count;
+
+  long cpus = sysconf(_SC_NPROCESSORS_CONF);
+  count = cpus < 1 ? 1 : (size_t)cpus;
+  if (count > PROM_METRIC_SHARD_MAX) count = PROM_METRIC_SHARD_MAX;
+  atomic_store_explicit(&prom_metric_shard_count_cache, count, memory_order_relaxed);
+  return count;
+}
+
+size_t prom_metric_shard_index(size_t shard_count) {
+  if (shard_count <= 1) return 0;
+
+  int cpu = sched_getcpu();
+  if (cpu >= 0) return (size_t)cpu % shard_count;
+
+  if (prom_metric_shard_thread == SIZE_MAX) {
+    prom_metric_shard_thread = atomic_fetch_add_explicit(&prom_metric_shard_next_thread, 1, memory_order_relaxed);
+  }
+  return prom_metric_shard_thread % shard_count;
+}
+
+void *prom_metric_shard_alloc(size_t size, void **storage) {
+  // Over-allocate by one line so that the block can start on a line boundary whatever prom_malloc returns
+  char *raw = (char *)prom_malloc(size + PROM_METRIC_SHARD_CACHE_LINE);
+  *storage = raw;
+  if (raw == NULL) return NULL;
+
+  uintptr_t aligned = ((uintptr_t)raw + PROM_METRIC_SHARD_CACHE_LINE - 1);
+  aligned &= ~(uintptr_t)(PROM_METRIC_SHARD_CACHE_LINE - 1);
+  memset((void *)aligned, 0, size);
+  return (void *)aligned;
+}
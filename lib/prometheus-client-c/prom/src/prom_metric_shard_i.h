@@ -0,0 +1,50 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stddef.h>
+
+#include "prom_metric_shard_t.h"
+
+#ifndef PROM_METRIC_SHARD_I_H
+#define PROM_METRIC_SHARD_I_H
+
+/**
+ * @brief API PRIVATE Returns the number of shards to give a sharded sample: one per configured CPU, at most
+ * PROM_METRIC_SHARD_MAX
+ */
+size_t prom_metric_shard_count(void);
+
+/**
+ * @brief API PRIVATE Returns the shard the calling thread should update
+ *
+ * The shard follows the CPU the thread runs on, as reported by sched_getcpu. Where that is unavailable, each thread is
+ * given its own shard in round-robin order on first use.
+ *
+ * @param shard_count The number of shards of the sample being updated
+ * @return An index lower than shard_count
+ */
+size_t prom_metric_shard_index(size_t shard_count);
+
+/**
+ * @brief API PRIVATE Allocates a zeroed block aligned on a cache line
+ *
+ * @param size The size of the block in bytes
+ * @param storage Receives the pointer to pass to prom_free once the block is no longer needed
+ * @return The aligned block, or NULL upon failure
+ */
+void *prom_metric_shard_alloc(size_t size, void **storage);
+
+#endif  // PROM_METRIC_SHARD_I_H
@@ -0,0 +1,39 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROM_METRIC_SHARD_T_H
+#define PROM_METRIC_SHARD_T_H
+
+#include <stdatomic.h>
+
+/**
+ * @brief API PRIVATE Size in bytes of the cache lines shard slots are padded to
+ */
+#define PROM_METRIC_SHARD_CACHE_LINE 64
+
+/**
+ * @brief API PRIVATE Upper bound on the number of shards of a sharded sample
+ */
+#define PROM_METRIC_SHARD_MAX 64
+
+/**
+ * @brief API PRIVATE A value slot of a sharded sample, alone on its cache line
+ */
+typedef struct prom_metric_shard {
+  _Alignas(PROM_METRIC_SHARD_CACHE_LINE) _Atomic double value; /**< value accumulated by the threads of this shard */
+} prom_metric_shard_t;
+
+#endif  // PROM_METRIC_SHARD_T_H
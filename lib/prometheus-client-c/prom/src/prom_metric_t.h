@@ -18,14 +18,19 @@
 #define PROM_METRIC_T_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 
 // Public
 #include "prom_histogram_buckets.h"
 #include "prom_metric.h"
+#include "prom_metric_sample.h"
+#include "prom_summary_quantiles.h"
 
 // Private
 #include "prom_map_i.h"
 #include "prom_map_t.h"
+#include "prom_metric_dense_t.h"
 #include "prom_metric_formatter_t.h"
 
 /**
@@ -48,10 +53,26 @@ struct prom_metric {
   const char *help;                   /**< help             The help output for the metric */
   prom_map_t *samples;                /**< samples          Map comprised of samples for the given metric */
   prom_histogram_buckets_t *buckets;  /**< buckets          Array of histogram bucket upper bound values */
+  prom_summary_quantiles_t *quantiles; /**< quantiles        Array of summary quantiles */
   size_t label_key_count;             /**< label_keys_count The count of labe_keys*/
   prom_metric_formatter_t *formatter; /**< formatter        The metric formatter  */
   pthread_rwlock_t *rwlock;           /**< rwlock           Required for locking on certain non-atomic operations */
   const char **label_keys;            /**< labels           Array comprised of const char **/
+  _Atomic(prom_metric_sample_t *) default_sample; /**< default_sample The unlabelled sample, once resolved */
+  size_t shard_count;                 /**< shard_count      Per-CPU shards of each sample, or 0 if not sharded */
+  prom_metric_dense_t *dense;         /**< dense            Contiguous values of the samples, or NULL */
+  size_t removals;                    /**< removals         Number of samples removed so far, guarded by rwlock */
+  bool integer;                       /**< integer          Whether the samples hold exact 64-bit integers */
+  unsigned int ttl;                   /**< ttl              Seconds a sample may go without update, 0 for no limit */
+  size_t max_series;                  /**< max_series       Most samples the metric holds, 0 for no limit */
+  size_t refused;                     /**< refused          Number of samples refused for max_series, guarded by rwlock */
+  atomic_uint epoch;                  /**< epoch            Grace period of updates through label values */
+  atomic_size_t updaters[2];          /**< updaters         Updates through label values in progress, by epoch parity */
+  const char *header;                 /**< header           Prebuilt HELP and TYPE lines of the text format, or NULL */
+  size_t header_len;                  /**< header_len       Length of header */
+  bool native;                        /**< native           Whether the histogram keeps sparse exponential buckets */
+  int native_schema;                  /**< native_schema    Initial schema of the native histogram samples */
+  size_t native_max_buckets;          /**< native_max_buckets Most buckets a native sample keeps before merging */
 };
 
 #endif  // PROM_METRIC_T_H
@@ -0,0 +1,55 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Private
+#include "prom_name_i.h"
+
+// Character classes of the metric and label name grammars, one table lookup per character
+#define PROM_NAME_METRIC_FIRST 0x01
+#define PROM_NAME_METRIC_REST 0x02
+#define PROM_NAME_LABEL_FIRST 0x04
+#define PROM_NAME_LABEL_REST 0x08
+
+#define PROM_NAME_ALPHA (PROM_NAME_METRIC_FIRST | PROM_NAME_METRIC_REST | PROM_NAME_LABEL_FIRST | PROM_NAME_LABEL_REST)
+#define PROM_NAME_DIGIT (PROM_NAME_METRIC_REST | PROM_NAME_LABEL_REST)
+#define PROM_NAME_COLON (PROM_NAME_METRIC_FIRST | PROM_NAME_METRIC_REST)
+
+static const unsigned char prom_name_classes[256] = {
+    ['A' ... 'Z'] = PROM_NAME_ALPHA, ['a' ... 'z'] = PROM_NAME_ALPHA, ['_'] = PROM_NAME_ALPHA,
+    ['0' ... '9'] = PROM_NAME_DIGIT, [':'] = PROM_NAME_COLON,
+};
+
+static bool prom_name_matches(const char *name, unsigned char first, unsigned char rest) {
+  if (name == NULL) return false;
+  const unsigned char *c = (const unsigned char *)name;
+  if (!(prom_name_classes[*c] & first)) return false;
+  for (c++; *c != '\0'; c++) {
+    if (!(prom_name_classes[*c] & rest)) return false;
+  }
+  return true;
+}
+
+bool prom_name_is_valid_metric(const char *name) {
+  return prom_name_matches(name, PROM_NAME_METRIC_FIRST, PROM_NAME_METRIC_REST);
+}
+
+bool prom_name_is_valid_label(const char *name) {
+  if (!prom_name_matches(name, PROM_NAME_LABEL_FIRST, PROM_NAME_LABEL_REST)) return false;
+  return !(name[0] == '_' && name[1] == '_');
+}
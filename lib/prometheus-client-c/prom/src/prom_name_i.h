@@ -0,0 +1,37 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdbool.h>
+
+#ifndef PROM_NAME_I_H
+#define PROM_NAME_I_H
+
+/**
+ * @brief API PRIVATE Returns true if name matches ^[a-zA-Z_:][a-zA-Z0-9_:]*$
+ *
+ * Reference: https://prometheus.io/docs/concepts/data_model/#metric-names-and-labels
+ */
+bool prom_name_is_valid_metric(const char *name);
+
+/**
+ * @brief API PRIVATE Returns true if name matches ^[a-zA-Z_][a-zA-Z0-9_]*$ and does not start with the "__" prefix
+ * reserved for internal use
+ *
+ * Reference: https://prometheus.io/docs/concepts/data_model/#metric-names-and-labels
+ */
+bool prom_name_is_valid_label(const char *name);
+
+#endif  // PROM_NAME_I_H
@@ -26,6 +26,7 @@
 // Private
 #include "prom_errors.h"
 #include "prom_log.h"
+#include "prom_process_fds_i.h"
 #include "prom_process_fds_t.h"
 
 prom_gauge_t *prom_process_open_fds;
@@ -33,7 +34,6 @@ prom_gauge_t *prom_process_open_fds;
 int prom_process_fds_count(const char *path) {
   int count = 0;
   int r = 0;
-  struct dirent *de;
   DIR *d;
   if (path) {
     d = opendir(path);
@@ -52,17 +52,27 @@ int prom_process_fds_count(const char *path) {
     }
   }
 
+  count = prom_process_fds_count_dir(d);
+  r = closedir(d);
+  if (r) {
+    PROM_LOG(PROM_STDIO_CLOSE_DIR_ERROR);
+    return -1;
+  }
+  return count;
+}
+
+int prom_process_fds_count_dir(DIR *d) {
+  int count = 0;
+  struct dirent *de;
+
+  // Rewinding makes the next readdir list the descriptors open now rather than when the directory was opened
+  rewinddir(d);
   while ((de = readdir(d)) != NULL) {
     if (strcmp(".", de->d_name) == 0 || strcmp("..", de->d_name) == 0) {
       continue;
     }
     count++;
   }
-  r = closedir(d);
-  if (r) {
-    PROM_LOG(PROM_STDIO_CLOSE_DIR_ERROR);
-    return -1;
-  }
   return count;
 }
 
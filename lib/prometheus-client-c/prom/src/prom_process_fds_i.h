@@ -17,7 +17,17 @@
 #ifndef PROM_PROESS_FDS_I_INCLUDED
 #define PROM_PROESS_FDS_I_INCLUDED
 
+#include <dirent.h>
+
 int prom_process_fds_count(const char *path);
+
+/**
+ * @brief API PRIVATE Rewinds an open /proc/[pid]/fd directory and returns the number of entries in it
+ *
+ * The count includes the descriptor of the directory itself, like prom_process_fds_count does.
+ */
+int prom_process_fds_count_dir(DIR *d);
+
 int prom_process_fds_init(void);
 
 #endif  // PROM_PROESS_FDS_I_INCLUDED
@@ -133,12 +133,12 @@ int prom_process_limits_current_row_destroy(prom_process_limits_current_row_t *s
 
 prom_process_limits_file_t *prom_process_limits_file_new(const char *path) {
   if (path) {
-    return prom_procfs_buf_new(path);
+    return prom_procfs_buf_new(path, PROM_PROCESS_LIMITS_SIZE_HINT);
   } else {
     int pid = (int)getpid();
     char path[255];
     sprintf(path, "/proc/%d/limits", pid);
-    return prom_procfs_buf_new(path);
+    return prom_procfs_buf_new(path, PROM_PROCESS_LIMITS_SIZE_HINT);
   }
 }
 
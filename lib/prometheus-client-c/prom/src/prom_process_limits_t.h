@@ -20,6 +20,9 @@
 #include "prom_gauge.h"
 #include "prom_procfs_t.h"
 
+// /proc/[pid]/limits is a fixed table of 17 rows of about 80 bytes each
+#define PROM_PROCESS_LIMITS_SIZE_HINT 2048
+
 extern prom_gauge_t *prom_process_open_fds;
 extern prom_gauge_t *prom_process_max_fds;
 extern prom_gauge_t *prom_process_virtual_memory_max_bytes;
@@ -21,8 +21,17 @@
 
 prom_process_stat_file_t *prom_process_stat_file_new(const char *path);
 int prom_process_stat_file_destroy(prom_process_stat_file_t *self);
-prom_process_stat_t *prom_process_stat_new(prom_process_stat_file_t *stat_f);
-int prom_process_stat_destroy(prom_process_stat_t *self);
 int prom_process_stats_init(void);
 
+/**
+ * @brief API PRIVATE Fills pid, state, utime, stime, starttime, vsize and rss of self from the contents of a
+ * /proc/[pid]/stat file, leaving the other fields untouched
+ *
+ * Fields are found by counting spaces from the last ')', so a comm holding spaces or parentheses cannot shift them.
+ * The numbers are converted with prom_procfs_parse_u64s, which reads no further than buf + len.
+ *
+ * @return A non-zero integer value upon failure
+ */
+int prom_process_stat_parse(prom_process_stat_t *self, const char *buf, size_t len);
+
 #endif  // PROM_PROCESS_STATS_I_H
@@ -20,6 +20,9 @@
 #include "prom_gauge.h"
 #include "prom_procfs_t.h"
 
+// /proc/[pid]/stat is a single line of at most a few hundred bytes; comm is capped at 16 bytes by the kernel
+#define PROM_PROCESS_STAT_SIZE_HINT 1024
+
 extern prom_gauge_t *prom_process_cpu_seconds_total;
 extern prom_gauge_t *prom_process_virtual_memory_bytes;
 extern prom_gauge_t *prom_process_resident_memory_bytes;
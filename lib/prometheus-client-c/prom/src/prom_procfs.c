@@ -15,77 +15,172 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 // Public
 #include "prom_alloc.h"
+#include "prom_procfs.h"
 
 // Private
 #include "prom_assert.h"
 #include "prom_log.h"
 #include "prom_procfs_i.h"
 
-static int prom_procfs_ensure_buf_size(prom_procfs_buf_t *self) {
-  PROM_ASSERT(self != NULL);
-  if (self->allocated >= self->size + 1) return 0;
-  while (self->allocated < self->size + 1) self->allocated <<= 1;
-  self->buf = (char *)prom_realloc(self->buf, self->allocated);
-  return 0;
+ssize_t prom_procfs_read(int fd, char **buf, size_t *capacity, size_t max_capacity) {
+  PROM_ASSERT(buf != NULL);
+  PROM_ASSERT(capacity != NULL);
+  if (buf == NULL || capacity == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (*buf == NULL) {
+    if (*capacity == 0) *capacity = PROM_PROCFS_DEFAULT_SIZE_HINT;
+    *buf = (char *)prom_malloc(*capacity);
+    if (*buf == NULL) {
+      errno = ENOMEM;
+      return -1;
+    }
+  }
+  if (*capacity < 2) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  size_t len = 0;
+  for (;;) {
+    if (len == *capacity - 1) {
+      // The buffer is full: either the file ends here or it is larger than the buffer
+      if (*capacity >= max_capacity) break;
+      size_t grown_capacity = *capacity * 2;
+      if (grown_capacity > max_capacity) grown_capacity = max_capacity;
+      char *grown = (char *)prom_realloc(*buf, grown_capacity);
+      if (grown == NULL) {
+        errno = ENOMEM;
+        return -1;
+      }
+      *buf = grown;
+      *capacity = grown_capacity;
+    }
+
+    ssize_t n = pread(fd, *buf + len, *capacity - 1 - len, (off_t)len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    if (n == 0) break;
+    len += (size_t)n;
+  }
+
+  (*buf)[len] = '\0';
+  return (ssize_t)len;
+}
+
+/**
+ * @brief API PRIVATE Returns true if the eight bytes of a little-endian word are all ASCII digits
+ */
+static inline bool prom_procfs_eight_digits(uint64_t word) {
+  // The high nibble of a digit is 3, and adding 6 to a digit leaves it there
+  return ((word & 0xF0F0F0F0F0F0F0F0) | (((word + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) ==
+         0x3333333333333333;
 }
 
-prom_procfs_buf_t *prom_procfs_buf_new(const char *path) {
-  int r = 0;
+/**
+ * @brief API PRIVATE Converts eight ASCII digits held in a little-endian word, first digit in the lowest byte
+ *
+ * Adjacent digits, then pairs, then quadruples are combined with one multiplication per step.
+ */
+static inline uint64_t prom_procfs_convert_eight(uint64_t word) {
+  word -= 0x3030303030303030;
+  word = (word * 10 + (word >> 8)) & 0x00FF00FF00FF00FF;
+  word = (word * 100 + (word >> 16)) & 0x0000FFFF0000FFFF;
+  return (word * 10000 + (word >> 32)) & 0x00000000FFFFFFFF;
+}
 
-  FILE *f = fopen(path, "r");
+uint64_t prom_procfs_parse_u64(const char **p, const char *end) {
+  PROM_ASSERT(p != NULL);
+  const char *c = *p;
+  while (c < end && (*c == ' ' || *c == '\t')) c++;
+
+  uint64_t value = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (end - c >= 8) {
+    uint64_t word;
+    memcpy(&word, c, sizeof(word));
+    if (!prom_procfs_eight_digits(word)) break;
+    value = value * 100000000 + prom_procfs_convert_eight(word);
+    c += 8;
+  }
+#endif
+  while (c < end && *c >= '0' && *c <= '9') {
+    value = value * 10 + (uint64_t)(*c - '0');
+    c++;
+  }
+
+  *p = c;
+  return value;
+}
+
+size_t prom_procfs_parse_u64s(const char **p, const char *end, uint64_t *values, size_t count) {
+  PROM_ASSERT(p != NULL);
+  PROM_ASSERT(values != NULL);
+  size_t parsed = 0;
+  for (; parsed < count; parsed++) {
+    const char *c = *p;
+    while (c < end && (*c == ' ' || *c == '\t')) c++;
+    if (c == end || *c < '0' || *c > '9') break;
+    values[parsed] = prom_procfs_parse_u64(p, end);
+  }
+  return parsed;
+}
+
+size_t prom_procfs_skip_fields(const char **p, const char *end, size_t count) {
+  PROM_ASSERT(p != NULL);
+  const char *c = *p;
+  size_t skipped = 0;
+  for (; skipped < count; skipped++) {
+    while (c < end && (*c == ' ' || *c == '\t')) c++;
+    if (c == end || *c == '\n' || *c == '\0') break;
+    while (c < end && *c != ' ' && *c != '\t' && *c != '\n' && *c != '\0') c++;
+  }
+  *p = c;
+  return skipped;
+}
+
+prom_procfs_buf_t *prom_procfs_buf_new(const char *path, size_t size_hint) {
   char errbuf[100];
 
-  if (f == NULL) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
     strerror_r(errno, errbuf, 100);
     PROM_LOG(errbuf);
     return NULL;
   }
 
-#define PROM_PROCFS_BUF_NEW_HANDLE_F_CLOSE(f) \
-  r = fclose(f);                              \
-  if (r) {                                    \
-    strerror_r(errno, errbuf, 100);           \
-    PROM_LOG(errbuf);                         \
-  }
-
-  unsigned short int initial_size = 32;
   prom_procfs_buf_t *self = prom_malloc(sizeof(prom_procfs_buf_t));
-  self->buf = prom_malloc(initial_size);
+  self->buf = NULL;
   self->size = 0;
   self->index = 0;
-  self->allocated = initial_size;
-
-  for (int current_char = getc(f), i = 0; current_char != EOF; current_char = getc(f), i++) {
-    r = prom_procfs_ensure_buf_size(self);
-    if (r) {
-      prom_procfs_buf_destroy(self);
-      self = NULL;
-      PROM_PROCFS_BUF_NEW_HANDLE_F_CLOSE(f);
-      return NULL;
-    }
-    self->buf[i] = current_char;
-    self->size++;
-  }
-  r = prom_procfs_ensure_buf_size(self);
-  if (r) {
+  self->allocated = size_hint;
+
+  ssize_t n = prom_procfs_read(fd, &self->buf, &self->allocated, PROM_PROCFS_MAX_SIZE);
+  if (n < 0) {
+    strerror_r(errno, errbuf, 100);
+    PROM_LOG(errbuf);
+    close(fd);
     prom_procfs_buf_destroy(self);
-    self = NULL;
-    PROM_PROCFS_BUF_NEW_HANDLE_F_CLOSE(f);
     return NULL;
   }
+  close(fd);
 
-  self->buf[self->size] = '\0';
-  self->size++;
-
-  PROM_PROCFS_BUF_NEW_HANDLE_F_CLOSE(f);
-  if (r) return NULL;
+  // size counts the NUL terminator, which the parsers rely on
+  self->size = (size_t)n + 1;
   return self;
 }
 
@@ -17,9 +17,23 @@
 #ifndef PROM_PROCFS_I_H
 #define PROM_PROCFS_I_H
 
+#include <stddef.h>
+
 #include "prom_procfs_t.h"
 
-prom_procfs_buf_t *prom_procfs_buf_new(const char *path);
+/**
+ * @brief Upper bound on the size of a file read into a prom_procfs_buf_t
+ */
+#define PROM_PROCFS_MAX_SIZE (1 << 20)
+
+/**
+ * @brief API PRIVATE Reads a whole file into a new prom_procfs_buf_t with prom_procfs_read
+ *
+ * @param path The path of the file
+ * @param size_hint Initial size of the buffer, large enough for the usual contents of the file so it is read in one
+ * block. 0 selects PROM_PROCFS_DEFAULT_SIZE_HINT.
+ */
+prom_procfs_buf_t *prom_procfs_buf_new(const char *path, size_t size_hint);
 
 int prom_procfs_buf_destroy(prom_procfs_buf_t *self);
 
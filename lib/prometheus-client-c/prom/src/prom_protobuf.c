@@ -0,0 +1,97 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+// Private
+#include "prom_assert.h"
+#include "prom_protobuf_i.h"
+#include "prom_string_builder_i.h"
+
+// A uint64_t takes at most 10 bytes as a varint
+#define PROM_PROTOBUF_VARINT_MAX_SIZE 10
+
+int prom_protobuf_add_varint(prom_string_builder_t *self, uint64_t value) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+
+  unsigned char buf[PROM_PROTOBUF_VARINT_MAX_SIZE];
+  size_t len = 0;
+  while (value >= 0x80) {
+    buf[len++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  buf[len++] = (unsigned char)value;
+  return prom_string_builder_add_bytes(self, buf, len);
+}
+
+static int prom_protobuf_add_tag(prom_string_builder_t *self, uint32_t field, uint32_t wire_type) {
+  return prom_protobuf_add_varint(self, ((uint64_t)field << 3) | wire_type);
+}
+
+int prom_protobuf_add_uint64(prom_string_builder_t *self, uint32_t field, uint64_t value) {
+  int r = 0;
+
+  r = prom_protobuf_add_tag(self, field, PROM_PROTOBUF_WIRE_VARINT);
+  if (r) return r;
+
+  return prom_protobuf_add_varint(self, value);
+}
+
+uint64_t prom_protobuf_zigzag(int64_t value) {
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+int prom_protobuf_add_sint64(prom_string_builder_t *self, uint32_t field, int64_t value) {
+  return prom_protobuf_add_uint64(self, field, prom_protobuf_zigzag(value));
+}
+
+int prom_protobuf_add_double(prom_string_builder_t *self, uint32_t field, double value) {
+  int r = 0;
+
+  r = prom_protobuf_add_tag(self, field, PROM_PROTOBUF_WIRE_FIXED64);
+  if (r) return r;
+
+  uint64_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  unsigned char buf[sizeof(bits)];
+  for (size_t i = 0; i < sizeof(bits); i++) buf[i] = (unsigned char)(bits >> (8 * i));
+  return prom_string_builder_add_bytes(self, buf, sizeof(buf));
+}
+
+int prom_protobuf_add_bytes(prom_string_builder_t *self, uint32_t field, const void *data, size_t len) {
+  int r = 0;
+
+  r = prom_protobuf_add_tag(self, field, PROM_PROTOBUF_WIRE_LEN);
+  if (r) return r;
+
+  r = prom_protobuf_add_varint(self, len);
+  if (r) return r;
+
+  return prom_string_builder_add_bytes(self, data, len);
+}
+
+int prom_protobuf_add_string(prom_string_builder_t *self, uint32_t field, const char *str) {
+  if (str == NULL) str = "";
+  return prom_protobuf_add_bytes(self, field, str, strlen(str));
+}
+
+int prom_protobuf_add_message(prom_string_builder_t *self, uint32_t field, prom_string_builder_t *message) {
+  PROM_ASSERT(message != NULL);
+  if (message == NULL) return 1;
+  return prom_protobuf_add_bytes(self, field, prom_string_builder_str(message), prom_string_builder_len(message));
+}
@@ -0,0 +1,73 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Reference: https://protobuf.dev/programming-guides/encoding/
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Private
+#include "prom_string_builder_t.h"
+
+#ifndef PROM_PROTOBUF_I_H
+#define PROM_PROTOBUF_I_H
+
+// Wire types of the protobuf encoding used by the exposition format
+#define PROM_PROTOBUF_WIRE_VARINT 0
+#define PROM_PROTOBUF_WIRE_FIXED64 1
+#define PROM_PROTOBUF_WIRE_LEN 2
+
+/**
+ * @brief API PRIVATE Adds value encoded as a base 128 varint, without a field tag
+ */
+int prom_protobuf_add_varint(prom_string_builder_t *self, uint64_t value);
+
+/**
+ * @brief API PRIVATE Adds a varint field
+ */
+int prom_protobuf_add_uint64(prom_string_builder_t *self, uint32_t field, uint64_t value);
+
+/**
+ * @brief API PRIVATE Returns the zigzag encoding of value, which keeps small negative numbers short as varints
+ */
+uint64_t prom_protobuf_zigzag(int64_t value);
+
+/**
+ * @brief API PRIVATE Adds a sint64 field, or a sint32 one, which encodes values in range the same way
+ */
+int prom_protobuf_add_sint64(prom_string_builder_t *self, uint32_t field, int64_t value);
+
+/**
+ * @brief API PRIVATE Adds a double field, encoded as 8 little-endian bytes
+ */
+int prom_protobuf_add_double(prom_string_builder_t *self, uint32_t field, double value);
+
+/**
+ * @brief API PRIVATE Adds a length-delimited field holding len bytes of data
+ */
+int prom_protobuf_add_bytes(prom_string_builder_t *self, uint32_t field, const void *data, size_t len);
+
+/**
+ * @brief API PRIVATE Adds a string field. NULL is encoded as the empty string.
+ */
+int prom_protobuf_add_string(prom_string_builder_t *self, uint32_t field, const char *str);
+
+/**
+ * @brief API PRIVATE Adds an embedded message field whose encoded fields were built in message
+ */
+int prom_protobuf_add_message(prom_string_builder_t *self, uint32_t field, prom_string_builder_t *message);
+
+#endif  // PROM_PROTOBUF_I_H
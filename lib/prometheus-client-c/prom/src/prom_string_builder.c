@@ -21,6 +21,7 @@
 
 // Private
 #include "prom_assert.h"
+#include "prom_dtoa_i.h"
 #include "prom_string_builder_i.h"
 #include "prom_string_builder_t.h"
 
@@ -103,6 +104,22 @@ int prom_string_builder_add_str(prom_string_builder_t *self, const char *str) {
   return 0;
 }
 
+int prom_string_builder_add_bytes(prom_string_builder_t *self, const void *data, size_t len) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+
+  if (self == NULL) return 1;
+  if (len == 0) return 0;
+
+  r = prom_string_builder_ensure_space(self, len);
+  if (r) return r;
+
+  memcpy(self->str + self->len, data, len);
+  self->len += len;
+  self->str[self->len] = '\0';
+  return 0;
+}
+
 int prom_string_builder_add_char(prom_string_builder_t *self, char c) {
   PROM_ASSERT(self != NULL);
   int r = 0;
@@ -117,6 +134,38 @@ int prom_string_builder_add_char(prom_string_builder_t *self, char c) {
   return 0;
 }
 
+int prom_string_builder_add_double(prom_string_builder_t *self, double value) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+
+  if (self == NULL) return 1;
+  r = prom_string_builder_ensure_space(self, PROM_DTOA_BUFFER_SIZE);
+  if (r) return r;
+
+  self->len += (size_t)prom_dtoa(value, self->str + self->len);
+  return 0;
+}
+
+int prom_string_builder_add_u64(prom_string_builder_t *self, uint64_t value) {
+  PROM_ASSERT(self != NULL);
+  int r = 0;
+
+  if (self == NULL) return 1;
+  // UINT64_MAX has 20 digits
+  r = prom_string_builder_ensure_space(self, 20);
+  if (r) return r;
+
+  char digits[20];
+  size_t count = 0;
+  do {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (count > 0) self->str[self->len++] = digits[--count];
+  self->str[self->len] = '\0';
+  return 0;
+}
+
 int prom_string_builder_truncate(prom_string_builder_t *self, size_t len) {
   PROM_ASSERT(self != NULL);
   if (self == NULL) return 1;
@@ -134,6 +183,27 @@ int prom_string_builder_clear(prom_string_builder_t *self) {
   return prom_string_builder_init(self);
 }
 
+int prom_string_builder_reset(prom_string_builder_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  self->len = 0;
+  self->str[0] = '\0';
+  return 0;
+}
+
+int prom_string_builder_reserve(prom_string_builder_t *self, size_t capacity) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (capacity <= self->len) return 0;
+  return prom_string_builder_ensure_space(self, capacity - self->len);
+}
+
+size_t prom_string_builder_capacity(prom_string_builder_t *self) {
+  PROM_ASSERT(self != NULL);
+  // -1 to account for \0
+  return self->allocated - 1;
+}
+
 size_t prom_string_builder_len(prom_string_builder_t *self) {
   PROM_ASSERT(self != NULL);
   return self->len;
@@ -18,6 +18,7 @@
 #define PROM_STRING_BUILDER_I_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include "prom_string_builder_t.h"
 
@@ -39,23 +40,59 @@ int prom_string_builder_destroy(prom_string_builder_t *self);
  */
 int prom_string_builder_add_str(prom_string_builder_t *self, const char *str);
 
+/**
+ * API PRIVATE
+ * @brief Adds len bytes, which may include NUL bytes. The string stays NUL terminated after them.
+ */
+int prom_string_builder_add_bytes(prom_string_builder_t *self, const void *data, size_t len);
+
 /**
  * API PRIVATE
  * @brief Adds a char
  */
 int prom_string_builder_add_char(prom_string_builder_t *self, char c);
 
+/**
+ * API PRIVATE
+ * @brief Adds the shortest decimal representation of a double that parses back to the same value. See prom_dtoa.
+ */
+int prom_string_builder_add_double(prom_string_builder_t *self, double value);
+
+/**
+ * API PRIVATE
+ * @brief Adds the decimal representation of an unsigned 64-bit integer
+ */
+int prom_string_builder_add_u64(prom_string_builder_t *self, uint64_t value);
+
 /**
  * API PRIVATE
  * @brief Clear the string
  */
 int prom_string_builder_clear(prom_string_builder_t *self);
 
+/**
+ * API PRIVATE
+ * @brief Empty the string while keeping its allocation for the next use
+ */
+int prom_string_builder_reset(prom_string_builder_t *self);
+
+/**
+ * API PRIVATE
+ * @brief Grow the allocation so that the string can hold at least capacity characters without reallocating
+ */
+int prom_string_builder_reserve(prom_string_builder_t *self, size_t capacity);
+
+/**
+ * API PRIVATE
+ * @brief Returns the number of characters the string can hold without reallocating
+ */
+size_t prom_string_builder_capacity(prom_string_builder_t *self);
+
 /**
  * API PRIVATE
  * @brief Remove data from the end
  */
-int prom_string_buillder_truncate(prom_string_builder_t *self, size_t len);
+int prom_string_builder_truncate(prom_string_builder_t *self, size_t len);
 
 /**
  * API PRIVATE
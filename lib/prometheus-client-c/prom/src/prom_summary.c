@@ -0,0 +1,76 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Public
+#include "prom_summary.h"
+
+#include "prom_alloc.h"
+#include "prom_summary_quantiles.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_errors.h"
+#include "prom_log.h"
+#include "prom_metric_i.h"
+#include "prom_metric_sample_summary_i.h"
+#include "prom_metric_sample_summary_t.h"
+#include "prom_metric_t.h"
+
+prom_summary_t *prom_summary_new(const char *name, const char *help, prom_summary_quantiles_t *quantiles,
+                                 size_t label_key_count, const char **label_keys) {
+  if (quantiles == NULL) {
+    if (!prom_summary_default_quantiles) {
+      prom_summary_default_quantiles = prom_summary_quantiles_new(3, 0.5, 0.9, 0.99);
+    }
+    quantiles = prom_summary_default_quantiles;
+  } else {
+    // Ensure every quantile is within [0, 1]
+    for (int i = 0; i < quantiles->count; i++) {
+      if (!(quantiles->quantiles[i] >= 0.0 && quantiles->quantiles[i] <= 1.0)) {
+        PROM_LOG(PROM_SUMMARY_INVALID_QUANTILE);
+        return NULL;
+      }
+    }
+  }
+  prom_summary_t *self = (prom_summary_t *)prom_metric_new(PROM_SUMMARY, name, help, label_key_count, label_keys);
+  if (self == NULL) return NULL;
+  self->quantiles = quantiles;
+  return self;
+}
+
+int prom_summary_destroy(prom_summary_t *self) {
+  PROM_ASSERT(self != NULL);
+
+  int r = 0;
+
+  if (self == NULL) return r;
+  r = prom_metric_destroy(self);
+  if (r) return r;
+  self = NULL;
+  return r;
+}
+
+int prom_summary_observe(prom_summary_t *self, double value, const char **label_values) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 1;
+  if (self->type != PROM_SUMMARY) {
+    PROM_LOG(PROM_METRIC_INCORRECT_TYPE);
+    return 1;
+  }
+  prom_metric_sample_summary_t *s_sample = prom_metric_sample_summary_from_labels(self, label_values);
+  if (s_sample == NULL) return 1;
+  return prom_metric_sample_summary_observe(s_sample, value);
+}
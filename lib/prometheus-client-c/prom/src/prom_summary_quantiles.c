@@ -0,0 +1,63 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+
+// Public
+#include "prom_alloc.h"
+#include "prom_summary_quantiles.h"
+
+// Private
+#include "prom_assert.h"
+#include "prom_log.h"
+
+prom_summary_quantiles_t *prom_summary_default_quantiles = NULL;
+
+prom_summary_quantiles_t *prom_summary_quantiles_new(size_t count, double quantile, ...) {
+  prom_summary_quantiles_t *self = (prom_summary_quantiles_t *)prom_malloc(sizeof(prom_summary_quantiles_t));
+  if (self == NULL) return NULL;
+  double *quantiles = (double *)prom_malloc(sizeof(double) * count);
+  if (quantiles == NULL) {
+    prom_free(self);
+    return NULL;
+  }
+  self->count = count;
+  quantiles[0] = quantile;
+  va_list arg_list;
+  va_start(arg_list, quantile);
+  for (size_t i = 1; i < count; i++) {
+    quantiles[i] = va_arg(arg_list, double);
+  }
+  va_end(arg_list);
+  self->quantiles = quantiles;
+  return self;
+}
+
+int prom_summary_quantiles_destroy(prom_summary_quantiles_t *self) {
+  PROM_ASSERT(self != NULL);
+  if (self == NULL) return 0;
+  prom_free((double *)self->quantiles);
+  self->quantiles = NULL;
+  prom_free(self);
+  self = NULL;
+  return 0;
+}
+
+size_t prom_summary_quantiles_count(prom_summary_quantiles_t *self) {
+  PROM_ASSERT(self != NULL);
+  return self->count;
+}
@@ -0,0 +1,38 @@
+/**
+ * Copyright 2019-2020 DigitalOcean Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file prom_trace.h
+ * @brief USDT probes of the library, compiled in with PROM_TRACE_ENABLE
+ *
+ * The probes belong to the "prom" provider and can be listed with `readelf -n` on the library or attached with, for
+ * example, `bpftrace -e 'usdt:libprom.so:prom:map__resize { ... }'`. Without PROM_TRACE_ENABLE they expand to nothing.
+ * An armed probe is a single nop until a tracer attaches to it.
+ */
+
+#ifndef PROM_TRACE_H
+#define PROM_TRACE_H
+
+#ifdef PROM_TRACE_ENABLE
+#include <sys/sdt.h>
+#define PROM_TRACE1(name, a) DTRACE_PROBE1(prom, name, a)
+#define PROM_TRACE2(name, a, b) DTRACE_PROBE2(prom, name, a, b)
+#else
+#define PROM_TRACE1(name, a)
+#define PROM_TRACE2(name, a, b)
+#endif  // PROM_TRACE_ENABLE
+
+#endif  // PROM_TRACE_H
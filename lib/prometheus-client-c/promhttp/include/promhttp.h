@@ -23,11 +23,15 @@
  * https://www.gnu.org/software/libmicrohttpd/manual/libmicrohttpd.html#index-_002aMHD_005fAcceptPolicyCallback
  */
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 
 #include "microhttpd.h"
 #include "prom_collector_registry.h"
 
+#define PROMHTTP_ENDPOINT_MAX 8 /**< Most endpoints promhttp_add_endpoint can add */
+
 /**
  * @brief Sets the active registry for metric scraping.
  *
@@ -36,6 +40,56 @@
  */
 void promhttp_set_active_collector_registry(prom_collector_registry_t *active_registry);
 
+/**
+ * @brief A request served by an endpoint added with promhttp_add_endpoint
+ */
+typedef struct promhttp_request promhttp_request_t;
+
+/**
+ * @brief Returns the value of a query string argument of a request
+ *
+ * @param request The request
+ * @param key The name of the argument
+ * @return The decoded value, valid until the response is queued, or NULL if the argument is missing
+ */
+const char *promhttp_request_argument(const promhttp_request_t *request, const char *key);
+
+/**
+ * @brief Sets the HTTP status code of the response to a request, 200 unless set
+ *
+ * @param request The request
+ * @param status The status code, such as MHD_HTTP_BAD_REQUEST
+ */
+void promhttp_request_set_status(promhttp_request_t *request, unsigned int status);
+
+/**
+ * @brief Renders the body of an endpoint added with promhttp_add_endpoint.
+ *
+ * Works like snprintf: the body is written into buf, truncated to size - 1 bytes and NUL terminated, and its full
+ * length is returned. When it did not fit, the daemon calls the function again with a larger buffer.
+ *
+ * @param arg The argument given to promhttp_add_endpoint
+ * @param request The request being served
+ * @param buf The buffer receiving the body
+ * @param size The size of buf in bytes
+ * @return The length of the whole body, excluding the NUL
+ */
+typedef size_t promhttp_endpoint_fn(void *arg, promhttp_request_t *request, char *buf, size_t size);
+
+/**
+ * @brief Serves the body rendered by a function on a URL, besides / and /metrics. GET requests only.
+ *
+ * Endpoints must be added before the daemon is started; they are rendered on every request, from whichever thread
+ * serves it.
+ *
+ * @param url The path, such as "/status". The pointer is stored.
+ * @param content_type The Content-Type of the body. The pointer is stored.
+ * @param render The function rendering the body
+ * @param arg Argument passed to render
+ * @return A non-zero integer value upon failure, i.e. when PROMHTTP_ENDPOINT_MAX endpoints were already added
+ */
+int promhttp_add_endpoint(const char *url, const char *content_type, promhttp_endpoint_fn *render, void *arg);
+
 /**
  *  @brief Starts a daemon in the background and returns a pointer to an HMD_Daemon.
  *
@@ -46,3 +100,88 @@ void promhttp_set_active_collector_registry(prom_collector_registry_t *active_re
  */
 struct MHD_Daemon *promhttp_start_daemon(unsigned int flags, unsigned short port, MHD_AcceptPolicyCallback apc,
                                          void *apc_cls);
+
+/**
+ * @brief The ways a promhttp daemon can wait for connections.
+ */
+typedef enum promhttp_mode {
+  PROMHTTP_MODE_SELECT, /**< One internal thread calling select(); limited to FD_SETSIZE descriptors */
+  PROMHTTP_MODE_EPOLL,  /**< Internal threads calling epoll_wait(); Linux only */
+} promhttp_mode_t;
+
+/**
+ * @brief Configuration of a promhttp daemon. Zero fields keep the libmicrohttpd defaults.
+ */
+typedef struct promhttp_config {
+  promhttp_mode_t mode;                 /**< How the daemon waits for connections */
+  unsigned int thread_pool_size;        /**< Threads serving connections; 0 or 1 for a single internal thread */
+  unsigned int connection_limit;        /**< Maximum number of concurrent connections */
+  unsigned int per_ip_connection_limit; /**< Maximum number of concurrent connections from one address */
+  unsigned int connection_timeout;      /**< Seconds of inactivity after which a connection is closed */
+  size_t stream_chunk_size;             /**< If not 0, stream /metrics in chunks of this size; see below */
+} promhttp_config_t;
+
+/**
+ * @brief Callbacks told about every full /metrics scrape, for self-instrumentation
+ *
+ * Both are called on the thread serving the scrape and either may be NULL. Scrapes filtered by name[] or match[] are
+ * not reported; streamed scrapes are only reported once sent, since they render while sending.
+ */
+typedef struct promhttp_observer {
+  /** Called once the body is ready, with the time spent rendering and compressing it, its size in bytes and the
+   * allocations the library made meanwhile */
+  void (*rendered)(uint64_t render_ns, size_t bytes, unsigned long long allocations, void *arg);
+  /** Called once the response is done, with the time spent sending it and whether it was sent completely */
+  void (*sent)(uint64_t send_ns, bool completed, void *arg);
+  void *arg; /**< Argument passed to the callbacks */
+} promhttp_observer_t;
+
+/**
+ * @brief Installs the callbacks told about every scrape
+ *
+ * Must be called before the daemon is started.
+ *
+ * @param observer The callbacks, copied; NULL removes them
+ */
+void promhttp_set_observer(const promhttp_observer_t *observer);
+
+/**
+ * @brief Function run before every /metrics scrape is rendered, to collect the metrics it serves on demand
+ *
+ * It is called on the thread serving the scrape, concurrently when several scrapes arrive at once; the render that
+ * follows is shared by the scrapes that find the samples unchanged.
+ *
+ * @param arg The argument given to promhttp_set_collect_hook
+ */
+typedef void promhttp_collect_fn(void *arg);
+
+/**
+ * @brief Installs the function run before every /metrics scrape is rendered
+ *
+ * Must be called before the daemon is started.
+ *
+ * @param collect The function, or NULL to remove it
+ * @param arg Argument passed to collect
+ */
+void promhttp_set_collect_hook(promhttp_collect_fn *collect, void *arg);
+
+/**
+ *  @brief Starts a daemon in the background configured by config and returns a pointer to an HMD_Daemon.
+ *
+ * With a thread pool, each thread accepts and serves its own connections, so a slow scraper only holds up the thread
+ * serving it; the render it is sent is shared with the other scrapes.
+ *
+ * With a stream_chunk_size, /metrics is rendered while it is sent with prom_collector_registry_stream_read instead of
+ * from the render cache, so memory stays bounded for registries too large to render at once. Streamed responses are
+ * neither cached nor compressed.
+ *
+ * References:
+ *  * https://www.gnu.org/software/libmicrohttpd/manual/libmicrohttpd.html#microhttpd_002dinit
+ *  * https://www.gnu.org/software/libmicrohttpd/manual/libmicrohttpd.html#microhttpd_002dconst
+ *
+ * @param port The port to listen on
+ * @param config The daemon configuration. NULL is equivalent to a zeroed configuration.
+ * @return struct MHD_Daemon*, or NULL upon failure
+ */
+struct MHD_Daemon *promhttp_start_daemon_with_config(unsigned short port, const promhttp_config_t *config,
+                                                     MHD_AcceptPolicyCallback apc, void *apc_cls);
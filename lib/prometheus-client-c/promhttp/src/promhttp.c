@@ -14,13 +14,94 @@
  * limitations under the License.
  */
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <zlib.h>
 
 #include "microhttpd.h"
 #include "prom.h"
+#include "promhttp.h"
+
+// USDT probes of the "promhttp" provider around every scrape and request, compiled in with PROM_TRACE_ENABLE
+#ifdef PROM_TRACE_ENABLE
+#include <sys/sdt.h>
+#define PROMHTTP_TRACE1(name, a) DTRACE_PROBE1(promhttp, name, a)
+#else
+#define PROMHTTP_TRACE1(name, a)
+#endif
+
+#define PROMHTTP_GZIP_LEVEL 6              /**< zlib compression level of gzip responses */
+#define PROMHTTP_FILTER_MAX 64             /**< Most metric names a filtered scrape may ask for */
+#define PROMHTTP_FILTER_NAME_MAX 128       /**< Longest metric name a filtered scrape may ask for, including the NUL */
+#define PROMHTTP_ENDPOINT_BUFFER_SIZE 4096 /**< First buffer size an endpoint is rendered into */
+#define PROMHTTP_ENDPOINT_ATTEMPTS 4       /**< Renders of an endpoint whose body keeps growing before giving up */
+
+/**
+ * @brief The metric names asked for by the name[] and match[] arguments of a scrape
+ */
+typedef struct promhttp_filter {
+  char names[PROMHTTP_FILTER_MAX][PROMHTTP_FILTER_NAME_MAX]; /**< Requested metric names */
+  size_t count;                                             /**< Number of entries in names */
+  bool invalid;                                             /**< An argument could not be served */
+} promhttp_filter_t;
+
+/**
+ * @brief Content-Type of each exposition format, indexed by prom_exposition_format_t
+ */
+static const char *promhttp_content_types[PROM_EXPOSITION_FORMAT_COUNT] = {
+    [PROM_EXPOSITION_TEXT] = "text/plain; version=0.0.4; charset=utf-8",
+    [PROM_EXPOSITION_OPENMETRICS] = "application/openmetrics-text; version=1.0.0; charset=utf-8",
+    [PROM_EXPOSITION_PROTOBUF] =
+        "application/vnd.google.protobuf; proto=io.prometheus.client.MetricFamily; encoding=delimited",
+};
+
+/**
+ * @brief A compressed copy of a render, shared by the cache and the responses sending it
+ */
+typedef struct promhttp_encoded {
+  _Atomic unsigned int refs;                 /**< One per response being sent, plus one while cached */
+  const prom_collector_registry_t *registry; /**< Registry the render came from */
+  uint64_t generation;                       /**< Generation of the render */
+  size_t len;                                /**< Length of data in bytes */
+  char data[];                               /**< The compressed body */
+} promhttp_encoded_t;
+
+/**
+ * @brief An endpoint added with promhttp_add_endpoint
+ */
+typedef struct promhttp_endpoint {
+  const char *url;              /**< Path the endpoint is served on */
+  const char *content_type;     /**< Content-Type of the body */
+  promhttp_endpoint_fn *render; /**< Renders the body */
+  void *arg;                    /**< Argument passed to render */
+} promhttp_endpoint_t;
+
+/**
+ * @brief A request served by an endpoint
+ */
+struct promhttp_request {
+  struct MHD_Connection *connection; /**< Connection the request came on */
+  unsigned int status;               /**< Status code of the response */
+};
 
 prom_collector_registry_t *PROM_ACTIVE_REGISTRY;
 
+static promhttp_endpoint_t promhttp_endpoints[PROMHTTP_ENDPOINT_MAX];
+static size_t promhttp_endpoint_count;
+
+static promhttp_observer_t promhttp_observer;
+static promhttp_collect_fn *promhttp_collect;
+static void *promhttp_collect_arg;
+
+static pthread_mutex_t promhttp_gzip_lock = PTHREAD_MUTEX_INITIALIZER;
+static promhttp_encoded_t *promhttp_gzip_cache[PROM_EXPOSITION_FORMAT_COUNT];
+
 void promhttp_set_active_collector_registry(prom_collector_registry_t *active_registry) {
   if (!active_registry) {
     PROM_ACTIVE_REGISTRY = PROM_COLLECTOR_REGISTRY_DEFAULT;
@@ -29,6 +110,420 @@ void promhttp_set_active_collector_registry(prom_collector_registry_t *active_re
   }
 }
 
+void promhttp_set_observer(const promhttp_observer_t *observer) {
+  static const promhttp_observer_t none = {0};
+  promhttp_observer = observer != NULL ? *observer : none;
+}
+
+void promhttp_set_collect_hook(promhttp_collect_fn *collect, void *arg) {
+  promhttp_collect = collect;
+  promhttp_collect_arg = arg;
+}
+
+static uint64_t promhttp_now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Remembers when a scrape was queued in its connection closure, for promhttp_completed
+ *
+ * The time is stored in the pointer itself so that no allocation is needed; differences are taken modulo the pointer
+ * width, which is exact for sends shorter than four seconds even with 32-bit pointers.
+ */
+static void promhttp_mark_queued(void **con_cls) {
+  if (promhttp_observer.sent != NULL) *con_cls = (void *)(uintptr_t)(promhttp_now_ns() | 1u);
+}
+
+static void promhttp_completed(void *cls, struct MHD_Connection *connection, void **con_cls,
+                               enum MHD_RequestTerminationCode toe) {
+  PROMHTTP_TRACE1(request__done, toe == MHD_REQUEST_TERMINATED_COMPLETED_OK);
+  if (*con_cls == NULL || promhttp_observer.sent == NULL) return;
+  uintptr_t elapsed = (uintptr_t)promhttp_now_ns() - (uintptr_t)*con_cls;
+  *con_cls = NULL;
+  promhttp_observer.sent((uint64_t)elapsed, toe == MHD_REQUEST_TERMINATED_COMPLETED_OK, promhttp_observer.arg);
+}
+
+static void promhttp_release_render(void *cls) { prom_collector_registry_render_release((const char *)cls); }
+
+static void promhttp_release_stream(void *cls) {
+  prom_collector_registry_stream_destroy((prom_collector_registry_stream_t *)cls);
+}
+
+static ssize_t promhttp_read_stream(void *cls, uint64_t pos, char *buf, size_t max) {
+  ssize_t n = prom_collector_registry_stream_read((prom_collector_registry_stream_t *)cls, buf, max);
+  if (n < 0) return MHD_CONTENT_READER_END_WITH_ERROR;
+  if (n == 0) return MHD_CONTENT_READER_END_OF_STREAM;
+  return n;
+}
+
+static void promhttp_release_encoded(void *cls) {
+  promhttp_encoded_t *encoded = (promhttp_encoded_t *)cls;
+  if (atomic_fetch_sub(&encoded->refs, 1) == 1) prom_free(encoded);
+}
+
+/**
+ * @brief Returns true if an Accept-Encoding header value accepts gzip, i.e. lists gzip, x-gzip or * without q=0
+ */
+static bool promhttp_accepts_gzip(const char *header) {
+  if (header == NULL) return false;
+  const char *p = header;
+  while (*p != '\0') {
+    while (*p == ' ' || *p == '\t' || *p == ',') p++;
+    const char *coding = p;
+    while (*p != '\0' && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') p++;
+    size_t coding_len = (size_t)(p - coding);
+    bool gzip = (coding_len == 4 && strncasecmp(coding, "gzip", 4) == 0) ||
+                (coding_len == 6 && strncasecmp(coding, "x-gzip", 6) == 0) || (coding_len == 1 && *coding == '*');
+
+    double q = 1.0;
+    while (*p != '\0' && *p != ',') {
+      if (*p == ';') {
+        p++;
+        while (*p == ' ' || *p == '\t') p++;
+        if ((*p == 'q' || *p == 'Q') && p[1] == '=') {
+          char *end = NULL;
+          q = strtod(p + 2, &end);
+          p = end;
+          continue;
+        }
+      } else {
+        p++;
+      }
+    }
+    if (gzip && q > 0) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Returns true if the len bytes at token are expected, ignoring case
+ */
+static bool promhttp_token_equals(const char *token, size_t len, const char *expected) {
+  return strlen(expected) == len && strncasecmp(token, expected, len) == 0;
+}
+
+/**
+ * @brief Returns the exposition format preferred by an Accept header value
+ *
+ * Each media range is weighed by its q parameter and the first range with the highest weight wins. The protobuf format
+ * is only chosen when asked for with proto=io.prometheus.client.MetricFamily and encoding=delimited. The text format
+ * is returned when the header is missing or lists none of the supported formats.
+ */
+static prom_exposition_format_t promhttp_negotiate_format(const char *header) {
+  prom_exposition_format_t best = PROM_EXPOSITION_TEXT;
+  double best_q = 0.0;
+  if (header == NULL) return best;
+
+  const char *p = header;
+  while (*p != '\0') {
+    while (*p == ' ' || *p == '\t' || *p == ',') p++;
+    const char *type = p;
+    while (*p != '\0' && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') p++;
+    size_t type_len = (size_t)(p - type);
+
+    double q = 1.0;
+    bool metric_family = false;
+    bool delimited = false;
+    while (*p != '\0' && *p != ',') {
+      if (*p != ';') {
+        p++;
+        continue;
+      }
+      p++;
+      while (*p == ' ' || *p == '\t') p++;
+      const char *name = p;
+      while (*p != '\0' && *p != '=' && *p != ';' && *p != ',') p++;
+      size_t name_len = (size_t)(p - name);
+      if (*p != '=') continue;
+      p++;
+
+      const char *value = p;
+      size_t value_len = 0;
+      if (*p == '"') {
+        value = ++p;
+        while (*p != '\0' && *p != '"') p++;
+        value_len = (size_t)(p - value);
+        if (*p == '"') p++;
+      } else {
+        while (*p != '\0' && *p != ';' && *p != ',' && *p != ' ' && *p != '\t') p++;
+        value_len = (size_t)(p - value);
+      }
+
+      if (promhttp_token_equals(name, name_len, "q")) {
+        q = strtod(value, NULL);
+      } else if (promhttp_token_equals(name, name_len, "proto")) {
+        metric_family = promhttp_token_equals(value, value_len, "io.prometheus.client.MetricFamily");
+      } else if (promhttp_token_equals(name, name_len, "encoding")) {
+        delimited = promhttp_token_equals(value, value_len, "delimited");
+      }
+    }
+
+    int format = -1;
+    if (promhttp_token_equals(type, type_len, "application/vnd.google.protobuf")) {
+      if (metric_family && delimited) format = PROM_EXPOSITION_PROTOBUF;
+    } else if (promhttp_token_equals(type, type_len, "application/openmetrics-text")) {
+      format = PROM_EXPOSITION_OPENMETRICS;
+    } else if (promhttp_token_equals(type, type_len, "text/plain") || promhttp_token_equals(type, type_len, "text/*") ||
+               promhttp_token_equals(type, type_len, "*/*")) {
+      format = PROM_EXPOSITION_TEXT;
+    }
+    if (format >= 0 && q > best_q) {
+      best = (prom_exposition_format_t)format;
+      best_q = q;
+    }
+  }
+  return best;
+}
+
+/**
+ * @brief Copies the len bytes at name into out if they form a metric name that fits
+ */
+static bool promhttp_copy_name(const char *name, size_t len, char *out) {
+  if (len == 0 || len >= PROMHTTP_FILTER_NAME_MAX) return false;
+  memcpy(out, name, len);
+  out[len] = '\0';
+  return true;
+}
+
+static bool promhttp_is_name_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == ':';
+}
+
+/**
+ * @brief Extracts the metric name of a match[] selector into out
+ *
+ * Only selectors naming a single metric are supported: name, name{} and {__name__="name"}. Selectors on other labels
+ * or with regular expressions would need the samples to be filtered one by one, which the render index cannot do.
+ */
+static bool promhttp_parse_selector(const char *selector, char *out) {
+  const char *p = selector;
+  while (*p == ' ') p++;
+
+  const char *name = p;
+  size_t name_len = 0;
+  if (*p != '{') {
+    while (promhttp_is_name_char(*p)) p++;
+    name_len = (size_t)(p - name);
+    while (*p == ' ') p++;
+    if (*p == '{') {
+      p++;
+      while (*p == ' ') p++;
+      if (*p++ != '}') return false;
+    }
+  } else {
+    p++;
+    while (*p == ' ') p++;
+    if (strncmp(p, "__name__", 8) != 0) return false;
+    p += 8;
+    while (*p == ' ') p++;
+    if (*p++ != '=') return false;
+    while (*p == ' ') p++;
+    if (*p++ != '"') return false;
+    name = p;
+    while (promhttp_is_name_char(*p)) p++;
+    name_len = (size_t)(p - name);
+    if (*p++ != '"') return false;
+    while (*p == ' ') p++;
+    if (*p++ != '}') return false;
+  }
+  while (*p == ' ') p++;
+  return *p == '\0' && promhttp_copy_name(name, name_len, out);
+}
+
+/**
+ * @brief MHD_KeyValueIterator collecting the name[] and match[] arguments of a scrape into a promhttp_filter_t
+ */
+static enum MHD_Result promhttp_collect_filter(void *cls, enum MHD_ValueKind kind, const char *key, const char *value) {
+  promhttp_filter_t *filter = (promhttp_filter_t *)cls;
+  bool is_name = strcmp(key, "name[]") == 0;
+  if (!is_name && strcmp(key, "match[]") != 0) return MHD_YES;
+
+  if (value == NULL || filter->count == PROMHTTP_FILTER_MAX) {
+    filter->invalid = true;
+    return MHD_NO;
+  }
+  char *name = filter->names[filter->count];
+  if (is_name ? !promhttp_copy_name(value, strlen(value), name) : !promhttp_parse_selector(value, name)) {
+    filter->invalid = true;
+    return MHD_NO;
+  }
+  filter->count++;
+  return MHD_YES;
+}
+
+static void promhttp_free_body(void *cls) { prom_free(cls); }
+
+int promhttp_add_endpoint(const char *url, const char *content_type, promhttp_endpoint_fn *render, void *arg) {
+  if (url == NULL || content_type == NULL || render == NULL) return 1;
+  if (promhttp_endpoint_count == PROMHTTP_ENDPOINT_MAX) return 1;
+  promhttp_endpoints[promhttp_endpoint_count++] = (promhttp_endpoint_t){url, content_type, render, arg};
+  return 0;
+}
+
+const char *promhttp_request_argument(const promhttp_request_t *request, const char *key) {
+  return MHD_lookup_connection_value(request->connection, MHD_GET_ARGUMENT_KIND, key);
+}
+
+void promhttp_request_set_status(promhttp_request_t *request, unsigned int status) { request->status = status; }
+
+/**
+ * @brief Renders an endpoint into a buffer owned by the response
+ *
+ * The body is rendered again into a larger buffer while it does not fit. The state it reports may grow in between, so
+ * the new buffer leaves some room on top of the length that was asked for.
+ */
+static enum MHD_Result promhttp_queue_endpoint(struct MHD_Connection *connection, const promhttp_endpoint_t *endpoint) {
+  promhttp_request_t request = {connection, MHD_HTTP_OK};
+  size_t size = PROMHTTP_ENDPOINT_BUFFER_SIZE;
+  char *body = NULL;
+  size_t len = 0;
+  for (int attempt = 0; attempt < PROMHTTP_ENDPOINT_ATTEMPTS; attempt++) {
+    body = (char *)prom_malloc(size);
+    if (body == NULL) return MHD_NO;
+    len = endpoint->render(endpoint->arg, &request, body, size);
+    if (len < size) break;
+    prom_free(body);
+    body = NULL;
+    size = len + len / 8 + 1;
+  }
+  if (body == NULL) return MHD_NO;
+
+  struct MHD_Response *response = MHD_create_response_from_buffer_with_free_callback(len, body, &promhttp_free_body);
+  if (response == NULL) {
+    prom_free(body);
+    return MHD_NO;
+  }
+  MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, endpoint->content_type);
+  MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, "no-store");
+  enum MHD_Result ret = MHD_queue_response(connection, request.status, response);
+  MHD_destroy_response(response);
+  return ret;
+}
+
+/**
+ * @brief Queues the families of the filtered metrics, copied out of a render which is then released
+ *
+ * Each family is found through the render index and copied once; names without a family are skipped and names asked
+ * for twice are sent once.
+ */
+static enum MHD_Result promhttp_queue_filtered(struct MHD_Connection *connection, prom_exposition_format_t format,
+                                               const char *render, const promhttp_filter_t *filter) {
+  const char *parts[PROMHTTP_FILTER_MAX];
+  size_t lens[PROMHTTP_FILTER_MAX];
+  size_t count = 0;
+  size_t total = 0;
+  for (size_t i = 0; i < filter->count; i++) {
+    size_t len = 0;
+    const char *part = prom_collector_registry_render_find(render, filter->names[i], &len);
+    if (part == NULL) continue;
+    bool seen = false;
+    for (size_t j = 0; j < count && !seen; j++) seen = parts[j] == part;
+    if (seen) continue;
+    parts[count] = part;
+    lens[count] = len;
+    total += len;
+    count++;
+  }
+
+  const char *eof = format == PROM_EXPOSITION_OPENMETRICS ? "# EOF\n" : "";
+  size_t eof_len = strlen(eof);
+  char *body = (char *)prom_malloc(total + eof_len + 1);
+  if (body == NULL) {
+    prom_collector_registry_render_release(render);
+    return MHD_NO;
+  }
+  size_t offset = 0;
+  for (size_t i = 0; i < count; i++) {
+    memcpy(body + offset, parts[i], lens[i]);
+    offset += lens[i];
+  }
+  memcpy(body + offset, eof, eof_len);
+  prom_collector_registry_render_release(render);
+
+  struct MHD_Response *response =
+      MHD_create_response_from_buffer_with_free_callback(total + eof_len, body, &promhttp_free_body);
+  if (response == NULL) {
+    prom_free(body);
+    return MHD_NO;
+  }
+  MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, promhttp_content_types[format]);
+  MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, "Accept, Accept-Encoding");
+  enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+  MHD_destroy_response(response);
+  return ret;
+}
+
+/**
+ * @brief Compresses data into a gzip stream, returned with a single reference
+ */
+static promhttp_encoded_t *promhttp_gzip(const char *data, size_t len) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // 15 window bits plus 16 selects the gzip wrapper rather than the zlib one
+  if (deflateInit2(&stream, PROMHTTP_GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return NULL;
+
+  size_t bound = deflateBound(&stream, len);
+  promhttp_encoded_t *encoded = (promhttp_encoded_t *)prom_malloc(sizeof(promhttp_encoded_t) + bound);
+  if (encoded == NULL) {
+    deflateEnd(&stream);
+    return NULL;
+  }
+
+  // The output buffer is sized by deflateBound, so a single pass consumes the whole input
+  stream.next_in = (Bytef *)data;
+  stream.avail_in = (uInt)len;
+  stream.next_out = (Bytef *)encoded->data;
+  stream.avail_out = (uInt)bound;
+  int r = deflate(&stream, Z_FINISH);
+  encoded->len = stream.total_out;
+  deflateEnd(&stream);
+  if (r != Z_STREAM_END) {
+    prom_free(encoded);
+    return NULL;
+  }
+
+  atomic_init(&encoded->refs, 1);
+  encoded->registry = NULL;
+  encoded->generation = 0;
+  return encoded;
+}
+
+/**
+ * @brief Returns the gzip copy of a render, compressing it only if the cache of its format holds another generation
+ *
+ * The caller owns one reference to the result and releases it with promhttp_release_encoded.
+ */
+static promhttp_encoded_t *promhttp_gzip_acquire(const prom_collector_registry_t *registry,
+                                                 prom_exposition_format_t format, const char *render, size_t len) {
+  uint64_t generation = prom_collector_registry_render_generation(render);
+
+  // Compressing under the lock makes concurrent scrapes of a new generation wait for one compression instead of
+  // each running their own
+  pthread_mutex_lock(&promhttp_gzip_lock);
+  promhttp_encoded_t *cached = promhttp_gzip_cache[format];
+  if (cached != NULL && cached->registry == registry && cached->generation == generation) {
+    atomic_fetch_add(&cached->refs, 1);
+    pthread_mutex_unlock(&promhttp_gzip_lock);
+    return cached;
+  }
+
+  promhttp_encoded_t *encoded = promhttp_gzip(render, len);
+  if (encoded != NULL) {
+    encoded->registry = registry;
+    encoded->generation = generation;
+    // A render older than the cached one is served without replacing it
+    if (cached == NULL || cached->registry != registry || cached->generation < generation) {
+      atomic_fetch_add(&encoded->refs, 1);
+      promhttp_gzip_cache[format] = encoded;
+      if (cached != NULL) promhttp_release_encoded(cached);
+    }
+  }
+  pthread_mutex_unlock(&promhttp_gzip_lock);
+  return encoded;
+}
+
 enum MHD_Result promhttp_handler(void *cls, struct MHD_Connection *connection, const char *url, const char *method,
                                  const char *version, const char *upload_data, long unsigned int *upload_data_size, void **con_cls) {
   if (strcmp(method, "GET") != 0) {
@@ -46,12 +541,97 @@ enum MHD_Result promhttp_handler(void *cls, struct MHD_Connection *connection, c
     return ret;
   }
   if (strcmp(url, "/metrics") == 0) {
-    const char *buf = prom_collector_registry_bridge(PROM_ACTIVE_REGISTRY);
-    struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_MUST_FREE);
+    PROMHTTP_TRACE1(scrape__start, connection);
+    // Collected before the render is timed, so that the observer only sees the cost of the exposition
+    if (promhttp_collect != NULL) promhttp_collect(promhttp_collect_arg);
+    uint64_t start_ns = promhttp_observer.rendered != NULL ? promhttp_now_ns() : 0;
+    unsigned long long allocations = prom_alloc_thread_allocations();
+    prom_exposition_format_t format =
+        promhttp_negotiate_format(MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT));
+
+    promhttp_filter_t filter;
+    filter.count = 0;
+    filter.invalid = false;
+    MHD_get_connection_values(connection, MHD_GET_ARGUMENT_KIND, &promhttp_collect_filter, &filter);
+    if (filter.invalid) {
+      char *err = "Unsupported metric filter\n";
+      struct MHD_Response *response = MHD_create_response_from_buffer(strlen(err), (void *)err, MHD_RESPMEM_PERSISTENT);
+      enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, response);
+      MHD_destroy_response(response);
+      return ret;
+    }
+
+    // The daemon passes the stream chunk size as the handler closure; 0 serves from the render cache. Filtered scrapes
+    // are always served from the cache, where the index of the render finds their families.
+    size_t stream_chunk_size = (size_t)(uintptr_t)cls;
+    if (stream_chunk_size > 0 && filter.count == 0) {
+      prom_collector_registry_stream_t *stream = prom_collector_registry_stream_new(PROM_ACTIVE_REGISTRY, format);
+      if (stream == NULL) return MHD_NO;
+      struct MHD_Response *response = MHD_create_response_from_callback(
+          MHD_SIZE_UNKNOWN, stream_chunk_size, &promhttp_read_stream, stream, &promhttp_release_stream);
+      if (response == NULL) {
+        prom_collector_registry_stream_destroy(stream);
+        return MHD_NO;
+      }
+      MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, promhttp_content_types[format]);
+      MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, "Accept, Accept-Encoding");
+      promhttp_mark_queued(con_cls);
+      enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+      MHD_destroy_response(response);
+      return ret;
+    }
+
+    // The render is shared with concurrent scrapes and released by MHD once the response has been sent
+    size_t len = 0;
+    const char *buf = prom_collector_registry_render_acquire_format(PROM_ACTIVE_REGISTRY, format, &len);
+    if (buf == NULL) {
+      char *err = "Internal Server Error\n";
+      struct MHD_Response *response = MHD_create_response_from_buffer(strlen(err), (void *)err, MHD_RESPMEM_PERSISTENT);
+      enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+      MHD_destroy_response(response);
+      return ret;
+    }
+    if (filter.count > 0) return promhttp_queue_filtered(connection, format, buf, &filter);
+
+    struct MHD_Response *response = NULL;
+    size_t body_len = len;
+    const char *accept_encoding =
+        MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+    promhttp_encoded_t *encoded =
+        promhttp_accepts_gzip(accept_encoding) ? promhttp_gzip_acquire(PROM_ACTIVE_REGISTRY, format, buf, len) : NULL;
+    if (encoded != NULL) {
+      // The compressed copy is self-contained, so the render can go back to the registry right away
+      prom_collector_registry_render_release(buf);
+      response = MHD_create_response_from_buffer_with_free_callback_cls(encoded->len, encoded->data,
+                                                                        &promhttp_release_encoded, encoded);
+      if (response == NULL) {
+        promhttp_release_encoded(encoded);
+        return MHD_NO;
+      }
+      MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, "gzip");
+      body_len = encoded->len;
+    } else {
+      response = MHD_create_response_from_buffer_with_free_callback(len, (void *)buf, &promhttp_release_render);
+      if (response == NULL) {
+        prom_collector_registry_render_release(buf);
+        return MHD_NO;
+      }
+    }
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, promhttp_content_types[format]);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, "Accept, Accept-Encoding");
+    if (promhttp_observer.rendered != NULL) {
+      promhttp_observer.rendered(promhttp_now_ns() - start_ns, body_len,
+                                 prom_alloc_thread_allocations() - allocations, promhttp_observer.arg);
+    }
+    PROMHTTP_TRACE1(scrape__rendered, body_len);
+    promhttp_mark_queued(con_cls);
     enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
     MHD_destroy_response(response);
     return ret;
   }
+  for (size_t i = 0; i < promhttp_endpoint_count; i++) {
+    if (strcmp(url, promhttp_endpoints[i].url) == 0) return promhttp_queue_endpoint(connection, &promhttp_endpoints[i]);
+  }
   char *buf = "Bad Request\n";
   struct MHD_Response *response = MHD_create_response_from_buffer(strlen(buf), (void *)buf, MHD_RESPMEM_PERSISTENT);
   enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_BAD_REQUEST, response);
@@ -62,6 +642,39 @@ enum MHD_Result promhttp_handler(void *cls, struct MHD_Connection *connection, c
 
 struct MHD_Daemon *promhttp_start_daemon(unsigned int flags, unsigned short port, MHD_AcceptPolicyCallback apc,
                                          void *apc_cls) {
-  return MHD_start_daemon(flags, port, apc, apc_cls, &promhttp_handler, NULL, MHD_OPTION_END);
+  return MHD_start_daemon(flags, port, apc, apc_cls, &promhttp_handler, NULL, MHD_OPTION_NOTIFY_COMPLETED,
+                          &promhttp_completed, NULL, MHD_OPTION_END);
+}
+
+struct MHD_Daemon *promhttp_start_daemon_with_config(unsigned short port, const promhttp_config_t *config,
+                                                     MHD_AcceptPolicyCallback apc, void *apc_cls) {
+  static const promhttp_config_t defaults = {0};
+  if (config == NULL) config = &defaults;
+
+  unsigned int flags = MHD_USE_INTERNAL_POLLING_THREAD;
+  if (config->mode == PROMHTTP_MODE_EPOLL) flags |= MHD_USE_EPOLL;
+
+  // Only pass the options that were set: a zero connection limit, for one, would refuse every connection
+  struct MHD_OptionItem options[6];
+  size_t count = 0;
+  if (config->thread_pool_size > 1) {
+    options[count++] = (struct MHD_OptionItem){MHD_OPTION_THREAD_POOL_SIZE, config->thread_pool_size, NULL};
+  }
+  if (config->connection_limit > 0) {
+    options[count++] = (struct MHD_OptionItem){MHD_OPTION_CONNECTION_LIMIT, config->connection_limit, NULL};
+  }
+  if (config->per_ip_connection_limit > 0) {
+    options[count++] =
+        (struct MHD_OptionItem){MHD_OPTION_PER_IP_CONNECTION_LIMIT, config->per_ip_connection_limit, NULL};
+  }
+  if (config->connection_timeout > 0) {
+    options[count++] = (struct MHD_OptionItem){MHD_OPTION_CONNECTION_TIMEOUT, config->connection_timeout, NULL};
+  }
+  // Reports the end of every response to the observer, see promhttp_mark_queued
+  options[count++] = (struct MHD_OptionItem){MHD_OPTION_NOTIFY_COMPLETED, (intptr_t)&promhttp_completed, NULL};
+  options[count] = (struct MHD_OptionItem){MHD_OPTION_END, 0, NULL};
+
+  return MHD_start_daemon(flags, port, apc, apc_cls, &promhttp_handler, (void *)(uintptr_t)config->stream_chunk_size,
+                          MHD_OPTION_ARRAY, options, MHD_OPTION_END);
 }
 
@@ -0,0 +1,620 @@
+/**
+ * @file cgroup_table.c
+ * @brief Functions for tracking the cgroup v2 hierarchy and reading the resource usage of every cgroup.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "cgroup_table.h"
+#include "metrics.h"
+#include <errno.h>
+#include <prom_alloc.h>
+#include <prom_procfs.h>
+#include <stdint.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#define CGROUP_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MODIFY | IN_ONLYDIR) /**< Events watched on every cgroup. */
+#define CGROUP_EVENT_BUFFER 4096                                          /**< Size of the inotify event buffer. */
+
+static const char* const cgroup_file_names[CGROUP_FILE_COUNT] = {
+    "cgroup.events", "cpu.stat", "memory.current", "memory.stat", "io.stat",
+}; /**< Names of the files, indexed by CgroupFile. */
+
+int cgroup_table_init(CgroupTable* table, const char* root, cgroup_release_fn release)
+{
+    memset(table, 0, sizeof(*table));
+    table->root = root;
+    table->release = release;
+    table->rescan = true;
+    table->capacity = CGROUP_READ_BUFFER;
+
+    // The rest of the exporter shares the limit, so the table only takes a share of it
+    struct rlimit limit;
+    table->fd_budget = SIZE_MAX;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+    {
+        table->fd_budget = (size_t)limit.rlim_cur / CGROUP_FD_SHARE;
+    }
+
+    table->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (table->inotify_fd < 0)
+    {
+        perror("inotify_init1");
+        return RETURN_ERROR;
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the bucket of a watch descriptor.
+ */
+static CgroupEntry** bucket_of(const CgroupTable* table, int wd)
+{
+    return &table->buckets[(size_t)wd & (table->bucket_count - 1)];
+}
+
+/**
+ * @brief Returns the entry of a watch descriptor, or NULL if the watch is unknown.
+ */
+static CgroupEntry* find_entry(const CgroupTable* table, int wd)
+{
+    if (table->bucket_count == 0)
+    {
+        return NULL;
+    }
+
+    for (CgroupEntry* entry = *bucket_of(table, wd); entry != NULL; entry = entry->next)
+    {
+        if (entry->wd == wd)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+CgroupEntry* cgroup_table_next(const CgroupTable* table, const CgroupEntry* entry)
+{
+    size_t bucket = 0;
+    if (entry != NULL)
+    {
+        if (entry->next != NULL)
+        {
+            return entry->next;
+        }
+        bucket = ((size_t)entry->wd & (table->bucket_count - 1)) + 1;
+    }
+
+    for (; bucket < table->bucket_count; bucket++)
+    {
+        if (table->buckets[bucket] != NULL)
+        {
+            return table->buckets[bucket];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns the entry of a cgroup directory by path; only used when a cgroup is removed.
+ */
+static CgroupEntry* find_path(const CgroupTable* table, const char* path)
+{
+    for (CgroupEntry* entry = cgroup_table_next(table, NULL); entry != NULL; entry = cgroup_table_next(table, entry))
+    {
+        if (strcmp(entry->path, path) == 0)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Doubles the number of buckets, or allocates the first ones.
+ *
+ * @return 0 on success, or -1 if the buckets cannot be allocated.
+ */
+static int grow_buckets(CgroupTable* table)
+{
+    size_t bucket_count = table->bucket_count ? table->bucket_count * 2 : CGROUP_INITIAL_BUCKETS;
+    CgroupEntry** buckets = calloc(bucket_count, sizeof(*buckets));
+    if (buckets == NULL)
+    {
+        perror("calloc");
+        return RETURN_ERROR;
+    }
+
+    for (size_t i = 0; i < table->bucket_count; i++)
+    {
+        CgroupEntry* entry = table->buckets[i];
+        while (entry != NULL)
+        {
+            CgroupEntry* next = entry->next;
+            CgroupEntry** bucket = &buckets[(size_t)entry->wd & (bucket_count - 1)];
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    free(table->buckets);
+    table->buckets = buckets;
+    table->bucket_count = bucket_count;
+    return 0;
+}
+
+/**
+ * @brief Tells the caller to drop the samples of a cgroup that stops being reported.
+ */
+static void release_entry(CgroupTable* table, CgroupEntry* entry)
+{
+    if (entry->reported && table->release != NULL)
+    {
+        table->release(entry);
+    }
+    entry->reported = false;
+    memset(entry->samples, 0, sizeof(entry->samples));
+}
+
+/**
+ * @brief Closes the files of a cgroup.
+ */
+static void close_files(CgroupTable* table, CgroupEntry* entry)
+{
+    for (int f = 0; f < CGROUP_FILE_COUNT; f++)
+    {
+        if (entry->fds[f] >= 0)
+        {
+            close(entry->fds[f]);
+            table->open_fds--;
+        }
+        entry->fds[f] = CGROUP_FD_MISSING;
+    }
+}
+
+/**
+ * @brief Opens a file of a cgroup.
+ *
+ * @return The descriptor, or -1 if the file cannot be opened.
+ */
+static int open_file(const CgroupEntry* entry, CgroupFile file)
+{
+    char path[BUFFER_SIZE];
+    snprintf(path, sizeof(path), "%s/%s", entry->path, cgroup_file_names[file]);
+    return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/**
+ * @brief Opens the files of a cgroup that are not open yet; controllers enabled later add files to it.
+ *
+ * Files are held open while the fd budget allows; the others are only checked for and left CGROUP_FD_UNHELD.
+ */
+static void open_files(CgroupTable* table, CgroupEntry* entry)
+{
+    for (int f = 0; f < CGROUP_FILE_COUNT; f++)
+    {
+        if (entry->fds[f] >= 0)
+        {
+            continue;
+        }
+
+        int fd = open_file(entry, f);
+        if (fd >= 0 && table->open_fds < table->fd_budget)
+        {
+            entry->fds[f] = fd;
+            table->open_fds++;
+        }
+        else if (fd >= 0 || errno == EMFILE || errno == ENFILE)
+        {
+            // Out of descriptors, the file is assumed present and opened again on the next read
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            entry->fds[f] = CGROUP_FD_UNHELD;
+        }
+        else
+        {
+            entry->fds[f] = CGROUP_FD_MISSING;
+        }
+    }
+}
+
+/**
+ * @brief Unlinks and frees the entry of a removed cgroup.
+ */
+static void remove_entry(CgroupTable* table, CgroupEntry* entry)
+{
+    CgroupEntry** link = bucket_of(table, entry->wd);
+    while (*link != entry)
+    {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    table->entry_count--;
+
+    release_entry(table, entry);
+    close_files(table, entry);
+    free(entry->path);
+    free(entry);
+}
+
+/**
+ * @brief Reads a file of a cgroup into the table buffer.
+ *
+ * @return The NUL-terminated contents, or NULL if the file is missing or cannot be read.
+ */
+static const char* read_file(CgroupTable* table, CgroupEntry* entry, CgroupFile file)
+{
+    int fd = entry->fds[file] == CGROUP_FD_UNHELD ? open_file(entry, file) : entry->fds[file];
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    ssize_t n = prom_procfs_read(fd, &table->buffer, &table->capacity, CGROUP_READ_MAX_BUFFER);
+    if (fd != entry->fds[file])
+    {
+        close(fd);
+    }
+    return n >= 0 ? table->buffer : NULL;
+}
+
+/**
+ * @brief Refreshes the populated state of a cgroup from its cgroup.events.
+ */
+static void read_populated(CgroupTable* table, CgroupEntry* entry)
+{
+    // The root cgroup has no cgroup.events and is always populated
+    if (entry->fds[CGROUP_FILE_EVENTS] == CGROUP_FD_MISSING)
+    {
+        entry->populated = true;
+        return;
+    }
+
+    const char* events = read_file(table, entry, CGROUP_FILE_EVENTS);
+    const char* populated = events != NULL ? strstr(events, "populated ") : NULL;
+    entry->populated = populated != NULL && populated[strlen("populated ")] == '1';
+}
+
+/**
+ * @brief Adds a cgroup directory to the table, or marks it seen if it is already tracked.
+ *
+ * @param table The table.
+ * @param path Absolute path of the directory.
+ * @return The entry, or NULL if it cannot be watched or allocated.
+ */
+static CgroupEntry* add_entry(CgroupTable* table, const char* path)
+{
+    // inotify returns the existing watch of a directory that is already watched, which deduplicates the walks
+    int wd = inotify_add_watch(table->inotify_fd, path, CGROUP_WATCH_MASK);
+    if (wd < 0)
+    {
+        if (errno == ENOSPC)
+        {
+            fprintf(stderr, "Error watching %s: inotify watch limit reached\n", path);
+        }
+        return NULL;
+    }
+
+    CgroupEntry* entry = find_entry(table, wd);
+    if (entry != NULL)
+    {
+        entry->seen = true;
+        return entry;
+    }
+
+    if (table->entry_count >= table->bucket_count && grow_buckets(table) != 0)
+    {
+        inotify_rm_watch(table->inotify_fd, wd);
+        return NULL;
+    }
+
+    entry = calloc(1, sizeof(*entry));
+    if (entry == NULL || (entry->path = strdup(path)) == NULL)
+    {
+        perror("calloc");
+        free(entry);
+        inotify_rm_watch(table->inotify_fd, wd);
+        return NULL;
+    }
+
+    size_t root_len = strlen(table->root);
+    entry->name = entry->path[root_len] != '\0' ? entry->path + root_len : "/";
+    entry->wd = wd;
+    entry->seen = true;
+    for (int f = 0; f < CGROUP_FILE_COUNT; f++)
+    {
+        entry->fds[f] = CGROUP_FD_MISSING;
+    }
+    open_files(table, entry);
+    read_populated(table, entry);
+
+    CgroupEntry** bucket = bucket_of(table, wd);
+    entry->next = *bucket;
+    *bucket = entry;
+    table->entry_count++;
+    return entry;
+}
+
+/**
+ * @brief Tells whether a directory entry is a directory; a sysroot may be on a file system that leaves d_type
+ * DT_UNKNOWN, which is then asked with fstatat().
+ */
+static bool is_directory(DIR* dir, const struct dirent* entry)
+{
+    if (entry->d_type != DT_UNKNOWN)
+    {
+        return entry->d_type == DT_DIR;
+    }
+
+    struct stat st;
+    return fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
+
+/**
+ * @brief Adds a cgroup and every cgroup below it to the table.
+ *
+ * @param table The table.
+ * @param path Absolute path of the cgroup directory.
+ */
+static void walk(CgroupTable* table, const char* path)
+{
+    if (add_entry(table, path) == NULL)
+    {
+        return;
+    }
+
+    DIR* dir = opendir(path);
+    if (dir == NULL)
+    {
+        return;
+    }
+
+    const struct dirent* child;
+    while ((child = readdir(dir)) != NULL)
+    {
+        if (child->d_name[0] == '.' || !is_directory(dir, child))
+        {
+            continue;
+        }
+
+        char child_path[BUFFER_SIZE];
+        if (snprintf(child_path, sizeof(child_path), "%s/%s", path, child->d_name) < (int)sizeof(child_path))
+        {
+            walk(table, child_path);
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * @brief Walks the whole hierarchy again and drops the cgroups it no longer lists.
+ */
+static void rescan(CgroupTable* table)
+{
+    table->rescan = false;
+    for (CgroupEntry* entry = cgroup_table_next(table, NULL); entry != NULL; entry = cgroup_table_next(table, entry))
+    {
+        entry->seen = false;
+    }
+
+    walk(table, table->root);
+
+    for (size_t i = 0; i < table->bucket_count; i++)
+    {
+        CgroupEntry* entry = table->buckets[i];
+        while (entry != NULL)
+        {
+            CgroupEntry* next = entry->next;
+            if (!entry->seen)
+            {
+                inotify_rm_watch(table->inotify_fd, entry->wd);
+                remove_entry(table, entry);
+            }
+            entry = next;
+        }
+    }
+}
+
+/**
+ * @brief Applies one inotify event to the table.
+ */
+static void handle_event(CgroupTable* table, const struct inotify_event* event)
+{
+    if (event->mask & IN_Q_OVERFLOW)
+    {
+        table->rescan = true;
+        return;
+    }
+
+    CgroupEntry* entry = find_entry(table, event->wd);
+    if (entry == NULL)
+    {
+        return;
+    }
+
+    // A watch dropped by the kernel, such as when the hierarchy is unmounted, is reported with IN_IGNORED
+    if (event->mask & IN_IGNORED)
+    {
+        remove_entry(table, entry);
+        return;
+    }
+
+    if ((event->mask & (IN_CREATE | IN_DELETE)) && (event->mask & IN_ISDIR) && event->len > 0)
+    {
+        char path[BUFFER_SIZE];
+        if (snprintf(path, sizeof(path), "%s/%s", entry->path, event->name) >= (int)sizeof(path))
+        {
+            return;
+        }
+
+        if (event->mask & IN_CREATE)
+        {
+            walk(table, path);
+            return;
+        }
+
+        // The open files pin the directory, so its own IN_DELETE_SELF only arrives once they are closed; the removal
+        // is taken from the IN_DELETE of the parent instead
+        CgroupEntry* child = find_path(table, path);
+        if (child != NULL)
+        {
+            inotify_rm_watch(table->inotify_fd, child->wd);
+            remove_entry(table, child);
+        }
+    }
+    else if ((event->mask & IN_MODIFY) && event->len > 0 && strcmp(event->name, "cgroup.events") == 0)
+    {
+        open_files(table, entry);
+        read_populated(table, entry);
+    }
+}
+
+/**
+ * @brief Reads every pending inotify event.
+ */
+static void drain_events(CgroupTable* table)
+{
+    // Aligned so that the events, which start with an int, can be read in place
+    char buffer[CGROUP_EVENT_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t n;
+    while ((n = read(table->inotify_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char* p = buffer; p < buffer + n;)
+        {
+            const struct inotify_event* event = (const struct inotify_event*)p;
+            handle_event(table, event);
+            p += sizeof(*event) + event->len;
+        }
+    }
+}
+
+/**
+ * @brief Returns the value following a key at the start of a line, such as "usage_usec 123".
+ *
+ * @return 0 on success, or -1 if the key is missing.
+ */
+static int find_key(const char* buffer, const char* key, unsigned long long* value)
+{
+    size_t len = strlen(key);
+    for (const char* line = buffer; line != NULL && *line != '\0';)
+    {
+        if (strncmp(line, key, len) == 0 && line[len] == ' ')
+        {
+            *value = strtoull(line + len + 1, NULL, 10);
+            return 0;
+        }
+        line = strchr(line, '\n');
+        line = line != NULL ? line + 1 : NULL;
+    }
+    return RETURN_ERROR;
+}
+
+/**
+ * @brief Sets a value of a cgroup from a key of one of its files.
+ */
+static void set_key(CgroupEntry* entry, CgroupStat stat, const char* buffer, const char* key, double scale)
+{
+    unsigned long long value;
+    entry->valid[stat] = buffer != NULL && find_key(buffer, key, &value) == 0;
+    entry->values[stat] = entry->valid[stat] ? (double)value * scale : 0.0;
+}
+
+/**
+ * @brief Sums the rbytes and wbytes fields of every device of io.stat.
+ */
+static void read_io_stat(CgroupEntry* entry, const char* buffer)
+{
+    entry->valid[CGROUP_IO_READ] = entry->valid[CGROUP_IO_WRITE] = buffer != NULL;
+    unsigned long long read_bytes = 0;
+    unsigned long long write_bytes = 0;
+    for (const char* p = buffer; p != NULL && (p = strstr(p, "bytes=")) != NULL; p += strlen("bytes="))
+    {
+        // Lines read "8:0 rbytes=N wbytes=N rios=N wios=N dbytes=N dios=N"
+        if (p > buffer && p[-1] == 'r')
+        {
+            read_bytes += strtoull(p + strlen("bytes="), NULL, 10);
+        }
+        else if (p > buffer && p[-1] == 'w')
+        {
+            write_bytes += strtoull(p + strlen("bytes="), NULL, 10);
+        }
+    }
+    entry->counts[CGROUP_IO_READ] = read_bytes;
+    entry->counts[CGROUP_IO_WRITE] = write_bytes;
+    entry->values[CGROUP_IO_READ] = (double)read_bytes;
+    entry->values[CGROUP_IO_WRITE] = (double)write_bytes;
+}
+
+/**
+ * @brief Reads the files of one cgroup.
+ */
+static void read_entry(CgroupTable* table, CgroupEntry* entry)
+{
+    const char* buffer = read_file(table, entry, CGROUP_FILE_CPU_STAT);
+    set_key(entry, CGROUP_CPU_USAGE, buffer, "usage_usec", 1e-6);
+    set_key(entry, CGROUP_CPU_THROTTLED, buffer, "throttled_usec", 1e-6);
+
+    buffer = read_file(table, entry, CGROUP_FILE_MEMORY_CURRENT);
+    entry->valid[CGROUP_MEMORY_CURRENT] = buffer != NULL;
+    entry->values[CGROUP_MEMORY_CURRENT] = buffer != NULL ? (double)strtoull(buffer, NULL, 10) : 0.0;
+
+    buffer = read_file(table, entry, CGROUP_FILE_MEMORY_STAT);
+    set_key(entry, CGROUP_MEMORY_ANON, buffer, "anon", 1.0);
+    set_key(entry, CGROUP_MEMORY_FILE, buffer, "file", 1.0);
+
+    read_io_stat(entry, read_file(table, entry, CGROUP_FILE_IO_STAT));
+}
+
+int cgroup_table_read(CgroupTable* table)
+{
+    drain_events(table);
+    if (table->rescan)
+    {
+        rescan(table);
+    }
+    if (table->entry_count == 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    for (CgroupEntry* entry = cgroup_table_next(table, NULL); entry != NULL; entry = cgroup_table_next(table, entry))
+    {
+        if (!entry->populated)
+        {
+            release_entry(table, entry);
+            continue;
+        }
+
+        read_entry(table, entry);
+        entry->reported = true;
+    }
+    return 0;
+}
+
+void cgroup_table_free(CgroupTable* table)
+{
+    for (size_t i = 0; i < table->bucket_count; i++)
+    {
+        CgroupEntry* entry = table->buckets[i];
+        while (entry != NULL)
+        {
+            CgroupEntry* next = entry->next;
+            remove_entry(table, entry);
+            entry = next;
+        }
+    }
+    free(table->buckets);
+    prom_free(table->buffer);
+    table->buckets = NULL;
+    table->bucket_count = 0;
+    table->buffer = NULL;
+    if (table->inotify_fd >= 0)
+    {
+        close(table->inotify_fd);
+        table->inotify_fd = -1;
+    }
+}
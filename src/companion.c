@@ -0,0 +1,260 @@
+/**
+ * @file companion.c
+ * @brief Functions for launching the Prometheus and Grafana servers with posix_spawn and restarting them on exit.
+ * @author 1v6n
+ * @date 15/10/2026
+ */
+
+#define _GNU_SOURCE // Required for POSIX_SPAWN_SETSID
+
+#include "companion.h"
+#include "metrics.h"
+#include <errno.h>
+#include <pwd.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+static const char* const companion_names[COMPANION_COUNT] = {
+    "prometheus",
+    "grafana",
+}; /**< Names of the companions, indexed by CompanionKind. */
+
+static const char* companion_label_keys[] = {"name"}; /**< Label keys of the companion metrics. */
+
+static uint64_t monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Returns the home directory of the user, from HOME or else from the password database.
+ */
+static const char* home_directory(void)
+{
+    const char* home = getenv("HOME");
+    if (home != NULL && *home != '\0')
+    {
+        return home;
+    }
+    struct passwd* pw = getpwuid(getuid());
+    return pw ? pw->pw_dir : NULL;
+}
+
+/**
+ * @brief Formats an argument of a companion into its storage and appends it to its command line.
+ *
+ * @return 0 on success, or -1 if the argument does not fit.
+ */
+static int add_argument(Companion* companion, size_t* argc, const char* format, const char* home)
+{
+    if (*argc + 1 >= COMPANION_MAX_ARGS)
+    {
+        return RETURN_ERROR;
+    }
+    char* arg = companion->paths[*argc];
+    int len = snprintf(arg, COMPANION_PATH_SIZE, format, home, home);
+    if (len < 0 || len >= COMPANION_PATH_SIZE)
+    {
+        return RETURN_ERROR;
+    }
+    companion->argv[(*argc)++] = arg;
+    companion->argv[*argc] = NULL;
+    return 0;
+}
+
+/**
+ * @brief Builds the command line of a companion, as the monitor used to run it through the shell.
+ */
+static int build_command(Companion* companion, CompanionKind kind, const char* home)
+{
+    size_t argc = 0;
+    int result = 0;
+    switch (kind)
+    {
+    case COMPANION_PROMETHEUS:
+        result |= add_argument(companion, &argc, "%s/prometheus/prometheus", home);
+        result |= add_argument(companion, &argc, "--config.file=%s/prometheus/prometheus.yml", home);
+        break;
+    case COMPANION_GRAFANA:
+        result |= add_argument(companion, &argc, "%s/grafana/bin/grafana", home);
+        result |= add_argument(companion, &argc, "server", home);
+        result |= add_argument(companion, &argc, "--config", home);
+        result |= add_argument(companion, &argc, "%s/grafana/conf/defaults.ini", home);
+        result |= add_argument(companion, &argc, "--homepath", home);
+        result |= add_argument(companion, &argc, "%s/grafana", home);
+        break;
+    default:
+        return RETURN_ERROR;
+    }
+    return result != 0 ? RETURN_ERROR : 0;
+}
+
+int companions_open(Companions* companions, const char* list)
+{
+    memset(companions, 0, sizeof(*companions));
+
+    const char* home = home_directory();
+    if (home == NULL)
+    {
+        fprintf(stderr, "Failed to retrieve home directory, no companion is started\n");
+        return RETURN_ERROR;
+    }
+
+    for (const char* p = list; *p != '\0';)
+    {
+        size_t len = strcspn(p, ",");
+        int kind = 0;
+        while (kind < COMPANION_COUNT &&
+               (strlen(companion_names[kind]) != len || strncmp(p, companion_names[kind], len) != 0))
+        {
+            kind++;
+        }
+        if (len > 0 && kind == COMPANION_COUNT)
+        {
+            fprintf(stderr, "Error: unknown companion '%.*s'\n", (int)len, p);
+            return RETURN_ERROR;
+        }
+        if (len > 0)
+        {
+            Companion* companion = &companions->companions[kind];
+            if (build_command(companion, (CompanionKind)kind, home) != 0)
+            {
+                fprintf(stderr, "Error: the home directory is too long to start %s\n", companion_names[kind]);
+                return RETURN_ERROR;
+            }
+            companion->enabled = true;
+            companion->backoff_ms = COMPANION_MIN_BACKOFF_MS;
+        }
+        p += len;
+        p += *p == ',';
+    }
+
+    companions->up_metric = prom_gauge_new("companion_up", "Whether each companion server is running", 1,
+                                           companion_label_keys);
+    if (companions->up_metric == NULL ||
+        prom_collector_registry_register_metric((prom_metric_t*)companions->up_metric) != 0)
+    {
+        fprintf(stderr, "Error registering metric 'companion_up'\n");
+        if (companions->up_metric != NULL)
+        {
+            prom_gauge_destroy(companions->up_metric);
+        }
+        companions->up_metric = NULL;
+    }
+    companions->starts_metric =
+        prom_counter_new("companion_starts_total", "Times each companion server was started", 1, companion_label_keys);
+    if (companions->starts_metric == NULL ||
+        prom_collector_registry_register_metric((prom_metric_t*)companions->starts_metric) != 0)
+    {
+        fprintf(stderr, "Error registering metric 'companion_starts_total'\n");
+        if (companions->starts_metric != NULL)
+        {
+            prom_counter_destroy(companions->starts_metric);
+        }
+        companions->starts_metric = NULL;
+    }
+    return 0;
+}
+
+/**
+ * @brief Starts a companion without going through a shell.
+ *
+ * The child gets its own session, so that a terminal interrupt aimed at the monitor does not reach it, and the signal
+ * mask and dispositions of a plain process rather than those of the supervising thread.
+ */
+static int spawn_companion(Companion* companion, const char* name)
+{
+    posix_spawnattr_t attr;
+    if (posix_spawnattr_init(&attr) != 0)
+    {
+        return RETURN_ERROR;
+    }
+    sigset_t empty;
+    sigset_t defaults;
+    sigemptyset(&empty);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigmask(&attr, &empty);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid;
+    int error = posix_spawn(&pid, companion->argv[0], NULL, &attr, companion->argv, environ);
+    posix_spawnattr_destroy(&attr);
+    if (error != 0)
+    {
+        fprintf(stderr, "Failed to start %s from %s: %s\n", name, companion->argv[0], strerror(error));
+        return RETURN_ERROR;
+    }
+    printf("%s started with pid %d\n", name, (int)pid);
+    companion->pid = pid;
+    return 0;
+}
+
+/**
+ * @brief Holds the next start of a companion back by its delay, and doubles the delay.
+ */
+static void delay_next_start(Companion* companion, uint64_t now)
+{
+    companion->next_start_ms = now + companion->backoff_ms;
+    companion->backoff_ms =
+        companion->backoff_ms * 2 < COMPANION_MAX_BACKOFF_MS ? companion->backoff_ms * 2 : COMPANION_MAX_BACKOFF_MS;
+}
+
+void companions_supervise(Companions* companions)
+{
+    uint64_t now = monotonic_ms();
+    for (int kind = 0; kind < COMPANION_COUNT; kind++)
+    {
+        Companion* companion = &companions->companions[kind];
+        const char* label_values[] = {companion_names[kind]};
+        if (!companion->enabled)
+        {
+            continue;
+        }
+
+        int status;
+        if (companion->pid > 0 && waitpid(companion->pid, &status, WNOHANG) == companion->pid)
+        {
+            if (WIFEXITED(status))
+            {
+                fprintf(stderr, "%s exited with status %d\n", companion_names[kind], WEXITSTATUS(status));
+            }
+            else if (WIFSIGNALED(status))
+            {
+                fprintf(stderr, "%s was killed by signal %d\n", companion_names[kind], WTERMSIG(status));
+            }
+            companion->pid = 0;
+
+            // A companion that ran for a while is started again right away, one that keeps exiting less and less often
+            if (now - companion->started_ms >= COMPANION_STABLE_MS)
+            {
+                companion->backoff_ms = COMPANION_MIN_BACKOFF_MS;
+            }
+            delay_next_start(companion, now);
+        }
+
+        if (companion->pid == 0 && now >= companion->next_start_ms)
+        {
+            companion->started_ms = now;
+            if (spawn_companion(companion, companion_names[kind]) != 0)
+            {
+                delay_next_start(companion, now);
+            }
+            else if (companions->starts_metric != NULL)
+            {
+                prom_counter_inc(companions->starts_metric, label_values);
+            }
+        }
+
+        if (companions->up_metric != NULL)
+        {
+            prom_gauge_set(companions->up_metric, companion->pid > 0 ? 1.0 : 0.0, label_values);
+        }
+    }
+}
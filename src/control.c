@@ -0,0 +1,475 @@
+/**
+ * @file control.c
+ * @brief Functions for changing the selected metrics through a long-lived control FIFO.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "control.h"
+#include "expose_metrics.h"
+#include "status.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+
+#define CONTROL_STATUS_SIZE 256 /**< Buffer size of a status message. */
+
+/**
+ * @brief Reports the outcome of a command.
+ */
+static void report_status(const ControlChannel* control, const char* format, ...)
+{
+    char status[CONTROL_STATUS_SIZE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(status, sizeof(status), format, args);
+    va_end(args);
+
+    if (control->report != NULL)
+    {
+        control->report(status);
+    }
+    if (strncmp(status, "Error", strlen("Error")) == 0)
+    {
+        fprintf(stderr, "%s\n", status);
+    }
+}
+
+/**
+ * @brief Strips the whitespace around a token in place.
+ */
+static char* trim(char* token)
+{
+    while (isspace((unsigned char)*token))
+    {
+        token++;
+    }
+    char* end = token + strlen(token);
+    while (end > token && isspace((unsigned char)end[-1]))
+    {
+        end--;
+    }
+    *end = '\0';
+    return token;
+}
+
+/**
+ * @brief Schedules the collectors of the selected metrics, at the shortest interval each of them is needed at.
+ */
+static int apply_selection(ControlChannel* control)
+{
+    CollectorDispatch dispatch;
+    dispatch_init(&dispatch);
+
+    int result = 0;
+    for (size_t i = 0; i < control->metric_count; i++)
+    {
+        if (!control->selected[i])
+        {
+            continue;
+        }
+        unsigned int interval_ms = control->intervals[i] != 0 ? control->intervals[i] : all_metrics[i].interval_ms;
+        if (dispatch_add(&dispatch, all_metrics[i].update_function, interval_ms) != 0)
+        {
+            result = RETURN_ERROR;
+        }
+    }
+
+    add_export_collectors(&dispatch);
+    status_set_selection(control->selected, control->metric_count);
+
+    if (scheduler_update(control->scheduler, &dispatch) != 0)
+    {
+        result = RETURN_ERROR;
+    }
+    watch_collector_events(control->scheduler);
+    return result;
+}
+
+/**
+ * @brief Context of a command applied to every metric selected by its patterns.
+ */
+typedef struct
+{
+    ControlChannel* control;  /**< The channel. */
+    unsigned int interval_ms; /**< Interval set by the interval command. */
+    int result;               /**< 0, or -1 once a metric could not be changed. */
+} ControlVisit;
+
+/**
+ * @brief Calls a function on the metrics selected by every pattern of a comma-separated list.
+ *
+ * @return 0, or -1 if a pattern selects no metric.
+ */
+static int visit_patterns(ControlChannel* control, char* list, metric_visit_fn visit, void* arg)
+{
+    int result = 0;
+    char* save = NULL;
+    for (char* token = strtok_r(list, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save))
+    {
+        char* pattern = trim(token);
+        if (*pattern != '\0' && match_metrics(pattern, visit, arg) == 0)
+        {
+            report_status(control, "Error: No metric matches '%s'", pattern);
+            result = RETURN_ERROR;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Selects a metric, registering it unless it still is.
+ */
+static void select_metric(const MetricInfo* info, void* arg)
+{
+    ControlVisit* visit = arg;
+    ControlChannel* control = visit->control;
+    size_t index = (size_t)(info - all_metrics);
+    if (control->selected[index])
+    {
+        return;
+    }
+    if (!control->registered[index] && register_metric(info) != 0)
+    {
+        report_status(control, "Error: Could not register metric '%s'", info->name);
+        visit->result = RETURN_ERROR;
+        return;
+    }
+    control->registered[index] = true;
+    control->selected[index] = true;
+    control->selected_count++;
+}
+
+/**
+ * @brief Deselects a metric; it is unregistered once its collector is no longer scheduled for it.
+ */
+static void deselect_metric(const MetricInfo* info, void* arg)
+{
+    ControlChannel* control = ((ControlVisit*)arg)->control;
+    size_t index = (size_t)(info - all_metrics);
+    if (control->selected[index])
+    {
+        control->selected[index] = false;
+        control->selected_count--;
+    }
+}
+
+/**
+ * @brief Sets the interval override of a metric.
+ */
+static void set_metric_interval(const MetricInfo* info, void* arg)
+{
+    ControlVisit* visit = arg;
+    visit->control->intervals[info - all_metrics] = visit->interval_ms;
+}
+
+/**
+ * @brief Unregisters the metrics that are registered but no longer selected.
+ *
+ * Must be called once the selection has been applied, so that no new run updates a metric that left the exposition;
+ * a run still in flight updates the unregistered metric, which stays valid.
+ */
+static int unregister_deselected(ControlChannel* control)
+{
+    int result = 0;
+    for (size_t i = 0; i < control->metric_count; i++)
+    {
+        if (!control->registered[i] || control->selected[i])
+        {
+            continue;
+        }
+        if (unregister_metric(&all_metrics[i]) != 0)
+        {
+            report_status(control, "Error: Could not unregister metric '%s'", all_metrics[i].name);
+            result = RETURN_ERROR;
+            continue;
+        }
+        control->registered[i] = false;
+    }
+    return result;
+}
+
+/**
+ * @brief Selects every metric matching a comma-separated list of patterns.
+ *
+ * The default selection is replaced rather than extended; the metrics it shares with the new one stay registered, so
+ * their series never leave the exposition.
+ */
+static int add_metrics(ControlChannel* control, char* list)
+{
+    if (control->provisional)
+    {
+        memset(control->selected, 0, control->metric_count * sizeof(*control->selected));
+        control->selected_count = 0;
+        control->provisional = false;
+    }
+
+    ControlVisit visit = {control, 0, 0};
+    int result = visit_patterns(control, list, select_metric, &visit);
+
+    if (apply_selection(control) != 0)
+    {
+        report_status(control, "Error: Could not schedule every selected metric");
+        return RETURN_ERROR;
+    }
+    if (unregister_deselected(control) != 0)
+    {
+        result = RETURN_ERROR;
+    }
+    return result != 0 ? result : visit.result;
+}
+
+/**
+ * @brief Deselects every metric matching a comma-separated list of patterns.
+ *
+ * The collectors are unscheduled before the metrics are unregistered.
+ */
+static int remove_metrics(ControlChannel* control, char* list)
+{
+    control->provisional = false;
+    ControlVisit visit = {control, 0, 0};
+    int result = visit_patterns(control, list, deselect_metric, &visit);
+
+    if (apply_selection(control) != 0)
+    {
+        result = RETURN_ERROR;
+    }
+    if (unregister_deselected(control) != 0)
+    {
+        result = RETURN_ERROR;
+    }
+    return result;
+}
+
+/**
+ * @brief Changes the collection interval of the metrics matching a list of patterns, given as "<patterns> <ms>".
+ */
+static int set_interval(ControlChannel* control, char* arguments)
+{
+    char* save = NULL;
+    char* patterns = strtok_r(arguments, " \t", &save);
+    char* value = strtok_r(NULL, " \t", &save);
+    if (patterns == NULL || value == NULL || strtok_r(NULL, " \t", &save) != NULL)
+    {
+        report_status(control, "Error: Usage: interval <pattern>[,<pattern>...] <ms>");
+        return RETURN_ERROR;
+    }
+
+    char* end = NULL;
+    errno = 0;
+    unsigned long interval_ms = strtoul(value, &end, 10);
+    if (errno != 0 || *end != '\0' || *value == '-' || interval_ms > UINT_MAX)
+    {
+        report_status(control, "Error: Invalid interval '%s'", value);
+        return RETURN_ERROR;
+    }
+
+    // The interval is kept for a later add of the metrics that are not selected
+    control->provisional = false;
+    ControlVisit visit = {control, (unsigned int)interval_ms, 0};
+    int result = visit_patterns(control, patterns, set_metric_interval, &visit);
+    if (apply_selection(control) != 0)
+    {
+        report_status(control, "Error: Could not reschedule every selected metric");
+        return RETURN_ERROR;
+    }
+    return result;
+}
+
+int control_channel_execute(ControlChannel* control, char* command)
+{
+    command = trim(command);
+    if (*command == '\0')
+    {
+        return 0;
+    }
+
+    char* arguments = command + strcspn(command, " \t");
+    if (*arguments != '\0')
+    {
+        *arguments++ = '\0';
+    }
+
+    int result;
+    if (strcmp(command, "list") == 0 || strcmp(command, "1") == 0)
+    {
+        report_status(control, "Available metrics served on /catalog");
+        return 0;
+    }
+    else if (strcmp(command, "add") == 0)
+    {
+        result = add_metrics(control, arguments);
+    }
+    else if (strcmp(command, "remove") == 0)
+    {
+        result = remove_metrics(control, arguments);
+    }
+    else if (strcmp(command, "interval") == 0)
+    {
+        result = set_interval(control, arguments);
+    }
+    else if (strcmp(command, "trace") == 0)
+    {
+        // Leaves the selection alone, so it reports its own outcome
+        const char* path = trim(arguments);
+        if (*path == '\0' || trace_dump(path) != 0)
+        {
+            report_status(control, "Error: Could not write the trace to '%s'", path);
+            return RETURN_ERROR;
+        }
+        report_status(control, "Trace written to %s", path);
+        return 0;
+    }
+    else
+    {
+        // A bare list of metric names, as sent before commands existed; the split is undone first
+        if (*arguments != '\0')
+        {
+            arguments[-1] = ' ';
+        }
+        result = add_metrics(control, command);
+    }
+
+    if (result == 0)
+    {
+        report_status(control, "Metrics monitoring started: %zu metrics selected", control->selected_count);
+    }
+    return result;
+}
+
+/**
+ * @brief Executes the command held in the line buffer.
+ */
+static void execute_line(ControlChannel* control)
+{
+    if (!control->discarding)
+    {
+        control->line[control->length] = '\0';
+        control_channel_execute(control, control->line);
+    }
+    control->length = 0;
+    control->discarding = false;
+}
+
+/**
+ * @brief Reads every pending byte of the FIFO and executes the commands it completes.
+ */
+static void process_input(void* arg)
+{
+    ControlChannel* control = arg;
+
+    char buffer[CONTROL_LINE_SIZE];
+    ssize_t n;
+    while ((n = read(control->fd, buffer, sizeof(buffer))) > 0 || (n < 0 && errno == EINTR))
+    {
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (buffer[i] == '\n')
+            {
+                execute_line(control);
+            }
+            else if (control->length + 1 < sizeof(control->line))
+            {
+                control->line[control->length++] = buffer[i];
+            }
+            else if (!control->discarding)
+            {
+                report_status(control, "Error: Command longer than %d bytes ignored", CONTROL_LINE_SIZE - 1);
+                control->discarding = true;
+            }
+        }
+    }
+    if (n < 0 && errno != EAGAIN)
+    {
+        perror("Error reading the control FIFO");
+    }
+
+    // Writes of at most PIPE_BUF bytes are never split, so a command that was written without its newline is whole
+    if (control->length > 0 || control->discarding)
+    {
+        execute_line(control);
+    }
+}
+
+int control_channel_open(ControlChannel* control, const char* path, Scheduler* scheduler, control_status_fn report)
+{
+    memset(control, 0, sizeof(*control));
+    control->fd = -1;
+    control->path = path;
+    control->scheduler = scheduler;
+    control->report = report;
+
+    while (all_metrics[control->metric_count].name != NULL)
+    {
+        control->metric_count++;
+    }
+    control->selected = calloc(control->metric_count, sizeof(*control->selected));
+    control->registered = calloc(control->metric_count, sizeof(*control->registered));
+    control->intervals = calloc(control->metric_count, sizeof(*control->intervals));
+    if (control->selected == NULL || control->registered == NULL || control->intervals == NULL)
+    {
+        perror("calloc");
+        control_channel_close(control);
+        return RETURN_ERROR;
+    }
+
+    if (mkfifo(path, 0666) == -1 && errno != EEXIST)
+    {
+        perror("mkfifo");
+        control_channel_close(control);
+        return RETURN_ERROR;
+    }
+
+    // Holding the write end as well keeps the FIFO from reporting end of file, and POLLHUP, between two writers
+    control->fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (control->fd < 0)
+    {
+        perror("Error opening the control FIFO");
+        control_channel_close(control);
+        return RETURN_ERROR;
+    }
+
+    scheduler_set_input(scheduler, control->fd, process_input, control);
+
+    // The exporters run before any metric is selected
+    if (apply_selection(control) != 0)
+    {
+        fprintf(stderr, "Error scheduling the exporters\n");
+    }
+    return 0;
+}
+
+int control_channel_select_default(ControlChannel* control, const char* patterns)
+{
+    char list[CONTROL_LINE_SIZE];
+    if (snprintf(list, sizeof(list), "%s", patterns) >= (int)sizeof(list))
+    {
+        report_status(control, "Error: Default selection longer than %d bytes ignored", CONTROL_LINE_SIZE - 1);
+        return RETURN_ERROR;
+    }
+
+    int result = add_metrics(control, list);
+    control->provisional = true;
+    report_status(control, "Default metrics selected: %zu metrics, replaced by the first add on %s",
+                  control->selected_count, control->path);
+    return result;
+}
+
+void control_channel_close(ControlChannel* control)
+{
+    if (control->fd >= 0)
+    {
+        scheduler_set_input(control->scheduler, -1, NULL, NULL);
+        close(control->fd);
+        unlink(control->path);
+        control->fd = -1;
+    }
+
+    free(control->selected);
+    free(control->registered);
+    free(control->intervals);
+    control->selected = NULL;
+    control->registered = NULL;
+    control->intervals = NULL;
+}
@@ -0,0 +1,215 @@
+/**
+ * @file cpufreq.c
+ * @brief Functions for reading the current frequency of every CPU through persistent file descriptors.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "cpufreq.h"
+#include "metrics.h"
+#include <errno.h>
+#include <limits.h>
+
+void cpufreq_table_init(CpuFreqTable* table, const char* root)
+{
+    memset(table, 0, sizeof(*table));
+    table->root = root;
+    table->rescan = true;
+
+    char path[BUFFER_SIZE];
+    snprintf(path, sizeof(path), "%s/online", root);
+    table->online_fd = open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/**
+ * @brief Closes the descriptors of every CPU and empties the table.
+ */
+static void close_cpus(CpuFreqTable* table)
+{
+    for (size_t i = 0; i < table->cpu_count; i++)
+    {
+        close(table->cpus[i].fd);
+    }
+    table->cpu_count = 0;
+}
+
+void cpufreq_table_free(CpuFreqTable* table)
+{
+    close_cpus(table);
+    free(table->cpus);
+    table->cpus = NULL;
+    table->cpu_capacity = 0;
+    if (table->online_fd >= 0)
+    {
+        close(table->online_fd);
+        table->online_fd = -1;
+    }
+}
+
+/**
+ * @brief Parses the id of a CPU directory, such as cpu12.
+ *
+ * @param name The directory name.
+ * @return The CPU id, or -1 if the directory is not a CPU.
+ */
+static int parse_cpu_name(const char* name)
+{
+    if (strncmp(name, "cpu", 3) != 0 || name[3] == '\0')
+    {
+        return RETURN_ERROR;
+    }
+
+    int cpu = 0;
+    for (const char* p = name + 3; *p != '\0'; p++)
+    {
+        if (*p < '0' || *p > '9' || cpu > (INT_MAX - 9) / 10)
+        {
+            return RETURN_ERROR;
+        }
+        cpu = cpu * 10 + (*p - '0');
+    }
+    return cpu;
+}
+
+/**
+ * @brief Appends a CPU to the table.
+ *
+ * @return The new entry, or NULL if the array cannot be grown.
+ */
+static CpuFreqEntry* add_cpu(CpuFreqTable* table)
+{
+    if (table->cpu_count == table->cpu_capacity)
+    {
+        size_t capacity = table->cpu_capacity ? table->cpu_capacity * 2 : 64;
+        CpuFreqEntry* cpus = realloc(table->cpus, capacity * sizeof(*cpus));
+        if (cpus == NULL)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        table->cpus = cpus;
+        table->cpu_capacity = capacity;
+    }
+    return &table->cpus[table->cpu_count++];
+}
+
+/**
+ * @brief Orders CPUs by id, so that discovery does not depend on readdir() order.
+ */
+static int compare_cpus(const void* a, const void* b)
+{
+    const CpuFreqEntry* x = a;
+    const CpuFreqEntry* y = b;
+    return (x->cpu > y->cpu) - (x->cpu < y->cpu);
+}
+
+/**
+ * @brief Reads the online CPU list.
+ *
+ * @param table The table.
+ * @param buffer Buffer of CPUFREQ_ONLINE_SIZE bytes to store the list.
+ */
+static void read_online(const CpuFreqTable* table, char buffer[CPUFREQ_ONLINE_SIZE])
+{
+    ssize_t n = table->online_fd >= 0 ? pread(table->online_fd, buffer, CPUFREQ_ONLINE_SIZE - 1, 0) : -1;
+    buffer[n > 0 ? n : 0] = '\0';
+}
+
+/**
+ * @brief Runs a discovery pass, replacing every CPU of the table.
+ *
+ * @param table The table.
+ * @return 0 on success, or -1 if the CPU directory cannot be listed.
+ */
+static int scan_cpus(CpuFreqTable* table)
+{
+    close_cpus(table);
+    table->rescan = false;
+    read_online(table, table->online);
+
+    DIR* root = opendir(table->root);
+    if (root == NULL)
+    {
+        return RETURN_ERROR;
+    }
+
+    const struct dirent* entry;
+    while ((entry = readdir(root)) != NULL)
+    {
+        int cpu = parse_cpu_name(entry->d_name);
+        if (cpu < 0)
+        {
+            continue;
+        }
+
+        // Offline CPUs and CPUs without a cpufreq driver have no scaling_cur_freq
+        char path[BUFFER_SIZE];
+        snprintf(path, sizeof(path), "%s/cpu%d/cpufreq/scaling_cur_freq", table->root, cpu);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        CpuFreqEntry* c = add_cpu(table);
+        if (c == NULL)
+        {
+            close(fd);
+            break;
+        }
+        memset(c, 0, sizeof(*c));
+        c->cpu = cpu;
+        c->fd = fd;
+        snprintf(c->label, sizeof(c->label), "%d", cpu);
+    }
+    closedir(root);
+
+    qsort(table->cpus, table->cpu_count, sizeof(*table->cpus), compare_cpus);
+    return 0;
+}
+
+int cpufreq_table_read(CpuFreqTable* table)
+{
+    // A hotplugged CPU changes the online list before its cpufreq directory appears or goes away
+    if (!table->rescan && table->online_fd >= 0)
+    {
+        char online[CPUFREQ_ONLINE_SIZE];
+        read_online(table, online);
+        table->rescan = strcmp(online, table->online) != 0;
+    }
+
+    int scanned = 0;
+    if (table->rescan)
+    {
+        if (scan_cpus(table) != 0)
+        {
+            return RETURN_ERROR;
+        }
+        scanned = 1;
+    }
+
+    for (size_t i = 0; i < table->cpu_count; i++)
+    {
+        CpuFreqEntry* c = &table->cpus[i];
+        char buffer[CPUFREQ_VALUE_SIZE];
+        ssize_t n = pread(c->fd, buffer, sizeof(buffer) - 1, 0);
+        if (n <= 0)
+        {
+            if (n < 0 && (errno == ENODEV || errno == ENXIO || errno == ENOENT))
+            {
+                table->rescan = true;
+            }
+            c->valid = false;
+            continue;
+        }
+
+        // scaling_cur_freq reports kHz
+        buffer[n] = '\0';
+        char* end;
+        long khz = strtol(buffer, &end, 10);
+        c->valid = end != buffer;
+        c->mhz = (double)khz / UNIT_CONVERSION;
+    }
+
+    return scanned;
+}
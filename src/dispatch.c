@@ -0,0 +1,60 @@
+/**
+ * @file dispatch.c
+ * @brief Functions for running each selected collector once per monitoring cycle.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "dispatch.h"
+#include "metrics.h"
+
+void dispatch_init(CollectorDispatch* dispatch)
+{
+    dispatch->group_count = 0;
+}
+
+int dispatch_add(CollectorDispatch* dispatch, collector_fn update_function, unsigned int interval_ms)
+{
+    if (update_function == NULL)
+    {
+        return RETURN_ERROR;
+    }
+
+    if (interval_ms == 0)
+    {
+        interval_ms = DEFAULT_INTERVAL_MS;
+    }
+
+    for (size_t i = 0; i < dispatch->group_count; i++)
+    {
+        if (dispatch->groups[i].update_function == update_function)
+        {
+            dispatch->groups[i].metric_count++;
+            if (interval_ms < dispatch->groups[i].interval_ms)
+            {
+                dispatch->groups[i].interval_ms = interval_ms;
+            }
+            return 0;
+        }
+    }
+
+    if (dispatch->group_count >= MAX_COLLECTORS)
+    {
+        fprintf(stderr, "Error: too many collectors (max %d)\n", MAX_COLLECTORS);
+        return RETURN_ERROR;
+    }
+
+    dispatch->groups[dispatch->group_count].update_function = update_function;
+    dispatch->groups[dispatch->group_count].metric_count = 1;
+    dispatch->groups[dispatch->group_count].interval_ms = interval_ms;
+    dispatch->group_count++;
+    return 0;
+}
+
+void dispatch_run(const CollectorDispatch* dispatch)
+{
+    for (size_t i = 0; i < dispatch->group_count; i++)
+    {
+        dispatch->groups[i].update_function();
+    }
+}
@@ -6,301 +6,1944 @@
  * memory usage, disk stats, and network traffic via Prometheus gauges. These metrics are collected from the
  * system and exposed through an HTTP server for monitoring purposes.
  *
- * The metrics include usage statistics for CPU, memory, disk, network, battery, and more,
- * and are safely updated in a multi-threaded environment using mutexes.
+ * The metrics include usage statistics for CPU, memory, disk, network, battery, and more. Gauges are updated without
+ * locks; values produced together by one collector are published as a batch so that a scrape sees all or none of
+ * them.
  *
  * @author 1v6n
  * @date 09/10/2024
  */
 
 #include "expose_metrics.h"
-#define METRICS_FILE "/tmp/monitor_metrics"
-
-bool keep_running = true; /**< Control variable for the main loop. */
-pthread_mutex_t lock;     /**< Mutex for thread synchronization. */
-
-static prom_gauge_t* cpu_usage_metric;         /**< Prometheus gauge for tracking CPU usage. */
-static prom_gauge_t* memory_usage_metric;      /**< Prometheus gauge for tracking memory usage. */
-static prom_gauge_t* disk_usage_metric;        /**< Prometheus gauge for tracking disk usage. */
-static prom_gauge_t* running_processes_metric; /**< Prometheus gauge for tracking the number of running processes. */
-static prom_gauge_t* cpu_temp_metric;          /**< Prometheus gauge for tracking CPU temperature. */
-static prom_gauge_t* battery_voltage_metric;   /**< Prometheus gauge for tracking battery voltage. */
-static prom_gauge_t* battery_current_metric;   /**< Prometheus gauge for tracking battery current. */
-static prom_gauge_t* cpu_frequency_metric;     /**< Prometheus gauge for tracking CPU frequency. */
-static prom_gauge_t* cpu_fan_speed_metric;     /**< Prometheus gauge for tracking CPU fan speed. */
-static prom_gauge_t* gpu_fan_speed_metric;     /**< Prometheus gauge for tracking GPU fan speed. */
-static prom_gauge_t* total_processes_metric;   /**< Prometheus gauge for tracking the total number of processes. */
-static prom_gauge_t*
-    suspended_processes_metric;                /**< Prometheus gauge for tracking the number of suspended processes. */
-static prom_gauge_t* ready_processes_metric;   /**< Prometheus gauge for tracking the number of ready processes. */
-static prom_gauge_t* blocked_processes_metric; /**< Prometheus gauge for tracking the number of blocked processes. */
-static prom_gauge_t* total_memory_metric;      /**< Prometheus gauge for tracking the total memory in the system. */
-static prom_gauge_t* used_memory_metric;       /**< Prometheus gauge for tracking the used memory in the system. */
-static prom_gauge_t* available_memory_metric;  /**< Prometheus gauge for tracking the available memory in the system. */
-static prom_gauge_t* context_switches_metric;  /**< Prometheus gauge for tracking the number of context switches. */
-static prom_gauge_t* io_time_metric;           /**< Prometheus gauge for tracking the time spent on I/O operations. */
-static prom_gauge_t*
-    writes_completed_metric;                 /**< Prometheus gauge for tracking the total number of writes completed. */
-static prom_gauge_t* reads_completed_metric; /**< Prometheus gauge for tracking the total number of reads completed. */
-static prom_gauge_t* rx_bytes_metric;  /**< Prometheus gauge for tracking the total received bytes in the network. */
-static prom_gauge_t* tx_bytes_metric;  /**< Prometheus gauge for tracking the total transmitted bytes in the network. */
-static prom_gauge_t* rx_errors_metric; /**< Prometheus gauge for tracking the total receive errors in the network. */
-static prom_gauge_t* tx_errors_metric; /**< Prometheus gauge for tracking the total transmit errors in the network. */
-static prom_gauge_t* dropped_packets_metric; /**< Prometheus gauge for tracking the total number of dropped packets. */
-
-MetricInfo all_metrics[] = {
-    {"rx_bytes_total", "Total received bytes", &rx_bytes_metric, &update_network_traffic_metric},
-    {"tx_bytes_total", "Total transmitted bytes", &tx_bytes_metric, &update_network_traffic_metric},
-    {"rx_errors_total", "Total receive errors", &rx_errors_metric, &update_network_traffic_metric},
-    {"tx_errors_total", "Total transmit errors", &tx_errors_metric, &update_network_traffic_metric},
-    {"dropped_packets_total", "Total dropped packets", &dropped_packets_metric, &update_network_traffic_metric},
-    {"io_time_ms", "Time spent on I/O in milliseconds", &io_time_metric, &update_disk_stats_metrics},
-    {"writes_completed_total", "Total writes completed", &writes_completed_metric, &update_disk_stats_metrics},
-    {"reads_completed_total", "Total reads completed", &reads_completed_metric, &update_disk_stats_metrics},
-    {"total_memory_mb", "Total memory in MB", &total_memory_metric, &update_memory_metrics},
-    {"used_memory_mb", "Used memory in MB", &used_memory_metric, &update_memory_metrics},
-    {"available_memory_mb", "Available memory in MB", &available_memory_metric, &update_memory_metrics},
-    {"context_switches", "Context switches", &context_switches_metric, &update_context_switches_metric},
-    {"cpu_usage_percentage", "CPU usage in percentage", &cpu_usage_metric, &update_cpu_gauge},
-    {"memory_usage_percentage", "Memory usage in percentage", &memory_usage_metric, &update_memory_gauge},
-    {"disk_usage_percentage", "Disk usage in percentage", &disk_usage_metric, &update_disk_gauge},
-    {"running_processes_total", "Total running processes", &running_processes_metric, &update_running_processes_gauge},
-    {"cpu_temperature_celsius", "CPU temperature in Celsius", &cpu_temp_metric, &update_cpu_temperature},
-    {"battery_voltage_volts", "Battery voltage in volts", &battery_voltage_metric, &update_battery_voltage},
-    {"battery_current_amperes", "Battery current in amperes", &battery_current_metric, &update_battery_current},
-    {"cpu_frequency_megahertz", "CPU frequency in MHz", &cpu_frequency_metric, &update_cpu_frequency},
-    {"cpu_fan_speed_rpm", "CPU fan speed in RPM", &cpu_fan_speed_metric, &update_cpu_fan_speed},
-    {"gpu_fan_speed_rpm", "GPU fan speed in RPM", &gpu_fan_speed_metric, &update_gpu_fan_speed},
-    {"total_processes", "Total number of processes", &total_processes_metric, &update_process_states_gauge},
-    {"suspended_processes", "Suspended processes", &suspended_processes_metric, &update_process_states_gauge},
-    {"ready_processes", "Ready processes", &ready_processes_metric, &update_process_states_gauge},
-    {"blocked_processes", "Blocked processes", &blocked_processes_metric, &update_process_states_gauge},
-    {NULL, NULL, NULL} // Sentinel value to mark the end of the array
+#include "metric_catalog.h"
+#include <fnmatch.h>
+#include <math.h>
+#define CACHE_LINE_SIZE 64           /**< Alignment of the per-core state array. */
+#define TOP_PROCESSES 5              /**< Number of processes reported by the top-N gauges. */
+#define PROCESS_INTERVAL_MS 5000     /**< Collection interval of the /proc walk. */
+#define DISK_USAGE_INTERVAL_MS 15000 /**< Collection interval of the file system usage. */
+
+bool keep_running = true;                                             /**< Control variable for the main loop. */
+static pthread_mutex_t keep_running_lock = PTHREAD_MUTEX_INITIALIZER; /**< Guards keep_running. */
+static pthread_cond_t keep_running_cond = PTHREAD_COND_INITIALIZER;   /**< Signalled when keep_running is cleared. */
+
+static Rollup cpu_usage_rollup = ROLLUP_INIT;        /**< One-minute rollup of cpu_usage_percentage. */
+static Rollup memory_usage_rollup = ROLLUP_INIT;     /**< One-minute rollup of memory_usage_percentage. */
+static Rollup cpu_core_usage_rollup = ROLLUP_INIT;   /**< One-minute rollup of cpu_core_usage_percentage. */
+static Rollup disk_utilization_rollup = ROLLUP_INIT; /**< One-minute rollup of disk_utilization_percentage. */
+static Rollup psi_avg_rollup = ROLLUP_INIT;          /**< One-minute rollup of pressure_stall_percentage. */
+
+static Rate context_switches_rate = RATE_INIT;  /**< Per-second rate of context_switches. */
+static Rate interrupts_rate = RATE_INIT;        /**< Per-second rate of interrupts_total. */
+static Rate forks_rate = RATE_INIT;             /**< Per-second rate of forks_total. */
+static Rate rx_bytes_rate = RATE_INIT;          /**< Per-second rate of rx_bytes_total. */
+static Rate tx_bytes_rate = RATE_INIT;          /**< Per-second rate of tx_bytes_total. */
+static Rate reads_completed_rate = RATE_INIT;   /**< Per-second rate of reads_completed_total. */
+static Rate writes_completed_rate = RATE_INIT;  /**< Per-second rate of writes_completed_total. */
+static Rate net_rx_bytes_rate = RATE_INIT;      /**< Per-second rate of network_receive_bytes_total. */
+static Rate net_tx_bytes_rate = RATE_INIT;      /**< Per-second rate of network_transmit_bytes_total. */
+static Rate net_rx_packets_rate = RATE_INIT;    /**< Per-second rate of network_receive_packets_total. */
+static Rate net_tx_packets_rate = RATE_INIT;    /**< Per-second rate of network_transmit_packets_total. */
+static Rate page_faults_rate = RATE_INIT;       /**< Per-second rate of page_faults_total. */
+static Rate page_major_faults_rate = RATE_INIT; /**< Per-second rate of page_major_faults_total. */
+
+/**
+ * @brief Structure to hold the values a collector produced on its previous run, for the adaptive probe.
+ */
+typedef struct
+{
+    double* previous;      /**< Value of every series on the previous run, in visit order. */
+    double* current;       /**< Value of every series on the run being probed. */
+    size_t previous_count; /**< Number of series on the previous run. */
+    size_t capacity;       /**< Number of entries allocated in previous and current. */
+    size_t base;           /**< Index in current of the first series of the metric being visited. */
+    bool overflow;         /**< Set when current could not hold every series. */
+} AdaptiveState;
+
+static AdaptiveState adaptive_states[MAX_COLLECTORS]; /**< Probe state of every collector, as in all_collectors. */
+static double adaptive_epsilon = ADAPTIVE_EPSILON_DEFAULT; /**< Relative change below which a value is stable. */
+static Scheduler* _Atomic lazy_scheduler;                  /**< Scheduler collecting on scrapes, NULL when not lazy. */
+
+#define METRIC_CTYPE_GAUGE prom_gauge_t           /**< C type of a GAUGE entry of the catalog. */
+#define METRIC_CTYPE_COUNTER prom_counter_t       /**< C type of a COUNTER entry of the catalog. */
+#define METRIC_CTYPE_FLOAT_COUNTER prom_counter_t /**< C type of a FLOAT_COUNTER entry of the catalog. */
+#define METRIC_TYPE_GAUGE "gauge"                 /**< Prometheus type of a GAUGE entry of the catalog. */
+#define METRIC_TYPE_COUNTER "counter"             /**< Prometheus type of a COUNTER entry of the catalog. */
+#define METRIC_TYPE_FLOAT_COUNTER "counter"       /**< Prometheus type of a FLOAT_COUNTER entry of the catalog. */
+
+/** "# HELP" and "# TYPE" lines of a metric in the text format. */
+#define METRIC_HEADER(NAME, TYPE, HELP) "# HELP " NAME " " HELP "\n# TYPE " NAME " " METRIC_TYPE_##TYPE "\n"
+/** Declares the variable holding a metric of the catalog. */
+#define METRIC_DECLARE(VAR, NAME, TYPE, UPDATE, INTERVAL, COUNT, KEYS, ROLLUP, RATE, HELP) static METRIC_CTYPE_##TYPE* VAR;
+/** Expands a metric of the catalog into its all_metrics entry. */
+#define METRIC_INFO(VAR, NAME, TYPE, UPDATE, INTERVAL, COUNT, KEYS, ROLLUP, RATE, HELP)                                     \
+    {.name = NAME,                                                                                                     \
+     .description = HELP,                                                                                              \
+     .metric = &VAR,                                                                                                   \
+     .update_function = &UPDATE,                                                                                       \
+     .interval_ms = INTERVAL,                                                                                          \
+     .label_count = COUNT,                                                                                             \
+     .label_keys = KEYS,                                                                                               \
+     .kind = METRIC_##TYPE,                                                                                            \
+     .rollup = ROLLUP,                                                                                                 \
+     .rate = RATE,                                                                                                     \
+     .header = METRIC_HEADER(NAME, TYPE, HELP),                                                                        \
+     .header_len = sizeof(METRIC_HEADER(NAME, TYPE, HELP)) - 1},
+/** Counts the metrics of the catalog. */
+#define METRIC_ONE(VAR, NAME, TYPE, UPDATE, INTERVAL, COUNT, KEYS, ROLLUP, RATE, HELP) +1
+
+METRIC_CATALOG(METRIC_DECLARE)
+
+static const char* rank_label_keys[] = {"rank"};                           /**< Label keys of the top-N gauges. */
+static const char* rank_labels[TOP_PROCESSES] = {"1", "2", "3", "4", "5"}; /**< Values of the rank label. */
+
+static prom_metric_sample_t* top_cpu_process_samples[TOP_PROCESSES]; /**< Per-rank samples of top_cpu_process_metric. */
+static prom_metric_sample_t* top_cpu_pid_samples[TOP_PROCESSES];     /**< Per-rank samples of top_cpu_pid_metric. */
+static prom_metric_sample_t* top_rss_process_samples[TOP_PROCESSES]; /**< Per-rank samples of top_rss_process_metric. */
+static prom_metric_sample_t* top_rss_pid_samples[TOP_PROCESSES];     /**< Per-rank samples of top_rss_pid_metric. */
+
+static ProcessTable process_table; /**< Processes tracked across cycles. */
+static bool process_table_ready;   /**< Whether process_table has been initialized. */
+
+static const char* cpu_core_label_keys[] = {"cpu", "mode"}; /**< Label keys of the per-core usage gauge. */
+
+static prom_counter_t* collector_timeout_metric;                   /**< Prometheus counter for missed deadlines. */
+static const char* collector_timeout_label_keys[] = {"collector"}; /**< Label keys of the timeout counter. */
+
+/**
+ * @brief Structure to hold the previous counters of one CPU.
+ */
+typedef struct
+{
+    CpuTimes prev;                                 /**< Counters from the previous cycle. */
+    bool valid;                                    /**< Whether prev holds a reading. */
+    bool listed;                                   /**< Whether the current snapshot lists the CPU. */
+    char label[21];                                /**< CPU id rendered as a label value. */
+    prom_metric_sample_t* samples[CPU_MODE_COUNT]; /**< Per-mode samples, resolved on first use. */
+} CpuCoreState;
+
+static CpuCoreState* cpu_core_states; /**< Per-core state indexed by CPU id, aligned to a cache line. */
+static size_t cpu_core_capacity;      /**< Number of allocated entries in cpu_core_states. */
+
+static const char* net_dev_label_keys[] = {"device"}; /**< Label keys of the per-device network counters. */
+
+/**
+ * @brief Structure to map a per-device network counter to the /proc/net/dev column it reports.
+ */
+typedef struct
+{
+    prom_counter_t** metric; /**< The Prometheus counter. */
+    NetDevCounter counter;   /**< The reported column. */
+} NetDevMetric;
+
+static const NetDevMetric net_dev_metrics[NET_DEV_METRIC_COUNT] = {
+    {&net_rx_bytes_metric, NET_DEV_RX_BYTES},     {&net_tx_bytes_metric, NET_DEV_TX_BYTES},
+    {&net_rx_packets_metric, NET_DEV_RX_PACKETS}, {&net_tx_packets_metric, NET_DEV_TX_PACKETS},
+    {&net_rx_errors_metric, NET_DEV_RX_ERRORS},   {&net_tx_errors_metric, NET_DEV_TX_ERRORS},
+    {&net_rx_dropped_metric, NET_DEV_RX_DROPPED}, {&net_tx_dropped_metric, NET_DEV_TX_DROPPED},
+}; /**< Per-device network counters and the column each one reports. */
+
+/**
+ * @brief Structure to hold the state of one position of /proc/net/dev.
+ *
+ * Devices keep their position between reads unless links are added or removed, so the filter verdict and the sample
+ * handles are cached by position and only recomputed when the device at that position changes.
+ */
+typedef struct
+{
+    char name[IFNAMSIZ];                                 /**< Device last seen at this position. */
+    bool reported;                                       /**< Whether the device passes the filter. */
+    prom_metric_sample_t* samples[NET_DEV_METRIC_COUNT]; /**< Per-gauge samples, resolved on first use. */
+} NetDevState;
+
+static NameFilter net_dev_filter;   /**< Device filter, compiled once by init_metrics. */
+static NetDevState* net_dev_states; /**< Per-position device state. */
+static size_t net_dev_capacity;     /**< Number of allocated entries in net_dev_states. */
+
+static const char* disk_label_keys[] = {"device"}; /**< Label keys of the per-disk gauges. */
+
+static prom_gauge_t** const disk_device_metrics[DISK_DEVICE_METRIC_COUNT] = {
+    &disk_reads_metric,      &disk_writes_metric, &disk_read_bytes_metric,
+    &disk_write_bytes_metric, &disk_await_metric,  &disk_utilization_metric,
+}; /**< Per-disk gauges, in the order of the fields of DiskDeviceRates. */
+
+/**
+ * @brief Structure to hold the state of one position of /proc/diskstats.
+ */
+typedef struct
+{
+    char name[DISK_NAME_SIZE];                               /**< Device last seen at this position. */
+    DiskDeviceStats prev;                                    /**< Counters from the previous cycle. */
+    bool valid;                                              /**< Whether prev holds a reading of this device. */
+    prom_metric_sample_t* samples[DISK_DEVICE_METRIC_COUNT]; /**< Per-gauge samples, resolved on first use. */
+} DiskDeviceState;
+
+static DiskDeviceState* disk_device_states; /**< Per-position disk state. */
+static size_t disk_device_capacity;         /**< Number of allocated entries in disk_device_states. */
+
+static const char* fs_label_keys[] = {"mountpoint", "device", "fstype"}; /**< Label keys of the file system gauges. */
+
+static prom_gauge_t** const fs_metrics[MOUNT_SAMPLE_COUNT] = {
+    &fs_size_metric, &fs_free_metric, &fs_avail_metric, &fs_usage_metric, &fs_files_metric, &fs_files_free_metric,
+}; /**< File system gauges, in the order of the samples of a MountEntry. */
+
+static const char* hwmon_label_keys[] = {"chip", "sensor", "label"}; /**< Label keys of the hwmon gauges. */
+
+static prom_gauge_t** const hwmon_metrics[HWMON_KIND_COUNT] = {
+    &hwmon_temp_metric, &hwmon_fan_metric, &hwmon_voltage_metric, &hwmon_current_metric, &hwmon_power_metric,
+}; /**< hwmon gauges, indexed by HwmonKind. */
+
+static prom_gauge_t** const hwmon_role_metrics[HWMON_ROLE_COUNT] = {
+    &cpu_temp_metric, &battery_voltage_metric, &battery_current_metric, &cpu_fan_speed_metric, &gpu_fan_speed_metric,
+}; /**< Single-value gauges, indexed by HwmonRole. */
+
+static HwmonTable hwmon_table;    /**< Sensors discovered under /sys/class/hwmon. */
+static char hwmon_root[PATH_MAX]; /**< Root of hwmon_table when a snapshot is replayed. */
+
+static const char* cpu_label_keys[] = {"cpu"}; /**< Label keys of the per-CPU gauges. */
+static CpuFreqTable cpufreq_table;             /**< CPUs discovered under /sys/devices/system/cpu. */
+static char cpufreq_root[PATH_MAX];            /**< Root of cpufreq_table when a snapshot is replayed. */
+
+static const char* psi_avg_label_keys[] = {"resource", "kind", "window"}; /**< Label keys of the stall share gauge. */
+static const char* psi_total_label_keys[] = {"resource", "kind"};         /**< Label keys of the stall time gauge. */
+
+static PsiSnapshot psi_snapshot; /**< Pressure of every resource, kept to remember the missing files. */
+/** Samples of psi_avg_metric, indexed by resource, kind and window. */
+static prom_metric_sample_t* psi_avg_samples[PSI_RESOURCE_COUNT][PSI_KIND_COUNT][PSI_WINDOW_COUNT];
+/** Samples of psi_total_metric, indexed by resource and kind. */
+static prom_metric_sample_t* psi_total_samples[PSI_RESOURCE_COUNT][PSI_KIND_COUNT];
+
+static const char* cgroup_label_keys[] = {"cgroup"}; /**< Label keys of the cgroup gauges. */
+
+static prom_metric_t** const cgroup_metrics[CGROUP_STAT_COUNT] = {
+    &cgroup_cpu_metric,  &cgroup_throttled_metric, &cgroup_memory_metric,   &cgroup_anon_metric,
+    &cgroup_file_metric, &cgroup_io_read_metric,   &cgroup_io_write_metric,
+}; /**< cgroup metrics, indexed by CgroupStat. */
+static const bool cgroup_counters[CGROUP_STAT_COUNT] = {
+    [CGROUP_IO_READ] = true,
+    [CGROUP_IO_WRITE] = true,
+}; /**< Whether each cgroup metric is an integer counter, set from CgroupEntry.counts. */
+static const bool cgroup_totals[CGROUP_STAT_COUNT] = {
+    [CGROUP_CPU_USAGE] = true,
+    [CGROUP_CPU_THROTTLED] = true,
+}; /**< Whether each cgroup metric is a counter of seconds, set from CgroupEntry.values. */
+
+static prom_metric_t** const sched_metrics[SCHEDSTAT_FIELD_COUNT] = {
+    &sched_run_metric, &sched_wait_metric, &sched_slices_metric,
+};                                                                           /**< Per-CPU scheduler metrics, indexed by SchedstatField. */
+static const double sched_scales[SCHEDSTAT_FIELD_COUNT] = {1e-9, 1e-9, 1.0}; /**< Units of the samples to export. */
+
+static SchedstatSnapshot schedstat_snapshot; /**< Scheduler statistics, kept to diff the totals between reads. */
+
+static prom_gauge_t** const perf_metrics[PERF_RATIO_COUNT] = {
+    &perf_ipc_metric, &perf_cache_metric, &perf_branch_metric,
+};                           /**< Per-CPU efficiency gauges, indexed by PerfRatio. */
+static PerfTable perf_table; /**< Hardware event groups of every CPU, opened on the first run. */
+
+static const char* irq_label_keys[] = {"irq", "device", "cpu"}; /**< Label keys of the per-CPU interrupt counter. */
+static const char* softirq_label_keys[] = {"type", "cpu"};       /**< Label keys of the per-CPU softirq counter. */
+
+static IrqMatrix interrupts_matrix = {.path = INTERRUPTS_PATH}; /**< Interrupt counts of every line and CPU. */
+static IrqMatrix softirqs_matrix = {.path = SOFTIRQS_PATH};     /**< Softirq counts of every type and CPU. */
+static size_t irq_top = IRQ_TOP_DEFAULT;                        /**< Interrupt lines exported, from IRQ_TOP_ENV. */
+
+static prom_counter_t** const vmstat_metrics[VMSTAT_FIELD_COUNT] = {
+    &page_faults_metric, &page_major_faults_metric, &swap_in_metric, &swap_out_metric, &oom_kills_metric,
+}; /**< Paging counters, indexed by VmstatField. */
+
+static CgroupTable cgroup_table;   /**< cgroups tracked under /sys/fs/cgroup. */
+static bool cgroup_table_ready;    /**< Whether cgroup_table has been initialized. */
+static char cgroup_root[PATH_MAX]; /**< Root of cgroup_table when a snapshot is replayed. */
+
+static MountTable mount_table; /**< Mounts tracked across cycles. */
+static bool mount_table_ready; /**< Whether mount_table has been initialized. */
+
+static ShmExport shm_export;  /**< Shared memory snapshot named by SHM_EXPORT_NAME_ENV. */
+static bool shm_export_ready; /**< Whether shm_export has been opened. */
+
+static History history;    /**< Local history in the directory named by HISTORY_DIR_ENV. */
+static bool history_ready; /**< Whether history has been opened. */
+
+static RemoteWrite remote_write; /**< Remote-write client pushing to the URL named by REMOTE_WRITE_URL_ENV. */
+static bool remote_write_ready;  /**< Whether remote_write has been opened. */
+
+static Gateway gateway;    /**< Gateway scraping the monitors named by GATEWAY_TARGETS_ENV. */
+static bool gateway_ready; /**< Whether gateway has been opened. */
+
+static Companions companions; /**< Prometheus and Grafana servers named by COMPANIONS_ENV. */
+static bool companions_ready;  /**< Whether companions has been opened. */
+
+static size_t series_max;             /**< Most series of a labelled metric, from SERIES_MAX_ENV; 0 for no limit. */
+static size_t series_refused_reported; /**< Series refused for series_max as of the last sweep. */
+
+const MetricInfo all_metrics[] = {
+    METRIC_CATALOG(METRIC_INFO)
+    {NULL} // Sentinel value to mark the end of the array
+};
+
+#define METRIC_CATALOG_SIZE (0 METRIC_CATALOG(METRIC_ONE)) /**< Entries of all_metrics. */
+
+CollectorInfo all_collectors[] = {
+    {"proc_stat", &update_proc_stat_metrics},
+    {"memory", &update_memory_metrics},
+    {"disk_usage", &update_disk_gauge},
+    {"disk_stats", &update_disk_stats_metrics},
+    {"disk_devices", &update_disk_device_metrics},
+    {"filesystems", &update_filesystem_metrics},
+    {"network", &update_network_traffic_metric},
+    {"network_devices", &update_network_device_metrics},
+    {"process_states", &update_process_states_gauge},
+    {"hwmon", &update_hwmon_metrics},
+    {"pressure", &update_psi_metrics},
+    {"cgroups", &update_cgroup_metrics},
+    {"schedstat", &update_schedstat_metrics},
+    {"perf_events", &update_perf_metrics},
+    {"cpu_frequency", &update_cpu_frequency},
+    {"interrupts", &update_interrupt_metrics},
+    {"softirqs", &update_softirq_metrics},
+    {"vmstat", &update_vmstat_metrics},
+    {"shm_export", &update_shm_export},
+    {"history", &update_history},
+    {"remote_write", &update_remote_write},
+    {"gateway", &update_gateway},
+    {"companions", &update_companions},
+    {"series_sweep", &update_series_sweep},
+    {NULL, NULL} // Sentinel value to mark the end of the array
 };
+
+const char* collector_name(void (*update_function)(void))
+{
+    for (const CollectorInfo* info = all_collectors; info->name != NULL; info++)
+    {
+        if (info->update_function == update_function)
+        {
+            return info->name;
+        }
+    }
+    return "unknown";
+}
+
+void report_collector_timeout(void (*update_function)(void))
+{
+    const char* name = collector_name(update_function);
+    fprintf(stderr, "Collector '%s' missed its deadline\n", name);
+
+    if (collector_timeout_metric != NULL)
+    {
+        const char* label_values[] = {name};
+        prom_counter_inc(collector_timeout_metric, label_values);
+    }
+}
+
+/**
+ * @brief Returns the position of the first metric of the catalog whose name does not sort before a key.
+ */
+static size_t catalog_lower_bound(const char* key)
+{
+    size_t low = 0;
+    size_t high = METRIC_CATALOG_SIZE;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (strcmp(all_metrics[middle].name, key) < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+const MetricInfo* find_metric_info(const char* name)
+{
+    size_t index = catalog_lower_bound(name);
+    if (index < METRIC_CATALOG_SIZE && strcmp(all_metrics[index].name, name) == 0)
+    {
+        return &all_metrics[index];
+    }
+    return NULL;
+}
+
+size_t match_metrics(const char* pattern, metric_visit_fn visit, void* arg)
+{
+    if (strcmp(pattern, "all") == 0)
+    {
+        pattern = "*";
+    }
+
+    size_t prefix_length = strcspn(pattern, "*?[\\");
+    if (pattern[prefix_length] == '\0')
+    {
+        const MetricInfo* info = find_metric_info(pattern);
+        if (info != NULL)
+        {
+            visit(info, arg);
+        }
+        return info != NULL ? 1 : 0;
+    }
+
+    char prefix[prefix_length + 1];
+    memcpy(prefix, pattern, prefix_length);
+    prefix[prefix_length] = '\0';
+
+    size_t count = 0;
+    for (size_t i = catalog_lower_bound(prefix);
+         i < METRIC_CATALOG_SIZE && strncmp(all_metrics[i].name, prefix, prefix_length) == 0; i++)
+    {
+        if (fnmatch(pattern, all_metrics[i].name, 0) == 0)
+        {
+            visit(&all_metrics[i], arg);
+            count++;
+        }
+    }
+    return count;
+}
+
 void update_gauge(prom_gauge_t* metric, double value)
 {
-    pthread_mutex_lock(&lock);
-    prom_gauge_set(metric, value, NULL);
-    pthread_mutex_unlock(&lock);
+    // Collectors update every gauge they produce; gauges that were not selected are never created
+    if (metric == NULL)
+    {
+        return;
+    }
+
+    prom_gauge_set(metric, value, NULL);
+}
+
+void update_gauges(const prom_gauge_t** gauges, const double* values, size_t count)
+{
+    if (prom_gauge_set_many(gauges, values, count) != 0)
+    {
+        fprintf(stderr, "Error publishing gauge batch\n");
+    }
+}
+
+void update_counter(prom_counter_t* counter, unsigned long long value)
+{
+    if (counter == NULL)
+    {
+        return;
+    }
+
+    prom_metric_sample_t* sample = prom_counter_with_labels(counter, NULL);
+    if (sample == NULL || prom_metric_sample_set_u64(sample, value) != 0)
+    {
+        fprintf(stderr, "Error setting counter\n");
+    }
+}
+
+void update_counters(prom_counter_t* const* counters, const unsigned long long* values, size_t count)
+{
+    prom_gauge_batch_begin();
+    for (size_t i = 0; i < count; i++)
+    {
+        update_counter(counters[i], values[i]);
+    }
+    prom_gauge_batch_end();
+}
+
+/**
+ * @brief Makes sure the per-core state array can be indexed by the given CPU id.
+ *
+ * The array only grows, so it is reallocated when a CPU with a higher id comes online and never on a regular cycle.
+ *
+ * @param cpu The CPU id.
+ * @return 0 on success, or -1 if the array cannot be grown.
+ */
+static int reserve_cpu_core_state(int cpu)
+{
+    if ((size_t)cpu < cpu_core_capacity)
+    {
+        return 0;
+    }
+
+    size_t capacity = cpu_core_capacity ? cpu_core_capacity : 64;
+    while (capacity <= (size_t)cpu)
+    {
+        capacity *= 2;
+    }
+
+    CpuCoreState* states = aligned_alloc(CACHE_LINE_SIZE, capacity * sizeof(*states));
+    if (states == NULL)
+    {
+        perror("aligned_alloc");
+        return RETURN_ERROR;
+    }
+
+    if (cpu_core_states != NULL)
+    {
+        memcpy(states, cpu_core_states, cpu_core_capacity * sizeof(*states));
+        free(cpu_core_states);
+    }
+    for (size_t i = cpu_core_capacity; i < capacity; i++)
+    {
+        states[i].valid = false;
+        states[i].listed = false;
+        snprintf(states[i].label, sizeof(states[i].label), "%zu", i);
+        memset(states[i].samples, 0, sizeof(states[i].samples));
+    }
+
+    cpu_core_states = states;
+    cpu_core_capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Drops the state and the series of every core a /proc/stat snapshot no longer lists, as when it went offline.
+ *
+ * Must be called outside a gauge batch. A core that comes back starts over, as its counters did not advance meanwhile.
+ *
+ * @param snapshot The /proc/stat snapshot.
+ */
+static void release_offline_cpu_cores(const ProcStatSnapshot* snapshot)
+{
+    for (size_t i = 0; i < snapshot->cpu_count; i++)
+    {
+        int cpu = snapshot->cpus[i].cpu;
+        if (cpu >= 0 && (size_t)cpu < cpu_core_capacity)
+        {
+            cpu_core_states[cpu].listed = true;
+        }
+    }
+
+    for (size_t cpu = 0; cpu < cpu_core_capacity; cpu++)
+    {
+        CpuCoreState* state = &cpu_core_states[cpu];
+        if (!state->listed && state->valid)
+        {
+            for (int mode = 0; mode < CPU_MODE_COUNT; mode++)
+            {
+                if (state->samples[mode] != NULL)
+                {
+                    const char* label_values[] = {state->label, cpu_mode_names[mode]};
+                    prom_gauge_remove(cpu_core_usage_metric, label_values);
+                    state->samples[mode] = NULL;
+                }
+            }
+            state->valid = false;
+        }
+        state->listed = false;
+    }
+}
+
+/**
+ * @brief Publishes the per-mode usage of every core listed in a /proc/stat snapshot.
+ *
+ * Must be called inside a gauge batch.
+ *
+ * @param snapshot The /proc/stat snapshot.
+ */
+static void update_cpu_core_metrics(const ProcStatSnapshot* snapshot)
+{
+    for (size_t i = 0; i < snapshot->cpu_count; i++)
+    {
+        const CpuTimes* cur = &snapshot->cpus[i];
+        if (cur->cpu < 0 || reserve_cpu_core_state(cur->cpu) != 0)
+        {
+            continue;
+        }
+
+        CpuCoreState* state = &cpu_core_states[cur->cpu];
+        double percentages[CPU_MODE_COUNT];
+        if (state->valid && cpu_times_mode_percentages(&state->prev, cur, percentages) == 0)
+        {
+            for (int mode = 0; mode < CPU_MODE_COUNT; mode++)
+            {
+                if (state->samples[mode] == NULL)
+                {
+                    const char* label_values[] = {state->label, cpu_mode_names[mode]};
+                    state->samples[mode] = prom_gauge_with_labels(cpu_core_usage_metric, label_values);
+                    if (state->samples[mode] == NULL)
+                    {
+                        continue;
+                    }
+                }
+                prom_metric_sample_set(state->samples[mode], percentages[mode]);
+            }
+        }
+
+        state->prev = *cur;
+        state->valid = true;
+    }
+}
+
+void update_proc_stat_metrics(void)
+{
+    static ProcStatSnapshot snapshot;
+    static CpuTimes prev_total;
+    static bool prev_total_valid;
+
+    if (read_proc_stat_snapshot(&snapshot) != 0)
+    {
+        fprintf(stderr, "Error obtaining /proc/stat snapshot\n");
+        return;
+    }
+
+    // The first snapshot has nothing to be compared with; against zeros it would report the average since boot
+    double usage = prev_total_valid ? cpu_times_usage_percentage(&prev_total, &snapshot.total) : RETURN_ERROR;
+    prev_total = snapshot.total;
+    prev_total_valid = true;
+
+    if (cpu_core_usage_metric != NULL)
+    {
+        release_offline_cpu_cores(&snapshot);
+    }
+
+    // The aggregate and per-core values come from the same snapshot, so they are published as one batch
+    prom_gauge_batch_begin();
+    if (usage >= 0)
+    {
+        update_gauge(cpu_usage_metric, usage);
+    }
+    update_counter(context_switches_metric, snapshot.ctxt);
+    update_gauge(running_processes_metric, (double)snapshot.procs_running);
+    update_counter(interrupts_metric, snapshot.intr_total);
+    update_counter(forks_metric, snapshot.processes);
+    update_gauge(procs_blocked_metric, (double)snapshot.procs_blocked);
+    if (cpu_core_usage_metric != NULL)
+    {
+        update_cpu_core_metrics(&snapshot);
+    }
+    prom_gauge_batch_end();
+}
+
+void update_disk_gauge(void)
+{
+    double usage = get_disk_usage();
+    if (usage >= 0)
+    {
+        update_gauge(disk_usage_metric, usage);
+    }
+    else
+    {
+        fprintf(stderr, "Error obtaining disk usage\n");
+    }
+}
+
+/**
+ * @brief Sets the sample of one rank of a top-N gauge, resolving its handle on first use.
+ *
+ * @param metric The top-N gauge, or NULL if it is not selected.
+ * @param samples Per-rank sample handles of the gauge.
+ * @param rank Index of the rank.
+ * @param value The value to set.
+ */
+static void set_rank_sample(prom_gauge_t* metric, prom_metric_sample_t** samples, size_t rank, double value)
+{
+    if (metric == NULL)
+    {
+        return;
+    }
+
+    if (samples[rank] == NULL)
+    {
+        const char* label_values[] = {rank_labels[rank]};
+        samples[rank] = prom_gauge_with_labels(metric, label_values);
+        if (samples[rank] == NULL)
+        {
+            fprintf(stderr, "Error resolving rank %s sample\n", rank_labels[rank]);
+            return;
+        }
+    }
+    prom_metric_sample_set(samples[rank], value);
+}
+
+/**
+ * @brief Publishes a top-N ranking of the process table.
+ *
+ * @param key The ranking key.
+ * @param value_metric Gauge receiving the ranked value.
+ * @param value_samples Per-rank sample handles of value_metric.
+ * @param pid_metric Gauge receiving the PID of each ranked process.
+ * @param pid_samples Per-rank sample handles of pid_metric.
+ */
+static void update_top_processes(ProcessRankKey key, prom_gauge_t* value_metric, prom_metric_sample_t** value_samples,
+                                 prom_gauge_t* pid_metric, prom_metric_sample_t** pid_samples)
+{
+    if (value_metric == NULL && pid_metric == NULL)
+    {
+        return;
+    }
+
+    const ProcessEntry* top[TOP_PROCESSES];
+    size_t count = process_table_top(&process_table, key, top, TOP_PROCESSES);
+
+    prom_gauge_batch_begin();
+    for (size_t i = 0; i < TOP_PROCESSES; i++)
+    {
+        double value = 0;
+        double pid = 0;
+        if (i < count)
+        {
+            value = key == PROCESS_RANK_CPU ? top[i]->cpu_percentage
+                                            : (double)top[i]->rss_pages * (double)process_table.page_size;
+            pid = top[i]->pid;
+        }
+
+        set_rank_sample(value_metric, value_samples, i, value);
+        set_rank_sample(pid_metric, pid_samples, i, pid);
+    }
+    prom_gauge_batch_end();
+}
+
+void update_process_states_gauge(void)
+{
+    if (!process_table_ready)
+    {
+        if (process_table_init(&process_table) != 0)
+        {
+            fprintf(stderr, "Error initializing process table\n");
+            return;
+        }
+        process_table_ready = true;
+    }
+
+    if (process_table_scan(&process_table) != 0)
+    {
+        fprintf(stderr, "Error obtaining process states\n");
+        return;
+    }
+
+    const ProcessStateCounts* counts = &process_table.counts;
+    const prom_gauge_t* gauges[] = {total_processes_metric,   suspended_processes_metric, ready_processes_metric,
+                                    blocked_processes_metric, zombie_processes_metric,    stopped_processes_metric,
+                                    idle_processes_metric};
+    const double values[] = {counts->total,  counts->sleeping, counts->running, counts->disk_sleep,
+                             counts->zombie, counts->stopped,  counts->idle};
+    update_gauges(gauges, values, sizeof(gauges) / sizeof(gauges[0]));
+
+    update_top_processes(PROCESS_RANK_CPU, top_cpu_process_metric, top_cpu_process_samples, top_cpu_pid_metric,
+                         top_cpu_pid_samples);
+    update_top_processes(PROCESS_RANK_RSS, top_rss_process_metric, top_rss_process_samples, top_rss_pid_metric,
+                         top_rss_pid_samples);
+}
+
+/**
+ * @brief Drops the series of a sensor a hwmon discovery pass no longer finds, as when its device was unplugged.
+ */
+static void release_hwmon_sensor(const HwmonSensor* sensor)
+{
+    const char* label_values[] = {sensor->chip, sensor->sensor, sensor->label};
+    prom_gauge_remove(*hwmon_metrics[sensor->kind], label_values);
+}
+
+void update_hwmon_metrics(void)
+{
+    if (hwmon_table_read(&hwmon_table) < 0)
+    {
+        fprintf(stderr, "Error listing the hwmon sensors\n");
+        return;
+    }
+
+    prom_gauge_batch_begin();
+    for (size_t i = 0; i < hwmon_table.sensor_count; i++)
+    {
+        HwmonSensor* sensor = &hwmon_table.sensors[i];
+        prom_gauge_t* metric = *hwmon_metrics[sensor->kind];
+        if (!sensor->valid || metric == NULL)
+        {
+            continue;
+        }
+
+        if (sensor->sample == NULL)
+        {
+            const char* label_values[] = {sensor->chip, sensor->sensor, sensor->label};
+            sensor->sample = prom_gauge_with_labels(metric, label_values);
+            if (sensor->sample == NULL)
+            {
+                continue;
+            }
+        }
+        prom_metric_sample_set(sensor->sample, sensor->value);
+    }
+
+    // Roles no sensor fills are left unset rather than reported as errors on every cycle
+    for (int role = 0; role < HWMON_ROLE_COUNT; role++)
+    {
+        const HwmonSensor* sensor = hwmon_table_role(&hwmon_table, (HwmonRole)role);
+        if (sensor != NULL && sensor->valid)
+        {
+            update_gauge(*hwmon_role_metrics[role], sensor->value);
+        }
+    }
+    prom_gauge_batch_end();
+}
+
+void update_cpu_frequency(void)
+{
+    if (cpufreq_table_read(&cpufreq_table) < 0)
+    {
+        fprintf(stderr, "Error listing the CPU frequencies\n");
+        return;
+    }
+
+    prom_gauge_batch_begin();
+    for (size_t i = 0; i < cpufreq_table.cpu_count; i++)
+    {
+        CpuFreqEntry* cpu = &cpufreq_table.cpus[i];
+        if (!cpu->valid || core_freq_metric == NULL)
+        {
+            continue;
+        }
+
+        if (cpu->sample == NULL)
+        {
+            const char* label_values[] = {cpu->label};
+            cpu->sample = prom_gauge_with_labels(core_freq_metric, label_values);
+            if (cpu->sample == NULL)
+            {
+                continue;
+            }
+        }
+        prom_metric_sample_set(cpu->sample, cpu->mhz);
+    }
+
+    // The single-value gauge keeps reporting the lowest CPU, which used to be read from cpu0 alone
+    if (cpufreq_table.cpu_count > 0 && cpufreq_table.cpus[0].valid)
+    {
+        update_gauge(cpu_frequency_metric, cpufreq_table.cpus[0].mhz);
+    }
+    prom_gauge_batch_end();
+}
+
+void update_memory_metrics(void)
+{
+    MemInfoSnapshot snapshot;
+    if (read_meminfo_snapshot(&snapshot) != 0)
+    {
+        fprintf(stderr, "Error obtaining memory information\n");
+        return;
+    }
+
+    const prom_gauge_t* gauges[] = {total_memory_metric, used_memory_metric, available_memory_metric,
+                                    memory_usage_metric};
+    const double values[] = {snapshot.mem_total / CONVERT_TO_MB, meminfo_used_mb(&snapshot),
+                             snapshot.mem_available / CONVERT_TO_MB, meminfo_usage_percentage(&snapshot)};
+    update_gauges(gauges, values, sizeof(gauges) / sizeof(gauges[0]));
+}
+
+void update_network_traffic_metric(void)
+{
+    NetworkStats stats;
+    if (get_network_traffic(&stats) != 0)
+    {
+        // Publishing nothing keeps the counters from dropping to an error value and looking reset
+        return;
+    }
+    prom_counter_t* const counters[] = {rx_bytes_metric, tx_bytes_metric, rx_errors_metric, tx_errors_metric,
+                                        dropped_packets_metric};
+    const unsigned long long values[] = {stats.rx_bytes, stats.tx_bytes, stats.rx_errors, stats.tx_errors,
+                                         stats.dropped_packets};
+    update_counters(counters, values, sizeof(counters) / sizeof(counters[0]));
+}
+
+/**
+ * @brief Makes sure the per-position device state array holds at least the given number of entries.
+ *
+ * @param count The number of devices.
+ * @return 0 on success, or -1 if the array cannot be grown.
+ */
+static int reserve_net_dev_states(size_t count)
+{
+    if (count <= net_dev_capacity)
+    {
+        return 0;
+    }
+
+    size_t capacity = net_dev_capacity ? net_dev_capacity : 64;
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+
+    NetDevState* states = realloc(net_dev_states, capacity * sizeof(*states));
+    if (states == NULL)
+    {
+        perror("realloc");
+        return RETURN_ERROR;
+    }
+
+    for (size_t i = net_dev_capacity; i < capacity; i++)
+    {
+        states[i].name[0] = '\0';
+        states[i].reported = false;
+    }
+
+    net_dev_states = states;
+    net_dev_capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Drops the series of every device a /proc/net/dev snapshot no longer lists, as when a link was deleted.
+ *
+ * Must be called outside a gauge batch. A position whose device only moved is forgotten, and the device keeps its
+ * series.
+ *
+ * @param snapshot The /proc/net/dev snapshot.
+ */
+static void release_vanished_net_devs(const NetDevSnapshot* snapshot)
+{
+    for (size_t i = 0; i < net_dev_capacity; i++)
+    {
+        NetDevState* state = &net_dev_states[i];
+        if (state->name[0] == '\0' ||
+            (i < snapshot->device_count && strcmp(state->name, snapshot->devices[i].name) == 0))
+        {
+            continue;
+        }
+
+        bool listed = false;
+        for (size_t j = 0; j < snapshot->device_count && !listed; j++)
+        {
+            listed = strcmp(state->name, snapshot->devices[j].name) == 0;
+        }
+        for (int m = 0; m < NET_DEV_METRIC_COUNT && !listed && state->reported; m++)
+        {
+            if (state->samples[m] != NULL)
+            {
+                const char* label_values[] = {state->name};
+                prom_counter_remove(*net_dev_metrics[m].metric, label_values);
+            }
+        }
+        state->name[0] = '\0';
+        state->reported = false;
+        memset(state->samples, 0, sizeof(state->samples));
+    }
+}
+
+void update_network_device_metrics(void)
+{
+    static NetDevSnapshot snapshot;
+
+    if (read_net_dev_snapshot(&snapshot) != 0 || reserve_net_dev_states(snapshot.device_count) != 0)
+    {
+        fprintf(stderr, "Error obtaining network device stats\n");
+        return;
+    }
+    release_vanished_net_devs(&snapshot);
+
+    // Every device comes from the same read of /proc/net/dev, so the whole family is published as one batch
+    prom_gauge_batch_begin();
+    for (size_t i = 0; i < snapshot.device_count; i++)
+    {
+        const NetDevStats* device = &snapshot.devices[i];
+        NetDevState* state = &net_dev_states[i];
+        if (strcmp(state->name, device->name) != 0)
+        {
+            memcpy(state->name, device->name, sizeof(state->name));
+            state->reported = name_filter_match(&net_dev_filter, state->name);
+            memset(state->samples, 0, sizeof(state->samples));
+        }
+        if (!state->reported)
+        {
+            continue;
+        }
+
+        for (int m = 0; m < NET_DEV_METRIC_COUNT; m++)
+        {
+            prom_counter_t* metric = *net_dev_metrics[m].metric;
+            if (metric == NULL)
+            {
+                continue;
+            }
+            if (state->samples[m] == NULL)
+            {
+                const char* label_values[] = {state->name};
+                state->samples[m] = prom_counter_with_labels(metric, label_values);
+                if (state->samples[m] == NULL)
+                {
+                    continue;
+                }
+            }
+            prom_metric_sample_set_u64(state->samples[m], device->counters[net_dev_metrics[m].counter]);
+        }
+    }
+    prom_gauge_batch_end();
+}
+
+void update_disk_stats_metrics(void)
+{
+    DiskStats stats;
+    if (get_disk_stats(&stats) == 0)
+    {
+        prom_counter_t* const counters[] = {io_time_metric, writes_completed_metric, reads_completed_metric};
+        const unsigned long long values[] = {stats.io_time, stats.writes_completed, stats.reads_completed};
+        update_counters(counters, values, sizeof(counters) / sizeof(counters[0]));
+    }
+    else
+    {
+        fprintf(stderr, "Error obtaining disk stats\n");
+    }
+}
+
+/**
+ * @brief Makes sure the per-position disk state array holds at least the given number of entries.
+ *
+ * @param count The number of devices.
+ * @return 0 on success, or -1 if the array cannot be grown.
+ */
+static int reserve_disk_device_states(size_t count)
+{
+    if (count <= disk_device_capacity)
+    {
+        return 0;
+    }
+
+    size_t capacity = disk_device_capacity ? disk_device_capacity : 64;
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+
+    DiskDeviceState* states = realloc(disk_device_states, capacity * sizeof(*states));
+    if (states == NULL)
+    {
+        perror("realloc");
+        return RETURN_ERROR;
+    }
+
+    for (size_t i = disk_device_capacity; i < capacity; i++)
+    {
+        states[i].name[0] = '\0';
+        states[i].valid = false;
+    }
+
+    disk_device_states = states;
+    disk_device_capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Drops the series of every disk a /proc/diskstats snapshot no longer lists, as when a device was removed.
+ *
+ * Must be called outside a gauge batch. A position whose disk only moved is forgotten, and the disk keeps its series.
+ *
+ * @param snapshot The /proc/diskstats snapshot.
+ */
+static void release_vanished_disk_devices(const DiskStatsSnapshot* snapshot)
+{
+    for (size_t i = 0; i < disk_device_capacity; i++)
+    {
+        DiskDeviceState* state = &disk_device_states[i];
+        if (state->name[0] == '\0' ||
+            (i < snapshot->device_count && strcmp(state->name, snapshot->devices[i].name) == 0))
+        {
+            continue;
+        }
+
+        bool listed = false;
+        for (size_t j = 0; j < snapshot->device_count && !listed; j++)
+        {
+            listed = strcmp(state->name, snapshot->devices[j].name) == 0;
+        }
+        for (int m = 0; m < DISK_DEVICE_METRIC_COUNT && !listed; m++)
+        {
+            if (state->samples[m] != NULL)
+            {
+                const char* label_values[] = {state->name};
+                prom_gauge_remove(*disk_device_metrics[m], label_values);
+            }
+        }
+        state->name[0] = '\0';
+        state->valid = false;
+        memset(state->samples, 0, sizeof(state->samples));
+    }
+}
+
+void update_disk_device_metrics(void)
+{
+    static DiskStatsSnapshot snapshot;
+    static struct timespec prev_timestamp;
+
+    if (read_diskstats_snapshot(&snapshot) != 0 || reserve_disk_device_states(snapshot.device_count) != 0)
+    {
+        fprintf(stderr, "Error obtaining disk device stats\n");
+        return;
+    }
+    release_vanished_disk_devices(&snapshot);
+
+    double elapsed = (double)(snapshot.timestamp.tv_sec - prev_timestamp.tv_sec) +
+                     (double)(snapshot.timestamp.tv_nsec - prev_timestamp.tv_nsec) / 1e9;
+    prev_timestamp = snapshot.timestamp;
+
+    prom_gauge_batch_begin();
+    for (size_t i = 0; i < snapshot.device_count; i++)
+    {
+        const DiskDeviceStats* cur = &snapshot.devices[i];
+        if (cur->kind != DISK_KIND_PHYSICAL && cur->kind != DISK_KIND_STACKED)
+        {
+            continue;
+        }
+
+        DiskDeviceState* state = &disk_device_states[i];
+        if (strcmp(state->name, cur->name) != 0)
+        {
+            memcpy(state->name, cur->name, sizeof(state->name));
+            state->valid = false;
+            memset(state->samples, 0, sizeof(state->samples));
+        }
+
+        DiskDeviceRates rates;
+        if (state->valid && disk_device_rates(&state->prev, cur, elapsed, &rates) == 0)
+        {
+            const double values[DISK_DEVICE_METRIC_COUNT] = {
+                rates.reads_per_second,       rates.writes_per_second, rates.read_bytes_per_second,
+                rates.write_bytes_per_second, rates.await_ms,          rates.utilization,
+            };
+            for (int m = 0; m < DISK_DEVICE_METRIC_COUNT; m++)
+            {
+                prom_gauge_t* metric = *disk_device_metrics[m];
+                if (metric == NULL)
+                {
+                    continue;
+                }
+                if (state->samples[m] == NULL)
+                {
+                    const char* label_values[] = {state->name};
+                    state->samples[m] = prom_gauge_with_labels(metric, label_values);
+                    if (state->samples[m] == NULL)
+                    {
+                        continue;
+                    }
+                }
+                prom_metric_sample_set(state->samples[m], values[m]);
+            }
+        }
+
+        state->prev = *cur;
+        state->valid = true;
+    }
+    prom_gauge_batch_end();
+}
+
+/**
+ * @brief Sets a labelled sample, resolving its handle on first use.
+ */
+static void set_labelled_sample(prom_gauge_t* metric, prom_metric_sample_t** sample, const char** label_values,
+                                double value)
+{
+    if (metric == NULL)
+    {
+        return;
+    }
+
+    if (*sample == NULL)
+    {
+        *sample = prom_gauge_with_labels(metric, label_values);
+        if (*sample == NULL)
+        {
+            return;
+        }
+    }
+    prom_metric_sample_set(*sample, value);
+}
+
+/**
+ * @brief Sets a labelled integer counter, resolving its handle on first use.
+ */
+static void set_labelled_count(prom_counter_t* metric, prom_metric_sample_t** sample, const char** label_values,
+                               unsigned long long value)
+{
+    if (metric == NULL)
+    {
+        return;
+    }
+
+    if (*sample == NULL)
+    {
+        *sample = prom_counter_with_labels(metric, label_values);
+        if (*sample == NULL)
+        {
+            return;
+        }
+    }
+    if (prom_metric_sample_set_u64(*sample, value) != 0)
+    {
+        fprintf(stderr, "Error setting counter\n");
+    }
+}
+
+/**
+ * @brief Sets a labelled counter holding a double, resolving its handle on first use.
+ */
+static void set_labelled_total(prom_counter_t* metric, prom_metric_sample_t** sample, const char** label_values,
+                               double value)
+{
+    if (metric == NULL)
+    {
+        return;
+    }
+
+    if (*sample == NULL)
+    {
+        *sample = prom_counter_with_labels(metric, label_values);
+        if (*sample == NULL)
+        {
+            return;
+        }
+    }
+    if (prom_metric_sample_set_counter(*sample, value) != 0)
+    {
+        fprintf(stderr, "Error setting counter\n");
+    }
+}
+
+void update_psi_metrics(void)
+{
+    if (read_psi_snapshot(&psi_snapshot) != 0)
+    {
+        return;
+    }
+
+    prom_gauge_batch_begin();
+    for (int r = 0; r < PSI_RESOURCE_COUNT; r++)
+    {
+        for (int k = 0; k < PSI_KIND_COUNT; k++)
+        {
+            const PsiLine* line = &psi_snapshot.lines[r][k];
+            if (!line->valid)
+            {
+                continue;
+            }
+
+            for (int w = 0; w < PSI_WINDOW_COUNT; w++)
+            {
+                const char* label_values[] = {psi_resource_names[r], psi_kind_names[k], psi_window_names[w]};
+                set_labelled_sample(psi_avg_metric, &psi_avg_samples[r][k][w], label_values, line->avg[w]);
+            }
+
+            const char* label_values[] = {psi_resource_names[r], psi_kind_names[k]};
+            set_labelled_total(psi_total_metric, &psi_total_samples[r][k], label_values, (double)line->total_us / 1e6);
+        }
+    }
+    prom_gauge_batch_end();
+}
+
+void update_schedstat_metrics(void)
+{
+    if (read_schedstat_snapshot(&schedstat_snapshot) != 0)
+    {
+        return;
+    }
+
+    prom_gauge_batch_begin();
+    for (size_t i = 0; i < schedstat_snapshot.cpu_count; i++)
+    {
+        SchedstatCpu* cpu = &schedstat_snapshot.cpus[i];
+        const char* label_values[] = {cpu->label};
+        for (int f = 0; f < SCHEDSTAT_FIELD_COUNT; f++)
+        {
+            // Timeslices are a plain count, exported exactly
+            if (f == SCHEDSTAT_TIMESLICES)
+            {
+                set_labelled_count(*sched_metrics[f], &cpu->samples[f], label_values, cpu->values[f]);
+            }
+            else
+            {
+                set_labelled_total(*sched_metrics[f], &cpu->samples[f], label_values,
+                                   (double)cpu->values[f] * sched_scales[f]);
+            }
+        }
+    }
+
+    double latency;
+    if (schedstat_runqueue_latency(&schedstat_snapshot, &latency) == 0)
+    {
+        update_gauge(runqueue_latency_metric, latency);
+    }
+    prom_gauge_batch_end();
+}
+
+void update_perf_metrics(void)
+{
+    if (perf_table_read(&perf_table) != 0)
+    {
+        return;
+    }
+
+    prom_gauge_batch_begin();
+    for (size_t i = 0; i < perf_table.cpu_count; i++)
+    {
+        PerfCpu* cpu = &perf_table.cpus[i];
+        const char* label_values[] = {cpu->label};
+        for (int r = 0; r < PERF_RATIO_COUNT; r++)
+        {
+            if (!isnan(cpu->ratios[r]))
+            {
+                set_labelled_sample(*perf_metrics[r], &cpu->samples[r], label_values, cpu->ratios[r]);
+            }
+        }
+    }
+    prom_gauge_batch_end();
+}
+
+/**
+ * @brief Fills the label values of a count of a matrix: the name of its line, its device for interrupts, and its CPU.
+ */
+static void irq_label_values(const IrqMatrix* matrix, const IrqLine* line, size_t cpu, const char** label_values)
+{
+    size_t n = 0;
+    label_values[n++] = line->name;
+    if (matrix == &interrupts_matrix)
+    {
+        label_values[n++] = line->device;
+    }
+    label_values[n] = matrix->cpu_labels[cpu];
+}
+
+/**
+ * @brief Exports the counts of the selected lines of a matrix, after dropping the series of the lines no longer
+ *        selected.
+ */
+static void export_irq_matrix(IrqMatrix* matrix, prom_counter_t* metric)
+{
+    const char* label_values[3];
+    for (size_t l = 0; l < matrix->line_count; l++)
+    {
+        IrqLine* line = &matrix->lines[l];
+        for (size_t c = 0; line->reported && !line->selected && c < matrix->cpu_slots; c++)
+        {
+            prom_metric_sample_t** sample = irq_matrix_sample(matrix, l, c);
+            if (*sample != NULL)
+            {
+                irq_label_values(matrix, line, c, label_values);
+                prom_counter_remove(metric, label_values);
+                *sample = NULL;
+            }
+        }
+        line->reported = line->selected;
+    }
+
+    // Every count comes from the same read, so the whole matrix is published as one batch
+    prom_gauge_batch_begin();
+    for (size_t l = 0; l < matrix->line_count; l++)
+    {
+        IrqLine* line = &matrix->lines[l];
+        for (size_t c = 0; line->reported && c < matrix->column_count; c++)
+        {
+            size_t cpu = (size_t)matrix->columns[c];
+            prom_metric_sample_t** sample = irq_matrix_sample(matrix, l, cpu);
+            if (*sample == NULL)
+            {
+                irq_label_values(matrix, line, cpu, label_values);
+                *sample = prom_counter_with_labels(metric, label_values);
+                if (*sample == NULL)
+                {
+                    continue;
+                }
+            }
+            prom_metric_sample_set_u64(*sample, irq_matrix_count(matrix, l, cpu));
+        }
+    }
+    prom_gauge_batch_end();
+}
+
+void update_interrupt_metrics(void)
+{
+    if (irq_interrupts_metric != NULL && irq_matrix_read(&interrupts_matrix, irq_top) == 0)
+    {
+        export_irq_matrix(&interrupts_matrix, irq_interrupts_metric);
+    }
+}
+
+void update_softirq_metrics(void)
+{
+    if (softirqs_metric != NULL && irq_matrix_read(&softirqs_matrix, 0) == 0)
+    {
+        export_irq_matrix(&softirqs_matrix, softirqs_metric);
+    }
+}
+
+void update_vmstat_metrics(void)
+{
+    VmstatSnapshot snapshot;
+    if (read_vmstat_snapshot(&snapshot) != 0)
+    {
+        fprintf(stderr, "Error obtaining vmstat counters\n");
+        return;
+    }
+
+    prom_gauge_batch_begin();
+    for (int f = 0; f < VMSTAT_FIELD_COUNT; f++)
+    {
+        if (snapshot.present[f])
+        {
+            update_counter(*vmstat_metrics[f], snapshot.values[f]);
+        }
+    }
+    prom_gauge_batch_end();
+}
+
+/**
+ * @brief Drops the samples of a cgroup that was removed or is no longer populated.
+ */
+static void release_cgroup_samples(CgroupEntry* entry)
+{
+    const char* label_values[] = {entry->name};
+    for (int s = 0; s < CGROUP_STAT_COUNT; s++)
+    {
+        if (entry->samples[s] != NULL)
+        {
+            if (cgroup_counters[s] || cgroup_totals[s])
+            {
+                prom_counter_remove(*cgroup_metrics[s], label_values);
+            }
+            else
+            {
+                prom_gauge_remove(*cgroup_metrics[s], label_values);
+            }
+            entry->samples[s] = NULL;
+        }
+    }
+}
+
+void update_cgroup_metrics(void)
+{
+    if (!cgroup_table_ready)
+    {
+        const char* root = sysroot_path(CGROUP_ROOT_PATH, cgroup_root, sizeof(cgroup_root));
+        if (root == NULL || cgroup_table_init(&cgroup_table, root, &release_cgroup_samples) != 0)
+        {
+            fprintf(stderr, "Error initializing cgroup table\n");
+            return;
+        }
+        cgroup_table_ready = true;
+    }
+
+    // Samples of removed cgroups are dropped here, before the batch starts
+    if (cgroup_table_read(&cgroup_table) != 0)
+    {
+        return;
+    }
+
+    prom_gauge_batch_begin();
+    for (CgroupEntry* entry = cgroup_table_next(&cgroup_table, NULL); entry != NULL;
+         entry = cgroup_table_next(&cgroup_table, entry))
+    {
+        if (!entry->reported)
+        {
+            continue;
+        }
+
+        const char* label_values[] = {entry->name};
+        for (int s = 0; s < CGROUP_STAT_COUNT; s++)
+        {
+            if (entry->valid[s] && cgroup_counters[s])
+            {
+                set_labelled_count(*cgroup_metrics[s], &entry->samples[s], label_values, entry->counts[s]);
+            }
+            else if (entry->valid[s] && cgroup_totals[s])
+            {
+                set_labelled_total(*cgroup_metrics[s], &entry->samples[s], label_values, entry->values[s]);
+            }
+            else if (entry->valid[s])
+            {
+                set_labelled_sample(*cgroup_metrics[s], &entry->samples[s], label_values, entry->values[s]);
+            }
+        }
+    }
+    prom_gauge_batch_end();
 }
 
-void update_cpu_gauge(void)
+void watch_collector_events(Scheduler* scheduler)
 {
-    double usage = get_cpu_usage();
-    if (usage >= 0)
+    const char* spec = getenv(PSI_TRIGGER_ENV);
+    if (spec == NULL)
     {
-        update_gauge(cpu_usage_metric, usage);
+        spec = PSI_TRIGGER_DEFAULT;
     }
-    else
+    const ScheduledCollector* entry = scheduler_find(scheduler, &update_psi_metrics);
+    if (*spec == '\0' || entry == NULL || entry->watch_count > 0)
+    {
+        return;
+    }
+
+    for (int r = 0; r < PSI_RESOURCE_COUNT; r++)
     {
-        fprintf(stderr, "Error obtaining CPU usage\n");
+        int fd = psi_trigger_open((PsiResource)r, spec);
+        if (fd >= 0 && scheduler_watch(scheduler, fd, &update_psi_metrics) != 0)
+        {
+            fprintf(stderr, "Error watching the %s pressure trigger\n", psi_resource_names[r]);
+        }
     }
 }
 
-void update_memory_gauge(void)
+void update_shm_export(void)
 {
-    double usage = get_memory_usage();
-    if (usage >= 0)
+    if (shm_export_ready)
     {
-        update_gauge(memory_usage_metric, usage);
+        shm_export_publish(&shm_export);
     }
-    else
+}
+
+void update_history(void)
+{
+    if (history_ready)
     {
-        fprintf(stderr, "Error obtaining memory usage\n");
+        history_record(&history);
     }
 }
 
-void update_disk_gauge(void)
+void update_remote_write(void)
 {
-    double usage = get_disk_usage();
-    if (usage >= 0)
+    if (remote_write_ready)
     {
-        update_gauge(disk_usage_metric, usage);
+        remote_write_queue(&remote_write);
     }
-    else
+}
+
+void update_gateway(void)
+{
+    if (gateway_ready)
     {
-        fprintf(stderr, "Error obtaining disk usage\n");
+        gateway_scrape(&gateway);
     }
 }
 
-void update_running_processes_gauge(void)
+void update_companions(void)
 {
-    FILE* fp = fopen(PROC_STAT_PATH, "r");
-    if (fp == NULL)
+    if (companions_ready)
     {
-        perror("Error opening /proc/stat");
-        return;
+        companions_supervise(&companions);
+    }
+}
+
+void update_series_sweep(void)
+{
+    size_t evicted = 0;
+    if (prom_collector_registry_sweep(PROM_COLLECTOR_REGISTRY_DEFAULT, &evicted) != 0)
+    {
+        fprintf(stderr, "Error sweeping idle series\n");
     }
 
-    char buffer[BUFFER_SIZE];
-    unsigned long running_processes = 0;
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    size_t refused = 0;
+    for (size_t i = 0; series_max > 0 && all_metrics[i].name != NULL; i++)
     {
-        if (sscanf(buffer, "procs_running %lu", &running_processes) == 1)
+        if (all_metrics[i].label_count > 0 && *(all_metrics[i].metric) != NULL)
         {
-            break;
+            refused += prom_metric_refused_series((prom_metric_t*)*(all_metrics[i].metric));
         }
     }
-    fclose(fp);
-
-    update_gauge(running_processes_metric, (double)running_processes);
+    if (refused > series_refused_reported)
+    {
+        fprintf(stderr, "Refused %zu new series over %s=%zu\n", refused - series_refused_reported, SERIES_MAX_ENV,
+                series_max);
+        series_refused_reported = refused;
+    }
 }
 
-void update_process_states_gauge(void)
+void update_rollups(void (*update_function)(void))
 {
-    int total, suspended, ready, blocked;
-    get_process_states(&total, &suspended, &ready, &blocked);
-
-    pthread_mutex_lock(&lock);
-    prom_gauge_set(total_processes_metric, total, NULL);
-    prom_gauge_set(suspended_processes_metric, suspended, NULL);
-    prom_gauge_set(ready_processes_metric, ready, NULL);
-    prom_gauge_set(blocked_processes_metric, blocked, NULL);
-    pthread_mutex_unlock(&lock);
+    for (size_t i = 0; all_metrics[i].name != NULL; i++)
+    {
+        const MetricInfo* info = &all_metrics[i];
+        if (info->rollup != NULL && info->update_function == update_function && *(info->metric) != NULL)
+        {
+            rollup_observe(info->rollup, *(info->metric));
+        }
+    }
 }
 
-void update_cpu_temperature(void)
+void update_rates(void (*update_function)(void))
 {
-    double cpu_temp = get_cpu_temperature();
-    if (cpu_temp >= 0)
+    for (size_t i = 0; all_metrics[i].name != NULL; i++)
     {
-        update_gauge(cpu_temp_metric, cpu_temp);
+        const MetricInfo* info = &all_metrics[i];
+        if (info->rate != NULL && info->update_function == update_function && *(info->metric) != NULL)
+        {
+            rate_observe(info->rate, *(info->metric));
+        }
     }
-    else
+}
+
+/**
+ * @brief Copies the value of one series into the current values of a collector.
+ */
+static void stage_adaptive_sample(size_t index, const prom_sample_view_t* view, void* arg)
+{
+    AdaptiveState* state = arg;
+    size_t slot = state->base + index;
+    if (slot >= state->capacity)
     {
-        fprintf(stderr, "Error getting CPU temperature\n");
+        size_t capacity = state->capacity > 0 ? state->capacity * 2 : 64;
+        while (capacity <= slot)
+        {
+            capacity *= 2;
+        }
+        double* previous = realloc(state->previous, capacity * sizeof(double));
+        if (previous != NULL)
+        {
+            state->previous = previous;
+        }
+        double* current = previous != NULL ? realloc(state->current, capacity * sizeof(double)) : NULL;
+        if (current == NULL)
+        {
+            state->overflow = true;
+            return;
+        }
+        state->current = current;
+        state->capacity = capacity;
     }
+    state->current[slot] = view->integer ? (double)view->u_value : view->value;
 }
 
-void update_battery_voltage(void)
+bool collector_metrics_changed(void (*update_function)(void))
 {
-    double voltage = get_battery_voltage();
-    if (voltage >= 0)
+    size_t c = 0;
+    while (all_collectors[c].name != NULL && all_collectors[c].update_function != update_function)
     {
-        update_gauge(battery_voltage_metric, voltage);
+        c++;
     }
-    else
+    if (all_collectors[c].name == NULL || c >= MAX_COLLECTORS)
     {
-        fprintf(stderr, "Error getting battery voltage\n");
+        return true;
     }
+
+    // Only the thread running the collector gets here, and a collector never runs twice at once
+    AdaptiveState* state = &adaptive_states[c];
+    state->base = 0;
+    state->overflow = false;
+    for (size_t i = 0; all_metrics[i].name != NULL; i++)
+    {
+        const MetricInfo* info = &all_metrics[i];
+        size_t count = 0;
+        if (info->update_function == update_function && *(info->metric) != NULL &&
+            prom_metric_visit_samples((prom_metric_t*)*(info->metric), stage_adaptive_sample, state, &count) == 0)
+        {
+            state->base += count;
+        }
+    }
+
+    // A collector without series, such as an exporter, is never slowed down
+    bool changed = state->overflow || state->base == 0 || state->base != state->previous_count;
+    for (size_t i = 0; i < state->base && !changed; i++)
+    {
+        double delta = state->current[i] - state->previous[i];
+        double scale = state->previous[i] < 0 ? -state->previous[i] : state->previous[i];
+        double limit = adaptive_epsilon * (scale > 1.0 ? scale : 1.0);
+        // NaN compares false both ways, so a series turning NaN or back counts as a change
+        changed = !(delta <= limit && -delta <= limit);
+    }
+
+    double* swap = state->previous;
+    state->previous = state->current;
+    state->current = swap;
+    state->previous_count = state->overflow ? 0 : state->base;
+    return changed;
 }
 
-void update_battery_current(void)
+void init_adaptive_sampling(Scheduler* scheduler)
 {
-    double current = get_battery_current();
-    if (current >= 0)
+    const char* max_env = getenv(ADAPTIVE_MAX_INTERVAL_ENV);
+    if (max_env == NULL || *max_env == '\0')
     {
-        update_gauge(battery_current_metric, current);
+        return;
     }
-    else
+
+    char* end = NULL;
+    unsigned long max_interval_ms = strtoul(max_env, &end, 10);
+    if (*end != '\0' || max_interval_ms == 0 || max_interval_ms > UINT_MAX)
+    {
+        fprintf(stderr, "Invalid %s '%s', adaptive sampling stays off\n", ADAPTIVE_MAX_INTERVAL_ENV, max_env);
+        return;
+    }
+
+    const char* epsilon_env = getenv(ADAPTIVE_EPSILON_ENV);
+    if (epsilon_env != NULL && *epsilon_env != '\0')
     {
-        fprintf(stderr, "Error getting battery current\n");
+        double epsilon = strtod(epsilon_env, &end);
+        if (*end != '\0' || !(epsilon >= 0.0))
+        {
+            fprintf(stderr, "Invalid %s '%s', using %g\n", ADAPTIVE_EPSILON_ENV, epsilon_env, ADAPTIVE_EPSILON_DEFAULT);
+        }
+        else
+        {
+            adaptive_epsilon = epsilon;
+        }
     }
+
+    scheduler_set_adaptive(scheduler, collector_metrics_changed, (unsigned int)max_interval_ms);
 }
 
-void update_cpu_frequency(void)
+/**
+ * @brief Tells whether a collector reads metrics, rather than exporting them, and can therefore run on demand.
+ */
+static bool runs_on_demand(collector_fn update_function)
 {
-    double freq = get_cpu_frequency();
-    if (freq >= 0)
+    return update_function != &update_shm_export && update_function != &update_history &&
+           update_function != &update_remote_write && update_function != &update_gateway &&
+           update_function != &update_companions && update_function != &update_series_sweep;
+}
+
+/**
+ * @brief Runs the stale collectors before a scrape is rendered, when collection is lazy.
+ */
+static void collect_on_scrape(void* arg)
+{
+    (void)arg;
+    Scheduler* scheduler = atomic_load(&lazy_scheduler);
+    if (scheduler != NULL)
     {
-        update_gauge(cpu_frequency_metric, freq);
+        // A collector that did not return in time is reported by the scheduler; the scrape gets its last values
+        scheduler_collect_stale(scheduler);
     }
-    else
+}
+
+void init_lazy_collection(Scheduler* scheduler)
+{
+    const char* lazy_env = getenv(LAZY_COLLECTION_ENV);
+    if (lazy_env == NULL || *lazy_env == '\0')
+    {
+        return;
+    }
+    if (strcmp(lazy_env, "1") != 0)
     {
-        fprintf(stderr, "Error getting CPU frequency\n");
+        fprintf(stderr, "Invalid %s '%s', collectors run on their intervals\n", LAZY_COLLECTION_ENV, lazy_env);
+        return;
     }
+
+    scheduler_set_lazy(scheduler, runs_on_demand);
+    atomic_store(&lazy_scheduler, scheduler);
+}
+
+void stop_lazy_collection(void)
+{
+    atomic_store(&lazy_scheduler, NULL);
 }
 
-void update_cpu_fan_speed(void)
+void add_export_collectors(CollectorDispatch* dispatch)
 {
-    double speed = get_cpu_fan_speed();
-    if (speed >= 0)
+    if (shm_export_ready && dispatch_add(dispatch, &update_shm_export, SHM_EXPORT_INTERVAL_MS) != 0)
     {
-        update_gauge(cpu_fan_speed_metric, speed);
+        fprintf(stderr, "Error scheduling the shared memory export\n");
     }
-    else
+    if (history_ready && dispatch_add(dispatch, &update_history, HISTORY_INTERVAL_MS) != 0)
+    {
+        fprintf(stderr, "Error scheduling the history\n");
+    }
+    if (remote_write_ready && dispatch_add(dispatch, &update_remote_write, REMOTE_WRITE_INTERVAL_MS) != 0)
+    {
+        fprintf(stderr, "Error scheduling the remote write\n");
+    }
+    if (gateway_ready && dispatch_add(dispatch, &update_gateway, GATEWAY_INTERVAL_MS) != 0)
+    {
+        fprintf(stderr, "Error scheduling the gateway\n");
+    }
+    if (companions_ready && dispatch_add(dispatch, &update_companions, COMPANION_INTERVAL_MS) != 0)
+    {
+        fprintf(stderr, "Error scheduling the companion supervision\n");
+    }
+    if (dispatch_add(dispatch, &update_series_sweep, SERIES_SWEEP_INTERVAL_MS) != 0)
     {
-        fprintf(stderr, "Error getting CPU fan speed\n");
+        fprintf(stderr, "Error scheduling the series sweep\n");
     }
 }
 
-void update_gpu_fan_speed(void)
+void stop_export_collectors(void)
 {
-    double speed = get_gpu_fan_speed();
-    if (speed >= 0)
+    if (gateway_ready)
     {
-        update_gauge(gpu_fan_speed_metric, speed);
+        gateway_ready = false;
+        gateway_close(&gateway);
     }
-    else
+}
+
+/**
+ * @brief Opens the history if HISTORY_DIR_ENV names a directory, and serves it on the HTTP daemon.
+ */
+static void init_history(void)
+{
+    const char* directory = getenv(HISTORY_DIR_ENV);
+    if (directory == NULL || *directory == '\0')
+    {
+        return;
+    }
+
+    size_t size_mb = HISTORY_DEFAULT_SIZE_MB;
+    const char* size_env = getenv(HISTORY_SIZE_ENV);
+    if (size_env != NULL && *size_env != '\0')
+    {
+        char* end = NULL;
+        unsigned long value = strtoul(size_env, &end, 10);
+        if (*end != '\0' || value == 0)
+        {
+            fprintf(stderr, "Invalid %s '%s', using %d MiB\n", HISTORY_SIZE_ENV, size_env, HISTORY_DEFAULT_SIZE_MB);
+        }
+        else
+        {
+            size_mb = value;
+        }
+    }
+
+    history_ready = history_open(&history, directory, size_mb << 20) == 0;
+    if (history_ready)
     {
-        fprintf(stderr, "Error getting GPU fan speed\n");
+        history_add_endpoint(&history);
     }
 }
 
-void update_memory_metrics(void)
+void set_collector_pool(WorkerPool* pool)
 {
-    update_gauge(total_memory_metric, get_total_memory());
-    update_gauge(used_memory_metric, get_used_memory());
-    update_gauge(available_memory_metric, get_available_memory());
+    if (mount_table_ready)
+    {
+        mount_table_set_pool(&mount_table, pool);
+    }
 }
 
-void update_network_traffic_metric(void)
+/**
+ * @brief Drops the series of a mount that left the mount table, as when the file system was unmounted.
+ */
+static void release_mount_samples(MountEntry* entry)
 {
-    NetworkStats stats = get_network_traffic();
-    update_gauge(rx_bytes_metric, (double)stats.rx_bytes);
-    update_gauge(tx_bytes_metric, (double)stats.tx_bytes);
-    update_gauge(rx_errors_metric, (double)stats.rx_errors);
-    update_gauge(tx_errors_metric, (double)stats.tx_errors);
-    update_gauge(dropped_packets_metric, (double)stats.dropped_packets);
+    const char* label_values[] = {entry->mount_point, entry->source, entry->fstype};
+    for (int m = 0; m < MOUNT_SAMPLE_COUNT; m++)
+    {
+        if (entry->samples[m] != NULL)
+        {
+            prom_gauge_remove(*fs_metrics[m], label_values);
+            entry->samples[m] = NULL;
+        }
+    }
 }
 
-void update_context_switches_metric(void)
+/**
+ * @brief Publishes the usage of one mount.
+ *
+ * @param entry The mount, with a fresh reading.
+ */
+static void update_mount_metrics(MountEntry* entry)
 {
-    update_gauge(context_switches_metric, get_context_switches());
+    const struct statvfs* usage = &entry->usage;
+    double total = (double)usage->f_blocks * (double)usage->f_frsize;
+    double available = (double)usage->f_bavail * (double)usage->f_frsize;
+    const double values[MOUNT_SAMPLE_COUNT] = {
+        total,
+        (double)usage->f_bfree * (double)usage->f_frsize,
+        available,
+        total > 0 ? (total - available) / total * PERCENTAGE : 0.0,
+        (double)usage->f_files,
+        (double)usage->f_ffree,
+    };
+
+    for (int m = 0; m < MOUNT_SAMPLE_COUNT; m++)
+    {
+        prom_gauge_t* metric = *fs_metrics[m];
+        if (metric == NULL)
+        {
+            continue;
+        }
+        if (entry->samples[m] == NULL)
+        {
+            const char* label_values[] = {entry->mount_point, entry->source, entry->fstype};
+            entry->samples[m] = prom_gauge_with_labels(metric, label_values);
+            if (entry->samples[m] == NULL)
+            {
+                continue;
+            }
+        }
+        prom_metric_sample_set(entry->samples[m], values[m]);
+    }
 }
 
-void update_disk_stats_metrics(void)
+void update_filesystem_metrics(void)
 {
-    DiskStats stats = get_disk_stats();
-    if (stats.io_time >= 0)
+    if (!mount_table_ready || mount_table_refresh(&mount_table) != 0)
     {
-        update_gauge(io_time_metric, (double)stats.io_time);
-        update_gauge(writes_completed_metric, (double)stats.writes_completed);
-        update_gauge(reads_completed_metric, (double)stats.reads_completed);
+        fprintf(stderr, "Error obtaining the mounted file systems\n");
+        return;
     }
-    else
+
+    size_t waiting = mount_table_stat(&mount_table, FILESYSTEM_STAT_TIMEOUT_MS);
+    if (waiting > 0)
     {
-        fprintf(stderr, "Error obtaining disk stats\n");
+        fprintf(stderr, "%zu file systems did not answer statvfs in time\n", waiting);
+    }
+
+    // Mounts that did not answer keep their previous values
+    pthread_mutex_lock(&mount_table.mutex);
+    prom_gauge_batch_begin();
+    for (MountEntry* entry = mount_table.entries; entry != NULL; entry = entry->next)
+    {
+        if (entry->fresh && entry->has_usage)
+        {
+            update_mount_metrics(entry);
+        }
     }
+    prom_gauge_batch_end();
+    pthread_mutex_unlock(&mount_table.mutex);
 }
 
 void* expose_metrics(const void* arg)
 {
     (void)arg;
 
+    // The libmicrohttpd threads inherit the placement of this thread
+    placement_apply(PLACEMENT_HTTP);
     promhttp_set_active_collector_registry(NULL);
+    promhttp_set_collect_hook(collect_on_scrape, NULL);
 
-    struct MHD_Daemon* daemon = promhttp_start_daemon(MHD_USE_SELECT_INTERNALLY, 8000, NULL, NULL);
+    promhttp_config_t config = {
+        .mode = PROMHTTP_MODE_EPOLL,
+        .thread_pool_size = HTTP_THREAD_POOL_SIZE,
+        .connection_limit = HTTP_CONNECTION_LIMIT,
+        .per_ip_connection_limit = HTTP_PER_IP_CONNECTION_LIMIT,
+        .connection_timeout = HTTP_CONNECTION_TIMEOUT_S,
+        .stream_chunk_size = HTTP_STREAM_CHUNK_SIZE,
+    };
+    struct MHD_Daemon* daemon = promhttp_start_daemon_with_config(HTTP_PORT, &config, NULL, NULL);
+    if (daemon == NULL)
+    {
+        // libmicrohttpd may be built without epoll support
+        config.mode = PROMHTTP_MODE_SELECT;
+        daemon = promhttp_start_daemon_with_config(HTTP_PORT, &config, NULL, NULL);
+    }
     if (daemon == NULL)
     {
         fprintf(stderr, "Error starting HTTP server\n");
         return NULL;
     }
 
+    pthread_mutex_lock(&keep_running_lock);
     while (keep_running)
     {
-        sleep(1);
+        pthread_cond_wait(&keep_running_cond, &keep_running_lock);
     }
+    pthread_mutex_unlock(&keep_running_lock);
 
     MHD_stop_daemon(daemon);
     return NULL;
 }
 
+void stop_expose_metrics(void)
+{
+    pthread_mutex_lock(&keep_running_lock);
+    keep_running = false;
+    pthread_cond_broadcast(&keep_running_cond);
+    pthread_mutex_unlock(&keep_running_lock);
+}
+
+/**
+ * @brief Registers a metric selected at startup unless an earlier pattern already selected it.
+ */
+static void register_selected_metric(const MetricInfo* info, void* arg)
+{
+    (void)arg;
+    if (*(info->metric) == NULL && register_metric(info) != 0)
+    {
+        exit(EXIT_FAILURE);
+    }
+}
+
 void init_metrics(const char* selected_metrics[], size_t num_metrics)
 {
-    if (pthread_mutex_init(&lock, NULL) != 0)
+    // Metrics, samples and their keys live as long as the process, so they are packed into slabs
+    if (prom_allocator_set(prom_allocator_slab()) != 0)
     {
-        fprintf(stderr, "Error initializing mutex\n");
+        fprintf(stderr, "Error selecting the Prometheus slab allocator\n");
     }
 
     if (prom_collector_registry_default_init() != 0)
@@ -308,42 +1951,166 @@ void init_metrics(const char* selected_metrics[], size_t num_metrics)
         fprintf(stderr, "Error initializing Prometheus registry\n");
     }
 
-    // Iterate over the selected metrics array and create/register the metrics
-    for (size_t i = 0; i < num_metrics; i++)
+    // Lookups binary-search all_metrics, which only finds every metric if metric_catalog.h is sorted
+    for (size_t i = 1; i < METRIC_CATALOG_SIZE; i++)
+    {
+        if (strcmp(all_metrics[i - 1].name, all_metrics[i].name) >= 0)
+        {
+            fprintf(stderr, "Error: metric '%s' is out of order or listed twice in the catalog\n",
+                    all_metrics[i].name);
+        }
+    }
+
+    // Every reader below goes through the root, so it is selected before any of them runs
+    sysroot_init();
+
+    // The patterns are compiled once; the collector only matches devices it has not seen at their position before
+    if (name_filter_init(&net_dev_filter, getenv(NETWORK_INCLUDE_ENV), getenv(NETWORK_EXCLUDE_ENV)) != 0)
+    {
+        fprintf(stderr, "Error compiling the network device filter, reporting every device\n");
+    }
+
+    // The tables keep their root, so the replayed paths live in static buffers
+    const char* hwmon_path = sysroot_path(HWMON_ROOT_PATH, hwmon_root, sizeof(hwmon_root));
+    hwmon_table_init(&hwmon_table, hwmon_path != NULL ? hwmon_path : HWMON_ROOT_PATH, &release_hwmon_sensor);
+    const char* cpufreq_path = sysroot_path(CPUFREQ_ROOT_PATH, cpufreq_root, sizeof(cpufreq_root));
+    cpufreq_table_init(&cpufreq_table, cpufreq_path != NULL ? cpufreq_path : CPUFREQ_ROOT_PATH);
+
+    const char* fs_exclude = getenv(FILESYSTEM_EXCLUDE_ENV);
+    if (mount_table_init(&mount_table, getenv(FILESYSTEM_INCLUDE_ENV),
+                         fs_exclude != NULL ? fs_exclude : FILESYSTEM_EXCLUDE_DEFAULT, &release_mount_samples) == 0)
     {
-        const char* metric_name = selected_metrics[i];
+        mount_table_ready = true;
+    }
 
-        // Find the metric in the all_metrics array
-        for (MetricInfo* info = all_metrics; info->name != NULL; info++)
+    const char* series_env = getenv(SERIES_MAX_ENV);
+    if (series_env != NULL && *series_env != '\0')
+    {
+        char* end = NULL;
+        unsigned long long max = strtoull(series_env, &end, 10);
+        if (*end != '\0' || max == 0 || max > SIZE_MAX)
         {
-            if (strcmp(metric_name, info->name) == 0)
-            {
-                *(info->metric) = prom_gauge_new(info->name, info->description, 0, NULL);
-                prom_collector_registry_must_register_metric((prom_metric_t*)*(info->metric));
-                break;
-            }
+            fprintf(stderr, "Invalid %s '%s', series stay unbounded\n", SERIES_MAX_ENV, series_env);
+        }
+        else
+        {
+            series_max = (size_t)max;
+        }
+    }
+
+    const char* irq_top_env = getenv(IRQ_TOP_ENV);
+    if (irq_top_env != NULL && *irq_top_env != '\0')
+    {
+        char* end = NULL;
+        unsigned long long top = strtoull(irq_top_env, &end, 10);
+        if (*end != '\0' || top > SIZE_MAX)
+        {
+            fprintf(stderr, "Invalid %s '%s', keeping the %d busiest interrupt lines\n", IRQ_TOP_ENV, irq_top_env,
+                    IRQ_TOP_DEFAULT);
         }
+        else
+        {
+            irq_top = (size_t)top;
+        }
+    }
+
+    collector_timeout_metric = prom_counter_new("collector_timeout_total", "Collector runs that missed their deadline",
+                                                1, collector_timeout_label_keys);
+    prom_collector_registry_must_register_metric((prom_metric_t*)collector_timeout_metric);
+    instrumentation_init();
+
+    const char* shm_name = getenv(SHM_EXPORT_NAME_ENV);
+    if (shm_name != NULL && *shm_name != '\0')
+    {
+        shm_export_ready = shm_export_open(&shm_export, shm_name) == 0;
+    }
+    init_history();
+
+    const char* remote_write_url = getenv(REMOTE_WRITE_URL_ENV);
+    if (remote_write_url != NULL && *remote_write_url != '\0')
+    {
+        remote_write_ready = remote_write_open(&remote_write, remote_write_url) == 0;
+    }
+
+    const char* gateway_targets = getenv(GATEWAY_TARGETS_ENV);
+    if (gateway_targets != NULL && *gateway_targets != '\0')
+    {
+        gateway_ready = gateway_open(&gateway, gateway_targets, getenv(GATEWAY_AGGREGATE_ENV)) == 0;
+    }
+
+    // The companions are started by their first supervision, once the HTTP server is up
+    const char* companion_list = getenv(COMPANIONS_ENV);
+    if (companion_list != NULL && *companion_list != '\0')
+    {
+        companions_ready = companions_open(&companions, companion_list) == 0;
+    }
+
+    // Iterate over the selected patterns and create/register the metrics they select
+    for (size_t i = 0; i < num_metrics; i++)
+    {
+        match_metrics(selected_metrics[i], register_selected_metric, NULL);
     }
 }
 
-void show_available_metrics(void)
+int register_metric(const MetricInfo* info)
 {
-    FILE* file = fopen(METRICS_FILE, "w");
-    if (file == NULL)
+    // Monotonic kernel counters keep their exact integer value; dense gauges keep their values in contiguous arrays,
+    // so a scrape reads them in one pass
+    if (*(info->metric) == NULL && info->kind == METRIC_COUNTER)
     {
-        perror("fopen");
-        return;
+        *(info->metric) = prom_counter_new_integer(info->name, info->description, info->label_count, info->label_keys);
     }
-
-    for (MetricInfo* info = all_metrics; info->name != NULL; info++)
+    else if (*(info->metric) == NULL && info->kind == METRIC_FLOAT_COUNTER)
+    {
+        *(info->metric) = prom_counter_new_dense(info->name, info->description, info->label_count, info->label_keys);
+    }
+    else if (*(info->metric) == NULL)
     {
-        fprintf(file, "Metric: %s\n", info->name);
+        *(info->metric) = prom_gauge_new_dense(info->name, info->description, info->label_count, info->label_keys);
     }
 
-    fclose(file);
+    if (*(info->metric) == NULL || prom_collector_registry_register_metric((prom_metric_t*)*(info->metric)) != 0)
+    {
+        fprintf(stderr, "Error registering metric '%s'\n", info->name);
+        return RETURN_ERROR;
+    }
+    // Without the prebuilt lines, a render builds them as it did before
+    if (prom_metric_set_text_header((prom_metric_t*)*(info->metric), info->header, info->header_len) != 0)
+    {
+        fprintf(stderr, "Error setting the header of metric '%s'\n", info->name);
+    }
+    // Once full, a metric refuses new label values and keeps updating the series it has
+    if (series_max > 0 && info->label_count > 0 &&
+        prom_metric_set_lifecycle((prom_metric_t*)*(info->metric), 0, series_max) != 0)
+    {
+        fprintf(stderr, "Error bounding the series of metric '%s'\n", info->name);
+    }
+    // A missing rollup leaves the metric itself exported
+    if (info->rollup != NULL)
+    {
+        rollup_register(info->rollup, info->name, info->description, info->label_count, info->label_keys);
+    }
+    if (info->rate != NULL)
+    {
+        rate_register(info->rate, info->name, info->description, info->label_count, info->label_keys);
+    }
+    return 0;
 }
 
-void destroy_mutex(void)
+int unregister_metric(const MetricInfo* info)
 {
-    pthread_mutex_destroy(&lock);
-}
\ No newline at end of file
+    if (*(info->metric) == NULL || prom_collector_registry_unregister_metric((prom_metric_t*)*(info->metric)) != 0)
+    {
+        fprintf(stderr, "Error unregistering metric '%s'\n", info->name);
+        return RETURN_ERROR;
+    }
+    if (info->rollup != NULL)
+    {
+        rollup_unregister(info->rollup);
+    }
+    if (info->rate != NULL)
+    {
+        rate_unregister(info->rate);
+    }
+    return 0;
+}
@@ -0,0 +1,1244 @@
+/**
+ * @file gateway.c
+ * @brief Functions for merging the series of many downstream monitors into the registry this monitor serves.
+ * @author 1v6n
+ * @date 15/10/2026
+ */
+
+#define _GNU_SOURCE // Required for strcasestr and getaddrinfo_a
+
+#include "gateway.h"
+#include "metrics.h"
+#include <errno.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+
+#define GATEWAY_EPOLL_EVENTS 64   /**< Events handled per epoll_wait call. */
+#define GATEWAY_READ_SIZE 65536   /**< Free space the response buffer is grown to before every read. */
+#define GATEWAY_INSTANCE "instance" /**< Label key naming the target of a merged series. */
+#define PROTO_WIRE_VARINT 0       /**< Wire type of varints. */
+#define PROTO_WIRE_FIXED64 1      /**< Wire type of doubles. */
+#define PROTO_WIRE_LEN 2          /**< Wire type of strings and messages. */
+#define PROTO_WIRE_FIXED32 5      /**< Wire type of floats. */
+
+/** Media type of the delimited protobuf exposition. */
+#define GATEWAY_ACCEPT "application/vnd.google.protobuf; proto=io.prometheus.client.MetricFamily; encoding=delimited"
+
+static const char* up_label_keys[] = {GATEWAY_INSTANCE}; /**< Label keys of the per-target gauges. */
+
+static const struct addrinfo resolve_hints = {
+    .ai_family = AF_UNSPEC,
+    .ai_socktype = SOCK_STREAM,
+}; /**< Hints of every resolution, kept alive for the background ones. */
+
+static const char* const aggregate_names[GATEWAY_AGGREGATE_COUNT] = {
+    "sum",
+    "max",
+}; /**< Names of the aggregates, indexed by GatewayAggregateKind. */
+
+/**
+ * @brief MetricType of the exposition.
+ */
+typedef enum
+{
+    PROTO_COUNTER = 0,
+    PROTO_GAUGE = 1,
+    PROTO_UNTYPED = 3,
+} ProtoType;
+
+/**
+ * @brief Structure to hold a field of a protobuf message.
+ */
+typedef struct
+{
+    uint32_t number;     /**< Field number. */
+    int wire;            /**< Wire type. */
+    uint64_t varint;     /**< Value of a varint field. */
+    const uint8_t* data; /**< Payload of a fixed or length-delimited field. */
+    size_t len;          /**< Length of data. */
+} ProtoField;
+
+/**
+ * @brief Structure to hold a label of a downstream series, pointing into the response.
+ */
+typedef struct
+{
+    const uint8_t* name;  /**< Label name. */
+    size_t name_len;      /**< Length of name. */
+    const uint8_t* value; /**< Label value. */
+    size_t value_len;     /**< Length of value. */
+} ProtoLabel;
+
+static bool read_varint(const uint8_t** p, const uint8_t* end, uint64_t* value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7)
+    {
+        uint8_t byte = *(*p)++;
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Reads the next field of a message.
+ *
+ * @return true on success, or false if the message is truncated or holds a group.
+ */
+static bool read_field(const uint8_t** p, const uint8_t* end, ProtoField* field)
+{
+    uint64_t tag;
+    if (!read_varint(p, end, &tag))
+    {
+        return false;
+    }
+    field->number = (uint32_t)(tag >> 3);
+    field->wire = (int)(tag & 7);
+    field->len = 0;
+
+    switch (field->wire)
+    {
+    case PROTO_WIRE_VARINT:
+        return read_varint(p, end, &field->varint);
+    case PROTO_WIRE_FIXED64:
+        field->len = 8;
+        break;
+    case PROTO_WIRE_LEN:
+        if (!read_varint(p, end, &field->varint) || field->varint > (uint64_t)(end - *p))
+        {
+            return false;
+        }
+        field->len = (size_t)field->varint;
+        break;
+    case PROTO_WIRE_FIXED32:
+        field->len = 4;
+        break;
+    default:
+        return false;
+    }
+
+    if (field->len > (size_t)(end - *p))
+    {
+        return false;
+    }
+    field->data = *p;
+    *p += field->len;
+    return true;
+}
+
+/**
+ * @brief Returns the double of the first field 1 of a Counter, Gauge or Untyped message, or 0 if it has none.
+ */
+static double read_value(const uint8_t* p, const uint8_t* end)
+{
+    ProtoField field;
+    while (read_field(&p, end, &field))
+    {
+        if (field.number == 1 && field.wire == PROTO_WIRE_FIXED64)
+        {
+            // Doubles are little-endian on the wire
+            uint64_t bits = 0;
+            for (int i = 7; i >= 0; i--)
+            {
+                bits = bits << 8 | field.data[i];
+            }
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+    }
+    return 0.0;
+}
+
+static char* copy_string(const uint8_t* data, size_t len)
+{
+    char* copy = malloc(len + 1);
+    if (copy == NULL)
+    {
+        perror("malloc");
+        return NULL;
+    }
+    memcpy(copy, data, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+static bool string_equals(const char* string, const uint8_t* data, size_t len)
+{
+    return strncmp(string, (const char*)data, len) == 0 && string[len] == '\0';
+}
+
+/**
+ * @brief Creates and registers a counter or gauge, destroying it if the registry refuses it.
+ *
+ * @return The metric, or NULL if it could not be created or registered.
+ */
+static prom_metric_t* register_family_metric(bool counter, const char* name, const char* help, size_t label_count,
+                                             const char** label_keys)
+{
+    prom_counter_t* metric_counter = counter ? prom_counter_new(name, help, label_count, label_keys) : NULL;
+    prom_gauge_t* metric_gauge = counter ? NULL : prom_gauge_new(name, help, label_count, label_keys);
+    prom_metric_t* metric = counter ? (prom_metric_t*)metric_counter : (prom_metric_t*)metric_gauge;
+    if (metric == NULL || prom_collector_registry_register_metric(metric) != 0)
+    {
+        fprintf(stderr, "Gateway cannot register '%s': its name is invalid or taken\n", name);
+        if (metric_counter != NULL)
+        {
+            prom_counter_destroy(metric_counter);
+        }
+        if (metric_gauge != NULL)
+        {
+            prom_gauge_destroy(metric_gauge);
+        }
+        return NULL;
+    }
+    return metric;
+}
+
+/**
+ * @brief Unregisters and destroys a metric made by register_family_metric. NULL is ignored.
+ */
+static void release_family_metric(bool counter, prom_metric_t* metric)
+{
+    if (metric == NULL)
+    {
+        return;
+    }
+    prom_collector_registry_unregister_metric(metric);
+    if (counter)
+    {
+        prom_counter_destroy((prom_counter_t*)metric);
+    }
+    else
+    {
+        prom_gauge_destroy((prom_gauge_t*)metric);
+    }
+}
+
+/**
+ * @brief Destroys the metrics of a family, then frees the names, help text and label keys they pointed at.
+ */
+static void free_family(GatewayFamily* family)
+{
+    release_family_metric(family->counter, family->metric);
+    for (int a = 0; a < GATEWAY_AGGREGATE_COUNT; a++)
+    {
+        release_family_metric(family->counter, family->aggregates[a]);
+        free(family->aggregate_names[a]);
+    }
+    for (size_t e = 0; e < family->entry_count; e++)
+    {
+        for (size_t i = 0; i < family->label_count; i++)
+        {
+            free(family->entries[e].values[i]);
+        }
+        free(family->entries[e].values);
+    }
+    free(family->entries);
+
+    // The keys are NULL-terminated, and a family whose registration failed halfway has fewer of them
+    for (size_t i = 0; family->label_keys != NULL && family->label_keys[i] != NULL; i++)
+    {
+        free(family->label_keys[i]);
+    }
+    free(family->label_keys);
+    free(family->help);
+    free(family->name);
+}
+
+/**
+ * @brief Creates and registers the merged and aggregate metrics of a family from the labels of its first series.
+ *
+ * On failure the family is left unusable, so that its series are skipped from then on.
+ */
+static void register_family(Gateway* gateway, GatewayFamily* family, const ProtoLabel* labels, size_t label_count)
+{
+    const char* keys[GATEWAY_MAX_LABELS];
+    family->label_keys = calloc(label_count + 1, sizeof(*family->label_keys));
+    if (family->label_keys == NULL)
+    {
+        perror("calloc");
+        return;
+    }
+    if (label_count + 1 > GATEWAY_MAX_LABELS)
+    {
+        fprintf(stderr, "Gateway cannot merge family '%s': too many labels\n", family->name);
+        return;
+    }
+    for (size_t i = 0; i < label_count; i++)
+    {
+        family->label_keys[i] = copy_string(labels[i].name, labels[i].name_len);
+        if (family->label_keys[i] == NULL)
+        {
+            return;
+        }
+        if (strcmp(family->label_keys[i], GATEWAY_INSTANCE) == 0)
+        {
+            fprintf(stderr, "Gateway cannot merge family '%s': it already has an instance label\n", family->name);
+            return;
+        }
+        keys[i] = family->label_keys[i];
+    }
+    family->label_count = label_count;
+    keys[label_count] = GATEWAY_INSTANCE;
+
+    family->metric = register_family_metric(family->counter, family->name, family->help, label_count + 1, keys);
+    if (family->metric == NULL)
+    {
+        return;
+    }
+    // Series of targets that went away, or that stopped listing them, are evicted once idle
+    prom_metric_set_lifecycle(family->metric, GATEWAY_SERIES_TTL_S, 0);
+
+    for (int a = 0; a < GATEWAY_AGGREGATE_COUNT; a++)
+    {
+        if (!gateway->aggregate[a])
+        {
+            continue;
+        }
+        size_t len = strlen(GATEWAY_AGGREGATE_PREFIX) + strlen(family->name) + strlen(aggregate_names[a]) + 2;
+        family->aggregate_names[a] = malloc(len);
+        if (family->aggregate_names[a] == NULL)
+        {
+            perror("malloc");
+            continue;
+        }
+        snprintf(family->aggregate_names[a], len, "%s%s:%s", GATEWAY_AGGREGATE_PREFIX, family->name,
+                 aggregate_names[a]);
+        family->aggregates[a] =
+            register_family_metric(family->counter, family->aggregate_names[a], family->help, label_count, keys);
+    }
+    family->usable = true;
+}
+
+/**
+ * @brief Returns the family with the given name, adding it if the gateway has none.
+ *
+ * Targets list their families in the same order, so the family after the previous match is tried first.
+ *
+ * @param hint Pointer to the index to try first, advanced past the family returned.
+ * @return The family, or NULL if the gateway cannot grow.
+ */
+static GatewayFamily* find_family(Gateway* gateway, const ProtoField* name, size_t* hint)
+{
+    size_t index = *hint;
+    if (index >= gateway->family_count || !string_equals(gateway->families[index].name, name->data, name->len))
+    {
+        for (index = 0; index < gateway->family_count; index++)
+        {
+            if (string_equals(gateway->families[index].name, name->data, name->len))
+            {
+                break;
+            }
+        }
+    }
+
+    if (index == gateway->family_count)
+    {
+        if (gateway->family_count == gateway->family_capacity)
+        {
+            size_t capacity = gateway->family_capacity ? gateway->family_capacity * 2 : 64;
+            GatewayFamily* families = realloc(gateway->families, capacity * sizeof(*families));
+            if (families == NULL)
+            {
+                perror("realloc");
+                return NULL;
+            }
+            gateway->families = families;
+            gateway->family_capacity = capacity;
+        }
+
+        GatewayFamily* family = &gateway->families[gateway->family_count];
+        memset(family, 0, sizeof(*family));
+        family->name = copy_string(name->data, name->len);
+        if (family->name == NULL)
+        {
+            return NULL;
+        }
+        gateway->family_count++;
+    }
+    *hint = index + 1;
+    return &gateway->families[index];
+}
+
+/**
+ * @brief Returns the aggregate entry with the given label values, adding it if the family has none.
+ *
+ * @param hint Pointer to the index to try first, advanced past the entry returned.
+ * @return The entry, or NULL if the family cannot grow.
+ */
+static GatewayAggregate* find_aggregate(GatewayFamily* family, const char** values, size_t* hint)
+{
+    size_t index = *hint;
+    for (size_t tried = 0; tried < family->entry_count; tried++, index++)
+    {
+        if (index >= family->entry_count)
+        {
+            index = 0;
+        }
+        GatewayAggregate* entry = &family->entries[index];
+        size_t i = 0;
+        while (i < family->label_count && strcmp(entry->values[i], values[i]) == 0)
+        {
+            i++;
+        }
+        if (i == family->label_count)
+        {
+            *hint = index + 1;
+            return entry;
+        }
+    }
+
+    if (family->entry_count == family->entry_capacity)
+    {
+        size_t capacity = family->entry_capacity ? family->entry_capacity * 2 : 16;
+        GatewayAggregate* entries = realloc(family->entries, capacity * sizeof(*entries));
+        if (entries == NULL)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        family->entries = entries;
+        family->entry_capacity = capacity;
+    }
+
+    GatewayAggregate* entry = &family->entries[family->entry_count];
+    entry->values = calloc(family->label_count + 1, sizeof(*entry->values));
+    if (entry->values == NULL)
+    {
+        perror("calloc");
+        return NULL;
+    }
+    for (size_t i = 0; i < family->label_count; i++)
+    {
+        entry->values[i] = strdup(values[i]);
+        if (entry->values[i] == NULL)
+        {
+            perror("strdup");
+            for (size_t j = 0; j < i; j++)
+            {
+                free(entry->values[j]);
+            }
+            free(entry->values);
+            return NULL;
+        }
+    }
+    entry->pass = 0;
+    *hint = family->entry_count + 1;
+    return &family->entries[family->entry_count++];
+}
+
+/**
+ * @brief Copies the label values of a series into the scratch buffer, NUL-terminated, and points values at them.
+ *
+ * @return 0 on success, or -1 if the buffer cannot grow.
+ */
+static int copy_label_values(Gateway* gateway, const ProtoLabel* labels, size_t label_count, const char** values)
+{
+    size_t needed = 0;
+    for (size_t i = 0; i < label_count; i++)
+    {
+        needed += labels[i].value_len + 1;
+    }
+    if (needed > gateway->scratch_capacity)
+    {
+        size_t capacity = gateway->scratch_capacity ? gateway->scratch_capacity : 1024;
+        while (capacity < needed)
+        {
+            capacity *= 2;
+        }
+        char* scratch = realloc(gateway->scratch, capacity);
+        if (scratch == NULL)
+        {
+            perror("realloc");
+            return RETURN_ERROR;
+        }
+        gateway->scratch = scratch;
+        gateway->scratch_capacity = capacity;
+    }
+
+    char* p = gateway->scratch;
+    for (size_t i = 0; i < label_count; i++)
+    {
+        memcpy(p, labels[i].value, labels[i].value_len);
+        p[labels[i].value_len] = '\0';
+        values[i] = p;
+        p += labels[i].value_len + 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Merges one Metric message of a family listed by a target.
+ *
+ * @param aggregate_hint Pointer to the aggregate entry to try first for the family.
+ */
+static void merge_series(Gateway* gateway, GatewayFamily* family, ProtoType type, const GatewayTarget* target,
+                         const uint8_t* p, const uint8_t* end, size_t* aggregate_hint)
+{
+    ProtoLabel labels[GATEWAY_MAX_LABELS];
+    size_t label_count = 0;
+    double value = 0.0;
+    bool has_value = false;
+
+    ProtoField field;
+    while (read_field(&p, end, &field))
+    {
+        if (field.number == 1 && field.wire == PROTO_WIRE_LEN)
+        {
+            if (label_count == GATEWAY_MAX_LABELS)
+            {
+                return;
+            }
+            ProtoLabel* label = &labels[label_count++];
+            memset(label, 0, sizeof(*label));
+            const uint8_t* q = field.data;
+            ProtoField pair;
+            while (read_field(&q, field.data + field.len, &pair))
+            {
+                if (pair.number == 1 && pair.wire == PROTO_WIRE_LEN)
+                {
+                    label->name = pair.data;
+                    label->name_len = pair.len;
+                }
+                else if (pair.number == 2 && pair.wire == PROTO_WIRE_LEN)
+                {
+                    label->value = pair.data;
+                    label->value_len = pair.len;
+                }
+            }
+        }
+        // Metric.gauge is field 2, Metric.counter field 3 and Metric.untyped field 5
+        else if (field.wire == PROTO_WIRE_LEN && ((type == PROTO_GAUGE && field.number == 2) ||
+                                                  (type == PROTO_COUNTER && field.number == 3) ||
+                                                  (type == PROTO_UNTYPED && field.number == 5)))
+        {
+            value = read_value(field.data, field.data + field.len);
+            has_value = true;
+        }
+    }
+    if (!has_value)
+    {
+        return;
+    }
+
+    if (family->label_keys == NULL)
+    {
+        register_family(gateway, family, labels, label_count);
+    }
+    if (!family->usable || label_count != family->label_count)
+    {
+        return;
+    }
+    for (size_t i = 0; i < label_count; i++)
+    {
+        if (labels[i].name == NULL || !string_equals(family->label_keys[i], labels[i].name, labels[i].name_len))
+        {
+            return;
+        }
+    }
+
+    const char* values[GATEWAY_MAX_LABELS];
+    if (copy_label_values(gateway, labels, label_count, values) != 0)
+    {
+        return;
+    }
+    values[label_count] = target->instance;
+    if (family->counter)
+    {
+        prom_counter_set((prom_counter_t*)family->metric, value, values);
+    }
+    else
+    {
+        prom_gauge_set((prom_gauge_t*)family->metric, value, values);
+    }
+
+    if (family->aggregates[GATEWAY_SUM] == NULL && family->aggregates[GATEWAY_MAX] == NULL)
+    {
+        return;
+    }
+    GatewayAggregate* entry = find_aggregate(family, values, aggregate_hint);
+    if (entry == NULL)
+    {
+        return;
+    }
+    if (entry->pass != gateway->pass)
+    {
+        entry->pass = gateway->pass;
+        entry->sum = value;
+        entry->max = value;
+    }
+    else
+    {
+        entry->sum += value;
+        entry->max = value > entry->max ? value : entry->max;
+    }
+}
+
+/**
+ * @brief Merges one MetricFamily message listed by a target.
+ *
+ * @param hint Pointer to the family to try first.
+ */
+static void merge_family(Gateway* gateway, const GatewayTarget* target, const uint8_t* data, const uint8_t* end,
+                         size_t* hint)
+{
+    // The name, help and type come first in practice, but protobuf does not promise it
+    ProtoField name = {0};
+    ProtoField help = {0};
+    uint64_t type = PROTO_GAUGE;
+    ProtoField field;
+    for (const uint8_t* p = data; read_field(&p, end, &field);)
+    {
+        if (field.number == 1 && field.wire == PROTO_WIRE_LEN)
+        {
+            name = field;
+        }
+        else if (field.number == 2 && field.wire == PROTO_WIRE_LEN)
+        {
+            help = field;
+        }
+        else if (field.number == 3 && field.wire == PROTO_WIRE_VARINT)
+        {
+            type = field.varint;
+        }
+    }
+    if (name.len == 0 || (type != PROTO_COUNTER && type != PROTO_GAUGE && type != PROTO_UNTYPED))
+    {
+        return;
+    }
+
+    GatewayFamily* family = find_family(gateway, &name, hint);
+    if (family == NULL)
+    {
+        return;
+    }
+    if (family->help == NULL)
+    {
+        family->help = copy_string(help.len > 0 ? help.data : (const uint8_t*)family->name,
+                                   help.len > 0 ? help.len : strlen(family->name));
+        family->counter = type == PROTO_COUNTER;
+    }
+    if (family->help == NULL || family->counter != (type == PROTO_COUNTER))
+    {
+        return;
+    }
+
+    size_t aggregate_hint = 0;
+    for (const uint8_t* p = data; read_field(&p, end, &field);)
+    {
+        if (field.number == 4 && field.wire == PROTO_WIRE_LEN)
+        {
+            merge_series(gateway, family, (ProtoType)type, target, field.data, field.data + field.len,
+                         &aggregate_hint);
+        }
+    }
+}
+
+/**
+ * @brief Checks the response of a target and merges every family it lists.
+ *
+ * @param report Whether to log why the response is rejected, so that a target that stays down is logged once.
+ * @return 0 on success, or -1 if the response is not a successful protobuf exposition.
+ */
+static int merge_target(Gateway* gateway, GatewayTarget* target, bool report)
+{
+    target->response[target->len] = '\0';
+    int status = 0;
+    const char* body = strstr(target->response, "\r\n\r\n");
+    const char* type = strcasestr(target->response, "\r\nContent-Type:");
+    const char* protobuf = type != NULL ? strstr(type, "protobuf") : NULL;
+    const char* problem = NULL;
+    if (sscanf(target->response, "HTTP/%*d.%*d %d", &status) != 1 || status != 200 || body == NULL)
+    {
+        problem = "did not answer with status 200";
+    }
+    // A target that ignored the Accept header answered in text
+    else if (protobuf == NULL || type > body || protobuf > body)
+    {
+        problem = "did not answer in the protobuf format";
+    }
+
+    const uint8_t* p = problem == NULL ? (const uint8_t*)body + 4 : NULL;
+    const uint8_t* end = (const uint8_t*)target->response + target->len;
+    size_t hint = 0;
+    while (problem == NULL && p < end)
+    {
+        uint64_t len;
+        if (!read_varint(&p, end, &len) || len > (uint64_t)(end - p))
+        {
+            problem = "sent a truncated response";
+            break;
+        }
+        merge_family(gateway, target, p, p + len, &hint);
+        p += len;
+    }
+
+    if (problem != NULL)
+    {
+        if (report)
+        {
+            fprintf(stderr, "Gateway target %s %s\n", target->instance, problem);
+        }
+        return RETURN_ERROR;
+    }
+    return 0;
+}
+
+/**
+ * @brief Publishes the aggregates of every family and drops the entries no target contributed to in this pass.
+ */
+static void publish_aggregates(Gateway* gateway)
+{
+    for (size_t f = 0; f < gateway->family_count; f++)
+    {
+        GatewayFamily* family = &gateway->families[f];
+        size_t kept = 0;
+        for (size_t e = 0; e < family->entry_count; e++)
+        {
+            GatewayAggregate* entry = &family->entries[e];
+            const char** values = (const char**)entry->values;
+            for (int a = 0; a < GATEWAY_AGGREGATE_COUNT; a++)
+            {
+                prom_metric_t* metric = family->aggregates[a];
+                double value = a == GATEWAY_SUM ? entry->sum : entry->max;
+                if (metric == NULL)
+                {
+                    continue;
+                }
+                if (entry->pass != gateway->pass)
+                {
+                    prom_metric_remove_labels(metric, values);
+                }
+                else if (family->counter)
+                {
+                    prom_counter_set((prom_counter_t*)metric, value, values);
+                }
+                else
+                {
+                    prom_gauge_set((prom_gauge_t*)metric, value, values);
+                }
+            }
+
+            if (entry->pass != gateway->pass)
+            {
+                for (size_t i = 0; i < family->label_count; i++)
+                {
+                    free(entry->values[i]);
+                }
+                free(entry->values);
+                continue;
+            }
+            family->entries[kept++] = *entry;
+        }
+        family->entry_count = kept;
+    }
+}
+
+static double seconds_since(const struct timespec* start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void start_resolve(GatewayTarget* target);
+
+/**
+ * @brief Ends the scrape of a target, closing its connection.
+ *
+ * A target whose connection failed is resolved again in the background, in case its address changed.
+ */
+static void finish_target(Gateway* gateway, GatewayTarget* target, GatewayState state, const struct timespec* start)
+{
+    if (target->fd >= 0)
+    {
+        epoll_ctl(gateway->epoll_fd, EPOLL_CTL_DEL, target->fd, NULL);
+        close(target->fd);
+        target->fd = -1;
+    }
+    if (state == GATEWAY_FAILED)
+    {
+        start_resolve(target);
+    }
+    target->state = state;
+    target->duration = seconds_since(start);
+}
+
+/**
+ * @brief Resolves the host of a target, blocking; only done while the gateway opens.
+ */
+static int resolve_target(GatewayTarget* target)
+{
+    struct addrinfo* addresses = NULL;
+    if (getaddrinfo(target->host, target->port, &resolve_hints, &addresses) != 0 || addresses == NULL)
+    {
+        return RETURN_ERROR;
+    }
+    memcpy(&target->address, addresses->ai_addr, addresses->ai_addrlen);
+    target->address_len = addresses->ai_addrlen;
+    freeaddrinfo(addresses);
+    return 0;
+}
+
+/**
+ * @brief Starts resolving the host of a target in the background, unless it already is.
+ *
+ * The scrapes keep using the previous address, if any, until the resolution completes.
+ */
+static void start_resolve(GatewayTarget* target)
+{
+    if (target->resolve != NULL)
+    {
+        return;
+    }
+    target->resolve = calloc(1, sizeof(*target->resolve));
+    if (target->resolve == NULL)
+    {
+        perror("calloc");
+        return;
+    }
+    target->resolve->ar_name = target->host;
+    target->resolve->ar_service = target->port;
+    target->resolve->ar_request = &resolve_hints;
+    struct gaicb* requests[] = {target->resolve};
+    if (getaddrinfo_a(GAI_NOWAIT, requests, 1, NULL) != 0)
+    {
+        free(target->resolve);
+        target->resolve = NULL;
+    }
+}
+
+/**
+ * @brief Takes the address of a background resolution once it completed.
+ *
+ * @param wait Whether to cancel or wait for a resolution still running rather than leave it.
+ */
+static void finish_resolve(GatewayTarget* target, bool wait)
+{
+    if (target->resolve == NULL)
+    {
+        return;
+    }
+    if (wait && gai_cancel(target->resolve) == EAI_NOTCANCELED)
+    {
+        const struct gaicb* requests[] = {target->resolve};
+        while (gai_error(target->resolve) == EAI_INPROGRESS)
+        {
+            gai_suspend(requests, 1, NULL);
+        }
+    }
+
+    int error = gai_error(target->resolve);
+    if (error == EAI_INPROGRESS)
+    {
+        return;
+    }
+    struct addrinfo* addresses = target->resolve->ar_result;
+    if (error == 0 && addresses != NULL)
+    {
+        memcpy(&target->address, addresses->ai_addr, addresses->ai_addrlen);
+        target->address_len = addresses->ai_addrlen;
+    }
+    if (addresses != NULL)
+    {
+        freeaddrinfo(addresses);
+    }
+    free(target->resolve);
+    target->resolve = NULL;
+}
+
+/**
+ * @brief Starts connecting to a target.
+ *
+ * @return 0 on success, or -1 if the target is not resolved yet or cannot be connected to.
+ */
+static int start_target(Gateway* gateway, GatewayTarget* target)
+{
+    target->len = 0;
+    target->sent = 0;
+    finish_resolve(target, false);
+    if (target->address_len == 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    target->fd = socket(target->address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (target->fd < 0)
+    {
+        return RETURN_ERROR;
+    }
+    struct epoll_event event = {.events = EPOLLOUT, .data.ptr = target};
+    if ((connect(target->fd, (struct sockaddr*)&target->address, target->address_len) != 0 &&
+         errno != EINPROGRESS) ||
+        epoll_ctl(gateway->epoll_fd, EPOLL_CTL_ADD, target->fd, &event) != 0)
+    {
+        return RETURN_ERROR;
+    }
+    target->state = GATEWAY_CONNECTING;
+    return 0;
+}
+
+/**
+ * @brief Makes sure the response buffer of a target has GATEWAY_READ_SIZE free bytes, plus one for the NUL.
+ *
+ * @return 0 on success, or -1 if the response would grow past GATEWAY_MAX_RESPONSE or cannot be allocated.
+ */
+static int reserve_response(GatewayTarget* target)
+{
+    if (target->capacity - target->len > GATEWAY_READ_SIZE)
+    {
+        return 0;
+    }
+    size_t capacity = target->capacity ? target->capacity * 2 : 4 * GATEWAY_READ_SIZE;
+    if (capacity > GATEWAY_MAX_RESPONSE)
+    {
+        fprintf(stderr, "Gateway target %s sent more than %d bytes\n", target->instance, GATEWAY_MAX_RESPONSE);
+        return RETURN_ERROR;
+    }
+    char* response = realloc(target->response, capacity);
+    if (response == NULL)
+    {
+        perror("realloc");
+        return RETURN_ERROR;
+    }
+    target->response = response;
+    target->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Advances the scrape of a target as far as its socket allows without blocking.
+ */
+static void advance_target(Gateway* gateway, GatewayTarget* target, const struct timespec* start)
+{
+    if (target->state == GATEWAY_CONNECTING)
+    {
+        int error = 0;
+        socklen_t error_len = sizeof(error);
+        if (getsockopt(target->fd, SOL_SOCKET, SO_ERROR, &error, &error_len) != 0 || error != 0)
+        {
+            finish_target(gateway, target, GATEWAY_FAILED, start);
+            return;
+        }
+        while (target->sent < target->request_len)
+        {
+            ssize_t n = send(target->fd, target->request + target->sent, target->request_len - target->sent,
+                             MSG_NOSIGNAL);
+            if (n < 0 && (errno == EAGAIN || errno == EINTR))
+            {
+                return;
+            }
+            if (n <= 0)
+            {
+                finish_target(gateway, target, GATEWAY_FAILED, start);
+                return;
+            }
+            target->sent += (size_t)n;
+        }
+
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = target};
+        if (epoll_ctl(gateway->epoll_fd, EPOLL_CTL_MOD, target->fd, &event) != 0)
+        {
+            finish_target(gateway, target, GATEWAY_FAILED, start);
+            return;
+        }
+        target->state = GATEWAY_RECEIVING;
+        return;
+    }
+
+    // The request asks for HTTP/1.0, so the response ends when the target closes the connection
+    for (;;)
+    {
+        if (reserve_response(target) != 0)
+        {
+            finish_target(gateway, target, GATEWAY_FAILED, start);
+            return;
+        }
+        ssize_t n = recv(target->fd, target->response + target->len, target->capacity - target->len - 1, 0);
+        if (n > 0)
+        {
+            target->len += (size_t)n;
+            continue;
+        }
+        if (n == 0)
+        {
+            finish_target(gateway, target, GATEWAY_DONE, start);
+            return;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno != EAGAIN)
+        {
+            finish_target(gateway, target, GATEWAY_FAILED, start);
+        }
+        return;
+    }
+}
+
+/**
+ * @brief Parses one entry of the target list into a target.
+ */
+static int parse_target(GatewayTarget* target, const char* entry, size_t len)
+{
+    const char* end = entry + len;
+    const char* host = entry;
+    const char* host_end;
+    const char* port = NULL;
+    if (*host == '[')
+    {
+        // An IPv6 literal
+        host++;
+        host_end = memchr(host, ']', (size_t)(end - host));
+        if (host_end == NULL || (host_end + 1 < end && host_end[1] != ':'))
+        {
+            return RETURN_ERROR;
+        }
+        port = host_end + 1 < end ? host_end + 2 : NULL;
+    }
+    else
+    {
+        host_end = memchr(host, ':', len);
+        if (host_end != NULL)
+        {
+            port = host_end + 1;
+        }
+        else
+        {
+            host_end = end;
+        }
+    }
+
+    size_t host_len = (size_t)(host_end - host);
+    size_t port_len = port != NULL ? (size_t)(end - port) : 0;
+    if (host_len == 0 || host_len >= sizeof(target->host) || port_len >= sizeof(target->port) ||
+        (port != NULL && port_len == 0))
+    {
+        return RETURN_ERROR;
+    }
+    memcpy(target->host, host, host_len);
+    target->host[host_len] = '\0';
+    snprintf(target->port, sizeof(target->port), "%.*s", (int)port_len, port_len > 0 ? port : GATEWAY_DEFAULT_PORT);
+    snprintf(target->instance, sizeof(target->instance), "%.*s", (int)len, entry);
+
+    bool ipv6 = strchr(target->host, ':') != NULL;
+    int request_len = snprintf(target->request, sizeof(target->request),
+                               "GET " GATEWAY_PATH " HTTP/1.0\r\n"
+                               "Host: %s%s%s:%s\r\n"
+                               "User-Agent: monitor\r\n"
+                               "Accept: " GATEWAY_ACCEPT "\r\n\r\n",
+                               ipv6 ? "[" : "", target->host, ipv6 ? "]" : "", target->port);
+    if (request_len < 0 || (size_t)request_len >= sizeof(target->request))
+    {
+        return RETURN_ERROR;
+    }
+    target->request_len = (size_t)request_len;
+    target->fd = -1;
+    return 0;
+}
+
+/**
+ * @brief Parses the aggregates to keep.
+ */
+static int parse_aggregates(Gateway* gateway, const char* aggregate)
+{
+    for (const char* p = aggregate; p != NULL && *p != '\0';)
+    {
+        size_t len = strcspn(p, ",");
+        int a = 0;
+        while (a < GATEWAY_AGGREGATE_COUNT &&
+               (strlen(aggregate_names[a]) != len || strncmp(p, aggregate_names[a], len) != 0))
+        {
+            a++;
+        }
+        if (a == GATEWAY_AGGREGATE_COUNT)
+        {
+            fprintf(stderr, "Error: unknown gateway aggregate '%.*s'\n", (int)len, p);
+            return RETURN_ERROR;
+        }
+        gateway->aggregate[a] = true;
+        p += len;
+        p += *p == ',';
+    }
+    return 0;
+}
+
+int gateway_open(Gateway* gateway, const char* targets, const char* aggregate)
+{
+    memset(gateway, 0, sizeof(*gateway));
+    gateway->epoll_fd = -1;
+    if (parse_aggregates(gateway, aggregate) != 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    gateway->targets = calloc(GATEWAY_MAX_TARGETS, sizeof(*gateway->targets));
+    if (gateway->targets == NULL)
+    {
+        perror("calloc");
+        return RETURN_ERROR;
+    }
+    for (const char* p = targets; *p != '\0';)
+    {
+        size_t len = strcspn(p, ",");
+        if (len > 0)
+        {
+            if (gateway->target_count == GATEWAY_MAX_TARGETS ||
+                parse_target(&gateway->targets[gateway->target_count], p, len) != 0)
+            {
+                fprintf(stderr, "Error: invalid or too many gateway targets at '%.*s'\n", (int)len, p);
+                gateway_close(gateway);
+                return RETURN_ERROR;
+            }
+            gateway->target_count++;
+        }
+        p += len;
+        p += *p == ',';
+    }
+    if (gateway->target_count == 0)
+    {
+        fprintf(stderr, "Error: no gateway target in '%s'\n", targets);
+        gateway_close(gateway);
+        return RETURN_ERROR;
+    }
+
+    // Names are resolved here rather than by the scrapes, so a slow name server never holds the targets up
+    for (size_t t = 0; t < gateway->target_count; t++)
+    {
+        if (resolve_target(&gateway->targets[t]) != 0)
+        {
+            fprintf(stderr, "Gateway cannot resolve %s yet\n", gateway->targets[t].instance);
+        }
+    }
+
+    gateway->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (gateway->epoll_fd < 0)
+    {
+        perror("epoll_create1");
+        gateway_close(gateway);
+        return RETURN_ERROR;
+    }
+
+    gateway->up_metric = (prom_gauge_t*)register_family_metric(
+        false, "gateway_target_up", "Whether each gateway target answered the last scrape", 1, up_label_keys);
+    gateway->duration_metric = (prom_gauge_t*)register_family_metric(
+        false, "gateway_scrape_duration_seconds", "Duration of the last scrape of each gateway target in seconds", 1,
+        up_label_keys);
+    return 0;
+}
+
+int gateway_scrape(Gateway* gateway)
+{
+    gateway->pass++;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    size_t pending = 0;
+    for (size_t t = 0; t < gateway->target_count; t++)
+    {
+        GatewayTarget* target = &gateway->targets[t];
+        if (start_target(gateway, target) == 0)
+        {
+            pending++;
+        }
+        else
+        {
+            finish_target(gateway, target, GATEWAY_FAILED, &start);
+        }
+    }
+
+    struct epoll_event events[GATEWAY_EPOLL_EVENTS];
+    while (pending > 0)
+    {
+        int remaining_ms = GATEWAY_TIMEOUT_MS - (int)(seconds_since(&start) * 1000.0);
+        if (remaining_ms <= 0)
+        {
+            break;
+        }
+        int n = epoll_wait(gateway->epoll_fd, events, GATEWAY_EPOLL_EVENTS, remaining_ms);
+        if (n < 0 && errno != EINTR)
+        {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            GatewayTarget* target = events[i].data.ptr;
+            advance_target(gateway, target, &start);
+            pending -= target->state == GATEWAY_DONE || target->state == GATEWAY_FAILED;
+        }
+    }
+
+    for (size_t t = 0; t < gateway->target_count; t++)
+    {
+        GatewayTarget* target = &gateway->targets[t];
+        if (target->state == GATEWAY_CONNECTING || target->state == GATEWAY_RECEIVING)
+        {
+            finish_target(gateway, target, GATEWAY_FAILED, &start);
+        }
+
+        // A target is logged when its state changes, and on the first scrape if it is down
+        bool report = target->up || gateway->pass == 1;
+        bool up = target->state == GATEWAY_DONE && merge_target(gateway, target, report) == 0;
+        if (up != target->up || (report && !up))
+        {
+            fprintf(stderr, "Gateway target %s is %s\n", target->instance, up ? "up" : "down");
+            target->up = up;
+        }
+        target->state = GATEWAY_IDLE;
+
+        const char* label_values[] = {target->instance};
+        if (gateway->up_metric != NULL)
+        {
+            prom_gauge_set(gateway->up_metric, up ? 1.0 : 0.0, label_values);
+        }
+        if (gateway->duration_metric != NULL)
+        {
+            prom_gauge_set(gateway->duration_metric, target->duration, label_values);
+        }
+    }
+    publish_aggregates(gateway);
+    return 0;
+}
+
+void gateway_close(Gateway* gateway)
+{
+    for (size_t t = 0; t < gateway->target_count; t++)
+    {
+        GatewayTarget* target = &gateway->targets[t];
+        if (target->fd >= 0)
+        {
+            close(target->fd);
+        }
+        finish_resolve(target, true);
+        free(target->response);
+    }
+    if (gateway->epoll_fd >= 0)
+    {
+        close(gateway->epoll_fd);
+    }
+    for (size_t f = 0; f < gateway->family_count; f++)
+    {
+        free_family(&gateway->families[f]);
+    }
+    release_family_metric(false, (prom_metric_t*)gateway->up_metric);
+    release_family_metric(false, (prom_metric_t*)gateway->duration_metric);
+    free(gateway->families);
+    free(gateway->targets);
+    free(gateway->scratch);
+    gateway->families = NULL;
+    gateway->family_count = 0;
+    gateway->family_capacity = 0;
+    gateway->up_metric = NULL;
+    gateway->duration_metric = NULL;
+    gateway->targets = NULL;
+    gateway->target_count = 0;
+    gateway->epoll_fd = -1;
+    gateway->scratch = NULL;
+}
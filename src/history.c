@@ -0,0 +1,699 @@
+/**
+ * @file history.c
+ * @brief Functions for keeping the history of every series in a memory-mapped ring of compressed segments.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "history.h"
+#include "json_writer.h"
+#include "metrics.h"
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <prom.h>
+#include <promhttp.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HISTORY_DATA_BITS ((HISTORY_SEGMENT_SIZE - sizeof(HistorySegment)) * 8) /**< Bits of the two columns. */
+#define HISTORY_SAMPLE_MAX_BITS 128                /**< Most bits one sample takes in both columns together. */
+#define HISTORY_NO_WINDOW 0xff                     /**< leading while no XOR window has been written. */
+#define HISTORY_DEFAULT_RANGE_MS 3600000LL         /**< Range of a read that only sets its end. */
+#define HISTORY_FNV_OFFSET 14695981039346656037ull /**< FNV-1a offset basis. */
+#define HISTORY_FNV_PRIME 1099511628211ull         /**< FNV-1a prime. */
+
+/**
+ * @brief Structure to hold a segment selected by a range read.
+ */
+typedef struct
+{
+    uint64_t sequence; /**< Sequence of the segment. */
+    uint32_t index;    /**< Index of the segment in the ring. */
+} SegmentRef;
+
+/**
+ * @brief Structure to hold the decoder state of a segment.
+ */
+typedef struct
+{
+    const HistorySegment* segment; /**< The segment. */
+    uint32_t time_position;        /**< Next bit of the timestamp column. */
+    uint32_t value_position;       /**< Next bit of the value column. */
+    int64_t prev_ms;               /**< Last timestamp decoded. */
+    int64_t prev_delta;            /**< Difference between the last two timestamps. */
+    uint64_t prev_bits;            /**< Bits of the last value decoded. */
+    uint8_t leading;               /**< Leading zero bits of the XOR window. */
+    uint8_t trailing;              /**< Trailing zero bits of the XOR window. */
+} SegmentDecoder;
+
+static HistorySegment* segment_at(const History* history, uint32_t index)
+{
+    // The file header takes the first segment
+    return (HistorySegment*)((char*)history->header + (size_t)(index + 1) * HISTORY_SEGMENT_SIZE);
+}
+
+/**
+ * @brief Returns the bit of the data area at a position of a column.
+ *
+ * The timestamp column runs forward from the first bit, the value column backwards from the last one, so the two
+ * share the segment without a fixed split.
+ */
+static size_t column_bit(bool values, uint32_t position)
+{
+    return values ? HISTORY_DATA_BITS - 1 - position : position;
+}
+
+static void put_bits(uint8_t* data, bool values, uint32_t* position, uint64_t bits, unsigned int count)
+{
+    for (unsigned int i = count; i-- > 0;)
+    {
+        if ((bits >> i) & 1)
+        {
+            size_t bit = column_bit(values, *position);
+            data[bit >> 3] |= (uint8_t)(0x80 >> (bit & 7));
+        }
+        (*position)++;
+    }
+}
+
+static uint64_t get_bits(const uint8_t* data, bool values, uint32_t* position, unsigned int count)
+{
+    uint64_t bits = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+        // Past the data area only happens on a torn segment, which the caller then stops decoding
+        uint64_t bit_value = 0;
+        if (*position < HISTORY_DATA_BITS)
+        {
+            size_t bit = column_bit(values, *position);
+            bit_value = (data[bit >> 3] >> (7 - (bit & 7))) & 1;
+        }
+        bits = (bits << 1) | bit_value;
+        (*position)++;
+    }
+    return bits;
+}
+
+static int64_t sign_extend(uint64_t bits, unsigned int count)
+{
+    return (int64_t)(bits << (64 - count)) >> (64 - count);
+}
+
+static uint64_t double_bits(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/**
+ * @brief Appends the delta-of-delta code of a timestamp to the timestamp column.
+ *
+ * @return false, having written nothing, if the code does not fit in 32 bits.
+ */
+static bool encode_time(HistorySegment* segment, HistorySeries* series, int64_t timestamp_ms)
+{
+    int64_t dod = (timestamp_ms - series->prev_ms) - series->prev_delta;
+    uint32_t* position = &segment->time_bits;
+    if (dod == 0)
+    {
+        put_bits(segment->data, false, position, 0x0, 1);
+    }
+    else if (dod >= -64 && dod <= 63)
+    {
+        put_bits(segment->data, false, position, 0x2, 2);
+        put_bits(segment->data, false, position, (uint64_t)dod, 7);
+    }
+    else if (dod >= -256 && dod <= 255)
+    {
+        put_bits(segment->data, false, position, 0x6, 3);
+        put_bits(segment->data, false, position, (uint64_t)dod, 9);
+    }
+    else if (dod >= -2048 && dod <= 2047)
+    {
+        put_bits(segment->data, false, position, 0xe, 4);
+        put_bits(segment->data, false, position, (uint64_t)dod, 12);
+    }
+    else if (dod >= INT32_MIN && dod <= INT32_MAX)
+    {
+        put_bits(segment->data, false, position, 0xf, 4);
+        put_bits(segment->data, false, position, (uint64_t)dod, 32);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Appends a value XORed with the previous one to the value column.
+ */
+static void encode_value(HistorySegment* segment, HistorySeries* series, uint64_t bits)
+{
+    uint32_t* position = &segment->value_bits;
+    uint64_t xor = bits ^ series->prev_bits;
+    if (xor == 0)
+    {
+        put_bits(segment->data, true, position, 0x0, 1);
+        return;
+    }
+
+    unsigned int leading = (unsigned int)__builtin_clzll(xor);
+    unsigned int trailing = (unsigned int)__builtin_ctzll(xor);
+    leading = leading > 31 ? 31 : leading;
+    if (series->leading != HISTORY_NO_WINDOW && leading >= series->leading && trailing >= series->trailing)
+    {
+        // The meaningful bits fit in the previous window
+        put_bits(segment->data, true, position, 0x2, 2);
+        put_bits(segment->data, true, position, xor >> series->trailing, 64 - series->leading - series->trailing);
+        return;
+    }
+
+    unsigned int meaningful = 64 - leading - trailing;
+    put_bits(segment->data, true, position, 0x3, 2);
+    put_bits(segment->data, true, position, leading, 5);
+    put_bits(segment->data, true, position, meaningful - 1, 6);
+    put_bits(segment->data, true, position, xor >> trailing, meaningful);
+    series->leading = (uint8_t)leading;
+    series->trailing = (uint8_t)trailing;
+}
+
+/**
+ * @brief Takes the next segment of the ring for a series, overwriting what it held.
+ */
+static HistorySegment* take_segment(History* history, HistorySeries* series)
+{
+    uint32_t index = history->header->next_segment;
+    history->header->next_segment = (index + 1) % history->header->segment_count;
+
+    HistorySegment* segment = segment_at(history, index);
+    memset(segment, 0, HISTORY_SEGMENT_SIZE);
+    segment->sequence = history->next_sequence++;
+    snprintf(segment->series, sizeof(segment->series), "%s", series->name);
+    segment->magic = HISTORY_SEGMENT_MAGIC;
+
+    series->segment = segment;
+    series->sequence = segment->sequence;
+    series->leading = HISTORY_NO_WINDOW;
+    return segment;
+}
+
+/**
+ * @brief Appends a sample to the segment of a series, or to a new one if it is full or was reclaimed.
+ *
+ * A timestamp that does not follow the previous one, after the clock was set back, also starts a new segment, so the
+ * samples of a segment are always in time order.
+ */
+static void append_sample(History* history, HistorySeries* series, int64_t timestamp_ms, double value)
+{
+    uint64_t bits = double_bits(value);
+    HistorySegment* segment = series->segment;
+    if (segment != NULL && segment->sequence == series->sequence && timestamp_ms == series->prev_ms)
+    {
+        // One sample per millisecond; a second one would not tell the first apart
+        return;
+    }
+    bool fresh = segment == NULL || segment->sequence != series->sequence || timestamp_ms <= series->prev_ms ||
+                 segment->time_bits + segment->value_bits + HISTORY_SAMPLE_MAX_BITS > HISTORY_DATA_BITS;
+
+    if (fresh || !encode_time(segment, series, timestamp_ms))
+    {
+        segment = take_segment(history, series);
+        put_bits(segment->data, false, &segment->time_bits, (uint64_t)timestamp_ms, 64);
+        put_bits(segment->data, true, &segment->value_bits, bits, 64);
+        segment->first_ms = timestamp_ms;
+        series->prev_delta = 0;
+    }
+    else
+    {
+        encode_value(segment, series, bits);
+        series->prev_delta = timestamp_ms - series->prev_ms;
+    }
+
+    series->prev_ms = timestamp_ms;
+    series->prev_bits = bits;
+    segment->last_ms = timestamp_ms;
+    segment->count++;
+}
+
+/**
+ * @brief Decodes the next sample of a segment.
+ *
+ * @return false once a column runs past the bits it holds.
+ */
+static bool decode_sample(SegmentDecoder* decoder, bool first, int64_t* timestamp_ms, double* value)
+{
+    const HistorySegment* segment = decoder->segment;
+    const uint8_t* data = segment->data;
+    if (first)
+    {
+        decoder->prev_ms = (int64_t)get_bits(data, false, &decoder->time_position, 64);
+        decoder->prev_bits = get_bits(data, true, &decoder->value_position, 64);
+        decoder->prev_delta = 0;
+        decoder->leading = HISTORY_NO_WINDOW;
+    }
+    else
+    {
+        unsigned int ones = 0;
+        while (ones < 4 && get_bits(data, false, &decoder->time_position, 1) == 1)
+        {
+            ones++;
+        }
+        static const unsigned int dod_bits[] = {0, 7, 9, 12, 32};
+        int64_t dod = ones == 0 ? 0 : sign_extend(get_bits(data, false, &decoder->time_position, dod_bits[ones]),
+                                                  dod_bits[ones]);
+        decoder->prev_delta += dod;
+        decoder->prev_ms += decoder->prev_delta;
+
+        if (get_bits(data, true, &decoder->value_position, 1) == 1)
+        {
+            if (get_bits(data, true, &decoder->value_position, 1) == 1)
+            {
+                decoder->leading = (uint8_t)get_bits(data, true, &decoder->value_position, 5);
+                unsigned int meaningful = (unsigned int)get_bits(data, true, &decoder->value_position, 6) + 1;
+                decoder->trailing = (uint8_t)(64 - decoder->leading - meaningful);
+            }
+            else if (decoder->leading == HISTORY_NO_WINDOW)
+            {
+                return false;
+            }
+            unsigned int meaningful = 64 - decoder->leading - decoder->trailing;
+            decoder->prev_bits ^= get_bits(data, true, &decoder->value_position, meaningful) << decoder->trailing;
+        }
+    }
+
+    if (decoder->time_position > segment->time_bits || decoder->value_position > segment->value_bits)
+    {
+        return false;
+    }
+    *timestamp_ms = decoder->prev_ms;
+    memcpy(value, &decoder->prev_bits, sizeof(*value));
+    return true;
+}
+
+static uint64_t hash_series(const char* name, size_t len)
+{
+    uint64_t hash = HISTORY_FNV_OFFSET;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ (unsigned char)name[i]) * HISTORY_FNV_PRIME;
+    }
+    return hash;
+}
+
+static void index_insert(HistorySeries** slots, size_t slot_count, HistorySeries* series)
+{
+    size_t i = (size_t)series->hash & (slot_count - 1);
+    while (slots[i] != NULL)
+    {
+        i = (i + 1) & (slot_count - 1);
+    }
+    slots[i] = series;
+}
+
+static int index_grow(History* history)
+{
+    size_t slot_count = history->slot_count * 2;
+    HistorySeries** slots = calloc(slot_count, sizeof(*slots));
+    if (slots == NULL)
+    {
+        perror("calloc");
+        return RETURN_ERROR;
+    }
+    for (size_t i = 0; i < history->series_count; i++)
+    {
+        index_insert(slots, slot_count, history->series[i]);
+    }
+    free(history->slots);
+    history->slots = slots;
+    history->slot_count = slot_count;
+    return 0;
+}
+
+/**
+ * @brief Returns the encoder state of a series, adding it on first sight.
+ */
+static HistorySeries* find_series(History* history, const char* name, size_t len)
+{
+    uint64_t hash = hash_series(name, len);
+    size_t i = (size_t)hash & (history->slot_count - 1);
+    while (history->slots[i] != NULL)
+    {
+        HistorySeries* series = history->slots[i];
+        if (series->hash == hash && strncmp(series->name, name, len) == 0 && series->name[len] == '\0')
+        {
+            return series;
+        }
+        i = (i + 1) & (history->slot_count - 1);
+    }
+
+    if ((double)(history->series_count + 1) > (double)history->slot_count * HISTORY_MAX_LOAD &&
+        index_grow(history) != 0)
+    {
+        return NULL;
+    }
+    if (history->series_count == history->series_capacity)
+    {
+        size_t capacity = history->series_capacity > 0 ? history->series_capacity * 2 : HISTORY_INITIAL_SLOTS;
+        HistorySeries** list = realloc(history->series, capacity * sizeof(*list));
+        if (list == NULL)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        history->series = list;
+        history->series_capacity = capacity;
+    }
+
+    HistorySeries* series = calloc(1, sizeof(*series));
+    char* copy = malloc(len + 1);
+    if (series == NULL || copy == NULL)
+    {
+        perror("malloc");
+        free(series);
+        free(copy);
+        return NULL;
+    }
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    series->name = copy;
+    series->hash = hash;
+    series->leading = HISTORY_NO_WINDOW;
+    history->series[history->series_count++] = series;
+    index_insert(history->slots, history->slot_count, series);
+    return series;
+}
+
+/**
+ * @brief Keeps the value of a series read by the snapshot; only those staged in the current pass are appended.
+ */
+static void stage_sample(size_t index, const prom_sample_view_t* view, void* arg)
+{
+    History* history = arg;
+    (void)index;
+    HistorySeries* series = find_series(history, view->series, view->series_len);
+    if (series != NULL)
+    {
+        series->pending = view->integer ? (double)view->u_value : view->value;
+        series->pending_pass = history->pass;
+    }
+}
+
+int history_open(History* history, const char* directory, size_t size)
+{
+    memset(history, 0, sizeof(*history));
+    history->fd = -1;
+    pthread_mutex_init(&history->mutex, NULL);
+
+    size_t segment_count = size / HISTORY_SEGMENT_SIZE;
+    segment_count = segment_count > HISTORY_MIN_SEGMENTS + 1 ? segment_count - 1 : HISTORY_MIN_SEGMENTS;
+    segment_count = segment_count < UINT32_MAX ? segment_count : UINT32_MAX;
+    size_t file_size = (segment_count + 1) * HISTORY_SEGMENT_SIZE;
+
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", directory, HISTORY_FILE_NAME) >= (int)sizeof(path))
+    {
+        fprintf(stderr, "Error: history directory path too long\n");
+        return RETURN_ERROR;
+    }
+    history->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (history->fd < 0)
+    {
+        perror("Error opening the history file");
+        return RETURN_ERROR;
+    }
+    if (flock(history->fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        perror("Error locking the history file");
+        history_close(history);
+        return RETURN_ERROR;
+    }
+
+    // A file of another size or layout is emptied; truncating it zeroes it without touching its pages
+    struct stat st;
+    HistoryFileHeader stored = {0};
+    bool reuse = fstat(history->fd, &st) == 0 && (size_t)st.st_size == file_size &&
+                 pread(history->fd, &stored, sizeof(stored), 0) == (ssize_t)sizeof(stored) &&
+                 stored.magic == HISTORY_MAGIC && stored.version == HISTORY_VERSION &&
+                 stored.segment_size == HISTORY_SEGMENT_SIZE && stored.segment_count == segment_count;
+    if (!reuse && (ftruncate(history->fd, 0) != 0 || ftruncate(history->fd, (off_t)file_size) != 0))
+    {
+        perror("Error sizing the history file");
+        history_close(history);
+        return RETURN_ERROR;
+    }
+
+    void* mapping = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, history->fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        perror("Error mapping the history file");
+        history_close(history);
+        return RETURN_ERROR;
+    }
+    history->header = mapping;
+    history->mapped_size = file_size;
+
+    if (!reuse)
+    {
+        history->header->version = HISTORY_VERSION;
+        history->header->segment_size = HISTORY_SEGMENT_SIZE;
+        history->header->segment_count = (uint32_t)segment_count;
+        history->header->magic = HISTORY_MAGIC;
+    }
+    else
+    {
+        for (uint32_t i = 0; i < history->header->segment_count; i++)
+        {
+            const HistorySegment* segment = segment_at(history, i);
+            if (segment->magic == HISTORY_SEGMENT_MAGIC && segment->sequence >= history->next_sequence)
+            {
+                history->next_sequence = segment->sequence + 1;
+            }
+        }
+        if (history->header->next_segment >= history->header->segment_count)
+        {
+            history->header->next_segment = 0;
+        }
+    }
+
+    history->slots = calloc(HISTORY_INITIAL_SLOTS, sizeof(*history->slots));
+    if (history->slots == NULL)
+    {
+        perror("calloc");
+        history_close(history);
+        return RETURN_ERROR;
+    }
+    history->slot_count = HISTORY_INITIAL_SLOTS;
+    return 0;
+}
+
+int history_record(History* history)
+{
+    history->pass++;
+    if (prom_collector_registry_visit_samples(PROM_COLLECTOR_REGISTRY_DEFAULT, stage_sample, history, NULL) != 0)
+    {
+        fprintf(stderr, "Error reading the metrics for the history\n");
+        return RETURN_ERROR;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t timestamp_ms = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+    pthread_mutex_lock(&history->mutex);
+    for (size_t i = 0; i < history->series_count; i++)
+    {
+        HistorySeries* series = history->series[i];
+        if (series->pending_pass == history->pass)
+        {
+            append_sample(history, series, timestamp_ms, series->pending);
+        }
+    }
+    pthread_mutex_unlock(&history->mutex);
+    return 0;
+}
+
+static int compare_segment_refs(const void* a, const void* b)
+{
+    uint64_t left = ((const SegmentRef*)a)->sequence;
+    uint64_t right = ((const SegmentRef*)b)->sequence;
+    return (left > right) - (left < right);
+}
+
+size_t history_read(History* history, const char* series, int64_t from_ms, int64_t to_ms, history_point_fn fn,
+                    void* arg)
+{
+    // Segments hold the name truncated to fit, so the name asked for is compared the same way
+    char name[HISTORY_SERIES_SIZE];
+    snprintf(name, sizeof(name), "%s", series);
+
+    uint32_t segment_count = history->header->segment_count;
+    SegmentRef* refs = malloc(segment_count * sizeof(*refs));
+    if (refs == NULL)
+    {
+        perror("malloc");
+        return 0;
+    }
+
+    pthread_mutex_lock(&history->mutex);
+    size_t ref_count = 0;
+    for (uint32_t i = 0; i < segment_count; i++)
+    {
+        const HistorySegment* segment = segment_at(history, i);
+        if (segment->magic == HISTORY_SEGMENT_MAGIC && segment->count > 0 && segment->last_ms >= from_ms &&
+            segment->first_ms <= to_ms && strcmp(segment->series, name) == 0)
+        {
+            refs[ref_count++] = (SegmentRef){segment->sequence, i};
+        }
+    }
+    qsort(refs, ref_count, sizeof(*refs), compare_segment_refs);
+
+    size_t points = 0;
+    for (size_t r = 0; r < ref_count; r++)
+    {
+        SegmentDecoder decoder = {segment_at(history, refs[r].index), 0, 0, 0, 0, 0, HISTORY_NO_WINDOW, 0};
+        for (uint32_t s = 0; s < decoder.segment->count; s++)
+        {
+            int64_t timestamp_ms;
+            double value;
+            if (!decode_sample(&decoder, s == 0, &timestamp_ms, &value) || timestamp_ms > to_ms)
+            {
+                break;
+            }
+            if (timestamp_ms >= from_ms)
+            {
+                fn(timestamp_ms, value, arg);
+                points++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&history->mutex);
+
+    free(refs);
+    return points;
+}
+
+/**
+ * @brief Structure to hold the body of a range read being rendered.
+ */
+typedef struct
+{
+    JsonWriter writer; /**< The body. */
+    size_t count;      /**< Number of samples written. */
+} HistoryRender;
+
+/**
+ * @brief Appends a sample as [<seconds>, "<value>"]; matches history_point_fn.
+ */
+static void write_point(int64_t timestamp_ms, double value, void* arg)
+{
+    HistoryRender* render = arg;
+    json_append(&render->writer, "%s[%.3f,", render->count++ > 0 ? "," : "", (double)timestamp_ms / 1000.0);
+    if (isnan(value))
+    {
+        json_append(&render->writer, "\"NaN\"]");
+    }
+    else if (isinf(value))
+    {
+        json_append(&render->writer, "\"%sInf\"]", value > 0 ? "+" : "-");
+    }
+    else
+    {
+        json_append(&render->writer, "\"%.17g\"]", value);
+    }
+}
+
+/**
+ * @brief Parses a timestamp argument in seconds into milliseconds.
+ *
+ * @return false if the argument is set but is not a number.
+ */
+static bool parse_seconds(const char* value, int64_t* timestamp_ms)
+{
+    if (value == NULL)
+    {
+        return true;
+    }
+    char* end = NULL;
+    errno = 0;
+    double seconds = strtod(value, &end);
+    if (errno != 0 || end == value || *end != '\0' || !isfinite(seconds))
+    {
+        return false;
+    }
+    *timestamp_ms = (int64_t)(seconds * 1000.0);
+    return true;
+}
+
+/**
+ * @brief Renders /history; matches promhttp_endpoint_fn.
+ */
+static size_t render_history(void* arg, promhttp_request_t* request, char* buf, size_t size)
+{
+    History* history = arg;
+    HistoryRender render = {{buf, size, 0}, 0};
+
+    const char* series = promhttp_request_argument(request, "series");
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t to_ms = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    int64_t from_ms = INT64_MIN;
+    if (series == NULL || !parse_seconds(promhttp_request_argument(request, "end"), &to_ms) ||
+        !parse_seconds(promhttp_request_argument(request, "start"), &from_ms))
+    {
+        promhttp_request_set_status(request, MHD_HTTP_BAD_REQUEST);
+        json_append(&render.writer, "{\"error\":\"Usage: /history?series=<series>&start=<seconds>&end=<seconds>\"}\n");
+        return render.writer.len;
+    }
+    if (from_ms == INT64_MIN)
+    {
+        from_ms = to_ms - HISTORY_DEFAULT_RANGE_MS;
+    }
+
+    json_append(&render.writer, "{\"series\":");
+    json_string(&render.writer, series);
+    json_append(&render.writer, ",\"values\":[");
+    history_read(history, series, from_ms, to_ms, write_point, &render);
+    json_append(&render.writer, "]}\n");
+    return render.writer.len;
+}
+
+int history_add_endpoint(History* history)
+{
+    if (promhttp_add_endpoint("/history", "application/json", render_history, history) != 0)
+    {
+        fprintf(stderr, "Error adding the history endpoint\n");
+        return RETURN_ERROR;
+    }
+    return 0;
+}
+
+void history_close(History* history)
+{
+    if (history->header != NULL)
+    {
+        munmap(history->header, history->mapped_size);
+        history->header = NULL;
+    }
+    if (history->fd >= 0)
+    {
+        close(history->fd);
+        history->fd = -1;
+    }
+
+    for (size_t i = 0; i < history->series_count; i++)
+    {
+        free(history->series[i]->name);
+        free(history->series[i]);
+    }
+    free(history->series);
+    free(history->slots);
+    history->series = NULL;
+    history->slots = NULL;
+    history->series_count = 0;
+    history->series_capacity = 0;
+    pthread_mutex_destroy(&history->mutex);
+}
@@ -0,0 +1,521 @@
+/**
+ * @file hwmon.c
+ * @brief Functions for discovering the hwmon sensors and reading them through persistent file descriptors.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#define _GNU_SOURCE // Required for memmem
+
+#include "hwmon.h"
+#include "metrics.h"
+#include <errno.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Attribute prefix and scale to the base unit of every sensor kind, indexed by HwmonKind.
+ */
+static const struct
+{
+    const char* prefix; /**< Attribute prefix. */
+    double scale;       /**< Factor converting the raw value to the base unit. */
+} hwmon_kinds[HWMON_KIND_COUNT] = {
+    {"temp", 1e-3},
+    {"fan", 1.0},
+    {"in", 1e-3},
+    {"curr", 1e-3},
+    {"power", 1e-6},
+};
+
+static const char* const cpu_chip_names[] = {"coretemp", "k10temp", "zenpower", "cpu_thermal", "acpitz",
+                                             NULL}; /**< Chips reporting the CPU temperature, by preference. */
+static const char* const gpu_chip_names[] = {"amdgpu", "nouveau", "radeon", NULL}; /**< Chips of GPUs. */
+
+/**
+ * @brief Opens the socket receiving kernel uevents.
+ *
+ * @return The socket, or -1 if uevents are unavailable.
+ */
+static int open_uevent_socket(void)
+{
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    // Group 1 carries the uevents broadcast by the kernel itself, before udev processes them
+    struct sockaddr_nl addr = {.nl_family = AF_NETLINK, .nl_groups = 1};
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return RETURN_ERROR;
+    }
+    return fd;
+}
+
+void hwmon_table_init(HwmonTable* table, const char* root, hwmon_release_fn release)
+{
+    memset(table, 0, sizeof(*table));
+    table->root = root;
+    table->release = release;
+    table->rescan = true;
+    for (int i = 0; i < HWMON_ROLE_COUNT; i++)
+    {
+        table->roles[i] = -1;
+    }
+    table->uevent_fd = open_uevent_socket();
+}
+
+/**
+ * @brief Closes the descriptors of every sensor and empties the table.
+ */
+static void close_sensors(HwmonTable* table)
+{
+    for (size_t i = 0; i < table->sensor_count; i++)
+    {
+        close(table->sensors[i].fd);
+    }
+    table->sensor_count = 0;
+}
+
+void hwmon_table_free(HwmonTable* table)
+{
+    close_sensors(table);
+    free(table->sensors);
+    table->sensors = NULL;
+    table->sensor_capacity = 0;
+    if (table->uevent_fd >= 0)
+    {
+        close(table->uevent_fd);
+        table->uevent_fd = -1;
+    }
+}
+
+/**
+ * @brief Reads a short sysfs attribute without its trailing newline.
+ *
+ * @param path Path of the attribute.
+ * @param buffer Buffer of HWMON_NAME_SIZE bytes to store the contents.
+ * @return 0 on success, or -1 if the attribute cannot be read.
+ */
+static int read_attribute(const char* path, char buffer[HWMON_NAME_SIZE])
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    ssize_t n = read(fd, buffer, HWMON_NAME_SIZE - 1);
+    close(fd);
+    if (n <= 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    while (n > 0 && (buffer[n - 1] == '\n' || buffer[n - 1] == ' '))
+    {
+        n--;
+    }
+    buffer[n] = '\0';
+    return n > 0 ? 0 : RETURN_ERROR;
+}
+
+/**
+ * @brief Parses the name of an input attribute, such as temp1_input.
+ *
+ * @param name The attribute name.
+ * @param kind Pointer to store the sensor kind.
+ * @param sensor Buffer of HWMON_NAME_SIZE bytes to store the attribute prefix, such as temp1.
+ * @return 1 if the attribute is a sensor input, 0 otherwise.
+ */
+static int parse_input_name(const char* name, HwmonKind* kind, char sensor[HWMON_NAME_SIZE])
+{
+    for (int k = 0; k < HWMON_KIND_COUNT; k++)
+    {
+        size_t prefix_len = strlen(hwmon_kinds[k].prefix);
+        if (strncmp(name, hwmon_kinds[k].prefix, prefix_len) != 0)
+        {
+            continue;
+        }
+
+        const char* p = name + prefix_len;
+        const char* digits = p;
+        while (*p >= '0' && *p <= '9')
+        {
+            p++;
+        }
+        if (p == digits || strcmp(p, "_input") != 0 || (size_t)(p - name) >= HWMON_NAME_SIZE)
+        {
+            return 0;
+        }
+
+        memcpy(sensor, name, (size_t)(p - name));
+        sensor[p - name] = '\0';
+        *kind = (HwmonKind)k;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Appends a sensor to the table.
+ *
+ * @return The new entry, or NULL if the array cannot be grown.
+ */
+static HwmonSensor* add_sensor(HwmonTable* table)
+{
+    if (table->sensor_count == table->sensor_capacity)
+    {
+        size_t capacity = table->sensor_capacity ? table->sensor_capacity * 2 : 32;
+        HwmonSensor* sensors = realloc(table->sensors, capacity * sizeof(*sensors));
+        if (sensors == NULL)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        table->sensors = sensors;
+        table->sensor_capacity = capacity;
+    }
+    return &table->sensors[table->sensor_count++];
+}
+
+/**
+ * @brief Opens every sensor input of one chip.
+ *
+ * @param table The table.
+ * @param dir Directory of the chip attributes.
+ * @param chip Chip label of the sensors.
+ * @param name Chip name of the sensors.
+ */
+static void scan_chip(HwmonTable* table, const char* dir, const char* chip, const char* name)
+{
+    DIR* attributes = opendir(dir);
+    if (attributes == NULL)
+    {
+        return;
+    }
+
+    const struct dirent* entry;
+    while ((entry = readdir(attributes)) != NULL)
+    {
+        HwmonKind kind;
+        char sensor[HWMON_NAME_SIZE];
+        if (!parse_input_name(entry->d_name, &kind, sensor))
+        {
+            continue;
+        }
+
+        char path[BUFFER_SIZE];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        HwmonSensor* s = add_sensor(table);
+        if (s == NULL)
+        {
+            close(fd);
+            break;
+        }
+        memset(s, 0, sizeof(*s));
+        s->kind = kind;
+        s->fd = fd;
+        snprintf(s->chip, sizeof(s->chip), "%s", chip);
+        snprintf(s->name, sizeof(s->name), "%s", name);
+        memcpy(s->sensor, sensor, sizeof(sensor));
+
+        snprintf(path, sizeof(path), "%s/%s_label", dir, sensor);
+        if (read_attribute(path, s->label) != 0)
+        {
+            memcpy(s->label, sensor, sizeof(sensor));
+        }
+    }
+    closedir(attributes);
+}
+
+/**
+ * @brief Orders sensors by chip, kind and attribute number, so that discovery does not depend on readdir() order.
+ */
+static int compare_sensors(const void* a, const void* b)
+{
+    const HwmonSensor* x = a;
+    const HwmonSensor* y = b;
+
+    int c = strcmp(x->chip, y->chip);
+    if (c != 0)
+    {
+        return c;
+    }
+    if (x->kind != y->kind)
+    {
+        return x->kind < y->kind ? -1 : 1;
+    }
+
+    long nx = strtol(x->sensor + strlen(hwmon_kinds[x->kind].prefix), NULL, 10);
+    long ny = strtol(y->sensor + strlen(hwmon_kinds[y->kind].prefix), NULL, 10);
+    return (nx > ny) - (nx < ny);
+}
+
+/**
+ * @brief Checks whether a chip name is listed.
+ */
+static bool name_in(const char* name, const char* const* names)
+{
+    for (; *names != NULL; names++)
+    {
+        if (strcmp(name, *names) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Returns the index of the first sensor of a kind accepted by a predicate, or -1.
+ */
+static int find_sensor(const HwmonTable* table, HwmonKind kind, bool (*accept)(const HwmonSensor*, const void*),
+                       const void* arg)
+{
+    for (size_t i = 0; i < table->sensor_count; i++)
+    {
+        if (table->sensors[i].kind == kind && accept(&table->sensors[i], arg))
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static bool is_named(const HwmonSensor* sensor, const void* name)
+{
+    return strcmp(sensor->name, name) == 0;
+}
+
+static bool is_battery(const HwmonSensor* sensor, const void* arg)
+{
+    (void)arg;
+    return strncmp(sensor->name, "BAT", 3) == 0;
+}
+
+static bool is_gpu(const HwmonSensor* sensor, const void* arg)
+{
+    (void)arg;
+    return name_in(sensor->name, gpu_chip_names);
+}
+
+static bool is_not_gpu(const HwmonSensor* sensor, const void* arg)
+{
+    (void)arg;
+    return !name_in(sensor->name, gpu_chip_names);
+}
+
+static bool is_after_on_chip(const HwmonSensor* sensor, const void* first)
+{
+    const HwmonSensor* other = first;
+    return sensor > other && strcmp(sensor->chip, other->chip) == 0;
+}
+
+/**
+ * @brief Picks the sensors standing in for the fixed paths of the single-value gauges.
+ */
+static void assign_roles(HwmonTable* table)
+{
+    int* roles = table->roles;
+
+    roles[HWMON_ROLE_CPU_TEMP] = -1;
+    for (const char* const* name = cpu_chip_names; *name != NULL && roles[HWMON_ROLE_CPU_TEMP] < 0; name++)
+    {
+        roles[HWMON_ROLE_CPU_TEMP] = find_sensor(table, HWMON_TEMP, is_named, *name);
+    }
+    roles[HWMON_ROLE_BATTERY_VOLTAGE] = find_sensor(table, HWMON_IN, is_battery, NULL);
+    roles[HWMON_ROLE_BATTERY_CURRENT] = find_sensor(table, HWMON_CURR, is_battery, NULL);
+    roles[HWMON_ROLE_CPU_FAN] = find_sensor(table, HWMON_FAN, is_not_gpu, NULL);
+    roles[HWMON_ROLE_GPU_FAN] = find_sensor(table, HWMON_FAN, is_gpu, NULL);
+    if (roles[HWMON_ROLE_GPU_FAN] < 0 && roles[HWMON_ROLE_CPU_FAN] >= 0)
+    {
+        roles[HWMON_ROLE_GPU_FAN] =
+            find_sensor(table, HWMON_FAN, is_after_on_chip, &table->sensors[roles[HWMON_ROLE_CPU_FAN]]);
+    }
+}
+
+/**
+ * @brief Hands the sensors a discovery pass did not find again to the release callback.
+ *
+ * @param table The table, holding the sensors the pass found.
+ * @param previous The sensors before the pass, with their descriptors already closed. The array is freed.
+ * @param previous_count Number of entries in previous.
+ */
+static void release_lost_sensors(const HwmonTable* table, HwmonSensor* previous, size_t previous_count)
+{
+    for (size_t i = 0; i < previous_count && table->release != NULL; i++)
+    {
+        const HwmonSensor* old = &previous[i];
+        bool found = old->sample == NULL;
+        for (size_t j = 0; j < table->sensor_count && !found; j++)
+        {
+            const HwmonSensor* s = &table->sensors[j];
+            found = s->kind == old->kind && strcmp(s->chip, old->chip) == 0 && strcmp(s->sensor, old->sensor) == 0 &&
+                    strcmp(s->label, old->label) == 0;
+        }
+        if (!found)
+        {
+            table->release(old);
+        }
+    }
+    free(previous);
+}
+
+/**
+ * @brief Runs a discovery pass, replacing every sensor of the table.
+ *
+ * @param table The table.
+ * @return 0 on success, or -1 if the chip directory cannot be listed.
+ */
+static int scan_sensors(HwmonTable* table)
+{
+    // The previous sensors are kept until the pass ends so that the ones it finds again keep their series
+    HwmonSensor* previous = table->sensors;
+    size_t previous_count = table->sensor_count;
+    close_sensors(table);
+    table->sensors = NULL;
+    table->sensor_capacity = 0;
+    table->rescan = false;
+
+    DIR* root = opendir(table->root);
+    if (root == NULL)
+    {
+        assign_roles(table);
+        release_lost_sensors(table, previous, previous_count);
+        return RETURN_ERROR;
+    }
+
+    const struct dirent* entry;
+    while ((entry = readdir(root)) != NULL)
+    {
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+
+        char dir[BUFFER_SIZE];
+        char path[BUFFER_SIZE];
+        char name[HWMON_NAME_SIZE];
+        if (snprintf(dir, sizeof(dir), "%s/%s", table->root, entry->d_name) >= (int)sizeof(dir) - 16)
+        {
+            continue;
+        }
+
+        // Older drivers keep their attributes on the parent device rather than on the hwmon class device
+        snprintf(path, sizeof(path), "%.*s/name", (int)sizeof(dir) - 16, dir);
+        if (read_attribute(path, name) != 0)
+        {
+            snprintf(path, sizeof(path), "%.*s/device/name", (int)sizeof(dir) - 16, dir);
+            if (read_attribute(path, name) != 0)
+            {
+                continue;
+            }
+            strncat(dir, "/device", sizeof(dir) - strlen(dir) - 1);
+        }
+
+        // The device a chip belongs to, such as coretemp.0 or 0000:01:00.0, does not change between boots
+        char chip[HWMON_NAME_SIZE];
+        char device[BUFFER_SIZE];
+        snprintf(path, sizeof(path), "%s/%s/device", table->root, entry->d_name);
+        if (realpath(path, device) != NULL)
+        {
+            const char* base = strrchr(device, '/');
+            snprintf(chip, sizeof(chip), "%.*s", (int)sizeof(chip) - 1, base != NULL ? base + 1 : device);
+        }
+        else
+        {
+            memcpy(chip, name, sizeof(chip));
+        }
+
+        scan_chip(table, dir, chip, name);
+    }
+    closedir(root);
+
+    qsort(table->sensors, table->sensor_count, sizeof(*table->sensors), compare_sensors);
+    assign_roles(table);
+    release_lost_sensors(table, previous, previous_count);
+    return 0;
+}
+
+/**
+ * @brief Drains the pending uevents and flags a discovery pass if one of them concerns hwmon.
+ */
+static void drain_uevents(HwmonTable* table)
+{
+    if (table->uevent_fd < 0)
+    {
+        return;
+    }
+
+    char buffer[HWMON_UEVENT_BUFFER];
+    ssize_t n;
+    while ((n = recv(table->uevent_fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0)
+    {
+        // The payload is a list of NUL-separated KEY=value pairs
+        if (memmem(buffer, (size_t)n, "SUBSYSTEM=hwmon", sizeof("SUBSYSTEM=hwmon")) != NULL)
+        {
+            table->rescan = true;
+        }
+    }
+    if (n < 0 && errno == ENOBUFS)
+    {
+        // Uevents were dropped, so a hwmon one may have been lost
+        table->rescan = true;
+    }
+}
+
+int hwmon_table_read(HwmonTable* table)
+{
+    drain_uevents(table);
+
+    int scanned = 0;
+    if (table->rescan)
+    {
+        if (scan_sensors(table) != 0)
+        {
+            return RETURN_ERROR;
+        }
+        scanned = 1;
+    }
+
+    for (size_t i = 0; i < table->sensor_count; i++)
+    {
+        HwmonSensor* sensor = &table->sensors[i];
+        char buffer[HWMON_VALUE_SIZE];
+        ssize_t n = pread(sensor->fd, buffer, sizeof(buffer) - 1, 0);
+        if (n <= 0)
+        {
+            // An unplugged device leaves its descriptors stale; a sensor that is merely idle reports EAGAIN or EIO
+            if (n < 0 && (errno == ENODEV || errno == ENXIO || errno == ENOENT))
+            {
+                table->rescan = true;
+            }
+            sensor->valid = false;
+            continue;
+        }
+
+        buffer[n] = '\0';
+        char* end;
+        long raw = strtol(buffer, &end, 10);
+        sensor->valid = end != buffer;
+        sensor->value = (double)raw * hwmon_kinds[sensor->kind].scale;
+    }
+
+    return scanned;
+}
+
+const HwmonSensor* hwmon_table_role(const HwmonTable* table, HwmonRole role)
+{
+    int index = table->roles[role];
+    return index >= 0 ? &table->sensors[index] : NULL;
+}
@@ -0,0 +1,159 @@
+/**
+ * @file instrumentation.c
+ * @brief Functions for the histograms the monitor keeps about itself.
+ * @author 1v6n
+ * @date 15/10/2026
+ */
+
+#include "instrumentation.h"
+#include "expose_metrics.h"
+
+#define NS_PER_SECOND 1e9 /**< Nanoseconds in a second. */
+
+static const char* collector_label_keys[] = {"collector"}; /**< Label keys of the collector histogram. */
+static bool native_histograms;                             /**< Whether the histograms are native. */
+
+static prom_histogram_t* collector_duration; /**< Duration of every collector run. */
+static prom_histogram_t* scrape_render;      /**< Time spent rendering and compressing a scrape. */
+static prom_histogram_t* scrape_send;        /**< Time spent sending a scrape. */
+static prom_histogram_t* scrape_bytes;       /**< Size of a scrape body. */
+static prom_histogram_t* scrape_allocations; /**< Allocations made by the library while rendering a scrape. */
+static prom_counter_t* scrape_aborted;       /**< Scrapes not sent completely. */
+
+static prom_metric_sample_histogram_t* collector_samples[MAX_COLLECTORS]; /**< Series of every collector. */
+static prom_metric_sample_histogram_t* render_sample;                     /**< Series of scrape_render. */
+static prom_metric_sample_histogram_t* send_sample;                       /**< Series of scrape_send. */
+static prom_metric_sample_histogram_t* bytes_sample;                      /**< Series of scrape_bytes. */
+static prom_metric_sample_histogram_t* allocations_sample;                /**< Series of scrape_allocations. */
+static prom_metric_sample_t* aborted_sample;                              /**< Series of scrape_aborted. */
+
+/**
+ * @brief Creates a sharded histogram with exponential buckets, or a native one if native_histograms is set.
+ *
+ * @param start Upper bound of the first bucket.
+ * @param factor Ratio between two buckets.
+ * @param count Number of buckets.
+ * @return The histogram, or NULL in case of error.
+ */
+static prom_histogram_t* create_histogram(const char* name, const char* help, double start, double factor,
+                                          size_t count, size_t label_count, const char** label_keys)
+{
+    if (native_histograms)
+    {
+        return prom_histogram_new_native(name, help, INSTRUMENTATION_NATIVE_SCHEMA, 0, label_count, label_keys);
+    }
+    return prom_histogram_new_sharded(name, help, prom_histogram_buckets_exponential(start, factor, count),
+                                      label_count, label_keys);
+}
+
+/**
+ * @brief Creates and registers a histogram without labels.
+ *
+ * @param sample Set to the only series of the histogram.
+ * @return The histogram, or NULL in case of error.
+ */
+static prom_histogram_t* new_histogram(const char* name, const char* help, double start, double factor, size_t count,
+                                       prom_metric_sample_histogram_t** sample)
+{
+    prom_histogram_t* histogram = create_histogram(name, help, start, factor, count, 0, NULL);
+    if (histogram == NULL || prom_collector_registry_register_metric((prom_metric_t*)histogram) != 0)
+    {
+        fprintf(stderr, "Error creating the %s histogram\n", name);
+        return NULL;
+    }
+    *sample = prom_metric_sample_histogram_from_labels((prom_metric_t*)histogram, NULL);
+    return *sample != NULL ? histogram : NULL;
+}
+
+static void observe_render(uint64_t render_ns, size_t bytes, unsigned long long allocations, void* arg)
+{
+    (void)arg;
+    TRACE_RECORD(TRACE_SCRAPE_RENDER, NULL, trace_now_ns() - render_ns, render_ns, bytes);
+    prom_metric_sample_histogram_observe(render_sample, (double)render_ns / NS_PER_SECOND);
+    prom_metric_sample_histogram_observe(bytes_sample, (double)bytes);
+    prom_metric_sample_histogram_observe(allocations_sample, (double)allocations);
+}
+
+static void observe_send(uint64_t send_ns, bool completed, void* arg)
+{
+    (void)arg;
+    TRACE_RECORD(TRACE_SCRAPE_SEND, NULL, trace_now_ns() - send_ns, send_ns, completed);
+    if (completed)
+    {
+        prom_metric_sample_histogram_observe(send_sample, (double)send_ns / NS_PER_SECOND);
+    }
+    else
+    {
+        prom_metric_sample_add(aborted_sample, 1.0);
+    }
+}
+
+int instrumentation_init(void)
+{
+    const char* native_env = getenv(INSTRUMENTATION_NATIVE_ENV);
+    native_histograms = native_env != NULL && strcmp(native_env, "1") == 0;
+    if (native_env != NULL && *native_env != '\0' && !native_histograms)
+    {
+        fprintf(stderr, "Invalid %s '%s', histograms keep fixed buckets\n", INSTRUMENTATION_NATIVE_ENV, native_env);
+    }
+
+    collector_duration = create_histogram("monitor_collector_duration_seconds", "Time taken by every collector run",
+                                          INSTRUMENTATION_LATENCY_START, INSTRUMENTATION_LATENCY_FACTOR,
+                                          INSTRUMENTATION_LATENCY_BUCKETS, 1, collector_label_keys);
+    if (collector_duration == NULL || prom_collector_registry_register_metric((prom_metric_t*)collector_duration) != 0)
+    {
+        fprintf(stderr, "Error creating the monitor_collector_duration_seconds histogram\n");
+        return RETURN_ERROR;
+    }
+
+    // Every series is created up front, so that a run only finds its sample by index
+    for (size_t i = 0; i < MAX_COLLECTORS && all_collectors[i].name != NULL; i++)
+    {
+        const char* label_values[] = {all_collectors[i].name};
+        collector_samples[i] =
+            prom_metric_sample_histogram_from_labels((prom_metric_t*)collector_duration, label_values);
+    }
+
+    scrape_render = new_histogram("monitor_scrape_render_seconds", "Time taken to render and compress a scrape",
+                                  INSTRUMENTATION_LATENCY_START, INSTRUMENTATION_LATENCY_FACTOR,
+                                  INSTRUMENTATION_LATENCY_BUCKETS, &render_sample);
+    scrape_send = new_histogram("monitor_scrape_send_seconds", "Time taken to send a scrape to the client",
+                                INSTRUMENTATION_LATENCY_START, INSTRUMENTATION_LATENCY_FACTOR,
+                                INSTRUMENTATION_LATENCY_BUCKETS, &send_sample);
+    scrape_bytes = new_histogram("monitor_scrape_bytes", "Size of a scrape body in bytes, after compression",
+                                 INSTRUMENTATION_BYTES_START, INSTRUMENTATION_BYTES_FACTOR,
+                                 INSTRUMENTATION_BYTES_BUCKETS, &bytes_sample);
+    scrape_allocations = new_histogram("monitor_scrape_allocations", "Allocations made to render a scrape",
+                                       INSTRUMENTATION_ALLOCS_START, INSTRUMENTATION_ALLOCS_FACTOR,
+                                       INSTRUMENTATION_ALLOCS_BUCKETS, &allocations_sample);
+    scrape_aborted = prom_counter_new("monitor_scrape_aborted_total", "Scrapes not sent completely", 0, NULL);
+    if (scrape_aborted != NULL && prom_collector_registry_register_metric((prom_metric_t*)scrape_aborted) == 0)
+    {
+        aborted_sample = prom_metric_sample_from_labels((prom_metric_t*)scrape_aborted, NULL);
+    }
+    if (scrape_render == NULL || scrape_send == NULL || scrape_bytes == NULL || scrape_allocations == NULL ||
+        aborted_sample == NULL)
+    {
+        fprintf(stderr, "Error creating the scrape instrumentation, scrapes are not observed\n");
+        return RETURN_ERROR;
+    }
+
+    promhttp_observer_t observer = {.rendered = observe_render, .sent = observe_send, .arg = NULL};
+    promhttp_set_observer(&observer);
+    return 0;
+}
+
+void instrumentation_record_collector(void (*update_function)(void), uint64_t duration_ns)
+{
+    for (size_t i = 0; i < MAX_COLLECTORS && all_collectors[i].name != NULL; i++)
+    {
+        if (all_collectors[i].update_function == update_function)
+        {
+            if (collector_samples[i] != NULL)
+            {
+                prom_metric_sample_histogram_observe(collector_samples[i], (double)duration_ns / NS_PER_SECOND);
+            }
+            return;
+        }
+    }
+}
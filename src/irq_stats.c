@@ -0,0 +1,490 @@
+/**
+ * @file irq_stats.c
+ * @brief Functions for reading the per-CPU interrupt and softirq counts and the paging counters of /proc/vmstat.
+ * @author 1v6n
+ * @date 15/10/2026
+ */
+
+#include "irq_stats.h"
+#include "metrics.h"
+#include "source_cache.h"
+#include "sysroot.h"
+#include <prom_procfs.h>
+
+#define IRQ_CPU_PREFIX "CPU" /**< Prefix of every column of the header. */
+
+static const char* const vmstat_names[VMSTAT_FIELD_COUNT] = {
+    "pgfault", "pgmajfault", "pswpin", "pswpout", "oom_kill",
+}; /**< Names of the counters in /proc/vmstat, indexed by VmstatField. */
+
+/**
+ * @brief Reallocates the rows of counts and samples for a number of lines and CPU slots, keeping the valid lines.
+ *
+ * @return 0 on success, or -1 if the rows cannot be allocated, in which case the matrix is unchanged.
+ */
+static int resize_rows(IrqMatrix* matrix, size_t capacity, size_t slots)
+{
+    uint64_t* counts = calloc(capacity * slots, sizeof(*counts));
+    prom_metric_sample_t** samples = calloc(capacity * slots, sizeof(*samples));
+    if (counts == NULL || samples == NULL)
+    {
+        perror("calloc");
+        free(counts);
+        free(samples);
+        return RETURN_ERROR;
+    }
+
+    for (size_t l = 0; l < matrix->line_count; l++)
+    {
+        memcpy(&counts[l * slots], &matrix->counts[l * matrix->cpu_slots], matrix->cpu_slots * sizeof(*counts));
+        memcpy(&samples[l * slots], &matrix->samples[l * matrix->cpu_slots], matrix->cpu_slots * sizeof(*samples));
+    }
+    free(matrix->counts);
+    free(matrix->samples);
+    matrix->counts = counts;
+    matrix->samples = samples;
+    return 0;
+}
+
+/**
+ * @brief Makes room in every row for the CPU slots up to a given one, labelling the new slots.
+ *
+ * @return 0 on success, or -1 if the matrix cannot grow.
+ */
+static int reserve_cpu_slots(IrqMatrix* matrix, size_t slots)
+{
+    if (slots <= matrix->cpu_slots)
+    {
+        return 0;
+    }
+
+    char(*labels)[IRQ_LABEL_SIZE] = realloc(matrix->cpu_labels, slots * sizeof(*labels));
+    if (labels == NULL)
+    {
+        perror("realloc");
+        return RETURN_ERROR;
+    }
+    matrix->cpu_labels = labels;
+    if (matrix->line_capacity > 0 && resize_rows(matrix, matrix->line_capacity, slots) != 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    for (size_t c = matrix->cpu_slots; c < slots; c++)
+    {
+        snprintf(labels[c], sizeof(labels[c]), "%zu", c);
+    }
+    matrix->cpu_slots = slots;
+    return 0;
+}
+
+/**
+ * @brief Parses the header naming the CPU of every column.
+ *
+ * @return 0 on success, or -1 if the header is malformed or the matrix cannot grow.
+ */
+static int parse_header(IrqMatrix* matrix, const char* p, const char* end)
+{
+    size_t count = 0;
+    size_t slots = 0;
+    for (;;)
+    {
+        while (p < end && (*p == ' ' || *p == '\t'))
+        {
+            p++;
+        }
+        if (p == end)
+        {
+            break;
+        }
+        if ((size_t)(end - p) <= strlen(IRQ_CPU_PREFIX) || strncmp(p, IRQ_CPU_PREFIX, strlen(IRQ_CPU_PREFIX)) != 0)
+        {
+            return RETURN_ERROR;
+        }
+        p += strlen(IRQ_CPU_PREFIX);
+        if (*p < '0' || *p > '9')
+        {
+            return RETURN_ERROR;
+        }
+        uint64_t cpu = prom_procfs_parse_u64(&p, end);
+        if (cpu >= INT_MAX)
+        {
+            return RETURN_ERROR;
+        }
+
+        if (count == matrix->column_capacity)
+        {
+            size_t capacity = matrix->column_capacity ? matrix->column_capacity * 2 : 16;
+            int* columns = realloc(matrix->columns, capacity * sizeof(*columns));
+            if (columns == NULL)
+            {
+                perror("realloc");
+                return RETURN_ERROR;
+            }
+            matrix->columns = columns;
+
+            uint64_t* values = realloc(matrix->values, capacity * sizeof(*values));
+            if (values == NULL)
+            {
+                perror("realloc");
+                return RETURN_ERROR;
+            }
+            matrix->values = values;
+            matrix->column_capacity = capacity;
+        }
+        matrix->columns[count++] = (int)cpu;
+        if (cpu + 1 > slots)
+        {
+            slots = cpu + 1;
+        }
+    }
+
+    if (count == 0 || reserve_cpu_slots(matrix, slots) != 0)
+    {
+        return RETURN_ERROR;
+    }
+    matrix->column_count = count;
+    return 0;
+}
+
+/**
+ * @brief Drops the lines that the previous read did not list and that the caller no longer exports, then marks the
+ *        others as not yet listed by the read to come.
+ */
+static void compact_lines(IrqMatrix* matrix)
+{
+    size_t kept = 0;
+    for (size_t l = 0; l < matrix->line_count; l++)
+    {
+        IrqLine* line = &matrix->lines[l];
+        if (!line->seen && !line->reported)
+        {
+            continue;
+        }
+
+        if (kept != l)
+        {
+            matrix->lines[kept] = *line;
+            memcpy(&matrix->counts[kept * matrix->cpu_slots], &matrix->counts[l * matrix->cpu_slots],
+                   matrix->cpu_slots * sizeof(*matrix->counts));
+            memcpy(&matrix->samples[kept * matrix->cpu_slots], &matrix->samples[l * matrix->cpu_slots],
+                   matrix->cpu_slots * sizeof(*matrix->samples));
+        }
+        matrix->lines[kept++].seen = false;
+    }
+    matrix->line_count = kept;
+}
+
+/**
+ * @brief Appends a line with no counts and no sample handles.
+ *
+ * @return The line, or NULL if the matrix cannot grow.
+ */
+static IrqLine* append_line(IrqMatrix* matrix)
+{
+    if (matrix->line_count == matrix->line_capacity)
+    {
+        size_t capacity = matrix->line_capacity ? matrix->line_capacity * 2 : 16;
+        IrqLine* lines = realloc(matrix->lines, capacity * sizeof(*lines));
+        if (lines == NULL)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        matrix->lines = lines;
+
+        uint64_t* ranks = realloc(matrix->ranks, capacity * sizeof(*ranks));
+        if (ranks == NULL)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        matrix->ranks = ranks;
+
+        if (resize_rows(matrix, capacity, matrix->cpu_slots) != 0)
+        {
+            return NULL;
+        }
+        matrix->line_capacity = capacity;
+    }
+
+    size_t index = matrix->line_count++;
+    memset(&matrix->counts[index * matrix->cpu_slots], 0, matrix->cpu_slots * sizeof(*matrix->counts));
+    memset(&matrix->samples[index * matrix->cpu_slots], 0, matrix->cpu_slots * sizeof(*matrix->samples));
+    IrqLine* line = &matrix->lines[index];
+    memset(line, 0, sizeof(*line));
+    return line;
+}
+
+/**
+ * @brief Checks whether a line has the given name and device, as truncated to fit the line.
+ */
+static bool line_matches(const IrqLine* line, const char* name, size_t name_len, const char* device,
+                         size_t device_len)
+{
+    return strncmp(line->name, name, name_len) == 0 && line->name[name_len] == '\0' &&
+           strncmp(line->device, device, device_len) == 0 && line->device[device_len] == '\0';
+}
+
+/**
+ * @brief Returns the index of the line with the given name and device, appending it if the matrix has none.
+ *
+ * The lines are listed in the same order on every read, so the line after the previous match is tried first.
+ *
+ * @param hint Pointer to the index to try first, advanced past the line returned.
+ * @return The index, or -1 if the matrix cannot grow.
+ */
+static long find_line(IrqMatrix* matrix, const char* name, size_t name_len, const char* device, size_t device_len,
+                      size_t* hint)
+{
+    size_t index = *hint;
+    if (index >= matrix->line_count || !line_matches(&matrix->lines[index], name, name_len, device, device_len))
+    {
+        for (index = 0; index < matrix->line_count; index++)
+        {
+            if (line_matches(&matrix->lines[index], name, name_len, device, device_len))
+            {
+                break;
+            }
+        }
+    }
+
+    if (index == matrix->line_count)
+    {
+        IrqLine* line = append_line(matrix);
+        if (line == NULL)
+        {
+            return RETURN_ERROR;
+        }
+        memcpy(line->name, name, name_len);
+        memcpy(line->device, device, device_len);
+    }
+    *hint = index + 1;
+    return (long)index;
+}
+
+/**
+ * @brief Parses one line of counts into its row.
+ *
+ * The device is what follows the last run of two blanks: the kernel prints the handlers of a numbered line after the
+ * chip and trigger, and the description of a named one, that way.
+ *
+ * @return 0 on success, or -1 if the line is malformed or the matrix cannot grow.
+ */
+static int parse_line(IrqMatrix* matrix, const char* p, const char* end, size_t* hint)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    if (p == end)
+    {
+        return 0;
+    }
+
+    const char* colon = memchr(p, ':', (size_t)(end - p));
+    if (colon == NULL || colon == p || (size_t)(colon - p) >= IRQ_NAME_SIZE)
+    {
+        return RETURN_ERROR;
+    }
+    const char* name = p;
+    size_t name_len = (size_t)(colon - p);
+
+    // ERR and MIS hold a single count for every CPU, so they are not part of the matrix
+    p = colon + 1;
+    if (prom_procfs_parse_u64s(&p, end, matrix->values, matrix->column_count) < matrix->column_count)
+    {
+        return 0;
+    }
+
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    const char* device_end = end;
+    while (device_end > p && (device_end[-1] == ' ' || device_end[-1] == '\t'))
+    {
+        device_end--;
+    }
+    const char* device = p;
+    for (const char* s = p; s + 1 < device_end; s++)
+    {
+        if (s[0] == ' ' && s[1] == ' ')
+        {
+            device = s + 2;
+        }
+    }
+    size_t device_len = (size_t)(device_end - device);
+    if (device_len >= IRQ_DEVICE_SIZE)
+    {
+        device_len = IRQ_DEVICE_SIZE - 1;
+    }
+
+    long index = find_line(matrix, name, name_len, device, device_len, hint);
+    if (index < 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    IrqLine* line = &matrix->lines[index];
+    uint64_t* row = &matrix->counts[(size_t)index * matrix->cpu_slots];
+    line->total = 0;
+    for (size_t c = 0; c < matrix->column_count; c++)
+    {
+        row[matrix->columns[c]] = matrix->values[c];
+        line->total += matrix->values[c];
+    }
+    line->seen = true;
+    return 0;
+}
+
+/**
+ * @brief Orders totals from the largest down.
+ */
+static int compare_ranks(const void* a, const void* b)
+{
+    uint64_t left = *(const uint64_t*)a;
+    uint64_t right = *(const uint64_t*)b;
+    return (left < right) - (left > right);
+}
+
+/**
+ * @brief Selects the listed lines with the largest totals; ties are broken in the order of the lines.
+ */
+static void select_lines(IrqMatrix* matrix, size_t top)
+{
+    size_t listed = 0;
+    for (size_t l = 0; l < matrix->line_count; l++)
+    {
+        if (matrix->lines[l].seen)
+        {
+            matrix->ranks[listed++] = matrix->lines[l].total;
+        }
+    }
+
+    if (top == 0 || listed <= top)
+    {
+        for (size_t l = 0; l < matrix->line_count; l++)
+        {
+            matrix->lines[l].selected = matrix->lines[l].seen;
+        }
+        return;
+    }
+
+    qsort(matrix->ranks, listed, sizeof(*matrix->ranks), compare_ranks);
+    uint64_t threshold = matrix->ranks[top - 1];
+    size_t ties = 0;
+    for (size_t r = 0; r < top; r++)
+    {
+        ties += matrix->ranks[r] == threshold;
+    }
+
+    for (size_t l = 0; l < matrix->line_count; l++)
+    {
+        IrqLine* line = &matrix->lines[l];
+        line->selected = line->seen && (line->total > threshold || (line->total == threshold && ties > 0));
+        if (line->selected && line->total == threshold)
+        {
+            ties--;
+        }
+    }
+}
+
+int irq_matrix_read(IrqMatrix* matrix, size_t top)
+{
+    if (matrix->unavailable)
+    {
+        return RETURN_ERROR;
+    }
+
+    size_t len = 0;
+    const char* buffer = source_cache_read(matrix->path, &len);
+    if (buffer == NULL)
+    {
+        // Sandboxed kernels, such as gVisor, may not provide the file
+        char path[PATH_MAX];
+        const char* resolved = sysroot_path(matrix->path, path, sizeof(path));
+        matrix->unavailable = resolved == NULL || access(resolved, F_OK) != 0;
+        return RETURN_ERROR;
+    }
+
+    const char* end = buffer + len;
+    const char* line_end = memchr(buffer, '\n', len);
+    if (line_end == NULL || parse_header(matrix, buffer, line_end) != 0)
+    {
+        fprintf(stderr, "Error parsing %s: unsupported format\n", matrix->path);
+        return RETURN_ERROR;
+    }
+
+    compact_lines(matrix);
+    size_t hint = 0;
+    for (const char* p = line_end + 1; p < end; p = line_end + 1)
+    {
+        line_end = memchr(p, '\n', (size_t)(end - p));
+        if (line_end == NULL)
+        {
+            line_end = end;
+        }
+        if (parse_line(matrix, p, line_end, &hint) != 0)
+        {
+            fprintf(stderr, "Error parsing %s\n", matrix->path);
+            return RETURN_ERROR;
+        }
+    }
+
+    select_lines(matrix, top);
+    return 0;
+}
+
+void irq_matrix_free(IrqMatrix* matrix)
+{
+    free(matrix->lines);
+    free(matrix->cpu_labels);
+    free(matrix->counts);
+    free(matrix->samples);
+    free(matrix->columns);
+    free(matrix->values);
+    free(matrix->ranks);
+    *matrix = (IrqMatrix){.path = matrix->path};
+}
+
+int read_vmstat_snapshot(VmstatSnapshot* snapshot)
+{
+    size_t len = 0;
+    const char* buffer = source_cache_read(VMSTAT_PATH, &len);
+    if (buffer == NULL)
+    {
+        return RETURN_ERROR;
+    }
+
+    memset(snapshot->present, 0, sizeof(snapshot->present));
+    const char* end = buffer + len;
+    for (const char* p = buffer; p < end;)
+    {
+        const char* space = memchr(p, ' ', (size_t)(end - p));
+        if (space == NULL)
+        {
+            break;
+        }
+
+        size_t name_len = (size_t)(space - p);
+        for (int f = 0; f < VMSTAT_FIELD_COUNT; f++)
+        {
+            if (strlen(vmstat_names[f]) == name_len && memcmp(p, vmstat_names[f], name_len) == 0)
+            {
+                p = space;
+                snapshot->values[f] = prom_procfs_parse_u64(&p, end);
+                snapshot->present[f] = true;
+                break;
+            }
+        }
+
+        const char* next = memchr(p, '\n', (size_t)(end - p));
+        if (next == NULL)
+        {
+            break;
+        }
+        p = next + 1;
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file json_writer.c
+ * @brief Functions for writing JSON bodies into a fixed buffer.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "json_writer.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+void json_append(JsonWriter* writer, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    bool fits = writer->len < writer->size;
+    int n = vsnprintf(fits ? writer->buf + writer->len : NULL, fits ? writer->size - writer->len : 0, format, args);
+    va_end(args);
+    if (n > 0)
+    {
+        writer->len += (size_t)n;
+    }
+}
+
+void json_string(JsonWriter* writer, const char* value)
+{
+    json_append(writer, "\"");
+    while (*value != '\0')
+    {
+        size_t run = 0;
+        while (value[run] != '\0' && value[run] != '"' && value[run] != '\\' && (unsigned char)value[run] >= 0x20)
+        {
+            run++;
+        }
+        if (run > 0)
+        {
+            json_append(writer, "%.*s", (int)run, value);
+            value += run;
+            continue;
+        }
+
+        unsigned char c = (unsigned char)*value++;
+        if (c == '"' || c == '\\')
+        {
+            json_append(writer, "\\%c", c);
+        }
+        else
+        {
+            json_append(writer, "\\u%04x", c);
+        }
+    }
+    json_append(writer, "\"");
+}
@@ -1,120 +1,17 @@
 /**
  * @file main.c
- * @brief Entry point of the system. This file contains the main functionality for starting Prometheus and Grafana,
- * initializing and exposing system metrics.
+ * @brief Entry point of the system. This file contains the main functionality for initializing and exposing system
+ * metrics; Prometheus and Grafana are started as companions, see companion.h.
  * @author 1v6n
  * @date 09/10/2024
  */
 
+#include "control.h"
+#include "dispatch.h"
 #include "expose_metrics.h"
 #include "metrics.h"
-#define FIFO_PATH "/tmp/monitor_fifo"
-#define BUFFER_SIZE 256
-#define MAX_METRICS 10
-#define STATUS_FILE "/tmp/monitor_status"
-
-#include <ctype.h>
-#include <fcntl.h>
-#include <sys/stat.h>
-
-// Function to trim leading and trailing whitespace
-char* trim_whitespace(char* str)
-{
-    char* end;
-
-    while (isspace((unsigned char)*str))
-        str++;
-
-    if (*str == 0)
-        return str;
-
-    end = str + strlen(str) - 1;
-    while (end > str && isspace((unsigned char)*end))
-        end--;
-
-    end[1] = '\0';
-
-    return str;
-}
-
-// Function to update the status file
-void update_status(const char* status)
-{
-    FILE* file = fopen(STATUS_FILE, "w");
-    if (file == NULL)
-    {
-        perror("fopen");
-        return;
-    }
-    fprintf(file, "%s\n", status);
-    fclose(file);
-}
-
-/**
- * @brief Get the home directory of the current user.
- *
- * This function retrieves the home directory of the user running the program by using the `getpwuid()` function.
- *
- * @return A pointer to a string representing the home directory path of the current user. Returns `NULL` on failure.
- */
-char* get_home_directory()
-{
-    struct passwd* pw = getpwuid(getuid());
-    return pw ? pw->pw_dir : NULL;
-}
-
-/**
- * @brief Start the Grafana server.
- *
- * Constructs the command to launch the Grafana server with the appropriate configuration and home path.
- * The server is started as a background process using the `system()` function.
- */
-void start_grafana()
-{
-    char* home_dir = get_home_directory();
-    if (home_dir == NULL)
-    {
-        fprintf(stderr, "Failed to retrieve home directory\n");
-        return;
-    }
-
-    char command[COMMAND_SIZE];
-    snprintf(command, sizeof(command),
-             "%s/grafana/bin/grafana server --config %s/grafana/conf/defaults.ini --homepath %s/grafana &", home_dir,
-             home_dir, home_dir);
-
-    int ret = system(command);
-    if (ret == RETURN_ERROR)
-    {
-        fprintf(stderr, "Failed to start Grafana\n");
-    }
-    else
-    {
-        printf("Grafana started successfully\n");
-    }
-}
-
-/**
- * @brief Starts the Prometheus server.
- *
- * This function uses the `system()` call to start the Prometheus server in the background.
- */
-void start_prometheus()
-{
-    const char* home_dir = getenv("HOME");
-    if (home_dir == NULL)
-    {
-        fprintf(stderr, "Error: HOME environment variable not set.\n");
-        return;
-    }
-
-    char prometheus_config_path[COMMAND_SIZE];
-    snprintf(prometheus_config_path, sizeof(prometheus_config_path), "%s/prometheus/prometheus.yml", home_dir);
-
-    char command[COMMAND_SIZE];
-    snprintf(command, sizeof(command), "%s/prometheus/prometheus --config.file=%s &", home_dir, prometheus_config_path);
-    system(command);
-}
+#include "scheduler.h"
+#include "status.h"
 
 /**
  * @brief Creates a new thread to expose metrics via an HTTP server.
@@ -129,160 +26,115 @@ void create_threads(void)
     if (pthread_create(&tid, NULL, expose_metrics, NULL) != 0)
     {
         fprintf(stderr, "Error creating HTTP server thread\n");
-        update_status("Error creating HTTP server thread");
+        status_set("Error creating HTTP server thread");
         return EXIT_FAILURE;
     }
 }
 
-void start_metrics_monitoring(const char* selected_metrics[], size_t num_metrics)
-{
-    init_metrics(selected_metrics, num_metrics);
-
-    create_threads();
-
-    void (*update_functions[num_metrics])(void);
-
-    for (size_t i = 0; i < num_metrics; i++)
-    {
-        const char* metric_name = selected_metrics[i];
-        update_functions[i] = NULL; // Initialize to NULL
-
-        printf("Processing metric: '%s'\n", metric_name);
-
-        for (MetricInfo* info = all_metrics; info->name != NULL; info++)
-        {
-
-            if (strcmp(metric_name, info->name) == 0)
-            {
-                update_functions[i] = info->update_function;
-                break;
-            }
-        }
-        if (update_functions[i] == NULL)
-        {
-            char status_message[BUFFER_SIZE];
-            snprintf(status_message, sizeof(status_message), "Error: No update function found for metric '%s'",
-                     metric_name);
-            update_status(status_message);
-            fprintf(stderr, "%s\n", status_message);
-            fprintf(stderr, "Error: No update function found for metric '%s'\n", metric_name);
-            return;
-        }
-    }
-
-    update_status("Metrics monitoring started");
-
-    while (true)
-    {
-        for (size_t i = 0; i < num_metrics; i++)
-        {
-            if (update_functions[i] != NULL)
-            {
-                update_functions[i]();
-            }
-            else
-            {
-                fprintf(stderr, "Error: update_functions[%zu] is NULL\n", i);
-            }
-        }
-        sleep(SLEEP_TIME);
-    }
-}
-
 /**
- * @brief Parses a comma-separated string into an array of metric names.
+ * @brief Records a collector run for /status, folds the gauges it updated into their rollups and derives the rates of
+ * the counters it updated.
  *
- * @param input The input string containing metric names separated by commas.
- * @param output Array to store parsed metric names.
- * @param max_metrics Maximum number of metrics to parse.
- * @return The number of parsed metrics.
+ * @param update_function The collector that ran.
+ * @param started CLOCK_REALTIME start time of the run.
+ * @param duration_ns Duration of the run in nanoseconds.
  */
-size_t parse_metrics(const char* input, const char* output[], size_t max_metrics)
+static void record_collector_run(collector_fn update_function, const struct timespec* started, uint64_t duration_ns)
 {
-    size_t count = 0;
-    char* token;
-    char* input_copy = strdup(input);
-
-    token = strtok(input_copy, ",");
-    while (token != NULL && count < max_metrics)
-    {
-        char* trimmed_token = strdup(token);
-        output[count++] = strdup(trim_whitespace(trimmed_token)); // Store each trimmed metric name
-        free(trimmed_token);
-        token = strtok(NULL, ",");
-    }
-
-    free(input_copy);
-    return count;
+    status_record_run(update_function, started, duration_ns);
+    instrumentation_record_collector(update_function, duration_ns);
+    TRACE_RECORD(TRACE_COLLECTOR, update_function,
+                 (uint64_t)started->tv_sec * 1000000000ULL + (uint64_t)started->tv_nsec, duration_ns, 0);
+    update_rollups(update_function);
+    update_rates(update_function);
 }
 
 /**
- * @brief Reads metrics from a FIFO and starts monitoring.
+ * @brief Starts the collector scheduler and runs it with the metrics selected through the control FIFO.
+ *
+ * The HTTP endpoint is up before anything else is started, and the default selection of control.h is applied as soon as
+ * the scheduler runs, so that a restarted monitor is scraped with data within a few ticks rather than once a client
+ * writes to the FIFO. The control channel stays open while monitoring runs, so that metrics can be added, removed or
+ * collected at another interval without restarting the process and losing the state of the collectors.
+ * Metrics that share a collector (for example, all of the network counters) are grouped so that every collector runs
+ * once per interval, at the shortest interval of the metrics it serves, on the collector worker pool.
  *
- * This function opens and reads from a FIFO. The read data is parsed into
- * an array of metric names and used to start metric monitoring.
+ * The threads are placed and their priorities lowered as configured, see placement.h. With LAZY_COLLECTION_ENV set,
+ * the metric collectors only run when a scrape finds their metrics older than their interval.
  */
-void start_monitoring_from_fifo()
+void start_metrics_monitoring(void)
 {
-    if (mkfifo(FIFO_PATH, 0666) == -1 && errno != EEXIST)
+    // Placed before anything is allocated or started, so that every thread but the HTTP ones inherits it
+    placement_init();
+    placement_apply(PLACEMENT_COLLECTOR);
+    init_metrics(NULL, 0);
+
+    status_add_endpoints();
+    create_threads();
+
+    WorkerPool pool;
+    if (worker_pool_init(&pool) != 0)
     {
-        perror("mkfifo");
-        exit(EXIT_FAILURE);
+        status_set("Error: could not start the collector workers");
+        stop_export_collectors();
+        return;
     }
+    set_collector_pool(&pool);
 
-    FILE* fifo_file = fopen(FIFO_PATH, "r");
-    if (fifo_file == NULL)
+    CollectorDispatch dispatch;
+    dispatch_init(&dispatch);
+
+    Scheduler scheduler;
+    if (scheduler_init(&scheduler, &dispatch, &pool, report_collector_timeout, record_collector_run) != 0)
     {
-        perror("fopen");
-        exit(EXIT_FAILURE);
+        status_set("Error: could not start the collector scheduler");
+        set_collector_pool(NULL);
+        worker_pool_destroy(&pool);
+        stop_export_collectors();
+        return;
     }
 
-    char buffer[BUFFER_SIZE];
-    size_t bytesRead = fread(buffer, sizeof(char), sizeof(buffer) - 1, fifo_file);
-    if (bytesRead > 0)
-    {
-        buffer[bytesRead] = '\0';
+    init_adaptive_sampling(&scheduler);
+    init_lazy_collection(&scheduler);
 
-        const char* selected_metrics[MAX_METRICS];
-        size_t num_metrics = parse_metrics(buffer, selected_metrics, MAX_METRICS);
+    ControlChannel control;
+    if (control_channel_open(&control, CONTROL_FIFO_PATH, &scheduler, status_set) != 0)
+    {
+        status_set("Error: could not open the control FIFO");
+        stop_lazy_collection();
+        scheduler_destroy(&scheduler);
+        set_collector_pool(NULL);
+        worker_pool_destroy(&pool);
+        stop_export_collectors();
+        return;
+    }
 
-        // Check if the first value is "1"
-        if (num_metrics > 0 && strcmp(selected_metrics[0], "1") == 0)
-        {
-            show_available_metrics();
-            for (size_t i = 0; i < num_metrics; i++)
-            {
-                free((char*)selected_metrics[i]);
-            }
-            fclose(fifo_file);
-            unlink(FIFO_PATH);
-            return;
-        }
+    const char* default_metrics = getenv(CONTROL_DEFAULT_ENV);
+    control_channel_select_default(&control, default_metrics != NULL ? default_metrics : CONTROL_DEFAULT_METRICS);
 
-        if (num_metrics > 0)
-        {
-            start_metrics_monitoring(selected_metrics, num_metrics);
-        }
-        for (size_t i = 0; i < num_metrics; i++)
+    while (true)
+    {
+        if (scheduler_run_once(&scheduler) != 0)
         {
-            free((char*)selected_metrics[i]);
+            break;
         }
     }
-    else
-    {
-        perror("fread");
-    }
 
-    fclose(fifo_file);
-    unlink(FIFO_PATH);
+    control_channel_close(&control);
+    stop_lazy_collection();
+    scheduler_destroy(&scheduler);
+    set_collector_pool(NULL);
+    worker_pool_destroy(&pool);
+    stop_export_collectors();
+    status_set("Error: collector scheduler stopped");
 }
 
 /**
  * @brief Main function of the system.
  *
- * The main function is responsible for starting both Prometheus and Grafana servers.
- * It also initializes system metrics and creates a thread to expose these metrics via an HTTP server.
- * The metrics are continuously updated every second in an infinite loop.
+ * The main function initializes system metrics, creates a thread to expose them via an HTTP server and collects them
+ * until the scheduler stops. The Prometheus and Grafana servers named by COMPANIONS_ENV are started once the HTTP
+ * server is up.
  *
  * @param argc The argument count.
  * @param argv The argument vector.
@@ -290,10 +142,7 @@ void start_monitoring_from_fifo()
  */
 int main(int argc, char* argv[])
 {
-    // start_grafana();
-    // start_prometheus();
-    // show_available_metrics();
-    update_status("Starting monitoring from FIFO");
-    start_monitoring_from_fifo();
+    status_set("Starting monitoring from FIFO");
+    start_metrics_monitoring();
     return EXIT_SUCCESS;
 }
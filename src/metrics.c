@@ -6,123 +6,364 @@
  * @date 09/10/2024
  */
 
+#define _GNU_SOURCE // Required for memrchr
+
 #include "metrics.h"
+#include "netlink_stats.h"
+#include "source_cache.h"
+#include "sysroot.h"
+#include <prom_procfs.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+/**
+ * @brief Directory entry layout returned by the getdents64 system call.
+ */
+struct linux_dirent64
+{
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/**
+ * @brief Tells whether a directory entry is a directory; file systems that leave d_type DT_UNKNOWN, which a sysroot
+ * may be on, are asked with fstatat().
+ */
+static bool is_directory(int dir_fd, const struct linux_dirent64* entry)
+{
+    if (entry->d_type != DT_UNKNOWN)
+    {
+        return entry->d_type == DT_DIR;
+    }
+
+    struct stat st;
+    return fstatat(dir_fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
 
-static double read_value(const char* path)
+/**
+ * @brief Maps a /proc/meminfo key to the MemInfoSnapshot field it fills.
+ */
+typedef struct
 {
-    FILE* fp = fopen(path, "r");
-    if (fp == NULL)
+    const char* key; /**< Key as it appears before the colon. */
+    size_t key_len;  /**< Length of the key. */
+    size_t offset;   /**< Offset of the field in MemInfoSnapshot. */
+} MemInfoField;
+
+#define MEMINFO_FIELD(key, field) {key, sizeof(key) - 1, offsetof(MemInfoSnapshot, field)}
+
+static const MemInfoField meminfo_fields[] = {
+    MEMINFO_FIELD("MemTotal", mem_total),
+    MEMINFO_FIELD("MemFree", mem_free),
+    MEMINFO_FIELD("MemAvailable", mem_available),
+    MEMINFO_FIELD("Buffers", buffers),
+    MEMINFO_FIELD("Cached", cached),
+    MEMINFO_FIELD("SwapTotal", swap_total),
+    MEMINFO_FIELD("SwapFree", swap_free),
+    MEMINFO_FIELD("Dirty", dirty),
+    MEMINFO_FIELD("Slab", slab),
+};
+
+#define MEMINFO_FIELD_COUNT (sizeof(meminfo_fields) / sizeof(meminfo_fields[0]))
+
+int read_meminfo_snapshot(MemInfoSnapshot* snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    size_t len;
+    const char* buffer = source_cache_read(PROC_MEMINFO_PATH, &len);
+    if (buffer == NULL)
     {
-        perror("Error opening file");
         return RETURN_ERROR;
     }
 
-    int value;
-    if (fscanf(fp, "%d", &value) != 1)
+    size_t found = 0;
+    const char* p = buffer;
+    const char* end = buffer + len;
+    while (p < end && found < MEMINFO_FIELD_COUNT)
     {
-        fprintf(stderr, "Error reading value from %s\n", path);
-        fclose(fp);
+        const char* colon = memchr(p, ':', (size_t)(end - p));
+        if (colon == NULL)
+        {
+            break;
+        }
+
+        size_t key_len = (size_t)(colon - p);
+        const MemInfoField* field = NULL;
+        for (size_t i = 0; i < MEMINFO_FIELD_COUNT; i++)
+        {
+            if (meminfo_fields[i].key_len == key_len && memcmp(meminfo_fields[i].key, p, key_len) == 0)
+            {
+                field = &meminfo_fields[i];
+                break;
+            }
+        }
+
+        p = colon + 1;
+        while (p < end && *p == ' ')
+        {
+            p++;
+        }
+
+        if (field != NULL)
+        {
+            *(unsigned long long*)((char*)snapshot + field->offset) = prom_procfs_parse_u64(&p, end);
+            found++;
+        }
+
+        const char* newline = memchr(p, '\n', (size_t)(end - p));
+        p = newline != NULL ? newline + 1 : end;
+    }
+
+    if (snapshot->mem_total == 0)
+    {
+        fprintf(stderr, "Error reading memory information from " PROC_MEMINFO_PATH "\n");
         return RETURN_ERROR;
     }
 
-    fclose(fp);
-    return value / UNIT_CONVERSION;
+    return 0;
+}
+
+double meminfo_usage_percentage(const MemInfoSnapshot* snapshot)
+{
+    // Container views and fixtures can report more available memory than the total
+    if (snapshot->mem_available >= snapshot->mem_total)
+    {
+        return 0.0;
+    }
+    double used_mem = (double)(snapshot->mem_total - snapshot->mem_available);
+    return (used_mem / (double)snapshot->mem_total) * PERCENTAGE;
+}
+
+double meminfo_used_mb(const MemInfoSnapshot* snapshot)
+{
+    // An inconsistent read can list more free, buffered and cached memory than the total; the difference must not wrap
+    unsigned long long unused = snapshot->mem_free + snapshot->buffers + snapshot->cached;
+    if (unused >= snapshot->mem_total)
+    {
+        return 0.0;
+    }
+    return (double)(snapshot->mem_total - unused) / CONVERT_TO_MB;
 }
 
 double get_memory_usage()
 {
-    FILE* fp = fopen(PROC_MEMINFO_PATH, "r");
-    if (fp == NULL)
+    MemInfoSnapshot snapshot;
+    if (read_meminfo_snapshot(&snapshot) != 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    return meminfo_usage_percentage(&snapshot);
+}
+
+/**
+ * @brief Parses the counters of a cpu line into a CpuTimes structure.
+ *
+ * @param p Pointer to the first counter of the line.
+ * @param end End of the buffer holding the line.
+ * @param times Pointer to store the parsed counters; counters missing from the line are set to 0.
+ */
+static void parse_cpu_times(const char* p, const char* end, CpuTimes* times)
+{
+    uint64_t fields[CPU_TIME_FIELDS] = {0};
+    prom_procfs_parse_u64s(&p, end, fields, CPU_TIME_FIELDS);
+    times->user = fields[0];
+    times->nice = fields[1];
+    times->system = fields[2];
+    times->idle = fields[3];
+    times->iowait = fields[4];
+    times->irq = fields[5];
+    times->softirq = fields[6];
+    times->steal = fields[7];
+    times->guest = fields[8];
+    times->guest_nice = fields[9];
+}
+
+/**
+ * @brief Checks whether a line starts with the given key followed by a space.
+ */
+static int line_has_key(const char* line, const char* key, size_t key_len)
+{
+    return strncmp(line, key, key_len) == 0 && line[key_len] == ' ';
+}
+
+int read_proc_stat_snapshot(ProcStatSnapshot* snapshot)
+{
+    size_t len;
+    const char* buffer = source_cache_read(PROC_STAT_PATH, &len);
+    if (buffer == NULL)
     {
-        perror("Error opening " PROC_MEMINFO_PATH);
         return RETURN_ERROR;
     }
+    const char* end = buffer + len;
 
-    char buffer[BUFFER_SIZE];
-    double total_mem = 0, free_mem = 0;
+    int have_total = 0;
+    snapshot->cpu_count = 0;
 
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    for (const char* line = buffer; *line != '\0';)
     {
-        if (sscanf(buffer, "MemTotal: %llu kB", &total_mem) == 1)
+        if (line[0] == 'c' && line[1] == 'p' && line[2] == 'u')
+        {
+            if (line[3] == ' ')
+            {
+                snapshot->total.cpu = -1;
+                parse_cpu_times(line + 3, end, &snapshot->total);
+                have_total = 1;
+            }
+            else if (line[3] >= '0' && line[3] <= '9')
+            {
+                if (snapshot->cpu_count == snapshot->cpu_capacity)
+                {
+                    size_t capacity = snapshot->cpu_capacity ? snapshot->cpu_capacity * 2 : 64;
+                    CpuTimes* cpus = realloc(snapshot->cpus, capacity * sizeof(*cpus));
+                    if (cpus == NULL)
+                    {
+                        perror("realloc");
+                        return RETURN_ERROR;
+                    }
+                    snapshot->cpus = cpus;
+                    snapshot->cpu_capacity = capacity;
+                }
+
+                const char* p = line + 3;
+                CpuTimes* times = &snapshot->cpus[snapshot->cpu_count++];
+                times->cpu = (int)prom_procfs_parse_u64(&p, end);
+                parse_cpu_times(p, end, times);
+            }
+        }
+        else if (line_has_key(line, "ctxt", 4))
+        {
+            const char* p = line + 4;
+            snapshot->ctxt = prom_procfs_parse_u64(&p, end);
+        }
+        else if (line_has_key(line, "intr", 4))
+        {
+            // Only the leading total is needed; the per-IRQ counters are skipped with the rest of the line
+            const char* p = line + 4;
+            snapshot->intr_total = prom_procfs_parse_u64(&p, end);
+        }
+        else if (line_has_key(line, "processes", 9))
+        {
+            const char* p = line + 9;
+            snapshot->processes = prom_procfs_parse_u64(&p, end);
+        }
+        else if (line_has_key(line, "procs_running", 13))
         {
-            continue;
+            const char* p = line + 13;
+            snapshot->procs_running = prom_procfs_parse_u64(&p, end);
         }
-        if (sscanf(buffer, "MemAvailable: %llu kB", &free_mem) == 1)
+        else if (line_has_key(line, "procs_blocked", 13))
+        {
+            const char* p = line + 13;
+            snapshot->procs_blocked = prom_procfs_parse_u64(&p, end);
+        }
+
+        const char* next = strchr(line, '\n');
+        if (next == NULL)
         {
             break;
         }
+        line = next + 1;
     }
 
-    fclose(fp);
-
-    if (total_mem == 0 || free_mem == 0)
+    if (!have_total)
     {
-        fprintf(stderr, "Error reading memory information from " PROC_MEMINFO_PATH "\n");
+        fprintf(stderr, "Error parsing " PROC_STAT_PATH "\n");
         return RETURN_ERROR;
     }
 
-    double used_mem = (total_mem - free_mem);
-    double mem_usage_percent = (used_mem / total_mem) * 100.0;
+    return 0;
+}
 
-    return mem_usage_percent;
+void proc_stat_snapshot_free(ProcStatSnapshot* snapshot)
+{
+    free(snapshot->cpus);
+    snapshot->cpus = NULL;
+    snapshot->cpu_count = 0;
+    snapshot->cpu_capacity = 0;
 }
 
-double get_cpu_usage()
+double cpu_times_usage_percentage(const CpuTimes* prev, const CpuTimes* cur)
 {
-    static double prev_user = 0, prev_nice = 0, prev_system = 0, prev_idle = 0, prev_iowait = 0, prev_irq = 0,
-                  prev_softirq = 0, prev_steal = 0;
-    double user, nice, system, idle, iowait, irq, softirq, steal;
+    // guest and guest_nice are already accounted for in user and nice
+    double prev_idle_total = (double)(prev->idle + prev->iowait);
+    double idle_total = (double)(cur->idle + cur->iowait);
+    double prev_non_idle =
+        (double)(prev->user + prev->nice + prev->system + prev->irq + prev->softirq + prev->steal);
+    double non_idle = (double)(cur->user + cur->nice + cur->system + cur->irq + cur->softirq + cur->steal);
+    double totald = (idle_total + non_idle) - (prev_idle_total + prev_non_idle);
+    double idled = idle_total - prev_idle_total;
 
-    FILE* fp = fopen(PROC_STAT_PATH, "r");
-    if (fp == NULL)
+    if (totald <= 0)
     {
-        perror("Error opening " PROC_STAT_PATH);
         return RETURN_ERROR;
     }
 
-    char buffer[BUFFER_SIZE * 4];
-    if (fgets(buffer, sizeof(buffer), fp) == NULL)
+    return ((totald - idled) / totald) * PERCENTAGE;
+}
+
+const char* const cpu_mode_names[CPU_MODE_COUNT] = {"user", "nice", "system", "idle",
+                                                     "iowait", "irq", "softirq", "steal"};
+
+int cpu_times_mode_percentages(const CpuTimes* prev, const CpuTimes* cur, double percentages[CPU_MODE_COUNT])
+{
+    const unsigned long long prev_modes[CPU_MODE_COUNT] = {prev->user,   prev->nice, prev->system,  prev->idle,
+                                                           prev->iowait, prev->irq,  prev->softirq, prev->steal};
+    const unsigned long long cur_modes[CPU_MODE_COUNT] = {cur->user,   cur->nice, cur->system,  cur->idle,
+                                                          cur->iowait, cur->irq,  cur->softirq, cur->steal};
+
+    unsigned long long deltas[CPU_MODE_COUNT];
+    unsigned long long totald = 0;
+    for (int i = 0; i < CPU_MODE_COUNT; i++)
     {
-        perror("Error reading " PROC_STAT_PATH);
-        fclose(fp);
-        return RETURN_ERROR;
+        // Counters of a CPU that went offline and came back may restart from a lower value
+        if (cur_modes[i] < prev_modes[i])
+        {
+            return RETURN_ERROR;
+        }
+        deltas[i] = cur_modes[i] - prev_modes[i];
+        totald += deltas[i];
     }
-    fclose(fp);
 
-    int ret = sscanf(buffer, "cpu  %llu %llu %llu %llu %llu %llu %llu %llu", &user, &nice, &system, &idle, &iowait,
-                     &irq, &softirq, &steal);
-    if (ret < 8)
+    if (totald == 0)
     {
-        fprintf(stderr, "Error parsing " PROC_STAT_PATH "\n");
         return RETURN_ERROR;
     }
 
-    double prev_idle_total = prev_idle + prev_iowait;
-    double idle_total = idle + iowait;
-    double prev_non_idle = prev_user + prev_nice + prev_system + prev_irq + prev_softirq + prev_steal;
-    double non_idle = user + nice + system + irq + softirq + steal;
-    double prev_total = prev_idle_total + prev_non_idle;
-    double total = idle_total + non_idle;
-    double totald = total - prev_total;
-    double idled = idle_total - prev_idle_total;
+    for (int i = 0; i < CPU_MODE_COUNT; i++)
+    {
+        percentages[i] = ((double)deltas[i] / (double)totald) * PERCENTAGE;
+    }
+    return 0;
+}
 
-    if (totald == 0)
+double get_cpu_usage(CpuUsageState* state)
+{
+    if (read_proc_stat_snapshot(&state->snapshot) != 0)
     {
-        fprintf(stderr, "Totald is zero, cannot calculate CPU usage!\n");
         return RETURN_ERROR;
     }
 
-    double cpu_usage_percent = ((totald - idled) / totald) * 100.0;
-
-    prev_user = user;
-    prev_nice = nice;
-    prev_system = system;
-    prev_idle = idle;
-    prev_iowait = iowait;
-    prev_irq = irq;
-    prev_softirq = softirq;
-    prev_steal = steal;
+    // Without a previous call the interval would start at boot
+    bool valid = state->valid;
+    CpuTimes prev = state->prev;
+    state->prev = state->snapshot.total;
+    state->valid = true;
+    if (!valid)
+    {
+        return RETURN_ERROR;
+    }
 
+    double cpu_usage_percent = cpu_times_usage_percentage(&prev, &state->snapshot.total);
+    if (cpu_usage_percent < 0)
+    {
+        fprintf(stderr, "Totald is zero, cannot calculate CPU usage!\n");
+        return RETURN_ERROR;
+    }
     return cpu_usage_percent;
 }
 
@@ -144,254 +385,639 @@ double get_disk_usage()
     return usage_percentage;
 }
 
-double get_cpu_temperature()
+/**
+ * @brief Reads the fields of one process that follow its comm.
+ *
+ * @param proc_fd Descriptor of the /proc directory.
+ * @param pid PID of the process as a string.
+ * @param buffer Buffer to read /proc/<pid>/stat into.
+ * @param size Size of buffer.
+ * @param len Pointer to store the length of the returned fields.
+ * @return Pointer to the state field inside buffer, or NULL if the process vanished or its stat file is malformed.
+ */
+static const char* read_pid_stat_fields(int proc_fd, const char* pid, char* buffer, size_t size, size_t* len)
 {
-    return read_value(HWMON_CPU_TEMP_PATH);
+    char path[32];
+    size_t pid_len = strlen(pid);
+    if (pid_len + sizeof("/stat") > sizeof(path))
+    {
+        return NULL;
+    }
+    memcpy(path, pid, pid_len);
+    memcpy(path + pid_len, "/stat", sizeof("/stat"));
+
+    int fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    // max_capacity == size keeps prom_procfs_read from reallocating the caller's stack buffer
+    ssize_t n = prom_procfs_read(fd, &buffer, &size, size);
+    close(fd);
+    if (n <= 0)
+    {
+        return NULL;
+    }
+
+    // comm may itself contain ')' or spaces, so the state is found after the last ')'
+    const char* paren = memrchr(buffer, ')', (size_t)n);
+    if (paren == NULL || paren + 2 >= buffer + n)
+    {
+        return NULL;
+    }
+
+    *len = (size_t)(buffer + n - (paren + 2));
+    return paren + 2;
 }
 
-double get_battery_voltage()
+int for_each_pid_stat(size_t read_size, pid_stat_fn fn, void* ctx)
 {
-    return read_value(HWMON_BATTERY_VOLTAGE_PATH);
+    static _Thread_local char dents[DENTS_BUFFER_SIZE];
+    char buffer[PID_STAT_FULL_BUFFER_SIZE];
+
+    if (read_size > sizeof(buffer))
+    {
+        read_size = sizeof(buffer);
+    }
+
+    char proc_path[PATH_MAX];
+    const char* proc_dir = sysroot_path(PROC_DIR_PATH, proc_path, sizeof(proc_path));
+    int proc_fd = proc_dir != NULL ? open(proc_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+    if (proc_fd < 0)
+    {
+        perror("Error opening " PROC_DIR_PATH);
+        return RETURN_ERROR;
+    }
+
+    for (;;)
+    {
+        long nread = syscall(SYS_getdents64, proc_fd, dents, sizeof(dents));
+        if (nread < 0)
+        {
+            perror("Error listing " PROC_DIR_PATH);
+            close(proc_fd);
+            return RETURN_ERROR;
+        }
+        if (nread == 0)
+        {
+            break;
+        }
+
+        for (long offset = 0; offset < nread;)
+        {
+            const struct linux_dirent64* entry = (const struct linux_dirent64*)(dents + offset);
+            offset += entry->d_reclen;
+
+            if (!isdigit((unsigned char)entry->d_name[0]) || !is_directory(proc_fd, entry))
+            {
+                continue;
+            }
+
+            size_t len;
+            const char* fields = read_pid_stat_fields(proc_fd, entry->d_name, buffer, read_size, &len);
+            if (fields != NULL)
+            {
+                fn(entry->d_name, fields, len, ctx);
+            }
+        }
+    }
+
+    close(proc_fd);
+    return 0;
 }
 
-double get_battery_current()
+void process_state_counts_add(ProcessStateCounts* counts, char state)
 {
-    return read_value(HWMON_BATTERY_CURRENT_PATH);
+    counts->total++;
+    switch (state)
+    {
+    case 'R':
+        counts->running++;
+        break;
+    case 'S':
+        counts->sleeping++;
+        break;
+    case 'D':
+        counts->disk_sleep++;
+        break;
+    case 'Z':
+        counts->zombie++;
+        break;
+    case 'T':
+    case 't':
+        counts->stopped++;
+        break;
+    case 'I':
+        counts->idle++;
+        break;
+    default:
+        break;
+    }
 }
 
-double get_cpu_frequency()
+static void count_process_state(const char* pid, const char* fields, size_t len, void* ctx)
 {
-    return read_value(CPU_FREQ_PATH);
+    (void)pid;
+    (void)len;
+    process_state_counts_add(ctx, fields[0]);
 }
 
-double get_cpu_fan_speed()
+int get_process_states(ProcessStateCounts* counts)
 {
-    return read_value(CPU_FAN_SPEED_PATH) * UNIT_CONVERSION;
+    memset(counts, 0, sizeof(*counts));
+    return for_each_pid_stat(PID_STAT_BUFFER_SIZE, count_process_state, counts);
 }
 
-double get_gpu_fan_speed()
+double get_total_memory()
 {
-    return read_value(GPU_FAN_SPEED_PATH) * UNIT_CONVERSION;
+    MemInfoSnapshot snapshot;
+    if (read_meminfo_snapshot(&snapshot) != 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    return snapshot.mem_total / CONVERT_TO_MB;
 }
 
-void get_process_states(int* total, int* suspended, int* ready, int* blocked)
+double get_used_memory()
 {
-    DIR* proc_dir = opendir(PROC_DIR_PATH);
-    if (proc_dir == NULL)
+    MemInfoSnapshot snapshot;
+    if (read_meminfo_snapshot(&snapshot) != 0)
     {
-        perror("Error opening " PROC_DIR_PATH);
-        return;
+        return RETURN_ERROR;
+    }
+
+    return meminfo_used_mb(&snapshot);
+}
+
+double get_available_memory()
+{
+    MemInfoSnapshot snapshot;
+    if (read_meminfo_snapshot(&snapshot) != 0)
+    {
+        return RETURN_ERROR;
     }
 
-    struct dirent* entry;
-    *total = 0;
-    *suspended = 0;
-    *ready = 0;
-    *blocked = 0;
+    return snapshot.mem_available / CONVERT_TO_MB;
+}
 
-    while ((entry = readdir(proc_dir)) != NULL)
+/**
+ * @brief Parses the interface name of a /proc/net/dev line.
+ *
+ * @param line The line.
+ * @param name Buffer of IFNAMSIZ bytes to store the name.
+ * @return Pointer to the first counter of the line, or NULL if the line holds no device.
+ */
+static const char* parse_net_dev_name(const char* line, char name[IFNAMSIZ])
+{
+    while (*line == ' ')
     {
-        if (isdigit(entry->d_name[0]))
+        line++;
+    }
+
+    const char* colon = line;
+    while (*colon != ':' && *colon != '\n' && *colon != '\0')
+    {
+        colon++;
+    }
+    if (*colon != ':' || colon == line || (size_t)(colon - line) >= IFNAMSIZ)
+    {
+        return NULL;
+    }
+
+    memcpy(name, line, (size_t)(colon - line));
+    name[colon - line] = '\0';
+    return colon + 1;
+}
+
+NetDevStats* net_dev_snapshot_next(NetDevSnapshot* snapshot)
+{
+    if (snapshot->device_count == snapshot->device_capacity)
+    {
+        size_t capacity = snapshot->device_capacity ? snapshot->device_capacity * 2 : 64;
+        NetDevStats* devices = realloc(snapshot->devices, capacity * sizeof(*devices));
+        if (devices == NULL)
         {
-            char path[BUFFER_SIZE];
-            snprintf(path, sizeof(path), STAT_FILE_FORMAT, entry->d_name);
+            perror("realloc");
+            return NULL;
+        }
+        snapshot->devices = devices;
+        snapshot->device_capacity = capacity;
+    }
 
-            FILE* fp = fopen(path, "r");
-            if (fp == NULL)
-            {
-                continue;
-            }
+    return &snapshot->devices[snapshot->device_count];
+}
 
-            char state;
-            if (fscanf(fp, "%*d %*s %c", &state) == 1)
+int read_proc_net_dev_snapshot(NetDevSnapshot* snapshot)
+{
+    size_t len;
+    const char* buffer = source_cache_read(PROC_NET_DEV_PATH, &len);
+    if (buffer == NULL)
+    {
+        return RETURN_ERROR;
+    }
+    const char* end = buffer + len;
+
+    snapshot->device_count = 0;
+
+    // Skip the two header lines
+    const char* line = strchr(buffer, '\n');
+    line = line != NULL ? strchr(line + 1, '\n') : NULL;
+
+    while (line != NULL && *(++line) != '\0')
+    {
+        NetDevStats* device = net_dev_snapshot_next(snapshot);
+        if (device == NULL)
+        {
+            return RETURN_ERROR;
+        }
+
+        const char* p = parse_net_dev_name(line, device->name);
+        if (p != NULL)
+        {
+            uint64_t counters[NET_DEV_COUNTER_COUNT] = {0};
+            prom_procfs_parse_u64s(&p, end, counters, NET_DEV_COUNTER_COUNT);
+            for (int i = 0; i < NET_DEV_COUNTER_COUNT; i++)
             {
-                (*total)++;
-                if (state == 'S')
-                {
-                    (*suspended)++;
-                }
-                else if (state == 'R')
-                {
-                    (*ready)++;
-                }
-                else if (state == 'D')
-                {
-                    (*blocked)++;
-                }
+                device->counters[i] = counters[i];
             }
+            snapshot->device_count++;
+        }
+
+        line = strchr(line, '\n');
+    }
 
-            fclose(fp);
+    return 0;
+}
+
+int read_net_dev_snapshot(NetDevSnapshot* snapshot)
+{
+    // A replayed snapshot has no netlink socket to dump
+    if (!snapshot->netlink_unavailable && !sysroot_active())
+    {
+        if (snapshot->netlink == NULL)
+        {
+            snapshot->netlink = netlink_reader_open();
         }
+        if (snapshot->netlink != NULL && netlink_read_links(snapshot->netlink, snapshot) == 0)
+        {
+            return 0;
+        }
+
+        // Sandboxes commonly block AF_NETLINK; once it fails the text file is used for good
+        fprintf(stderr, "Netlink link statistics unavailable, reading " PROC_NET_DEV_PATH "\n");
+        netlink_reader_close(snapshot->netlink);
+        snapshot->netlink = NULL;
+        snapshot->netlink_unavailable = 1;
     }
 
-    closedir(proc_dir);
+    return read_proc_net_dev_snapshot(snapshot);
 }
 
-double get_total_memory()
+void net_dev_snapshot_free(NetDevSnapshot* snapshot)
 {
-    FILE* fp = fopen(PROC_MEMINFO_PATH, "r");
-    if (fp == NULL)
+    netlink_reader_close(snapshot->netlink);
+    snapshot->netlink = NULL;
+    free(snapshot->devices);
+    snapshot->devices = NULL;
+    snapshot->device_count = 0;
+    snapshot->device_capacity = 0;
+}
+
+/**
+ * @brief Compiles a filter pattern anchored to the whole name.
+ *
+ * @param regex Pointer to store the compiled pattern.
+ * @param pattern The pattern.
+ * @return 0 on success, or -1 if the pattern does not compile.
+ */
+static int compile_name_pattern(regex_t* regex, const char* pattern)
+{
+    char anchored[BUFFER_SIZE];
+    if (snprintf(anchored, sizeof(anchored), "^(%s)$", pattern) >= (int)sizeof(anchored))
     {
-        perror("Error opening " PROC_MEMINFO_PATH);
+        fprintf(stderr, "Name pattern is too long: %s\n", pattern);
         return RETURN_ERROR;
     }
 
-    char buffer[BUFFER_SIZE];
-    double total_mem = 0;
+    int ret = regcomp(regex, anchored, REG_EXTENDED | REG_NOSUB);
+    if (ret != 0)
+    {
+        char message[BUFFER_SIZE];
+        regerror(ret, regex, message, sizeof(message));
+        fprintf(stderr, "Invalid name pattern '%s': %s\n", pattern, message);
+        return RETURN_ERROR;
+    }
+    return 0;
+}
 
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+int name_filter_init(NameFilter* filter, const char* include, const char* exclude)
+{
+    filter->has_include = 0;
+    filter->has_exclude = 0;
+
+    if (include != NULL && *include != '\0')
     {
-        if (sscanf(buffer, "MemTotal: %llu kB", &total_mem) == 1)
+        if (compile_name_pattern(&filter->include, include) != 0)
         {
-            break;
+            return RETURN_ERROR;
+        }
+        filter->has_include = 1;
+    }
+
+    if (exclude != NULL && *exclude != '\0')
+    {
+        if (compile_name_pattern(&filter->exclude, exclude) != 0)
+        {
+            name_filter_free(filter);
+            return RETURN_ERROR;
         }
+        filter->has_exclude = 1;
     }
 
-    fclose(fp);
-    return total_mem / CONVERT_TO_MB;
+    return 0;
 }
 
-double get_used_memory()
+int name_filter_match(const NameFilter* filter, const char* name)
 {
-    FILE* fp = fopen(PROC_MEMINFO_PATH, "r");
-    if (fp == NULL)
+    if (filter->has_include && regexec(&filter->include, name, 0, NULL, 0) != 0)
     {
-        perror("Error opening " PROC_MEMINFO_PATH);
-        return RETURN_ERROR;
+        return 0;
     }
+    if (filter->has_exclude && regexec(&filter->exclude, name, 0, NULL, 0) == 0)
+    {
+        return 0;
+    }
+    return 1;
+}
+
+void name_filter_free(NameFilter* filter)
+{
+    if (filter->has_include)
+    {
+        regfree(&filter->include);
+    }
+    if (filter->has_exclude)
+    {
+        regfree(&filter->exclude);
+    }
+    filter->has_include = 0;
+    filter->has_exclude = 0;
+}
 
-    char buffer[BUFFER_SIZE];
-    double total_mem = 0, free_mem = 0, buffers = 0, cached = 0;
+int get_network_traffic(NetworkStats* stats)
+{
+    static NetDevSnapshot snapshot;
+
+    if (read_net_dev_snapshot(&snapshot) != 0)
+    {
+        return RETURN_ERROR;
+    }
 
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    for (size_t i = 0; i < snapshot.device_count; i++)
     {
-        sscanf(buffer, "MemTotal: %llu kB", &total_mem);
-        sscanf(buffer, "MemFree: %llu kB", &free_mem);
-        sscanf(buffer, "Buffers: %llu kB", &buffers);
-        sscanf(buffer, "Cached: %llu kB", &cached);
+        const NetDevStats* device = &snapshot.devices[i];
+        if (strcmp(device->name, NETWORK_INTERFACE) == 0)
+        {
+            const unsigned long long* c = device->counters;
+            *stats = (NetworkStats){c[NET_DEV_RX_BYTES], c[NET_DEV_TX_BYTES], c[NET_DEV_RX_ERRORS],
+                                    c[NET_DEV_TX_ERRORS], c[NET_DEV_RX_DROPPED]};
+            return 0;
+        }
     }
 
-    fclose(fp);
-    return (total_mem - free_mem - buffers - cached) / CONVERT_TO_MB;
+    return RETURN_ERROR;
 }
 
-double get_available_memory()
+int get_context_switches(unsigned long long* switches)
 {
-    FILE* fp = fopen(PROC_MEMINFO_PATH, "r");
-    if (fp == NULL)
+    static ProcStatSnapshot snapshot;
+
+    if (read_proc_stat_snapshot(&snapshot) != 0)
     {
-        perror("Error opening " PROC_MEMINFO_PATH);
         return RETURN_ERROR;
     }
 
-    char buffer[BUFFER_SIZE];
-    double available_mem = 0;
+    *switches = snapshot.ctxt;
+    return 0;
+}
+
+/**
+ * @brief Looks up the kind of a block device in /sys/block.
+ *
+ * @param device The device, with its name and numbers parsed.
+ * @return The kind of the device.
+ */
+static DiskKind classify_disk(const DiskDeviceStats* device)
+{
+    if (device->major == RAMDISK_MAJOR || device->major == LOOP_MAJOR)
+    {
+        return DISK_KIND_VIRTUAL;
+    }
+
+    // sysfs spells the '/' of names such as cciss/c0d0 as '!'
+    char sysfs_name[DISK_NAME_SIZE];
+    for (size_t i = 0; i < sizeof(sysfs_name); i++)
+    {
+        sysfs_name[i] = device->name[i] == '/' ? '!' : device->name[i];
+    }
+
+    char path[BUFFER_SIZE];
+    char root_path[PATH_MAX];
+    snprintf(path, sizeof(path), SYS_BLOCK_PATH "/%s", sysfs_name);
+    const char* block_path = sysroot_path(path, root_path, sizeof(root_path));
+
+    // Partitions are only listed under their parent disk, so they have no /sys/block entry of their own
+    struct stat info;
+    if (block_path == NULL || stat(block_path, &info) != 0)
+    {
+        return DISK_KIND_PARTITION;
+    }
+
+    // A disk without a slaves directory, as on some kernels and drivers, has nothing stacked below it
+    snprintf(path, sizeof(path), SYS_BLOCK_PATH "/%s/slaves", sysfs_name);
+    const char* slaves_path = sysroot_path(path, root_path, sizeof(root_path));
+    DIR* slaves = slaves_path != NULL ? opendir(slaves_path) : NULL;
+    if (slaves == NULL)
+    {
+        return DISK_KIND_PHYSICAL;
+    }
 
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    DiskKind kind = DISK_KIND_PHYSICAL;
+    const struct dirent* entry;
+    while ((entry = readdir(slaves)) != NULL)
     {
-        if (sscanf(buffer, "MemAvailable: %llu kB", &available_mem) == 1)
+        if (entry->d_name[0] != '.')
         {
+            kind = DISK_KIND_STACKED;
             break;
         }
     }
-
-    fclose(fp);
-    return available_mem / CONVERT_TO_MB;
+    closedir(slaves);
+    return kind;
 }
 
-NetworkStats get_network_traffic()
+/**
+ * @brief Parses the numbers and the name of a /proc/diskstats line.
+ *
+ * @param line The line.
+ * @param end End of the buffer holding the line.
+ * @param major Pointer to store the major device number.
+ * @param minor Pointer to store the minor device number.
+ * @param name Buffer of DISK_NAME_SIZE bytes to store the name.
+ * @return Pointer to the first counter of the line, or NULL if the line holds no device.
+ */
+static const char* parse_diskstats_device(const char* line, const char* end, unsigned int* major,
+                                          unsigned int* minor, char name[DISK_NAME_SIZE])
 {
-    FILE* fp = fopen(PROC_NET_DEV_PATH, "r");
-    if (fp == NULL)
+    const char* p = line;
+    *major = (unsigned int)prom_procfs_parse_u64(&p, end);
+    *minor = (unsigned int)prom_procfs_parse_u64(&p, end);
+
+    while (*p == ' ')
+    {
+        p++;
+    }
+    const char* name_end = p;
+    while (*name_end != ' ' && *name_end != '\n' && *name_end != '\0')
+    {
+        name_end++;
+    }
+    if (name_end == p || (size_t)(name_end - p) >= DISK_NAME_SIZE)
     {
-        perror("Error opening " PROC_NET_DEV_PATH);
-        return (NetworkStats){RETURN_ERROR, RETURN_ERROR, RETURN_ERROR, RETURN_ERROR, RETURN_ERROR};
+        return NULL;
     }
 
-    char buffer[BUFFER_SIZE];
-    unsigned long long rx_bytes = 0, tx_bytes = 0;
-    unsigned long long rx_errors = 0, tx_errors = 0, dropped_packets = 0;
+    memcpy(name, p, (size_t)(name_end - p));
+    name[name_end - p] = '\0';
+    return name_end;
+}
+
+int read_diskstats_snapshot(DiskStatsSnapshot* snapshot)
+{
+    size_t len;
+    const char* buffer = source_cache_read(DISKSTATS_PATH, &len);
+    if (buffer == NULL)
+    {
+        return RETURN_ERROR;
+    }
+    const char* end = buffer + len;
 
-    fgets(buffer, sizeof(buffer), fp);
-    fgets(buffer, sizeof(buffer), fp);
+    clock_gettime(CLOCK_MONOTONIC, &snapshot->timestamp);
+    snapshot->device_count = 0;
 
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    for (const char* line = buffer; *line != '\0';)
     {
-        if (strstr(buffer, NETWORK_INTERFACE) != NULL)
+        if (snapshot->device_count == snapshot->device_capacity)
         {
-            unsigned long long r_bytes, t_bytes, r_errors, t_errors, drop;
-
-            int matched = sscanf(buffer, "%*[^:]: %llu %*d %llu %llu %*d %*d %*d %*d %llu %*d %llu", &r_bytes,
-                                 &r_errors, &drop, &t_bytes, &t_errors);
+            size_t capacity = snapshot->device_capacity ? snapshot->device_capacity * 2 : 64;
+            DiskDeviceStats* devices = realloc(snapshot->devices, capacity * sizeof(*devices));
+            if (devices == NULL)
+            {
+                perror("realloc");
+                return RETURN_ERROR;
+            }
+            // New entries hold no device, so their kind is looked up on first use
+            memset(devices + snapshot->device_capacity, 0,
+                   (capacity - snapshot->device_capacity) * sizeof(*devices));
+            snapshot->devices = devices;
+            snapshot->device_capacity = capacity;
+        }
 
-            if (matched != 5)
+        DiskDeviceStats* device = &snapshot->devices[snapshot->device_count];
+        unsigned int major, minor;
+        char name[DISK_NAME_SIZE];
+        const char* p = parse_diskstats_device(line, end, &major, &minor, name);
+        if (p != NULL)
+        {
+            if (device->major != major || device->minor != minor || strcmp(device->name, name) != 0)
             {
-                fprintf(stderr, "sscanf failed to match expected format (matched = %d) for line: %s\n", matched,
-                        buffer);
-                continue;
+                memcpy(device->name, name, sizeof(name));
+                device->major = major;
+                device->minor = minor;
+                device->kind = classify_disk(device);
             }
 
-            rx_bytes = r_bytes;
-            tx_bytes = t_bytes;
-            rx_errors = r_errors;
-            tx_errors = t_errors;
-            dropped_packets = drop;
+            // Reads, reads merged, sectors read, ms reading, then the same for writes, requests in flight and io ms
+            uint64_t fields[DISKSTATS_FIELDS] = {0};
+            prom_procfs_parse_u64s(&p, end, fields, DISKSTATS_FIELDS);
+            device->reads = fields[0];
+            device->read_sectors = fields[2];
+            device->read_ms = fields[3];
+            device->writes = fields[4];
+            device->write_sectors = fields[6];
+            device->write_ms = fields[7];
+            device->io_ms = fields[9];
+            snapshot->device_count++;
+        }
 
+        const char* next = strchr(line, '\n');
+        if (next == NULL)
+        {
             break;
         }
+        line = next + 1;
     }
 
-    fclose(fp);
-    return (NetworkStats){rx_bytes, tx_bytes, rx_errors, tx_errors, dropped_packets};
+    return 0;
 }
 
-int get_context_switches()
+void diskstats_snapshot_free(DiskStatsSnapshot* snapshot)
 {
-    FILE* fp = fopen(PROC_STAT_PATH, "r");
-    if (fp == NULL)
+    free(snapshot->devices);
+    snapshot->devices = NULL;
+    snapshot->device_count = 0;
+    snapshot->device_capacity = 0;
+}
+
+int disk_device_rates(const DiskDeviceStats* prev, const DiskDeviceStats* cur, double elapsed, DiskDeviceRates* rates)
+{
+    if (elapsed <= 0 || cur->reads < prev->reads || cur->writes < prev->writes || cur->io_ms < prev->io_ms ||
+        cur->read_sectors < prev->read_sectors || cur->write_sectors < prev->write_sectors ||
+        cur->read_ms < prev->read_ms || cur->write_ms < prev->write_ms)
     {
-        perror("Error opening /proc/stat");
         return RETURN_ERROR;
     }
 
-    char buffer[BUFFER_SIZE];
-    int context_switches = 0;
+    unsigned long long ios = (cur->reads - prev->reads) + (cur->writes - prev->writes);
+    unsigned long long ticks = (cur->read_ms - prev->read_ms) + (cur->write_ms - prev->write_ms);
 
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    rates->reads_per_second = (double)(cur->reads - prev->reads) / elapsed;
+    rates->writes_per_second = (double)(cur->writes - prev->writes) / elapsed;
+    rates->read_bytes_per_second = (double)(cur->read_sectors - prev->read_sectors) * DISK_SECTOR_SIZE / elapsed;
+    rates->write_bytes_per_second = (double)(cur->write_sectors - prev->write_sectors) * DISK_SECTOR_SIZE / elapsed;
+    rates->await_ms = ios > 0 ? (double)ticks / (double)ios : 0.0;
+    rates->utilization = (double)(cur->io_ms - prev->io_ms) / (elapsed * UNIT_CONVERSION) * PERCENTAGE;
+    if (rates->utilization > PERCENTAGE)
     {
-        if (sscanf(buffer, "ctxt %d", &context_switches) == 1)
-        {
-            break;
-        }
+        rates->utilization = PERCENTAGE;
     }
-
-    fclose(fp);
-    return context_switches;
+    return 0;
 }
 
-DiskStats get_disk_stats()
+int get_disk_stats(DiskStats* stats)
 {
-    FILE* fp = fopen(DISKSTATS_PATH, "r");
-    if (fp == NULL)
+    static DiskStatsSnapshot snapshot;
+
+    if (read_diskstats_snapshot(&snapshot) != 0)
     {
-        perror("Error opening " DISKSTATS_PATH);
-        return (DiskStats){RETURN_ERROR, RETURN_ERROR, RETURN_ERROR};
+        return RETURN_ERROR;
     }
 
-    char buffer[BUFFER_SIZE];
     unsigned long long io_time = 0, writes_completed = 0, reads_completed = 0;
 
-    while (fgets(buffer, sizeof(buffer), fp) != NULL)
+    for (size_t i = 0; i < snapshot.device_count; i++)
     {
-        long long it, wc, rc;
-        if (sscanf(buffer, "%*d %*d %*s %lld %*d %*d %*d %lld %*d %lld", &rc, &wc, &it) == 3)
+        const DiskDeviceStats* device = &snapshot.devices[i];
+        if (device->kind == DISK_KIND_PHYSICAL)
         {
-            reads_completed += rc;
-            writes_completed += wc;
-            io_time += it;
+            reads_completed += device->reads;
+            writes_completed += device->writes;
+            io_time += device->io_ms;
         }
     }
 
-    fclose(fp);
-    return (DiskStats){io_time, writes_completed, reads_completed};
+    *stats = (DiskStats){io_time, writes_completed, reads_completed};
+    return 0;
 }
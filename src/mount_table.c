@@ -0,0 +1,429 @@
+/**
+ * @file mount_table.c
+ * @brief Functions for tracking the mounted file systems and their usage.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "mount_table.h"
+#include "sysroot.h"
+#include <errno.h>
+#include <poll.h>
+#include <prom_alloc.h>
+#include <prom_procfs.h>
+
+int mount_table_init(MountTable* table, const char* include, const char* exclude, mount_release_fn release)
+{
+    memset(table, 0, sizeof(*table));
+    table->fd = -1;
+    table->capacity = MOUNTINFO_SIZE_HINT;
+    table->release = release;
+
+    pthread_condattr_t attr;
+    if (pthread_mutex_init(&table->mutex, NULL) != 0 || pthread_condattr_init(&attr) != 0)
+    {
+        fprintf(stderr, "Error initializing mount table\n");
+        return RETURN_ERROR;
+    }
+    // The wait for the answers is bounded on the monotonic clock so that a clock change cannot stretch it
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int ret = pthread_cond_init(&table->done, &attr);
+    pthread_condattr_destroy(&attr);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Error initializing mount table\n");
+        pthread_mutex_destroy(&table->mutex);
+        return RETURN_ERROR;
+    }
+
+    if (name_filter_init(&table->fstypes, include, exclude) != 0)
+    {
+        fprintf(stderr, "Error compiling the file system type filter, reporting every type\n");
+    }
+    return 0;
+}
+
+void mount_table_set_pool(MountTable* table, WorkerPool* pool)
+{
+    pthread_mutex_lock(&table->mutex);
+    table->pool = pool;
+    pthread_mutex_unlock(&table->mutex);
+}
+
+/**
+ * @brief Releases a mount entry.
+ *
+ * @param entry The entry.
+ */
+static void free_entry(MountEntry* entry)
+{
+    free(entry->mount_point);
+    free(entry->fstype);
+    free(entry->source);
+    free(entry);
+}
+
+/**
+ * @brief Decodes the octal escapes the kernel uses for blanks and backslashes in mountinfo, in place.
+ *
+ * @param field The NUL-terminated field.
+ */
+static void unescape_field(char* field)
+{
+    char* out = field;
+    for (const char* in = field; *in != '\0'; out++)
+    {
+        if (in[0] == '\\' && in[1] >= '0' && in[1] <= '3' && in[2] >= '0' && in[2] <= '7' && in[3] >= '0' &&
+            in[3] <= '7')
+        {
+            *out = (char)((in[1] - '0') * 64 + (in[2] - '0') * 8 + (in[3] - '0'));
+            in += 4;
+        }
+        else
+        {
+            *out = *in++;
+        }
+    }
+    *out = '\0';
+}
+
+/**
+ * @brief Splits the next space-separated field of a line in place.
+ *
+ * @param p Pointer to the parse position; advanced past the field.
+ * @return The NUL-terminated field, or NULL at the end of the line.
+ */
+static char* next_field(char** p)
+{
+    char* start = *p;
+    while (*start == ' ')
+    {
+        start++;
+    }
+    if (*start == '\0')
+    {
+        return NULL;
+    }
+
+    char* end = start;
+    while (*end != ' ' && *end != '\0')
+    {
+        end++;
+    }
+    if (*end != '\0')
+    {
+        *end++ = '\0';
+    }
+    *p = end;
+    return start;
+}
+
+/**
+ * @brief Looks up a mount by ID.
+ */
+static MountEntry* find_entry(MountTable* table, int mount_id)
+{
+    for (MountEntry* entry = table->entries; entry != NULL; entry = entry->next)
+    {
+        if (entry->mount_id == mount_id)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Adds or marks the mount described by one mountinfo line.
+ *
+ * @param table The table.
+ * @param line The NUL-terminated line, modified in place.
+ * @return 0 on success, or -1 if an entry cannot be allocated.
+ */
+static int parse_mount_line(MountTable* table, char* line)
+{
+    // mount_id parent_id major:minor root mount_point options [optional fields...] - fstype source super_options
+    char* p = line;
+    char* fields[5];
+    for (int i = 0; i < 5; i++)
+    {
+        fields[i] = next_field(&p);
+        if (fields[i] == NULL)
+        {
+            return 0;
+        }
+    }
+
+    char* field;
+    while ((field = next_field(&p)) != NULL && strcmp(field, "-") != 0)
+    {
+    }
+    char* fstype = field != NULL ? next_field(&p) : NULL;
+    char* source = fstype != NULL ? next_field(&p) : NULL;
+    if (source == NULL || !name_filter_match(&table->fstypes, fstype))
+    {
+        return 0;
+    }
+
+    int mount_id = atoi(fields[0]);
+    char* mount_point = fields[4];
+    unescape_field(mount_point);
+    unescape_field(source);
+
+    MountEntry* entry = find_entry(table, mount_id);
+    if (entry != NULL && strcmp(entry->mount_point, mount_point) == 0)
+    {
+        entry->seen = true;
+        return 0;
+    }
+
+    // A moved mount keeps its ID; it gets a new entry because a query in flight may still read the old mount point
+    if (entry != NULL)
+    {
+        entry->mount_id = -1;
+    }
+
+    entry = calloc(1, sizeof(*entry));
+    if (entry == NULL)
+    {
+        perror("calloc");
+        return RETURN_ERROR;
+    }
+    entry->mount_id = mount_id;
+    entry->mount_point = strdup(mount_point);
+    entry->fstype = strdup(fstype);
+    entry->source = strdup(source);
+    if (entry->mount_point == NULL || entry->fstype == NULL || entry->source == NULL)
+    {
+        perror("strdup");
+        free_entry(entry);
+        return RETURN_ERROR;
+    }
+    entry->seen = true;
+    entry->table = table;
+    entry->next = table->entries;
+    table->entries = entry;
+    return 0;
+}
+
+/**
+ * @brief Checks with poll() whether the mounts changed since mountinfo was last parsed.
+ *
+ * @param table The table.
+ * @return 1 if mountinfo must be parsed, 0 if it is unchanged.
+ */
+static int mounts_changed(MountTable* table)
+{
+    if (!table->loaded)
+    {
+        return 1;
+    }
+
+    struct pollfd pfd = {.fd = table->fd, .events = POLLPRI};
+    if (poll(&pfd, 1, 0) < 0)
+    {
+        perror("poll");
+        return 1;
+    }
+    return (pfd.revents & (POLLPRI | POLLERR)) != 0;
+}
+
+int mount_table_refresh(MountTable* table)
+{
+    if (table->fd < 0)
+    {
+        char buffer[PATH_MAX];
+        const char* path = sysroot_path(PROC_MOUNTINFO_PATH, buffer, sizeof(buffer));
+        table->fd = path != NULL ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+        if (table->fd < 0)
+        {
+            perror("open");
+            return RETURN_ERROR;
+        }
+        table->loaded = false;
+    }
+
+    if (!mounts_changed(table))
+    {
+        return 0;
+    }
+
+    ssize_t n = prom_procfs_read(table->fd, &table->buffer, &table->capacity, MOUNTINFO_MAX_SIZE);
+    if (n < 0)
+    {
+        fprintf(stderr, "Error reading " PROC_MOUNTINFO_PATH ": %s\n", strerror(errno));
+        return RETURN_ERROR;
+    }
+
+    pthread_mutex_lock(&table->mutex);
+    for (MountEntry* entry = table->entries; entry != NULL; entry = entry->next)
+    {
+        entry->seen = false;
+    }
+
+    int ret = 0;
+    for (char* line = table->buffer; ret == 0 && *line != '\0';)
+    {
+        char* next = strchr(line, '\n');
+        if (next != NULL)
+        {
+            *next = '\0';
+        }
+        ret = parse_mount_line(table, line);
+        if (next == NULL)
+        {
+            break;
+        }
+        line = next + 1;
+    }
+
+    // Mounts that are gone are unlinked; one with a query in flight is freed by that query when it returns
+    for (MountEntry** link = &table->entries; *link != NULL;)
+    {
+        MountEntry* entry = *link;
+        if (entry->seen || ret != 0)
+        {
+            link = &entry->next;
+            continue;
+        }
+
+        *link = entry->next;
+        if (table->release != NULL)
+        {
+            table->release(entry);
+        }
+        if (entry->in_flight)
+        {
+            entry->removed = true;
+        }
+        else
+        {
+            free_entry(entry);
+        }
+    }
+    table->loaded = ret == 0;
+    pthread_mutex_unlock(&table->mutex);
+
+    return ret;
+}
+
+/**
+ * @brief Queries the usage of one mount; runs on the worker pool.
+ *
+ * @param arg The mount entry.
+ */
+static void stat_mount(void* arg)
+{
+    MountEntry* entry = arg;
+    MountTable* table = entry->table;
+
+    // The mount point is not modified while the query is in flight, so it is read without the lock
+    struct statvfs usage;
+    bool ok = statvfs(entry->mount_point, &usage) == 0;
+
+    pthread_mutex_lock(&table->mutex);
+    entry->in_flight = false;
+    table->in_flight--;
+    if (entry->removed)
+    {
+        free_entry(entry);
+    }
+    else
+    {
+        entry->usage = usage;
+        entry->has_usage = ok;
+        entry->fresh = true;
+    }
+    pthread_cond_broadcast(&table->done);
+    pthread_mutex_unlock(&table->mutex);
+}
+
+/**
+ * @brief Sends the queries of the pending mounts while query slots are free.
+ *
+ * @param table The table, with its mutex held.
+ */
+static void submit_pending(MountTable* table)
+{
+    for (MountEntry* entry = table->entries; entry != NULL && table->in_flight < MOUNT_MAX_IN_FLIGHT;
+         entry = entry->next)
+    {
+        if (!entry->pending)
+        {
+            continue;
+        }
+
+        entry->pending = false;
+        entry->in_flight = true;
+        entry->queried = true;
+        table->in_flight++;
+        if (table->pool == NULL)
+        {
+            pthread_mutex_unlock(&table->mutex);
+            stat_mount(entry);
+            pthread_mutex_lock(&table->mutex);
+        }
+        else if (worker_pool_submit(table->pool, stat_mount, entry) != 0)
+        {
+            entry->in_flight = false;
+            table->in_flight--;
+        }
+    }
+}
+
+/**
+ * @brief Counts the listed mounts that have not answered yet.
+ *
+ * @param table The table, with its mutex held.
+ * @param round_only Whether to only count the queries sent by this round, leaving out earlier stuck ones.
+ */
+static size_t count_waiting(const MountTable* table, bool round_only)
+{
+    size_t waiting = 0;
+    for (const MountEntry* entry = table->entries; entry != NULL; entry = entry->next)
+    {
+        waiting += entry->pending || (entry->in_flight && (entry->queried || !round_only));
+    }
+    return waiting;
+}
+
+size_t mount_table_stat(MountTable* table, unsigned int timeout_ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    // A mount whose query from an earlier round has not returned yet is left alone
+    pthread_mutex_lock(&table->mutex);
+    for (MountEntry* entry = table->entries; entry != NULL; entry = entry->next)
+    {
+        entry->fresh = false;
+        entry->queried = false;
+        entry->pending = !entry->in_flight;
+    }
+
+    for (;;)
+    {
+        submit_pending(table);
+        if (count_waiting(table, true) == 0 ||
+            pthread_cond_timedwait(&table->done, &table->mutex, &deadline) == ETIMEDOUT)
+        {
+            break;
+        }
+    }
+
+    size_t waiting = count_waiting(table, false);
+    for (MountEntry* entry = table->entries; entry != NULL; entry = entry->next)
+    {
+        entry->pending = false;
+    }
+    pthread_mutex_unlock(&table->mutex);
+
+    return waiting;
+}
@@ -0,0 +1,252 @@
+/**
+ * @file netlink_stats.c
+ * @brief Functions for reading network link statistics over rtnetlink.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "netlink_stats.h"
+#include <errno.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+NetlinkReader* netlink_reader_open(void)
+{
+    NetlinkReader* reader = malloc(sizeof(*reader));
+    if (reader == NULL)
+    {
+        perror("malloc");
+        return NULL;
+    }
+
+    reader->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (reader->fd < 0)
+    {
+        free(reader);
+        return NULL;
+    }
+
+    // A dump is answered immediately; the timeout only keeps a collector worker from hanging on a broken socket
+    struct timeval timeout = {.tv_sec = NETLINK_RECV_TIMEOUT_S, .tv_usec = 0};
+    setsockopt(reader->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    reader->seq = 0;
+    reader->capacity = NETLINK_INITIAL_BUFFER;
+    reader->buffer = malloc(reader->capacity);
+    if (reader->buffer == NULL)
+    {
+        perror("malloc");
+        close(reader->fd);
+        free(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+void netlink_reader_close(NetlinkReader* reader)
+{
+    if (reader == NULL)
+    {
+        return;
+    }
+
+    close(reader->fd);
+    free(reader->buffer);
+    free(reader);
+}
+
+/**
+ * @brief Sends a RTM_GETLINK dump request.
+ *
+ * @param reader The reader.
+ * @return 0 on success, or -1 in case of error.
+ */
+static int send_link_dump(NetlinkReader* reader)
+{
+    struct
+    {
+        struct nlmsghdr header;
+        struct ifinfomsg info;
+    } request;
+
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(request.info));
+    request.header.nlmsg_type = RTM_GETLINK;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++reader->seq;
+    request.info.ifi_family = AF_UNSPEC;
+
+    struct sockaddr_nl kernel = {.nl_family = AF_NETLINK};
+    if (sendto(reader->fd, &request, request.header.nlmsg_len, 0, (struct sockaddr*)&kernel, sizeof(kernel)) < 0)
+    {
+        perror("sendto");
+        return RETURN_ERROR;
+    }
+    return 0;
+}
+
+/**
+ * @brief Receives the next batch of dump messages into the reader buffer, growing it if the batch does not fit.
+ *
+ * @param reader The reader.
+ * @return The number of bytes received, or -1 in case of error.
+ */
+static ssize_t recv_batch(NetlinkReader* reader)
+{
+    // Peeking with MSG_TRUNC reports the size of the pending datagram without consuming it
+    ssize_t pending = recv(reader->fd, NULL, 0, MSG_PEEK | MSG_TRUNC);
+    if (pending < 0)
+    {
+        perror("recv");
+        return RETURN_ERROR;
+    }
+
+    if ((size_t)pending > reader->capacity)
+    {
+        char* buffer = realloc(reader->buffer, (size_t)pending);
+        if (buffer == NULL)
+        {
+            perror("realloc");
+            return RETURN_ERROR;
+        }
+        reader->buffer = buffer;
+        reader->capacity = (size_t)pending;
+    }
+
+    ssize_t received = recv(reader->fd, reader->buffer, reader->capacity, 0);
+    if (received < 0)
+    {
+        perror("recv");
+    }
+    return received;
+}
+
+/**
+ * @brief Maps IFLA_STATS64 counters to the /proc/net/dev columns.
+ *
+ * The aggregation mirrors dev_seq_printf_stats() in net/core/net-procfs.c.
+ *
+ * @param stats The link counters.
+ * @param counters Array to store the counters, indexed by NetDevCounter.
+ */
+static void map_link_stats(const struct rtnl_link_stats64* stats, unsigned long long counters[NET_DEV_COUNTER_COUNT])
+{
+    counters[NET_DEV_RX_BYTES] = stats->rx_bytes;
+    counters[NET_DEV_RX_PACKETS] = stats->rx_packets;
+    counters[NET_DEV_RX_ERRORS] = stats->rx_errors;
+    counters[NET_DEV_RX_DROPPED] = stats->rx_dropped + stats->rx_missed_errors;
+    counters[NET_DEV_RX_FIFO] = stats->rx_fifo_errors;
+    counters[NET_DEV_RX_FRAME] =
+        stats->rx_length_errors + stats->rx_over_errors + stats->rx_crc_errors + stats->rx_frame_errors;
+    counters[NET_DEV_RX_COMPRESSED] = stats->rx_compressed;
+    counters[NET_DEV_RX_MULTICAST] = stats->multicast;
+    counters[NET_DEV_TX_BYTES] = stats->tx_bytes;
+    counters[NET_DEV_TX_PACKETS] = stats->tx_packets;
+    counters[NET_DEV_TX_ERRORS] = stats->tx_errors;
+    counters[NET_DEV_TX_DROPPED] = stats->tx_dropped;
+    counters[NET_DEV_TX_FIFO] = stats->tx_fifo_errors;
+    counters[NET_DEV_TX_COLLISIONS] = stats->collisions;
+    counters[NET_DEV_TX_CARRIER] = stats->tx_carrier_errors + stats->tx_aborted_errors + stats->tx_window_errors +
+                                   stats->tx_heartbeat_errors;
+    counters[NET_DEV_TX_COMPRESSED] = stats->tx_compressed;
+}
+
+/**
+ * @brief Appends the link of a RTM_NEWLINK message to a snapshot.
+ *
+ * Links without a name or without 64-bit statistics are skipped.
+ *
+ * @param header The message.
+ * @param snapshot The snapshot.
+ * @return 0 on success, or -1 if the device array cannot be grown.
+ */
+static int add_link(const struct nlmsghdr* header, NetDevSnapshot* snapshot)
+{
+    const char* name = NULL;
+    size_t name_len = 0;
+    const struct rtattr* stats = NULL;
+
+    int len = (int)header->nlmsg_len - (int)NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    for (const struct rtattr* attr = IFLA_RTA((const struct ifinfomsg*)NLMSG_DATA(header)); RTA_OK(attr, len);
+         attr = RTA_NEXT(attr, len))
+    {
+        if (attr->rta_type == IFLA_IFNAME)
+        {
+            name = RTA_DATA(attr);
+            name_len = strnlen(name, RTA_PAYLOAD(attr));
+        }
+        else if (attr->rta_type == IFLA_STATS64 && RTA_PAYLOAD(attr) >= sizeof(struct rtnl_link_stats64))
+        {
+            stats = attr;
+        }
+    }
+
+    if (name == NULL || name_len == 0 || name_len >= IFNAMSIZ || stats == NULL)
+    {
+        return 0;
+    }
+
+    NetDevStats* device = net_dev_snapshot_next(snapshot);
+    if (device == NULL)
+    {
+        return RETURN_ERROR;
+    }
+
+    // Attributes are only 4-byte aligned, so the 64-bit counters are copied out before use
+    struct rtnl_link_stats64 link_stats;
+    memcpy(&link_stats, RTA_DATA(stats), sizeof(link_stats));
+    memcpy(device->name, name, name_len);
+    device->name[name_len] = '\0';
+    map_link_stats(&link_stats, device->counters);
+    snapshot->device_count++;
+    return 0;
+}
+
+int netlink_read_links(NetlinkReader* reader, NetDevSnapshot* snapshot)
+{
+    if (send_link_dump(reader) != 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    snapshot->device_count = 0;
+
+    for (;;)
+    {
+        ssize_t received = recv_batch(reader);
+        if (received <= 0)
+        {
+            return RETURN_ERROR;
+        }
+
+        int len = (int)received;
+        for (const struct nlmsghdr* header = (const struct nlmsghdr*)reader->buffer; NLMSG_OK(header, len);
+             header = NLMSG_NEXT(header, len))
+        {
+            // Replies to an earlier dump that was abandoned midway are still queued on the socket
+            if (header->nlmsg_seq != reader->seq)
+            {
+                continue;
+            }
+
+            if (header->nlmsg_type == NLMSG_DONE)
+            {
+                return 0;
+            }
+            if (header->nlmsg_type == NLMSG_ERROR)
+            {
+                const struct nlmsgerr* error = NLMSG_DATA(header);
+                fprintf(stderr, "Netlink link dump failed: %s\n", strerror(-error->error));
+                return RETURN_ERROR;
+            }
+            if (header->nlmsg_type == RTM_NEWLINK && add_link(header, snapshot) != 0)
+            {
+                return RETURN_ERROR;
+            }
+        }
+    }
+}
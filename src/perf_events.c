@@ -0,0 +1,231 @@
+/**
+ * @file perf_events.c
+ * @brief Functions for counting hardware events on every CPU to tell how efficiently it runs.
+ * @author 1v6n
+ * @date 15/10/2026
+ */
+
+#include "perf_events.h"
+#include "metrics.h"
+#include "sysroot.h"
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <math.h>
+#include <sys/syscall.h>
+
+#define PERF_PER_KI 1000.0 /**< Instructions a miss ratio is counted per. */
+
+/**
+ * @brief Layout of a group read with PERF_FORMAT_GROUP and PERF_FORMAT_TOTAL_TIME_RUNNING.
+ */
+typedef struct
+{
+    uint64_t count;                    /**< Number of events in the group. */
+    uint64_t time_running;             /**< Time the group was counting in nanoseconds. */
+    uint64_t values[PERF_EVENT_COUNT]; /**< Count of every event, in the order they joined the group. */
+} PerfGroupRead;
+
+static const uint64_t perf_configs[PERF_EVENT_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+}; /**< Hardware event of every PerfEvent. */
+
+/**
+ * @brief Opens one event counting on a CPU for every task.
+ *
+ * @param group_fd Descriptor of the group leader, or -1 to open a leader.
+ * @return The descriptor, or -1 with errno set.
+ */
+static int open_event(PerfEvent event, int cpu, int group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = perf_configs[event];
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, -1, cpu, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+static void close_group(PerfCpu* cpu)
+{
+    for (int e = 0; e < PERF_EVENT_COUNT; e++)
+    {
+        if (cpu->fds[e] >= 0)
+        {
+            close(cpu->fds[e]);
+            cpu->fds[e] = -1;
+        }
+    }
+}
+
+/**
+ * @brief Opens the group of one CPU.
+ *
+ * The first group opened decides which miss counters the groups hold: those the PMU refuses are left out. Later
+ * groups must open the same events.
+ *
+ * @return 0 on success, or -1 with errno set if the CPU cannot count the events, as when it is offline.
+ */
+static int open_group(PerfTable* table, PerfCpu* cpu)
+{
+    bool first = table->event_count == 0;
+    for (int e = 0; e < PERF_EVENT_COUNT; e++)
+    {
+        cpu->fds[e] = -1;
+    }
+
+    for (int e = 0; e < PERF_EVENT_COUNT; e++)
+    {
+        if (!first && !table->opened[e])
+        {
+            continue;
+        }
+
+        cpu->fds[e] = open_event(e, cpu->cpu, e == PERF_CYCLES ? -1 : cpu->fds[PERF_CYCLES]);
+        if (cpu->fds[e] < 0 && (!first || e == PERF_CYCLES || e == PERF_INSTRUCTIONS))
+        {
+            int error = errno;
+            close_group(cpu);
+            errno = error;
+            return RETURN_ERROR;
+        }
+    }
+
+    if (first)
+    {
+        for (int e = 0; e < PERF_EVENT_COUNT; e++)
+        {
+            table->opened[e] = cpu->fds[e] >= 0;
+            table->event_count += table->opened[e];
+        }
+    }
+    snprintf(cpu->label, sizeof(cpu->label), "%d", cpu->cpu);
+    return 0;
+}
+
+/**
+ * @brief Opens the group of every online CPU, or marks the table unavailable if there is none.
+ */
+static void open_table(PerfTable* table)
+{
+    table->initialized = true;
+    long configured = sysconf(_SC_NPROCESSORS_CONF);
+    if (sysroot_active() || configured <= 0)
+    {
+        table->unavailable = true;
+        return;
+    }
+
+    table->cpus = calloc((size_t)configured, sizeof(*table->cpus));
+    if (table->cpus == NULL)
+    {
+        perror("calloc");
+        table->unavailable = true;
+        return;
+    }
+
+    int error = 0;
+    for (int c = 0; c < configured; c++)
+    {
+        PerfCpu* cpu = &table->cpus[table->cpu_count];
+        cpu->cpu = c;
+        if (open_group(table, cpu) == 0)
+        {
+            table->cpu_count++;
+        }
+        else if (errno != ENODEV)
+        {
+            // Offline CPUs report ENODEV; anything else is worth telling
+            error = errno;
+        }
+    }
+
+    if (table->cpu_count == 0)
+    {
+        fprintf(stderr, "Hardware events are unavailable: %s\n", strerror(error != 0 ? error : ENODEV));
+        perf_table_free(table);
+        table->unavailable = true;
+    }
+}
+
+/**
+ * @brief Reads the group of one CPU and derives its ratios since the previous read.
+ */
+static void read_group(const PerfTable* table, PerfCpu* cpu)
+{
+    for (int r = 0; r < PERF_RATIO_COUNT; r++)
+    {
+        cpu->ratios[r] = NAN;
+    }
+
+    PerfGroupRead group;
+    ssize_t expected = (ssize_t)(offsetof(PerfGroupRead, values) + table->event_count * sizeof(uint64_t));
+    if (read(cpu->fds[PERF_CYCLES], &group, sizeof(group)) != expected || group.count != table->event_count)
+    {
+        cpu->has_previous = false;
+        return;
+    }
+
+    uint64_t deltas[PERF_EVENT_COUNT] = {0};
+    for (int e = 0, i = 0; e < PERF_EVENT_COUNT; e++)
+    {
+        if (table->opened[e])
+        {
+            deltas[e] = group.values[i] - cpu->previous[e];
+            cpu->previous[e] = group.values[i++];
+        }
+    }
+    uint64_t running = group.time_running - cpu->previous_running;
+    cpu->previous_running = group.time_running;
+    bool had_previous = cpu->has_previous;
+    cpu->has_previous = true;
+
+    // A group the PMU did not schedule in the interval, as when its counters are busy, has nothing to tell
+    if (!had_previous || running == 0 || deltas[PERF_CYCLES] == 0 || deltas[PERF_INSTRUCTIONS] == 0)
+    {
+        return;
+    }
+
+    double instructions = (double)deltas[PERF_INSTRUCTIONS];
+    cpu->ratios[PERF_IPC] = instructions / (double)deltas[PERF_CYCLES];
+    if (table->opened[PERF_CACHE_MISSES])
+    {
+        cpu->ratios[PERF_CACHE_MISSES_PER_KI] = (double)deltas[PERF_CACHE_MISSES] * PERF_PER_KI / instructions;
+    }
+    if (table->opened[PERF_BRANCH_MISSES])
+    {
+        cpu->ratios[PERF_BRANCH_MISSES_PER_KI] = (double)deltas[PERF_BRANCH_MISSES] * PERF_PER_KI / instructions;
+    }
+}
+
+int perf_table_read(PerfTable* table)
+{
+    if (!table->initialized)
+    {
+        open_table(table);
+    }
+    if (table->unavailable)
+    {
+        return RETURN_ERROR;
+    }
+
+    for (size_t i = 0; i < table->cpu_count; i++)
+    {
+        read_group(table, &table->cpus[i]);
+    }
+    return 0;
+}
+
+void perf_table_free(PerfTable* table)
+{
+    for (size_t i = 0; i < table->cpu_count; i++)
+    {
+        close_group(&table->cpus[i]);
+    }
+    free(table->cpus);
+    table->cpus = NULL;
+    table->cpu_count = 0;
+}
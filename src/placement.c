@@ -0,0 +1,276 @@
+/**
+ * @file placement.c
+ * @brief Functions for pinning the threads of the monitor to chosen CPUs and NUMA nodes and lowering their priority.
+ * @author 1v6n
+ * @date 15/10/2026
+ */
+
+#define _GNU_SOURCE
+
+#include "placement.h"
+#include "metrics.h"
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#define NODE_CPULIST_PATH "/sys/devices/system/node/node%ld/cpulist" /**< CPUs of a NUMA node. */
+#define PLACEMENT_CPULIST_SIZE 4096                                  /**< Longest cpulist read from sysfs. */
+#define PLACEMENT_MAX_NODES 1024                                     /**< Nodes covered by the memory policy mask. */
+#define BITS_PER_LONG (8 * sizeof(unsigned long))                    /**< Nodes held by one word of the mask. */
+#define IOPRIO_CLASS_SHIFT 13                                        /**< Position of the class in an I/O priority. */
+#define IOPRIO_CLASS_BE 2                                            /**< Best-effort I/O class. */
+#define IOPRIO_CLASS_IDLE 3                                          /**< Idle I/O class. */
+#define IOPRIO_BE_LEVELS 8                                           /**< Number of best-effort I/O levels. */
+#define IOPRIO_WHO_PROCESS 1                                         /**< ioprio_set target of a single thread. */
+
+/**
+ * @brief Structure to hold the placement of one role.
+ */
+typedef struct
+{
+    bool set;       /**< Whether the role was given CPUs or a node. */
+    cpu_set_t cpus; /**< CPUs of the role. */
+    long node;      /**< Node preferred for the memory of the role, or -1 for local allocation. */
+} RolePlacement;
+
+static const char* const role_envs[PLACEMENT_ROLES] = {COLLECTOR_CPUS_ENV, HTTP_CPUS_ENV}; /**< Setting of a role. */
+
+static RolePlacement roles[PLACEMENT_ROLES]; /**< Placement of every role. */
+static cpu_set_t startup_cpus;               /**< CPUs the process started with. */
+static bool startup_cpus_known;              /**< Whether startup_cpus could be read. */
+static bool memory_policy_set;               /**< Whether a role prefers a node, so the others must reset theirs. */
+
+/**
+ * @brief Parses a list of CPUs such as "0-3,8,10-11", as written to sysfs cpulist files.
+ *
+ * @return 0 on success, or -1 if the list is malformed or names a CPU past CPU_SETSIZE.
+ */
+static int parse_cpu_list(const char* list, cpu_set_t* cpus)
+{
+    CPU_ZERO(cpus);
+    const char* p = list;
+    while (*p != '\0' && *p != '\n')
+    {
+        char* end = NULL;
+        errno = 0;
+        unsigned long first = strtoul(p, &end, 10);
+        unsigned long last = first;
+        if (end == p || errno != 0)
+        {
+            return RETURN_ERROR;
+        }
+        p = end;
+        if (*p == '-')
+        {
+            last = strtoul(p + 1, &end, 10);
+            if (end == p + 1 || errno != 0 || last < first)
+            {
+                return RETURN_ERROR;
+            }
+            p = end;
+        }
+        if (last >= CPU_SETSIZE)
+        {
+            return RETURN_ERROR;
+        }
+        for (unsigned long cpu = first; cpu <= last; cpu++)
+        {
+            CPU_SET(cpu, cpus);
+        }
+        if (*p == ',')
+        {
+            p++;
+        }
+        else if (*p != '\0' && *p != '\n')
+        {
+            return RETURN_ERROR;
+        }
+    }
+    return CPU_COUNT(cpus) > 0 ? 0 : RETURN_ERROR;
+}
+
+/**
+ * @brief Reads the CPUs of a NUMA node from sysfs.
+ *
+ * @return 0 on success, or -1 if the node does not exist or has no CPU.
+ */
+static int read_node_cpus(long node, cpu_set_t* cpus)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), NODE_CPULIST_PATH, node);
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return RETURN_ERROR;
+    }
+    char list[PLACEMENT_CPULIST_SIZE];
+    int result = fgets(list, sizeof(list), file) != NULL ? parse_cpu_list(list, cpus) : RETURN_ERROR;
+    fclose(file);
+    return result;
+}
+
+/**
+ * @brief Reads the placement of a role from its environment variable.
+ *
+ * @return 0 on success or when the role is not placed, or -1 if the setting is invalid.
+ */
+static int read_role(PlacementRole role)
+{
+    RolePlacement* placement = &roles[role];
+    const char* env = role_envs[role];
+    const char* spec = getenv(env);
+    placement->node = -1;
+    if (spec == NULL || *spec == '\0')
+    {
+        return 0;
+    }
+
+    size_t prefix_len = strlen(PLACEMENT_NODE_PREFIX);
+    if (strncmp(spec, PLACEMENT_NODE_PREFIX, prefix_len) == 0)
+    {
+        char* end = NULL;
+        long node = strtol(spec + prefix_len, &end, 10);
+        if (end == spec + prefix_len || *end != '\0' || node < 0 || node >= PLACEMENT_MAX_NODES ||
+            read_node_cpus(node, &placement->cpus) != 0)
+        {
+            fprintf(stderr, "Invalid %s '%s': no such node with CPUs, the threads are not placed\n", env, spec);
+            return RETURN_ERROR;
+        }
+        placement->node = node;
+        memory_policy_set = true;
+    }
+    else if (parse_cpu_list(spec, &placement->cpus) != 0)
+    {
+        fprintf(stderr, "Invalid %s '%s', the threads are not placed\n", env, spec);
+        return RETURN_ERROR;
+    }
+    placement->set = true;
+    return 0;
+}
+
+/**
+ * @brief Lowers the scheduling priority of the calling thread as set by PRIORITY_ENV.
+ */
+static int apply_priority(void)
+{
+    const char* spec = getenv(PRIORITY_ENV);
+    if (spec == NULL || *spec == '\0')
+    {
+        return 0;
+    }
+
+    if (strcmp(spec, PLACEMENT_IDLE) == 0)
+    {
+        struct sched_param param = {.sched_priority = 0};
+        if (sched_setscheduler(0, SCHED_IDLE, &param) != 0)
+        {
+            fprintf(stderr, "Error switching to SCHED_IDLE: %s\n", strerror(errno));
+            return RETURN_ERROR;
+        }
+        return 0;
+    }
+
+    char* end = NULL;
+    long nice = strtol(spec, &end, 10);
+    if (end == spec || *end != '\0' || nice < PRIO_MIN || nice >= PRIO_MAX)
+    {
+        fprintf(stderr, "Invalid %s '%s', the priority is kept\n", PRIORITY_ENV, spec);
+        return RETURN_ERROR;
+    }
+    // On Linux this only changes the calling thread, which the threads started afterwards inherit
+    if (setpriority(PRIO_PROCESS, 0, (int)nice) != 0)
+    {
+        fprintf(stderr, "Error setting nice level %ld: %s\n", nice, strerror(errno));
+        return RETURN_ERROR;
+    }
+    return 0;
+}
+
+/**
+ * @brief Lowers the I/O priority of the calling thread as set by IO_PRIORITY_ENV.
+ */
+static int apply_io_priority(void)
+{
+    const char* spec = getenv(IO_PRIORITY_ENV);
+    if (spec == NULL || *spec == '\0')
+    {
+        return 0;
+    }
+
+    int ioprio;
+    if (strcmp(spec, PLACEMENT_IDLE) == 0)
+    {
+        ioprio = IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT;
+    }
+    else
+    {
+        char* end = NULL;
+        long level = strtol(spec, &end, 10);
+        if (end == spec || *end != '\0' || level < 0 || level >= IOPRIO_BE_LEVELS)
+        {
+            fprintf(stderr, "Invalid %s '%s', the I/O priority is kept\n", IO_PRIORITY_ENV, spec);
+            return RETURN_ERROR;
+        }
+        ioprio = IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT | (int)level;
+    }
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, ioprio) != 0)
+    {
+        fprintf(stderr, "Error setting the I/O priority: %s\n", strerror(errno));
+        return RETURN_ERROR;
+    }
+    return 0;
+}
+
+int placement_init(void)
+{
+    int result = 0;
+    startup_cpus_known = sched_getaffinity(0, sizeof(startup_cpus), &startup_cpus) == 0;
+    for (int role = 0; role < PLACEMENT_ROLES; role++)
+    {
+        if (read_role(role) != 0)
+        {
+            result = RETURN_ERROR;
+        }
+    }
+    if (apply_priority() != 0)
+    {
+        result = RETURN_ERROR;
+    }
+    if (apply_io_priority() != 0)
+    {
+        result = RETURN_ERROR;
+    }
+    return result;
+}
+
+int placement_apply(PlacementRole role)
+{
+    const RolePlacement* placement = &roles[role];
+    const cpu_set_t* cpus = placement->set ? &placement->cpus : startup_cpus_known ? &startup_cpus : NULL;
+    if (cpus != NULL && sched_setaffinity(0, sizeof(*cpus), cpus) != 0)
+    {
+        fprintf(stderr, "Error pinning the threads of %s: %s\n", role_envs[role], strerror(errno));
+        return RETURN_ERROR;
+    }
+
+    // The policy only affects pages touched afterwards, hence placing a thread before it allocates
+    if (placement->node >= 0)
+    {
+        unsigned long nodemask[PLACEMENT_MAX_NODES / BITS_PER_LONG] = {0};
+        nodemask[placement->node / BITS_PER_LONG] |= 1UL << (placement->node % BITS_PER_LONG);
+        // The kernel reads one bit less than maxnode
+        if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodemask, PLACEMENT_MAX_NODES + 1) != 0)
+        {
+            fprintf(stderr, "Error preferring node %ld: %s\n", placement->node, strerror(errno));
+            return RETURN_ERROR;
+        }
+    }
+    else if (memory_policy_set && syscall(SYS_set_mempolicy, MPOL_DEFAULT, NULL, 0) != 0)
+    {
+        fprintf(stderr, "Error resetting the memory policy: %s\n", strerror(errno));
+        return RETURN_ERROR;
+    }
+    return 0;
+}
@@ -0,0 +1,331 @@
+/**
+ * @file process_table.c
+ * @brief Functions for tracking per-process CPU and memory usage across monitoring cycles.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "process_table.h"
+
+/**
+ * @brief Structure to hold the context of a scan.
+ */
+typedef struct
+{
+    ProcessTable* table; /**< The table being refreshed. */
+    double elapsed;      /**< Seconds since the previous scan, or 0 on the first scan. */
+    int error;           /**< Set when an entry could not be allocated. */
+} ScanContext;
+
+static size_t hash_pid(pid_t pid, size_t slot_count)
+{
+    // Fibonacci hashing spreads consecutive PIDs over the whole table
+    return (size_t)(((uint64_t)(uint32_t)pid * 11400714819323198485ull) >> 32) & (slot_count - 1);
+}
+
+static void index_insert(ProcessEntry** slots, size_t slot_count, ProcessEntry* entry)
+{
+    size_t i = hash_pid(entry->pid, slot_count);
+    while (slots[i] != NULL)
+    {
+        i = (i + 1) & (slot_count - 1);
+    }
+    slots[i] = entry;
+}
+
+static ProcessEntry* index_find(const ProcessTable* table, pid_t pid, unsigned long long start_time)
+{
+    size_t i = hash_pid(pid, table->slot_count);
+    while (table->slots[i] != NULL)
+    {
+        ProcessEntry* entry = table->slots[i];
+        if (entry->pid == pid && entry->start_time == start_time)
+        {
+            return entry;
+        }
+        i = (i + 1) & (table->slot_count - 1);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Rebuilds the index from the live entries, growing it if needed.
+ *
+ * Rebuilding after a bulk eviction keeps the probe sequences free of tombstones.
+ */
+static int index_rebuild(ProcessTable* table, size_t slot_count)
+{
+    ProcessEntry** slots = calloc(slot_count, sizeof(*slots));
+    if (slots == NULL)
+    {
+        perror("calloc");
+        return RETURN_ERROR;
+    }
+
+    for (ProcessSlab* slab = table->slabs; slab != NULL; slab = slab->next)
+    {
+        for (size_t i = 0; i < PROCESS_SLAB_SIZE; i++)
+        {
+            if (slab->entries[i].generation != 0)
+            {
+                index_insert(slots, slot_count, &slab->entries[i]);
+            }
+        }
+    }
+
+    free(table->slots);
+    table->slots = slots;
+    table->slot_count = slot_count;
+    return 0;
+}
+
+static ProcessEntry* allocate_entry(ProcessTable* table)
+{
+    if (table->free_list == NULL)
+    {
+        ProcessSlab* slab = calloc(1, sizeof(*slab));
+        if (slab == NULL)
+        {
+            perror("calloc");
+            return NULL;
+        }
+
+        for (size_t i = PROCESS_SLAB_SIZE; i > 0; i--)
+        {
+            slab->entries[i - 1].next_free = table->free_list;
+            table->free_list = &slab->entries[i - 1];
+        }
+        slab->next = table->slabs;
+        table->slabs = slab;
+    }
+
+    ProcessEntry* entry = table->free_list;
+    table->free_list = entry->next_free;
+    entry->next_free = NULL;
+    return entry;
+}
+
+/**
+ * @brief Skips the given number of space-separated fields.
+ */
+static const char* skip_fields(const char* p, int count)
+{
+    while (count-- > 0 && p != NULL)
+    {
+        p = strchr(p, ' ');
+        if (p != NULL)
+        {
+            p++;
+        }
+    }
+    return p;
+}
+
+static unsigned long long parse_field(const char** p)
+{
+    char* end;
+    unsigned long long value = strtoull(*p, &end, 10);
+    *p = (*end == ' ') ? end + 1 : end;
+    return value;
+}
+
+static void refresh_process(const char* pid, const char* fields, size_t len, void* ctx)
+{
+    (void)len;
+    ScanContext* scan = ctx;
+    ProcessTable* table = scan->table;
+
+    // fields starts at the state (field 3); utime and stime are fields 14 and 15, starttime and rss 22 and 24
+    char state = fields[0];
+    const char* p = skip_fields(fields, 11);
+    if (p == NULL)
+    {
+        return;
+    }
+    unsigned long long utime = parse_field(&p);
+    unsigned long long stime = parse_field(&p);
+    p = skip_fields(p, 6);
+    if (p == NULL)
+    {
+        return;
+    }
+    unsigned long long start_time = parse_field(&p);
+    p = skip_fields(p, 1);
+    if (p == NULL)
+    {
+        return;
+    }
+    unsigned long long rss_pages = parse_field(&p);
+
+    process_state_counts_add(&table->counts, state);
+
+    pid_t process_id = (pid_t)strtol(pid, NULL, 10);
+    unsigned long long cpu_time = utime + stime;
+    ProcessEntry* entry = index_find(table, process_id, start_time);
+    if (entry == NULL)
+    {
+        if ((double)(table->entry_count + 1) > (double)table->slot_count * PROCESS_TABLE_MAX_LOAD &&
+            index_rebuild(table, table->slot_count * 2) != 0)
+        {
+            scan->error = 1;
+            return;
+        }
+
+        entry = allocate_entry(table);
+        if (entry == NULL)
+        {
+            scan->error = 1;
+            return;
+        }
+
+        entry->pid = process_id;
+        entry->start_time = start_time;
+        entry->prev_cpu_time = cpu_time;
+        index_insert(table->slots, table->slot_count, entry);
+        table->entry_count++;
+    }
+    else
+    {
+        entry->prev_cpu_time = entry->utime + entry->stime;
+    }
+
+    entry->utime = utime;
+    entry->stime = stime;
+    entry->rss_pages = rss_pages;
+    entry->state = state;
+    entry->generation = table->generation;
+    entry->cpu_percentage = 0;
+    if (scan->elapsed > 0 && cpu_time >= entry->prev_cpu_time)
+    {
+        entry->cpu_percentage =
+            ((double)(cpu_time - entry->prev_cpu_time) / table->clock_ticks) / scan->elapsed * PERCENTAGE;
+    }
+}
+
+/**
+ * @brief Returns every entry that was not refreshed by the current scan to the free list.
+ *
+ * @return The number of evicted entries.
+ */
+static size_t evict_dead_entries(ProcessTable* table)
+{
+    size_t evicted = 0;
+    for (ProcessSlab* slab = table->slabs; slab != NULL; slab = slab->next)
+    {
+        for (size_t i = 0; i < PROCESS_SLAB_SIZE; i++)
+        {
+            ProcessEntry* entry = &slab->entries[i];
+            if (entry->generation != 0 && entry->generation != table->generation)
+            {
+                entry->generation = 0;
+                entry->next_free = table->free_list;
+                table->free_list = entry;
+                evicted++;
+            }
+        }
+    }
+    table->entry_count -= evicted;
+    return evicted;
+}
+
+int process_table_init(ProcessTable* table)
+{
+    memset(table, 0, sizeof(*table));
+
+    table->slots = calloc(PROCESS_TABLE_INITIAL_SLOTS, sizeof(*table->slots));
+    if (table->slots == NULL)
+    {
+        perror("calloc");
+        return RETURN_ERROR;
+    }
+
+    table->slot_count = PROCESS_TABLE_INITIAL_SLOTS;
+    table->clock_ticks = (double)sysconf(_SC_CLK_TCK);
+    table->page_size = sysconf(_SC_PAGESIZE);
+    return 0;
+}
+
+void process_table_destroy(ProcessTable* table)
+{
+    ProcessSlab* slab = table->slabs;
+    while (slab != NULL)
+    {
+        ProcessSlab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+int process_table_scan(ProcessTable* table)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    ScanContext scan = {table, 0, 0};
+    if (table->generation != 0)
+    {
+        scan.elapsed =
+            (double)(now.tv_sec - table->last_scan.tv_sec) + (double)(now.tv_nsec - table->last_scan.tv_nsec) / 1e9;
+    }
+
+    // Generation 0 marks unused entries, so it is skipped when the counter wraps
+    table->generation++;
+    if (table->generation == 0)
+    {
+        table->generation = 1;
+    }
+
+    memset(&table->counts, 0, sizeof(table->counts));
+    if (for_each_pid_stat(PID_STAT_FULL_BUFFER_SIZE, refresh_process, &scan) != 0)
+    {
+        return RETURN_ERROR;
+    }
+    table->last_scan = now;
+
+    if (evict_dead_entries(table) > 0 && index_rebuild(table, table->slot_count) != 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    return scan.error ? RETURN_ERROR : 0;
+}
+
+static double rank_value(const ProcessEntry* entry, ProcessRankKey key)
+{
+    return key == PROCESS_RANK_CPU ? entry->cpu_percentage : (double)entry->rss_pages;
+}
+
+size_t process_table_top(const ProcessTable* table, ProcessRankKey key, const ProcessEntry** top, size_t n)
+{
+    size_t count = 0;
+    for (const ProcessSlab* slab = table->slabs; slab != NULL; slab = slab->next)
+    {
+        for (size_t i = 0; i < PROCESS_SLAB_SIZE; i++)
+        {
+            const ProcessEntry* entry = &slab->entries[i];
+            if (entry->generation == 0)
+            {
+                continue;
+            }
+
+            double value = rank_value(entry, key);
+            if (count == n && (n == 0 || value <= rank_value(top[n - 1], key)))
+            {
+                continue;
+            }
+
+            // Insertion into the short sorted array, dropping the lowest entry when full
+            size_t pos = count < n ? count++ : n - 1;
+            while (pos > 0 && rank_value(top[pos - 1], key) < value)
+            {
+                top[pos] = top[pos - 1];
+                pos--;
+            }
+            top[pos] = entry;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file psi.c
+ * @brief Functions for reading Pressure Stall Information and arming PSI triggers.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "psi.h"
+#include "metrics.h"
+#include "source_cache.h"
+#include "sysroot.h"
+#include <errno.h>
+
+const char* const psi_resource_names[PSI_RESOURCE_COUNT] = {"cpu", "memory", "io"};
+const char* const psi_kind_names[PSI_KIND_COUNT] = {"some", "full"};
+const char* const psi_window_names[PSI_WINDOW_COUNT] = {"10", "60", "300"};
+
+static const char* const psi_paths[PSI_RESOURCE_COUNT] = {PSI_CPU_PATH, PSI_MEMORY_PATH,
+                                                          PSI_IO_PATH}; /**< PSI files, indexed by PsiResource. */
+
+/**
+ * @brief Parses the fields of a PSI line that follow its kind.
+ *
+ * @param p The fields, as in " avg10=0.00 avg60=0.00 avg300=0.00 total=0".
+ * @param line Pointer to store the parsed line.
+ */
+static void parse_psi_line(const char* p, PsiLine* line)
+{
+    static const char* const keys[PSI_WINDOW_COUNT] = {"avg10=", "avg60=", "avg300="};
+
+    line->valid = true;
+    for (int w = 0; w < PSI_WINDOW_COUNT; w++)
+    {
+        const char* field = strstr(p, keys[w]);
+        line->avg[w] = field != NULL ? strtod(field + strlen(keys[w]), NULL) : 0.0;
+        line->valid &= field != NULL;
+    }
+
+    const char* total = strstr(p, "total=");
+    line->total_us = total != NULL ? strtoull(total + strlen("total="), NULL, 10) : 0;
+    line->valid &= total != NULL;
+}
+
+/**
+ * @brief Reads the PSI file of one resource.
+ *
+ * @return 0 on success, or -1 if the file cannot be read.
+ */
+static int read_psi_resource(PsiSnapshot* snapshot, PsiResource resource)
+{
+    PsiLine* lines = snapshot->lines[resource];
+    for (int k = 0; k < PSI_KIND_COUNT; k++)
+    {
+        lines[k].valid = false;
+    }
+
+    const char* buffer = source_cache_read(psi_paths[resource], NULL);
+    if (buffer == NULL)
+    {
+        return RETURN_ERROR;
+    }
+
+    // The full line of cpu only exists since Linux 5.13, so every line is optional
+    for (const char* line = buffer; *line != '\0';)
+    {
+        for (int k = 0; k < PSI_KIND_COUNT; k++)
+        {
+            size_t len = strlen(psi_kind_names[k]);
+            if (strncmp(line, psi_kind_names[k], len) == 0 && line[len] == ' ')
+            {
+                parse_psi_line(line + len, &lines[k]);
+            }
+        }
+
+        const char* next = strchr(line, '\n');
+        if (next == NULL)
+        {
+            break;
+        }
+        line = next + 1;
+    }
+    return 0;
+}
+
+int read_psi_snapshot(PsiSnapshot* snapshot)
+{
+    int ret = RETURN_ERROR;
+    for (int r = 0; r < PSI_RESOURCE_COUNT; r++)
+    {
+        if (snapshot->unavailable[r])
+        {
+            continue;
+        }
+
+        if (read_psi_resource(snapshot, (PsiResource)r) == 0)
+        {
+            ret = 0;
+        }
+        else if (access(psi_paths[r], F_OK) != 0)
+        {
+            // Kernels built without CONFIG_PSI, or booted with psi=0, have no /proc/pressure
+            snapshot->unavailable[r] = true;
+        }
+    }
+    return ret;
+}
+
+int psi_trigger_open(PsiResource resource, const char* spec)
+{
+    // Writing a trigger into a replayed snapshot would only overwrite the recorded file
+    if (sysroot_active())
+    {
+        return RETURN_ERROR;
+    }
+
+    int fd = open(psi_paths[resource], O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    // The kernel parses the trigger from the written string, including its terminating NUL
+    if (write(fd, spec, strlen(spec) + 1) < 0)
+    {
+        fprintf(stderr, "Error arming the %s pressure trigger '%s': %s\n", psi_resource_names[resource], spec,
+                strerror(errno));
+        close(fd);
+        return RETURN_ERROR;
+    }
+    return fd;
+}
@@ -0,0 +1,258 @@
+/**
+ * @file rate.c
+ * @brief Functions for the per-second rates derived from chosen counters.
+ * @author 1v6n
+ * @date 15/10/2026
+ */
+
+#include "rate.h"
+#include "metrics.h"
+#include "rollup.h"
+#include <math.h>
+
+#define RATE_FNV_OFFSET 14695981039346656037ull /**< FNV-1a offset basis. */
+#define RATE_FNV_PRIME 1099511628211ull         /**< FNV-1a prime. */
+#define RATE_WRAP_LIMIT (1ull << 31)            /**< Largest increment modulo 2^32 taken for a 32-bit wrap. */
+#define NS_PER_SECOND 1e9                       /**< Nanoseconds in a second. */
+
+static uint64_t hash_series(const char* name, size_t len)
+{
+    uint64_t hash = RATE_FNV_OFFSET;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ (unsigned char)name[i]) * RATE_FNV_PRIME;
+    }
+    return hash;
+}
+
+static int64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * @brief Grows every array of a rate to hold at least a number of series, clearing the new entries.
+ */
+static int reserve_series(Rate* rate, size_t count)
+{
+    if (count <= rate->capacity)
+    {
+        return 0;
+    }
+    size_t capacity = rate->capacity > 0 ? rate->capacity : RATE_INITIAL_SERIES;
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+
+    // Every array that grew is kept, so a failure halfway leaves the rate consistent at its old capacity
+#define RATE_GROW(field)                                                                                               \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        __typeof__(rate->field) grown = realloc(rate->field, capacity * sizeof(*grown));                               \
+        if (grown == NULL)                                                                                             \
+        {                                                                                                              \
+            perror("realloc");                                                                                         \
+            return RETURN_ERROR;                                                                                       \
+        }                                                                                                              \
+        memset(grown + rate->capacity, 0, (capacity - rate->capacity) * sizeof(*grown));                               \
+        rate->field = grown;                                                                                           \
+    } while (0)
+
+    RATE_GROW(hashes);
+    RATE_GROW(previous);
+    RATE_GROW(current);
+    RATE_GROW(valid);
+    RATE_GROW(previous_ns);
+    RATE_GROW(rates);
+    RATE_GROW(label_values);
+    RATE_GROW(samples);
+#undef RATE_GROW
+    rate->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Forgets the series at a position, removing it from the rate gauge.
+ */
+static void clear_position(Rate* rate, size_t index)
+{
+    if (rate->samples[index] != NULL)
+    {
+        prom_gauge_remove(rate->gauge, (const char**)rate->label_values[index]);
+        rate->samples[index] = NULL;
+    }
+    series_label_values_free(rate->label_values[index], rate->label_count);
+    rate->label_values[index] = NULL;
+    rate->hashes[index] = 0;
+    rate->previous_ns[index] = 0;
+}
+
+/**
+ * @brief Copies the value of a series read by the visit to its position; only those of its last pass are derived.
+ */
+static void stage_sample(size_t index, const prom_sample_view_t* view, void* arg)
+{
+    Rate* rate = arg;
+    if (reserve_series(rate, index + 1) != 0)
+    {
+        return;
+    }
+
+    uint64_t hash = hash_series(view->series, view->series_len);
+    if (index >= rate->count || rate->hashes[index] != hash)
+    {
+        // A series appeared, or the one at this position left the counter and the next ones moved up
+        clear_position(rate, index);
+        rate->hashes[index] = hash;
+        if (rate->label_count > 0 &&
+            (rate->label_values[index] = series_label_values(view->series, view->series_len, rate->label_count,
+                                                             rate->label_keys)) == NULL)
+        {
+            fprintf(stderr, "Error parsing the labels of a series of %s, not publishing its rate\n", rate->name);
+        }
+        rate->count = index >= rate->count ? index + 1 : rate->count;
+    }
+    // A counter never holds -1 but after a failed read, and deriving a rate from it would publish two bogus points
+    rate->valid[index] = view->integer ? view->u_value != UINT64_MAX : view->value >= 0.0;
+    rate->current[index] = view->integer ? view->u_value : rate->valid[index] ? (uint64_t)view->value : 0;
+}
+
+/**
+ * @brief Derives the rate of every series from its current and previous values, then makes the current ones previous.
+ *
+ * A series whose current value is not valid keeps its previous value and time, and gets no rate.
+ *
+ * Conditions are combined with bitwise operators and chosen with selects, so that the loop has no data-dependent branch
+ * for counters that wrap or reset at random.
+ */
+static void compute_rates(Rate* rate, int64_t now_ns)
+{
+    uint64_t* restrict previous = rate->previous;
+    const uint64_t* restrict current = rate->current;
+    const bool* restrict valid = rate->valid;
+    int64_t* restrict previous_ns = rate->previous_ns;
+    double* restrict rates = rate->rates;
+    size_t count = rate->count;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t prev = previous[i];
+        uint64_t cur = current[i];
+        uint64_t increase = cur - prev;
+        uint64_t wrapped = (uint32_t)increase;
+        bool wrap = (prev <= UINT32_MAX) & (cur <= UINT32_MAX) & (wrapped < RATE_WRAP_LIMIT);
+        uint64_t delta = cur >= prev ? increase : (wrap ? wrapped : cur);
+        int64_t elapsed_ns = now_ns - previous_ns[i];
+        bool known = (previous_ns[i] != 0) & (elapsed_ns > 0) & valid[i];
+        double value = (double)delta * NS_PER_SECOND / (double)(known ? elapsed_ns : 1);
+        rates[i] = known ? value : NAN;
+        previous[i] = valid[i] ? cur : prev;
+        previous_ns[i] = valid[i] ? now_ns : previous_ns[i];
+    }
+}
+
+/**
+ * @brief Publishes the rate of every series that has one.
+ */
+static void publish_rates(Rate* rate)
+{
+    // The rates of one counter come from the same run, so a scrape sees all of them or none
+    prom_gauge_batch_begin();
+    for (size_t i = 0; i < rate->count; i++)
+    {
+        if (isnan(rate->rates[i]) || (rate->label_count > 0 && rate->label_values[i] == NULL))
+        {
+            continue;
+        }
+        if (rate->samples[i] == NULL)
+        {
+            rate->samples[i] = prom_gauge_with_labels(rate->gauge, (const char**)rate->label_values[i]);
+        }
+        if (rate->samples[i] == NULL || prom_metric_sample_set(rate->samples[i], rate->rates[i]) != 0)
+        {
+            fprintf(stderr, "Error publishing %s\n", rate->name);
+        }
+    }
+    prom_gauge_batch_end();
+}
+
+int rate_register(Rate* rate, const char* name, const char* description, size_t label_count, const char** label_keys)
+{
+    int result = 0;
+    pthread_mutex_lock(&rate->mutex);
+    if (!rate->open)
+    {
+        size_t len = strlen(name);
+        size_t suffix_len = strlen(RATE_SUFFIX);
+        if (len >= suffix_len && strcmp(name + len - suffix_len, RATE_SUFFIX) == 0)
+        {
+            len -= suffix_len;
+        }
+        snprintf(rate->name, sizeof(rate->name), "%.*s_per_second", (int)len, name);
+        snprintf(rate->help, sizeof(rate->help), "%s, per second", description);
+        rate->label_count = label_count;
+        rate->label_keys = label_keys;
+        rate->gauge = prom_gauge_new(rate->name, rate->help, label_count, label_keys);
+        if (rate->gauge == NULL)
+        {
+            fprintf(stderr, "Error creating metric '%s'\n", rate->name);
+            result = RETURN_ERROR;
+        }
+        rate->open = true;
+    }
+
+    if (result == 0 && prom_collector_registry_register_metric((prom_metric_t*)rate->gauge) != 0)
+    {
+        fprintf(stderr, "Error registering metric '%s'\n", rate->name);
+        result = RETURN_ERROR;
+    }
+    pthread_mutex_unlock(&rate->mutex);
+    return result;
+}
+
+int rate_unregister(Rate* rate)
+{
+    int result = 0;
+    pthread_mutex_lock(&rate->mutex);
+    if (rate->open && rate->gauge != NULL && prom_collector_registry_unregister_metric((prom_metric_t*)rate->gauge))
+    {
+        fprintf(stderr, "Error unregistering metric '%s'\n", rate->name);
+        result = RETURN_ERROR;
+    }
+    pthread_mutex_unlock(&rate->mutex);
+    return result;
+}
+
+void rate_observe(Rate* rate, prom_counter_t* source)
+{
+    pthread_mutex_lock(&rate->mutex);
+    if (!rate->open || rate->gauge == NULL)
+    {
+        pthread_mutex_unlock(&rate->mutex);
+        return;
+    }
+
+    // One time stands for the whole run, as the collector read every series at once
+    int64_t now_ns = monotonic_ns();
+    size_t visited = 0;
+    if (prom_metric_visit_samples((prom_metric_t*)source, stage_sample, rate, &visited) != 0)
+    {
+        fprintf(stderr, "Error reading the samples of %s\n", rate->name);
+        pthread_mutex_unlock(&rate->mutex);
+        return;
+    }
+
+    // Series past the last pass left the counter
+    visited = visited < rate->capacity ? visited : rate->capacity;
+    for (size_t i = visited; i < rate->count; i++)
+    {
+        clear_position(rate, i);
+    }
+    rate->count = visited;
+
+    compute_rates(rate, now_ns);
+    publish_rates(rate);
+    pthread_mutex_unlock(&rate->mutex);
+}
@@ -0,0 +1,952 @@
+/**
+ * @file remote_write.c
+ * @brief Functions for pushing every series to a Prometheus remote-write endpoint.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "remote_write.h"
+#include "metrics.h"
+#include <errno.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define REMOTE_WRITE_MAX_LABELS 32                      /**< Most labels of a series, including its name. */
+#define REMOTE_WRITE_RESPONSE_SIZE 512                  /**< Bytes of the response read to find its status. */
+#define SNAPPY_BLOCK_SIZE 65536                         /**< Input compressed at a time, so offsets fit in 16 bits. */
+#define SNAPPY_HASH_BITS 14                             /**< Bits of the match finder hash. */
+#define REMOTE_WRITE_FNV_OFFSET 14695981039346656037ull /**< FNV-1a offset basis. */
+#define REMOTE_WRITE_FNV_PRIME 1099511628211ull         /**< FNV-1a prime. */
+
+static const char* samples_label_keys[] = {"result"}; /**< Label keys of the samples counter. */
+
+/**
+ * @brief Structure to hold a growable byte buffer.
+ */
+typedef struct
+{
+    uint8_t* data;   /**< The bytes. */
+    size_t len;      /**< Number of bytes used. */
+    size_t capacity; /**< Number of bytes allocated. */
+} ByteBuffer;
+
+/**
+ * @brief Structure to hold a label parsed out of a series.
+ */
+typedef struct
+{
+    const char* name;  /**< Label name, "__name__" for the metric name. */
+    size_t name_len;   /**< Length of name. */
+    const char* value; /**< Label value. */
+    size_t value_len;  /**< Length of value. */
+} ParsedLabel;
+
+static int buffer_reserve(ByteBuffer* buffer, size_t extra)
+{
+    if (buffer->len + extra <= buffer->capacity)
+    {
+        return 0;
+    }
+    size_t capacity = buffer->capacity > 0 ? buffer->capacity : 4096;
+    while (capacity < buffer->len + extra)
+    {
+        capacity *= 2;
+    }
+    uint8_t* data = realloc(buffer->data, capacity);
+    if (data == NULL)
+    {
+        perror("realloc");
+        return RETURN_ERROR;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return 0;
+}
+
+static size_t varint_len(uint64_t value)
+{
+    size_t len = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        len++;
+    }
+    return len;
+}
+
+/**
+ * @brief Appends a varint; the caller has reserved the room.
+ */
+static void put_varint(ByteBuffer* buffer, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        buffer->data[buffer->len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer->data[buffer->len++] = (uint8_t)value;
+}
+
+static void put_bytes(ByteBuffer* buffer, const void* bytes, size_t len)
+{
+    memcpy(buffer->data + buffer->len, bytes, len);
+    buffer->len += len;
+}
+
+/**
+ * @brief Undoes the \\, \" and \n escapes of a label value in place, up to its closing quote.
+ *
+ * @param p First byte of the value.
+ * @param last Closing brace of the series.
+ * @param len Set to the length of the unescaped value.
+ * @return The closing quote, or NULL if the value has none before last.
+ */
+static char* unescape_value(char* p, const char* last, size_t* len)
+{
+    char* out = p;
+    char* value = p;
+    while (p < last && *p != '"')
+    {
+        if (*p == '\\' && p + 1 < last)
+        {
+            p++;
+            *out++ = *p == 'n' ? '\n' : *p;
+        }
+        else
+        {
+            *out++ = *p;
+        }
+        p++;
+    }
+    *len = (size_t)(out - value);
+    return p < last ? p : NULL;
+}
+
+/**
+ * @brief Splits a series of the text exposition into its labels, with the metric name as __name__.
+ *
+ * The client library escapes backslashes, double quotes and line feeds in label values; they are unescaped in place,
+ * so series is modified.
+ *
+ * @param series The series, such as name{key="value",...}.
+ * @param len Length of series.
+ * @param labels Receives the labels, pointing into series.
+ * @return Number of labels, or 0 if the series cannot be parsed.
+ */
+static size_t parse_labels(char* series, size_t len, ParsedLabel* labels)
+{
+    const char* end = series + len;
+    const char* brace = memchr(series, '{', len);
+    const char* name_end = brace != NULL ? brace : end;
+    if (name_end == series || (brace != NULL && end[-1] != '}'))
+    {
+        return 0;
+    }
+    labels[0] = (ParsedLabel){"__name__", strlen("__name__"), series, (size_t)(name_end - series)};
+    size_t count = 1;
+
+    char* p = brace != NULL ? (char*)brace + 1 : (char*)end;
+    const char* last = end - 1;
+    while (p < last)
+    {
+        const char* key = p;
+        while (p < last && *p != '=')
+        {
+            p++;
+        }
+        if (p + 1 >= last || p[1] != '"' || count == REMOTE_WRITE_MAX_LABELS)
+        {
+            return 0;
+        }
+        size_t key_len = (size_t)(p - key);
+        char* value = p + 2;
+        size_t value_len = 0;
+
+        p = unescape_value(value, last, &value_len);
+        if (p == NULL)
+        {
+            return 0;
+        }
+        labels[count++] = (ParsedLabel){key, key_len, value, value_len};
+        p += p + 1 < last ? 2 : 1;
+    }
+    return count;
+}
+
+static int compare_labels(const ParsedLabel* a, const ParsedLabel* b)
+{
+    size_t len = a->name_len < b->name_len ? a->name_len : b->name_len;
+    int result = memcmp(a->name, b->name, len);
+    return result != 0 ? result : (a->name_len > b->name_len) - (a->name_len < b->name_len);
+}
+
+/**
+ * @brief Encodes the labels of a series as the labels fields of a TimeSeries message, sorted by name.
+ *
+ * @return 0 on success, or -1 if the series cannot be parsed or memory runs out.
+ */
+static int encode_labels(RemoteSeries* series, size_t len)
+{
+    // The labels point into a copy, since their values are unescaped in place
+    char* copy = strndup(series->name, len);
+    if (copy == NULL)
+    {
+        perror("strndup");
+        return RETURN_ERROR;
+    }
+    ParsedLabel labels[REMOTE_WRITE_MAX_LABELS];
+    size_t count = parse_labels(copy, len, labels);
+    if (count == 0)
+    {
+        free(copy);
+        return RETURN_ERROR;
+    }
+
+    // Insertion sort; remote-write requires the labels in name order
+    for (size_t i = 1; i < count; i++)
+    {
+        ParsedLabel label = labels[i];
+        size_t j = i;
+        while (j > 0 && compare_labels(&labels[j - 1], &label) > 0)
+        {
+            labels[j] = labels[j - 1];
+            j--;
+        }
+        labels[j] = label;
+    }
+
+    ByteBuffer buffer = {0};
+    for (size_t i = 0; i < count; i++)
+    {
+        // Label { string name = 1; string value = 2; }, as field 1 of TimeSeries
+        size_t message_len = 1 + varint_len(labels[i].name_len) + labels[i].name_len + 1 +
+                             varint_len(labels[i].value_len) + labels[i].value_len;
+        if (buffer_reserve(&buffer, 1 + varint_len(message_len) + message_len) != 0)
+        {
+            free(buffer.data);
+            free(copy);
+            return RETURN_ERROR;
+        }
+        put_varint(&buffer, 0x0a);
+        put_varint(&buffer, message_len);
+        put_varint(&buffer, 0x0a);
+        put_varint(&buffer, labels[i].name_len);
+        put_bytes(&buffer, labels[i].name, labels[i].name_len);
+        put_varint(&buffer, 0x12);
+        put_varint(&buffer, labels[i].value_len);
+        put_bytes(&buffer, labels[i].value, labels[i].value_len);
+    }
+    free(copy);
+    series->labels = buffer.data;
+    series->labels_len = buffer.len;
+    return 0;
+}
+
+static uint64_t hash_series(const char* name, size_t len)
+{
+    uint64_t hash = REMOTE_WRITE_FNV_OFFSET;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ (unsigned char)name[i]) * REMOTE_WRITE_FNV_PRIME;
+    }
+    return hash;
+}
+
+static void index_insert(RemoteSeries** slots, size_t slot_count, RemoteSeries* series)
+{
+    size_t i = (size_t)series->hash & (slot_count - 1);
+    while (slots[i] != NULL)
+    {
+        i = (i + 1) & (slot_count - 1);
+    }
+    slots[i] = series;
+}
+
+static int index_grow(RemoteWrite* remote)
+{
+    size_t slot_count = remote->slot_count * 2;
+    RemoteSeries** slots = calloc(slot_count, sizeof(*slots));
+    if (slots == NULL)
+    {
+        perror("calloc");
+        return RETURN_ERROR;
+    }
+    for (size_t i = 0; i < remote->series_count; i++)
+    {
+        index_insert(slots, slot_count, remote->series[i]);
+    }
+    free(remote->slots);
+    remote->slots = slots;
+    remote->slot_count = slot_count;
+    return 0;
+}
+
+/**
+ * @brief Returns a series, adding it with its encoded labels on first sight.
+ *
+ * Series that cannot be parsed are added without labels, so they are only rejected once, and never queued.
+ */
+static RemoteSeries* find_series(RemoteWrite* remote, const char* name, size_t len)
+{
+    uint64_t hash = hash_series(name, len);
+    size_t i = (size_t)hash & (remote->slot_count - 1);
+    while (remote->slots[i] != NULL)
+    {
+        RemoteSeries* series = remote->slots[i];
+        if (series->hash == hash && strncmp(series->name, name, len) == 0 && series->name[len] == '\0')
+        {
+            return series;
+        }
+        i = (i + 1) & (remote->slot_count - 1);
+    }
+
+    if ((double)(remote->series_count + 1) > (double)remote->slot_count * REMOTE_WRITE_MAX_LOAD &&
+        index_grow(remote) != 0)
+    {
+        return NULL;
+    }
+    if (remote->series_count == remote->series_capacity)
+    {
+        size_t capacity = remote->series_capacity > 0 ? remote->series_capacity * 2 : REMOTE_WRITE_INITIAL_SLOTS;
+        RemoteSeries** list = realloc(remote->series, capacity * sizeof(*list));
+        if (list == NULL)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        remote->series = list;
+        remote->series_capacity = capacity;
+    }
+
+    RemoteSeries* series = calloc(1, sizeof(*series));
+    char* copy = malloc(len + 1);
+    if (series == NULL || copy == NULL)
+    {
+        perror("malloc");
+        free(series);
+        free(copy);
+        return NULL;
+    }
+    memcpy(copy, name, len);
+    copy[len] = '\0';
+    series->name = copy;
+    series->hash = hash;
+    if (encode_labels(series, len) != 0)
+    {
+        fprintf(stderr, "Error encoding the labels of %s, not pushing it\n", copy);
+    }
+    remote->series[remote->series_count++] = series;
+    index_insert(remote->slots, remote->slot_count, series);
+    return series;
+}
+
+/**
+ * @brief Keeps the value of a series read by the snapshot; only those staged in the current pass are queued.
+ */
+static void stage_sample(size_t index, const prom_sample_view_t* view, void* arg)
+{
+    RemoteWrite* remote = arg;
+    (void)index;
+    RemoteSeries* series = find_series(remote, view->series, view->series_len);
+    if (series != NULL)
+    {
+        series->pending = view->integer ? (double)view->u_value : view->value;
+        series->pending_pass = remote->pass;
+    }
+}
+
+static uint32_t load32(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static void snappy_literal(ByteBuffer* out, const uint8_t* literal, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    size_t n = len - 1;
+    if (n < 60)
+    {
+        out->data[out->len++] = (uint8_t)(n << 2);
+    }
+    else if (n < 256)
+    {
+        out->data[out->len++] = 60 << 2;
+        out->data[out->len++] = (uint8_t)n;
+    }
+    else
+    {
+        // Literals never span more than a block, so two bytes of length are enough
+        out->data[out->len++] = 61 << 2;
+        out->data[out->len++] = (uint8_t)n;
+        out->data[out->len++] = (uint8_t)(n >> 8);
+    }
+    put_bytes(out, literal, len);
+}
+
+static void snappy_copy(ByteBuffer* out, size_t offset, size_t len)
+{
+    // Copies hold at most 64 bytes; the split leaves at least 4 for the last one
+    while (len >= 68)
+    {
+        out->data[out->len++] = (uint8_t)(2 | (63 << 2));
+        out->data[out->len++] = (uint8_t)offset;
+        out->data[out->len++] = (uint8_t)(offset >> 8);
+        len -= 64;
+    }
+    if (len > 64)
+    {
+        out->data[out->len++] = (uint8_t)(2 | (59 << 2));
+        out->data[out->len++] = (uint8_t)offset;
+        out->data[out->len++] = (uint8_t)(offset >> 8);
+        len -= 60;
+    }
+
+    if (len <= 11 && offset < 2048)
+    {
+        out->data[out->len++] = (uint8_t)(1 | ((len - 4) << 2) | ((offset >> 8) << 5));
+        out->data[out->len++] = (uint8_t)offset;
+    }
+    else
+    {
+        out->data[out->len++] = (uint8_t)(2 | ((len - 1) << 2));
+        out->data[out->len++] = (uint8_t)offset;
+        out->data[out->len++] = (uint8_t)(offset >> 8);
+    }
+}
+
+/**
+ * @brief Compresses a buffer into the snappy block format.
+ *
+ * Matches of at least four bytes are found through a hash of the next four bytes, within the current 64 KiB block.
+ *
+ * @return 0 on success, or -1 if memory runs out.
+ */
+static int snappy_compress(const uint8_t* input, size_t len, ByteBuffer* out)
+{
+    out->len = 0;
+    if (buffer_reserve(out, 32 + len + len / 6) != 0)
+    {
+        return RETURN_ERROR;
+    }
+    put_varint(out, len);
+
+    // Stale positions are harmless: a candidate is only used once its four bytes compare equal
+    static _Thread_local uint32_t table[1 << SNAPPY_HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    for (size_t block = 0; block < len; block += SNAPPY_BLOCK_SIZE)
+    {
+        size_t block_end = len - block > SNAPPY_BLOCK_SIZE ? block + SNAPPY_BLOCK_SIZE : len;
+        size_t literal = block;
+        size_t i = block;
+        while (i + 4 <= block_end)
+        {
+            uint32_t bytes = load32(input + i);
+            uint32_t hash = (bytes * 0x1e35a7bdu) >> (32 - SNAPPY_HASH_BITS);
+            size_t candidate = table[hash];
+            table[hash] = (uint32_t)i;
+            if (candidate < block || candidate >= i || load32(input + candidate) != bytes)
+            {
+                i++;
+                continue;
+            }
+
+            size_t match = 4;
+            while (i + match < block_end && input[candidate + match] == input[i + match])
+            {
+                match++;
+            }
+            snappy_literal(out, input + literal, i - literal);
+            snappy_copy(out, i - candidate, match);
+            i += match;
+            literal = i;
+        }
+        snappy_literal(out, input + literal, block_end - literal);
+    }
+    return 0;
+}
+
+static int compare_samples(const void* a, const void* b)
+{
+    const RemoteSample* left = a;
+    const RemoteSample* right = b;
+    if (left->series != right->series)
+    {
+        return left->series < right->series ? -1 : 1;
+    }
+    return (left->timestamp_ms > right->timestamp_ms) - (left->timestamp_ms < right->timestamp_ms);
+}
+
+static size_t sample_len(const RemoteSample* sample)
+{
+    // Sample { double value = 1; int64 timestamp = 2; }
+    return 1 + 8 + 1 + varint_len((uint64_t)sample->timestamp_ms);
+}
+
+/**
+ * @brief Encodes a batch as a WriteRequest, one TimeSeries per distinct series.
+ *
+ * @return 0 on success, or -1 if memory runs out.
+ */
+static int encode_batch(RemoteSample* batch, size_t count, ByteBuffer* out)
+{
+    qsort(batch, count, sizeof(*batch), compare_samples);
+
+    out->len = 0;
+    for (size_t first = 0; first < count;)
+    {
+        const RemoteSeries* series = batch[first].series;
+        size_t last = first;
+        size_t series_len = series->labels_len;
+        while (last < count && batch[last].series == series)
+        {
+            size_t len = sample_len(&batch[last]);
+            series_len += 1 + varint_len(len) + len;
+            last++;
+        }
+
+        if (buffer_reserve(out, 1 + varint_len(series_len) + series_len) != 0)
+        {
+            return RETURN_ERROR;
+        }
+        put_varint(out, 0x0a);
+        put_varint(out, series_len);
+        put_bytes(out, series->labels, series->labels_len);
+        for (size_t i = first; i < last; i++)
+        {
+            uint64_t bits;
+            memcpy(&bits, &batch[i].value, sizeof(bits));
+            put_varint(out, 0x12);
+            put_varint(out, sample_len(&batch[i]));
+            put_varint(out, 0x09);
+            for (int b = 0; b < 8; b++)
+            {
+                out->data[out->len++] = (uint8_t)(bits >> (8 * b));
+            }
+            put_varint(out, 0x10);
+            put_varint(out, (uint64_t)batch[i].timestamp_ms);
+        }
+        first = last;
+    }
+    return 0;
+}
+
+static int send_all(int fd, const void* data, size_t len)
+{
+    const char* p = data;
+    while (len > 0)
+    {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return RETURN_ERROR;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Posts a compressed WriteRequest on a new connection.
+ *
+ * @return The HTTP status of the response, or -1 if the endpoint cannot be reached or does not answer.
+ */
+static int post_request(const RemoteWrite* remote, const ByteBuffer* body)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addresses = NULL;
+    if (getaddrinfo(remote->host, remote->port, &hints, &addresses) != 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    int fd = -1;
+    struct timeval timeout = {REMOTE_WRITE_TIMEOUT_S, 0};
+    for (struct addrinfo* address = addresses; address != NULL && fd < 0; address = address->ai_next)
+    {
+        fd = socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        // The send timeout also bounds connect()
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (connect(fd, address->ai_addr, address->ai_addrlen) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (fd < 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    char header[REMOTE_WRITE_PATH_SIZE + REMOTE_WRITE_HOST_SIZE + 256];
+    bool ipv6 = strchr(remote->host, ':') != NULL;
+    int header_len = snprintf(header, sizeof(header),
+                              "POST %s HTTP/1.1\r\n"
+                              "Host: %s%s%s:%s\r\n"
+                              "User-Agent: monitor\r\n"
+                              "Content-Type: application/x-protobuf\r\n"
+                              "Content-Encoding: snappy\r\n"
+                              "X-Prometheus-Remote-Write-Version: 0.1.0\r\n"
+                              "Content-Length: %zu\r\n"
+                              "Connection: close\r\n\r\n",
+                              remote->path, ipv6 ? "[" : "", remote->host, ipv6 ? "]" : "", remote->port, body->len);
+
+    int status = RETURN_ERROR;
+    char response[REMOTE_WRITE_RESPONSE_SIZE];
+    size_t received = 0;
+    if (send_all(fd, header, (size_t)header_len) == 0 && send_all(fd, body->data, body->len) == 0)
+    {
+        // Only the status line matters; the connection is closed right after it
+        while (received + 1 < sizeof(response) && memchr(response, '\n', received) == NULL)
+        {
+            ssize_t n = recv(fd, response + received, sizeof(response) - 1 - received, 0);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                break;
+            }
+            received += (size_t)n;
+        }
+        response[received] = '\0';
+        int code = 0;
+        if (sscanf(response, "HTTP/%*d.%*d %d", &code) == 1)
+        {
+            status = code;
+        }
+    }
+    close(fd);
+    return status;
+}
+
+static void add_samples(const RemoteWrite* remote, const char* result, size_t count)
+{
+    if (remote->samples_metric != NULL && count > 0)
+    {
+        const char* label_values[] = {result};
+        prom_counter_add(remote->samples_metric, (double)count, label_values);
+    }
+}
+
+static void deadline_after(struct timespec* deadline, unsigned int ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * @brief Sends a batch, retrying with exponential backoff while the endpoint fails in a way that may pass.
+ */
+static void send_batch(RemoteShard* shard, const ByteBuffer* body, size_t count)
+{
+    RemoteWrite* remote = shard->remote;
+    unsigned int backoff_ms = REMOTE_WRITE_MIN_BACKOFF_MS;
+    bool failing = false;
+    while (!atomic_load(&remote->stopping))
+    {
+        int status = post_request(remote, body);
+        if (status >= 200 && status < 300)
+        {
+            if (failing)
+            {
+                fprintf(stderr, "Remote write to %s:%s recovered\n", remote->host, remote->port);
+            }
+            add_samples(remote, "sent", count);
+            return;
+        }
+        if (status >= 400 && status < 500 && status != 429)
+        {
+            fprintf(stderr, "Remote write refused a batch of %zu samples with status %d\n", count, status);
+            add_samples(remote, "failed", count);
+            return;
+        }
+        if (!failing)
+        {
+            fprintf(stderr, "Remote write to %s:%s failed (%d), retrying\n", remote->host, remote->port, status);
+            failing = true;
+        }
+
+        struct timespec deadline;
+        deadline_after(&deadline, backoff_ms);
+        pthread_mutex_lock(&shard->mutex);
+        while (!atomic_load(&remote->stopping) &&
+               pthread_cond_timedwait(&shard->cond, &shard->mutex, &deadline) != ETIMEDOUT)
+        {
+        }
+        pthread_mutex_unlock(&shard->mutex);
+        backoff_ms = backoff_ms * 2 < REMOTE_WRITE_MAX_BACKOFF_MS ? backoff_ms * 2 : REMOTE_WRITE_MAX_BACKOFF_MS;
+    }
+    add_samples(remote, "dropped", count);
+}
+
+/**
+ * @brief Sends the batches of a shard until the client stops.
+ */
+static void* run_shard(void* arg)
+{
+    RemoteShard* shard = arg;
+    RemoteWrite* remote = shard->remote;
+    RemoteSample* batch = malloc(REMOTE_WRITE_BATCH_SAMPLES * sizeof(*batch));
+    ByteBuffer request = {0};
+    ByteBuffer body = {0};
+    if (batch == NULL)
+    {
+        perror("malloc");
+        return NULL;
+    }
+
+    while (!atomic_load(&remote->stopping))
+    {
+        struct timespec deadline;
+        deadline_after(&deadline, REMOTE_WRITE_FLUSH_MS);
+
+        pthread_mutex_lock(&shard->mutex);
+        while (!atomic_load(&remote->stopping) && shard->count < REMOTE_WRITE_BATCH_SAMPLES &&
+               pthread_cond_timedwait(&shard->cond, &shard->mutex, &deadline) != ETIMEDOUT)
+        {
+        }
+        size_t count = shard->count < REMOTE_WRITE_BATCH_SAMPLES ? shard->count : REMOTE_WRITE_BATCH_SAMPLES;
+        for (size_t i = 0; i < count; i++)
+        {
+            batch[i] = shard->samples[(shard->head + i) % REMOTE_WRITE_QUEUE_CAPACITY];
+        }
+        shard->head = (shard->head + count) % REMOTE_WRITE_QUEUE_CAPACITY;
+        shard->count -= count;
+        pthread_mutex_unlock(&shard->mutex);
+
+        if (count == 0 || atomic_load(&remote->stopping))
+        {
+            add_samples(remote, "dropped", count);
+            continue;
+        }
+        if (encode_batch(batch, count, &request) != 0 || snappy_compress(request.data, request.len, &body) != 0)
+        {
+            add_samples(remote, "failed", count);
+            continue;
+        }
+        send_batch(shard, &body, count);
+    }
+
+    free(batch);
+    free(request.data);
+    free(body.data);
+    return NULL;
+}
+
+/**
+ * @brief Splits an http:// URL into host, port and path.
+ */
+static int parse_url(RemoteWrite* remote, const char* url)
+{
+    const char* scheme = "http://";
+    if (strncmp(url, scheme, strlen(scheme)) != 0)
+    {
+        fprintf(stderr, "Error: remote write URL '%s' must start with %s\n", url, scheme);
+        return RETURN_ERROR;
+    }
+    const char* authority = url + strlen(scheme);
+    const char* path = authority + strcspn(authority, "/");
+
+    const char* host = authority;
+    const char* host_end;
+    const char* port = NULL;
+    if (*host == '[')
+    {
+        // An IPv6 literal
+        host++;
+        host_end = memchr(host, ']', (size_t)(path - host));
+        if (host_end == NULL)
+        {
+            fprintf(stderr, "Error: invalid remote write URL '%s'\n", url);
+            return RETURN_ERROR;
+        }
+        port = host_end[1] == ':' ? host_end + 2 : NULL;
+    }
+    else
+    {
+        host_end = memchr(host, ':', (size_t)(path - host));
+        if (host_end != NULL)
+        {
+            port = host_end + 1;
+        }
+        else
+        {
+            host_end = path;
+        }
+    }
+
+    size_t host_len = (size_t)(host_end - host);
+    size_t port_len = port != NULL ? (size_t)(path - port) : 0;
+    if (host_len == 0 || host_len >= sizeof(remote->host) || port_len >= sizeof(remote->port) ||
+        strlen(path) >= sizeof(remote->path) || (port != NULL && port_len == 0))
+    {
+        fprintf(stderr, "Error: invalid remote write URL '%s'\n", url);
+        return RETURN_ERROR;
+    }
+    memcpy(remote->host, host, host_len);
+    remote->host[host_len] = '\0';
+    snprintf(remote->port, sizeof(remote->port), "%.*s", (int)port_len, port_len > 0 ? port : "80");
+    snprintf(remote->path, sizeof(remote->path), "%s", *path != '\0' ? path : "/");
+    return 0;
+}
+
+int remote_write_open(RemoteWrite* remote, const char* url)
+{
+    memset(remote, 0, sizeof(*remote));
+    atomic_init(&remote->stopping, false);
+    if (parse_url(remote, url) != 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    remote->slots = calloc(REMOTE_WRITE_INITIAL_SLOTS, sizeof(*remote->slots));
+    if (remote->slots == NULL)
+    {
+        perror("calloc");
+        return RETURN_ERROR;
+    }
+    remote->slot_count = REMOTE_WRITE_INITIAL_SLOTS;
+
+    remote->samples_metric = prom_counter_new("remote_write_samples_total",
+                                              "Samples pushed to the remote write endpoint", 1, samples_label_keys);
+    if (remote->samples_metric == NULL ||
+        prom_collector_registry_register_metric((prom_metric_t*)remote->samples_metric) != 0)
+    {
+        fprintf(stderr, "Error registering metric 'remote_write_samples_total'\n");
+        prom_counter_destroy(remote->samples_metric);
+        remote->samples_metric = NULL;
+    }
+
+    for (int s = 0; s < REMOTE_WRITE_SHARDS; s++)
+    {
+        RemoteShard* shard = &remote->shards[s];
+        shard->remote = remote;
+
+        pthread_condattr_t attr;
+        if (pthread_mutex_init(&shard->mutex, NULL) != 0 || pthread_condattr_init(&attr) != 0)
+        {
+            fprintf(stderr, "Error initializing remote write shard\n");
+            remote_write_close(remote);
+            return RETURN_ERROR;
+        }
+        // Batch deadlines and backoff are measured on the monotonic clock so that a clock change cannot stretch them
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        int ret = pthread_cond_init(&shard->cond, &attr);
+        pthread_condattr_destroy(&attr);
+        if (ret != 0 || pthread_create(&shard->thread, NULL, run_shard, shard) != 0)
+        {
+            fprintf(stderr, "Error starting remote write shard\n");
+            remote_write_close(remote);
+            return RETURN_ERROR;
+        }
+        shard->started = true;
+    }
+    return 0;
+}
+
+int remote_write_queue(RemoteWrite* remote)
+{
+    remote->pass++;
+    if (prom_collector_registry_visit_samples(PROM_COLLECTOR_REGISTRY_DEFAULT, stage_sample, remote, NULL) != 0)
+    {
+        fprintf(stderr, "Error reading the metrics for remote write\n");
+        return RETURN_ERROR;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t timestamp_ms = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+    size_t dropped = 0;
+    for (int s = 0; s < REMOTE_WRITE_SHARDS; s++)
+    {
+        RemoteShard* shard = &remote->shards[s];
+        pthread_mutex_lock(&shard->mutex);
+        for (size_t i = 0; i < remote->series_count; i++)
+        {
+            const RemoteSeries* series = remote->series[i];
+            if (series->pending_pass != remote->pass || series->labels == NULL ||
+                series->hash % REMOTE_WRITE_SHARDS != (uint64_t)s)
+            {
+                continue;
+            }
+            if (shard->count == REMOTE_WRITE_QUEUE_CAPACITY)
+            {
+                // Backpressure drops the oldest samples, so the newest reach the endpoint once it recovers
+                shard->head = (shard->head + 1) % REMOTE_WRITE_QUEUE_CAPACITY;
+                shard->count--;
+                dropped++;
+            }
+            shard->samples[(shard->head + shard->count) % REMOTE_WRITE_QUEUE_CAPACITY] =
+                (RemoteSample){series, timestamp_ms, series->pending};
+            shard->count++;
+        }
+        if (shard->count >= REMOTE_WRITE_BATCH_SAMPLES)
+        {
+            pthread_cond_signal(&shard->cond);
+        }
+        pthread_mutex_unlock(&shard->mutex);
+    }
+    add_samples(remote, "dropped", dropped);
+    return 0;
+}
+
+void remote_write_close(RemoteWrite* remote)
+{
+    atomic_store(&remote->stopping, true);
+    for (int s = 0; s < REMOTE_WRITE_SHARDS; s++)
+    {
+        RemoteShard* shard = &remote->shards[s];
+        if (!shard->started)
+        {
+            continue;
+        }
+        pthread_mutex_lock(&shard->mutex);
+        pthread_cond_broadcast(&shard->cond);
+        pthread_mutex_unlock(&shard->mutex);
+        pthread_join(shard->thread, NULL);
+        pthread_cond_destroy(&shard->cond);
+        pthread_mutex_destroy(&shard->mutex);
+        shard->started = false;
+    }
+
+    for (size_t i = 0; i < remote->series_count; i++)
+    {
+        free(remote->series[i]->name);
+        free(remote->series[i]->labels);
+        free(remote->series[i]);
+    }
+    free(remote->series);
+    free(remote->slots);
+    remote->series = NULL;
+    remote->slots = NULL;
+    remote->series_count = 0;
+}
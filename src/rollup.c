@@ -0,0 +1,411 @@
+/**
+ * @file rollup.c
+ * @brief Functions for the one-minute rollups of chosen gauges.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "rollup.h"
+#include "metrics.h"
+
+#define ROLLUP_FNV_OFFSET 14695981039346656037ull /**< FNV-1a offset basis. */
+#define ROLLUP_FNV_PRIME 1099511628211ull         /**< FNV-1a prime. */
+
+static const char* rollup_suffixes[ROLLUP_KINDS] = {"_min_1m", "_max_1m", "_avg_1m"}; /**< Gauge name suffixes. */
+static const char* rollup_help_suffixes[ROLLUP_KINDS] = {", minimum over the last minute",
+                                                         ", maximum over the last minute",
+                                                         ", mean over the last minute"}; /**< Description suffixes. */
+
+static uint64_t hash_series(const char* name, size_t len)
+{
+    uint64_t hash = ROLLUP_FNV_OFFSET;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ (unsigned char)name[i]) * ROLLUP_FNV_PRIME;
+    }
+    return hash;
+}
+
+static int64_t monotonic_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void series_label_values_free(char** values, size_t count)
+{
+    if (values == NULL)
+    {
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        free(values[i]);
+    }
+    free(values);
+}
+
+/**
+ * @brief Copies a label value of the text exposition up to its closing quote, undoing the \\, \" and \n escapes.
+ *
+ * @return The copy, or NULL if the value has no closing quote before end or memory runs out.
+ */
+static char* unescape_value(const char* value, const char* end, const char** value_end)
+{
+    const char* p = value;
+    while (p < end && *p != '"')
+    {
+        p += *p == '\\' ? 2 : 1;
+    }
+    if (p >= end)
+    {
+        return NULL;
+    }
+    *value_end = p;
+
+    char* copy = malloc((size_t)(p - value) + 1);
+    if (copy == NULL)
+    {
+        perror("malloc");
+        return NULL;
+    }
+    char* out = copy;
+    for (const char* q = value; q < p; q++)
+    {
+        if (*q == '\\')
+        {
+            q++;
+            *out++ = *q == 'n' ? '\n' : *q;
+        }
+        else
+        {
+            *out++ = *q;
+        }
+    }
+    *out = '\0';
+    return copy;
+}
+
+char** series_label_values(const char* series, size_t len, size_t label_count, const char** label_keys)
+{
+    char** values = calloc(label_count, sizeof(*values));
+    if (values == NULL)
+    {
+        perror("calloc");
+        return NULL;
+    }
+
+    const char* end = series + len;
+    const char* p = memchr(series, '{', len);
+    for (size_t i = 0; i < label_count; i++)
+    {
+        // p is at the brace or at the comma before the key
+        size_t key_len = strlen(label_keys[i]);
+        const char* value_end = NULL;
+        if (p == NULL || end - p < (ptrdiff_t)(key_len + 4) || strncmp(p + 1, label_keys[i], key_len) != 0 ||
+            strncmp(p + 1 + key_len, "=\"", 2) != 0 ||
+            (values[i] = unescape_value(p + 1 + key_len + 2, end, &value_end)) == NULL)
+        {
+            series_label_values_free(values, label_count);
+            return NULL;
+        }
+        p = value_end + 1;
+    }
+    return values;
+}
+
+static void index_insert(RollupSeries** slots, size_t slot_count, RollupSeries* series)
+{
+    size_t i = (size_t)series->hash & (slot_count - 1);
+    while (slots[i] != NULL)
+    {
+        i = (i + 1) & (slot_count - 1);
+    }
+    slots[i] = series;
+}
+
+static int index_grow(Rollup* rollup)
+{
+    size_t slot_count = rollup->slot_count * 2;
+    RollupSeries** slots = calloc(slot_count, sizeof(*slots));
+    if (slots == NULL)
+    {
+        perror("calloc");
+        return RETURN_ERROR;
+    }
+    for (size_t i = 0; i < rollup->series_count; i++)
+    {
+        index_insert(slots, slot_count, rollup->series[i]);
+    }
+    free(rollup->slots);
+    rollup->slots = slots;
+    rollup->slot_count = slot_count;
+    return 0;
+}
+
+/**
+ * @brief Indexes the series again after some were dropped, since linear probing cannot leave holes in a chain.
+ */
+static void index_rebuild(Rollup* rollup)
+{
+    memset(rollup->slots, 0, rollup->slot_count * sizeof(*rollup->slots));
+    for (size_t i = 0; i < rollup->series_count; i++)
+    {
+        index_insert(rollup->slots, rollup->slot_count, rollup->series[i]);
+    }
+}
+
+/**
+ * @brief Frees a series once it is out of the index.
+ */
+static void free_series(Rollup* rollup, RollupSeries* series)
+{
+    series_label_values_free(series->label_values, rollup->label_count);
+    free(series->name);
+    free(series);
+}
+
+/**
+ * @brief Returns the window of a series, adding it on first sight.
+ */
+static RollupSeries* find_series(Rollup* rollup, const char* name, size_t len)
+{
+    uint64_t hash = hash_series(name, len);
+    size_t i = (size_t)hash & (rollup->slot_count - 1);
+    while (rollup->slots[i] != NULL)
+    {
+        RollupSeries* series = rollup->slots[i];
+        if (series->hash == hash && strncmp(series->name, name, len) == 0 && series->name[len] == '\0')
+        {
+            return series;
+        }
+        i = (i + 1) & (rollup->slot_count - 1);
+    }
+
+    if ((double)(rollup->series_count + 1) > (double)rollup->slot_count * ROLLUP_MAX_LOAD && index_grow(rollup) != 0)
+    {
+        return NULL;
+    }
+    if (rollup->series_count == rollup->series_capacity)
+    {
+        size_t capacity = rollup->series_capacity > 0 ? rollup->series_capacity * 2 : ROLLUP_INITIAL_SLOTS;
+        RollupSeries** list = realloc(rollup->series, capacity * sizeof(*list));
+        if (list == NULL)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        rollup->series = list;
+        rollup->series_capacity = capacity;
+    }
+
+    RollupSeries* series = calloc(1, sizeof(*series));
+    if (series == NULL || (series->name = strndup(name, len)) == NULL)
+    {
+        perror("calloc");
+        free(series);
+        return NULL;
+    }
+    series->hash = hash;
+    if (rollup->label_count > 0 &&
+        (series->label_values = series_label_values(name, len, rollup->label_count, rollup->label_keys)) == NULL)
+    {
+        fprintf(stderr, "Error parsing the labels of %s, not rolling it up\n", series->name);
+    }
+    rollup->series[rollup->series_count++] = series;
+    index_insert(rollup->slots, rollup->slot_count, series);
+    return series;
+}
+
+/**
+ * @brief Keeps the value of a series read by the visit; only those staged in the current pass are folded in.
+ */
+static void stage_sample(size_t index, const prom_sample_view_t* view, void* arg)
+{
+    Rollup* rollup = arg;
+    (void)index;
+    RollupSeries* series = find_series(rollup, view->series, view->series_len);
+    if (series != NULL)
+    {
+        series->pending = view->integer ? (double)view->u_value : view->value;
+        series->pending_pass = rollup->pass;
+    }
+}
+
+/**
+ * @brief Publishes the window of every series and starts the next one; series without samples in it are dropped.
+ */
+static void publish_windows(Rollup* rollup)
+{
+    size_t kept = 0;
+
+    // The three gauges of a series change together, so a scrape never pairs the minimum of one window with the
+    // maximum of another
+    prom_gauge_batch_begin();
+    for (size_t i = 0; i < rollup->series_count; i++)
+    {
+        RollupSeries* series = rollup->series[i];
+        const char** label_values = (const char**)series->label_values;
+
+        if (series->count == 0)
+        {
+            // The series left the source gauge a whole window ago
+            if (series->samples[ROLLUP_MIN] != NULL)
+            {
+                for (int k = 0; k < ROLLUP_KINDS; k++)
+                {
+                    prom_gauge_remove(rollup->gauges[k], label_values);
+                }
+            }
+            free_series(rollup, series);
+            continue;
+        }
+        rollup->series[kept++] = series;
+        if (rollup->label_count > 0 && series->label_values == NULL)
+        {
+            series->count = 0;
+            series->sum = 0.0;
+            continue;
+        }
+
+        const double values[ROLLUP_KINDS] = {series->min, series->max, series->sum / (double)series->count};
+        for (int k = 0; k < ROLLUP_KINDS; k++)
+        {
+            if (series->samples[k] == NULL)
+            {
+                series->samples[k] = prom_gauge_with_labels(rollup->gauges[k], label_values);
+            }
+            if (series->samples[k] == NULL || prom_metric_sample_set(series->samples[k], values[k]) != 0)
+            {
+                fprintf(stderr, "Error publishing %s\n", rollup->names[k]);
+            }
+        }
+        series->count = 0;
+        series->sum = 0.0;
+    }
+    prom_gauge_batch_end();
+
+    if (kept != rollup->series_count)
+    {
+        rollup->series_count = kept;
+        index_rebuild(rollup);
+    }
+}
+
+int rollup_register(Rollup* rollup, const char* name, const char* description, size_t label_count,
+                    const char** label_keys)
+{
+    int result = 0;
+    pthread_mutex_lock(&rollup->mutex);
+    if (!rollup->open)
+    {
+        rollup->slots = calloc(ROLLUP_INITIAL_SLOTS, sizeof(*rollup->slots));
+        if (rollup->slots == NULL)
+        {
+            perror("calloc");
+            pthread_mutex_unlock(&rollup->mutex);
+            return RETURN_ERROR;
+        }
+        rollup->slot_count = ROLLUP_INITIAL_SLOTS;
+        rollup->label_count = label_count;
+        rollup->label_keys = label_keys;
+
+        for (int k = 0; k < ROLLUP_KINDS; k++)
+        {
+            snprintf(rollup->names[k], sizeof(rollup->names[k]), "%s%s", name, rollup_suffixes[k]);
+            snprintf(rollup->help[k], sizeof(rollup->help[k]), "%s%s", description, rollup_help_suffixes[k]);
+            rollup->gauges[k] = prom_gauge_new(rollup->names[k], rollup->help[k], label_count, label_keys);
+            if (rollup->gauges[k] == NULL)
+            {
+                fprintf(stderr, "Error creating metric '%s'\n", rollup->names[k]);
+                result = RETURN_ERROR;
+            }
+        }
+        rollup->open = true;
+    }
+
+    for (int k = 0; k < ROLLUP_KINDS && result == 0; k++)
+    {
+        if (prom_collector_registry_register_metric((prom_metric_t*)rollup->gauges[k]) != 0)
+        {
+            fprintf(stderr, "Error registering metric '%s'\n", rollup->names[k]);
+            result = RETURN_ERROR;
+        }
+    }
+    pthread_mutex_unlock(&rollup->mutex);
+    return result;
+}
+
+int rollup_unregister(Rollup* rollup)
+{
+    int result = 0;
+    pthread_mutex_lock(&rollup->mutex);
+    for (int k = 0; k < ROLLUP_KINDS && rollup->open; k++)
+    {
+        if (rollup->gauges[k] != NULL && prom_collector_registry_unregister_metric((prom_metric_t*)rollup->gauges[k]))
+        {
+            fprintf(stderr, "Error unregistering metric '%s'\n", rollup->names[k]);
+            result = RETURN_ERROR;
+        }
+    }
+    pthread_mutex_unlock(&rollup->mutex);
+    return result;
+}
+
+void rollup_observe(Rollup* rollup, prom_gauge_t* source)
+{
+    pthread_mutex_lock(&rollup->mutex);
+    if (!rollup->open || rollup->gauges[ROLLUP_AVG] == NULL)
+    {
+        pthread_mutex_unlock(&rollup->mutex);
+        return;
+    }
+
+    int64_t now_ms = monotonic_ms();
+    if (rollup->window_end_ms == 0)
+    {
+        rollup->window_end_ms = now_ms + ROLLUP_WINDOW_MS;
+    }
+    else if (now_ms >= rollup->window_end_ms)
+    {
+        publish_windows(rollup);
+        rollup->window_end_ms += ROLLUP_WINDOW_MS;
+        if (now_ms >= rollup->window_end_ms)
+        {
+            // The collector was paused for more than a window
+            rollup->window_end_ms = now_ms + ROLLUP_WINDOW_MS;
+        }
+    }
+
+    rollup->pass++;
+    if (prom_metric_visit_samples((prom_metric_t*)source, stage_sample, rollup, NULL) != 0)
+    {
+        fprintf(stderr, "Error reading the samples of %s\n", rollup->names[ROLLUP_AVG]);
+        pthread_mutex_unlock(&rollup->mutex);
+        return;
+    }
+
+    for (size_t i = 0; i < rollup->series_count; i++)
+    {
+        RollupSeries* series = rollup->series[i];
+        if (series->pending_pass != rollup->pass)
+        {
+            continue;
+        }
+        double value = series->pending;
+        if (series->count == 0)
+        {
+            series->min = value;
+            series->max = value;
+        }
+        else
+        {
+            series->min = value < series->min ? value : series->min;
+            series->max = value > series->max ? value : series->max;
+        }
+        series->sum += value;
+        series->count++;
+    }
+    pthread_mutex_unlock(&rollup->mutex);
+}
@@ -0,0 +1,166 @@
+/**
+ * @file schedstat.c
+ * @brief Functions for reading the scheduler statistics of every CPU.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "schedstat.h"
+#include "metrics.h"
+#include "source_cache.h"
+#include "sysroot.h"
+
+#define SCHEDSTAT_SKIPPED_FIELDS 6 /**< Fields of a CPU line before the run time. */
+
+/**
+ * @brief Returns the entry at an index of the snapshot, growing it if needed.
+ *
+ * @return The entry, or NULL if the snapshot cannot grow.
+ */
+static SchedstatCpu* entry_at(SchedstatSnapshot* snapshot, size_t index)
+{
+    if (index >= snapshot->cpu_capacity)
+    {
+        size_t capacity = snapshot->cpu_capacity ? snapshot->cpu_capacity * 2 : 16;
+        SchedstatCpu* cpus = realloc(snapshot->cpus, capacity * sizeof(*cpus));
+        if (cpus == NULL)
+        {
+            perror("realloc");
+            return NULL;
+        }
+
+        // New entries start without a CPU, so that their sample handles are reset when first filled
+        for (size_t i = snapshot->cpu_capacity; i < capacity; i++)
+        {
+            cpus[i].cpu = -1;
+        }
+        snapshot->cpus = cpus;
+        snapshot->cpu_capacity = capacity;
+    }
+    return &snapshot->cpus[index];
+}
+
+/**
+ * @brief Parses one "cpuN" line into the next entry of the snapshot.
+ *
+ * @param snapshot The snapshot.
+ * @param p The line, after "cpu".
+ * @return 0 on success, or -1 if the line is malformed or the snapshot cannot grow.
+ */
+static int parse_cpu_line(SchedstatSnapshot* snapshot, const char* p)
+{
+    char* end;
+    long cpu = strtol(p, &end, 10);
+    if (end == p || *end != ' ')
+    {
+        return RETURN_ERROR;
+    }
+
+    unsigned long long fields[SCHEDSTAT_SKIPPED_FIELDS + SCHEDSTAT_FIELD_COUNT];
+    p = end;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    {
+        fields[i] = strtoull(p, &end, 10);
+        if (end == p)
+        {
+            return RETURN_ERROR;
+        }
+        p = end;
+    }
+
+    SchedstatCpu* entry = entry_at(snapshot, snapshot->cpu_count);
+    if (entry == NULL)
+    {
+        return RETURN_ERROR;
+    }
+    if (entry->cpu != (int)cpu)
+    {
+        entry->cpu = (int)cpu;
+        snprintf(entry->label, sizeof(entry->label), "%ld", cpu);
+        memset(entry->samples, 0, sizeof(entry->samples));
+    }
+
+    for (int f = 0; f < SCHEDSTAT_FIELD_COUNT; f++)
+    {
+        entry->values[f] = fields[SCHEDSTAT_SKIPPED_FIELDS + f];
+        snapshot->totals[f] += entry->values[f];
+    }
+    snapshot->cpu_count++;
+    return 0;
+}
+
+int read_schedstat_snapshot(SchedstatSnapshot* snapshot)
+{
+    if (snapshot->unavailable)
+    {
+        return RETURN_ERROR;
+    }
+
+    const char* buffer = source_cache_read(SCHEDSTAT_PATH, NULL);
+    if (buffer == NULL)
+    {
+        // Kernels built without CONFIG_SCHEDSTATS have no /proc/schedstat
+        char path[PATH_MAX];
+        const char* resolved = sysroot_path(SCHEDSTAT_PATH, path, sizeof(path));
+        snapshot->unavailable = resolved == NULL || access(resolved, F_OK) != 0;
+        return RETURN_ERROR;
+    }
+
+    if (strncmp(buffer, "version ", strlen("version ")) != 0 ||
+        atoi(buffer + strlen("version ")) < SCHEDSTAT_MIN_VERSION)
+    {
+        fprintf(stderr, "Error parsing %s: unsupported format\n", SCHEDSTAT_PATH);
+        snapshot->unavailable = true;
+        return RETURN_ERROR;
+    }
+
+    if (snapshot->cpu_count > 0)
+    {
+        memcpy(snapshot->previous, snapshot->totals, sizeof(snapshot->previous));
+        snapshot->has_previous = true;
+    }
+    memset(snapshot->totals, 0, sizeof(snapshot->totals));
+    snapshot->cpu_count = 0;
+
+    // Every CPU line is followed by its domain lines, which are skipped
+    for (const char* line = buffer; *line != '\0';)
+    {
+        if (strncmp(line, "cpu", 3) == 0 && parse_cpu_line(snapshot, line + 3) != 0)
+        {
+            fprintf(stderr, "Error parsing %s\n", SCHEDSTAT_PATH);
+            return RETURN_ERROR;
+        }
+
+        const char* next = strchr(line, '\n');
+        if (next == NULL)
+        {
+            break;
+        }
+        line = next + 1;
+    }
+    return snapshot->cpu_count > 0 ? 0 : RETURN_ERROR;
+}
+
+int schedstat_runqueue_latency(const SchedstatSnapshot* snapshot, double* latency)
+{
+    if (!snapshot->has_previous || snapshot->totals[SCHEDSTAT_TIMESLICES] <= snapshot->previous[SCHEDSTAT_TIMESLICES])
+    {
+        return RETURN_ERROR;
+    }
+
+    // Offlining a CPU drops its counters from the totals, so a wait time going backwards is treated as no wait
+    unsigned long long timeslices = snapshot->totals[SCHEDSTAT_TIMESLICES] - snapshot->previous[SCHEDSTAT_TIMESLICES];
+    unsigned long long wait = snapshot->totals[SCHEDSTAT_WAIT_TIME] > snapshot->previous[SCHEDSTAT_WAIT_TIME]
+                                  ? snapshot->totals[SCHEDSTAT_WAIT_TIME] - snapshot->previous[SCHEDSTAT_WAIT_TIME]
+                                  : 0;
+    *latency = (double)wait / (double)timeslices / 1e9;
+    return 0;
+}
+
+void schedstat_snapshot_free(SchedstatSnapshot* snapshot)
+{
+    free(snapshot->cpus);
+    snapshot->cpus = NULL;
+    snapshot->cpu_count = 0;
+    snapshot->cpu_capacity = 0;
+}
@@ -0,0 +1,671 @@
+/**
+ * @file scheduler.c
+ * @brief Functions for running collectors at their own intervals on a hashed timer wheel.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "scheduler.h"
+#include "metrics.h"
+#include <errno.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+
+static void wheel_insert(Scheduler* scheduler, ScheduledCollector* entry)
+{
+    ScheduledCollector** slot = &scheduler->slots[entry->due_tick & (SCHEDULER_WHEEL_SLOTS - 1)];
+    entry->next = *slot;
+    *slot = entry;
+}
+
+static void wheel_remove(Scheduler* scheduler, ScheduledCollector* entry)
+{
+    ScheduledCollector** link = &scheduler->slots[entry->due_tick & (SCHEDULER_WHEEL_SLOTS - 1)];
+    while (*link != NULL && *link != entry)
+    {
+        link = &(*link)->next;
+    }
+    if (*link != NULL)
+    {
+        *link = entry->next;
+    }
+    entry->next = NULL;
+}
+
+/**
+ * @brief Returns the number of whole ticks elapsed since the scheduler started.
+ */
+static uint64_t elapsed_ticks(const Scheduler* scheduler)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    int64_t elapsed_ms = (int64_t)(now.tv_sec - scheduler->start.tv_sec) * 1000 +
+                         (now.tv_nsec - scheduler->start.tv_nsec) / 1000000L;
+    return elapsed_ms > 0 ? (uint64_t)elapsed_ms / SCHEDULER_TICK_MS : 0;
+}
+
+/**
+ * @brief Returns the CLOCK_MONOTONIC time in nanoseconds.
+ */
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Records for the scheduler thread whether a run changed the metrics of its collector, in adaptive mode.
+ */
+static void probe_collector(ScheduledCollector* entry)
+{
+    if (entry->probe != NULL)
+    {
+        bool changed = entry->probe(entry->update_function);
+        atomic_store(&entry->outcome, changed ? COLLECTOR_RUN_CHANGED : COLLECTOR_RUN_STABLE);
+    }
+}
+
+/**
+ * @brief Runs a collector, timing the run when someone is reported about it.
+ */
+static void time_collector(ScheduledCollector* entry)
+{
+    TRACE_PROBE1(collector__start, entry->update_function);
+    if (entry->on_run == NULL)
+    {
+        entry->update_function();
+        TRACE_PROBE1(collector__done, entry->update_function);
+        probe_collector(entry);
+        return;
+    }
+
+    struct timespec started;
+    struct timespec begin;
+    struct timespec end;
+    clock_gettime(CLOCK_REALTIME, &started);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    entry->update_function();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    TRACE_PROBE1(collector__done, entry->update_function);
+
+    int64_t duration_ns = (int64_t)(end.tv_sec - begin.tv_sec) * 1000000000LL + (end.tv_nsec - begin.tv_nsec);
+    entry->on_run(entry->update_function, &started, duration_ns > 0 ? (uint64_t)duration_ns : 0);
+    probe_collector(entry);
+}
+
+static void run_collector(void* arg)
+{
+    ScheduledCollector* entry = arg;
+    time_collector(entry);
+    if (!entry->lazy)
+    {
+        atomic_store(&entry->in_flight, false);
+        return;
+    }
+
+    // Wakes the callers of scheduler_collect_stale() waiting for the run
+    pthread_mutex_lock(&entry->scheduler->lazy_lock);
+    atomic_store(&entry->in_flight, false);
+    pthread_cond_broadcast(&entry->scheduler->lazy_done);
+    pthread_mutex_unlock(&entry->scheduler->lazy_lock);
+}
+
+/**
+ * @brief Starts a run of a collector, on the worker pool if there is one.
+ *
+ * Lazy collectors must be started with lazy_lock held.
+ */
+static void start_collector(Scheduler* scheduler, ScheduledCollector* entry, uint64_t tick)
+{
+    // A lazy collector is fresh for its interval from the start of the run, whether it succeeds or not
+    uint64_t fresh_until_ns = monotonic_ns() + entry->base_ticks * SCHEDULER_TICK_MS * 1000000ULL;
+    if (scheduler->pool == NULL)
+    {
+        entry->fresh_until_ns = fresh_until_ns;
+        time_collector(entry);
+        return;
+    }
+
+    if (atomic_load(&entry->in_flight))
+    {
+        // The previous run is still blocked; this cycle is skipped and the miss was or will be reported
+        return;
+    }
+
+    entry->deadline_tick = tick + entry->interval_ticks;
+    entry->timed_out = false;
+    atomic_store(&entry->in_flight, true);
+    if (worker_pool_submit(scheduler->pool, run_collector, entry) != 0)
+    {
+        atomic_store(&entry->in_flight, false);
+        fprintf(stderr, "Error: worker queue full, skipping collector\n");
+        return;
+    }
+    entry->fresh_until_ns = fresh_until_ns;
+}
+
+/**
+ * @brief Reports every run in flight that has passed its deadline.
+ */
+static void check_deadlines(Scheduler* scheduler, uint64_t tick)
+{
+    pthread_mutex_lock(&scheduler->lazy_lock);
+    for (size_t i = 0; i < scheduler->entry_count; i++)
+    {
+        ScheduledCollector* entry = &scheduler->entries[i];
+        if (entry->active && !entry->timed_out && tick >= entry->deadline_tick && atomic_load(&entry->in_flight))
+        {
+            entry->timed_out = true;
+            if (scheduler->on_timeout != NULL)
+            {
+                scheduler->on_timeout(entry->update_function);
+            }
+        }
+    }
+    pthread_mutex_unlock(&scheduler->lazy_lock);
+}
+
+/**
+ * @brief Adjusts the period of every collector whose last run was probed since the previous tick.
+ *
+ * A stable run doubles the period, up to max_ticks or the collector's own period if that is longer. A change restores
+ * the collector's own period and pulls its next run in, so that a transient is followed at full rate right away.
+ */
+static void apply_outcomes(Scheduler* scheduler, uint64_t tick)
+{
+    for (size_t i = 0; i < scheduler->entry_count; i++)
+    {
+        ScheduledCollector* entry = &scheduler->entries[i];
+        int outcome = atomic_exchange(&entry->outcome, COLLECTOR_RUN_NONE);
+        if (!entry->active || outcome == COLLECTOR_RUN_NONE)
+        {
+            continue;
+        }
+
+        if (outcome == COLLECTOR_RUN_STABLE)
+        {
+            uint64_t cap = entry->base_ticks > scheduler->max_ticks ? entry->base_ticks : scheduler->max_ticks;
+            entry->interval_ticks = entry->interval_ticks * 2 < cap ? entry->interval_ticks * 2 : cap;
+        }
+        else if (entry->interval_ticks != entry->base_ticks)
+        {
+            entry->interval_ticks = entry->base_ticks;
+            if (tick + entry->base_ticks < entry->due_tick)
+            {
+                wheel_remove(scheduler, entry);
+                entry->due_tick = tick + entry->base_ticks;
+                wheel_insert(scheduler, entry);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Processes a single tick, running and rescheduling the collectors due on it.
+ */
+static void process_tick(Scheduler* scheduler, uint64_t tick, uint64_t last_tick)
+{
+    if (scheduler->pool != NULL)
+    {
+        check_deadlines(scheduler, tick);
+    }
+    if (scheduler->probe != NULL)
+    {
+        apply_outcomes(scheduler, tick);
+    }
+
+    ScheduledCollector** slot = &scheduler->slots[tick & (SCHEDULER_WHEEL_SLOTS - 1)];
+    ScheduledCollector* entry = *slot;
+    *slot = NULL;
+
+    while (entry != NULL)
+    {
+        ScheduledCollector* next = entry->next;
+        if (entry->due_tick == tick)
+        {
+            start_collector(scheduler, entry, tick);
+
+            // Keep the phase of the collector; periods that were entirely missed are skipped instead of replayed
+            uint64_t now_tick = elapsed_ticks(scheduler);
+            if (now_tick < last_tick)
+            {
+                now_tick = last_tick;
+            }
+            entry->due_tick += entry->interval_ticks;
+            while (entry->due_tick <= now_tick)
+            {
+                entry->due_tick += entry->interval_ticks;
+            }
+        }
+        wheel_insert(scheduler, entry);
+        entry = next;
+    }
+}
+
+int scheduler_init(Scheduler* scheduler, const CollectorDispatch* dispatch, WorkerPool* pool,
+                   collector_timeout_fn on_timeout, collector_run_fn on_run)
+{
+    memset(scheduler, 0, sizeof(*scheduler));
+    scheduler->pool = pool;
+    scheduler->on_timeout = on_timeout;
+    scheduler->on_run = on_run;
+    scheduler->input_fd = -1;
+
+    for (size_t i = 0; i < MAX_COLLECTORS; i++)
+    {
+        atomic_init(&scheduler->entries[i].in_flight, false);
+        atomic_init(&scheduler->entries[i].outcome, COLLECTOR_RUN_NONE);
+        scheduler->entries[i].scheduler = scheduler;
+    }
+
+    // Waits for lazy runs are bounded on the clock the scheduler counts in
+    pthread_condattr_t attr;
+    if (pthread_mutex_init(&scheduler->lazy_lock, NULL) != 0 || pthread_condattr_init(&attr) != 0 ||
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) != 0 || pthread_cond_init(&scheduler->lazy_done, &attr) != 0)
+    {
+        fprintf(stderr, "Error initializing the scheduler lock\n");
+        return RETURN_ERROR;
+    }
+    pthread_condattr_destroy(&attr);
+
+    if (scheduler_update(scheduler, dispatch) != 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    scheduler->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (scheduler->timer_fd < 0)
+    {
+        perror("timerfd_create");
+        return RETURN_ERROR;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &scheduler->start);
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = SCHEDULER_TICK_MS / 1000;
+    spec.it_interval.tv_nsec = (SCHEDULER_TICK_MS % 1000) * 1000000L;
+    spec.it_value = scheduler->start;
+    spec.it_value.tv_nsec += spec.it_interval.tv_nsec;
+    spec.it_value.tv_sec += spec.it_interval.tv_sec + spec.it_value.tv_nsec / 1000000000L;
+    spec.it_value.tv_nsec %= 1000000000L;
+
+    if (timerfd_settime(scheduler->timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0)
+    {
+        perror("timerfd_settime");
+        close(scheduler->timer_fd);
+        scheduler->timer_fd = -1;
+        return RETURN_ERROR;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Returns the entry of a collector, active or not, or NULL if it never was scheduled.
+ */
+static ScheduledCollector* find_entry(Scheduler* scheduler, collector_fn update_function)
+{
+    for (size_t i = 0; i < scheduler->entry_count; i++)
+    {
+        if (scheduler->entries[i].update_function == update_function)
+        {
+            return &scheduler->entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Closes every watched descriptor running a collector.
+ */
+static void drop_watches(Scheduler* scheduler, ScheduledCollector* entry)
+{
+    for (size_t i = scheduler->watch_count; i > 0; i--)
+    {
+        ScheduledWatch* watch = &scheduler->watches[i - 1];
+        if (watch->entry == entry)
+        {
+            close(watch->fd);
+            entry->watch_count--;
+            *watch = scheduler->watches[--scheduler->watch_count];
+        }
+    }
+}
+
+/**
+ * @brief Returns an entry for a collector that is not scheduled, reusing its previous entry if it had one.
+ *
+ * The entry of another collector is only reused once its last run returned, so that run_collector() never clears the
+ * in_flight flag of a run it does not belong to.
+ */
+static ScheduledCollector* reserve_entry(Scheduler* scheduler, collector_fn update_function)
+{
+    ScheduledCollector* entry = find_entry(scheduler, update_function);
+    if (entry != NULL)
+    {
+        return entry;
+    }
+
+    for (size_t i = 0; i < scheduler->entry_count; i++)
+    {
+        entry = &scheduler->entries[i];
+        if (!entry->active && !atomic_load(&entry->in_flight))
+        {
+            entry->update_function = update_function;
+            return entry;
+        }
+    }
+
+    if (scheduler->entry_count >= MAX_COLLECTORS)
+    {
+        return NULL;
+    }
+    entry = &scheduler->entries[scheduler->entry_count++];
+    entry->update_function = update_function;
+    return entry;
+}
+
+int scheduler_update(Scheduler* scheduler, const CollectorDispatch* dispatch)
+{
+    pthread_mutex_lock(&scheduler->lazy_lock);
+    for (size_t i = 0; i < scheduler->entry_count; i++)
+    {
+        ScheduledCollector* entry = &scheduler->entries[i];
+        bool kept = false;
+        for (size_t g = 0; g < dispatch->group_count && !kept; g++)
+        {
+            kept = dispatch->groups[g].update_function == entry->update_function;
+        }
+        if (entry->active && !kept)
+        {
+            wheel_remove(scheduler, entry);
+            drop_watches(scheduler, entry);
+            entry->active = false;
+        }
+    }
+
+    int result = 0;
+    for (size_t g = 0; g < dispatch->group_count; g++)
+    {
+        uint64_t ticks = (dispatch->groups[g].interval_ms + SCHEDULER_TICK_MS - 1) / SCHEDULER_TICK_MS;
+        ticks = ticks > 0 ? ticks : 1;
+
+        ScheduledCollector* entry = reserve_entry(scheduler, dispatch->groups[g].update_function);
+        if (entry == NULL)
+        {
+            fprintf(stderr, "Error: no free collector entry, not scheduling a collector\n");
+            result = RETURN_ERROR;
+            continue;
+        }
+
+        if (entry->active)
+        {
+            // Keep the phase unless the new period brings the next run closer; a backed-off period starts over
+            if (!entry->lazy && entry->base_ticks != ticks && scheduler->current_tick + ticks < entry->due_tick)
+            {
+                wheel_remove(scheduler, entry);
+                entry->due_tick = scheduler->current_tick + ticks;
+                wheel_insert(scheduler, entry);
+            }
+            if (entry->base_ticks != ticks)
+            {
+                entry->interval_ticks = ticks;
+                entry->base_ticks = ticks;
+            }
+            continue;
+        }
+
+        entry->interval_ticks = ticks;
+        entry->base_ticks = ticks;
+        atomic_store(&entry->outcome, COLLECTOR_RUN_NONE);
+        entry->due_tick = scheduler->current_tick + 1;
+        entry->timed_out = false;
+        entry->watch_count = 0;
+        entry->on_run = scheduler->on_run;
+        entry->lazy = scheduler->is_lazy != NULL && scheduler->is_lazy(entry->update_function);
+        entry->fresh_until_ns = 0;
+        entry->probe = entry->lazy ? NULL : scheduler->probe;
+        entry->active = true;
+        if (!entry->lazy)
+        {
+            wheel_insert(scheduler, entry);
+        }
+    }
+    pthread_mutex_unlock(&scheduler->lazy_lock);
+    return result;
+}
+
+const ScheduledCollector* scheduler_find(const Scheduler* scheduler, collector_fn update_function)
+{
+    for (size_t i = 0; i < scheduler->entry_count; i++)
+    {
+        const ScheduledCollector* entry = &scheduler->entries[i];
+        if (entry->active && entry->update_function == update_function)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+void scheduler_set_adaptive(Scheduler* scheduler, collector_changed_fn probe, unsigned int max_interval_ms)
+{
+    scheduler->probe = probe;
+    scheduler->max_ticks = (max_interval_ms + SCHEDULER_TICK_MS - 1) / SCHEDULER_TICK_MS;
+
+    // Collectors scheduled by scheduler_init() have not run yet
+    for (size_t i = 0; i < scheduler->entry_count; i++)
+    {
+        scheduler->entries[i].probe = scheduler->entries[i].lazy ? NULL : probe;
+    }
+}
+
+void scheduler_set_lazy(Scheduler* scheduler, collector_lazy_fn is_lazy)
+{
+    pthread_mutex_lock(&scheduler->lazy_lock);
+    scheduler->is_lazy = is_lazy;
+
+    // Collectors scheduled by scheduler_init() leave the wheel before their first run
+    for (size_t i = 0; i < scheduler->entry_count; i++)
+    {
+        ScheduledCollector* entry = &scheduler->entries[i];
+        if (entry->active && is_lazy(entry->update_function))
+        {
+            wheel_remove(scheduler, entry);
+            entry->lazy = true;
+            entry->fresh_until_ns = 0;
+            entry->probe = NULL;
+        }
+    }
+    pthread_mutex_unlock(&scheduler->lazy_lock);
+}
+
+/**
+ * @brief Tells whether a lazy run is in flight and still within its deadline. Must be called with lazy_lock held.
+ */
+static bool lazy_runs_pending(const Scheduler* scheduler)
+{
+    for (size_t i = 0; i < scheduler->entry_count; i++)
+    {
+        const ScheduledCollector* entry = &scheduler->entries[i];
+        if (entry->active && entry->lazy && !entry->timed_out && atomic_load(&entry->in_flight))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int scheduler_collect_stale(Scheduler* scheduler)
+{
+    if (scheduler->is_lazy == NULL)
+    {
+        return 0;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    uint64_t now_ns = (uint64_t)deadline.tv_sec * 1000000000ULL + (uint64_t)deadline.tv_nsec;
+    deadline.tv_nsec += (SCHEDULER_LAZY_WAIT_MS % 1000) * 1000000L;
+    deadline.tv_sec += SCHEDULER_LAZY_WAIT_MS / 1000 + deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+
+    pthread_mutex_lock(&scheduler->lazy_lock);
+    uint64_t tick = elapsed_ticks(scheduler);
+    for (size_t i = 0; i < scheduler->entry_count; i++)
+    {
+        ScheduledCollector* entry = &scheduler->entries[i];
+        if (entry->active && entry->lazy && now_ns >= entry->fresh_until_ns && !atomic_load(&entry->in_flight))
+        {
+            start_collector(scheduler, entry, tick);
+        }
+    }
+
+    // Runs started by a concurrent caller are waited for too, so that both share them
+    int result = 0;
+    while (result == 0 && lazy_runs_pending(scheduler))
+    {
+        if (pthread_cond_timedwait(&scheduler->lazy_done, &scheduler->lazy_lock, &deadline) == ETIMEDOUT)
+        {
+            result = RETURN_ERROR;
+        }
+    }
+    pthread_mutex_unlock(&scheduler->lazy_lock);
+    return result;
+}
+
+void scheduler_set_input(Scheduler* scheduler, int fd, scheduler_input_fn on_input, void* arg)
+{
+    scheduler->input_fd = fd;
+    scheduler->on_input = on_input;
+    scheduler->input_arg = arg;
+}
+
+int scheduler_watch(Scheduler* scheduler, int fd, collector_fn update_function)
+{
+    ScheduledCollector* entry = find_entry(scheduler, update_function);
+    if (entry == NULL || !entry->active || scheduler->watch_count >= SCHEDULER_MAX_WATCHES)
+    {
+        close(fd);
+        return RETURN_ERROR;
+    }
+
+    scheduler->watches[scheduler->watch_count].fd = fd;
+    scheduler->watches[scheduler->watch_count].entry = entry;
+    scheduler->watch_count++;
+    entry->watch_count++;
+    return 0;
+}
+
+/**
+ * @brief Processes the ticks reported by the timer.
+ */
+static int process_timer(Scheduler* scheduler)
+{
+    uint64_t expirations;
+    ssize_t n = read(scheduler->timer_fd, &expirations, sizeof(expirations));
+    if (n != sizeof(expirations))
+    {
+        if (n < 0 && (errno == EINTR || errno == EAGAIN))
+        {
+            return 0;
+        }
+        perror("Error reading scheduler timer");
+        return RETURN_ERROR;
+    }
+
+    uint64_t last_tick = scheduler->current_tick + expirations;
+    for (uint64_t tick = scheduler->current_tick + 1; tick <= last_tick; tick++)
+    {
+        process_tick(scheduler, tick, last_tick);
+    }
+    scheduler->current_tick = last_tick;
+    return 0;
+}
+
+/**
+ * @brief Waits for the timer or a watched descriptor, running the collectors of the descriptors that fired.
+ */
+static int wait_events(Scheduler* scheduler)
+{
+    // The input descriptor is polled last; a negative descriptor is ignored by poll()
+    struct pollfd fds[SCHEDULER_MAX_WATCHES + 2];
+    size_t watch_count = scheduler->watch_count;
+    fds[0].fd = scheduler->timer_fd;
+    fds[0].events = POLLIN;
+    for (size_t i = 0; i < watch_count; i++)
+    {
+        fds[i + 1].fd = scheduler->watches[i].fd;
+        fds[i + 1].events = POLLPRI;
+    }
+    fds[watch_count + 1].fd = scheduler->input_fd;
+    fds[watch_count + 1].events = POLLIN;
+    fds[watch_count + 1].revents = 0;
+
+    if (poll(fds, watch_count + 2, -1) < 0)
+    {
+        if (errno == EINTR)
+        {
+            return 0;
+        }
+        perror("poll");
+        return RETURN_ERROR;
+    }
+
+    // Watches that fail are dropped by moving the last one into their slot, so fds[] is walked from the end
+    for (size_t i = watch_count; i > 0; i--)
+    {
+        ScheduledWatch* watch = &scheduler->watches[i - 1];
+        if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+        {
+            fprintf(stderr, "Error: watched descriptor failed, no longer watching it\n");
+            close(watch->fd);
+            watch->entry->watch_count--;
+            *watch = scheduler->watches[--scheduler->watch_count];
+        }
+        else if (fds[i].revents & POLLPRI)
+        {
+            pthread_mutex_lock(&scheduler->lazy_lock);
+            start_collector(scheduler, watch->entry, scheduler->current_tick);
+            pthread_mutex_unlock(&scheduler->lazy_lock);
+        }
+    }
+
+    // Handled once the watches were walked, since the callback may change them
+    if ((fds[watch_count + 1].revents & (POLLIN | POLLHUP)) && scheduler->on_input != NULL)
+    {
+        scheduler->on_input(scheduler->input_arg);
+    }
+
+    return (fds[0].revents & POLLIN) ? process_timer(scheduler) : 0;
+}
+
+int scheduler_run_once(Scheduler* scheduler)
+{
+    if (scheduler->watch_count > 0 || scheduler->input_fd >= 0)
+    {
+        return wait_events(scheduler);
+    }
+    return process_timer(scheduler);
+}
+
+void scheduler_destroy(Scheduler* scheduler)
+{
+    if (scheduler->timer_fd >= 0)
+    {
+        close(scheduler->timer_fd);
+        scheduler->timer_fd = -1;
+    }
+
+    for (size_t i = 0; i < scheduler->watch_count; i++)
+    {
+        close(scheduler->watches[i].fd);
+    }
+    scheduler->watch_count = 0;
+    pthread_cond_destroy(&scheduler->lazy_done);
+    pthread_mutex_destroy(&scheduler->lazy_lock);
+}
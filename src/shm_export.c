@@ -0,0 +1,185 @@
+/**
+ * @file shm_export.c
+ * @brief Functions for publishing the current value of every series in a POSIX shared memory segment.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#define _GNU_SOURCE // Required for mremap
+
+#include "shm_export.h"
+#include "metrics.h"
+#include <errno.h>
+#include <prom.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Returns the size in bytes of a segment holding a number of entries.
+ */
+static size_t segment_size(size_t capacity)
+{
+    return sizeof(ShmExportHeader) + capacity * sizeof(ShmExportEntry);
+}
+
+/**
+ * @brief Grows the segment until it holds at least a number of entries.
+ *
+ * Readers still mapping the smaller segment keep reading valid memory; they see the new capacity once the snapshot
+ * being written is published.
+ */
+static int grow_segment(ShmExport* shm, size_t needed)
+{
+    size_t capacity = shm->header->capacity;
+    while (capacity < needed)
+    {
+        capacity *= 2;
+    }
+    if (capacity > SHM_EXPORT_MAX_CAPACITY)
+    {
+        return RETURN_ERROR;
+    }
+
+    size_t size = segment_size(capacity);
+    if (ftruncate(shm->fd, (off_t)size) != 0)
+    {
+        perror("Error growing the shared memory segment");
+        return RETURN_ERROR;
+    }
+    void* mapping = mremap(shm->header, shm->mapped_size, size, MREMAP_MAYMOVE);
+    if (mapping == MAP_FAILED)
+    {
+        perror("Error remapping the shared memory segment");
+        return RETURN_ERROR;
+    }
+
+    shm->header = mapping;
+    shm->mapped_size = size;
+    shm->header->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Copies one series into its entry, growing the segment if it does not fit.
+ */
+static void write_entry(size_t index, const prom_sample_view_t* view, void* arg)
+{
+    ShmExport* shm = arg;
+    if (index >= shm->header->capacity && (shm->incomplete || grow_segment(shm, index + 1) != 0))
+    {
+        shm->incomplete = true;
+        return;
+    }
+
+    ShmExportEntry* entry = &shm->header->entries[index];
+    size_t len = view->series_len;
+    uint32_t flags = view->integer ? SHM_EXPORT_INTEGER : 0;
+    if (len >= sizeof(entry->series))
+    {
+        len = sizeof(entry->series) - 1;
+        flags |= SHM_EXPORT_TRUNCATED;
+    }
+    memcpy(entry->series, view->series, len);
+    entry->series[len] = '\0';
+    entry->flags = flags;
+    entry->value = view->integer ? (double)view->u_value : view->value;
+    entry->u_value = view->integer ? view->u_value : 0;
+}
+
+int shm_export_open(ShmExport* shm, const char* name)
+{
+    memset(shm, 0, sizeof(*shm));
+    shm->name = name;
+
+    // A segment left by a previous monitor is unlinked rather than reused, so that its readers notice and reopen
+    if (shm_unlink(name) != 0 && errno != ENOENT)
+    {
+        perror("Error removing the previous shared memory segment");
+    }
+    shm->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (shm->fd < 0)
+    {
+        perror("Error creating the shared memory segment");
+        return RETURN_ERROR;
+    }
+
+    size_t size = segment_size(SHM_EXPORT_INITIAL_CAPACITY);
+    if (ftruncate(shm->fd, (off_t)size) != 0)
+    {
+        perror("Error sizing the shared memory segment");
+        shm_export_close(shm);
+        return RETURN_ERROR;
+    }
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        perror("Error mapping the shared memory segment");
+        shm_export_close(shm);
+        return RETURN_ERROR;
+    }
+    shm->header = mapping;
+    shm->mapped_size = size;
+
+    // ftruncate() zero-filled the segment, so the sequence starts even with an empty snapshot
+    shm->header->version = SHM_EXPORT_VERSION;
+    shm->header->capacity = SHM_EXPORT_INITIAL_CAPACITY;
+    shm->header->entry_size = sizeof(ShmExportEntry);
+    atomic_thread_fence(memory_order_release);
+    shm->header->magic = SHM_EXPORT_MAGIC;
+    return 0;
+}
+
+int shm_export_publish(ShmExport* shm)
+{
+    uint64_t generation = prom_collector_registry_generation();
+    if (shm->published && generation == shm->generation)
+    {
+        return 0;
+    }
+
+    // The release fence keeps the entry stores from being seen before the sequence turns odd
+    uint64_t sequence = atomic_load_explicit(&shm->header->sequence, memory_order_relaxed);
+    atomic_store_explicit(&shm->header->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    shm->incomplete = false;
+    size_t count = 0;
+    int result = prom_collector_registry_visit_samples(PROM_COLLECTOR_REGISTRY_DEFAULT, write_entry, shm, &count);
+    if (count > shm->header->capacity)
+    {
+        count = shm->header->capacity;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    shm->header->entry_count = result == 0 ? count : 0;
+    shm->header->generation = generation;
+    shm->header->timestamp_ns = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+    shm->header->flags = shm->incomplete ? SHM_EXPORT_INCOMPLETE : 0;
+
+    atomic_store_explicit(&shm->header->sequence, sequence + 2, memory_order_release);
+
+    if (result != 0)
+    {
+        fprintf(stderr, "Error reading the metrics for the shared memory segment\n");
+        return RETURN_ERROR;
+    }
+    shm->generation = generation;
+    shm->published = true;
+    return 0;
+}
+
+void shm_export_close(ShmExport* shm)
+{
+    if (shm->header != NULL)
+    {
+        munmap(shm->header, shm->mapped_size);
+        shm->header = NULL;
+    }
+    if (shm->fd >= 0)
+    {
+        close(shm->fd);
+        shm_unlink(shm->name);
+        shm->fd = -1;
+    }
+}
@@ -0,0 +1,154 @@
+/**
+ * @file source_cache.c
+ * @brief Functions for reading /proc and /sys sources through persistent file descriptors.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "source_cache.h"
+#include "irq_stats.h"
+#include "metrics.h"
+#include "sysroot.h"
+#include <errno.h>
+#include <prom_alloc.h>
+#include <prom_procfs.h>
+
+/**
+ * @brief Structure to hold an open source and its read buffer.
+ */
+typedef struct
+{
+    const char* path; /**< Path of the source. */
+    int fd;           /**< Cached descriptor, or -1 if the source is not open. */
+    char* buffer;     /**< Buffer holding the last contents read. */
+    size_t capacity;  /**< Size of buffer in bytes. */
+} CachedSource;
+
+static _Thread_local CachedSource sources[MAX_SOURCES]; /**< Sources opened so far by the calling thread. */
+static _Thread_local size_t source_count = 0;           /**< Number of used entries in sources. */
+
+/**
+ * @brief Size hints of the sources read on every cycle, large enough for their usual contents to fit in one block.
+ */
+static const struct
+{
+    const char* path; /**< Path of the source. */
+    size_t size;      /**< Initial buffer size in bytes. */
+} source_size_hints[] = {
+    {PROC_STAT_PATH, 16384},
+    {PROC_MEMINFO_PATH, 2048},
+    {PROC_NET_DEV_PATH, 4096},
+    {DISKSTATS_PATH, 8192},
+    {INTERRUPTS_PATH, 32768},
+    {SOFTIRQS_PATH, 8192},
+    {VMSTAT_PATH, 8192},
+};
+
+static size_t source_size_hint(const char* path)
+{
+    for (size_t i = 0; i < sizeof(source_size_hints) / sizeof(source_size_hints[0]); i++)
+    {
+        if (strcmp(source_size_hints[i].path, path) == 0)
+        {
+            return source_size_hints[i].size;
+        }
+    }
+    return SOURCE_INITIAL_BUFFER;
+}
+
+static CachedSource* find_source(const char* path)
+{
+    for (size_t i = 0; i < source_count; i++)
+    {
+        if (sources[i].path == path || strcmp(sources[i].path, path) == 0)
+        {
+            return &sources[i];
+        }
+    }
+
+    if (source_count >= MAX_SOURCES)
+    {
+        fprintf(stderr, "Error: too many cached sources (max %d)\n", MAX_SOURCES);
+        return NULL;
+    }
+
+    // The buffer is allocated by the first read, sized from the hint of the source
+    CachedSource* source = &sources[source_count++];
+    source->path = path;
+    source->fd = -1;
+    source->buffer = NULL;
+    source->capacity = source_size_hint(path);
+    return source;
+}
+
+static int open_source(CachedSource* source)
+{
+    if (source->fd >= 0)
+    {
+        close(source->fd);
+    }
+
+    char buffer[PATH_MAX];
+    const char* path = sysroot_path(source->path, buffer, sizeof(buffer));
+    source->fd = path != NULL ? open(path, O_RDONLY | O_CLOEXEC) : -1;
+    if (source->fd < 0)
+    {
+        fprintf(stderr, "Error opening %s: %s\n", source->path, strerror(errno));
+        return RETURN_ERROR;
+    }
+    return 0;
+}
+
+static int is_stale_error(int err)
+{
+    // ENODEV is what sysfs returns for attributes of a device that has been removed
+    return err == ESTALE || err == ENOENT || err == ENODEV;
+}
+
+const char* source_cache_read(const char* path, size_t* len)
+{
+    CachedSource* source = find_source(path);
+    if (source == NULL)
+    {
+        return NULL;
+    }
+
+    if (source->fd < 0 && open_source(source) != 0)
+    {
+        return NULL;
+    }
+
+    ssize_t n = prom_procfs_read(source->fd, &source->buffer, &source->capacity, SOURCE_MAX_BUFFER);
+    if (n < 0 && is_stale_error(errno))
+    {
+        if (open_source(source) != 0)
+        {
+            return NULL;
+        }
+        n = prom_procfs_read(source->fd, &source->buffer, &source->capacity, SOURCE_MAX_BUFFER);
+    }
+    if (n < 0)
+    {
+        fprintf(stderr, "Error reading %s: %s\n", source->path, strerror(errno));
+        return NULL;
+    }
+
+    if (len != NULL)
+    {
+        *len = (size_t)n;
+    }
+    return source->buffer;
+}
+
+void source_cache_close_all(void)
+{
+    for (size_t i = 0; i < source_count; i++)
+    {
+        if (sources[i].fd >= 0)
+        {
+            close(sources[i].fd);
+        }
+        prom_free(sources[i].buffer);
+    }
+    source_count = 0;
+}
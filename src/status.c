@@ -0,0 +1,178 @@
+/**
+ * @file status.c
+ * @brief Functions for keeping the status of the monitor in memory and serving it as /status and /catalog.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "status.h"
+#include "expose_metrics.h"
+#include "json_writer.h"
+#include <inttypes.h>
+
+#define STATUS_CONTENT_TYPE "application/json" /**< Content-Type of both endpoints. */
+
+/**
+ * @brief Structure to hold the last run of a collector.
+ */
+typedef struct
+{
+    struct timespec last_run; /**< CLOCK_REALTIME start time of the last run. */
+    uint64_t duration_ns;     /**< Duration of the last run in nanoseconds. */
+    uint64_t runs;            /**< Number of runs. */
+} CollectorStatus;
+
+static pthread_mutex_t status_lock = PTHREAD_MUTEX_INITIALIZER; /**< Guards every field below. */
+static char status_message[STATUS_MESSAGE_SIZE];                /**< Last status message. */
+static struct timespec status_updated;                          /**< CLOCK_REALTIME time of status_message. */
+static bool* status_selected;                                   /**< Copy of the selection, by all_metrics index. */
+static size_t status_selected_count;                            /**< Number of entries in status_selected. */
+static CollectorStatus collector_status[MAX_COLLECTORS];        /**< Last runs, by all_collectors index. */
+
+void status_set(const char* status)
+{
+    pthread_mutex_lock(&status_lock);
+    snprintf(status_message, sizeof(status_message), "%s", status);
+    clock_gettime(CLOCK_REALTIME, &status_updated);
+    pthread_mutex_unlock(&status_lock);
+}
+
+void status_set_selection(const bool* selected, size_t count)
+{
+    pthread_mutex_lock(&status_lock);
+    if (count != status_selected_count)
+    {
+        bool* copy = realloc(status_selected, count * sizeof(*copy));
+        if (copy == NULL && count > 0)
+        {
+            perror("realloc");
+            pthread_mutex_unlock(&status_lock);
+            return;
+        }
+        status_selected = copy;
+        status_selected_count = count;
+    }
+    if (count > 0)
+    {
+        memcpy(status_selected, selected, count * sizeof(*selected));
+    }
+    pthread_mutex_unlock(&status_lock);
+}
+
+void status_record_run(collector_fn update_function, const struct timespec* started, uint64_t duration_ns)
+{
+    for (size_t i = 0; i < MAX_COLLECTORS && all_collectors[i].name != NULL; i++)
+    {
+        if (all_collectors[i].update_function == update_function)
+        {
+            pthread_mutex_lock(&status_lock);
+            collector_status[i].last_run = *started;
+            collector_status[i].duration_ns = duration_ns;
+            collector_status[i].runs++;
+            pthread_mutex_unlock(&status_lock);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Returns a CLOCK_REALTIME time in seconds.
+ */
+static double timespec_seconds(const struct timespec* time)
+{
+    return (double)time->tv_sec + (double)time->tv_nsec / 1e9;
+}
+
+/**
+ * @brief Renders /status; matches promhttp_endpoint_fn.
+ */
+static size_t render_status(void* arg, promhttp_request_t* request, char* buf, size_t size)
+{
+    (void)arg;
+    (void)request;
+    JsonWriter writer = {buf, size, 0};
+
+    pthread_mutex_lock(&status_lock);
+    json_append(&writer, "{\"status\":");
+    json_string(&writer, status_message);
+    json_append(&writer, ",\"updated\":%.3f,\"selected_metrics\":[", timespec_seconds(&status_updated));
+
+    const char* separator = "";
+    for (size_t i = 0; i < status_selected_count; i++)
+    {
+        if (status_selected[i])
+        {
+            json_append(&writer, "%s", separator);
+            json_string(&writer, all_metrics[i].name);
+            separator = ",";
+        }
+    }
+
+    json_append(&writer, "],\"collectors\":[");
+    separator = "";
+    for (size_t i = 0; i < MAX_COLLECTORS && all_collectors[i].name != NULL; i++)
+    {
+        const CollectorStatus* collector = &collector_status[i];
+        if (collector->runs == 0)
+        {
+            continue;
+        }
+        json_append(&writer, "%s{\"name\":", separator);
+        json_string(&writer, all_collectors[i].name);
+        json_append(&writer, ",\"last_run\":%.3f,\"duration_ms\":%.3f,\"runs\":%" PRIu64 "}",
+                    timespec_seconds(&collector->last_run), (double)collector->duration_ns / 1e6, collector->runs);
+        separator = ",";
+    }
+    pthread_mutex_unlock(&status_lock);
+
+    json_append(&writer, "]}\n");
+    return writer.len;
+}
+
+/**
+ * @brief Renders /catalog; matches promhttp_endpoint_fn.
+ */
+static size_t render_catalog(void* arg, promhttp_request_t* request, char* buf, size_t size)
+{
+    (void)arg;
+    (void)request;
+    JsonWriter writer = {buf, size, 0};
+
+    json_append(&writer, "{\"metrics\":[");
+    pthread_mutex_lock(&status_lock);
+    for (size_t i = 0; all_metrics[i].name != NULL; i++)
+    {
+        const MetricInfo* info = &all_metrics[i];
+        json_append(&writer, "%s{\"name\":", i > 0 ? "," : "");
+        json_string(&writer, info->name);
+        json_append(&writer, ",\"description\":");
+        json_string(&writer, info->description);
+        json_append(&writer, ",\"type\":\"%s\",\"collector\":", info->kind == METRIC_COUNTER ? "counter" : "gauge");
+        json_string(&writer, collector_name(info->update_function));
+        json_append(&writer, ",\"interval_ms\":%u,\"labels\":[",
+                    info->interval_ms != 0 ? info->interval_ms : DEFAULT_INTERVAL_MS);
+        for (size_t k = 0; k < info->label_count; k++)
+        {
+            json_append(&writer, "%s", k > 0 ? "," : "");
+            json_string(&writer, info->label_keys[k]);
+        }
+        bool selected = i < status_selected_count && status_selected[i];
+        json_append(&writer, "],\"rollup\":%s,\"selected\":%s}", info->rollup != NULL ? "true" : "false",
+                    selected ? "true" : "false");
+    }
+    pthread_mutex_unlock(&status_lock);
+
+    json_append(&writer, "]}\n");
+    return writer.len;
+}
+
+int status_add_endpoints(void)
+{
+    if (promhttp_add_endpoint("/status", STATUS_CONTENT_TYPE, render_status, NULL) != 0 ||
+        promhttp_add_endpoint("/catalog", STATUS_CONTENT_TYPE, render_catalog, NULL) != 0)
+    {
+        fprintf(stderr, "Error adding the status endpoints\n");
+        return RETURN_ERROR;
+    }
+    return 0;
+}
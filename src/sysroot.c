@@ -0,0 +1,494 @@
+/**
+ * @file sysroot.c
+ * @brief Functions for reading /proc and /sys from a captured snapshot instead of the live host.
+ * @author 1v6n
+ * @date 15/10/2026
+ */
+
+#define _GNU_SOURCE
+
+#include "sysroot.h"
+#include "metrics.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+
+static char sysroot[PATH_MAX];   /**< Directory the paths are read from, empty for the live host. */
+static char extracted[PATH_MAX]; /**< Directory an archive was extracted to, removed at exit; empty for none. */
+
+/**
+ * @brief Header of a tar entry, in the ustar layout.
+ */
+typedef struct
+{
+    char name[100];     /**< Name of the entry, continued by prefix. */
+    char mode[8];       /**< Permissions, in octal. */
+    char uid[8];        /**< Owner, in octal. */
+    char gid[8];        /**< Group, in octal. */
+    char size[12];      /**< Size of the contents, in octal. */
+    char mtime[12];     /**< Modification time, in octal. */
+    char checksum[8];   /**< Sum of the header bytes, in octal. */
+    char type;          /**< Kind of the entry. */
+    char linkname[100]; /**< Target of a link. */
+    char magic[6];      /**< "ustar", for the layout below. */
+    char version[2];    /**< Version of the layout. */
+    char uname[32];     /**< Name of the owner. */
+    char gname[32];     /**< Name of the group. */
+    char devmajor[8];   /**< Major number of a device. */
+    char devminor[8];   /**< Minor number of a device. */
+    char prefix[155];   /**< Directory of the entry, prepended to name. */
+    char padding[12];   /**< Up to TAR_BLOCK_SIZE. */
+} TarHeader;
+
+bool sysroot_active(void)
+{
+    return sysroot[0] != '\0';
+}
+
+const char* sysroot_path(const char* path, char* buffer, size_t size)
+{
+    if (!sysroot_active())
+    {
+        return path;
+    }
+    int len = snprintf(buffer, size, "%s%s", sysroot, path);
+    return len >= 0 && (size_t)len < size ? buffer : NULL;
+}
+
+/**
+ * @brief Parses an octal field of a tar header, which may end with a space or a NUL.
+ *
+ * @return The value, or -1 if the field is not octal.
+ */
+static long long parse_octal(const char* field, size_t size)
+{
+    long long value = 0;
+    size_t i = 0;
+    while (i < size && field[i] == ' ')
+    {
+        i++;
+    }
+    for (; i < size && field[i] >= '0' && field[i] <= '7'; i++)
+    {
+        value = value * 8 + (field[i] - '0');
+    }
+    return i < size && field[i] != ' ' && field[i] != '\0' ? -1 : value;
+}
+
+/**
+ * @brief Reads the contents of an entry into a NUL-terminated string, for GNU long names and pax headers.
+ *
+ * @return The contents, to be freed by the caller, or NULL in case of error.
+ */
+static char* read_contents(FILE* archive, long long size)
+{
+    if (size < 0 || size >= PATH_MAX * 4)
+    {
+        return NULL;
+    }
+    size_t padded = ((size_t)size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+    char* contents = malloc(padded + 1);
+    if (contents == NULL || fread(contents, 1, padded, archive) != padded)
+    {
+        free(contents);
+        return NULL;
+    }
+    contents[size] = '\0';
+    return contents;
+}
+
+/**
+ * @brief Looks up a key in the records of a pax header, each written as "<length> <key>=<value>\n".
+ *
+ * @return A copy of the value, to be freed by the caller, or NULL if the key is missing.
+ */
+static char* pax_value(const char* records, const char* key)
+{
+    size_t key_len = strlen(key);
+    const char* record = records;
+    while (*record != '\0')
+    {
+        char* end = NULL;
+        long length = strtol(record, &end, 10);
+        if (length <= 0 || *end != ' ' || strnlen(record, (size_t)length) < (size_t)length)
+        {
+            return NULL;
+        }
+        const char* field = end + 1;
+        if (strncmp(field, key, key_len) == 0 && field[key_len] == '=')
+        {
+            const char* value = field + key_len + 1;
+            return strndup(value, (size_t)(record + length - 1 - value));
+        }
+        record += length;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Tells whether the name of an entry stays inside the directory it is extracted to.
+ */
+static bool safe_name(const char* name)
+{
+    if (name[0] == '/' || name[0] == '\0')
+    {
+        return false;
+    }
+    for (const char* part = name; part != NULL; part = strchr(part, '/'))
+    {
+        part += *part == '/';
+        if (strncmp(part, "..", 2) == 0 && (part[2] == '/' || part[2] == '\0'))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Tells whether a symbolic link target, resolved from the directory of the link, stays inside the root.
+ *
+ * @param name Name of the link relative to the root, already checked by safe_name.
+ */
+static bool safe_link(const char* name, const char* target)
+{
+    if (target[0] == '/' || target[0] == '\0')
+    {
+        return false;
+    }
+    long depth = 0;
+    for (const char* slash = strchr(name, '/'); slash != NULL; slash = strchr(slash + 1, '/'))
+    {
+        depth++;
+    }
+    for (const char* part = target; *part != '\0';)
+    {
+        size_t len = strcspn(part, "/");
+        if (len == 2 && strncmp(part, "..", 2) == 0)
+        {
+            if (--depth < 0)
+            {
+                return false;
+            }
+        }
+        else if (len > 0 && !(len == 1 && part[0] == '.'))
+        {
+            depth++;
+        }
+        part += len;
+        part += *part == '/';
+    }
+    return true;
+}
+
+/**
+ * @brief Opens the parent directory of an entry below the root, creating the missing directories on the way.
+ *
+ * Every directory is opened with O_NOFOLLOW, so a symbolic link planted by an earlier entry is never walked through.
+ *
+ * @param root_fd Descriptor of the root.
+ * @param relative Name of the entry relative to the root, already checked by safe_name.
+ * @param leaf Set to the last component of relative.
+ * @return A descriptor of the parent directory, or -1 with errno set.
+ */
+static int open_parent(int root_fd, const char* relative, const char** leaf)
+{
+    int dir_fd = dup(root_fd);
+    const char* part = relative;
+    for (const char* slash = strchr(part, '/'); dir_fd >= 0 && slash != NULL; slash = strchr(part, '/'))
+    {
+        char component[NAME_MAX + 1];
+        size_t len = (size_t)(slash - part);
+        if (len > NAME_MAX)
+        {
+            close(dir_fd);
+            errno = ENAMETOOLONG;
+            return RETURN_ERROR;
+        }
+        memcpy(component, part, len);
+        component[len] = '\0';
+        part = slash + 1;
+        if (len == 0 || strcmp(component, ".") == 0)
+        {
+            continue;
+        }
+
+        if (mkdirat(dir_fd, component, 0755) != 0 && errno != EEXIST)
+        {
+            close(dir_fd);
+            return RETURN_ERROR;
+        }
+        int next_fd = openat(dir_fd, component, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        close(dir_fd);
+        dir_fd = next_fd;
+    }
+    *leaf = part;
+    return dir_fd;
+}
+
+/**
+ * @brief Copies the contents of a regular file entry, then skips their padding.
+ */
+static int extract_file(FILE* archive, int dir_fd, const char* leaf, long long size)
+{
+    int fd = openat(dir_fd, leaf, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        return RETURN_ERROR;
+    }
+
+    char block[TAR_BLOCK_SIZE];
+    int result = 0;
+    for (long long left = size; left > 0; left -= TAR_BLOCK_SIZE)
+    {
+        size_t used = left < TAR_BLOCK_SIZE ? (size_t)left : TAR_BLOCK_SIZE;
+        if (fread(block, 1, TAR_BLOCK_SIZE, archive) != TAR_BLOCK_SIZE || write(fd, block, used) != (ssize_t)used)
+        {
+            result = RETURN_ERROR;
+            break;
+        }
+    }
+    close(fd);
+    return result;
+}
+
+/**
+ * @brief Skips the contents of an entry that is not extracted.
+ */
+static int skip_contents(FILE* archive, long long size)
+{
+    long long padded = (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+    return fseeko(archive, (off_t)padded, SEEK_CUR) == 0 ? 0 : RETURN_ERROR;
+}
+
+int sysroot_extract(const char* archive_path, const char* directory)
+{
+    FILE* archive = fopen(archive_path, "rb");
+    if (archive == NULL)
+    {
+        fprintf(stderr, "Error opening %s: %s\n", archive_path, strerror(errno));
+        return RETURN_ERROR;
+    }
+    int root_fd = open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0)
+    {
+        fprintf(stderr, "Error opening %s: %s\n", directory, strerror(errno));
+        fclose(archive);
+        return RETURN_ERROR;
+    }
+
+    // GNU long names and pax headers describe the entry that follows them
+    char* long_name = NULL;
+    char* long_link = NULL;
+    int result = RETURN_ERROR;
+    TarHeader header;
+    while (fread(&header, 1, sizeof(header), archive) == sizeof(header))
+    {
+        if (header.name[0] == '\0')
+        {
+            // The archive ends with zero blocks
+            result = 0;
+            break;
+        }
+        long long size = parse_octal(header.size, sizeof(header.size));
+        if (size < 0 || strncmp(header.magic, "ustar", 5) != 0)
+        {
+            fprintf(stderr, "Error reading %s: not an uncompressed tar archive\n", archive_path);
+            break;
+        }
+
+        if (header.type == 'L' || header.type == 'K')
+        {
+            char** target = header.type == 'L' ? &long_name : &long_link;
+            free(*target);
+            if ((*target = read_contents(archive, size)) == NULL)
+            {
+                break;
+            }
+            continue;
+        }
+        if (header.type == 'x')
+        {
+            char* records = read_contents(archive, size);
+            if (records == NULL)
+            {
+                break;
+            }
+            char* path = pax_value(records, "path");
+            char* linkpath = pax_value(records, "linkpath");
+            free(records);
+            if (path != NULL)
+            {
+                free(long_name);
+                long_name = path;
+            }
+            if (linkpath != NULL)
+            {
+                free(long_link);
+                long_link = linkpath;
+            }
+            continue;
+        }
+
+        char name[PATH_MAX];
+        if (long_name != NULL)
+        {
+            snprintf(name, sizeof(name), "%s", long_name);
+        }
+        else if (header.prefix[0] != '\0' && header.magic[5] == '\0')
+        {
+            snprintf(name, sizeof(name), "%.155s/%.100s", header.prefix, header.name);
+        }
+        else
+        {
+            snprintf(name, sizeof(name), "%.100s", header.name);
+        }
+        char linkname[PATH_MAX];
+        snprintf(linkname, sizeof(linkname), "%.*s", long_link != NULL ? PATH_MAX : 100,
+                 long_link != NULL ? long_link : header.linkname);
+        free(long_name);
+        free(long_link);
+        long_name = NULL;
+        long_link = NULL;
+
+        char* relative = name;
+        while (strncmp(relative, "./", 2) == 0)
+        {
+            relative += 2;
+        }
+        size_t len = strlen(relative);
+        while (len > 0 && relative[len - 1] == '/')
+        {
+            relative[--len] = '\0';
+        }
+
+        char path[PATH_MAX];
+        bool extract = len > 0 && safe_name(relative) &&
+                       snprintf(path, sizeof(path), "%s/%s", directory, relative) < (int)sizeof(path) &&
+                       (header.type == '0' || header.type == '\0' || header.type == '5' || header.type == '2');
+        if (extract && header.type == '2' && !safe_link(relative, linkname))
+        {
+            fprintf(stderr, "Skipping %s: its target %s leaves the archive\n", relative, linkname);
+            extract = false;
+        }
+        if (!extract)
+        {
+            if (skip_contents(archive, header.type == '5' || header.type == '2' ? 0 : size) != 0)
+            {
+                break;
+            }
+            continue;
+        }
+
+        const char* leaf = NULL;
+        int dir_fd = open_parent(root_fd, relative, &leaf);
+        if (dir_fd < 0)
+        {
+            fprintf(stderr, "Error creating the parents of %s: %s\n", path, strerror(errno));
+            break;
+        }
+        int status = 0;
+        if (header.type == '5')
+        {
+            status = mkdirat(dir_fd, leaf, 0755) != 0 && errno != EEXIST ? RETURN_ERROR : 0;
+        }
+        else if (header.type == '2')
+        {
+            status = symlinkat(linkname, dir_fd, leaf) != 0 && errno != EEXIST ? RETURN_ERROR : 0;
+        }
+        else
+        {
+            status = extract_file(archive, dir_fd, leaf, size);
+        }
+        int error = errno;
+        close(dir_fd);
+        if (status != 0)
+        {
+            fprintf(stderr, "Error extracting %s: %s\n", path, strerror(error));
+            break;
+        }
+    }
+
+    free(long_name);
+    free(long_link);
+    close(root_fd);
+    fclose(archive);
+    return result;
+}
+
+static int remove_entry(const char* path, const struct stat* info, int flag, struct FTW* ftw)
+{
+    (void)info;
+    (void)flag;
+    (void)ftw;
+    remove(path);
+    return 0;
+}
+
+/**
+ * @brief Removes the directory an archive was extracted to.
+ */
+static void remove_extracted(void)
+{
+    if (extracted[0] != '\0')
+    {
+        nftw(extracted, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+        extracted[0] = '\0';
+    }
+}
+
+int sysroot_init(void)
+{
+    const char* root = getenv(SYSROOT_ENV);
+    if (root == NULL || *root == '\0')
+    {
+        return 0;
+    }
+
+    struct stat info;
+    if (stat(root, &info) != 0)
+    {
+        fprintf(stderr, "Error reading %s '%s': %s, reading the live host\n", SYSROOT_ENV, root, strerror(errno));
+        return RETURN_ERROR;
+    }
+
+    if (S_ISDIR(info.st_mode))
+    {
+        if (snprintf(sysroot, sizeof(sysroot), "%s", root) >= (int)sizeof(sysroot))
+        {
+            sysroot[0] = '\0';
+            fprintf(stderr, "Error: %s is too long, reading the live host\n", SYSROOT_ENV);
+            return RETURN_ERROR;
+        }
+    }
+    else
+    {
+        const char* tmpdir = getenv("TMPDIR");
+        snprintf(extracted, sizeof(extracted), "%s/" SYSROOT_TEMPLATE,
+                 tmpdir != NULL && *tmpdir != '\0' ? tmpdir : "/tmp");
+        if (mkdtemp(extracted) == NULL)
+        {
+            fprintf(stderr, "Error creating %s: %s, reading the live host\n", extracted, strerror(errno));
+            extracted[0] = '\0';
+            return RETURN_ERROR;
+        }
+        atexit(remove_extracted);
+        if (sysroot_extract(root, extracted) != 0)
+        {
+            fprintf(stderr, "Error extracting %s, reading the live host\n", root);
+            remove_extracted();
+            return RETURN_ERROR;
+        }
+        snprintf(sysroot, sizeof(sysroot), "%s", extracted);
+    }
+
+    // A trailing '/' would double the one every absolute path starts with
+    size_t len = strlen(sysroot);
+    while (len > 1 && sysroot[len - 1] == '/')
+    {
+        sysroot[--len] = '\0';
+    }
+    printf("Replaying /proc and /sys from %s\n", sysroot);
+    return 0;
+}
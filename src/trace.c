@@ -0,0 +1,199 @@
+/**
+ * @file trace.c
+ * @brief Functions for the per-event tracing of collector runs and scrapes.
+ * @author 1v6n
+ * @date 15/10/2026
+ */
+
+#include "trace.h"
+#include "expose_metrics.h"
+
+#ifdef MONITOR_TRACING
+
+#include <inttypes.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+
+/**
+ * @brief Structure to hold one traced event.
+ */
+typedef struct
+{
+    TraceKind kind;        /**< Kind of the event. */
+    void (*subject)(void); /**< Collector the event is about, or NULL. */
+    uint64_t start_ns;     /**< CLOCK_REALTIME start of the event. */
+    uint64_t duration_ns;  /**< Length of the event. */
+    uint64_t value;        /**< Value attached to the event. */
+} TraceEvent;
+
+/**
+ * @brief Structure to hold the ring of one thread. The thread is its only producer and trace_dump its only consumer.
+ */
+typedef struct
+{
+    alignas(64) atomic_size_t head;     /**< Count of events written, only advanced by the producer. */
+    alignas(64) atomic_size_t tail;     /**< Count of events read, only advanced by the consumer. */
+    atomic_ullong dropped;              /**< Events dropped because the ring was full. */
+    long tid;                           /**< Kernel id of the producing thread. */
+    TraceEvent events[TRACE_RING_SIZE]; /**< Events, at their count modulo TRACE_RING_SIZE. */
+} TraceRing;
+
+static TraceRing* _Atomic trace_rings[TRACE_MAX_THREADS]; /**< Ring of every thread that recorded an event. */
+static atomic_size_t trace_ring_count;                    /**< Number of claimed entries of trace_rings. */
+static _Thread_local TraceRing* own_ring;                 /**< Ring of the calling thread, NULL until claimed. */
+static _Thread_local bool own_ring_claimed;               /**< Whether the calling thread tried to claim a ring. */
+
+static const char* trace_names[] = {"collector", "scrape render", "scrape send"}; /**< Names of the event kinds. */
+static const char* trace_categories[] = {"collector", "scrape", "scrape"};        /**< Categories of the kinds. */
+
+/**
+ * @brief Returns the ring of the calling thread, claiming one on its first event.
+ *
+ * @return The ring, or NULL if TRACE_MAX_THREADS threads already own one or the ring could not be allocated.
+ */
+static TraceRing* claim_ring(void)
+{
+    if (own_ring_claimed)
+    {
+        return own_ring;
+    }
+    own_ring_claimed = true;
+
+    size_t index = atomic_fetch_add(&trace_ring_count, 1);
+    if (index >= TRACE_MAX_THREADS)
+    {
+        return NULL;
+    }
+    TraceRing* ring = aligned_alloc(alignof(TraceRing), sizeof(TraceRing));
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->tid = syscall(SYS_gettid);
+    atomic_store_explicit(&trace_rings[index], ring, memory_order_release);
+    own_ring = ring;
+    return ring;
+}
+
+void trace_record(TraceKind kind, void (*subject)(void), uint64_t start_ns, uint64_t duration_ns, uint64_t value)
+{
+    TraceRing* ring = claim_ring();
+    if (ring == NULL)
+    {
+        return;
+    }
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= TRACE_RING_SIZE)
+    {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    ring->events[head & (TRACE_RING_SIZE - 1)] = (TraceEvent){kind, subject, start_ns, duration_ns, value};
+    // Publishes the event to the consumer
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * @brief Writes a time in nanoseconds as the microseconds Chrome traces count in.
+ */
+static void write_micros(FILE* file, uint64_t ns)
+{
+    fprintf(file, "%" PRIu64 ".%03u", ns / 1000, (unsigned int)(ns % 1000));
+}
+
+/**
+ * @brief Drains one ring into the trace, after the events already written.
+ *
+ * @param first Whether no event has been written yet, cleared once one is.
+ */
+static void drain_ring(FILE* file, TraceRing* ring, pid_t pid, bool* first)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    for (; tail != head; tail++)
+    {
+        const TraceEvent* event = &ring->events[tail & (TRACE_RING_SIZE - 1)];
+        const char* name = event->kind == TRACE_COLLECTOR ? collector_name(event->subject) : trace_names[event->kind];
+        fprintf(file, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%ld,\"ts\":",
+                *first ? "" : ",", name, trace_categories[event->kind], (int)pid, ring->tid);
+        write_micros(file, event->start_ns);
+        fprintf(file, ",\"dur\":");
+        write_micros(file, event->duration_ns);
+        if (event->kind == TRACE_SCRAPE_RENDER)
+        {
+            fprintf(file, ",\"args\":{\"bytes\":%" PRIu64 "}", event->value);
+        }
+        else if (event->kind == TRACE_SCRAPE_SEND)
+        {
+            fprintf(file, ",\"args\":{\"completed\":%s}", event->value != 0 ? "true" : "false");
+        }
+        fputc('}', file);
+        *first = false;
+    }
+    // Hands the slots back to the producer
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+    fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%ld,\"args\":{\"name\":\"%ld\"",
+            *first ? "" : ",", (int)pid, ring->tid, ring->tid);
+    unsigned long long dropped = atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+    if (dropped > 0)
+    {
+        fprintf(file, ",\"dropped\":%llu", dropped);
+    }
+    fprintf(file, "}}");
+    *first = false;
+}
+
+int trace_dump(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Error opening %s: %s\n", path, strerror(errno));
+        return RETURN_ERROR;
+    }
+
+    pid_t pid = getpid();
+    bool first = true;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    size_t count = atomic_load(&trace_ring_count);
+    for (size_t i = 0; i < count && i < TRACE_MAX_THREADS; i++)
+    {
+        TraceRing* ring = atomic_load_explicit(&trace_rings[i], memory_order_acquire);
+        if (ring != NULL)
+        {
+            drain_ring(file, ring, pid, &first);
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0)
+    {
+        fprintf(stderr, "Error writing %s: %s\n", path, strerror(errno));
+        return RETURN_ERROR;
+    }
+    return 0;
+}
+
+#else
+
+void trace_record(TraceKind kind, void (*subject)(void), uint64_t start_ns, uint64_t duration_ns, uint64_t value)
+{
+    (void)kind;
+    (void)subject;
+    (void)start_ns;
+    (void)duration_ns;
+    (void)value;
+}
+
+int trace_dump(const char* path)
+{
+    (void)path;
+    fprintf(stderr, "Error: built without MONITOR_TRACING, there is no trace to write\n");
+    return RETURN_ERROR;
+}
+
+#endif // MONITOR_TRACING
@@ -0,0 +1,92 @@
+/**
+ * @file worker_pool.c
+ * @brief Functions for running collectors concurrently on a small pool of worker threads.
+ * @author 1v6n
+ * @date 14/10/2026
+ */
+
+#include "worker_pool.h"
+#include "metrics.h"
+
+static void* worker_main(void* arg)
+{
+    WorkerPool* pool = arg;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (true)
+    {
+        while (pool->count == 0 && !pool->stopping)
+        {
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+        }
+        if (pool->count == 0)
+        {
+            break;
+        }
+
+        WorkerTask task = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % WORKER_QUEUE_SIZE;
+        pool->count--;
+
+        pthread_mutex_unlock(&pool->mutex);
+        task.function(task.arg);
+        pthread_mutex_lock(&pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+int worker_pool_init(WorkerPool* pool)
+{
+    memset(pool, 0, sizeof(*pool));
+
+    if (pthread_mutex_init(&pool->mutex, NULL) != 0 || pthread_cond_init(&pool->cond, NULL) != 0)
+    {
+        fprintf(stderr, "Error initializing worker pool\n");
+        return RETURN_ERROR;
+    }
+
+    for (size_t i = 0; i < WORKER_COUNT; i++)
+    {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0)
+        {
+            fprintf(stderr, "Error creating worker thread\n");
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    return pool->thread_count > 0 ? 0 : RETURN_ERROR;
+}
+
+int worker_pool_submit(WorkerPool* pool, worker_task_fn function, void* arg)
+{
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->count == WORKER_QUEUE_SIZE)
+    {
+        pthread_mutex_unlock(&pool->mutex);
+        return RETURN_ERROR;
+    }
+
+    pool->queue[(pool->head + pool->count) % WORKER_QUEUE_SIZE] = (WorkerTask){function, arg};
+    pool->count++;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+void worker_pool_destroy(WorkerPool* pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (size_t i = 0; i < pool->thread_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+}